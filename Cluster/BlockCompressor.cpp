@@ -0,0 +1,202 @@
+/***********************************************************************
+BlockCompressor - Class to send blocks of data from the master to the
+slaves of a cluster pipe in compressed form, and to receive and
+decompress them on the slaves.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Cluster Abstraction Library (Cluster).
+
+The Cluster Abstraction Library is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Cluster Abstraction Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Cluster Abstraction Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <Cluster/BlockCompressor.h>
+
+#include <string.h>
+#include <Misc/SizedTypes.h>
+#include <Misc/ThrowStdErr.h>
+#include <Cluster/Packet.h>
+#include <Cluster/Multiplexer.h>
+
+namespace Cluster {
+
+namespace {
+
+/**************
+Helper objects:
+**************/
+
+const size_t minBackoffBlockSize=1024; // Smallest block size whose failure to compress makes the master skip compressing upcoming blocks
+
+}
+
+/********************************
+Methods of class BlockCompressor:
+********************************/
+
+BlockCompressor::BlockCompressor(Multiplexer* sMultiplexer,unsigned int sPipeId,int sCompressionLevel)
+	:multiplexer(sMultiplexer),pipeId(sPipeId),compressionLevel(sCompressionLevel),
+	 blockBuffer(0),codedBuffer(0),
+	 numSkippedBlocks(0),skipInterval(0)
+	{
+	/* Initialize the zlib stream object for raw deflate data without headers: */
+	stream.next_in=Z_NULL;
+	stream.avail_in=0;
+	stream.zalloc=Z_NULL;
+	stream.zfree=Z_NULL;
+	stream.opaque=0;
+	int result;
+	if(multiplexer->isMaster())
+		result=deflateInit2(&stream,compressionLevel,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY);
+	else
+		result=inflateInit2(&stream,-15);
+	if(result!=Z_OK)
+		{
+		if(stream.msg!=0)
+			Misc::throwStdErr("Cluster::BlockCompressor: Error \"%s\" during initialization",stream.msg);
+		else
+			Misc::throwStdErr("Cluster::BlockCompressor: Internal zlib error during initialization");
+		}
+	
+	/* Allocate the block buffers: */
+	blockBuffer=new Bytef[getBlockSize()];
+	codedBuffer=new Bytef[getBlockSize()];
+	}
+
+BlockCompressor::~BlockCompressor(void)
+	{
+	/* Release the zlib stream object: */
+	if(multiplexer->isMaster())
+		deflateEnd(&stream);
+	else
+		inflateEnd(&stream);
+	
+	/* Delete the block buffers: */
+	delete[] blockBuffer;
+	delete[] codedBuffer;
+	}
+
+void BlockCompressor::sendBlock(const void* data,size_t dataSize)
+	{
+	const Bytef* sendData=static_cast<const Bytef*>(data);
+	size_t sendSize=dataSize;
+	
+	if(numSkippedBlocks==0)
+		{
+		/* Compress the block, but give up as soon as the compressed block is not significantly smaller than the original: */
+		deflateReset(&stream);
+		stream.next_in=const_cast<Bytef*>(sendData);
+		stream.avail_in=dataSize;
+		stream.next_out=codedBuffer;
+		stream.avail_out=dataSize-dataSize/8;
+		if(deflate(&stream,Z_FINISH)==Z_STREAM_END)
+			{
+			/* Send the compressed block: */
+			sendData=codedBuffer;
+			sendSize=stream.total_out;
+			skipInterval=0;
+			}
+		else if(dataSize>=minBackoffBlockSize)
+			{
+			/* Don't bother compressing the next few blocks; back off further if the data stays incompressible: */
+			if(skipInterval==0)
+				skipInterval=1;
+			else if(skipInterval<64)
+				skipInterval*=2;
+			numSkippedBlocks=skipInterval;
+			}
+		}
+	else
+		--numSkippedBlocks;
+	
+	/* Send the block's uncompressed and coded sizes in the first packet, followed by the coded data: */
+	size_t maxPacketSize=multiplexer->getMaxPacketSize();
+	Packet* packet=multiplexer->newPacket();
+	{
+	Packet::Writer writer(packet);
+	writer.write<Misc::UInt32>(Misc::UInt32(dataSize));
+	writer.write<Misc::UInt32>(Misc::UInt32(sendSize));
+	}
+	while(true)
+		{
+		/* Fill the rest of the packet: */
+		size_t copySize=maxPacketSize-packet->packetSize;
+		if(copySize>sendSize)
+			copySize=sendSize;
+		memcpy(packet->packet+packet->packetSize,sendData,copySize);
+		packet->packetSize+=copySize;
+		sendData+=copySize;
+		sendSize-=copySize;
+		multiplexer->sendPacket(pipeId,packet);
+		
+		if(sendSize==0)
+			break;
+		packet=multiplexer->newPacket();
+		packet->packetSize=0;
+		}
+	}
+
+size_t BlockCompressor::receiveBlock(Packet* firstPacket)
+	{
+	/* Read the block's uncompressed and coded sizes: */
+	Packet::Reader reader(firstPacket);
+	size_t dataSize=reader.read<Misc::UInt32>();
+	size_t codedSize=reader.read<Misc::UInt32>();
+	if(dataSize>getBlockSize()||codedSize>dataSize)
+		{
+		multiplexer->deletePacket(firstPacket);
+		Misc::throwStdErr("Cluster::BlockCompressor: Received malformed block header");
+		}
+	
+	/* Collect the coded data directly in the block buffer if the block was sent uncompressed: */
+	bool compressed=codedSize<dataSize;
+	Bytef* codedPtr=compressed?codedBuffer:blockBuffer;
+	size_t headerSize=2*sizeof(Misc::UInt32);
+	size_t copySize=firstPacket->packetSize-headerSize;
+	memcpy(codedPtr,firstPacket->packet+headerSize,copySize);
+	multiplexer->deletePacket(firstPacket);
+	for(size_t received=copySize;received<codedSize;received+=copySize)
+		{
+		Packet* packet=multiplexer->receivePacket(pipeId);
+		copySize=packet->packetSize;
+		if(received+copySize>codedSize)
+			{
+			multiplexer->deletePacket(packet);
+			Misc::throwStdErr("Cluster::BlockCompressor: Received overlong block");
+			}
+		memcpy(codedPtr+received,packet->packet,copySize);
+		multiplexer->deletePacket(packet);
+		}
+	
+	if(compressed)
+		{
+		/* Decompress the block into the block buffer: */
+		inflateReset(&stream);
+		stream.next_in=codedBuffer;
+		stream.avail_in=codedSize;
+		stream.next_out=blockBuffer;
+		stream.avail_out=dataSize;
+		if(inflate(&stream,Z_FINISH)!=Z_STREAM_END||stream.avail_out!=0)
+			{
+			if(stream.msg!=0)
+				Misc::throwStdErr("Cluster::BlockCompressor: Error \"%s\" while decompressing",stream.msg);
+			else
+				Misc::throwStdErr("Cluster::BlockCompressor: Data corruption detected while decompressing");
+			}
+		}
+	
+	return dataSize;
+	}
+
+}
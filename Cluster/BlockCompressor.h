@@ -0,0 +1,80 @@
+/***********************************************************************
+BlockCompressor - Class to send blocks of data from the master to the
+slaves of a cluster pipe in compressed form, and to receive and
+decompress them on the slaves.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Cluster Abstraction Library (Cluster).
+
+The Cluster Abstraction Library is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Cluster Abstraction Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Cluster Abstraction Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef CLUSTER_BLOCKCOMPRESSOR_INCLUDED
+#define CLUSTER_BLOCKCOMPRESSOR_INCLUDED
+
+#include <stddef.h>
+#include <zlib.h>
+#include <Cluster/Config.h>
+
+/* Forward declarations: */
+namespace Cluster {
+class Multiplexer;
+struct Packet;
+}
+
+namespace Cluster {
+
+class BlockCompressor
+	{
+	/* Elements: */
+	private:
+	Multiplexer* multiplexer; // Multiplexer over which blocks are sent
+	unsigned int pipeId; // ID of the pipe over which blocks are sent
+	int compressionLevel; // Zlib compression level used by the master
+	z_stream stream; // Zlib stream compressing blocks on the master, or decompressing them on the slaves
+	Bytef* blockBuffer; // Buffer holding an uncompressed block
+	Bytef* codedBuffer; // Buffer holding a compressed block
+	unsigned int numSkippedBlocks; // Number of upcoming blocks the master sends without trying to compress them
+	unsigned int skipInterval; // Number of blocks to skip after the most recent incompressible block; doubles with each incompressible block
+	
+	/* Constructors and destructors: */
+	public:
+	BlockCompressor(Multiplexer* sMultiplexer,unsigned int sPipeId,int sCompressionLevel); // Creates a block compressor for the given pipe using the given zlib compression level on the master
+	private:
+	BlockCompressor(const BlockCompressor& source); // Prohibit copy constructor
+	BlockCompressor& operator=(const BlockCompressor& source); // Prohibit assignment operator
+	public:
+	~BlockCompressor(void);
+	
+	/* Methods: */
+	static size_t getBlockSize(void) // Returns the maximum size of an uncompressed block
+		{
+		return CLUSTER_CONFIG_COMPRESSION_BLOCK_SIZE;
+		}
+	int getCompressionLevel(void) const // Returns the compression level
+		{
+		return compressionLevel;
+		}
+	void* getBlockBuffer(void) // Returns a buffer that can hold a maximum-size uncompressed block
+		{
+		return blockBuffer;
+		}
+	void sendBlock(const void* data,size_t dataSize); // Sends a block of at most maximum block size to the slaves; sends the block uncompressed if it does not compress well
+	size_t receiveBlock(Packet* firstPacket); // Receives the rest of a block whose first non-empty packet was already received, decompresses it into the block buffer, and returns its uncompressed size
+	};
+
+}
+
+#endif
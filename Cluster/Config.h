@@ -23,9 +23,18 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define CLUSTER_CONFIG_INCLUDED
 
 #define CLUSTER_CONFIG_MTU_SIZE 1500
+#define CLUSTER_CONFIG_MAX_MTU_SIZE 1500
 #define CLUSTER_CONFIG_IP_HEADER_SIZE 20
 #define CLUSTER_CONFIG_UDP_HEADER_SIZE 8
 
+#define CLUSTER_CONFIG_HAVE_MMSG 0
+#define CLUSTER_CONFIG_IO_BATCH_SIZE 32
+#define CLUSTER_CONFIG_GATHERDATA_WINDOW_SIZE 64
+#define CLUSTER_CONFIG_COLLECTIVE_FANOUT 4
+#define CLUSTER_CONFIG_FILE_READAHEAD_SIZE 64
+#define CLUSTER_CONFIG_FILE_SENDBUFFER_SIZE 128
+#define CLUSTER_CONFIG_COMPRESSION_BLOCK_SIZE 65536
+
 #define CLUSTER_CONFIG_DEBUG_MULTIPLEXER 0
 #define CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE 0
 
@@ -24,6 +24,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef CLUSTER_GATHEROPERATION_INCLUDED
 #define CLUSTER_GATHEROPERATION_INCLUDED
 
+#include <stddef.h>
+
 namespace Cluster {
 
 class GatherOperation
@@ -36,6 +38,46 @@ class GatherOperation
 		MIN,MAX, // Range operations
 		SUM,PRODUCT // Arithmetic operations
 		};
+	
+	/* Methods: */
+	template <class ValueParam>
+	static void accumulate(OpCode op,ValueParam* accumulators,const ValueParam* values,size_t numValues) // Accumulates an array of values into an array of accumulators element-wise using the given operation
+		{
+		switch(op)
+			{
+			case AND:
+				for(size_t i=0;i<numValues;++i)
+					accumulators[i]=accumulators[i]&&values[i];
+				break;
+			
+			case OR:
+				for(size_t i=0;i<numValues;++i)
+					accumulators[i]=accumulators[i]||values[i];
+				break;
+			
+			case MIN:
+				for(size_t i=0;i<numValues;++i)
+					if(accumulators[i]>values[i])
+						accumulators[i]=values[i];
+				break;
+			
+			case MAX:
+				for(size_t i=0;i<numValues;++i)
+					if(accumulators[i]<values[i])
+						accumulators[i]=values[i];
+				break;
+			
+			case SUM:
+				for(size_t i=0;i<numValues;++i)
+					accumulators[i]+=values[i];
+				break;
+			
+			case PRODUCT:
+				for(size_t i=0;i<numValues;++i)
+					accumulators[i]*=values[i];
+				break;
+			}
+		}
 	};
 
 }
@@ -23,9 +23,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <Cluster/MulticastPipe.h>
 
+#include <string.h>
+#include <Misc/SizedTypes.h>
 #include <Misc/ThrowStdErr.h>
 #include <Cluster/Packet.h>
 #include <Cluster/Multiplexer.h>
+#include <Cluster/BlockCompressor.h>
 
 namespace Cluster {
 
@@ -43,6 +46,15 @@ size_t MulticastPipe::readData(IO::File::Byte* buffer,size_t bufferSize)
 		multiplexer->deletePacket(oldPacket);
 		}
 	
+	if(compressor!=0)
+		{
+		/* Receive and decompress the next block, and install the block buffer as the buffered file's read buffer: */
+		size_t blockSize=compressor->receiveBlock(multiplexer->receivePacket(pipeId));
+		setReadBuffer(BlockCompressor::getBlockSize(),static_cast<Byte*>(compressor->getBlockBuffer()),false);
+		
+		return blockSize;
+		}
+	
 	/* Get the next packet from the multiplexer: */
 	packet=multiplexer->receivePacket(pipeId);
 	
@@ -54,6 +66,14 @@ size_t MulticastPipe::readData(IO::File::Byte* buffer,size_t bufferSize)
 
 void MulticastPipe::writeData(const IO::File::Byte* buffer,size_t bufferSize)
 	{
+	if(compressor!=0)
+		{
+		/* Compress and send the block buffer's contents; the block buffer remains the buffered file's write buffer: */
+		compressor->sendBlock(buffer,bufferSize);
+		
+		return;
+		}
+	
 	/* Pass the current packet to the multiplexer: */
 	{
 	Packet* sendPacket=packet;
@@ -64,7 +84,7 @@ void MulticastPipe::writeData(const IO::File::Byte* buffer,size_t bufferSize)
 	
 	/* Install a fresh cluster packet as the write buffer: */
 	packet=multiplexer->newPacket();
-	setWriteBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
+	setWriteBuffer(multiplexer->getMaxPacketSize(),reinterpret_cast<Byte*>(packet->packet),false);
 	}
 
 void MulticastPipe::flushPipe(void)
@@ -73,16 +93,84 @@ void MulticastPipe::flushPipe(void)
 	flush();
 	}
 
+unsigned int MulticastPipe::gatherChildData(std::vector<std::vector<char> >& childData)
+	{
+	/* Send any unsent data: */
+	flushPipe();
+	
+	/* Pass call through to multicast pipe multiplexer: */
+	return multiplexer->gatherChildData(pipeId,childData);
+	}
+
+unsigned int MulticastPipe::checkChildData(const std::vector<std::vector<char> >& childData,unsigned int firstChildIndex,size_t dataSize)
+	{
+	for(unsigned int i=0;i<childData.size();++i)
+		{
+		/* Check the status word following the child's partial result, which names a bad slave in the child's subtree: */
+		const std::vector<char>& cd=childData[i];
+		if(cd.size()<sizeof(Misc::UInt32))
+			return firstChildIndex+i;
+		Misc::UInt32 status;
+		memcpy(&status,&cd[cd.size()-sizeof(Misc::UInt32)],sizeof(Misc::UInt32));
+		if(status!=0)
+			return status;
+		
+		/* Check the size of the child's partial result: */
+		if(cd.size()!=dataSize+sizeof(Misc::UInt32))
+			return firstChildIndex+i;
+		}
+	
+	return 0;
+	}
+
+void MulticastPipe::finishReduction(unsigned int badSlave,void* values,size_t dataSize)
+	{
+	if(isMaster())
+		{
+		/* Tell the slaves whether the reduction will proceed, so that they don't wait for a result that never arrives: */
+		write<Misc::UInt32>(Misc::UInt32(badSlave));
+		if(badSlave!=0)
+			{
+			flush();
+			Misc::throwStdErr("Cluster::MulticastPipe: Slave %u contributed the wrong amount of data to a reduction",badSlave);
+			}
+		
+		/* Send the result to the slaves: */
+		writeRaw(values,dataSize);
+		flush();
+		}
+	else
+		{
+		/* Send the partial result followed by the status word to the parent, or only the status word if the reduction failed: */
+		size_t partialSize=badSlave==0?dataSize:0;
+		std::vector<char> partialResult(partialSize+sizeof(Misc::UInt32));
+		if(partialSize>0)
+			memcpy(&partialResult[0],values,partialSize);
+		Misc::UInt32 status(badSlave);
+		memcpy(&partialResult[partialSize],&status,sizeof(Misc::UInt32));
+		multiplexer->sendParentData(pipeId,&partialResult[0],partialResult.size());
+		
+		/* Check if the master accepted all slaves' data: */
+		badSlave=read<Misc::UInt32>();
+		if(badSlave!=0)
+			Misc::throwStdErr("Cluster::MulticastPipe: Slave %u contributed the wrong amount of data to a reduction",badSlave);
+		
+		/* Read the result: */
+		readRaw(values,dataSize);
+		}
+	}
+
 MulticastPipe::MulticastPipe(Multiplexer* sMultiplexer)
 	:IO::File(),ClusterPipe(sMultiplexer),
-	 packet(0)
+	 packet(0),
+	 compressor(0)
 	{
 	/* Set up the master or slave buffers: */
 	if(isMaster())
 		{
 		/* Install a fresh cluster packet as the write buffer: */
 		packet=multiplexer->newPacket();
-		setWriteBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
+		setWriteBuffer(multiplexer->getMaxPacketSize(),reinterpret_cast<Byte*>(packet->packet),false);
 		
 		/* Disable direct writes: */
 		canWriteThrough=false;
@@ -100,7 +188,12 @@ MulticastPipe::~MulticastPipe(void)
 		{
 		/* Check if there is unsent data in the write buffer: */
 		size_t unwrittenSize=getWritePtr();
-		if(unwrittenSize!=0)
+		if(compressor!=0&&unwrittenSize!=0)
+			{
+			/* Send the final block: */
+			compressor->sendBlock(compressor->getBlockBuffer(),unwrittenSize);
+			}
+		else if(unwrittenSize!=0)
 			{
 			/* Pass the final packet to the multiplexer: */
 			{
@@ -120,27 +213,28 @@ MulticastPipe::~MulticastPipe(void)
 		setReadBuffer(0,0,false);
 		}
 	
-	/* Delete the current cluster packet: */
+	/* Delete the current cluster packet and the block compressor: */
 	if(packet!=0)
 		multiplexer->deletePacket(packet);
+	delete compressor;
 	}
 
 size_t MulticastPipe::getReadBufferSize(void) const
 	{
-	/* Return the maximum cluster packet size: */
-	return Packet::maxPacketSize;
+	/* Return the maximum block size in compressed mode, or the maximum cluster packet size: */
+	return compressor!=0?BlockCompressor::getBlockSize():Packet::maxPacketSize;
 	}
 
 size_t MulticastPipe::getWriteBufferSize(void) const
 	{
-	/* Return the maximum cluster packet size: */
-	return Packet::maxPacketSize;
+	/* Return the maximum block size in compressed mode, or the maximum cluster packet size at the multiplexer's MTU size: */
+	return compressor!=0?BlockCompressor::getBlockSize():multiplexer->getMaxPacketSize();
 	}
 
 size_t MulticastPipe::resizeReadBuffer(size_t newReadBufferSize)
 	{
-	/* Ignore the request and return the maximum cluster packet size: */
-	return Packet::maxPacketSize;
+	/* Ignore the request and return the current read buffer size: */
+	return getReadBufferSize();
 	}
 
 void MulticastPipe::resizeWriteBuffer(size_t newWriteBufferSize)
@@ -148,4 +242,105 @@ void MulticastPipe::resizeWriteBuffer(size_t newWriteBufferSize)
 	/* Ignore the request */
 	}
 
+int MulticastPipe::getCompressionLevel(void) const
+	{
+	return compressor!=0?compressor->getCompressionLevel():0;
+	}
+
+void MulticastPipe::setCompressionLevel(int newCompressionLevel)
+	{
+	if(isMaster())
+		{
+		/* Send any unsent data in the current mode: */
+		flush();
+		
+		/* Send the new compression level to the slaves: */
+		Packet* modePacket=multiplexer->newPacket();
+		{
+		Packet::Writer writer(modePacket);
+		writer.write<int>(newCompressionLevel);
+		}
+		multiplexer->sendPacket(pipeId,modePacket);
+		}
+	else
+		{
+		/* All data sent in the current mode must have been read: */
+		if(getUnreadDataSize()!=0)
+			Misc::throwStdErr("Cluster::MulticastPipe::setCompressionLevel: Unread data in pipe");
+		
+		/* Uninstall the current read buffer: */
+		setReadBuffer(0,0,false);
+		if(packet!=0)
+			{
+			multiplexer->deletePacket(packet);
+			packet=0;
+			}
+		
+		/* Receive the master's compression level: */
+		Packet* modePacket=multiplexer->receivePacket(pipeId);
+		Packet::Reader reader(modePacket);
+		newCompressionLevel=reader.read<int>();
+		multiplexer->deletePacket(modePacket);
+		}
+	
+	/* Create a new block compressor: */
+	delete compressor;
+	compressor=0;
+	if(newCompressionLevel!=0)
+		compressor=new BlockCompressor(multiplexer,pipeId,newCompressionLevel);
+	
+	if(isMaster())
+		{
+		/* Install the block buffer or the current cluster packet as the write buffer: */
+		if(compressor!=0)
+			setWriteBuffer(BlockCompressor::getBlockSize(),static_cast<Byte*>(compressor->getBlockBuffer()),false);
+		else
+			setWriteBuffer(multiplexer->getMaxPacketSize(),reinterpret_cast<Byte*>(packet->packet),false);
+		}
+	}
+
+void MulticastPipe::gatherData(const void* data,size_t dataSize,std::vector<std::vector<char> >& slaveData)
+	{
+	/* Send any unsent data: */
+	flushPipe();
+	
+	/* Pass call through to multicast pipe multiplexer: */
+	multiplexer->gatherData(pipeId,data,dataSize,slaveData);
+	}
+
+void MulticastPipe::allGather(const void* data,size_t dataSize,std::vector<std::vector<char> >& nodeData)
+	{
+	/* Collect the slaves' data on the master: */
+	std::vector<std::vector<char> > slaveData;
+	gatherData(data,dataSize,slaveData);
+	
+	nodeData.resize(getNumNodes());
+	if(isMaster())
+		{
+		/* Assemble all nodes' data: */
+		nodeData[0].assign(static_cast<const char*>(data),static_cast<const char*>(data)+dataSize);
+		for(unsigned int i=0;i<slaveData.size();++i)
+			nodeData[i+1].swap(slaveData[i]);
+		
+		/* Send all nodes' data to the slaves: */
+		for(std::vector<std::vector<char> >::iterator ndIt=nodeData.begin();ndIt!=nodeData.end();++ndIt)
+			{
+			write<Misc::UInt32>(Misc::UInt32(ndIt->size()));
+			if(!ndIt->empty())
+				writeRaw(&(*ndIt)[0],ndIt->size());
+			}
+		flush();
+		}
+	else
+		{
+		/* Receive all nodes' data from the master: */
+		for(std::vector<std::vector<char> >::iterator ndIt=nodeData.begin();ndIt!=nodeData.end();++ndIt)
+			{
+			ndIt->resize(read<Misc::UInt32>());
+			if(!ndIt->empty())
+				readRaw(&(*ndIt)[0],ndIt->size());
+			}
+		}
+	}
+
 }
@@ -25,12 +25,15 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define CLUSTER_MULTICASTPIPE_INCLUDED
 
 #include <stddef.h>
+#include <vector>
 #include <IO/File.h>
+#include <Cluster/GatherOperation.h>
 #include <Cluster/ClusterPipe.h>
 
 /* Forward declarations: */
 namespace Cluster {
 struct Packet;
+class BlockCompressor;
 }
 
 namespace Cluster {
@@ -41,6 +44,7 @@ class MulticastPipe:public IO::File,public ClusterPipe
 	private:
 	Packet* packet; // Pointer to current packet
 	size_t packetPos; // Data position in current packet
+	BlockCompressor* compressor; // Compressor for data sent in compressed mode; null in uncompressed mode
 	
 	/* Protected methods from IO::File: */
 	protected:
@@ -50,6 +54,12 @@ class MulticastPipe:public IO::File,public ClusterPipe
 	/* Protected methods from ClusterPipe: */
 	virtual void flushPipe(void);
 	
+	/* Private methods: */
+	private:
+	unsigned int gatherChildData(std::vector<std::vector<char> >& childData); // Receives the partial results of this node's children in the pipe's collective tree; returns the node index of the first child
+	static unsigned int checkChildData(const std::vector<std::vector<char> >& childData,unsigned int firstChildIndex,size_t dataSize); // Returns the index of a slave in this node's subtree that contributed the wrong amount of data to a reduction, or 0
+	void finishReduction(unsigned int badSlave,void* values,size_t dataSize); // Sends this node's partial result up the collective tree and receives the final result, or sends the final result to the slaves from the master; throws an exception on all nodes if the given slave index is not 0
+	
 	/* Constructors and destructors: */
 	public:
 	MulticastPipe(Multiplexer* sMultiplexer); // Creates new pipe for the given multiplexer
@@ -66,6 +76,8 @@ class MulticastPipe:public IO::File,public ClusterPipe
 	virtual void resizeWriteBuffer(size_t newWriteBufferSize);
 	
 	/* New methods: */
+	int getCompressionLevel(void) const; // Returns the pipe's zlib compression level, or 0 if the pipe is in uncompressed mode
+	void setCompressionLevel(int newCompressionLevel); // Switches the pipe to compressed mode using the given zlib compression level, or to uncompressed mode if level is 0; must be called at the same point in the data stream on all nodes; the slaves adopt the master's level
 	template <class DataParam>
 	void broadcast(DataParam& data) // Sends single value of arbitrary type from master to all slaves; does not change value on master
 		{
@@ -84,6 +96,40 @@ class MulticastPipe:public IO::File,public ClusterPipe
 		else
 			readRaw(data,sizeof(DataParam)*numItems);
 		}
+	void gatherData(const void* data,size_t dataSize,std::vector<std::vector<char> >& slaveData); // Sends a block of data from each slave to the master, which receives the slaves' data in the given vector in slave order; implies a barrier
+	void allGather(const void* data,size_t dataSize,std::vector<std::vector<char> >& nodeData); // Exchanges blocks of data of arbitrary sizes between all nodes; all nodes receive all nodes' data in the given vector in node order
+	template <class ValueParam>
+	void allReduce(ValueParam* values,size_t numValues,GatherOperation::OpCode op) // Combines arrays of values element-wise across all nodes using the given operation, and replaces the arrays on all nodes with the result; partial results are combined up the pipe's collective tree
+		{
+		/* Accumulate the partial results of this node's children into this node's array: */
+		std::vector<std::vector<char> > childData;
+		unsigned int firstChildIndex=gatherChildData(childData);
+		unsigned int badSlave=checkChildData(childData,firstChildIndex,sizeof(ValueParam)*numValues);
+		if(badSlave==0&&numValues>0)
+			for(std::vector<std::vector<char> >::iterator cdIt=childData.begin();cdIt!=childData.end();++cdIt)
+				GatherOperation::accumulate(op,values,reinterpret_cast<const ValueParam*>(&(*cdIt)[0]),numValues);
+		
+		/* Pass the partial result up the tree and distribute the final result: */
+		finishReduction(badSlave,values,sizeof(ValueParam)*numValues);
+		}
+	template <class ValueParam,class ReducerParam>
+	void allReduce(ValueParam* values,size_t numValues,ReducerParam& reducer) // Same, using a custom reduction functor called as reducer(accumulator,value); the reduction must be associative and commutative, as partial results are combined in tree order
+		{
+		/* Reduce the partial results of this node's children into this node's array: */
+		std::vector<std::vector<char> > childData;
+		unsigned int firstChildIndex=gatherChildData(childData);
+		unsigned int badSlave=checkChildData(childData,firstChildIndex,sizeof(ValueParam)*numValues);
+		if(badSlave==0)
+			for(std::vector<std::vector<char> >::iterator cdIt=childData.begin();cdIt!=childData.end();++cdIt)
+				{
+				const ValueParam* childValues=reinterpret_cast<const ValueParam*>(&(*cdIt)[0]);
+				for(size_t i=0;i<numValues;++i)
+					reducer(values[i],childValues[i]);
+				}
+		
+		/* Pass the partial result up the tree and distribute the final result: */
+		finishReduction(badSlave,values,sizeof(ValueParam)*numValues);
+		}
 	};
 
 }
@@ -29,9 +29,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <algorithm>
 #include <Misc/ThrowStdErr.h>
 #include <Cluster/Config.h>
 
@@ -53,6 +55,81 @@ inline bool isMulticast(const struct in_addr& netAddress) // Returns true if the
 	return address>=(0xe0<<24)&&address<(0xf0<<24);
 	}
 
+inline void xorPayload(char* dest,const char* source,size_t size) // XORs the given source payload into the given destination payload
+	{
+	for(size_t i=0;i<size;++i)
+		dest[i]^=source[i];
+	}
+
+struct in_addr getInterfaceAddress(const struct sockaddr_in& remoteAddress) // Returns the address of the local network interface used to reach the given remote address, in network byte order
+	{
+	struct in_addr result;
+	result.s_addr=htonl(INADDR_ANY);
+	
+	/* Let the kernel route a temporary UDP socket to the remote address and query the socket's local address: */
+	int fd=socket(PF_INET,SOCK_DGRAM,0);
+	if(fd>=0)
+		{
+		struct sockaddr_in localAddress;
+		socklen_t localAddressLen=sizeof(struct sockaddr_in);
+		if(connect(fd,(const struct sockaddr*)&remoteAddress,sizeof(struct sockaddr_in))==0&&getsockname(fd,(struct sockaddr*)&localAddress,&localAddressLen)==0)
+			result=localAddress.sin_addr;
+		close(fd);
+		}
+	
+	return result;
+	}
+
+inline unsigned int getNumChildren(unsigned int nodeIndex,unsigned int numSlaves,unsigned int fanout) // Returns the number of children of the given node in a collective tree of the given fanout
+	{
+	unsigned int firstChildIndex=nodeIndex*fanout+1;
+	if(firstChildIndex>numSlaves)
+		return 0;
+	unsigned int result=numSlaves+1-firstChildIndex;
+	return result<fanout?result:fanout;
+	}
+
+unsigned int combineGatherValues(GatherOperation::OpCode op,unsigned int value,const unsigned int* values,unsigned int numValues) // Combines the given value with the given array of values using the given gather operation
+	{
+	unsigned int result=value;
+	switch(op)
+		{
+		case GatherOperation::AND:
+			for(unsigned int i=0;i<numValues;++i)
+				result=result&&values[i];
+			break;
+		
+		case GatherOperation::OR:
+			for(unsigned int i=0;i<numValues;++i)
+				result=result||values[i];
+			break;
+		
+		case GatherOperation::MIN:
+			for(unsigned int i=0;i<numValues;++i)
+				if(result>values[i])
+					result=values[i];
+			break;
+		
+		case GatherOperation::MAX:
+			for(unsigned int i=0;i<numValues;++i)
+				if(result<values[i])
+					result=values[i];
+			break;
+		
+		case GatherOperation::SUM:
+			for(unsigned int i=0;i<numValues;++i)
+				result+=values[i];
+			break;
+		
+		case GatherOperation::PRODUCT:
+			for(unsigned int i=0;i<numValues;++i)
+				result*=values[i];
+			break;
+		}
+	
+	return result;
+	}
+
 }
 
 /***************************************************
@@ -120,10 +197,16 @@ Methods of class Multiplexer::PipeState:
 Multiplexer::PipeState::PipeState(unsigned int nodeIndex,unsigned int numSlaves)
 	:pipeId(0),
 	 streamPos(0),packetLossMode(false),
+	 sendBufferSize(0),
 	 headStreamPos(0),
 	 slaveStreamPosOffsets(0),numHeadSlaves(0),
 	 barrierId(0),slaveBarrierIds(0),minSlaveBarrierId(0),
-	 slaveGatherValues(0)
+	 collectiveFanout(0),parentIndex(0),firstChildIndex(0),numChildren(0),parentNumChildren(0),
+	 childBarrierIds(0),minChildBarrierId(~0U),childGatherValues(0),masterGatherValue(0),childGatherData(0),
+	 gatherDataBarrierId(0),numAckedFragments(0),
+	 parityBuffer(0),paritySize(0),parityBlockStart(0),parityNumPackets(0),parityBlockSize(0),parityValid(false),
+	 sendAckIn(nodeIndex>0?nodeIndex-1:0),
+	 incomingPackets(0)
 	 #if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 	 ,
 	 numResentPackets(0),numResentBytes(0)
@@ -139,11 +222,6 @@ Multiplexer::PipeState::PipeState(unsigned int nodeIndex,unsigned int numSlaves)
 		
 		/* Initialize the slave barrier ID array: */
 		slaveBarrierIds=new unsigned int[numSlaves];
-		for(unsigned int i=0;i<numSlaves;++i)
-			slaveBarrierIds[i]=0;
-		
-		/* Initialize the slave gather value array: */
-		slaveGatherValues=new unsigned int[numSlaves];
 		for(unsigned int i=0;i<numSlaves;++i)
 			slaveBarrierIds[i]=0;
 		}
@@ -157,12 +235,84 @@ Multiplexer::PipeState::~PipeState(void)
 	/* Destroy stream position array: */
 	delete[] slaveStreamPosOffsets;
 	
-	/* Destroy barrier ID array: */
+	/* Destroy barrier ID arrays: */
 	delete[] slaveBarrierIds;
+	delete[] childBarrierIds;
+	
+	/* Destroy child gather value array: */
+	delete[] childGatherValues;
+	
+	/* Destroy child gather data buffer array: */
+	delete[] childGatherData;
+	
+	/* Destroy the parity buffer: */
+	delete[] parityBuffer;
+	
+	/* Destroy all packets that were never handed to the pipe's delivery thread: */
+	Packet* packet=incomingPackets.get();
+	while(packet!=0)
+		{
+		Packet* succ=packet->succ;
+		delete packet;
+		packet=succ;
+		}
+	}
+	}
+
+void Multiplexer::PipeState::setTopology(unsigned int nodeIndex,unsigned int numSlaves,unsigned int newCollectiveFanout)
+	{
+	/* Arrange all nodes in a complete tree in node index order, with the master at the root: */
+	collectiveFanout=newCollectiveFanout;
+	parentIndex=nodeIndex>0?(nodeIndex-1)/collectiveFanout:0;
+	firstChildIndex=nodeIndex*collectiveFanout+1;
+	numChildren=getNumChildren(nodeIndex,numSlaves,collectiveFanout);
+	parentNumChildren=nodeIndex>0?getNumChildren(parentIndex,numSlaves,collectiveFanout):0;
+	
+	/* Initialize the child state arrays: */
+	childBarrierIds=new unsigned int[numChildren];
+	childGatherValues=new unsigned int[numChildren];
+	for(unsigned int i=0;i<numChildren;++i)
+		{
+		childBarrierIds[i]=0;
+		childGatherValues[i]=0;
+		}
+	minChildBarrierId=numChildren>0?0:~0U;
+	childGatherData=new GatherDataBuffer[numChildren];
+	}
+
+/***************************************
+Methods of class Multiplexer::PipeTable:
+***************************************/
+
+Multiplexer::PipeTable::PipeTable(const Multiplexer::PipeHasher& pipeStateTable)
+	:tableSize(16),pipeIds(0),pipeStates(0)
+	{
+	/* Keep the table at most half full to keep probe sequences short: */
+	while(tableSize<pipeStateTable.getNumEntries()*2)
+		tableSize<<=1;
+	pipeIds=new unsigned int[tableSize];
+	pipeStates=new PipeState*[tableSize];
+	for(unsigned int i=0;i<tableSize;++i)
+		{
+		pipeIds[i]=0;
+		pipeStates[i]=0;
+		}
 	
-	/* Destroy slave gather value array: */
-	delete[] slaveGatherValues;
+	/* Insert all pipes using linear probing: */
+	for(PipeHasher::ConstIterator psIt=pipeStateTable.begin();psIt!=pipeStateTable.end();++psIt)
+		{
+		unsigned int slot=psIt->getSource()&(tableSize-1);
+		while(pipeIds[slot]!=0)
+			slot=(slot+1)&(tableSize-1);
+		pipeIds[slot]=psIt->getSource();
+		pipeStates[slot]=psIt->getDest();
+		}
 	}
+
+Multiplexer::PipeTable::~PipeTable(void)
+	{
+	delete[] pipeIds;
+	delete[] pipeStates;
 	}
 
 namespace {
@@ -183,11 +333,12 @@ struct Message // Structure for protocol messages exchanged between master and s
 		ACKNOWLEDGMENT, // Signal that slave has received some stream packets
 		PACKETLOSS, // Signal that slave lost a stream packet
 		BARRIER, // Barrier message sent from slaves to master
-		GATHER // Message conveying a slave's gather value in a gather operation
+		GATHER, // Message conveying a slave's gather value in a gather operation
+		GATHERDATA // Message conveying a fragment of a slave's data in a data gather operation
 		};
 	
 	/* Elements: */
-	unsigned int nodeIndex; // Index of node that sent this message, with the MSB set if the message is from a slave to the master
+	unsigned int nodeIndex; // Index of node that sent this message, with the MSB set if the message is from a slave to the master or to its parent in a collective tree
 	int messageId; // ID of message
 	
 	/* Constructors and destructors: */
@@ -197,6 +348,27 @@ struct Message // Structure for protocol messages exchanged between master and s
 		}
 	};
 
+struct NodeAddress // Structure for the address of a slave's collective tree socket
+	{
+	/* Elements: */
+	public:
+	unsigned int address; // IP address in network byte order
+	unsigned int port; // UDP port number in network byte order
+	};
+
+struct ConnectionMessage:public Message
+	{
+	/* Elements: */
+	public:
+	NodeAddress treeAddress; // Address of the sending slave's collective tree socket
+	
+	/* Constructors and destructors: */
+	ConnectionMessage(unsigned int sNodeIndex)
+		:Message(sNodeIndex,CONNECTION)
+		{
+		}
+	};
+
 struct PipeMessage:public Message
 	{
 	/* Elements: */
@@ -216,11 +388,12 @@ struct CreatePipe1Message:public PipeMessage
 	/* Elements: */
 	public:
 	unsigned int idNumParts; // Number of partial IDs in the sending thread's global thread ID
+	unsigned int collectiveFanout; // Fanout of the new pipe's collective tree in messages from the master
 	
 	/* Constructors and destructors: */
 	CreatePipe1Message(unsigned int sNodeIndex,unsigned int sPipeId,unsigned int sIdNumParts)
 		:PipeMessage(sNodeIndex,CREATEPIPE1,sPipeId),
-		 idNumParts(sIdNumParts)
+		 idNumParts(sIdNumParts),collectiveFanout(0)
 		{
 		}
 	};
@@ -268,6 +441,53 @@ struct GatherMessage:public BarrierMessage
 		}
 	};
 
+struct GatherDataMessage:public BarrierMessage
+	{
+	/* Elements: */
+	public:
+	unsigned int dataSize; // Total size of the slave's data in a data gather operation
+	unsigned int fragmentSize; // Size of all data fragments except the last
+	unsigned int offset; // Offset of the data fragment following the message in the slave's data
+	
+	/* Constructors and destructors: */
+	GatherDataMessage(unsigned int sNodeIndex,unsigned int sPipeId,unsigned int sBarrierId,unsigned int sDataSize,unsigned int sFragmentSize,unsigned int sOffset)
+		:BarrierMessage(sNodeIndex,GATHERDATA,sPipeId,sBarrierId),
+		 dataSize(sDataSize),fragmentSize(sFragmentSize),offset(sOffset)
+		{
+		}
+	};
+
+struct GatherDataAckMessage:public BarrierMessage
+	{
+	/* Elements: */
+	public:
+	unsigned int slaveIndex; // Node index of the child whose data fragments are acknowledged
+	unsigned int numFragments; // Number of the child's data fragments received without gaps from the beginning of its data
+	
+	/* Constructors and destructors: */
+	GatherDataAckMessage(unsigned int sPipeId,unsigned int sBarrierId,unsigned int sSlaveIndex,unsigned int sNumFragments)
+		:BarrierMessage(0,GATHERDATA,sPipeId,sBarrierId),
+		 slaveIndex(sSlaveIndex),numFragments(sNumFragments)
+		{
+		}
+	};
+
+/****************
+Helper functions:
+****************/
+
+inline bool canSendNodeAddresses(unsigned int numSlaves) // Returns true if the addresses of all slaves' collective tree sockets fit into a single unfragmented connection message
+	{
+	return sizeof(Message)+size_t(numSlaves)*sizeof(NodeAddress)<=size_t(CLUSTER_CONFIG_MTU_SIZE-CLUSTER_CONFIG_IP_HEADER_SIZE-CLUSTER_CONFIG_UDP_HEADER_SIZE);
+	}
+
+inline unsigned int getTreeFanout(unsigned int collectiveFanout,unsigned int numSlaves) // Returns the fanout of a new pipe's collective tree; the master talks to all slaves directly if the slaves can't learn each other's addresses
+	{
+	if(collectiveFanout==0||collectiveFanout>=numSlaves||!canSendNodeAddresses(numSlaves))
+		return numSlaves>0?numSlaves:1;
+	return collectiveFanout>=2?collectiveFanout:2;
+	}
+
 }
 
 /****************************
@@ -279,6 +499,41 @@ Packet* Multiplexer::allocatePacket(void)
 	return new Packet;
 	}
 
+Multiplexer::PipeTable* Multiplexer::publishPipeTable(void)
+	{
+	/* Create a snapshot of the current pipe state table and swap it in: */
+	PipeTable* newPipeTable=new PipeTable(pipeStateTable);
+	PipeTable* oldPipeTable;
+	do
+		{
+		oldPipeTable=pipeTable.get();
+		}
+	while(!pipeTable.ifCompareAndSwap(oldPipeTable,newPipeTable));
+	
+	return oldPipeTable;
+	}
+
+void Multiplexer::waitForPacketHandlingThread(void)
+	{
+	/* Check if the packet handling thread is currently handling a batch of datagrams: */
+	unsigned int epoch=packetHandlingEpoch.get();
+	if(epoch&0x1U)
+		{
+		/* Wait until the batch is finished: */
+		Threads::MutexCond::Lock packetHandlingLock(packetHandlingCond);
+		while(packetHandlingEpoch.get()==epoch)
+			packetHandlingCond.wait(packetHandlingLock);
+		}
+	}
+
+void Multiplexer::endPacketHandlingBatch(void)
+	{
+	/* Mark the end of the batch and wake up any threads waiting for it: */
+	Threads::MutexCond::Lock packetHandlingLock(packetHandlingCond);
+	packetHandlingEpoch.preAdd(1);
+	packetHandlingCond.broadcast();
+	}
+
 void Multiplexer::processAcknowledgment(Multiplexer::LockedPipe& pipeState,int slaveIndex,unsigned int streamPos)
 	{
 	/* Check if the reported stream position points into the packet queue: */
@@ -356,417 +611,1008 @@ void Multiplexer::processAcknowledgment(Multiplexer::LockedPipe& pipeState,int s
 		}
 	}
 
-void* Multiplexer::packetHandlingThreadMaster(void)
+void Multiplexer::addToParity(Multiplexer::PipeState& pipeState,const Packet* packet)
 	{
-	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
-	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
+	/* XOR the packet's payload into the parity buffer: */
+	xorPayload(reinterpret_cast<char*>(pipeState.parityBuffer+4),packet->packet,packet->packetSize);
+	if(pipeState.paritySize<packet->packetSize)
+		pipeState.paritySize=packet->packetSize;
+	++pipeState.parityNumPackets;
+	pipeState.parityBlockSize+=packet->packetSize;
+	}
+
+void Multiplexer::resetParity(Multiplexer::PipeState& pipeState,unsigned int newBlockStart)
+	{
+	if(pipeState.parityBuffer==0)
+		{
+		/* Create the parity buffer on first use: */
+		pipeState.parityBuffer=new unsigned int[4+(Packet::maxPacketSize+sizeof(unsigned int)-1)/sizeof(unsigned int)];
+		memset(pipeState.parityBuffer+4,0,Packet::maxPacketSize);
+		}
+	else
+		{
+		/* Clear the used part of the parity buffer: */
+		memset(pipeState.parityBuffer+4,0,pipeState.paritySize);
+		}
+	pipeState.paritySize=0;
+	pipeState.parityBlockStart=newBlockStart;
+	pipeState.parityNumPackets=0;
+	pipeState.parityBlockSize=0;
+	pipeState.parityValid=true;
+	}
+
+void Multiplexer::sendParity(Multiplexer::PipeState& pipeState)
+	{
+	/* Fill in the parity packet's header: pipe ID with the MSB set, block start, number of packets, and block size: */
+	pipeState.parityBuffer[0]=pipeState.pipeId|0x80000000U;
+	pipeState.parityBuffer[1]=pipeState.parityBlockStart;
+	pipeState.parityBuffer[2]=pipeState.parityNumPackets;
+	pipeState.parityBuffer[3]=pipeState.parityBlockSize;
 	
-	/* Handle message exchange during multiplexer initialization: */
-	bool* slaveConnecteds=new bool[numSlaves];
-	for(unsigned int i=0;i<numSlaves;++i)
-		slaveConnecteds[i]=false;
-	unsigned int numConnectedSlaves=0;
-	while(numConnectedSlaves<numSlaves)
+	/* Send the parity packet across the UDP connection: */
+	{
+	// SocketMutex::Lock socketLock(socketMutex);
+	sendto(socketFd,pipeState.parityBuffer,pipeState.paritySize+4*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+	}
+	{
+	Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+	++statistics.numParityPacketsSent;
+	}
+	
+	/* Start the next block: */
+	resetParity(pipeState,pipeState.parityBlockStart+pipeState.parityBlockSize);
+	}
+
+void Multiplexer::deliverPacket(Multiplexer::PipeState& pipeState,Packet* packet)
+	{
+	/* Wake up sleeping receivers if the delivery queue is currently empty: */
+	if(pipeState.packetList.empty())
+		pipeState.receiveCond.signal();
+	
+	/* Append the packet to the pipe state's delivery queue: */
+	unsigned int packetPos=packet->streamPos;
+	pipeState.streamPos+=packet->packetSize;
+	pipeState.packetList.push_back(packet);
+	
+	++pipeState.sendAckIn;
+	if(pipeState.sendAckIn==numSlaves)
 		{
-		/* Wait for a connection initialization packet: */
-		ssize_t numBytesReceived=recv(socketFd,messageBuffer,Packet::maxRawPacketSize,0);
-		if(numBytesReceived==sizeof(Message))
+		/* Send positive acknowledgment of all data up to and including the packet to the master: */
+		StreamMessage msg(nodeIndex|0x80000000U,Message::ACKNOWLEDGMENT,pipeState.pipeId,pipeState.streamPos,packetPos);
+		{
+		// SocketMutex::Lock socketLock(socketMutex);
+		sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+		}
+		pipeState.sendAckIn=0;
+		}
+	}
+
+void Multiplexer::requestResend(Multiplexer::PipeState& pipeState,unsigned int packetPos)
+	{
+	/* Send negative acknowledgment to the master: */
+	StreamMessage msg(nodeIndex|0x80000000U,Message::PACKETLOSS,pipeState.pipeId,pipeState.streamPos,packetPos);
+	{
+	// SocketMutex::Lock socketLock(socketMutex);
+	for(int i=0;i<slaveMessageBurstSize;++i)
+		sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+	}
+	{
+	Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+	++statistics.numPacketLossMessages;
+	}
+	
+	/* Enable packet loss mode to prohibit sending further loss messages until the missing packet arrives: */
+	pipeState.packetLossMode=true;
+	
+	/* Discard all held-back packets; the master will resend them: */
+	while(!pipeState.heldPackets.empty())
+		deletePacket(pipeState.heldPackets.pop_front());
+	
+	/* The resent packets will not match the current parity block: */
+	pipeState.parityValid=false;
+	}
+
+void Multiplexer::processParityPacket(Multiplexer::PipeState& pipeState,const Packet* parityPacket)
+	{
+	/* Extract the parity packet's header: */
+	const unsigned int* header=reinterpret_cast<const unsigned int*>(parityPacket->packet);
+	unsigned int blockStart=parityPacket->streamPos;
+	unsigned int blockNumPackets=header[0];
+	unsigned int blockSize=header[1];
+	const char* parity=parityPacket->packet+2*sizeof(unsigned int);
+	size_t paritySize=parityPacket->packetSize-2*sizeof(unsigned int);
+	
+	/* Repair lost data only if forward error correction was already active for the parity packet's block: */
+	if(pipeState.parityBuffer!=0)
+		{
+		/* Check if the pipe is missing data from the parity packet's block; watch for stream position wrap-around: */
+		bool haveGap=!pipeState.heldPackets.empty()||pipeState.streamPos-blockStart<blockSize;
+		if(haveGap&&!pipeState.packetLossMode)
 			{
-			Message* msg=static_cast<Message*>(messageBuffer);
-			if(msg->nodeIndex&0x80000000U) // Check if the message is from a slave
+			/* Check if the gap lies inside the block, exactly one packet of the block is missing, and all others have been accumulated: */
+			unsigned int gapEnd=pipeState.heldPackets.empty()?blockStart+blockSize:pipeState.heldPackets.front()->streamPos;
+			unsigned int missingSize=gapEnd-pipeState.streamPos;
+			bool gapInBlock=pipeState.streamPos-blockStart<blockSize&&gapEnd-blockStart<=blockSize;
+			if(gapInBlock&&pipeState.parityValid&&pipeState.parityBlockStart==blockStart&&pipeState.parityNumPackets+1==blockNumPackets&&pipeState.parityBlockSize+missingSize==blockSize&&missingSize<=paritySize)
 				{
-				unsigned int slaveIndex=(msg->nodeIndex&0x7fffffffU)-1;
-				if(msg->messageId==Message::CONNECTION&&slaveIndex<numSlaves&&!slaveConnecteds[slaveIndex])
-					{
-					/* Mark the slave as connected: */
-					slaveConnecteds[slaveIndex]=true;
-					++numConnectedSlaves;
-					}
+				/* Reconstruct the missing packet from the parity packet and the accumulated payloads of all other packets: */
+				Packet* repairedPacket=newPacket();
+				repairedPacket->pipeId=pipeState.pipeId;
+				repairedPacket->streamPos=pipeState.streamPos;
+				repairedPacket->packetSize=missingSize;
+				const char* accumulated=reinterpret_cast<const char*>(pipeState.parityBuffer+4);
+				for(unsigned int i=0;i<missingSize;++i)
+					repairedPacket->packet[i]=parity[i]^accumulated[i];
+				{
+				Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+				++statistics.numRepairedPackets;
+				statistics.numPacketsReceived+=1+pipeState.heldPackets.size();
+				}
+				
+				/* Deliver the repaired packet and all held-back packets: */
+				deliverPacket(pipeState,repairedPacket);
+				while(!pipeState.heldPackets.empty())
+					deliverPacket(pipeState,pipeState.heldPackets.pop_front());
+				}
+			else
+				{
+				/* Fall back to requesting a resend from the master: */
+				requestResend(pipeState,gapEnd);
 				}
 			}
 		}
-	delete[] slaveConnecteds;
 	
-	/* Send connection message to slaves: */
-	Message msg(0,Message::CONNECTION);
+	/* Start accumulating the next block: */
+	resetParity(pipeState,blockStart+blockSize);
+	}
+
+bool Multiplexer::handleStreamPacket(Multiplexer::PipeState& pipeState,Packet* packet)
 	{
-	// SocketMutex::Lock socketLock(socketMutex);
-	for(int i=0;i<masterMessageBurstSize;++i)
-		sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+	if(packet->pipeId&0x80000000U)
+		{
+		/* It's a forward error correction parity packet: */
+		if(packet->packetSize>=2*sizeof(unsigned int))
+			processParityPacket(pipeState,packet);
+		return false;
+		}
+	
+	/* Check if forward error correction is active and the packet belongs to the current block: */
+	bool accumulate=pipeState.parityBuffer!=0&&pipeState.parityValid&&packet->streamPos-pipeState.parityBlockStart<0x80000000U;
+	
+	/* Check if the received packet is the next expected one: */
+	if(pipeState.streamPos==packet->streamPos)
+		{
+		/* Disable packet loss mode: */
+		pipeState.packetLossMode=false;
+		
+		/* Deliver the packet: */
+		if(accumulate)
+			addToParity(pipeState,packet);
+		deliverPacket(pipeState,packet);
+		size_t numDelivered=1;
+		
+		/* Deliver held-back packets that follow the packet in order, and discard those that are now outdated: */
+		while(!pipeState.heldPackets.empty())
+			{
+			Packet* held=pipeState.heldPackets.front();
+			if(held->streamPos==pipeState.streamPos)
+				{
+				deliverPacket(pipeState,pipeState.heldPackets.pop_front());
+				++numDelivered;
+				}
+			else if(pipeState.streamPos-held->streamPos<0x80000000U)
+				deletePacket(pipeState.heldPackets.pop_front());
+			else
+				break;
+			}
+		{
+		Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+		statistics.numPacketsReceived+=numDelivered;
+		}
+		
+		return true;
+		}
+	else if(!pipeState.packetLossMode&&packet->streamPos-pipeState.streamPos<=0x80000000U)
+		{
+		/* There is data missing between the packet's stream position and the pipe's stream position; check if the loss can be repaired by the next parity packet: */
+		const Packet* lastHeld=pipeState.heldPackets.back();
+		if(pipeState.parityBuffer!=0&&(lastHeld==0||lastHeld->streamPos+lastHeld->packetSize==packet->streamPos))
+			{
+			/* Hold back the packet until the parity packet arrives: */
+			if(accumulate)
+				addToParity(pipeState,packet);
+			pipeState.heldPackets.push_back(packet);
+			
+			return true;
+			}
+		else
+			{
+			/* At least one packet must have been lost; send negative acknowledgment to the master: */
+			requestResend(pipeState,packet->streamPos);
+			}
+		}
+	
+	return false;
 	}
+
+void Multiplexer::resetFlowControl(Multiplexer::PipeState& pipeState)
+	{
+	/* Reset the slaves' stream positions: */
+	pipeState.headStreamPos=pipeState.streamPos;
+	for(unsigned int i=0;i<numSlaves;++i)
+		pipeState.slaveStreamPosOffsets[i]=0;
+	pipeState.numHeadSlaves=numSlaves;
 	
-	/* Signal connection establishment: */
+	/* Add all packets in the list to the list of free packets: */
+	if(pipeState.packetList.numPackets>0)
+		{
+		{
+		Threads::Spinlock::Lock packetPoolLock(packetPoolMutex);
+		pipeState.packetList.tail->succ=packetPoolHead;
+		packetPoolHead=pipeState.packetList.head;
+		}
+		pipeState.packetList.numPackets=0;
+		pipeState.packetList.head=0;
+		pipeState.packetList.tail=0;
+		}
+	}
+
+unsigned int Multiplexer::getGatherDataWindowSize(unsigned int numSenders) const
 	{
-	Threads::MutexCond::Lock connectionCondLock(connectionCond);
-	connected=true;
-	connectionCond.broadcast();
+	/* Share the total window among all senders, but allow at least two acknowledgments per window: */
+	unsigned int result=numSenders>0?CLUSTER_CONFIG_GATHERDATA_WINDOW_SIZE/numSenders:CLUSTER_CONFIG_GATHERDATA_WINDOW_SIZE;
+	if(result<4)
+		result=4;
+	return result;
 	}
+
+void Multiplexer::sendPackets(Packet* firstPacket)
+	{
+	#if CLUSTER_CONFIG_HAVE_MMSG
 	
-	/* Handle messages from the slaves: */
-	while(true)
+	/* Send the packets in batches of datagrams: */
+	struct iovec iovecs[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	struct mmsghdr messages[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	Packet* packet=firstPacket;
+	while(packet!=0)
 		{
-		/* Wait for a message from any slave: */
-		ssize_t numBytesReceived=recv(socketFd,messageBuffer,Packet::maxRawPacketSize,0);
-		if(numBytesReceived>0&&size_t(numBytesReceived)>=sizeof(Message))
+		/* Collect the next batch of packets: */
+		int numMessages;
+		for(numMessages=0;numMessages<CLUSTER_CONFIG_IO_BATCH_SIZE&&packet!=0;++numMessages,packet=packet->succ)
+			{
+			iovecs[numMessages].iov_base=&packet->pipeId;
+			iovecs[numMessages].iov_len=packet->packetSize+2*sizeof(unsigned int);
+			memset(&messages[numMessages],0,sizeof(struct mmsghdr));
+			messages[numMessages].msg_hdr.msg_name=otherAddress;
+			messages[numMessages].msg_hdr.msg_namelen=sizeof(sockaddr_in);
+			messages[numMessages].msg_hdr.msg_iov=&iovecs[numMessages];
+			messages[numMessages].msg_hdr.msg_iovlen=1;
+			}
+		
+		/* Send the batch; sendmmsg might send fewer datagrams than requested: */
+		int numSent=0;
+		while(numSent<numMessages)
 			{
-			/* Check that the message is not the echo of a server message: */
-			if(static_cast<Message*>(messageBuffer)->nodeIndex&0x80000000U)
+			int result=sendmmsg(socketFd,messages+numSent,numMessages-numSent,0);
+			if(result>0)
+				numSent+=result;
+			else if(result==0||errno!=EINTR)
 				{
-				/* Remove the slave message indicator bit from the message's node index: */
-				unsigned int msgNodeIndex=static_cast<Message*>(messageBuffer)->nodeIndex&0x7fffffffU;
-				
-				switch(static_cast<Message*>(messageBuffer)->messageId)
-					{
-					case Message::CONNECTION:
-						{
-						/* One slave must have missed the connection establishment packet; send another one: */
-						Message msg(0,Message::CONNECTION);
-						{
-						// SocketMutex::Lock socketLock(socketMutex);
-						sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-						}
-						break;
-						}
-					
-					case Message::PING:
-						{
-						/* Broadcast a ping reply to all slaves: */
-						Message msg(0,Message::PING);
-						{
-						// SocketMutex::Lock socketLock(socketMutex);
-						sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-						}
-						break;
-						}
-					
-					case Message::CREATEPIPE1:
-						{
-						CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
-						if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
-							{
-							/* Extract the originating thread's ID from the message: */
-							Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
-							
-							/* Find the new pipe state corresponding to the thread ID: */
-							PipeState* newPipeState;
-							{
-							Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
-							NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
-							if(npIt.isFinished())
-								{
-								/* If the new pipe state hasn't been created already, do it here: */
-								newPipeState=new PipeState(nodeIndex,numSlaves);
-								
-								/* Add the new pipe state to the new pipe map: */
-								newPipes[senderId]=newPipeState;
-								}
-							else
-								newPipeState=npIt->getDest();
+				/* Skip the offending datagram; it will be resent on the next packet loss message: */
+				++numSent;
+				}
+			}
+		}
+	
+	#else
+	
+	/* Send the packets one at a time: */
+	for(Packet* packet=firstPacket;packet!=0;packet=packet->succ)
+		sendto(socketFd,&packet->pipeId,packet->packetSize+2*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+	
+	#endif
+	}
+
+int Multiplexer::receiveDatagrams(int fd,int numBuffers,void* const buffers[],size_t bufferSize,size_t datagramSizes[],bool wait)
+	{
+	#if CLUSTER_CONFIG_HAVE_MMSG
+	
+	/* Receive as many datagrams as are waiting, up to the number of buffers: */
+	if(numBuffers>CLUSTER_CONFIG_IO_BATCH_SIZE)
+		numBuffers=CLUSTER_CONFIG_IO_BATCH_SIZE;
+	struct iovec iovecs[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	struct mmsghdr messages[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	for(int i=0;i<numBuffers;++i)
+		{
+		iovecs[i].iov_base=buffers[i];
+		iovecs[i].iov_len=bufferSize;
+		memset(&messages[i],0,sizeof(struct mmsghdr));
+		messages[i].msg_hdr.msg_iov=&iovecs[i];
+		messages[i].msg_hdr.msg_iovlen=1;
+		}
+	int result=recvmmsg(fd,messages,numBuffers,wait?MSG_WAITFORONE:MSG_DONTWAIT,0);
+	for(int i=0;i<result;++i)
+		datagramSizes[i]=messages[i].msg_len;
+	return result;
+	
+	#else
+	
+	/* Receive a single datagram: */
+	ssize_t numBytesReceived=recv(fd,buffers[0],bufferSize,wait?0:MSG_DONTWAIT);
+	if(numBytesReceived<0)
+		return -1;
+	datagramSizes[0]=size_t(numBytesReceived);
+	return 1;
+	
+	#endif
+	}
+
+void Multiplexer::sendConnectionMessage(void)
+	{
+	/* Append the addresses of the slaves' collective tree sockets if they fit into a single datagram: */
+	char messageBuffer[Packet::maxRawPacketSize];
+	Message msg(0,Message::CONNECTION);
+	memcpy(messageBuffer,&msg,sizeof(Message));
+	size_t messageSize=sizeof(Message);
+	if(canSendNodeAddresses(numSlaves))
+		{
+		for(unsigned int i=1;i<=numSlaves;++i)
+			{
+			NodeAddress address;
+			address.address=nodeAddresses[i].sin_addr.s_addr;
+			address.port=nodeAddresses[i].sin_port;
+			memcpy(messageBuffer+messageSize,&address,sizeof(NodeAddress));
+			messageSize+=sizeof(NodeAddress);
+			}
+		}
+	
+	{
+	// SocketMutex::Lock socketLock(socketMutex);
+	sendto(socketFd,messageBuffer,messageSize,0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+	}
+	}
+
+void Multiplexer::sendToNode(unsigned int destNodeIndex,const void* message,size_t messageSize)
+	{
+	// SocketMutex::Lock socketLock(socketMutex);
+	sendto(socketFd,message,messageSize,0,(const sockaddr*)&nodeAddresses[destNodeIndex],sizeof(sockaddr_in));
+	}
+
+void Multiplexer::sendCompletion(Multiplexer::PipeState& pipeState,unsigned int destNodeIndex,int messageId,unsigned int barrierId)
+	{
+	/* The master multicasts completion messages to all slaves; slaves only repeat them to their children: */
+	if(messageId==Message::GATHER)
+		{
+		GatherMessage msg(0,Message::GATHER,pipeState.pipeId,barrierId,pipeState.masterGatherValue);
+		if(nodeIndex==0)
+			sendto(socketFd,&msg,sizeof(GatherMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+		else
+			sendToNode(destNodeIndex,&msg,sizeof(GatherMessage));
+		}
+	else
+		{
+		BarrierMessage msg(0,Message::BARRIER,pipeState.pipeId,barrierId);
+		if(nodeIndex==0)
+			sendto(socketFd,&msg,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+		else
+			sendToNode(destNodeIndex,&msg,sizeof(BarrierMessage));
+		}
+	}
+
+void Multiplexer::handleChildMessage(void* messageBuffer,size_t messageSize)
+	{
+	BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
+	
+	/* Check the message's size: */
+	bool valid=false;
+	switch(msg->messageId)
+		{
+		case Message::BARRIER:
+			valid=messageSize==sizeof(BarrierMessage);
+			break;
+		
+		case Message::GATHER:
+			valid=messageSize==sizeof(GatherMessage);
+			break;
+		
+		case Message::GATHERDATA:
+			if(messageSize>=sizeof(GatherDataMessage))
+				{
+				GatherDataMessage* gdMsg=static_cast<GatherDataMessage*>(messageBuffer);
+				size_t fragmentSize=messageSize-sizeof(GatherDataMessage);
+				valid=gdMsg->fragmentSize>0&&gdMsg->offset%gdMsg->fragmentSize==0&&fragmentSize<=gdMsg->fragmentSize&&size_t(gdMsg->offset)+fragmentSize<=size_t(gdMsg->dataSize);
+				}
+			break;
+		}
+	if(!valid)
+		{
+		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+		std::cerr<<"Node "<<nodeIndex<<": received malformed collective operation message of size "<<messageSize<<std::endl;
+		#endif
+		return;
+		}
+	
+	/* Remove the slave message indicator bit from the message's node index: */
+	unsigned int msgNodeIndex=msg->nodeIndex&0x7fffffffU;
+	
+	/* Get a handle on the state object of the pipe the message is meant for: */
+	LockedPipe pipeState(findPipe(msg->pipeId));
+	if(!pipeState.isValid())
+		{
+		/* Only the master knows that the pipe was closed; slaves can't tell closed pipes from pipes they have not opened yet, and the sender will ask the master directly: */
+		if(nodeIndex==0)
+			{
+			/* The sender must have missed the completion message for a pipe-closing barrier; send another one: */
+			BarrierMessage msg2(0,Message::BARRIER,msg->pipeId,msg->barrierId);
+			{
+			// SocketMutex::Lock socketLock(socketMutex);
+			sendto(socketFd,&msg2,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+			}
+			}
+		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+		else
+			std::cerr<<"Node "<<nodeIndex<<": received collective operation message for non-existent pipe "<<msg->pipeId<<std::endl;
+		#endif
+		return;
+		}
+	
+	if(pipeState->barrierId>=msg->barrierId)
+		{
+		/* The sender must have missed a completion message; send another one: */
+		sendCompletion(*pipeState,msgNodeIndex,msg->messageId==Message::GATHER?Message::GATHER:Message::BARRIER,msg->barrierId);
+		return;
+		}
+	
+	/* Ignore messages from nodes other than this node's children; they only ask the master for missed completion messages: */
+	unsigned int childIndex=msgNodeIndex-pipeState->firstChildIndex;
+	if(msgNodeIndex<pipeState->firstChildIndex||childIndex>=pipeState->numChildren)
+		return;
+	
+	bool childComplete=false;
+	switch(msg->messageId)
+		{
+		case Message::BARRIER:
+			/* The child's subtree has reached the barrier: */
+			pipeState->childBarrierIds[childIndex]=msg->barrierId;
+			childComplete=true;
+			break;
+		
+		case Message::GATHER:
+			/* Store the combined gather value of the child's subtree: */
+			pipeState->childBarrierIds[childIndex]=msg->barrierId;
+			pipeState->childGatherValues[childIndex]=static_cast<GatherMessage*>(messageBuffer)->value;
+			childComplete=true;
+			break;
+		
+		case Message::GATHERDATA:
+			{
+			GatherDataMessage* gdMsg=static_cast<GatherDataMessage*>(messageBuffer);
+			size_t fragmentSize=messageSize-sizeof(GatherDataMessage);
+			PipeState::GatherDataBuffer& gdb=pipeState->childGatherData[childIndex];
+			if(gdb.barrierId!=gdMsg->barrierId)
+				{
+				/* Prepare to receive the child's data for a new data gather operation: */
+				gdb.barrierId=gdMsg->barrierId;
+				gdb.data.resize(gdMsg->dataSize);
+				unsigned int numFragments=(gdMsg->dataSize+gdMsg->fragmentSize-1)/gdMsg->fragmentSize;
+				if(numFragments==0) // Empty data is sent as a single empty fragment
+					numFragments=1;
+				gdb.receivedFragments.assign(numFragments,false);
+				gdb.numMissingFragments=numFragments;
+				gdb.numContiguousFragments=0;
+				}
+			
+			/* Store the fragment unless it is a duplicate: */
+			unsigned int fragmentIndex=gdMsg->offset/gdMsg->fragmentSize;
+			bool sendAck;
+			if(pipeState->childBarrierIds[childIndex]<gdMsg->barrierId&&gdb.data.size()==gdMsg->dataSize&&fragmentIndex<gdb.receivedFragments.size()&&!gdb.receivedFragments[fragmentIndex])
+				{
+				if(fragmentSize>0)
+					memcpy(&gdb.data[gdMsg->offset],gdMsg+1,fragmentSize);
+				gdb.receivedFragments[fragmentIndex]=true;
+				--gdb.numMissingFragments;
+				
+				/* Acknowledge the child's fragments after every half window, and after the last fragment: */
+				unsigned int oldNumContiguousFragments=gdb.numContiguousFragments;
+				while(gdb.numContiguousFragments<gdb.receivedFragments.size()&&gdb.receivedFragments[gdb.numContiguousFragments])
+					++gdb.numContiguousFragments;
+				unsigned int ackInterval=getGatherDataWindowSize(pipeState->numChildren)/2;
+				sendAck=gdb.numContiguousFragments/ackInterval!=oldNumContiguousFragments/ackInterval||gdb.numMissingFragments==0;
+				
+				if(gdb.numMissingFragments==0)
+					{
+					/* The child's subtree data is complete: */
+					pipeState->childBarrierIds[childIndex]=gdMsg->barrierId;
+					childComplete=true;
+					}
+				}
+			else
+				{
+				/* The child must have missed an acknowledgment and resent the fragment; send another one: */
+				sendAck=true;
+				}
+			
+			if(sendAck)
+				{
+				GatherDataAckMessage msg2(gdMsg->pipeId,gdMsg->barrierId,msgNodeIndex,gdb.numContiguousFragments);
+				sendToNode(msgNodeIndex,&msg2,sizeof(GatherDataAckMessage));
+				}
+			break;
+			}
+		}
+	
+	if(childComplete)
+		{
+		/* Check if the current collective operation is complete in this node's subtree: */
+		pipeState->minChildBarrierId=pipeState->childBarrierIds[0];
+		for(unsigned int i=1;i<pipeState->numChildren;++i)
+			if(pipeState->minChildBarrierId>pipeState->childBarrierIds[i])
+				pipeState->minChildBarrierId=pipeState->childBarrierIds[i];
+		if(pipeState->minChildBarrierId>pipeState->barrierId)
+			{
+			/* Wake up thread waiting on the collective operation: */
+			pipeState->barrierCond.signal();
+			}
+		}
+	}
+
+void Multiplexer::handleParentMessage(void* messageBuffer,size_t messageSize)
+	{
+	switch(static_cast<Message*>(messageBuffer)->messageId)
+		{
+		case Message::BARRIER:
+			{
+			if(messageSize==sizeof(BarrierMessage))
+				{
+				BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
+				
+				/* Get a handle on the state object of the pipe the packet is meant for: */
+				LockedPipe pipeState(findPipe(msg->pipeId));
+				
+				if(pipeState.isValid())
+					{
+					/* Signal barrier completion if the completion message is for the current barrier: */
+					if(pipeState->barrierId<msg->barrierId)
+						{
+						pipeState->barrierId=msg->barrierId;
+						pipeState->barrierCond.signal();
+						}
+					}
+				#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+				else
+					std::cerr<<"Node "<<nodeIndex<<": received BARRIER message for non-existent pipe "<<msg->pipeId<<std::endl;
+				#endif
+				}
+			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+			else
+				std::cerr<<"Node "<<nodeIndex<<": received BARRIER message of wrong size "<<messageSize<<std::endl;
+			#endif
+			break;
+			}
+		
+		case Message::GATHER:
+			{
+			if(messageSize==sizeof(GatherMessage))
+				{
+				GatherMessage* msg=static_cast<GatherMessage*>(messageBuffer);
+				
+				/* Get a handle on the state object of the pipe the packet is meant for: */
+				LockedPipe pipeState(findPipe(msg->pipeId));
+				
+				if(pipeState.isValid())
+					{
+					/* Signal barrier completion if the completion message is for the current barrier: */
+					if(pipeState->barrierId<msg->barrierId)
+						{
+						pipeState->barrierId=msg->barrierId;
+						pipeState->masterGatherValue=msg->value;
+						pipeState->barrierCond.signal();
+						}
+					}
+				#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+				else
+					std::cerr<<"Node "<<nodeIndex<<": received GATHER message for non-existent pipe "<<msg->pipeId<<std::endl;
+				#endif
+				}
+			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+			else
+				std::cerr<<"Node "<<nodeIndex<<": received GATHER message of wrong size "<<messageSize<<std::endl;
+			#endif
+			break;
+			}
+		
+		case Message::GATHERDATA:
+			{
+			if(messageSize==sizeof(GatherDataAckMessage))
+				{
+				GatherDataAckMessage* msg=static_cast<GatherDataAckMessage*>(messageBuffer);
+				if(msg->slaveIndex==nodeIndex)
+					{
+					/* Get a handle on the state object of the pipe the packet is meant for: */
+					LockedPipe pipeState(findPipe(msg->pipeId));
+					
+					/* Update the number of acknowledged fragments if the acknowledgment is for the current data gather operation: */
+					if(pipeState.isValid()&&pipeState->gatherDataBarrierId==msg->barrierId&&pipeState->numAckedFragments<msg->numFragments)
+						{
+						pipeState->numAckedFragments=msg->numFragments;
+						pipeState->barrierCond.signal();
+						}
+					}
+				}
+			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+			else
+				std::cerr<<"Node "<<nodeIndex<<": received GATHERDATA message of wrong size "<<messageSize<<std::endl;
+			#endif
+			break;
+			}
+		}
+	}
+
+void Multiplexer::sendToParent(Multiplexer::PipeState& pipeState,const void* message,size_t messageSize)
+	{
+	/* Send the message to the parent until the master's completion message is received: */
+	unsigned int nextBarrierId=static_cast<const BarrierMessage*>(message)->barrierId;
+	Misc::Time waitTimeout=Misc::Time::now();
+	bool resend=false;
+	while(pipeState.barrierId<nextBarrierId)
+		{
+		sendToNode(pipeState.parentIndex,message,messageSize);
+		
+		/* Also ask the master on resends, in case this node missed a completion message its parent can no longer repeat: */
+		if(resend&&pipeState.parentIndex!=0)
+			sendToNode(0,message,messageSize);
+		resend=true;
+		
+		/* Wait for arrival of the completion message: */
+		waitTimeout+=barrierWaitTimeout;
+		pipeState.barrierCond.timedWait(pipeState.stateMutex,waitTimeout);
+		}
+	}
+
+void* Multiplexer::packetHandlingThreadMaster(void)
+	{
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
+	
+	/* Handle message exchange during multiplexer initialization: */
+	bool* slaveConnecteds=new bool[numSlaves];
+	for(unsigned int i=0;i<numSlaves;++i)
+		slaveConnecteds[i]=false;
+	unsigned int numConnectedSlaves=0;
+	while(numConnectedSlaves<numSlaves)
+		{
+		/* Wait for a connection initialization packet: */
+		ssize_t numBytesReceived=recv(socketFd,messageBuffers,Packet::maxRawPacketSize,0);
+		if(numBytesReceived==sizeof(ConnectionMessage))
+			{
+			ConnectionMessage* msg=static_cast<ConnectionMessage*>(messageBuffers);
+			if(msg->nodeIndex&0x80000000U) // Check if the message is from a slave
+				{
+				unsigned int slaveIndex=(msg->nodeIndex&0x7fffffffU)-1;
+				if(msg->messageId==Message::CONNECTION&&slaveIndex<numSlaves&&!slaveConnecteds[slaveIndex])
+					{
+					/* Store the address of the slave's collective tree socket: */
+					struct sockaddr_in& address=nodeAddresses[1+slaveIndex];
+					address.sin_family=AF_INET;
+					address.sin_port=msg->treeAddress.port;
+					address.sin_addr.s_addr=msg->treeAddress.address;
+					
+					/* Mark the slave as connected: */
+					slaveConnecteds[slaveIndex]=true;
+					++numConnectedSlaves;
+					}
+				}
+			}
+		}
+	delete[] slaveConnecteds;
+	
+	/* Send connection message to slaves: */
+	for(int i=0;i<masterMessageBurstSize;++i)
+		sendConnectionMessage();
+	
+	/* Signal connection establishment: */
+	{
+	Threads::MutexCond::Lock connectionCondLock(connectionCond);
+	connected=true;
+	connectionCond.broadcast();
+	}
+	
+	/* Set up the receive buffers: */
+	void* messageBufferPtrs[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	for(int i=0;i<CLUSTER_CONFIG_IO_BATCH_SIZE;++i)
+		messageBufferPtrs[i]=static_cast<unsigned char*>(messageBuffers)+i*Packet::maxRawPacketSize;
+	size_t datagramSizes[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	
+	/* Handle messages from the slaves: */
+	while(true)
+		{
+		/* Wait for a batch of messages from any slaves: */
+		int numDatagrams=receiveDatagrams(socketFd,CLUSTER_CONFIG_IO_BATCH_SIZE,messageBufferPtrs,Packet::maxRawPacketSize,datagramSizes,true);
+		
+		/* Mark the start of the batch; the pipe table must not be read before this point: */
+		packetHandlingEpoch.preAdd(1);
+		
+		/* Handle all received messages in order: */
+		for(int datagramIndex=0;datagramIndex<numDatagrams;++datagramIndex)
+			{
+			void* messageBuffer=messageBufferPtrs[datagramIndex];
+			ssize_t numBytesReceived=ssize_t(datagramSizes[datagramIndex]);
+			if(numBytesReceived>0&&size_t(numBytesReceived)>=sizeof(Message))
+				{
+				/* Check that the message is not the echo of a server message: */
+				if(static_cast<Message*>(messageBuffer)->nodeIndex&0x80000000U)
+					{
+					/* Remove the slave message indicator bit from the message's node index: */
+					unsigned int msgNodeIndex=static_cast<Message*>(messageBuffer)->nodeIndex&0x7fffffffU;
+					
+					switch(static_cast<Message*>(messageBuffer)->messageId)
+						{
+						case Message::CONNECTION:
+							{
+							/* One slave must have missed the connection establishment packet; send another one: */
+							sendConnectionMessage();
+							break;
 							}
-							
-							/* Lock the new pipe: */
-							LockedPipe pipeState(newPipeState);
-							
-							/* Check the pipe's barrier state for first-stage completion: */
-							bool sendReply=false;
-							if(pipeState->barrierId<1)
+						
+						case Message::PING:
+							{
+							/* Broadcast a ping reply to all slaves: */
+							Message msg(0,Message::PING);
+							{
+							// SocketMutex::Lock socketLock(socketMutex);
+							sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+							}
+							break;
+							}
+						
+						case Message::CREATEPIPE1:
+							{
+							CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
+							if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
 								{
-								/* Remember the slave's barrier completion: */
-								pipeState->slaveBarrierIds[msgNodeIndex-1]=1;
+								/* Extract the originating thread's ID from the message: */
+								Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
 								
-								/* Check if the current barrier is complete: */
-								pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
-								for(unsigned int i=1;i<numSlaves;++i)
-									if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
-										pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-								if(pipeState->minSlaveBarrierId>=1)
+								/* Find the new pipe state corresponding to the thread ID: */
+								PipeState* newPipeState;
+								{
+								Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
+								NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
+								if(npIt.isFinished())
 									{
-									/* Complete the first barrier: */
-									pipeState->barrierId=1;
+									/* If the new pipe state hasn't been created already, do it here: */
+									newPipeState=new PipeState(nodeIndex,numSlaves);
 									
-									/* Assign a pipe ID to the new pipe and store it in the pipe state table: */
-									Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
-									do
-										{
-										++lastPipeId;
-										if(lastPipeId==0x80000000U) // Ensure that pipeId never has the MSB set
-											lastPipeId=1;
-										}
-									while(pipeStateTable.isEntry(lastPipeId));
-									pipeState->pipeId=lastPipeId;
-									pipeStateTable[lastPipeId]=newPipeState;
-									
-									/* Wake up the thread blocked on the new pipe: */
-									pipeState->barrierCond.signal();
-									
-									/* Send a stage-one pipe creation completion message: */
-									sendReply=true;
+									/* Add the new pipe state to the new pipe map: */
+									newPipes[senderId]=newPipeState;
 									}
+								else
+									newPipeState=npIt->getDest();
 								}
-							else
-								{
-								/* One slave must have missed a stage-one pipe creation completion message; send another one: */
-								sendReply=true;
-								}
-							
-							if(sendReply)
-								{
-								CreatePipe1Message* msg2=static_cast<CreatePipe1Message*>(messageBuffer);
-								msg2->nodeIndex=0;
-								msg2->messageId=Message::CREATEPIPE1;
-								msg2->pipeId=pipeState->pipeId;
-								msg2->idNumParts=senderId.getNumParts();
-								for(unsigned int i=0;i<msg2->idNumParts;++i)
-									reinterpret_cast<unsigned int*>(msg2+1)[i]=senderId.getPart(i);
-								{
-								// SocketMutex::Lock socketLock(socketMutex);
-								sendto(socketFd,messageBuffer,sizeof(CreatePipe1Message)+msg2->idNumParts*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-								}
-								}
-							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::CREATEPIPE2:
-						{
-						if(numBytesReceived==sizeof(PipeMessage))
-							{
-							PipeMessage* msg=static_cast<PipeMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
-								{
-								/* Check the pipe's barrier state for second-stage completion: */
-								if(pipeState->barrierId<2)
+								
+								/* Lock the new pipe: */
+								LockedPipe pipeState(newPipeState);
+								
+								/* Check the pipe's barrier state for first-stage completion: */
+								bool sendReply=false;
+								if(pipeState->barrierId<1)
 									{
 									/* Remember the slave's barrier completion: */
-									pipeState->slaveBarrierIds[msgNodeIndex-1]=2;
+									pipeState->slaveBarrierIds[msgNodeIndex-1]=1;
 									
 									/* Check if the current barrier is complete: */
 									pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
 									for(unsigned int i=1;i<numSlaves;++i)
 										if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
 											pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-									if(pipeState->minSlaveBarrierId>=2)
+									if(pipeState->minSlaveBarrierId>=1)
 										{
-										/* Complete the second barrier: */
-										pipeState->barrierId=2;
-
+										/* Complete the first barrier: */
+										pipeState->barrierId=1;
+										
+										/* Arrange the nodes in the new pipe's collective tree: */
+										pipeState->setTopology(nodeIndex,numSlaves,getTreeFanout(collectiveFanout,numSlaves));
+										
+										/* Assign a pipe ID to the new pipe and store it in the pipe state table: */
+										Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
+										do
+											{
+											++lastPipeId;
+											if(lastPipeId==0x80000000U) // Ensure that pipeId never has the MSB set
+												lastPipeId=1;
+											}
+										while(pipeStateTable.isEntry(lastPipeId));
+										pipeState->pipeId=lastPipeId;
+										pipeStateTable[lastPipeId]=newPipeState;
+										
+										/* Publish the new pipe to the packet handling thread; this thread can delete the previous snapshot immediately: */
+										delete publishPipeTable();
+										
 										/* Wake up the thread blocked on the new pipe: */
 										pipeState->barrierCond.signal();
+										
+										/* Send a stage-one pipe creation completion message: */
+										sendReply=true;
 										}
 									}
+								else
+									{
+									/* One slave must have missed a stage-one pipe creation completion message; send another one: */
+									sendReply=true;
+									}
+								
+								if(sendReply)
+									{
+									CreatePipe1Message* msg2=static_cast<CreatePipe1Message*>(messageBuffer);
+									msg2->nodeIndex=0;
+									msg2->messageId=Message::CREATEPIPE1;
+									msg2->pipeId=pipeState->pipeId;
+									msg2->idNumParts=senderId.getNumParts();
+									msg2->collectiveFanout=pipeState->collectiveFanout;
+									for(unsigned int i=0;i<msg2->idNumParts;++i)
+										reinterpret_cast<unsigned int*>(msg2+1)[i]=senderId.getPart(i);
+									{
+									// SocketMutex::Lock socketLock(socketMutex);
+									sendto(socketFd,messageBuffer,sizeof(CreatePipe1Message)+msg2->idNumParts*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+									}
+									}
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message for non-existent pipe "<<msg->pipeId<<std::endl;
-							#endif
-							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::ACKNOWLEDGMENT:
-						{
-						if(numBytesReceived==sizeof(StreamMessage))
-							{
-							StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
-								{
-								/* Process the acknowledgment packet: */
-								processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
-								}
-							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-							else
-								std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::PACKETLOSS:
-						{
-						if(numBytesReceived==sizeof(StreamMessage))
+						
+						case Message::CREATEPIPE2:
 							{
-							StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(PipeMessage))
 								{
-								/* Use the stream position reported by the client as positive acknowledgment: */
-								processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
+								PipeMessage* msg=static_cast<PipeMessage*>(messageBuffer);
 								
-								/* Resend requested packets if there are any; otherwise, do nothing because master is busy: */
-								if(msg->streamPos!=pipeState->streamPos)
-									{
-									#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE
-									std::cerr<<"Packet loss of "<<msg->packetPos-msg->streamPos<<" bytes from "<<msg->streamPos<<" detected by node "<<msgNodeIndex<<", stream pos is "<<pipeState->streamPos<<", buffer starts at "<<pipeState->headStreamPos<<std::endl;
-									#endif
-									
-									/* Find the recently-sent packet starting at the slave's current stream position: */
-									Packet* packet;
-									for(packet=pipeState->packetList.front();packet!=0&&packet->streamPos!=msg->streamPos;packet=packet->succ)
-										;
-									
-									/* Signal a fatal error if the required packet has already been discarded: */
-									if(packet==0)
-										Misc::throwStdErr("Cluster::Multiplexer: Node %u: Fatal packet loss detected at stream position %u",msgNodeIndex,msg->streamPos);
-									
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(findPipe(msg->pipeId));
+								
+								if(pipeState.isValid())
 									{
-									/* Resend all recent packets in order: */
-									// SocketMutex::Lock socketLock(socketMutex);
-									for(;packet!=0;packet=packet->succ)
+									/* Check the pipe's barrier state for second-stage completion: */
+									if(pipeState->barrierId<2)
 										{
-										sendto(socketFd,&packet->pipeId,packet->packetSize+2*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-										#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-										++pipeState->numResentPackets;
-										pipeState->numResentBytes+=packet->packetSize;
-										#endif
+										/* Remember the slave's barrier completion: */
+										pipeState->slaveBarrierIds[msgNodeIndex-1]=2;
+										
+										/* Check if the current barrier is complete: */
+										pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
+										for(unsigned int i=1;i<numSlaves;++i)
+											if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
+												pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
+										if(pipeState->minSlaveBarrierId>=2)
+											{
+											/* Complete the second barrier: */
+											pipeState->barrierId=2;
+											
+											/* Wake up the thread blocked on the new pipe: */
+											pipeState->barrierCond.signal();
+											}
 										}
 									}
-									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE2 message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::BARRIER:
-						{
-						if(numBytesReceived==sizeof(BarrierMessage))
+						
+						case Message::ACKNOWLEDGMENT:
 							{
-							BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(StreamMessage))
 								{
-								/* Update the barrier ID array: */
-								if(pipeState->barrierId>=msg->barrierId)
-									{
-									/* One slave must have missed a barrier completion message; send another one: */
-									BarrierMessage msg2(0,Message::BARRIER,msg->pipeId,msg->barrierId);
+								StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(findPipe(msg->pipeId));
+								
+								if(pipeState.isValid())
 									{
-									// SocketMutex::Lock socketLock(socketMutex);
-									sendto(socketFd,&msg2,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-									}
+									/* Process the acknowledgment packet: */
+									processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
 									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 								else
-									{
-									pipeState->slaveBarrierIds[msgNodeIndex-1]=msg->barrierId;
-									
-									/* Check if the current barrier is complete: */
-									pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
-									for(unsigned int i=1;i<numSlaves;++i)
-										if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
-											pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-									if(pipeState->minSlaveBarrierId>pipeState->barrierId)
-										{
-										/* Wake up thread waiting on barrier: */
-										pipeState->barrierCond.signal();
-										}
-									}
+									std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
+							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								{
-								/* One slave must have missed the completion message for a pipe-closing barrier; send another one: */
-								BarrierMessage msg2(0,Message::BARRIER,msg->pipeId,msg->barrierId);
-								{
-								// SocketMutex::Lock socketLock(socketMutex);
-								sendto(socketFd,&msg2,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-								}
-								}
+								std::cerr<<"Node "<<nodeIndex<<": received ACKNOWLEDGMENT message of wrong size "<<numBytesReceived<<std::endl;
+							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received BARRIER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::GATHER:
-						{
-						if(numBytesReceived==sizeof(GatherMessage))
+						
+						case Message::PACKETLOSS:
 							{
-							GatherMessage* msg=static_cast<GatherMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							if(numBytesReceived==sizeof(StreamMessage))
 								{
-								/* Update the barrier ID array: */
-								if(pipeState->barrierId>=msg->barrierId)
-									{
-									/* One slave must have missed a gather completion message; send another one: */
-									GatherMessage msg2(0,Message::GATHER,msg->pipeId,msg->barrierId,pipeState->masterGatherValue);
-									{
-									// SocketMutex::Lock socketLock(socketMutex);
-									sendto(socketFd,&msg2,sizeof(GatherMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
-									}
-									}
-								else
+								StreamMessage* msg=static_cast<StreamMessage*>(messageBuffer);
+								
+								/* Get a handle on the state object of the pipe the packet is meant for: */
+								LockedPipe pipeState(findPipe(msg->pipeId));
+								
+								if(pipeState.isValid())
 									{
-									pipeState->slaveBarrierIds[msgNodeIndex-1]=msg->barrierId;
-									pipeState->slaveGatherValues[msgNodeIndex-1]=msg->value;
+									/* Use the stream position reported by the client as positive acknowledgment: */
+									processAcknowledgment(pipeState,msgNodeIndex-1,msg->streamPos);
 									
-									/* Check if the current gather operation is complete: */
-									pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[0];
-									for(unsigned int i=1;i<numSlaves;++i)
-										if(pipeState->minSlaveBarrierId>pipeState->slaveBarrierIds[i])
-											pipeState->minSlaveBarrierId=pipeState->slaveBarrierIds[i];
-									if(pipeState->minSlaveBarrierId>pipeState->barrierId)
+									/* Resend requested packets if there are any; otherwise, do nothing because master is busy: */
+									if(msg->streamPos!=pipeState->streamPos)
 										{
-										/* Wake up thread waiting on barrier: */
-										pipeState->barrierCond.signal();
+										#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE
+										std::cerr<<"Packet loss of "<<msg->packetPos-msg->streamPos<<" bytes from "<<msg->streamPos<<" detected by node "<<msgNodeIndex<<", stream pos is "<<pipeState->streamPos<<", buffer starts at "<<pipeState->headStreamPos<<std::endl;
+										#endif
+										
+										/* Find the recently-sent packet starting at the slave's current stream position: */
+										Packet* packet;
+										for(packet=pipeState->packetList.front();packet!=0&&packet->streamPos!=msg->streamPos;packet=packet->succ)
+											;
+										
+										/* Signal a fatal error if the required packet has already been discarded: */
+										if(packet==0)
+											Misc::throwStdErr("Cluster::Multiplexer: Node %u: Fatal packet loss detected at stream position %u",msgNodeIndex,msg->streamPos);
+										
+										#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+										for(Packet* pPtr=packet;pPtr!=0;pPtr=pPtr->succ)
+											{
+											++pipeState->numResentPackets;
+											pipeState->numResentBytes+=pPtr->packetSize;
+											}
+										#endif
+										{
+										Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+										for(Packet* pPtr=packet;pPtr!=0;pPtr=pPtr->succ)
+											++statistics.numResentPackets;
+										}
+										
+										{
+										/* Resend all recent packets in order: */
+										// SocketMutex::Lock socketLock(socketMutex);
+										sendPackets(packet);
+										}
 										}
 									}
+								#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+								else
+									std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message for non-existent pipe "<<msg->pipeId<<std::endl;
+								#endif
 								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received GATHER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received PACKETLOSS message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received GATHER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
+						
+						case Message::BARRIER:
+						case Message::GATHER:
+						case Message::GATHERDATA:
+							/* Handle the collective operation message sent up the pipe's collective tree: */
+							handleChildMessage(messageBuffer,size_t(numBytesReceived));
+							break;
 						}
 					}
 				}
+			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+			else
+				std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
+			#endif
 			}
-		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-		else
-			std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
-		#endif
+		
+		/* Mark the end of the batch: */
+		endPacketHandlingBatch();
 		}
 	
 	return 0;
@@ -780,15 +1626,22 @@ void* Multiplexer::packetHandlingThreadSlave(void)
 	/* Set the MSB on the nodeIndex to identify a slave-originating message: */
 	unsigned int sendNodeIndex=nodeIndex|0x80000000U;
 	
+	/* Tell the master the address of this node's collective tree socket as seen from the master: */
+	ConnectionMessage connectionMsg(sendNodeIndex);
+	struct sockaddr_in treeSocketAddress;
+	socklen_t treeSocketAddressLen=sizeof(struct sockaddr_in);
+	getsockname(treeSocketFd,(struct sockaddr*)&treeSocketAddress,&treeSocketAddressLen);
+	connectionMsg.treeAddress.address=getInterfaceAddress(*masterAddress).s_addr;
+	connectionMsg.treeAddress.port=treeSocketAddress.sin_port;
+	
 	/* Keep sending connection initiation packets to the master until connection is established: */
 	while(true)
 		{
 		/* Send connection initiation packet to master: */
-		Message msg(sendNodeIndex,Message::CONNECTION);
 		{
 		// SocketMutex::Lock socketLock(socketMutex);
 		for(int i=0;i<slaveMessageBurstSize;++i)
-			sendto(socketFd,&msg,sizeof(Message),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+			sendto(socketFd,&connectionMsg,sizeof(ConnectionMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
 		}
 		
 		/* Wait for a connection packet from the master (but don't wait for too long): */
@@ -800,21 +1653,27 @@ void* Multiplexer::packetHandlingThreadSlave(void)
 			break;
 		}
 	
-	unsigned int sendAckIn=nodeIndex-1;
+	/* Set up the receive buffers for collective operation messages from other slaves: */
+	void* messageBufferPtrs[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	for(int i=0;i<CLUSTER_CONFIG_IO_BATCH_SIZE;++i)
+		messageBufferPtrs[i]=static_cast<unsigned char*>(messageBuffers)+i*Packet::maxRawPacketSize;
+	size_t messageSizes[CLUSTER_CONFIG_IO_BATCH_SIZE];
+	int maxFd=socketFd>treeSocketFd?socketFd:treeSocketFd;
 	
-	/* Handle messages from the master: */
+	/* Handle messages from the master and from this node's parent and children in the collective trees: */
 	while(true)
 		{
 		/* Wait for the next packet, and request a ping packet if no data arrives during the timeout: */
+		fd_set readFdSet;
 		bool havePacket=false;
 		for(int i=0;i<maxPingRequests&&!havePacket;++i)
 			{
 			/* Wait until the "silence period" is over: */
-			fd_set readFdSet;
 			FD_ZERO(&readFdSet);
 			FD_SET(socketFd,&readFdSet);
+			FD_SET(treeSocketFd,&readFdSet);
 			struct timeval timeout=pingTimeout;
-			if(select(socketFd+1,&readFdSet,0,0,&timeout)>=0&&FD_ISSET(socketFd,&readFdSet))
+			if(select(maxFd+1,&readFdSet,0,0,&timeout)>0)
 				havePacket=true;
 			else
 				{
@@ -833,238 +1692,329 @@ void* Multiplexer::packetHandlingThreadSlave(void)
 			Misc::throwStdErr("Cluster::Multiplexer: Node %u: Communication error",nodeIndex);
 			}
 		
-		/* Read the waiting packet: */
-		ssize_t numBytesReceived=recv(socketFd,&slaveThreadPacket->pipeId,Packet::maxRawPacketSize,0);
-		if(numBytesReceived<0)
+		/* Mark the start of the batch; the pipe table must not be read before this point: */
+		packetHandlingEpoch.preAdd(1);
+		
+		if(FD_ISSET(treeSocketFd,&readFdSet))
 			{
-			/* Try to recover from this error: */
-			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-			std::cerr<<"Node "<<nodeIndex<<": Error "<<errno<<" on receive, slaveThreadPacket="<<slaveThreadPacket<<std::endl;
-			#endif
-			delete slaveThreadPacket;
-			slaveThreadPacket=newPacket();
+			/* Handle all waiting collective operation messages: */
+			int numMessages=receiveDatagrams(treeSocketFd,CLUSTER_CONFIG_IO_BATCH_SIZE,messageBufferPtrs,Packet::maxRawPacketSize,messageSizes,false);
+			for(int messageIndex=0;messageIndex<numMessages;++messageIndex)
+				if(messageSizes[messageIndex]>=sizeof(Message))
+					{
+					/* Check whether the message comes from a child or from the master or this node's parent: */
+					if(static_cast<Message*>(messageBufferPtrs[messageIndex])->nodeIndex&0x80000000U)
+						handleChildMessage(messageBufferPtrs[messageIndex],messageSizes[messageIndex]);
+					else
+						handleParentMessage(messageBufferPtrs[messageIndex],messageSizes[messageIndex]);
+					}
 			}
-		else if(size_t(numBytesReceived)>=2*sizeof(unsigned int))
+		
+		/* Read all waiting packets from the master: */
+		void* packetBuffers[CLUSTER_CONFIG_IO_BATCH_SIZE];
+		for(int i=0;i<CLUSTER_CONFIG_IO_BATCH_SIZE;++i)
+			packetBuffers[i]=&slaveThreadPackets[i]->pipeId;
+		size_t datagramSizes[CLUSTER_CONFIG_IO_BATCH_SIZE];
+		int numDatagrams=FD_ISSET(socketFd,&readFdSet)?receiveDatagrams(socketFd,CLUSTER_CONFIG_IO_BATCH_SIZE,packetBuffers,Packet::maxRawPacketSize,datagramSizes,false):0;
+		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+		if(numDatagrams<0)
+			std::cerr<<"Node "<<nodeIndex<<": Error "<<errno<<" on receive"<<std::endl;
+		#endif
+		
+		/* Handle all received packets in order: */
+		for(int datagramIndex=0;datagramIndex<numDatagrams;++datagramIndex)
 			{
-			slaveThreadPacket->packetSize=size_t(numBytesReceived-2*sizeof(unsigned int));
-			
-			if(slaveThreadPacket->pipeId==0)
+			Packet*& slaveThreadPacket=slaveThreadPackets[datagramIndex];
+			ssize_t numBytesReceived=ssize_t(datagramSizes[datagramIndex]);
+			if(size_t(numBytesReceived)>=2*sizeof(unsigned int))
 				{
-				/* It's a message for the pipe multiplexer itself: */
-				void* messageBuffer=&slaveThreadPacket->pipeId;
-				switch(static_cast<Message*>(messageBuffer)->messageId)
+				if(packetLossRate>0.0&&slaveThreadPacket->pipeId!=0)
 					{
-					case Message::CONNECTION:
-						/* Signal connection establishment: */
-						{
-						Threads::MutexCond::Lock connectionCondLock(connectionCond);
-						if(!connected)
-							{
-							connected=true;
-							connectionCond.broadcast();
-							}
-						}
-						break;
+					/* Advance the packet loss injector's random number generator: */
+					packetLossRandomState^=packetLossRandomState<<13;
+					packetLossRandomState^=packetLossRandomState>>17;
+					packetLossRandomState^=packetLossRandomState<<5;
 					
-					case Message::PING:
-						/* Just ignore the packet... */
-						break;
-					
-					case Message::CREATEPIPE1:
+					/* Drop the stream or parity packet to simulate an unreliable network: */
+					if(double(packetLossRandomState)<packetLossRate*4294967296.0)
 						{
-						CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
-						if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
-							{
-							{
-							Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
-							
-							/* Check if the pipe is not yet in the pipe state table: */
-							if(!pipeStateTable.isEntry(msg->pipeId))
-								{
-								/* Extract the originating thread's ID from the message: */
-								Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
-								
-								/* Find the new pipe state corresponding to the thread ID: */
-								NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
-								PipeState* newPipeState=npIt->getDest();
-								
-								/* Remove the new pipe state from the new pipe map and insert it into the pipe state table: */
-								newPipes.removeEntry(npIt);
-								pipeStateTable[msg->pipeId]=newPipeState;
-								
-								/* Signal pipe creation completion: */
-								{
-								Threads::Mutex::Lock pipeStateLock(newPipeState->stateMutex);
-								newPipeState->pipeId=msg->pipeId;
-								newPipeState->barrierId=2;
-								newPipeState->barrierCond.signal();
-								}
-								}
-							}
-							
-							/* Send a stage-two pipe creation message to the master: */
-							PipeMessage msg2(sendNodeIndex,Message::CREATEPIPE2,msg->pipeId);
-							{
-							// SocketMutex::Lock socketLock(socketMutex);
-							for(int i=0;i<slaveMessageBurstSize;++i)
-								sendto(socketFd,&msg2,sizeof(PipeMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
-							}
-							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
+						Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+						++statistics.numDroppedPackets;
+						continue;
 						}
-					
-					case Message::BARRIER:
+					}
+				
+				slaveThreadPacket->packetSize=size_t(numBytesReceived-2*sizeof(unsigned int));
+				
+				if(slaveThreadPacket->pipeId==0)
+					{
+					/* It's a message for the pipe multiplexer itself: */
+					void* messageBuffer=&slaveThreadPacket->pipeId;
+					switch(static_cast<Message*>(messageBuffer)->messageId)
 						{
-						if(numBytesReceived==sizeof(BarrierMessage))
+						case Message::CONNECTION:
+							/* Signal connection establishment: */
 							{
-							BarrierMessage* msg=static_cast<BarrierMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							Threads::MutexCond::Lock connectionCondLock(connectionCond);
+							if(!connected)
 								{
-								/* Signal barrier completion if the completion message is for the current barrier: */
-								if(pipeState->barrierId<msg->barrierId)
+								/* Store the addresses of the slaves' collective tree sockets if the master sent them: */
+								if(size_t(numBytesReceived)==sizeof(Message)+size_t(numSlaves)*sizeof(NodeAddress))
 									{
-									pipeState->barrierId=msg->barrierId;
-									pipeState->barrierCond.signal();
+									const char* addressPtr=static_cast<const char*>(messageBuffer)+sizeof(Message);
+									for(unsigned int i=1;i<=numSlaves;++i,addressPtr+=sizeof(NodeAddress))
+										{
+										NodeAddress address;
+										memcpy(&address,addressPtr,sizeof(NodeAddress));
+										nodeAddresses[i].sin_family=AF_INET;
+										nodeAddresses[i].sin_port=address.port;
+										nodeAddresses[i].sin_addr.s_addr=address.address;
+										}
 									}
+								
+								connected=true;
+								connectionCond.broadcast();
 								}
-							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-							else
-								std::cerr<<"Node "<<nodeIndex<<": received BARRIER message for non-existent pipe "<<msg->pipeId<<std::endl;
-							#endif
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received BARRIER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					
-					case Message::GATHER:
-						{
-						if(numBytesReceived==sizeof(GatherMessage))
+							break;
+						
+						case Message::PING:
+							/* Just ignore the packet... */
+							break;
+						
+						case Message::CREATEPIPE1:
 							{
-							GatherMessage* msg=static_cast<GatherMessage*>(messageBuffer);
-							
-							/* Get a handle on the state object of the pipe the packet is meant for: */
-							LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,msg->pipeId);
-							
-							if(pipeState.isValid())
+							CreatePipe1Message* msg=static_cast<CreatePipe1Message*>(messageBuffer);
+							if(size_t(numBytesReceived)>=sizeof(CreatePipe1Message)&&size_t(numBytesReceived)==sizeof(CreatePipe1Message)+msg->idNumParts*sizeof(unsigned int))
+								{
 								{
-								/* Signal barrier completion if the completion message is for the current barrier: */
-								if(pipeState->barrierId<msg->barrierId)
+								Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
+								
+								/* Check if the pipe is not yet in the pipe state table: */
+								if(!pipeStateTable.isEntry(msg->pipeId))
 									{
-									pipeState->barrierId=msg->barrierId;
-									pipeState->masterGatherValue=msg->value;
-									pipeState->barrierCond.signal();
+									/* Extract the originating thread's ID from the message: */
+									Threads::Thread::ID senderId(msg->idNumParts,reinterpret_cast<unsigned int*>(msg+1));
+									
+									/* Find the new pipe state corresponding to the thread ID: */
+									NewPipeHasher::Iterator npIt=newPipes.findEntry(senderId);
+									PipeState* newPipeState=npIt->getDest();
+									
+									/* Remove the new pipe state from the new pipe map and insert it into the pipe state table: */
+									newPipes.removeEntry(npIt);
+									pipeStateTable[msg->pipeId]=newPipeState;
+									
+									/* Publish the new pipe to the packet handling thread; this thread can delete the previous snapshot immediately: */
+									delete publishPipeTable();
+									
+									/* Signal pipe creation completion: */
+									{
+									Threads::Mutex::Lock pipeStateLock(newPipeState->stateMutex);
+									newPipeState->pipeId=msg->pipeId;
+									newPipeState->setTopology(nodeIndex,numSlaves,msg->collectiveFanout>0?msg->collectiveFanout:1);
+									newPipeState->barrierId=2;
+									newPipeState->barrierCond.signal();
+									}
 									}
 								}
+								
+								/* Send a stage-two pipe creation message to the master: */
+								PipeMessage msg2(sendNodeIndex,Message::CREATEPIPE2,msg->pipeId);
+								{
+								// SocketMutex::Lock socketLock(socketMutex);
+								for(int i=0;i<slaveMessageBurstSize;++i)
+									sendto(socketFd,&msg2,sizeof(PipeMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+								}
+								}
 							#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 							else
-								std::cerr<<"Node "<<nodeIndex<<": received GATHER message for non-existent pipe "<<msg->pipeId<<std::endl;
+								std::cerr<<"Node "<<nodeIndex<<": received CREATEPIPE1 message of wrong size "<<numBytesReceived<<std::endl;
 							#endif
+							break;
 							}
-						#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-						else
-							std::cerr<<"Node "<<nodeIndex<<": received GATHER message of wrong size "<<numBytesReceived<<std::endl;
-						#endif
-						break;
-						}
-					}
-				}
-			else
-				{
-				/* Get a handle on the state object of the pipe the packet is meant for: */
-				LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,slaveThreadPacket->pipeId);
-				
-				if(pipeState.isValid())
-					{
-					/* Check if the received packet is the next expected one: */
-					if(pipeState->streamPos==slaveThreadPacket->streamPos)
-						{
-						/* Disable packet loss mode: */
-						pipeState->packetLossMode=false;
-						
-						++sendAckIn;
-						if(sendAckIn==numSlaves)
-							{
-							/* Send positive acknowledgment to the master: */
-							StreamMessage msg(sendNodeIndex,Message::ACKNOWLEDGMENT,slaveThreadPacket->pipeId,pipeState->streamPos,slaveThreadPacket->streamPos);
-							{
-							// SocketMutex::Lock socketLock(socketMutex);
-							sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
-							}
-							sendAckIn=0;
-							}
-						
-						/* Wake up sleeping receivers if the delivery queue is currently empty: */
-						if(pipeState->packetList.empty())
-							pipeState->receiveCond.signal();
-						
-						/* Append the packet to the pipe state's delivery queue: */
-						pipeState->streamPos+=slaveThreadPacket->packetSize;
-						pipeState->packetList.push_back(slaveThreadPacket);
 						
-						/* Get a new packet: */
-						slaveThreadPacket=newPacket();
+						case Message::BARRIER:
+						case Message::GATHER:
+						case Message::GATHERDATA:
+							/* Handle the collective operation completion message from the master: */
+							handleParentMessage(messageBuffer,size_t(numBytesReceived));
+							break;
 						}
-					else
+					}
+				else
+					{
+					/* It's a stream packet or forward error correction parity packet; find the state object of the pipe it is meant for: */
+					PipeState* pipeState=findPipe(slaveThreadPacket->pipeId&0x7fffffffU);
+					
+					if(pipeState!=0)
 						{
-						/* Check if there is data missing between the packet's stream position and the pipe's stream position; watch for stream position wrap-around: */
-						if(!pipeState->packetLossMode&&slaveThreadPacket->streamPos-pipeState->streamPos<=0x80000000U)
+						if(numDeliveryThreads>0)
 							{
-							/* At least one packet must have been lost; send negative acknowledgment to the master: */
-							StreamMessage msg(sendNodeIndex,Message::PACKETLOSS,slaveThreadPacket->pipeId,pipeState->streamPos,slaveThreadPacket->streamPos);
-							{
-							// SocketMutex::Lock socketLock(socketMutex);
-							for(int i=0;i<slaveMessageBurstSize;++i)
-								sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+							/* Start the delivery threads on the first stream packet: */
+							if(deliveryThreads==0)
+								startDeliveryThreads();
+							
+							/* Push the packet onto the pipe's incoming packet stack: */
+							Packet* head;
+							do
+								{
+								head=pipeState->incomingPackets.get();
+								slaveThreadPacket->succ=head;
+								}
+							while(!pipeState->incomingPackets.ifCompareAndSwap(head,slaveThreadPacket));
+							
+							/* Hand the pipe to its delivery thread if the stack was empty: */
+							if(head==0)
+								{
+								DeliveryThread& dt=deliveryThreads[pipeState->pipeId%numDeliveryThreads];
+								Threads::Mutex::Lock readyLock(dt.mutex);
+								dt.readyPipes.push_back(pipeState);
+								dt.readyCond.signal();
+								}
+							
+							/* Get a new packet: */
+							slaveThreadPacket=newPacket();
 							}
-
-							/* Enable packet loss mode to prohibit sending further loss messages until the missing packet arrives: */
-							pipeState->packetLossMode=true;
+						else
+							{
+							/* Process the packet right here: */
+							LockedPipe lockedPipe(pipeState);
+							if(handleStreamPacket(*pipeState,slaveThreadPacket))
+								{
+								/* Get a new packet: */
+								slaveThreadPacket=newPacket();
+								}
 							}
 						}
+					#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+					else
+						std::cerr<<"Node "<<nodeIndex<<": received stream packet for non-existent pipe "<<(slaveThreadPacket->pipeId&0x7fffffffU)<<std::endl;
+					#endif
 					}
-				#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-				else
-					std::cerr<<"Node "<<nodeIndex<<": received stream packet for non-existent pipe "<<slaveThreadPacket->pipeId<<std::endl;
-				#endif
 				}
+			#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
+			else
+				std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
+			#endif
+			}
+		
+		/* Mark the end of the batch: */
+		endPacketHandlingBatch();
+		}
+	
+	return 0;
+	}
+
+void* Multiplexer::deliveryThreadMethod(Multiplexer::DeliveryThread* deliveryThread)
+	{
+	while(true)
+		{
+		/* Wait for the next pipe that has received packets: */
+		PipeState* pipeState;
+		{
+		Threads::Mutex::Lock readyLock(deliveryThread->mutex);
+		while(deliveryThread->readyPipes.empty()&&!deliveryThread->shutdown)
+			deliveryThread->readyCond.wait(deliveryThread->mutex);
+		if(deliveryThread->shutdown)
+			break;
+		pipeState=deliveryThread->readyPipes.front();
+		deliveryThread->readyPipes.pop_front();
+		deliveryThread->currentPipe=pipeState;
+		}
+		
+		/* Take all packets from the pipe's incoming packet stack; packets pushed afterwards will hand the pipe back to this thread: */
+		Packet* head;
+		do
+			{
+			head=pipeState->incomingPackets.get();
+			}
+		while(!pipeState->incomingPackets.ifCompareAndSwap(head,0));
+		
+		/* Reverse the packets into order of arrival: */
+		Packet* packets=0;
+		while(head!=0)
+			{
+			Packet* succ=head->succ;
+			head->succ=packets;
+			packets=head;
+			head=succ;
+			}
+		
+		/* Process all packets under a single lock of the pipe state: */
+		{
+		Threads::Mutex::Lock pipeStateLock(pipeState->stateMutex);
+		while(packets!=0)
+			{
+			Packet* packet=packets;
+			packets=packets->succ;
+			packet->succ=0;
+			if(!handleStreamPacket(*pipeState,packet))
+				deletePacket(packet);
 			}
-		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
-		else
-			std::cerr<<"Node "<<nodeIndex<<": received short message of size "<<numBytesReceived<<std::endl;
-		#endif
+		}
+		
+		/* Release the pipe: */
+		{
+		Threads::Mutex::Lock readyLock(deliveryThread->mutex);
+		deliveryThread->currentPipe=0;
+		deliveryThread->idleCond.broadcast();
+		}
 		}
 	
 	return 0;
 	}
 
+void Multiplexer::startDeliveryThreads(void)
+	{
+	/* Create the delivery threads as children of the calling packet handling thread, so they don't disturb the application threads' cluster-wide IDs: */
+	deliveryThreads=new DeliveryThread[numDeliveryThreads];
+	for(unsigned int i=0;i<numDeliveryThreads;++i)
+		deliveryThreads[i].thread.start(this,&Multiplexer::deliveryThreadMethod,&deliveryThreads[i]);
+	}
+
+void Multiplexer::stopDeliveryThreads(void)
+	{
+	if(deliveryThreads==0)
+		return;
+	
+	/* Signal all delivery threads to shut down and wait for them to finish: */
+	for(unsigned int i=0;i<numDeliveryThreads;++i)
+		{
+		Threads::Mutex::Lock readyLock(deliveryThreads[i].mutex);
+		deliveryThreads[i].shutdown=true;
+		deliveryThreads[i].readyCond.signal();
+		}
+	for(unsigned int i=0;i<numDeliveryThreads;++i)
+		deliveryThreads[i].thread.join();
+	delete[] deliveryThreads;
+	deliveryThreads=0;
+	}
+
 Multiplexer::Multiplexer(unsigned int sNumSlaves,unsigned int sNodeIndex,std::string masterHostName,int masterPortNumber,std::string slaveMulticastGroup,int slavePortNumber)
 	:numSlaves(sNumSlaves),nodeIndex(sNodeIndex),
 	 masterAddress(new sockaddr_in),
 	 otherAddress(new sockaddr_in),
-	 socketFd(0),
+	 socketFd(0),treeSocketFd(-1),
+	 nodeAddresses(0),
+	 collectiveFanout(CLUSTER_CONFIG_COLLECTIVE_FANOUT),
 	 connected(false),
 	 newPipes(17),
 	 lastPipeId(0),
 	 pipeStateTable(17),
-	 messageBuffer(0),
-	 slaveThreadPacket(0),
+	 pipeTable(new PipeTable(pipeStateTable)),
+	 packetHandlingEpoch(0),
+	 messageBuffers(0),
+	 slaveThreadPackets(0),
+	 numDeliveryThreads(0),deliveryThreads(0),
 	 masterMessageBurstSize(1),slaveMessageBurstSize(1),
 	 connectionWaitTimeout(0.5),
 	 pingTimeout(10.0),maxPingRequests(3),
 	 receiveWaitTimeout(0.25),
 	 barrierWaitTimeout(0.1),
 	 sendBufferSize(20),
+	 fecBlockSize(0),
+	 packetLossRate(0.0),packetLossRandomState(sNodeIndex*2654435761U+1U),
+	 mtuSize(CLUSTER_CONFIG_MTU_SIZE),
 	 packetPoolHead(0)
 	{
 	/* Lookup master's IP address: */
@@ -1098,6 +2048,13 @@ Multiplexer::Multiplexer(unsigned int sNumSlaves,unsigned int sNodeIndex,std::st
 	if(socketFd<0)
 		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Unable to create socket",nodeIndex);
 	
+	if(nodeIndex!=0&&isMulticast(slaveNetAddress))
+		{
+		/* Allow several slaves on the same host to join the slave multicast group: */
+		int reuseAddrFlag=1;
+		setsockopt(socketFd,SOL_SOCKET,SO_REUSEADDR,&reuseAddrFlag,sizeof(int));
+		}
+	
 	/* Bind the socket to the local address/port number: */
 	int localPortNumber=nodeIndex==0?masterPortNumber:slavePortNumber;
 	struct sockaddr_in socketAddress;
@@ -1143,10 +2100,10 @@ Multiplexer::Multiplexer(unsigned int sNumSlaves,unsigned int sNodeIndex,std::st
 		{
 		if(isMulticast(slaveNetAddress))
 			{
-			/* Join the slave multicast group: */
+			/* Join the slave multicast group on the network interface through which the master is reached: */
 			struct ip_mreq addGroupRequest;
 			addGroupRequest.imr_multiaddr.s_addr=htonl(slaveNetAddress.s_addr);
-			addGroupRequest.imr_interface.s_addr=htonl(INADDR_ANY);
+			addGroupRequest.imr_interface=getInterfaceAddress(*masterAddress);
 			if(setsockopt(socketFd,IPPROTO_IP,IP_ADD_MEMBERSHIP,&addGroupRequest,sizeof(struct ip_mreq))<0)
 				{
 				int myerrno=errno;
@@ -1162,15 +2119,37 @@ Multiplexer::Multiplexer(unsigned int sNumSlaves,unsigned int sNodeIndex,std::st
 		otherAddress->sin_addr.s_addr=htonl(masterNetAddress.s_addr);
 		}
 	
+	if(nodeIndex!=0)
+		{
+		/* Create a second UDP socket on an ephemeral port to receive collective operation messages from other slaves, which might share this node's host: */
+		treeSocketFd=socket(PF_INET,SOCK_DGRAM,0);
+		struct sockaddr_in treeSocketAddress;
+		treeSocketAddress.sin_family=AF_INET;
+		treeSocketAddress.sin_port=htons(0);
+		treeSocketAddress.sin_addr.s_addr=htonl(INADDR_ANY);
+		if(treeSocketFd<0||bind(treeSocketFd,(struct sockaddr*)&treeSocketAddress,sizeof(struct sockaddr_in))==-1)
+			{
+			if(treeSocketFd>=0)
+				close(treeSocketFd);
+			close(socketFd);
+			Misc::throwStdErr("Cluster::Multiplexer: Node %u: Unable to create collective tree socket",nodeIndex);
+			}
+		}
+	
+	/* Initialize the collective tree address table; the master is reached through its regular socket: */
+	nodeAddresses=new sockaddr_in[numSlaves+1];
+	memset(nodeAddresses,0,(numSlaves+1)*sizeof(sockaddr_in));
+	nodeAddresses[0]=*masterAddress;
+	
 	/* Create the packet handling thread: */
+	messageBuffers=new unsigned char[CLUSTER_CONFIG_IO_BATCH_SIZE*Packet::maxRawPacketSize];
 	if(nodeIndex==0)
-		{
-		messageBuffer=new unsigned char[Packet::maxRawPacketSize];
 		packetHandlingThread.start(this,&Multiplexer::packetHandlingThreadMaster);
-		}
 	else
 		{
-		slaveThreadPacket=newPacket();
+		slaveThreadPackets=new Packet*[CLUSTER_CONFIG_IO_BATCH_SIZE];
+		for(int i=0;i<CLUSTER_CONFIG_IO_BATCH_SIZE;++i)
+			slaveThreadPackets[i]=newPacket();
 		packetHandlingThread.start(this,&Multiplexer::packetHandlingThreadSlave);
 		}
 	}
@@ -1181,20 +2160,32 @@ Multiplexer::~Multiplexer(void)
 	packetHandlingThread.cancel();
 	packetHandlingThread.join();
 	
-	/* Delete the packet handling thread's receive packet: */
-	delete slaveThreadPacket;
-	delete[] static_cast<unsigned char*>(messageBuffer);
+	/* Stop the delivery threads: */
+	stopDeliveryThreads();
+	
+	/* Delete the packet handling thread's receive packets: */
+	if(slaveThreadPackets!=0)
+		{
+		for(int i=0;i<CLUSTER_CONFIG_IO_BATCH_SIZE;++i)
+			delete slaveThreadPackets[i];
+		delete[] slaveThreadPackets;
+		}
+	delete[] static_cast<unsigned char*>(messageBuffers);
 	
 	/* Close all leftover pipes: */
 	for(PipeHasher::Iterator psIt=pipeStateTable.begin();psIt!=pipeStateTable.end();++psIt)
 		delete psIt->getDest();
+	delete pipeTable.get();
 	
-	/* Close the UDP socket: */
+	/* Close the UDP sockets: */
 	close(socketFd);
+	if(treeSocketFd>=0)
+		close(treeSocketFd);
 	
-	/* Delete address of multicast connection's other end: */
+	/* Delete address of multicast connection's other end and the collective tree addresses: */
 	delete masterAddress;
 	delete otherAddress;
+	delete[] nodeAddresses;
 	
 	/* Delete all multicast packets in the packet pool: */
 	while(packetPoolHead!=0)
@@ -1248,6 +2239,52 @@ void Multiplexer::setSendBufferSize(unsigned int newSendBufferSize)
 	sendBufferSize=newSendBufferSize;
 	}
 
+void Multiplexer::setMTUSize(size_t newMTUSize)
+	{
+	/* Limit the MTU size to the supported range: */
+	mtuSize=newMTUSize;
+	if(mtuSize<576) // Minimum datagram size that must be supported by all IPv4 hosts
+		mtuSize=576;
+	if(mtuSize>CLUSTER_CONFIG_MAX_MTU_SIZE)
+		mtuSize=CLUSTER_CONFIG_MAX_MTU_SIZE;
+	}
+
+void Multiplexer::setFecBlockSize(unsigned int newFecBlockSize)
+	{
+	fecBlockSize=newFecBlockSize;
+	}
+
+void Multiplexer::setPacketLossRate(double newPacketLossRate)
+	{
+	packetLossRate=newPacketLossRate;
+	}
+
+void Multiplexer::setCollectiveFanout(unsigned int newCollectiveFanout)
+	{
+	collectiveFanout=newCollectiveFanout;
+	}
+
+void Multiplexer::setNumDeliveryThreads(unsigned int newNumDeliveryThreads)
+	{
+	/* Lock the pipe state table; the packet handling thread only reads the number of delivery threads after it sees a pipe published from the table: */
+	Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
+	
+	/* Check if pipes have been opened or the delivery threads have already been started: */
+	if(pipeStateTable.getNumEntries()!=0||deliveryThreads!=0)
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to change number of delivery threads after pipes have been opened",nodeIndex);
+	
+	/* The packet handling thread will start the delivery threads when they are first needed: */
+	numDeliveryThreads=newNumDeliveryThreads;
+	}
+
+void Multiplexer::getStatistics(Multiplexer::Statistics& stats,bool reset)
+	{
+	Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+	stats=statistics;
+	if(reset)
+		statistics=Statistics();
+	}
+
 void Multiplexer::waitForConnection(void)
 	{
 	{
@@ -1266,7 +2303,7 @@ unsigned int Multiplexer::openPipe(void)
 	const Threads::Thread::ID& threadId=Threads::Thread::getThreadObject()->getId();
 	
 	/* Check if the configured multicast packet size can handle the current thread's ID: */
-	if(sizeof(CreatePipe1Message)+threadId.getNumParts()*sizeof(unsigned int)>Packet::maxRawPacketSize)
+	if(sizeof(CreatePipe1Message)+threadId.getNumParts()*sizeof(unsigned int)>mtuSize-(CLUSTER_CONFIG_IP_HEADER_SIZE+CLUSTER_CONFIG_UDP_HEADER_SIZE+2*sizeof(unsigned int)))
 		Misc::throwStdErr("Cluster::Multiplexer: Threads nested too deply to open new multicast pipe");
 	
 	/* Add a new pipe state to the new pipe map: */
@@ -1332,6 +2369,7 @@ unsigned int Multiplexer::openPipe(void)
 			msg->messageId=Message::CREATEPIPE1;
 			msg->pipeId=newPipeState->pipeId;
 			msg->idNumParts=threadId.getNumParts();
+			msg->collectiveFanout=newPipeState->collectiveFanout;
 			for(unsigned int i=0;i<threadId.getNumParts();++i)
 				reinterpret_cast<unsigned int*>(msg+1)[i]=threadId.getPart(i);
 			{
@@ -1363,6 +2401,7 @@ unsigned int Multiplexer::openPipe(void)
 		msg->messageId=Message::CREATEPIPE1;
 		msg->pipeId=0;
 		msg->idNumParts=threadId.getNumParts();
+		msg->collectiveFanout=0;
 		for(unsigned int i=0;i<threadId.getNumParts();++i)
 			reinterpret_cast<unsigned int*>(msg+1)[i]=threadId.getPart(i);
 		
@@ -1394,6 +2433,7 @@ void Multiplexer::closePipe(unsigned int pipeId)
 	
 	/* Remove the pipe's state from the state table: */
 	PipeState* pipeState;
+	PipeTable* oldPipeTable;
 	{
 	Threads::Mutex::Lock pipeStateTableLock(pipeStateTableMutex);
 	PipeHasher::Iterator psIt=pipeStateTable.findEntry(pipeId);
@@ -1401,8 +2441,25 @@ void Multiplexer::closePipe(unsigned int pipeId)
 		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to close already-closed pipe",nodeIndex);
 	pipeState=psIt->getDest();
 	pipeStateTable.removeEntry(psIt);
+	oldPipeTable=publishPipeTable();
 	}
 	
+	/* Wait until the packet handling thread can no longer be using the previous pipe table or the removed pipe state: */
+	waitForPacketHandlingThread();
+	delete oldPipeTable;
+	
+	if(deliveryThreads!=0)
+		{
+		/* Wait until the pipe's delivery thread no longer services the pipe: */
+		DeliveryThread& dt=deliveryThreads[pipeId%numDeliveryThreads];
+		Threads::Mutex::Lock readyLock(dt.mutex);
+		std::deque<PipeState*>::iterator rpIt=std::find(dt.readyPipes.begin(),dt.readyPipes.end(),pipeState);
+		if(rpIt!=dt.readyPipes.end())
+			dt.readyPipes.erase(rpIt);
+		while(dt.currentPipe==pipeState)
+			dt.idleCond.wait(dt.mutex);
+		}
+	
 	#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 	if(nodeIndex==0)
 		{
@@ -1431,6 +2488,19 @@ void Multiplexer::closePipe(unsigned int pipeId)
 	delete pipeState;
 	}
 
+void Multiplexer::setPipeSendBufferSize(unsigned int pipeId,unsigned int newSendBufferSize)
+	{
+	/* Get a handle on the state object for the given pipe: */
+	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
+	if(!pipeState.isValid())
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to resize send buffer of closed pipe",nodeIndex);
+	
+	/* Set the pipe's send buffer size and wake up any senders blocking on a full send queue: */
+	pipeState->sendBufferSize=newSendBufferSize;
+	if(nodeIndex==0)
+		pipeState->receiveCond.broadcast();
+	}
+
 void Multiplexer::sendPacket(unsigned int pipeId,Packet* packet)
 	{
 	/* Get a handle on the state object for the given pipe: */
@@ -1440,11 +2510,12 @@ void Multiplexer::sendPacket(unsigned int pipeId,Packet* packet)
 	
 	/* Block if the pipe's send queue is full: */
 	#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE
-	bool amBlocking=pipeState->packetList.size()==sendBufferSize;
+	bool amBlocking=pipeState->packetList.size()>=getSendBufferSize(*pipeState);
 	if(amBlocking)
 		std::cerr<<"Pipe "<<pipeId<<": Blocking on full send buffer"<<std::endl;
 	#endif
-	while(pipeState->packetList.size()==sendBufferSize)
+	unsigned int pipeSendBufferSize=getSendBufferSize(*pipeState);
+	while(pipeState->packetList.size()>=pipeSendBufferSize)
 		pipeState->receiveCond.wait(pipeState->stateMutex);
 	
 	#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER_VERBOSE
@@ -1458,14 +2529,36 @@ void Multiplexer::sendPacket(unsigned int pipeId,Packet* packet)
 	pipeState->streamPos+=packet->packetSize;
 	pipeState->packetList.push_back(packet);
 	
-	/* It's safe to unlock the pipe state now: */
-	pipeState.unlock();
+	/* It's safe to unlock the pipe state now; the parity state is only accessed by the sending thread on the master: */
+	PipeState* ps=pipeState.unlock();
 	
 	/* Send the packet across the UDP connection: */
 	{
 	// SocketMutex::Lock socketLock(socketMutex);
 	sendto(socketFd,&packet->pipeId,packet->packetSize+2*sizeof(unsigned int),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
 	}
+	{
+	Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+	++statistics.numPacketsSent;
+	}
+	
+	if(fecBlockSize>0)
+		{
+		/* Add the packet to the current forward error correction block: */
+		if(ps->parityBuffer==0)
+			resetParity(*ps,packet->streamPos);
+		addToParity(*ps,packet);
+		
+		/* Send the block's parity packet if the block is complete; limit the block size so slaves holding back packets can't stall the send queue, but never to zero for tiny send queues: */
+		unsigned int maxBlockSize=pipeSendBufferSize/2;
+		if(maxBlockSize<2)
+			maxBlockSize=2;
+		unsigned int blockSize=fecBlockSize;
+		if(blockSize>maxBlockSize)
+			blockSize=maxBlockSize;
+		if(ps->parityNumPackets>=blockSize)
+			sendParity(*ps);
+		}
 	}
 
 Packet* Multiplexer::receivePacket(unsigned int pipeId)
@@ -1494,6 +2587,10 @@ Packet* Multiplexer::receivePacket(unsigned int pipeId)
 			for(int i=0;i<slaveMessageBurstSize;++i)
 				sendto(socketFd,&msg,sizeof(StreamMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
 			}
+			{
+			Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+			++statistics.numPacketLossMessages;
+			}
 			}
 		}
 	
@@ -1507,21 +2604,25 @@ void Multiplexer::barrier(unsigned int pipeId)
 	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
 	if(!pipeState.isValid())
 		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to synchronize closed pipe",nodeIndex);
-		
+	
 	/* Bump up barrier ID: */
 	unsigned int nextBarrierId=pipeState->barrierId+1;
 	
+	/* Send the parity packet for the current partial forward error correction block, so slaves can repair lost packets at the end of the stream: */
+	if(nodeIndex==0&&pipeState->parityNumPackets>0)
+		sendParity(*pipeState);
+	
+	/* Wait until barrier messages from all children have been received, i.e., all nodes in this node's subtree have reached the barrier: */
+	while(pipeState->minChildBarrierId<nextBarrierId)
+		{
+		/* Wait until the next barrier message: */
+		pipeState->barrierCond.wait(pipeState->stateMutex);
+		}
+	
 	if(nodeIndex==0)
 		{
-		/* Wait until barrier messages from all slaves have been received: */
-		while(pipeState->minSlaveBarrierId<nextBarrierId)
-			{
-			/* Wait until the next barrier message: */
-			pipeState->barrierCond.wait(pipeState->stateMutex);
-			}
-		
 		/* Mark the barrier as completed: */
-		pipeState->barrierId=pipeState->minSlaveBarrierId;
+		pipeState->barrierId=nextBarrierId;
 		
 		/* Send barrier completion message to all slaves: */
 		BarrierMessage msg(0,Message::BARRIER,pipeId,nextBarrierId);
@@ -1531,41 +2632,13 @@ void Multiplexer::barrier(unsigned int pipeId)
 		}
 		
 		/* Reset the pipe's flow control state: */
-		pipeState->headStreamPos=pipeState->streamPos;
-		for(unsigned int i=0;i<numSlaves;++i)
-			pipeState->slaveStreamPosOffsets[i]=0;
-		pipeState->numHeadSlaves=numSlaves;
-		
-		/* Add all packets in the list to the list of free packets: */
-		if(pipeState->packetList.numPackets>0)
-			{
-			{
-			Threads::Spinlock::Lock packetPoolLock(packetPoolMutex);
-			pipeState->packetList.tail->succ=packetPoolHead;
-			packetPoolHead=pipeState->packetList.head;
-			}
-			pipeState->packetList.numPackets=0;
-			pipeState->packetList.head=0;
-			pipeState->packetList.tail=0;
-			}
+		resetFlowControl(*pipeState);
 		}
 	else
 		{
-		/* Send barrier messages to master until barrier completion message is received: */
-		Misc::Time waitTimeout=Misc::Time::now();
-		while(pipeState->barrierId<nextBarrierId)
-			{
-			/* Send barrier message to master: */
-			BarrierMessage msg(nodeIndex|0x80000000U,Message::BARRIER,pipeId,nextBarrierId);
-			{
-			// SocketMutex::Lock socketLock(socketMutex);
-			sendto(socketFd,&msg,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
-			}
-			
-			/* Wait for arrival of barrier completion message: */
-			waitTimeout+=barrierWaitTimeout;
-			pipeState->barrierCond.timedWait(pipeState->stateMutex,waitTimeout);
-			}
+		/* Send barrier messages to the parent until barrier completion message is received: */
+		BarrierMessage msg(nodeIndex|0x80000000U,Message::BARRIER,pipeId,nextBarrierId);
+		sendToParent(*pipeState,&msg,sizeof(BarrierMessage));
 		}
 	}
 
@@ -1579,54 +2652,25 @@ unsigned int Multiplexer::gather(unsigned int pipeId,unsigned int value,GatherOp
 	/* Bump up barrier ID: */
 	unsigned int nextBarrierId=pipeState->barrierId+1;
 	
+	/* Send the parity packet for the current partial forward error correction block: */
+	if(nodeIndex==0&&pipeState->parityNumPackets>0)
+		sendParity(*pipeState);
+	
+	/* Wait until gather messages from all children have been received: */
+	while(pipeState->minChildBarrierId<nextBarrierId)
+		{
+		/* Wait until the next gather message: */
+		pipeState->barrierCond.wait(pipeState->stateMutex);
+		}
+	
+	/* Combine this node's value with the values of its children's subtrees: */
+	unsigned int subtreeValue=combineGatherValues(op,value,pipeState->childGatherValues,pipeState->numChildren);
+	
 	if(nodeIndex==0)
 		{
-		/* Wait until gather messages from all slaves have been received: */
-		while(pipeState->minSlaveBarrierId<nextBarrierId)
-			{
-			/* Wait until the next barrier message: */
-			pipeState->barrierCond.wait(pipeState->stateMutex);
-			}
-		
 		/* Mark the gathering operation as completed: */
 		pipeState->barrierId=nextBarrierId;
-		
-		/* Calculate the final gather value: */
-		pipeState->masterGatherValue=value;
-		switch(op)
-			{
-			case GatherOperation::AND:
-				for(unsigned int i=0;i<numSlaves;++i)
-					pipeState->masterGatherValue=pipeState->masterGatherValue&&pipeState->slaveGatherValues[i];
-				break;
-			
-			case GatherOperation::OR:
-				for(unsigned int i=0;i<numSlaves;++i)
-					pipeState->masterGatherValue=pipeState->masterGatherValue||pipeState->slaveGatherValues[i];
-				break;
-			
-			case GatherOperation::MIN:
-				for(unsigned int i=0;i<numSlaves;++i)
-					if(pipeState->masterGatherValue>pipeState->slaveGatherValues[i])
-						pipeState->masterGatherValue=pipeState->slaveGatherValues[i];
-				break;
-			
-			case GatherOperation::MAX:
-				for(unsigned int i=0;i<numSlaves;++i)
-					if(pipeState->masterGatherValue<pipeState->slaveGatherValues[i])
-						pipeState->masterGatherValue=pipeState->slaveGatherValues[i];
-				break;
-			
-			case GatherOperation::SUM:
-				for(unsigned int i=0;i<numSlaves;++i)
-					pipeState->masterGatherValue+=pipeState->slaveGatherValues[i];
-				break;
-			
-			case GatherOperation::PRODUCT:
-				for(unsigned int i=0;i<numSlaves;++i)
-					pipeState->masterGatherValue*=pipeState->slaveGatherValues[i];
-				break;
-			}
+		pipeState->masterGatherValue=subtreeValue;
 		
 		/* Send gather completion message to all slaves: */
 		GatherMessage msg(0,Message::GATHER,pipeId,nextBarrierId,pipeState->masterGatherValue);
@@ -1636,45 +2680,200 @@ unsigned int Multiplexer::gather(unsigned int pipeId,unsigned int value,GatherOp
 		}
 		
 		/* Reset the pipe's flow control state: */
-		pipeState->headStreamPos=pipeState->streamPos;
-		for(unsigned int i=0;i<numSlaves;++i)
-			pipeState->slaveStreamPosOffsets[i]=0;
-		pipeState->numHeadSlaves=numSlaves;
-		
-		/* Add all packets in the list to the list of free packets: */
-		if(pipeState->packetList.numPackets>0)
-			{
+		resetFlowControl(*pipeState);
+		}
+	else
+		{
+		/* Send gather messages to the parent until gather completion message is received: */
+		GatherMessage msg(nodeIndex|0x80000000U,Message::GATHER,pipeId,nextBarrierId,subtreeValue);
+		sendToParent(*pipeState,&msg,sizeof(GatherMessage));
+		}
+	
+	/* Return the master gather value: */
+	return pipeState->masterGatherValue;
+	}
+
+void Multiplexer::gatherData(unsigned int pipeId,const void* data,size_t dataSize,std::vector<std::vector<char> >& slaveData)
+	{
+	/* Receive the data of all slaves in the subtrees of this node's children: */
+	std::vector<std::vector<char> > childData;
+	gatherChildData(pipeId,childData);
+	
+	if(nodeIndex==0)
+		{
+		/* Unpack the slaves' data from the children's subtree data: */
+		slaveData.clear();
+		slaveData.resize(numSlaves);
+		for(std::vector<std::vector<char> >::iterator cdIt=childData.begin();cdIt!=childData.end();++cdIt)
 			{
-			Threads::Spinlock::Lock packetPoolLock(packetPoolMutex);
-			pipeState->packetList.tail->succ=packetPoolHead;
-			packetPoolHead=pipeState->packetList.head;
-			}
-			pipeState->packetList.numPackets=0;
-			pipeState->packetList.head=0;
-			pipeState->packetList.tail=0;
+			size_t pos=0;
+			while(pos<cdIt->size())
+				{
+				/* Read the next slave's node index and data size: */
+				unsigned int header[2];
+				if(cdIt->size()-pos<sizeof(header))
+					Misc::throwStdErr("Cluster::Multiplexer: Node %u: Received corrupted data in data gather operation",nodeIndex);
+				memcpy(header,&(*cdIt)[pos],sizeof(header));
+				pos+=sizeof(header);
+				if(header[0]<1||header[0]>numSlaves||cdIt->size()-pos<header[1])
+					Misc::throwStdErr("Cluster::Multiplexer: Node %u: Received corrupted data in data gather operation",nodeIndex);
+				
+				/* Extract the slave's data: */
+				slaveData[header[0]-1].assign(cdIt->begin()+pos,cdIt->begin()+(pos+header[1]));
+				pos+=header[1];
+				}
 			}
 		}
 	else
 		{
-		/* Send barrier messages to master until barrier completion message is received: */
-		Misc::Time waitTimeout=Misc::Time::now();
-		while(pipeState->barrierId<nextBarrierId)
+		/* Append this node's data and its children's subtree data, each slave's data preceded by its node index and size: */
+		size_t subtreeDataSize=2*sizeof(unsigned int)+dataSize;
+		for(std::vector<std::vector<char> >::iterator cdIt=childData.begin();cdIt!=childData.end();++cdIt)
+			subtreeDataSize+=cdIt->size();
+		std::vector<char> subtreeData(subtreeDataSize);
+		unsigned int header[2];
+		header[0]=nodeIndex;
+		header[1]=(unsigned int)(dataSize);
+		memcpy(&subtreeData[0],header,sizeof(header));
+		if(dataSize>0)
+			memcpy(&subtreeData[sizeof(header)],data,dataSize);
+		size_t pos=sizeof(header)+dataSize;
+		for(std::vector<std::vector<char> >::iterator cdIt=childData.begin();cdIt!=childData.end();++cdIt)
+			if(!cdIt->empty())
+				{
+				memcpy(&subtreeData[pos],&(*cdIt)[0],cdIt->size());
+				pos+=cdIt->size();
+				}
+		
+		/* Send the subtree's data to the parent: */
+		sendParentData(pipeId,&subtreeData[0],subtreeDataSize);
+		}
+	}
+
+unsigned int Multiplexer::gatherChildData(unsigned int pipeId,std::vector<std::vector<char> >& childData)
+	{
+	/* Get a handle on the state object for the given pipe: */
+	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
+	if(!pipeState.isValid())
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to gather on closed pipe",nodeIndex);
+	
+	/* Bump up barrier ID: */
+	unsigned int nextBarrierId=pipeState->barrierId+1;
+	
+	/* Send the parity packet for the current partial forward error correction block: */
+	if(nodeIndex==0&&pipeState->parityNumPackets>0)
+		sendParity(*pipeState);
+	
+	/* Wait until the data from all children has been received: */
+	while(pipeState->minChildBarrierId<nextBarrierId)
+		{
+		/* Wait until the next child's data is complete: */
+		pipeState->barrierCond.wait(pipeState->stateMutex);
+		}
+	
+	if(nodeIndex==0)
+		{
+		/* Mark the data gather operation as completed: */
+		pipeState->barrierId=nextBarrierId;
+		
+		/* Send barrier completion message to all slaves: */
+		BarrierMessage msg(0,Message::BARRIER,pipeId,nextBarrierId);
+		{
+		// SocketMutex::Lock socketLock(socketMutex);
+		sendto(socketFd,&msg,sizeof(BarrierMessage),0,(const sockaddr*)otherAddress,sizeof(sockaddr_in));
+		}
+		
+		/* Reset the pipe's flow control state: */
+		resetFlowControl(*pipeState);
+		}
+	
+	/* Hand the children's data to the caller: */
+	childData.resize(pipeState->numChildren);
+	for(unsigned int i=0;i<pipeState->numChildren;++i)
+		{
+		childData[i].clear();
+		childData[i].swap(pipeState->childGatherData[i].data);
+		}
+	
+	return pipeState->firstChildIndex;
+	}
+
+void Multiplexer::sendParentData(unsigned int pipeId,const void* data,size_t dataSize)
+	{
+	/* Get a handle on the state object for the given pipe: */
+	LockedPipe pipeState(pipeStateTable,pipeStateTableMutex,pipeId);
+	if(!pipeState.isValid())
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to gather on closed pipe",nodeIndex);
+	if(nodeIndex==0)
+		Misc::throwStdErr("Cluster::Multiplexer: Node %u: Attempt to send data from the root of a collective tree",nodeIndex);
+	
+	/* Bump up barrier ID: */
+	unsigned int nextBarrierId=pipeState->barrierId+1;
+	
+	/* Split the data into fragments that fit into single datagrams; send at least one fragment for empty data: */
+	size_t fragmentSize=mtuSize-(CLUSTER_CONFIG_IP_HEADER_SIZE+CLUSTER_CONFIG_UDP_HEADER_SIZE+sizeof(GatherDataMessage));
+	unsigned int numFragments=(unsigned int)((dataSize+fragmentSize-1)/fragmentSize);
+	if(numFragments==0)
+		numFragments=1;
+	unsigned int windowSize=getGatherDataWindowSize(pipeState->parentNumChildren);
+	char messageBuffer[Packet::maxRawPacketSize];
+	
+	/* Start a new data gather operation: */
+	pipeState->gatherDataBarrierId=nextBarrierId;
+	pipeState->numAckedFragments=0;
+	
+	/* Send data fragments to the parent in a sliding window until barrier completion message is received: */
+	unsigned int nextFragment=0;
+	Misc::Time waitTimeout=Misc::Time::now();
+	waitTimeout+=barrierWaitTimeout;
+	while(pipeState->barrierId<nextBarrierId)
+		{
+		/* Send all unsent fragments inside the window: */
+		unsigned int windowEnd=pipeState->numAckedFragments+windowSize;
+		if(windowEnd>numFragments)
+			windowEnd=numFragments;
+		if(nextFragment<pipeState->numAckedFragments)
+			nextFragment=pipeState->numAckedFragments;
+		for(;nextFragment<windowEnd;++nextFragment)
 			{
-			/* Send gather message to master: */
-			GatherMessage msg(nodeIndex|0x80000000U,Message::GATHER,pipeId,nextBarrierId,value);
+			size_t offset=size_t(nextFragment)*fragmentSize;
+			size_t sendSize=dataSize-offset;
+			if(sendSize>fragmentSize)
+				sendSize=fragmentSize;
+			GatherDataMessage msg(nodeIndex|0x80000000U,pipeId,nextBarrierId,(unsigned int)(dataSize),(unsigned int)(fragmentSize),(unsigned int)(offset));
+			memcpy(messageBuffer,&msg,sizeof(GatherDataMessage));
+			if(sendSize>0)
+				memcpy(messageBuffer+sizeof(GatherDataMessage),static_cast<const char*>(data)+offset,sendSize);
+			sendToNode(pipeState->parentIndex,messageBuffer,sizeof(GatherDataMessage)+sendSize);
+			}
+		
+		/* Wait for an acknowledgment or the barrier completion message: */
+		unsigned int numAckedFragments=pipeState->numAckedFragments;
+		if(!pipeState->barrierCond.timedWait(pipeState->stateMutex,waitTimeout)||Misc::Time::now()>=waitTimeout)
 			{
-			// SocketMutex::Lock socketLock(socketMutex);
-			sendto(socketFd,&msg,sizeof(GatherMessage),0,(const sockaddr*)otherAddress,sizeof(struct sockaddr_in));
+			/* Resend all unacknowledged fragments, or the last fragment to request another barrier completion message: */
+			nextFragment=pipeState->numAckedFragments;
+			if(nextFragment==numFragments)
+				{
+				nextFragment=numFragments-1;
+				
+				/* Also ask the master, in case this node missed a completion message its parent can no longer repeat: */
+				if(pipeState->parentIndex!=0)
+					{
+					BarrierMessage msg(nodeIndex|0x80000000U,Message::BARRIER,pipeId,nextBarrierId);
+					sendToNode(0,&msg,sizeof(BarrierMessage));
+					}
+				}
+			waitTimeout=Misc::Time::now();
+			waitTimeout+=barrierWaitTimeout;
 			}
-			
-			/* Wait for arrival of barrier completion message: */
+		else if(pipeState->numAckedFragments!=numAckedFragments)
+			{
+			/* Restart the timeout after each acknowledgment: */
+			waitTimeout=Misc::Time::now();
 			waitTimeout+=barrierWaitTimeout;
-			pipeState->barrierCond.timedWait(pipeState->stateMutex,waitTimeout);
 			}
 		}
-	
-	/* Return the master gather value: */
-	return pipeState->masterGatherValue;
 	}
 
 }
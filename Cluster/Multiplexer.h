@@ -24,6 +24,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define CLUSTER_MULTIPLEXER_INCLUDED
 
 #include <string>
+#include <vector>
+#include <deque>
 #include <Misc/HashTable.h>
 #include <Misc/Time.h>
 #include <Threads/Thread.h>
@@ -31,6 +33,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Threads/Cond.h>
 #include <Threads/MutexCond.h>
 #include <Threads/Spinlock.h>
+#include <Threads/Atomic.h>
 #include <Cluster/Config.h>
 #include <Cluster/Packet.h>
 #include <Cluster/GatherOperation.h>
@@ -81,6 +84,23 @@ class Multiplexer
 			Packet* pop_front(void); // Removes the packet at the front of the list and returns pointer to it
 			};
 		
+		struct GatherDataBuffer // Structure to receive a child's data during a data gather operation on its parent in the pipe's collective tree
+			{
+			/* Elements: */
+			public:
+			unsigned int barrierId; // ID of the data gather operation for which data is being received
+			std::vector<char> data; // The child's data
+			std::vector<bool> receivedFragments; // Flags for data fragments that have already been received
+			unsigned int numMissingFragments; // Number of data fragments that have not yet been received
+			unsigned int numContiguousFragments; // Number of data fragments received without gaps from the beginning of the data
+			
+			/* Constructors and destructors: */
+			GatherDataBuffer(void)
+				:barrierId(0),numMissingFragments(0),numContiguousFragments(0)
+				{
+				}
+			};
+		
 		/* Elements: */
 		public:
 		Threads::Mutex stateMutex; // Mutex serializing access to the pipe state
@@ -90,14 +110,34 @@ class Multiplexer
 		unsigned int streamPos; // Total amount of bytes that has been sent/received on this pipe so far
 		bool packetLossMode; // True if the pipe is currently recovering from lost data
 		PacketList packetList; // List of packets to be delivered to readers (on the slave side) or recently sent (on the master side)
+		unsigned int sendBufferSize; // Maximum number of packets held in this pipe's send queue on the master, or 0 to use the multiplexer's default
 		unsigned int headStreamPos; // Stream position currently at the head of the packet list
 		unsigned int* slaveStreamPosOffsets; // Array of stream positions of the slaves relative to beginning of packet list
 		unsigned int numHeadSlaves; // Number of slaves that still have not acknowledged the first packet in the packet list
 		unsigned int barrierId; // Unique identifier of last completed barrier in pipe
-		unsigned int* slaveBarrierIds; // Array of most recently received barrier messages from the slaves
-		unsigned int minSlaveBarrierId; // Smallest barrier ID currently in the state array
-		unsigned int* slaveGatherValues; // Array of most recently received gather values from the slaves
+		unsigned int* slaveBarrierIds; // Array of the pipe creation stages completed by the slaves on the master
+		unsigned int minSlaveBarrierId; // Smallest pipe creation stage currently in the state array
+		unsigned int collectiveFanout; // Maximum number of children of each node in the pipe's collective tree
+		unsigned int parentIndex; // Node index of this node's parent in the pipe's collective tree
+		unsigned int firstChildIndex; // Node index of this node's first child in the pipe's collective tree
+		unsigned int numChildren; // Number of this node's children in the pipe's collective tree
+		unsigned int parentNumChildren; // Number of children of this node's parent, which share the parent's data gather window
+		unsigned int* childBarrierIds; // Array of the most recent collective operations completed by the subtrees of this node's children
+		unsigned int minChildBarrierId; // Smallest collective operation ID currently in the child array; ~0 on leaf nodes
+		unsigned int* childGatherValues; // Array of the combined gather values of the subtrees of this node's children
 		unsigned int masterGatherValue; // Final value of last completed gather operation in pipe
+		GatherDataBuffer* childGatherData; // Array of buffers receiving the children's data in the current data gather operation
+		unsigned int gatherDataBarrierId; // ID of the data gather operation in which a slave is currently sending data to its parent
+		unsigned int numAckedFragments; // Number of a slave's data fragments acknowledged by its parent in the current data gather operation
+		unsigned int* parityBuffer; // Parity datagram for the pipe's current forward error correction block; header words followed by the XOR of all accumulated packet payloads
+		size_t paritySize; // Size of the largest packet payload accumulated into the parity buffer
+		unsigned int parityBlockStart; // Stream position of the first packet in the current forward error correction block
+		unsigned int parityNumPackets; // Number of packets accumulated into the parity buffer
+		unsigned int parityBlockSize; // Total payload size of all packets accumulated into the parity buffer
+		bool parityValid; // Flag whether the parity buffer on a slave contains exactly the packets received since the start of the current block
+		PacketList heldPackets; // List of packets received after a single gap on a slave, held back while waiting for the parity packet to repair the gap
+		unsigned int sendAckIn; // Number of packets a slave still has to receive on this pipe before sending the next positive acknowledgment
+		Threads::Atomic<Packet*> incomingPackets; // Lock-free stack of packets handed from a slave's packet handling thread to the pipe's delivery thread, in reverse order of arrival
 		#if CLUSTER_CONFIG_DEBUG_MULTIPLEXER
 		size_t numResentPackets;
 		size_t numResentBytes;
@@ -106,11 +146,55 @@ class Multiplexer
 		/* Constructors and destructors: */
 		PipeState(unsigned int nodeIndex,unsigned int numSlaves); // Creates empty pipe state
 		~PipeState(void); // Destroys a pipe state and all buffers in its delivery queue
+		
+		/* Methods: */
+		void setTopology(unsigned int nodeIndex,unsigned int numSlaves,unsigned int newCollectiveFanout); // Places the given node in a tree of the given fanout over all nodes for the pipe's collective operations
 		};
 	
 	typedef Misc::HashTable<Threads::Thread::ID,PipeState*,Threads::Thread::ID> NewPipeHasher; // Hash table to map from thread IDs to pipe state table entries during pipe creation
 	typedef Misc::HashTable<unsigned int,PipeState*> PipeHasher; // Hash table to map from pipe IDs to pipe state table entries
 	
+	struct PipeTable // Structure for immutable snapshots of the pipe state table, read by the packet handling thread without locking
+		{
+		/* Elements: */
+		public:
+		unsigned int tableSize; // Number of slots in the open-addressing hash table; always a power of two
+		unsigned int* pipeIds; // Array of pipe IDs stored in the table's slots; 0 marks an empty slot
+		PipeState** pipeStates; // Array of pipe states stored in the table's slots
+		
+		/* Constructors and destructors: */
+		PipeTable(const PipeHasher& pipeStateTable); // Creates a snapshot of the given pipe state table
+		~PipeTable(void);
+		
+		/* Methods: */
+		PipeState* find(unsigned int pipeId) const // Returns the state of the pipe of the given ID, or null if the pipe does not exist
+			{
+			for(unsigned int slot=pipeId&(tableSize-1);pipeIds[slot]!=0;slot=(slot+1)&(tableSize-1))
+				if(pipeIds[slot]==pipeId)
+					return pipeStates[slot];
+			return 0;
+			}
+		};
+	
+	struct DeliveryThread // Structure for threads delivering stream packets to the pipes assigned to them on a slave node
+		{
+		/* Elements: */
+		public:
+		Threads::Mutex mutex; // Mutex serializing access to the delivery thread's state
+		Threads::Cond readyCond; // Condition variable signaled when a pipe has received packets, or when the delivery thread is shut down
+		Threads::Cond idleCond; // Condition variable signaled when the delivery thread finishes servicing a pipe
+		std::deque<PipeState*> readyPipes; // Queue of pipes that have received packets since they were last serviced
+		PipeState* currentPipe; // Pipe currently serviced by the delivery thread, or null
+		bool shutdown; // Flag to shut down the delivery thread
+		Threads::Thread thread; // The delivery thread
+		
+		/* Constructors and destructors: */
+		DeliveryThread(void)
+			:currentPipe(0),shutdown(false)
+			{
+			}
+		};
+	
 	class LockedPipe // Helper class to obtain locks on pipe state objects retrieved by pipe ID
 		{
 		/* Elements: */
@@ -119,11 +203,12 @@ class Multiplexer
 		
 		/* Constructors and destructors: */
 		public:
-		LockedPipe(PipeState* sPipeState) // Locks the given pipe state
+		LockedPipe(PipeState* sPipeState) // Locks the given pipe state, if it is valid
 			:pipeState(sPipeState)
 			{
 			/* Lock the pipe state: */
-			pipeState->stateMutex.lock();
+			if(pipeState!=0)
+				pipeState->stateMutex.lock();
 			}
 		LockedPipe(const PipeHasher& pipeStateTable,Threads::Mutex& pipeStateTableMutex,unsigned int pipeId) // Grabs and locks the pipe of the given ID, if it exists
 			:pipeState(0)
@@ -175,6 +260,27 @@ class Multiplexer
 	
 	typedef Threads::Spinlock SocketMutex; // Type of mutex to serialize write access to the UDP socket
 	
+	public:
+	struct Statistics // Structure counting stream packets sent, lost, repaired, and resent by a multiplexer
+		{
+		/* Elements: */
+		public:
+		size_t numPacketsSent; // Number of stream packets sent by the master
+		size_t numParityPacketsSent; // Number of forward error correction parity packets sent by the master
+		size_t numResentPackets; // Number of stream packets resent by the master in response to packet loss messages
+		size_t numPacketsReceived; // Number of stream packets received in order by a slave
+		size_t numDroppedPackets; // Number of stream and parity packets discarded by a slave's packet loss injector
+		size_t numRepairedPackets; // Number of lost stream packets reconstructed by a slave from parity packets
+		size_t numPacketLossMessages; // Number of packet loss messages sent by a slave
+		
+		/* Constructors and destructors: */
+		Statistics(void) // Creates zeroed statistics
+			:numPacketsSent(0),numParityPacketsSent(0),numResentPackets(0),
+			 numPacketsReceived(0),numDroppedPackets(0),numRepairedPackets(0),numPacketLossMessages(0)
+			{
+			}
+		};
+	
 	/* Elements: */
 	private:
 	unsigned int numSlaves; // Number of slaves in the multicast group
@@ -183,15 +289,23 @@ class Multiplexer
 	struct sockaddr_in* otherAddress; // Pointer to socket address of other end of multicast connection
 	SocketMutex socketMutex; // Mutex serializing (write) access to the UDP socket
 	int socketFd; // File descriptor for the UDP socket
+	int treeSocketFd; // File descriptor for the UDP socket receiving collective operation messages from other slaves on a slave node; -1 on the master
+	struct sockaddr_in* nodeAddresses; // Array of socket addresses to send collective operation messages to each node; entries of slaves are the addresses of their collective tree sockets
+	unsigned int collectiveFanout; // Maximum number of children of each node in the collective trees of pipes opened by the master
 	bool connected; // Flag to indicate whether connection between master and all slaves has been established
 	Threads::MutexCond connectionCond; // Condition variable to wait on for connection establishment
 	Threads::Mutex pipeStateTableMutex; // Mutex serializing access to the the pipe state table
 	NewPipeHasher newPipes; // Hash table to map from thread IDs to pipe states not completely opened yet
 	unsigned int lastPipeId; // ID of the most-recently created pipe
 	PipeHasher pipeStateTable; // Hash table to map from pipe IDs to pipe state table entries
-	void* messageBuffer; // A buffer to receive message packets on the master node
+	Threads::Atomic<PipeTable*> pipeTable; // Snapshot of the pipe state table used by the packet handling thread
+	Threads::Atomic<unsigned int> packetHandlingEpoch; // Counter incremented by the packet handling thread before and after handling each batch of datagrams; odd while a batch is being handled
+	Threads::MutexCond packetHandlingCond; // Condition variable signalled when the packet handling thread finishes a batch of datagrams
+	void* messageBuffers; // Buffers to receive a batch of message packets on the master node, or a batch of collective operation messages on a slave node
 	Threads::Thread packetHandlingThread; // Packet handling thread
-	Packet* slaveThreadPacket; // Pointer to the one packet always held by the packet handling thread on slave nodes
+	Packet** slaveThreadPackets; // Array of packets always held by the packet handling thread on slave nodes to receive a batch of packets
+	unsigned int numDeliveryThreads; // Number of threads delivering stream packets to pipes on a slave node; 0 if packets are delivered by the packet handling thread
+	DeliveryThread* deliveryThreads; // Array of delivery threads on a slave node; null until the first stream packet is handed to a delivery thread
 	int masterMessageBurstSize; // Number of server messages sent in a single burst
 	int slaveMessageBurstSize; // Number of client messages sent in a single burst
 	Misc::Time connectionWaitTimeout; // Timeout between connection messages from the slaves
@@ -200,14 +314,51 @@ class Multiplexer
 	Misc::Time receiveWaitTimeout; // Timeout between packet loss messages from the slaves
 	Misc::Time barrierWaitTimeout; // Timeout between barrier messages from the slaves
 	unsigned int sendBufferSize; // Maximum number of packets buffered for each pipe
+	unsigned int fecBlockSize; // Number of stream packets covered by each forward error correction parity packet; 0 disables forward error correction
+	double packetLossRate; // Probability with which a slave drops incoming stream and parity packets to simulate an unreliable network
+	unsigned int packetLossRandomState; // State of the random number generator driving the packet loss injector
+	Threads::Spinlock statisticsMutex; // Mutex protecting the packet statistics
+	Statistics statistics; // Packet statistics accumulated since the last reset
+	size_t mtuSize; // Maximum transmission unit of the network connecting the cluster nodes, including IP and UDP headers
 	Threads::Spinlock packetPoolMutex; // Mutex protecting the free packet pool
 	Packet* packetPoolHead; // Pool of recently deleted packets to minimize number of new/delete calls
 	
 	/* Private methods: */
 	Packet* allocatePacket(void);
+	PipeTable* publishPipeTable(void); // Replaces the packet handling thread's pipe table with a snapshot of the current pipe state table; must be called with the pipe state table mutex locked; returns the previous snapshot
+	PipeState* findPipe(unsigned int pipeId) // Returns the state of the pipe of the given ID from the packet handling thread's pipe table without locking, or null; must only be called from the packet handling thread
+		{
+		return pipeTable.get()->find(pipeId);
+		}
+	void waitForPacketHandlingThread(void); // Waits until the packet handling thread has finished handling its current batch of datagrams
+	void endPacketHandlingBatch(void); // Called by the packet handling thread after handling a batch of datagrams
 	void processAcknowledgment(LockedPipe& pipeState,int slaveIndex,unsigned int streamPos); // Processes an acknowlegment (positive or implied-positive) from a slave
+	void addToParity(PipeState& pipeState,const Packet* packet); // Accumulates the given packet's payload into the pipe's parity buffer
+	void resetParity(PipeState& pipeState,unsigned int newBlockStart); // Starts a new forward error correction block at the given stream position
+	void sendParity(PipeState& pipeState); // Sends the pipe's current parity packet to the slaves and starts a new block
+	void deliverPacket(PipeState& pipeState,Packet* packet); // Appends an in-order packet to a slave pipe's delivery queue and acknowledges it if it is the slave's turn
+	void requestResend(PipeState& pipeState,unsigned int packetPos); // Sends a packet loss message from a slave and puts the pipe into packet loss mode
+	void processParityPacket(PipeState& pipeState,const Packet* parityPacket); // Repairs a single lost packet on a slave using the given parity packet, or requests a resend
+	bool handleStreamPacket(PipeState& pipeState,Packet* packet); // Processes a stream or parity packet received by a slave for the given locked pipe; returns true if the pipe retained the packet
+	void resetFlowControl(PipeState& pipeState); // Resets a pipe's flow control state on the master after a completed barrier
+	unsigned int getSendBufferSize(const PipeState& pipeState) const // Returns the maximum number of packets held in the given pipe's send queue
+		{
+		return pipeState.sendBufferSize!=0?pipeState.sendBufferSize:sendBufferSize;
+		}
+	unsigned int getGatherDataWindowSize(unsigned int numSenders) const; // Returns the number of data fragments each of the given number of nodes can send ahead of their common parent's acknowledgments in data gather operations
+	void sendConnectionMessage(void); // Sends a connection establishment message to the slaves, including the slaves' collective tree socket addresses if they fit into a single datagram
+	void sendToNode(unsigned int destNodeIndex,const void* message,size_t messageSize); // Sends a collective operation message to the given node
+	void sendCompletion(PipeState& pipeState,unsigned int destNodeIndex,int messageId,unsigned int barrierId); // Resends the completion message of the given completed collective operation to the given child, or to all slaves from the master
+	void handleChildMessage(void* messageBuffer,size_t messageSize); // Handles a collective operation message sent up the collective tree by a child
+	void handleParentMessage(void* messageBuffer,size_t messageSize); // Handles a collective operation completion or acknowledgment message on a slave
+	void sendToParent(PipeState& pipeState,const void* message,size_t messageSize); // Sends a collective operation message from a slave to its parent until the operation is completed
+	void sendPackets(Packet* firstPacket); // Sends the given packet and all its successors to the other end of the connection using as few system calls as possible
+	int receiveDatagrams(int fd,int numBuffers,void* const buffers[],size_t bufferSize,size_t datagramSizes[],bool wait); // Receives up to the given number of datagrams from the given socket into the given buffers; waits for the first datagram if flag is true; returns number of received datagrams, or -1 on error
 	void* packetHandlingThreadMaster(void); // Packet handling thread method for the master
 	void* packetHandlingThreadSlave(void); // Packet handling thread method for the slaves
+	void* deliveryThreadMethod(DeliveryThread* deliveryThread); // Delivery thread method for the slaves
+	void startDeliveryThreads(void); // Creates and starts the delivery threads from the packet handling thread
+	void stopDeliveryThreads(void); // Shuts down and destroys all delivery threads
 	
 	/* Constructors and destructors: */
 	public:
@@ -251,22 +402,56 @@ class Multiplexer
 		return nodeIndex;
 		}
 	int getLocalPortNumber(void) const; // Returns port number of local communication socket
+	size_t getMTUSize(void) const // Returns the maximum transmission unit of the cluster network
+		{
+		return mtuSize;
+		}
+	size_t getMaxPacketSize(void) const // Returns the maximum size of multicast packet data payloads sent by this multiplexer
+		{
+		/* Leave room for the pipe ID and stream position, and for the two extra header words of parity packets if forward error correction is enabled: */
+		size_t headerSize=CLUSTER_CONFIG_IP_HEADER_SIZE+CLUSTER_CONFIG_UDP_HEADER_SIZE+2*sizeof(unsigned int);
+		if(fecBlockSize!=0)
+			headerSize+=2*sizeof(unsigned int);
+		return mtuSize-headerSize;
+		}
+	unsigned int getFecBlockSize(void) const // Returns the number of stream packets covered by each parity packet, or 0 if forward error correction is disabled
+		{
+		return fecBlockSize;
+		}
 	void setConnectionWaitTimeout(Misc::Time newConnectionWaitTimeout); // Sets the timeout when waiting for connection messages
 	void setPingTimeout(Misc::Time newPingTimeout,int newMaxPingRequests); // Sets the time after which slaves request a ping packet when no data is received, and the maximum number of requests sent before a connection error is signaled
 	void setReceiveWaitTimeout(Misc::Time newReceiveWaitTimeout); // Sets the timeout when waiting for data packages
 	void setBarrierWaitTimeout(Misc::Time newBarrierWaitTimeout); // Sets the timeout when waiting for barrier messages
 	void setSendBufferSize(unsigned int newSendBufferSize); // Sets the maximum number of packets held in each pipe's send queue
+	void setMTUSize(size_t newMTUSize); // Sets the maximum transmission unit of the cluster network, clamped to CLUSTER_CONFIG_MAX_MTU_SIZE; must be called before any pipes are opened
+	void setFecBlockSize(unsigned int newFecBlockSize); // Sets the number of stream packets covered by each parity packet sent by the master; 0 disables forward error correction; must be called before any pipes are opened
+	void setPacketLossRate(double newPacketLossRate); // Sets the probability with which a slave drops incoming stream packets, for testing
+	unsigned int getCollectiveFanout(void) const // Returns the maximum number of children of each node in the collective trees of newly opened pipes
+		{
+		return collectiveFanout;
+		}
+	void setCollectiveFanout(unsigned int newCollectiveFanout); // Sets the maximum number of children of each node in the trees running barriers, gather operations, and reductions on pipes opened afterwards; 0 lets the master talk to all slaves directly; only the master's setting is used
+	unsigned int getNumDeliveryThreads(void) const // Returns the number of threads delivering stream packets to pipes on a slave node
+		{
+		return numDeliveryThreads;
+		}
+	void setNumDeliveryThreads(unsigned int newNumDeliveryThreads); // Sets the number of threads delivering stream packets to pipes on a slave node, each serving a fixed subset of pipes; 0 delivers packets from the packet handling thread; throws an exception if any pipes are open
+	void getStatistics(Statistics& stats,bool reset =false); // Returns the packet statistics accumulated since the last reset; resets the statistics if flag is true
 	void waitForConnection(void); // Waits until all slaves have connected to the master
 	
 	/* Pipe management interface: */
 	unsigned int openPipe(void); // Creates a new multicast pipe and returns its pipe ID
 	void closePipe(unsigned int pipeId); // Destroys the multicast pipe of the given ID
+	void setPipeSendBufferSize(unsigned int pipeId,unsigned int newSendBufferSize); // Overrides the maximum number of packets held in the given pipe's send queue, e.g., for bulk transfers; 0 reverts to the multiplexer's default
 	
 	/* Pipe communication interface: */
 	void sendPacket(unsigned int pipeId,Packet* packet); // Sends a packet from the master to the slaves
 	Packet* receivePacket(unsigned int pipeId); // Receives a packet from the master
 	void barrier(unsigned int pipeId); // Waits until all nodes (master + slaves) have reached the same point in the program
 	unsigned int gather(unsigned int pipeId,unsigned int value,GatherOperation::OpCode op); // Exchanges a single value between all nodes (master + slaves); implies a barrier
+	void gatherData(unsigned int pipeId,const void* data,size_t dataSize,std::vector<std::vector<char> >& slaveData); // Sends a block of data of arbitrary size from each slave to the master, which receives the slaves' data in the given vector in slave order; implies a barrier
+	unsigned int gatherChildData(unsigned int pipeId,std::vector<std::vector<char> >& childData); // Receives the blocks of data sent by this node's children in the pipe's collective tree in the given vector in child order, and returns the node index of the first child; completes the operation on the master
+	void sendParentData(unsigned int pipeId,const void* data,size_t dataSize); // Sends a block of data of arbitrary size from a slave to its parent in the pipe's collective tree, and waits until the master completes the operation; must follow gatherChildData
 	};
 
 }
@@ -32,8 +32,8 @@ struct Packet
 	{
 	/* Embedded classes: */
 	public:
-	static const size_t maxRawPacketSize=CLUSTER_CONFIG_MTU_SIZE-CLUSTER_CONFIG_IP_HEADER_SIZE-CLUSTER_CONFIG_UDP_HEADER_SIZE; // Configured MTU size minus IP header size minus UDP header size
-	static const size_t maxPacketSize=CLUSTER_CONFIG_MTU_SIZE-CLUSTER_CONFIG_IP_HEADER_SIZE-CLUSTER_CONFIG_UDP_HEADER_SIZE-2*sizeof(unsigned int); // Maximum size of multicast packet data payload in bytes
+	static const size_t maxRawPacketSize=CLUSTER_CONFIG_MAX_MTU_SIZE-CLUSTER_CONFIG_IP_HEADER_SIZE-CLUSTER_CONFIG_UDP_HEADER_SIZE; // Largest supported MTU size minus IP header size minus UDP header size
+	static const size_t maxPacketSize=CLUSTER_CONFIG_MAX_MTU_SIZE-CLUSTER_CONFIG_IP_HEADER_SIZE-CLUSTER_CONFIG_UDP_HEADER_SIZE-2*sizeof(unsigned int); // Maximum size of multicast packet data payload in bytes at the largest supported MTU size; packets sent by a multiplexer are limited by its configured MTU size
 	
 	class Reader // Simple class to read data from packets
 		{
@@ -29,6 +29,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <unistd.h>
 #include <string.h>
 #include <Misc/ThrowStdErr.h>
+#include <Cluster/Config.h>
 #include <Cluster/Packet.h>
 #include <Cluster/Multiplexer.h>
 
@@ -44,6 +45,20 @@ Methods of class StandardFileMaster:
 
 size_t StandardFileMaster::readData(IO::File::Byte* buffer,size_t bufferSize)
 	{
+	if(readAhead&&isReadCoupled())
+		{
+		/* Stop streaming if the file was repositioned since the last read, or if read-ahead chunks don't fit into the given buffer: */
+		if(streaming&&(readPos!=streamPos||bufferSize<readAheadChunkSize))
+			endStreaming();
+		
+		/* Start streaming if the file is being read sequentially: */
+		if(!streaming&&readPos==filePos)
+			startStreaming(bufferSize);
+		
+		if(streaming)
+			return readStreamedData(buffer,bufferSize);
+		}
+	
 	/* Collect error codes: */
 	int errorType=0;
 	int errorCode=0;
@@ -82,14 +97,9 @@ size_t StandardFileMaster::readData(IO::File::Byte* buffer,size_t bufferSize)
 	/* Check for errors: */
 	if(errorType==0)
 		{
+		/* Forward the just-read data to the slaves: */
 		if(isReadCoupled())
-			{
-			/* Forward the just-read data to the slaves: */
-			Packet* packet=multiplexer->newPacket();
-			packet->packetSize=readSize;
-			memcpy(packet->packet,buffer,readSize);
-			multiplexer->sendPacket(pipeId,packet);
-			}
+			sendReadData(buffer,readSize);
 		
 		/* Advance the read pointer: */
 		readPos+=readSize;
@@ -99,20 +109,9 @@ size_t StandardFileMaster::readData(IO::File::Byte* buffer,size_t bufferSize)
 		}
 	else
 		{
+		/* Send an error indicator to the slaves: */
 		if(isReadCoupled())
-			{
-			/* Send an error indicator (empty packet followed by status packet) to the slaves: */
-			Packet* packet=multiplexer->newPacket();
-			packet->packetSize=0;
-			multiplexer->sendPacket(pipeId,packet);
-			packet=multiplexer->newPacket();
-			{
-			Packet::Writer writer(packet);
-			writer.write<int>(errorType);
-			writer.write<int>(errorCode);
-			}
-			multiplexer->sendPacket(pipeId,packet);
-			}
+			sendReadStatus(errorType,errorCode);
 		
 		/* Throw an exception: */
 		if(errorType==1)
@@ -248,13 +247,221 @@ void StandardFileMaster::openFile(const char* fileName,IO::File::AccessMode acce
 	/* Install a read buffer the size of a multicast packet: */
 	canReadThrough=false;
 	if(accessMode==ReadOnly||accessMode==ReadWrite)
-		IO::SeekableFile::resizeReadBuffer(Packet::maxPacketSize);
+		IO::SeekableFile::resizeReadBuffer(multiplexer->getMaxPacketSize());
+	
+	/* Let read-ahead data stream to the slaves through a large send window: */
+	if(readAhead)
+		multiplexer->setPipeSendBufferSize(pipeId,CLUSTER_CONFIG_FILE_SENDBUFFER_SIZE);
+	}
+
+void StandardFileMaster::sendReadData(const IO::File::Byte* buffer,size_t readSize)
+	{
+	Packet* packet=multiplexer->newPacket();
+	packet->packetSize=readSize;
+	memcpy(packet->packet,buffer,readSize);
+	multiplexer->sendPacket(pipeId,packet);
+	}
+
+void StandardFileMaster::sendReadStatus(int errorType,int errorCode)
+	{
+	/* Send an empty packet followed by a status packet: */
+	Packet* packet=multiplexer->newPacket();
+	packet->packetSize=0;
+	multiplexer->sendPacket(pipeId,packet);
+	packet=multiplexer->newPacket();
+	{
+	Packet::Writer writer(packet);
+	writer.write<int>(errorType);
+	writer.write<int>(errorCode);
+	}
+	multiplexer->sendPacket(pipeId,packet);
+	}
+
+void* StandardFileMaster::readAheadThreadMethod(void)
+	{
+	while(true)
+		{
+		{
+		Threads::Mutex::Lock readAheadLock(readAheadMutex);
+		
+		/* Wait until there is room in the ring buffer: */
+		while(numFullSlots>=readAheadLimit&&!readAheadShutdown)
+			readAheadCond.wait(readAheadMutex);
+		if(readAheadShutdown)
+			break;
+		}
+		
+		/* Read the next chunk of data into the ring buffer: */
+		ReadAheadSlot& slot=readAheadSlots[inSlot];
+		ssize_t readResult;
+		do
+			{
+			readResult=::read(fd,slot.data,readAheadChunkSize);
+			}
+		while(readResult<0&&(errno==EAGAIN||errno==EWOULDBLOCK||errno==EINTR));
+		slot.dataSize=0;
+		slot.errorCode=0;
+		if(readResult>0)
+			{
+			slot.dataSize=size_t(readResult);
+			slot.errorType=0;
+			readAheadPos+=slot.dataSize;
+			}
+		else if(readResult==0)
+			slot.errorType=2; // End of file
+		else
+			{
+			slot.errorType=3; // Fatal error
+			slot.errorCode=errno;
+			}
+		int errorType=slot.errorType;
+		
+		/* Forward the chunk to the slaves right away, while the master still consumes earlier chunks: */
+		if(errorType==0)
+			sendReadData(slot.data,slot.dataSize);
+		else
+			sendReadStatus(errorType,slot.errorCode);
+		
+		{
+		Threads::Mutex::Lock readAheadLock(readAheadMutex);
+		
+		/* Hand the filled slot to the reader: */
+		if(++inSlot==CLUSTER_CONFIG_FILE_READAHEAD_SIZE)
+			inSlot=0;
+		++numFullSlots;
+		readAheadCond.signal();
+		}
+		
+		/* Stop reading after end-of-file or an error: */
+		if(errorType!=0)
+			break;
+		}
+	
+	return 0;
+	}
+
+void StandardFileMaster::startStreaming(size_t chunkSize)
+	{
+	if(readAheadSlots==0)
+		{
+		/* Create the read-ahead ring buffer: */
+		size_t slotSize=multiplexer->getMaxPacketSize();
+		readAheadSlots=new ReadAheadSlot[CLUSTER_CONFIG_FILE_READAHEAD_SIZE];
+		readAheadBuffer=new Byte[slotSize*CLUSTER_CONFIG_FILE_READAHEAD_SIZE];
+		for(unsigned int i=0;i<CLUSTER_CONFIG_FILE_READAHEAD_SIZE;++i)
+			readAheadSlots[i].data=readAheadBuffer+slotSize*i;
+		}
+	
+	/* Read chunks that fit into a multicast packet and into the master's read buffer: */
+	readAheadChunkSize=multiplexer->getMaxPacketSize();
+	if(readAheadChunkSize>chunkSize)
+		readAheadChunkSize=chunkSize;
+	
+	/* Tell the slaves that read-ahead data follows: */
+	sendReadStatus(4,0); // Start of read-ahead stream
+	
+	/* Start with a short read-ahead distance that grows as long as the file is read sequentially: */
+	inSlot=0;
+	outSlot=0;
+	numFullSlots=0;
+	readAheadLimit=2;
+	readAheadShutdown=false;
+	readAheadPos=filePos;
+	streamPos=readPos;
+	streaming=true;
+	
+	/* Start the read-ahead thread: */
+	readAheadThread.start(this,&StandardFileMaster::readAheadThreadMethod);
+	}
+
+void StandardFileMaster::stopReadAheadThread(void)
+	{
+	/* Shut down the read-ahead thread and wait for it to terminate: */
+	{
+	Threads::Mutex::Lock readAheadLock(readAheadMutex);
+	readAheadShutdown=true;
+	readAheadCond.signal();
+	}
+	readAheadThread.join();
+	
+	/* The read-ahead thread left the underlying file's read pointer at the end of the read-ahead data: */
+	filePos=readAheadPos;
+	streaming=false;
+	}
+
+void StandardFileMaster::endStreaming(void)
+	{
+	if(streaming)
+		{
+		stopReadAheadThread();
+		
+		/* Tell the slaves to skip any read-ahead data the master did not consume: */
+		sendReadStatus(5,0); // End of read-ahead stream
+		}
+	}
+
+size_t StandardFileMaster::readStreamedData(IO::File::Byte* buffer,size_t bufferSize)
+	{
+	/* Wait for the next chunk from the read-ahead thread: */
+	{
+	Threads::Mutex::Lock readAheadLock(readAheadMutex);
+	while(numFullSlots==0)
+		readAheadCond.wait(readAheadMutex);
+	}
+	
+	/* Copy the chunk into the file's read buffer; chunks are never larger than the buffer, so the master consumes exactly what the slaves received: */
+	ReadAheadSlot& slot=readAheadSlots[outSlot];
+	int errorType=slot.errorType;
+	int errorCode=slot.errorCode;
+	size_t readSize=slot.dataSize;
+	memcpy(buffer,slot.data,readSize);
+	
+	{
+	Threads::Mutex::Lock readAheadLock(readAheadMutex);
+	
+	/* Release the slot and double the read-ahead distance: */
+	if(++outSlot==CLUSTER_CONFIG_FILE_READAHEAD_SIZE)
+		outSlot=0;
+	--numFullSlots;
+	if(readAheadLimit<CLUSTER_CONFIG_FILE_READAHEAD_SIZE)
+		{
+		readAheadLimit*=2;
+		if(readAheadLimit>CLUSTER_CONFIG_FILE_READAHEAD_SIZE)
+			readAheadLimit=CLUSTER_CONFIG_FILE_READAHEAD_SIZE;
+		}
+	readAheadCond.signal();
+	}
+	
+	if(errorType==0)
+		{
+		/* Advance the read pointer: */
+		readPos+=readSize;
+		streamPos=readPos;
+		
+		return readSize;
+		}
+	else
+		{
+		/* The read-ahead thread terminated after forwarding the error to the slaves: */
+		stopReadAheadThread();
+		
+		/* Throw an exception: */
+		if(errorType==3)
+			throw Error(Misc::printStdErrMsg("Cluster::StandardFile: Fatal error %d while reading from file",errorCode));
+		
+		/* Only reached in case of end-of-file: */
+		return 0;
+		}
 	}
 
 StandardFileMaster::StandardFileMaster(Multiplexer* sMultiplexer,const char* fileName,IO::File::AccessMode accessMode)
 	:IO::SeekableFile(disableRead(accessMode)),ClusterPipe(sMultiplexer),
 	 fd(-1),
-	 filePos(0)
+	 filePos(0),
+	 readAhead(accessMode==ReadOnly),
+	 readAheadSlots(0),readAheadBuffer(0),
+	 inSlot(0),outSlot(0),numFullSlots(0),readAheadLimit(0),readAheadChunkSize(0),readAheadShutdown(false),readAheadPos(0),
+	 streaming(false),streamPos(0)
 	{
 	/* Create flags and mode to open the file: */
 	int flags=O_CREAT;
@@ -269,7 +476,11 @@ StandardFileMaster::StandardFileMaster(Multiplexer* sMultiplexer,const char* fil
 StandardFileMaster::StandardFileMaster(Multiplexer* sMultiplexer,const char* fileName,IO::File::AccessMode accessMode,int flags,int mode)
 	:SeekableFile(disableRead(accessMode)),ClusterPipe(sMultiplexer),
 	 fd(-1),
-	 filePos(0)
+	 filePos(0),
+	 readAhead(accessMode==ReadOnly),
+	 readAheadSlots(0),readAheadBuffer(0),
+	 inSlot(0),outSlot(0),numFullSlots(0),readAheadLimit(0),readAheadChunkSize(0),readAheadShutdown(false),readAheadPos(0),
+	 streaming(false),streamPos(0)
 	{
 	/* Open the file: */
 	openFile(fileName,accessMode,flags,mode);
@@ -277,6 +488,12 @@ StandardFileMaster::StandardFileMaster(Multiplexer* sMultiplexer,const char* fil
 
 StandardFileMaster::~StandardFileMaster(void)
 	{
+	/* Shut down the read-ahead thread; the slaves discard unconsumed read-ahead data when the pipe is closed: */
+	if(streaming)
+		stopReadAheadThread();
+	delete[] readAheadSlots;
+	delete[] readAheadBuffer;
+	
 	/* Flush the write buffer, and then close the file: */
 	flush();
 	if(fd>=0)
@@ -294,11 +511,15 @@ int StandardFileMaster::getFd(void) const
 size_t StandardFileMaster::resizeReadBuffer(size_t newReadBufferSize)
 	{
 	/* Ignore the change and return the size of a multicast packet: */
-	return Packet::maxPacketSize;
+	return multiplexer->getMaxPacketSize();
 	}
 
 IO::SeekableFile::Offset StandardFileMaster::getSize(void) const
 	{
+	/* Stop streaming so the status message does not interleave with read-ahead data: */
+	if(streaming)
+		const_cast<StandardFileMaster*>(this)->endStreaming();
+	
 	/* Get the file's total size: */
 	struct stat statBuffer;
 	int statResult=fstat(fd,&statBuffer);
@@ -324,49 +545,119 @@ IO::SeekableFile::Offset StandardFileMaster::getSize(void) const
 	return fileSize;
 	}
 
+void StandardFileMaster::couple(bool newReadCoupled,bool newWriteCoupled)
+	{
+	/* Stop streaming before reads are decoupled: */
+	if(!newReadCoupled)
+		endStreaming();
+	
+	ClusterPipe::couple(newReadCoupled,newWriteCoupled);
+	}
+
+void StandardFileMaster::barrier(void)
+	{
+	/* Stop streaming so the read-ahead thread does not send concurrently with the barrier: */
+	endStreaming();
+	
+	ClusterPipe::barrier();
+	}
+
+unsigned int StandardFileMaster::gather(unsigned int value,GatherOperation::OpCode op)
+	{
+	/* Stop streaming so the read-ahead thread does not send concurrently with the gather operation: */
+	endStreaming();
+	
+	return ClusterPipe::gather(value,op);
+	}
+
 /**********************************
 Methods of class StandardFileSlave:
 **********************************/
 
+void StandardFileSlave::endStreaming(void)
+	{
+	if(streaming)
+		{
+		/* Discard packets until the master's end-of-stream indicator: */
+		while(true)
+			{
+			Packet* newPacket=multiplexer->receivePacket(pipeId);
+			if(newPacket->packetSize==0)
+				{
+				/* Read the status packet: */
+				multiplexer->deletePacket(newPacket);
+				newPacket=multiplexer->receivePacket(pipeId);
+				Packet::Reader reader(newPacket);
+				int errorType=reader.read<int>();
+				multiplexer->deletePacket(newPacket);
+				if(errorType==5) // End of read-ahead stream
+					break;
+				}
+			else
+				multiplexer->deletePacket(newPacket);
+			}
+		
+		streaming=false;
+		}
+	}
+
 size_t StandardFileSlave::readData(IO::File::Byte* buffer,size_t bufferSize)
 	{
 	if(isReadCoupled())
 		{
-		/* Receive a data packet from the master: */
-		Packet* newPacket=multiplexer->receivePacket(pipeId);
+		/* Skip unconsumed read-ahead data if the file was repositioned since the last read: */
+		if(streaming&&readPos!=streamPos)
+			endStreaming();
 		
-		/* Check for error conditions: */
-		if(newPacket->packetSize!=0)
-			{
-			/* Install the new packet as the file's read buffer: */
-			if(packet!=0)
-				multiplexer->deletePacket(packet);
-			packet=newPacket;
-			setReadBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
-			
-			/* Advance the read pointer: */
-			readPos+=packet->packetSize;
-			
-			return packet->packetSize;
-			}
-		else
+		while(true)
 			{
-			/* Read the status packet: */
-			multiplexer->deletePacket(newPacket);
-			newPacket=multiplexer->receivePacket(pipeId);
-			Packet::Reader reader(newPacket);
-			int errorType=reader.read<int>();
-			int errorCode=reader.read<int>();
-			multiplexer->deletePacket(newPacket);
-			
-			/* Handle the error: */
-			if(errorType==1)
-				throw SeekError(readPos);
-			else if(errorType==3)
-				throw Error(Misc::printStdErrMsg("Cluster::StandardFile: Fatal error %d while reading from file",errorCode));
+			/* Receive a data packet from the master: */
+			Packet* newPacket=multiplexer->receivePacket(pipeId);
 			
-			/* Only reached in case of end-of-file packet: */
-			return 0;
+			/* Check for error conditions: */
+			if(newPacket->packetSize!=0)
+				{
+				/* Install the new packet as the file's read buffer: */
+				if(packet!=0)
+					multiplexer->deletePacket(packet);
+				packet=newPacket;
+				setReadBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
+				
+				/* Advance the read pointer: */
+				readPos+=packet->packetSize;
+				streamPos=readPos;
+				
+				return packet->packetSize;
+				}
+			else
+				{
+				/* Read the status packet: */
+				multiplexer->deletePacket(newPacket);
+				newPacket=multiplexer->receivePacket(pipeId);
+				Packet::Reader reader(newPacket);
+				int errorType=reader.read<int>();
+				int errorCode=reader.read<int>();
+				multiplexer->deletePacket(newPacket);
+				
+				/* Check for the start of a read-ahead stream, and receive the first streamed packet: */
+				if(errorType==4)
+					{
+					streaming=true;
+					continue;
+					}
+				
+				/* The master stops streaming after any error: */
+				streaming=false;
+				
+				/* Handle the error: */
+				if(errorType==1)
+					throw SeekError(readPos);
+				else if(errorType==3)
+					throw Error(Misc::printStdErrMsg("Cluster::StandardFile: Fatal error %d while reading from file",errorCode));
+				
+				/* Only reached in case of end-of-file packet: */
+				return 0;
+				}
 			}
 		}
 	else
@@ -409,7 +700,8 @@ void StandardFileSlave::writeData(const IO::File::Byte* buffer,size_t bufferSize
 
 StandardFileSlave::StandardFileSlave(Multiplexer* sMultiplexer,const char* fileName,IO::File::AccessMode accessMode)
 	:IO::SeekableFile(disableRead(accessMode)),ClusterPipe(sMultiplexer),
-	 packet(0)
+	 packet(0),
+	 streaming(false),streamPos(0)
 	{
 	/* Read the status packet from the master node: */
 	Packet* statusPacket=multiplexer->receivePacket(pipeId);
@@ -461,6 +753,10 @@ IO::SeekableFile::Offset StandardFileSlave::getSize(void) const
 	{
 	if(isReadCoupled())
 		{
+		/* Skip unconsumed read-ahead data: */
+		if(streaming)
+			const_cast<StandardFileSlave*>(this)->endStreaming();
+		
 		/* Receive a status message from the master: */
 		Packet* statusPacket=multiplexer->receivePacket(pipeId);
 		Packet::Reader reader(statusPacket);
@@ -482,4 +778,29 @@ IO::SeekableFile::Offset StandardFileSlave::getSize(void) const
 		}
 	}
 
+void StandardFileSlave::couple(bool newReadCoupled,bool newWriteCoupled)
+	{
+	/* Skip unconsumed read-ahead data before reads are decoupled: */
+	if(!newReadCoupled)
+		endStreaming();
+	
+	ClusterPipe::couple(newReadCoupled,newWriteCoupled);
+	}
+
+void StandardFileSlave::barrier(void)
+	{
+	/* Skip unconsumed read-ahead data: */
+	endStreaming();
+	
+	ClusterPipe::barrier();
+	}
+
+unsigned int StandardFileSlave::gather(unsigned int value,GatherOperation::OpCode op)
+	{
+	/* Skip unconsumed read-ahead data: */
+	endStreaming();
+	
+	return ClusterPipe::gather(value,op);
+	}
+
 }
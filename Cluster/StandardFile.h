@@ -23,6 +23,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef CLUSTER_STANDARDFILE_INCLUDED
 #define CLUSTER_STANDARDFILE_INCLUDED
 
+#include <Threads/Mutex.h>
+#include <Threads/Cond.h>
+#include <Threads/Thread.h>
 #include <IO/SeekableFile.h>
 #include <Cluster/ClusterPipe.h>
 
@@ -35,10 +38,36 @@ namespace Cluster {
 
 class StandardFileMaster:public IO::SeekableFile,public ClusterPipe // Class to represent cluster-transparent standard files on the master node
 	{
-	/* Elements: */
+	/* Embedded classes: */
 	private:
+	struct ReadAheadSlot // Structure for a chunk of file data read ahead by the background thread
+		{
+		/* Elements: */
+		public:
+		Byte* data; // Pointer to the chunk's data
+		size_t dataSize; // Amount of data in the chunk
+		int errorType; // Error type of the read operation that filled the chunk; 0 if the chunk contains data
+		int errorCode; // Error code of a fatal read error
+		};
+	
+	/* Elements: */
 	int fd; // File descriptor of the underlying file
 	Offset filePos; // Current position of the underlying file's read/write pointer
+	bool readAhead; // Flag whether sequential reads are streamed to the slaves by a background read-ahead thread
+	Threads::Thread readAheadThread; // Background thread reading ahead from the file and forwarding the read data to the slaves
+	Threads::Mutex readAheadMutex; // Mutex serializing access to the read-ahead ring buffer
+	Threads::Cond readAheadCond; // Condition variable to signal a change in ring buffer state
+	ReadAheadSlot* readAheadSlots; // Ring buffer of chunks read ahead by the background thread; allocated when streaming starts for the first time
+	Byte* readAheadBuffer; // Memory block holding the data of all ring buffer slots
+	unsigned int inSlot; // Index of the ring buffer slot to be filled next
+	unsigned int outSlot; // Index of the ring buffer slot to be consumed next
+	unsigned int numFullSlots; // Number of filled ring buffer slots
+	unsigned int readAheadLimit; // Current maximum number of filled ring buffer slots; grows while the file is read sequentially
+	size_t readAheadChunkSize; // Maximum amount of data read into each ring buffer slot; never larger than the master's read buffer, so the master consumes the same chunks as the slaves
+	bool readAheadShutdown; // Flag to shut down the read-ahead thread
+	Offset readAheadPos; // Position of the underlying file's read pointer while the read-ahead thread is running
+	bool streaming; // Flag whether the read-ahead thread is running and the slaves are receiving read-ahead data
+	Offset streamPos; // Read position following the most recently consumed read-ahead chunk
 	
 	/* Protected methods from IO::File: */
 	protected:
@@ -47,6 +76,13 @@ class StandardFileMaster:public IO::SeekableFile,public ClusterPipe // Class to
 	
 	/* Private methods: */
 	void openFile(const char* fileName,AccessMode accessMode,int flags,int mode); // Opens a file and handles errors
+	void sendReadData(const Byte* buffer,size_t readSize); // Forwards a chunk of read data to the slaves
+	void sendReadStatus(int errorType,int errorCode); // Sends a read status indicator (empty packet followed by status packet) to the slaves
+	void* readAheadThreadMethod(void); // The background read-ahead thread's method
+	void startStreaming(size_t chunkSize); // Starts reading ahead from the current read position in chunks of at most the given size
+	void stopReadAheadThread(void); // Shuts down the background read-ahead thread
+	void endStreaming(void); // Stops reading ahead and tells the slaves to discard any unconsumed read-ahead data
+	size_t readStreamedData(Byte* buffer,size_t bufferSize); // Returns the next chunk of data from the read-ahead ring buffer
 	
 	/* Constructors and destructors: */
 	public:
@@ -60,6 +96,11 @@ class StandardFileMaster:public IO::SeekableFile,public ClusterPipe // Class to
 	
 	/* Methods from IO::SeekableFile: */
 	virtual Offset getSize(void) const;
+	
+	/* Methods from ClusterPipe: */
+	virtual void couple(bool newReadCoupled,bool newWriteCoupled);
+	virtual void barrier(void);
+	virtual unsigned int gather(unsigned int value,GatherOperation::OpCode op);
 	};
 
 class StandardFileSlave:public IO::SeekableFile,public ClusterPipe // Class to represent cluster-transparent standard files on the slave nodes
@@ -67,12 +108,17 @@ class StandardFileSlave:public IO::SeekableFile,public ClusterPipe // Class to r
 	/* Elements: */
 	private:
 	Packet* packet; // Pointer to most recently received multicast packet; doubles as file's read buffer
+	bool streaming; // Flag whether the master is streaming read-ahead data
+	Offset streamPos; // Read position following the most recently consumed read-ahead packet
 	
 	/* Protected methods from IO::File: */
 	protected:
 	virtual size_t readData(Byte* buffer,size_t bufferSize);
 	virtual void writeData(const Byte* buffer,size_t bufferSize);
 	
+	/* Private methods: */
+	void endStreaming(void); // Discards all unconsumed read-ahead data sent by the master
+	
 	/* Constructors and destructors: */
 	public:
 	StandardFileSlave(Multiplexer* sMultiplexer,const char* fileName,AccessMode accessMode =ReadOnly); // Opens a standard file with "DontCare" endianness setting
@@ -85,6 +131,11 @@ class StandardFileSlave:public IO::SeekableFile,public ClusterPipe // Class to r
 	
 	/* Methods from IO::SeekableFile: */
 	virtual Offset getSize(void) const;
+	
+	/* Methods from ClusterPipe: */
+	virtual void couple(bool newReadCoupled,bool newWriteCoupled);
+	virtual void barrier(void);
+	virtual unsigned int gather(unsigned int value,GatherOperation::OpCode op);
 	};
 
 }
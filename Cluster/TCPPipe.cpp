@@ -34,6 +34,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Misc/ThrowStdErr.h>
 #include <Misc/StringMarshaller.h>
 #include <Misc/FdSet.h>
+#include <Cluster/BlockCompressor.h>
 
 namespace Cluster {
 
@@ -92,6 +93,10 @@ Methods of class TCPPipeMaster:
 
 size_t TCPPipeMaster::readData(IO::File::Byte* buffer,size_t bufferSize)
 	{
+	/* Limit the amount of data to what can be forwarded in a single multicast packet in uncompressed mode: */
+	if(compressor==0&&bufferSize>multiplexer->getMaxPacketSize())
+		bufferSize=multiplexer->getMaxPacketSize();
+	
 	/* Read more data from source: */
 	ssize_t readResult;
 	do
@@ -108,10 +113,15 @@ size_t TCPPipeMaster::readData(IO::File::Byte* buffer,size_t bufferSize)
 		if(isReadCoupled())
 			{
 			/* Forward the just-read data to the slaves: */
-			Packet* packet=multiplexer->newPacket();
-			packet->packetSize=readSize;
-			memcpy(packet->packet,buffer,readSize);
-			multiplexer->sendPacket(pipeId,packet);
+			if(compressor!=0)
+				compressor->sendBlock(buffer,readSize);
+			else
+				{
+				Packet* packet=multiplexer->newPacket();
+				packet->packetSize=readSize;
+				memcpy(packet->packet,buffer,readSize);
+				multiplexer->sendPacket(pipeId,packet);
+				}
 			}
 		
 		return readSize;
@@ -203,7 +213,8 @@ void TCPPipeMaster::writeData(const IO::File::Byte* buffer,size_t bufferSize)
 
 TCPPipeMaster::TCPPipeMaster(Multiplexer* sMultiplexer,const char* hostName,int portId)
 	:Comm::NetPipe(WriteOnly),ClusterPipe(sMultiplexer),
-	 fd(-1)
+	 fd(-1),
+	 compressor(0)
 	{
 	/* Collect error indicators: */
 	int errorType=0;
@@ -276,7 +287,7 @@ TCPPipeMaster::TCPPipeMaster(Multiplexer* sMultiplexer,const char* hostName,int
 		}
 	
 	/* Install a read buffer the size of a multicast packet: */
-	Comm::Pipe::resizeReadBuffer(Packet::maxPacketSize);
+	Comm::Pipe::resizeReadBuffer(multiplexer->getMaxPacketSize());
 	canReadThrough=false;
 	}
 
@@ -286,6 +297,9 @@ TCPPipeMaster::~TCPPipeMaster(void)
 	flush();
 	if(fd>=0)
 		close(fd);
+	
+	/* Delete the block compressor: */
+	delete compressor;
 	}
 
 int TCPPipeMaster::getFd(void) const
@@ -298,8 +312,8 @@ int TCPPipeMaster::getFd(void) const
 
 size_t TCPPipeMaster::resizeReadBuffer(size_t newReadBufferSize)
 	{
-	/* Ignore the change and return the size of a multicast packet: */
-	return Packet::maxPacketSize;
+	/* Ignore the change and return the maximum block size in compressed mode, or the size of a multicast packet: */
+	return compressor!=0?BlockCompressor::getBlockSize():multiplexer->getMaxPacketSize();
 	}
 
 bool TCPPipeMaster::waitForData(void) const
@@ -542,6 +556,34 @@ std::string TCPPipeMaster::getPeerHostName(void) const
 	return result;
 	}
 
+int TCPPipeMaster::getCompressionLevel(void) const
+	{
+	return compressor!=0?compressor->getCompressionLevel():0;
+	}
+
+void TCPPipeMaster::setCompressionLevel(int newCompressionLevel)
+	{
+	if(isReadCoupled())
+		{
+		/* Send the new compression level to the slaves: */
+		Packet* modePacket=multiplexer->newPacket();
+		{
+		Packet::Writer writer(modePacket);
+		writer.write<int>(newCompressionLevel);
+		}
+		multiplexer->sendPacket(pipeId,modePacket);
+		}
+	
+	/* Create a new block compressor: */
+	delete compressor;
+	compressor=0;
+	if(newCompressionLevel!=0)
+		compressor=new BlockCompressor(multiplexer,pipeId,newCompressionLevel);
+	
+	/* Read blocks of data at a time in compressed mode; resizing retains any unread data: */
+	Comm::Pipe::resizeReadBuffer(compressor!=0?BlockCompressor::getBlockSize():multiplexer->getMaxPacketSize());
+	}
+
 /*****************************
 Methods of class TCPPipeSlave:
 *****************************/
@@ -556,9 +598,23 @@ size_t TCPPipeSlave::readData(IO::File::Byte* buffer,size_t bufferSize)
 		/* Check for error conditions: */
 		if(newPacket->packetSize!=0)
 			{
-			/* Install the new packet as the pipe's read buffer: */
+			/* Delete the previous packet: */
 			if(packet!=0)
+				{
 				multiplexer->deletePacket(packet);
+				packet=0;
+				}
+			
+			if(compressionLevel!=0)
+				{
+				/* Receive and decompress the rest of the block, and install the block buffer as the pipe's read buffer: */
+				size_t blockSize=compressor->receiveBlock(newPacket);
+				setReadBuffer(BlockCompressor::getBlockSize(),static_cast<Byte*>(compressor->getBlockBuffer()),false);
+				
+				return blockSize;
+				}
+			
+			/* Install the new packet as the pipe's read buffer: */
 			packet=newPacket;
 			setReadBuffer(Packet::maxPacketSize,reinterpret_cast<Byte*>(packet->packet),false);
 			
@@ -608,7 +664,8 @@ void TCPPipeSlave::writeData(const IO::File::Byte* buffer,size_t bufferSize)
 
 TCPPipeSlave::TCPPipeSlave(Multiplexer* sMultiplexer,const char* hostName,int portId)
 	:Comm::NetPipe(WriteOnly),ClusterPipe(sMultiplexer),
-	 packet(0)
+	 packet(0),
+	 compressionLevel(0),compressor(0)
 	{
 	/* Read the status packet from the master node: */
 	Packet* statusPacket=multiplexer->receivePacket(pipeId);
@@ -630,10 +687,11 @@ TCPPipeSlave::~TCPPipeSlave(void)
 	{
 	/* Delete the current multicast packet: */
 	if(packet!=0)
-		{
 		multiplexer->deletePacket(packet);
-		setReadBuffer(0,0,false);
-		}
+	setReadBuffer(0,0,false);
+	
+	/* Delete the block decompressor: */
+	delete compressor;
 	}
 
 int TCPPipeSlave::getFd(void) const
@@ -646,14 +704,14 @@ int TCPPipeSlave::getFd(void) const
 
 size_t TCPPipeSlave::getReadBufferSize(void) const
 	{
-	/* Return the size of a multicast packet: */
-	return Packet::maxPacketSize;
+	/* Return the maximum block size in compressed mode, or the size of a multicast packet: */
+	return compressionLevel!=0?BlockCompressor::getBlockSize():Packet::maxPacketSize;
 	}
 
 size_t TCPPipeSlave::resizeReadBuffer(size_t newReadBufferSize)
 	{
-	/* Ignore the change and return the size of a multicast packet: */
-	return Packet::maxPacketSize;
+	/* Ignore the change and return the current read buffer size: */
+	return getReadBufferSize();
 	}
 
 bool TCPPipeSlave::waitForData(void) const
@@ -821,4 +879,26 @@ std::string TCPPipeSlave::getPeerHostName(void) const
 		}
 	}
 
+int TCPPipeSlave::getCompressionLevel(void) const
+	{
+	return compressionLevel;
+	}
+
+void TCPPipeSlave::setCompressionLevel(int newCompressionLevel)
+	{
+	if(isReadCoupled())
+		{
+		/* Receive the master's compression level: */
+		Packet* modePacket=multiplexer->receivePacket(pipeId);
+		Packet::Reader reader(modePacket);
+		newCompressionLevel=reader.read<int>();
+		multiplexer->deletePacket(modePacket);
+		}
+	
+	/* Create the block decompressor on first use; keep it afterwards, as its block buffer might still hold unread data: */
+	compressionLevel=newCompressionLevel;
+	if(compressionLevel!=0&&compressor==0)
+		compressor=new BlockCompressor(multiplexer,pipeId,compressionLevel);
+	}
+
 }
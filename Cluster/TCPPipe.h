@@ -26,6 +26,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Comm/NetPipe.h>
 #include <Cluster/ClusterPipe.h>
 
+/* Forward declarations: */
+namespace Cluster {
+class BlockCompressor;
+}
+
 namespace Cluster {
 
 class TCPPipeMaster:public Comm::NetPipe,public ClusterPipe // Class to represent cluster-transparent TCP pipes on the master node
@@ -33,6 +38,7 @@ class TCPPipeMaster:public Comm::NetPipe,public ClusterPipe // Class to represen
 	/* Elements: */
 	private:
 	int fd; // File descriptor of the underlying TCP socket
+	BlockCompressor* compressor; // Compressor for data forwarded to the slaves in compressed mode; null in uncompressed mode
 	
 	/* Protected methods from IO::File: */
 	virtual size_t readData(Byte* buffer,size_t bufferSize);
@@ -59,6 +65,10 @@ class TCPPipeMaster:public Comm::NetPipe,public ClusterPipe // Class to represen
 	virtual int getPeerPortId(void) const;
 	virtual std::string getPeerAddress(void) const;
 	virtual std::string getPeerHostName(void) const;
+	
+	/* New methods: */
+	int getCompressionLevel(void) const; // Returns the zlib compression level of data forwarded to the slaves, or 0 in uncompressed mode
+	void setCompressionLevel(int newCompressionLevel); // Switches forwarding of read data to compressed mode using the given zlib compression level, or to uncompressed mode if level is 0; must be called at the same point on all nodes; the slaves adopt the master's level
 	};
 
 class TCPPipeSlave:public Comm::NetPipe,public ClusterPipe // Class to represent cluster-transparent TCP pipes on the slave nodes
@@ -66,6 +76,8 @@ class TCPPipeSlave:public Comm::NetPipe,public ClusterPipe // Class to represent
 	/* Elements: */
 	private:
 	Packet* packet; // Pointer to most recently received multicast packet; doubles as pipe's read buffer
+	int compressionLevel; // Compression level of data forwarded by the master, or 0 in uncompressed mode
+	BlockCompressor* compressor; // Decompressor for data received in compressed mode; created when compressed mode is first enabled
 	
 	/* Protected methods from IO::File: */
 	virtual size_t readData(Byte* buffer,size_t bufferSize);
@@ -93,6 +105,10 @@ class TCPPipeSlave:public Comm::NetPipe,public ClusterPipe // Class to represent
 	virtual int getPeerPortId(void) const;
 	virtual std::string getPeerAddress(void) const;
 	virtual std::string getPeerHostName(void) const;
+	
+	/* New methods: */
+	int getCompressionLevel(void) const; // Returns the zlib compression level of data forwarded to the slaves, or 0 in uncompressed mode
+	void setCompressionLevel(int newCompressionLevel); // Switches forwarding of read data to compressed mode using the given zlib compression level, or to uncompressed mode if level is 0; must be called at the same point on all nodes; the slaves adopt the master's level
 	};
 
 }
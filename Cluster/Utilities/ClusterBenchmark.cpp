@@ -0,0 +1,546 @@
+/***********************************************************************
+ClusterBenchmark - Program to measure the cost of barriers, gather
+operations, reductions, broadcasts, and thread synchronization across a
+sweep of slave counts, collective tree fanouts, message sizes, and
+injected packet loss rates by running a master node and several slave
+nodes as local processes.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Cluster Abstraction Library (Cluster).
+
+The Cluster Abstraction Library is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Cluster Abstraction Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Cluster Abstraction Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <Math/Histogram.h>
+#include <Realtime/Time.h>
+#include <Threads/Thread.h>
+#include <Cluster/Multiplexer.h>
+#include <Cluster/MulticastPipe.h>
+#include <Cluster/ThreadSynchronizer.h>
+
+/**************
+Helper classes:
+**************/
+
+struct BenchmarkSettings // Structure holding the settings of a benchmark sweep
+	{
+	/* Elements: */
+	public:
+	const char* masterHostName; // Host name of the master node
+	int basePort; // First UDP port number used by the sweep; each cluster run uses the next two ports
+	const char* multicastGroup; // Multicast group or broadcast address of the slave nodes
+	unsigned int mtuSize; // MTU size for the master's multiplexer
+	unsigned int sendBufferSize; // Number of packets in each pipe's send buffer
+	unsigned int fecBlockSize; // Number of packets covered by each forward error correction parity packet; 0 disables forward error correction
+	unsigned int numDeliveryThreads; // Number of threads delivering stream packets to pipes on each slave; 0 delivers packets from the packet handling thread
+	unsigned int numPipes; // Number of pipes streaming concurrently in the multi-pipe goodput test; test is skipped if less than 2
+	std::vector<unsigned int> slaveCounts; // List of numbers of slave processes to sweep
+	std::vector<unsigned int> fanouts; // List of collective tree fanouts to sweep; 0 lets the master talk to all slaves directly
+	std::vector<size_t> messageSizes; // List of broadcast message sizes to sweep in bytes
+	std::vector<double> lossRates; // List of slave packet loss probabilities to sweep
+	unsigned int numRounds; // Number of rounds in each latency test
+	size_t dataSize; // Amount of data to send in each goodput test in bytes
+	};
+
+struct RunSettings // Structure holding the settings of a single cluster run inside a sweep
+	{
+	/* Elements: */
+	public:
+	unsigned int numSlaves; // Number of slave processes
+	unsigned int fanout; // Fanout of the collective trees
+	double lossRate; // Probability with which slaves drop incoming packets
+	int masterPort; // UDP port number of the master node
+	int slavePort; // UDP port number of the slave nodes
+	};
+
+struct StreamThreadArgs // Structure passing parameters to and results from a thread in the multi-pipe goodput test
+	{
+	/* Elements: */
+	public:
+	Cluster::Multiplexer* multiplexer; // Multiplexer on which to open the thread's pipe
+	const char* message; // Message to send or compare against
+	size_t messageSize; // Size of each message in bytes
+	size_t dataSize; // Amount of data to send through the thread's pipe in bytes
+	unsigned int numErrors; // Number of corrupted messages received by the thread
+	};
+
+/****************
+Helper functions:
+****************/
+
+template <class ValueParam>
+std::vector<ValueParam> parseList(const char* list) // Parses a comma-separated list of numbers
+	{
+	std::vector<ValueParam> result;
+	const char* lPtr=list;
+	while(*lPtr!='\0')
+		{
+		char* endPtr;
+		double value=strtod(lPtr,&endPtr);
+		if(endPtr==lPtr)
+			break;
+		result.push_back(ValueParam(value));
+		lPtr=endPtr;
+		if(*lPtr==',')
+			++lPtr;
+		}
+	return result;
+	}
+
+void printRow(const char* testName,const RunSettings& run,size_t messageSize,const Math::Histogram<double>& latencies,double goodput,unsigned int numResentPackets,unsigned int numErrors)
+	{
+	/* Print the run parameters: */
+	printf("%s,%u,%u,%g,%lu,%lu",testName,run.numSlaves,run.fanout,run.lossRate,(unsigned long)messageSize,(unsigned long)latencies.getNumSamples());
+	
+	/* Print the latency percentiles in microseconds, or empty fields if the test did not measure latencies: */
+	if(latencies.getNumSamples()>0)
+		printf(",%.2f,%.2f,%.2f,%.2f",latencies.getPercentile(0.5),latencies.getPercentile(0.9),latencies.getPercentile(0.99),latencies.getMaxValue());
+	else
+		printf(",,,,");
+	
+	/* Print the goodput in MB/s, or an empty field if the test did not measure goodput: */
+	if(goodput>0.0)
+		printf(",%.3f",goodput);
+	else
+		printf(",");
+	
+	printf(",%u,%u\n",numResentPackets,numErrors);
+	fflush(stdout);
+	}
+
+void* dummyThreadFunction(void) // Thread function for the thread synchronization test
+	{
+	return 0;
+	}
+
+void* streamThreadFunction(StreamThreadArgs* args) // Thread function for the multi-pipe goodput test
+	{
+	/* Open a pipe and stream the requested amount of data through it: */
+	Cluster::MulticastPipe pipe(args->multiplexer);
+	std::vector<char> buffer(args->messageSize);
+	for(size_t totalSize=0;totalSize<args->dataSize;totalSize+=args->messageSize)
+		{
+		if(pipe.isMaster())
+			pipe.writeRaw(args->message,args->messageSize);
+		else
+			{
+			pipe.readRaw(&buffer[0],args->messageSize);
+			if(memcmp(&buffer[0],args->message,args->messageSize)!=0)
+				++args->numErrors;
+			}
+		}
+	pipe.flush();
+	pipe.barrier();
+	
+	return 0;
+	}
+
+void runNode(const BenchmarkSettings& settings,const RunSettings& run,unsigned int nodeIndex)
+	{
+	/* Connect the node to the cluster: */
+	Cluster::Multiplexer multiplexer(run.numSlaves,nodeIndex,settings.masterHostName,run.masterPort,settings.multicastGroup,run.slavePort);
+	if(nodeIndex==0)
+		{
+		multiplexer.setMTUSize(settings.mtuSize);
+		multiplexer.setSendBufferSize(settings.sendBufferSize);
+		multiplexer.setFecBlockSize(settings.fecBlockSize);
+		multiplexer.setCollectiveFanout(run.fanout);
+		}
+	else
+		{
+		multiplexer.setPacketLossRate(run.lossRate);
+		multiplexer.setNumDeliveryThreads(settings.numDeliveryThreads);
+		}
+	multiplexer.waitForConnection();
+	Cluster::MulticastPipe pipe(&multiplexer);
+	unsigned int numNodes=multiplexer.getNumNodes();
+	bool master=nodeIndex==0;
+	
+	Math::Histogram<double> latencies(1.0,0.0,100000.0); // Round latencies in microseconds
+	Cluster::Multiplexer::Statistics stats;
+	unsigned int numResentPackets;
+	unsigned int numErrors;
+	
+	/*********************************************************************
+	Barrier test: Complete an empty barrier in each round.
+	*********************************************************************/
+	
+	pipe.barrier();
+	multiplexer.getStatistics(stats);
+	numResentPackets=stats.numResentPackets;
+	for(unsigned int round=0;round<settings.numRounds;++round)
+		{
+		Realtime::TimePointMonotonic roundStart;
+		pipe.barrier();
+		latencies.addSample(double(roundStart.setAndDiff())*1.0e6);
+		}
+	multiplexer.getStatistics(stats);
+	if(master)
+		printRow("barrier",run,0,latencies,0.0,stats.numResentPackets-numResentPackets,0);
+	latencies.reset();
+	
+	/*********************************************************************
+	Gather test: Sum a different value from each node in each round and
+	check the result on all nodes.
+	*********************************************************************/
+	
+	multiplexer.getStatistics(stats);
+	numResentPackets=stats.numResentPackets;
+	numErrors=0;
+	for(unsigned int round=0;round<settings.numRounds;++round)
+		{
+		Realtime::TimePointMonotonic roundStart;
+		unsigned int sum=pipe.gather(nodeIndex+round,Cluster::GatherOperation::SUM);
+		latencies.addSample(double(roundStart.setAndDiff())*1.0e6);
+		if(sum!=numNodes*(numNodes-1)/2+numNodes*round)
+			++numErrors;
+		}
+	multiplexer.getStatistics(stats);
+	numErrors=pipe.gather(numErrors,Cluster::GatherOperation::SUM);
+	if(master)
+		printRow("gather",run,0,latencies,0.0,stats.numResentPackets-numResentPackets,numErrors);
+	latencies.reset();
+	
+	/*********************************************************************
+	Thread synchronization test: Let the master create a child thread in
+	each round and synchronize the child thread indices of all nodes.
+	*********************************************************************/
+	
+	multiplexer.getStatistics(stats);
+	numResentPackets=stats.numResentPackets;
+	{
+	Cluster::ThreadSynchronizer threadSynchronizer(&pipe);
+	for(unsigned int round=0;round<settings.numRounds;++round)
+		{
+		if(master)
+			{
+			Threads::Thread thread;
+			thread.start(dummyThreadFunction);
+			thread.join();
+			}
+		Realtime::TimePointMonotonic roundStart;
+		threadSynchronizer.sync();
+		latencies.addSample(double(roundStart.setAndDiff())*1.0e6);
+		}
+	}
+	multiplexer.getStatistics(stats);
+	
+	/* Check that all nodes ended up with the same next child thread index: */
+	unsigned int nextChildIndex=Threads::Thread::getThreadObject()->getNextChildIndex();
+	unsigned int minNextChildIndex=pipe.gather(nextChildIndex,Cluster::GatherOperation::MIN);
+	unsigned int maxNextChildIndex=pipe.gather(nextChildIndex,Cluster::GatherOperation::MAX);
+	if(master)
+		printRow("threadsync",run,0,latencies,0.0,stats.numResentPackets-numResentPackets,minNextChildIndex!=maxNextChildIndex?1:0);
+	latencies.reset();
+	
+	/* Create a message buffer for the largest message size: */
+	size_t bufferSize=*std::max_element(settings.messageSizes.begin(),settings.messageSizes.end());
+	std::vector<char> message(bufferSize);
+	for(size_t i=0;i<bufferSize;++i)
+		message[i]=char(i*7+3);
+	std::vector<char> buffer(bufferSize);
+	
+	for(std::vector<size_t>::const_iterator msIt=settings.messageSizes.begin();msIt!=settings.messageSizes.end();++msIt)
+		{
+		size_t messageSize=*msIt;
+		
+		/*******************************************************************
+		Broadcast latency test: Send a message from the master to all slaves
+		and complete a barrier in each round.
+		*******************************************************************/
+		
+		multiplexer.getStatistics(stats);
+		numResentPackets=stats.numResentPackets;
+		numErrors=0;
+		for(unsigned int round=0;round<settings.numRounds;++round)
+			{
+			Realtime::TimePointMonotonic roundStart;
+			if(master)
+				{
+				pipe.writeRaw(&message[0],messageSize);
+				pipe.flush();
+				}
+			else
+				pipe.readRaw(&buffer[0],messageSize);
+			pipe.barrier();
+			latencies.addSample(double(roundStart.setAndDiff())*1.0e6);
+			if(!master&&memcmp(&buffer[0],&message[0],messageSize)!=0)
+				++numErrors;
+			}
+		multiplexer.getStatistics(stats);
+		numErrors=pipe.gather(numErrors,Cluster::GatherOperation::SUM);
+		if(master)
+			printRow("broadcast",run,messageSize,latencies,0.0,stats.numResentPackets-numResentPackets,numErrors);
+		latencies.reset();
+		
+		/*******************************************************************
+		All-reduce test: Sum arrays of the current size from all nodes in
+		each round and check the result on all nodes.
+		*******************************************************************/
+		
+		multiplexer.getStatistics(stats);
+		numResentPackets=stats.numResentPackets;
+		numErrors=0;
+		size_t numValues=(messageSize+sizeof(unsigned int)-1)/sizeof(unsigned int);
+		std::vector<unsigned int> values(numValues);
+		for(unsigned int round=0;round<settings.numRounds;++round)
+			{
+			for(size_t i=0;i<numValues;++i)
+				values[i]=nodeIndex+round+(unsigned int)(i);
+			Realtime::TimePointMonotonic roundStart;
+			pipe.allReduce(&values[0],numValues,Cluster::GatherOperation::SUM);
+			latencies.addSample(double(roundStart.setAndDiff())*1.0e6);
+			for(size_t i=0;i<numValues;++i)
+				if(values[i]!=numNodes*(numNodes-1)/2+numNodes*(round+(unsigned int)(i)))
+					{
+					++numErrors;
+					break;
+					}
+			}
+		multiplexer.getStatistics(stats);
+		numErrors=pipe.gather(numErrors,Cluster::GatherOperation::SUM);
+		if(master)
+			printRow("allreduce",run,numValues*sizeof(unsigned int),latencies,0.0,stats.numResentPackets-numResentPackets,numErrors);
+		latencies.reset();
+		
+		/*******************************************************************
+		Broadcast goodput test: Stream the configured amount of data from
+		the master to all slaves in messages of the current size and wait
+		until all slaves have received it.
+		*******************************************************************/
+		
+		multiplexer.getStatistics(stats);
+		numResentPackets=stats.numResentPackets;
+		numErrors=0;
+		pipe.barrier();
+		Realtime::TimePointMonotonic streamStart;
+		size_t totalSize;
+		for(totalSize=0;totalSize<settings.dataSize;totalSize+=messageSize)
+			{
+			if(master)
+				pipe.writeRaw(&message[0],messageSize);
+			else
+				{
+				pipe.readRaw(&buffer[0],messageSize);
+				if(memcmp(&buffer[0],&message[0],messageSize)!=0)
+					++numErrors;
+				}
+			}
+		pipe.flush();
+		pipe.barrier();
+		double streamTime=double(streamStart.setAndDiff());
+		multiplexer.getStatistics(stats);
+		numErrors=pipe.gather(numErrors,Cluster::GatherOperation::SUM);
+		if(master)
+			printRow("stream",run,messageSize,latencies,double(totalSize)/streamTime/(1024.0*1024.0),stats.numResentPackets-numResentPackets,numErrors);
+		
+		if(settings.numPipes>=2)
+			{
+			/*****************************************************************
+			Multi-pipe goodput test: Stream the configured amount of data from
+			the master to all slaves through several pipes concurrently, each
+			served by its own thread.
+			*****************************************************************/
+			
+			multiplexer.getStatistics(stats);
+			numResentPackets=stats.numResentPackets;
+			std::vector<StreamThreadArgs> args(settings.numPipes);
+			Threads::Thread* threads=new Threads::Thread[settings.numPipes];
+			pipe.barrier();
+			Realtime::TimePointMonotonic multiStreamStart;
+			for(unsigned int i=0;i<settings.numPipes;++i)
+				{
+				args[i].multiplexer=&multiplexer;
+				args[i].message=&message[0];
+				args[i].messageSize=messageSize;
+				args[i].dataSize=(settings.dataSize+settings.numPipes-1)/settings.numPipes;
+				args[i].numErrors=0;
+				threads[i].start(streamThreadFunction,&args[i]);
+				}
+			numErrors=0;
+			for(unsigned int i=0;i<settings.numPipes;++i)
+				{
+				threads[i].join();
+				numErrors+=args[i].numErrors;
+				}
+			pipe.barrier();
+			double multiStreamTime=double(multiStreamStart.setAndDiff());
+			delete[] threads;
+			multiplexer.getStatistics(stats);
+			numErrors=pipe.gather(numErrors,Cluster::GatherOperation::SUM);
+			if(master)
+				printRow("multistream",run,messageSize,latencies,double(settings.numPipes*args[0].dataSize)/multiStreamTime/(1024.0*1024.0),stats.numResentPackets-numResentPackets,numErrors);
+			}
+		}
+	}
+
+int runCluster(const BenchmarkSettings& settings,const RunSettings& run)
+	{
+	/* Start the slave processes: */
+	std::vector<pid_t> slavePids;
+	for(unsigned int slaveIndex=1;slaveIndex<=run.numSlaves;++slaveIndex)
+		{
+		pid_t childPid=fork();
+		if(childPid==0)
+			{
+			/* Run the slave node and exit: */
+			int result=0;
+			try
+				{
+				runNode(settings,run,slaveIndex);
+				}
+			catch(const std::runtime_error& err)
+				{
+				std::cerr<<"Slave "<<slaveIndex<<": Caught exception "<<err.what()<<std::endl;
+				result=1;
+				}
+			_exit(result);
+			}
+		else if(childPid>0)
+			slavePids.push_back(childPid);
+		else
+			{
+			std::cerr<<"Unable to start slave process "<<slaveIndex<<std::endl;
+			return 1;
+			}
+		}
+	
+	/* Run the master node: */
+	int result=0;
+	try
+		{
+		runNode(settings,run,0);
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"Master: Caught exception "<<err.what()<<std::endl;
+		result=1;
+		}
+	
+	/* Wait for all slave processes to finish: */
+	for(std::vector<pid_t>::iterator spIt=slavePids.begin();spIt!=slavePids.end();++spIt)
+		{
+		int status;
+		waitpid(*spIt,&status,0);
+		if(!WIFEXITED(status)||WEXITSTATUS(status)!=0)
+			result=1;
+		}
+	
+	return result;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	BenchmarkSettings settings;
+	settings.masterHostName="localhost";
+	settings.basePort=26000;
+	settings.multicastGroup="239.255.26.1";
+	settings.mtuSize=1500;
+	settings.sendBufferSize=16;
+	settings.fecBlockSize=0;
+	settings.numDeliveryThreads=0;
+	settings.numPipes=1;
+	settings.slaveCounts=parseList<unsigned int>("1,2,4,8");
+	settings.fanouts=parseList<unsigned int>("0,2");
+	settings.messageSizes=parseList<size_t>("64,1024,16384,262144");
+	settings.lossRates=parseList<double>("0");
+	settings.numRounds=1000;
+	settings.dataSize=64*1024*1024;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"master")==0&&i+1<argc)
+				settings.masterHostName=argv[++i];
+			else if(strcasecmp(argv[i]+1,"basePort")==0&&i+1<argc)
+				settings.basePort=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"group")==0&&i+1<argc)
+				settings.multicastGroup=argv[++i];
+			else if(strcasecmp(argv[i]+1,"mtu")==0&&i+1<argc)
+				settings.mtuSize=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"sendBufferSize")==0&&i+1<argc)
+				settings.sendBufferSize=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"fecBlockSize")==0&&i+1<argc)
+				settings.fecBlockSize=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"numDeliveryThreads")==0&&i+1<argc)
+				settings.numDeliveryThreads=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"numPipes")==0&&i+1<argc)
+				settings.numPipes=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"slaveCounts")==0&&i+1<argc)
+				settings.slaveCounts=parseList<unsigned int>(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"fanouts")==0&&i+1<argc)
+				settings.fanouts=parseList<unsigned int>(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"messageSizes")==0&&i+1<argc)
+				settings.messageSizes=parseList<size_t>(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"lossRates")==0&&i+1<argc)
+				settings.lossRates=parseList<double>(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"numRounds")==0&&i+1<argc)
+				settings.numRounds=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"dataSize")==0&&i+1<argc)
+				settings.dataSize=size_t(atoi(argv[++i]))*1024*1024;
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	bool settingsValid=!settings.slaveCounts.empty()&&!settings.fanouts.empty()&&!settings.messageSizes.empty()&&!settings.lossRates.empty()&&settings.numRounds>=1;
+	for(std::vector<unsigned int>::iterator scIt=settings.slaveCounts.begin();scIt!=settings.slaveCounts.end();++scIt)
+		settingsValid=settingsValid&&*scIt>=1;
+	for(std::vector<size_t>::iterator msIt=settings.messageSizes.begin();msIt!=settings.messageSizes.end();++msIt)
+		settingsValid=settingsValid&&*msIt>=1;
+	if(!settingsValid)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-master <master host name>] [-basePort <port>] [-group <multicast group>] [-mtu <MTU size>] [-sendBufferSize <number of packets>] [-fecBlockSize <number of packets>] [-numDeliveryThreads <number of threads>] [-numPipes <number of pipes>] [-slaveCounts <n1,n2,...>] [-fanouts <f1,f2,...>] [-messageSizes <bytes1,bytes2,...>] [-lossRates <p1,p2,...>] [-numRounds <number of rounds>] [-dataSize <MB>]"<<std::endl;
+		return 1;
+		}
+	
+	/* Print the header of the comma-separated result table; latencies are in microseconds and goodput in MB/s: */
+	printf("test,slaves,fanout,lossRate,messageSize,rounds,median_us,p90_us,p99_us,max_us,goodput_MBps,resentPackets,errors\n");
+	fflush(stdout);
+	
+	/* Run a separate cluster on a fresh pair of ports for each combination of slave count, fanout, and loss rate: */
+	int result=0;
+	int port=settings.basePort;
+	for(std::vector<unsigned int>::iterator scIt=settings.slaveCounts.begin();scIt!=settings.slaveCounts.end();++scIt)
+		for(std::vector<unsigned int>::iterator fIt=settings.fanouts.begin();fIt!=settings.fanouts.end();++fIt)
+			for(std::vector<double>::iterator lrIt=settings.lossRates.begin();lrIt!=settings.lossRates.end();++lrIt)
+				{
+				RunSettings run;
+				run.numSlaves=*scIt;
+				run.fanout=*fIt;
+				run.lossRate=*lrIt;
+				run.masterPort=port;
+				run.slavePort=port+1;
+				port+=2;
+				
+				std::cerr<<"Running "<<run.numSlaves<<" slaves with fanout "<<run.fanout<<" and loss rate "<<run.lossRate<<"..."<<std::endl;
+				if(runCluster(settings,run)!=0)
+					result=1;
+				}
+	
+	return result;
+	}
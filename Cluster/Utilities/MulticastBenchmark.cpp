@@ -0,0 +1,369 @@
+/***********************************************************************
+MulticastBenchmark - Program to measure the throughput and latency of
+multicast pipes by running a master node and several slave nodes as
+local processes.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Cluster Abstraction Library (Cluster).
+
+The Cluster Abstraction Library is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Cluster Abstraction Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Cluster Abstraction Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <Math/Histogram.h>
+#include <Realtime/Time.h>
+#include <IO/File.h>
+#include <IO/OpenFile.h>
+#include <Cluster/Multiplexer.h>
+#include <Cluster/MulticastPipe.h>
+
+/**************
+Helper classes:
+**************/
+
+struct BenchmarkSettings // Structure holding the settings of a benchmark run
+	{
+	/* Elements: */
+	public:
+	unsigned int numSlaves; // Number of slave processes
+	const char* masterHostName; // Host name of the master node
+	int masterPort; // UDP port number of the master node
+	const char* multicastGroup; // Multicast group or broadcast address of the slave nodes
+	int slavePort; // UDP port number of the slave nodes
+	unsigned int mtuSize; // MTU size for the master's multiplexer
+	unsigned int sendBufferSize; // Number of packets in each pipe's send buffer
+	size_t dataSize; // Total amount of data to send in the throughput test in bytes
+	size_t messageSize; // Size of individual writes in the throughput test in bytes
+	size_t latencyMessageSize; // Size of messages in the latency test in bytes
+	unsigned int numRounds; // Number of rounds in the latency test
+	size_t reduceSize; // Number of values in the all-reduce test
+	unsigned int numReduceRounds; // Number of rounds in the all-reduce test
+	unsigned int fecBlockSize; // Number of packets covered by each forward error correction parity packet; 0 disables forward error correction
+	double lossRate; // Probability with which slaves drop incoming packets
+	const char* dataFileName; // Name of a file whose contents are sent in the throughput tests; synthetic data is sent if null
+	int compressionLevel; // Zlib compression level for an additional compressed throughput test; 0 disables the test
+	};
+
+/****************
+Helper functions:
+****************/
+
+double runThroughputTest(Cluster::MulticastPipe& pipe,const BenchmarkSettings& settings,const std::vector<char>& data,size_t& totalSize,unsigned int& numCorruptMessages)
+	{
+	/* Send the test data repeatedly in messages of the configured size until the configured amount of data has been sent: */
+	std::vector<char> buffer(settings.messageSize);
+	pipe.barrier();
+	Realtime::TimePointMonotonic throughputStart;
+	size_t dataPos=0;
+	for(totalSize=0;totalSize<settings.dataSize;)
+		{
+		/* Send the next message, wrapping around at the end of the test data: */
+		size_t messageSize=std::min(settings.messageSize,data.size()-dataPos);
+		if(pipe.isMaster())
+			pipe.writeRaw(&data[dataPos],messageSize);
+		else
+			{
+			pipe.readRaw(&buffer[0],messageSize);
+			if(memcmp(&buffer[0],&data[dataPos],messageSize)!=0)
+				++numCorruptMessages;
+			}
+		totalSize+=messageSize;
+		dataPos+=messageSize;
+		if(dataPos==data.size())
+			dataPos=0;
+		}
+	pipe.flush();
+	pipe.barrier();
+	return double(throughputStart.setAndDiff());
+	}
+
+void runNode(const BenchmarkSettings& settings,unsigned int nodeIndex)
+	{
+	/* Connect the node to the cluster: */
+	Cluster::Multiplexer multiplexer(settings.numSlaves,nodeIndex,settings.masterHostName,settings.masterPort,settings.multicastGroup,settings.slavePort);
+	if(nodeIndex==0)
+		{
+		multiplexer.setMTUSize(settings.mtuSize);
+		multiplexer.setSendBufferSize(settings.sendBufferSize);
+		multiplexer.setFecBlockSize(settings.fecBlockSize);
+		}
+	else
+		multiplexer.setPacketLossRate(settings.lossRate);
+	multiplexer.waitForConnection();
+	Cluster::MulticastPipe pipe(&multiplexer);
+	
+	/* Create a message buffer: */
+	size_t bufferSize=std::max(settings.messageSize,settings.latencyMessageSize);
+	std::vector<char> buffer(bufferSize);
+	for(size_t i=0;i<bufferSize;++i)
+		buffer[i]=char(i);
+	unsigned int numCorruptMessages=0;
+	
+	/*********************************************************************
+	Throughput test: Send the configured amount of data from the master
+	to all slaves and wait until all slaves have received it.
+	*********************************************************************/
+	
+	/* Use the contents of the data file or the synthetic message as test data: */
+	std::vector<char> data;
+	if(settings.dataFileName!=0)
+		{
+		IO::FilePtr dataFile(IO::openFile(settings.dataFileName));
+		char chunk[65536];
+		size_t chunkSize;
+		while((chunkSize=dataFile->readUpTo(chunk,sizeof(chunk)))>0)
+			data.insert(data.end(),chunk,chunk+chunkSize);
+		if(data.empty())
+			throw std::runtime_error("Empty data file");
+		}
+	else
+		data.assign(buffer.begin(),buffer.begin()+settings.messageSize);
+	
+	Cluster::Multiplexer::Statistics stats;
+	multiplexer.getStatistics(stats);
+	unsigned int numPacketsSent=stats.numPacketsSent;
+	size_t totalSize;
+	double throughputTime=runThroughputTest(pipe,settings,data,totalSize,numCorruptMessages);
+	multiplexer.getStatistics(stats);
+	numPacketsSent=stats.numPacketsSent-numPacketsSent;
+	
+	/* Repeat the throughput test in compressed mode: */
+	unsigned int numCompressedPacketsSent=0;
+	double compressedThroughputTime=0.0;
+	if(settings.compressionLevel!=0)
+		{
+		numCompressedPacketsSent=stats.numPacketsSent;
+		pipe.setCompressionLevel(settings.compressionLevel);
+		compressedThroughputTime=runThroughputTest(pipe,settings,data,totalSize,numCorruptMessages);
+		pipe.setCompressionLevel(0);
+		multiplexer.getStatistics(stats);
+		numCompressedPacketsSent=stats.numPacketsSent-numCompressedPacketsSent;
+		}
+	
+	/*********************************************************************
+	Latency test: Send a short message from the master to all slaves and
+	complete a barrier in each round.
+	*********************************************************************/
+	
+	Math::Histogram<double> roundTimes(1.0,0.0,100000.0); // Histogram of round times in microseconds
+	for(unsigned int round=0;round<settings.numRounds;++round)
+		{
+		Realtime::TimePointMonotonic roundStart;
+		pipe.broadcast(&buffer[0],settings.latencyMessageSize);
+		pipe.flush();
+		pipe.barrier();
+		roundTimes.addSample(double(roundStart.setAndDiff())*1.0e6);
+		}
+	
+	/*********************************************************************
+	All-reduce test: Sum arrays of values across all nodes and check the
+	result on all nodes.
+	*********************************************************************/
+	
+	unsigned int numNodes=multiplexer.getNumNodes();
+	std::vector<double> values(settings.reduceSize);
+	unsigned int numBadReductions=0;
+	Math::Histogram<double> reduceTimes(1.0,0.0,100000.0); // Histogram of all-reduce times in microseconds
+	for(unsigned int round=0;round<settings.numReduceRounds;++round)
+		{
+		for(size_t i=0;i<settings.reduceSize;++i)
+			values[i]=double(nodeIndex)+double(i);
+		Realtime::TimePointMonotonic reduceStart;
+		pipe.allReduce(&values[0],settings.reduceSize,Cluster::GatherOperation::SUM);
+		reduceTimes.addSample(double(reduceStart.setAndDiff())*1.0e6);
+		for(size_t i=0;i<settings.reduceSize;++i)
+			if(values[i]!=double(numNodes*(numNodes-1)/2)+double(numNodes)*double(i))
+				{
+				++numBadReductions;
+				break;
+				}
+		}
+	
+	/* Exchange each node's index and check the result on all nodes: */
+	std::vector<std::vector<char> > nodeData;
+	pipe.allGather(&nodeIndex,sizeof(unsigned int),nodeData);
+	for(unsigned int i=0;i<numNodes;++i)
+		if(nodeData[i].size()!=sizeof(unsigned int)||*reinterpret_cast<const unsigned int*>(&nodeData[i][0])!=i)
+			++numBadReductions;
+	
+	/* Accumulate the slaves' packet statistics: */
+	multiplexer.getStatistics(stats);
+	unsigned int numDroppedPackets=pipe.gather((unsigned int)(stats.numDroppedPackets),Cluster::GatherOperation::SUM);
+	unsigned int numRepairedPackets=pipe.gather((unsigned int)(stats.numRepairedPackets),Cluster::GatherOperation::SUM);
+	unsigned int numPacketLossMessages=pipe.gather((unsigned int)(stats.numPacketLossMessages),Cluster::GatherOperation::SUM);
+	numCorruptMessages=pipe.gather(numCorruptMessages,Cluster::GatherOperation::SUM);
+	numBadReductions=pipe.gather(numBadReductions,Cluster::GatherOperation::SUM);
+	
+	if(nodeIndex==0)
+		{
+		/* Print the results: */
+		std::cout<<"Slaves: "<<settings.numSlaves<<", MTU: "<<multiplexer.getMTUSize()<<" bytes, packet payload: "<<multiplexer.getMaxPacketSize()<<" bytes"<<std::endl;
+		std::cout<<"Throughput: "<<totalSize<<" bytes in "<<numPacketsSent<<" packets in "<<throughputTime*1000.0<<" ms, ";
+		std::cout<<double(totalSize)/throughputTime/(1024.0*1024.0)<<" MB/s, "<<double(numPacketsSent)/throughputTime<<" packets/s"<<std::endl;
+		if(settings.compressionLevel!=0)
+			{
+			std::cout<<"Compressed throughput (level "<<settings.compressionLevel<<"): "<<totalSize<<" bytes in "<<numCompressedPacketsSent<<" packets in "<<compressedThroughputTime*1000.0<<" ms, ";
+			std::cout<<double(totalSize)/compressedThroughputTime/(1024.0*1024.0)<<" MB/s, ";
+			std::cout<<"compression ratio "<<double(numPacketsSent)/double(numCompressedPacketsSent)<<std::endl;
+			}
+		
+		std::cout<<"Latency ("<<settings.latencyMessageSize<<" byte message + barrier, "<<settings.numRounds<<" rounds):";
+		std::cout<<" median "<<roundTimes.getPercentile(0.5)<<" us";
+		std::cout<<", 90% "<<roundTimes.getPercentile(0.9)<<" us";
+		std::cout<<", 99% "<<roundTimes.getPercentile(0.99)<<" us";
+		std::cout<<", max "<<roundTimes.getMaxValue()<<" us"<<std::endl;
+		
+		std::cout<<"All-reduce ("<<settings.reduceSize<<" doubles, "<<settings.numReduceRounds<<" rounds):";
+		std::cout<<" median "<<reduceTimes.getPercentile(0.5)<<" us";
+		std::cout<<", 90% "<<reduceTimes.getPercentile(0.9)<<" us";
+		std::cout<<", max "<<reduceTimes.getMaxValue()<<" us";
+		std::cout<<", "<<numBadReductions<<" wrong results"<<std::endl;
+		
+		std::cout<<"Packets: "<<stats.numPacketsSent<<" sent, "<<stats.numParityPacketsSent<<" parity packets sent (block size "<<multiplexer.getFecBlockSize()<<"), "<<stats.numResentPackets<<" resent"<<std::endl;
+		std::cout<<"Slaves: "<<numDroppedPackets<<" packets dropped, "<<numRepairedPackets<<" repaired, "<<numPacketLossMessages<<" packet loss messages, "<<numCorruptMessages<<" corrupted messages"<<std::endl;
+		}
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	BenchmarkSettings settings;
+	settings.numSlaves=2;
+	settings.masterHostName="localhost";
+	settings.masterPort=26000;
+	settings.multicastGroup="239.255.26.1";
+	settings.slavePort=26001;
+	settings.mtuSize=1500;
+	settings.sendBufferSize=16;
+	settings.dataSize=256*1024*1024;
+	settings.messageSize=64*1024;
+	settings.latencyMessageSize=64;
+	settings.numRounds=1000;
+	settings.reduceSize=16384;
+	settings.numReduceRounds=100;
+	settings.fecBlockSize=0;
+	settings.lossRate=0.0;
+	settings.dataFileName=0;
+	settings.compressionLevel=0;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"numSlaves")==0&&i+1<argc)
+				settings.numSlaves=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"master")==0&&i+1<argc)
+				settings.masterHostName=argv[++i];
+			else if(strcasecmp(argv[i]+1,"masterPort")==0&&i+1<argc)
+				settings.masterPort=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"group")==0&&i+1<argc)
+				settings.multicastGroup=argv[++i];
+			else if(strcasecmp(argv[i]+1,"slavePort")==0&&i+1<argc)
+				settings.slavePort=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"mtu")==0&&i+1<argc)
+				settings.mtuSize=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"sendBufferSize")==0&&i+1<argc)
+				settings.sendBufferSize=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"dataSize")==0&&i+1<argc)
+				settings.dataSize=size_t(atoi(argv[++i]))*1024*1024;
+			else if(strcasecmp(argv[i]+1,"messageSize")==0&&i+1<argc)
+				settings.messageSize=size_t(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"latencyMessageSize")==0&&i+1<argc)
+				settings.latencyMessageSize=size_t(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"numRounds")==0&&i+1<argc)
+				settings.numRounds=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"reduceSize")==0&&i+1<argc)
+				settings.reduceSize=size_t(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"numReduceRounds")==0&&i+1<argc)
+				settings.numReduceRounds=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"fecBlockSize")==0&&i+1<argc)
+				settings.fecBlockSize=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"lossRate")==0&&i+1<argc)
+				settings.lossRate=atof(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"dataFile")==0&&i+1<argc)
+				settings.dataFileName=argv[++i];
+			else if(strcasecmp(argv[i]+1,"compressionLevel")==0&&i+1<argc)
+				settings.compressionLevel=atoi(argv[++i]);
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	if(settings.numSlaves<1||settings.messageSize<1||settings.latencyMessageSize<1||settings.numRounds<1||settings.reduceSize<1||settings.numReduceRounds<1)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-numSlaves <number of slaves>] [-master <master host name>] [-masterPort <port>] [-group <multicast group>] [-slavePort <port>] [-mtu <MTU size>] [-sendBufferSize <number of packets>] [-dataSize <MB>] [-messageSize <bytes>] [-latencyMessageSize <bytes>] [-numRounds <number of rounds>] [-reduceSize <number of values>] [-numReduceRounds <number of rounds>] [-fecBlockSize <number of packets>] [-lossRate <probability>] [-dataFile <file name>] [-compressionLevel <zlib level>]"<<std::endl;
+		return 1;
+		}
+	
+	/* Start the slave processes: */
+	std::vector<pid_t> slavePids;
+	for(unsigned int slaveIndex=1;slaveIndex<=settings.numSlaves;++slaveIndex)
+		{
+		pid_t childPid=fork();
+		if(childPid==0)
+			{
+			/* Run the slave node and exit: */
+			int result=0;
+			try
+				{
+				runNode(settings,slaveIndex);
+				}
+			catch(std::runtime_error err)
+				{
+				std::cerr<<"Slave "<<slaveIndex<<": Caught exception "<<err.what()<<std::endl;
+				result=1;
+				}
+			_exit(result);
+			}
+		else if(childPid>0)
+			slavePids.push_back(childPid);
+		else
+			{
+			std::cerr<<"Unable to start slave process "<<slaveIndex<<std::endl;
+			return 1;
+			}
+		}
+	
+	/* Run the master node: */
+	int result=0;
+	try
+		{
+		runNode(settings,0);
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Master: Caught exception "<<err.what()<<std::endl;
+		result=1;
+		}
+	
+	/* Wait for all slave processes to finish: */
+	for(std::vector<pid_t>::iterator spIt=slavePids.begin();spIt!=slavePids.end();++spIt)
+		{
+		int status;
+		waitpid(*spIt,&status,0);
+		if(!WIFEXITED(status)||WEXITSTATUS(status)!=0)
+			result=1;
+		}
+	
+	return result;
+	}
@@ -61,6 +61,21 @@ class ArrayKdTree
 			}
 		};
 	
+	struct BatchQueryArgs // Structure to hold arguments for batched closest points query threads
+		{
+		/* Elements: */
+		public:
+		const ArrayKdTree* tree; // Pointer to the queried tree
+		const Point* queryPositions; // Array of all query positions
+		const int* queryOrder; // Indices of this thread's query positions in processing order
+		int numQueries; // Number of query positions processed by this thread
+		int numNeighbors; // Number of closest points to find for each query position
+		int* neighborIndices; // Array receiving the node indices of closest points for all query positions
+		Scalar* neighborSqrDists; // Array receiving the squared distances of closest points for all query positions, or null
+		};
+	
+	static const int batchBucketSize=16; // Subtrees with at most this many nodes are scanned as leaf buckets during batched queries
+	
 	/* Elements: */
 	private:
 	int numNodes; // Total number of nodes in kd-tree
@@ -70,6 +85,9 @@ class ArrayKdTree
 	void createTree(int left,int right,int splitDimension); // Creates sub-kd-tree
 	void* createTreeThreaded(const CreateSubTreeArgs* args); // Creates sub-kd-tree using multiple threads
 	void checkTree(int left,int right,int splitDimension,Scalar bbMin[],Scalar bbMax[]) const; // Checks if kd-tree has correct structure
+	static void sortQueries(int numQueries,const Point queryPositions[],int queryOrder[]); // Sorts query positions along a space-filling curve so that nearby queries are processed together
+	void findClosestPointsBucketed(const Point& queryPosition,int numNeighbors,int indices[],Scalar sqrDists[]) const; // Finds closest points for a single query position, scanning small subtrees as leaf buckets
+	static void* findClosestPointsThreaded(BatchQueryArgs* args); // Processes a range of batched queries in a background thread
 	template <class TraversalFunctionParam>
 	void traverseTree(int left,int right,TraversalFunctionParam& traversalFunction) const // Traverses sub-kd-tree in prefix order and calls traversal function for each node
 		{
@@ -174,6 +192,7 @@ class ArrayKdTree
 	const StoredPoint& findClosePoint(const Point& queryPosition) const; // Returns a stored point that is close to the query position
 	const StoredPoint& findClosestPoint(const Point& queryPosition) const; // Returns the stored point closest to the query position
 	ClosePointSet& findClosestPoints(const Point& queryPosition,ClosePointSet& closestPoints) const; // Returns a set of closest points
+	void findClosestPoints(int numQueries,const Point queryPositions[],int numNeighbors,int neighborIndices[],Scalar neighborSqrDists[],int numThreads =1) const; // Finds the given number of closest points for each query position; stores node indices (and squared distances if array is not null) in order of increasing distance, padded with -1 if the tree has fewer points
 	};
 
 }
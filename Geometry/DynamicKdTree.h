@@ -0,0 +1,145 @@
+/***********************************************************************
+DynamicKdTree - Class to store k-dimensional points in a kd-tree that
+supports inserting and removing individual points without rebuilding the
+entire tree, using a logarithmic set of balanced array kd-trees.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Templatized Geometry Library (TGL).
+
+The Templatized Geometry Library is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Templatized Geometry Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Templatized Geometry Library; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef GEOMETRY_DYNAMICKDTREE_INCLUDED
+#define GEOMETRY_DYNAMICKDTREE_INCLUDED
+
+#include <vector>
+#include <Geometry/Point.h>
+#include <Geometry/Box.h>
+#include <Geometry/ClosePointSet.h>
+#include <Geometry/ArrayKdTree.h>
+
+namespace Geometry {
+
+template <class StoredPointParam>
+class DynamicKdTree
+	{
+	/* Embedded classes: */
+	public:
+	typedef StoredPointParam StoredPoint; // Type of points stored in kd-tree (typically with some associated value)
+	typedef typename StoredPoint::Point Point; // Type for positions
+	typedef typename Point::Scalar Scalar; // Scalar type used by points
+	static const int dimension=Point::dimension; // Dimension of points and kd-tree
+	typedef Geometry::Box<Scalar,dimension> Box; // Type for boxes in kd-tree's domain space
+	typedef Geometry::ClosePointSet<StoredPoint> ClosePointSet; // Type for nearest neighbours query results
+	typedef int Handle; // Type for handles identifying stored points between insertion and removal
+	
+	private:
+	struct Node:public StoredPoint // Structure for stored points, tagged with their handles and removal flags
+		{
+		/* Elements: */
+		public:
+		Handle handle; // Handle of the stored point
+		bool removed; // Flag if the point has been removed from the tree, but not yet from its level's array kd-tree
+		
+		/* Constructors and destructors: */
+		Node(void)
+			{
+			}
+		Node(const StoredPoint& sPoint,Handle sHandle)
+			:StoredPoint(sPoint),handle(sHandle),removed(false)
+			{
+			}
+		};
+	
+	typedef ArrayKdTree<Node> Level; // Type for balanced kd-trees holding the levels of the logarithmic set
+	
+	struct Location // Structure to locate stored points by their handles
+		{
+		/* Elements: */
+		public:
+		int level; // Index of level containing the point, or -1 if the point is in the insertion buffer
+		int index; // Index of the point in its level's node array or the insertion buffer
+		};
+	
+	static const int maxNumLevels=32; // Maximum number of levels in the logarithmic set
+	
+	/* Elements: */
+	int bufferSize; // Number of points collected in the unsorted insertion buffer before they are merged into a level
+	std::vector<Node> buffer; // Unsorted insertion buffer, searched linearly
+	int numLevels; // Number of levels that have been used so far
+	Level levels[maxNumLevels]; // Array of levels; level i holds at most bufferSize*2^i points, including removed ones
+	int levelNumRemoved[maxNumLevels]; // Number of removed points still held in each level
+	int numPoints; // Number of stored points that have not been removed
+	int numRemoved; // Number of removed points still held in levels
+	std::vector<Location> locations; // Locations of stored points, indexed by handle
+	std::vector<Handle> freeHandles; // Stack of handles that can be assigned to new points
+	
+	/* Private methods: */
+	Handle allocateHandle(void); // Returns an unused handle
+	void insertNode(const Node& node); // Inserts the given node into the insertion buffer
+	void mergeBuffer(void); // Merges the insertion buffer and as many lower levels as necessary into the lowest empty level that can hold all their points
+	void removeNode(Handle handle); // Removes the node of the given handle from the buffer, or marks it as removed in its level
+	void compact(void); // Rebuilds the tree from remaining points if too many removed points are held in levels
+	
+	/* Constructors and destructors: */
+	public:
+	DynamicKdTree(int sBufferSize =32); // Creates an empty kd-tree with the given insertion buffer size
+	private:
+	DynamicKdTree(const DynamicKdTree& source); // Prohibit copy constructor
+	DynamicKdTree& operator=(const DynamicKdTree& source); // Prohibit assignment operator
+	
+	/* Methods: */
+	public:
+	int getNumPoints(void) const // Returns the number of points in the tree
+		{
+		return numPoints;
+		}
+	bool isEmpty(void) const // Returns true if the tree does not contain any points
+		{
+		return numPoints==0;
+		}
+	const StoredPoint& getPoint(Handle handle) const // Returns the stored point of the given handle
+		{
+		const Location& l=locations[handle];
+		if(l.level<0)
+			return buffer[l.index];
+		else
+			return levels[l.level].getNode(l.index);
+		}
+	void clear(void); // Removes all points from the tree
+	void setPoints(int newNumPoints,const StoredPoint newPoints[],Handle newHandles[] =0); // Replaces the tree's contents with a balanced kd-tree of the given points; stores their handles if array is not null
+	Handle insertPoint(const StoredPoint& newPoint); // Inserts a point into the tree and returns its handle
+	void insertPoints(int numNewPoints,const StoredPoint newPoints[],Handle newHandles[] =0); // Inserts an array of points into the tree; stores their handles if array is not null
+	void removePoint(Handle handle); // Removes the point of the given handle from the tree; handle can be reused for later insertions
+	void movePoint(Handle handle,const StoredPoint& newPoint); // Replaces the point of the given handle with the given point; handle stays valid
+	void checkTree(void) const; // Checks the tree for consistency
+	template <class TraversalFunctionParam>
+	void traverseTree(TraversalFunctionParam& traversalFunction) const; // Calls traversal function for each point in the tree, in unspecified order
+	template <class TraversalFunctionParam>
+	void traverseTreeInBox(const Box& box,TraversalFunctionParam& traversalFunction) const; // Calls traversal function for each point inside the given box, in unspecified order
+	template <class DirectedTraversalFunctionParam>
+	void traverseTreeDirected(DirectedTraversalFunctionParam& traversalFunction) const; // Calls traversal function for points in the tree in directed order; return value is ignored for points in the insertion buffer
+	const StoredPoint& findClosestPoint(const Point& queryPosition) const; // Returns the stored point closest to the query position; tree must not be empty
+	ClosePointSet& findClosestPoints(const Point& queryPosition,ClosePointSet& closestPoints) const; // Returns a set of closest points
+	};
+
+}
+
+#if !defined(GEOMETRY_DYNAMICKDTREE_IMPLEMENTATION)
+#include <Geometry/DynamicKdTree.icpp>
+#endif
+
+#endif
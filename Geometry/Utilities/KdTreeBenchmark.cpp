@@ -0,0 +1,361 @@
+/***********************************************************************
+KdTreeBenchmark - Program to compare the speed of single and batched
+closest point queries on kd-trees holding large point clouds, or of
+rebuilt and dynamically updated kd-trees holding streaming point clouds,
+and to check that both produce identical results.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Templatized Geometry Library (TGL).
+
+The Templatized Geometry Library is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Templatized Geometry Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Templatized Geometry Library; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#include <Math/Math.h>
+#include <Math/Random.h>
+#include <Geometry/Point.h>
+#include <Geometry/ValuedPoint.h>
+#include <Geometry/ArrayKdTree.h>
+#include <Geometry/DynamicKdTree.h>
+#include <Realtime/Time.h>
+
+/**********************
+Benchmarked tree types:
+**********************/
+
+typedef Geometry::Point<float,3> Point;
+typedef Geometry::ValuedPoint<Point,unsigned int> StoredPoint;
+typedef Geometry::ArrayKdTree<StoredPoint> Tree;
+typedef Geometry::DynamicKdTree<StoredPoint> DynamicTree;
+
+/****************
+Helper functions:
+****************/
+
+std::vector<int> parseList(const char* list) // Parses a comma-separated list of numbers
+	{
+	std::vector<int> result;
+	const char* lPtr=list;
+	while(*lPtr!='\0')
+		{
+		char* endPtr;
+		result.push_back(int(strtol(lPtr,&endPtr,10)));
+		lPtr=endPtr;
+		if(*lPtr==',')
+			++lPtr;
+		else if(*lPtr!='\0')
+			{
+			result.clear();
+			break;
+			}
+		}
+	return result;
+	}
+
+Point randomPoint(void) // Returns a point on a noisy sphere to mimic a scanned surface
+	{
+	Point result;
+	float len2;
+	do
+		{
+		for(int i=0;i<3;++i)
+			result[i]=float(Math::randUniformCC(-1.0,1.0));
+		len2=float(Geometry::sqr(result));
+		}
+	while(len2>1.0f||len2<1.0e-4f);
+	float scale=(1.0f+float(Math::randUniformCC(-0.01,0.01)))/Math::sqrt(len2);
+	for(int i=0;i<3;++i)
+		result[i]*=scale;
+	return result;
+	}
+
+bool checkSmallBatches(const Tree& tree) // Checks that batches with fewer queries than sorting grid cells, or with non-finite query positions, match single queries
+	{
+	/* Create a batch of queries where some have non-finite coordinates: */
+	const int numQueries=7;
+	Point queries[numQueries];
+	for(int i=0;i<numQueries;++i)
+		queries[i]=randomPoint();
+	float inf=float(HUGE_VAL);
+	queries[2][0]=inf;
+	queries[5][1]=inf-inf; // NaN
+	
+	bool identical=true;
+	for(int n=1;n<=numQueries;++n)
+		{
+		/* Run the first n queries in a batch and compare the finite ones to single queries: */
+		int batchIndices[numQueries];
+		float batchDists[numQueries];
+		tree.findClosestPoints(n,queries,1,batchIndices,batchDists,1);
+		for(int i=0;i<n;++i)
+			if(Math::isFinite(queries[i][0])&&Math::isFinite(queries[i][1]))
+				identical=identical&&batchDists[i]==float(Geometry::sqrDist(tree.findClosestPoint(queries[i]),queries[i]));
+		}
+	return identical;
+	}
+
+class ValueCollector // Traversal function collecting the values of all traversed points
+	{
+	/* Elements: */
+	public:
+	std::vector<unsigned int> values; // Values of traversed points
+	
+	/* Methods: */
+	void operator()(const StoredPoint& point)
+		{
+		values.push_back(point.value);
+		}
+	};
+
+bool compareBoxQueries(const Tree& tree,const DynamicTree& dynamicTree,const DynamicTree::Box& box) // Returns true if both trees find the same points inside the given box
+	{
+	ValueCollector treeValues,dynamicValues;
+	tree.traverseTreeInBox(box,treeValues);
+	dynamicTree.traverseTreeInBox(box,dynamicValues);
+	std::sort(treeValues.values.begin(),treeValues.values.end());
+	std::sort(dynamicValues.values.begin(),dynamicValues.values.end());
+	return treeValues.values==dynamicValues.values;
+	}
+
+bool compareClosestPoints(const Tree& tree,const DynamicTree& dynamicTree,const Point& query,int numNeighbors) // Returns true if both trees find closest points at the same distances from the given query position
+	{
+	Tree::ClosePointSet treePoints(numNeighbors);
+	DynamicTree::ClosePointSet dynamicPoints(numNeighbors);
+	tree.findClosestPoints(query,treePoints);
+	dynamicTree.findClosestPoints(query,dynamicPoints);
+	if(treePoints.getNumPoints()!=dynamicPoints.getNumPoints())
+		return false;
+	for(int i=0;i<treePoints.getNumPoints();++i)
+		if(treePoints.getSqrDist(i)!=dynamicPoints.getSqrDist(i))
+			return false;
+	return true;
+	}
+
+int benchmarkStreaming(int numPoints,int numQueries,const std::vector<int>& batchSizes) // Compares rebuilding and dynamically updating kd-trees over a sliding window of streaming points
+	{
+	/* Print the header of the comma-separated result table: */
+	printf("batch_size,steps,rebuild_update_us,dynamic_update_us,update_speedup,rebuild_query_ns,dynamic_query_ns,identical\n");
+	
+	int result=0;
+	for(std::vector<int>::const_iterator bsIt=batchSizes.begin();bsIt!=batchSizes.end();++bsIt)
+		{
+		int batchSize=*bsIt;
+		if(batchSize<1||batchSize>numPoints)
+			continue;
+		
+		/* Fill both trees with the initial window of points: */
+		std::vector<StoredPoint> window(numPoints);
+		for(int i=0;i<numPoints;++i)
+			window[i]=StoredPoint(randomPoint(),(unsigned int)(i));
+		Tree tree(numPoints,&window[0]);
+		DynamicTree dynamicTree;
+		std::vector<DynamicTree::Handle> handles(numPoints);
+		dynamicTree.setPoints(numPoints,&window[0],&handles[0]);
+		
+		/* Replace the oldest batch of points with a new batch, and move a quarter batch of random points, until the entire window has been replaced: */
+		int numSteps=numPoints/batchSize;
+		int queriesPerStep=numQueries/numSteps+1;
+		int movesPerStep=batchSize/4+1;
+		int checkInterval=numSteps>16?numSteps/16:1;
+		std::vector<StoredPoint> batch(batchSize);
+		std::vector<int> moves(movesPerStep);
+		double rebuildUpdateTime=0.0,dynamicUpdateTime=0.0;
+		double rebuildQueryTime=0.0,dynamicQueryTime=0.0;
+		bool identical=true;
+		for(int step=0;step<numSteps;++step)
+			{
+			/* Create the new batch of points: */
+			int first=step*batchSize;
+			for(int i=0;i<batchSize;++i)
+				batch[i]=window[first+i]=StoredPoint(randomPoint(),(unsigned int)(numPoints+first+i));
+			
+			/* Move random points of the window, keeping their values: */
+			for(int i=0;i<movesPerStep;++i)
+				{
+				moves[i]=Math::randUniformCO(0,numPoints);
+				window[moves[i]]=StoredPoint(randomPoint(),window[moves[i]].value);
+				}
+			
+			/* Rebuild the array kd-tree from the entire window: */
+			Realtime::TimePointMonotonic start;
+			tree.setPoints(numPoints,&window[0]);
+			rebuildUpdateTime+=double(start.setAndDiff());
+			
+			/* Update the dynamic kd-tree; a point moved several times ends up at its last position, which is also in the window: */
+			for(int i=0;i<batchSize;++i)
+				dynamicTree.removePoint(handles[first+i]);
+			dynamicTree.insertPoints(batchSize,&batch[0],&handles[first]);
+			for(int i=0;i<movesPerStep;++i)
+				dynamicTree.movePoint(handles[moves[i]],window[moves[i]]);
+			dynamicUpdateTime+=double(start.setAndDiff());
+			
+			/* Check the dynamic kd-tree's structure about 16 times per run, as each check visits all points; inconsistencies are printed: */
+			if((step+1)%checkInterval==0||step==numSteps-1)
+				dynamicTree.checkTree();
+			identical=identical&&dynamicTree.getNumPoints()==numPoints;
+			
+			/* Query both trees: */
+			std::vector<Point> queries(queriesPerStep);
+			for(int i=0;i<queriesPerStep;++i)
+				queries[i]=randomPoint();
+			std::vector<float> dists(queriesPerStep);
+			start.set();
+			for(int i=0;i<queriesPerStep;++i)
+				dists[i]=float(Geometry::sqrDist(tree.findClosestPoint(queries[i]),queries[i]));
+			rebuildQueryTime+=double(start.setAndDiff());
+			for(int i=0;i<queriesPerStep;++i)
+				identical=identical&&float(Geometry::sqrDist(dynamicTree.findClosestPoint(queries[i]),queries[i]))==dists[i];
+			dynamicQueryTime+=double(start.setAndDiff());
+			
+			/* Compare k-nearest neighbor and box queries on both trees: */
+			for(int i=0;i<queriesPerStep&&identical;++i)
+				identical=compareClosestPoints(tree,dynamicTree,queries[i],8);
+			DynamicTree::Box box(queries[0]-Point::Vector(0.05f,0.05f,0.05f),queries[0]+Point::Vector(0.05f,0.05f,0.05f));
+			identical=identical&&compareBoxQueries(tree,dynamicTree,box);
+			}
+		
+		double numStepQueries=double(numSteps)*double(queriesPerStep);
+		printf("%d,%d,%.1f,%.1f,%.2f,%.1f,%.1f,%s\n",batchSize,numSteps,rebuildUpdateTime*1.0e6/double(numSteps),dynamicUpdateTime*1.0e6/double(numSteps),rebuildUpdateTime/dynamicUpdateTime,rebuildQueryTime*1.0e9/numStepQueries,dynamicQueryTime*1.0e9/numStepQueries,identical?"yes":"no");
+		fflush(stdout);
+		if(!identical)
+			result=1;
+		}
+	
+	return result;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	int numPoints=1000000;
+	int numQueries=1000000;
+	std::vector<int> neighborCounts=parseList("1,8,32");
+	std::vector<int> threadCounts=parseList("1,2,4");
+	bool stream=false;
+	std::vector<int> streamBatchSizes;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"numPoints")==0&&i+1<argc)
+				numPoints=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"numQueries")==0&&i+1<argc)
+				numQueries=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"neighbors")==0&&i+1<argc)
+				neighborCounts=parseList(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"threadCounts")==0&&i+1<argc)
+				threadCounts=parseList(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"stream")==0&&i+1<argc)
+				{
+				stream=true;
+				streamBatchSizes=parseList(argv[++i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	if(numPoints<1||numQueries<1||neighborCounts.empty()||threadCounts.empty()||(stream&&streamBatchSizes.empty()))
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-numPoints <number of points>] [-numQueries <number of queries>] [-neighbors <k1,k2,...>] [-threadCounts <t1,t2,...>] [-stream <b1,b2,...>]"<<std::endl;
+		std::cerr<<"With -stream, compares rebuilt and dynamic kd-trees while replacing the points in batches of the given sizes and moving a quarter batch of points per step"<<std::endl;
+		return 1;
+		}
+	
+	if(stream)
+		return benchmarkStreaming(numPoints,numQueries,streamBatchSizes);
+	
+	/* Create the point cloud and the kd-tree: */
+	std::cerr<<"Creating kd-tree of "<<numPoints<<" points..."<<std::flush;
+	Tree tree(numPoints);
+	StoredPoint* points=tree.accessPoints();
+	for(int i=0;i<numPoints;++i)
+		points[i]=StoredPoint(randomPoint(),(unsigned int)(i));
+	tree.releasePoints();
+	std::cerr<<" done"<<std::endl;
+	
+	/* Check edge cases of batched queries: */
+	int result=0;
+	if(!checkSmallBatches(tree))
+		{
+		std::cerr<<"Batched queries with few or non-finite query positions do not match single queries"<<std::endl;
+		result=1;
+		}
+	
+	/* Create query positions near the point cloud in random order: */
+	std::vector<Point> queries(numQueries);
+	for(int i=0;i<numQueries;++i)
+		queries[i]=randomPoint();
+	
+	/* Print the header of the comma-separated result table: */
+	printf("neighbors,threads,single_ns,batched_ns,speedup,identical\n");
+	
+	for(std::vector<int>::iterator ncIt=neighborCounts.begin();ncIt!=neighborCounts.end();++ncIt)
+		{
+		int k=*ncIt;
+		if(k<1)
+			continue;
+		
+		/* Run all queries one at a time: */
+		std::vector<float> singleDists(size_t(numQueries)*k);
+		Realtime::TimePointMonotonic start;
+		if(k==1)
+			{
+			for(int i=0;i<numQueries;++i)
+				singleDists[i]=float(Geometry::sqrDist(tree.findClosestPoint(queries[i]),queries[i]));
+			}
+		else
+			{
+			Tree::ClosePointSet closestPoints(k);
+			for(int i=0;i<numQueries;++i)
+				{
+				tree.findClosestPoints(queries[i],closestPoints);
+				for(int j=0;j<k;++j)
+					singleDists[size_t(i)*k+j]=closestPoints.getSqrDist(j);
+				}
+			}
+		double singleTime=double(start.setAndDiff());
+		
+		/* Run all queries in a batch for each number of threads: */
+		std::vector<int> batchIndices(size_t(numQueries)*k);
+		std::vector<float> batchDists(size_t(numQueries)*k);
+		for(std::vector<int>::iterator tcIt=threadCounts.begin();tcIt!=threadCounts.end();++tcIt)
+			{
+			start.set();
+			tree.findClosestPoints(numQueries,&queries[0],k,&batchIndices[0],&batchDists[0],*tcIt);
+			double batchTime=double(start.setAndDiff());
+			
+			/* Compare the results: */
+			bool identical=true;
+			for(size_t i=0;i<batchDists.size()&&identical;++i)
+				identical=batchDists[i]==singleDists[i]&&batchIndices[i]>=0;
+			
+			printf("%d,%d,%.1f,%.1f,%.2f,%s\n",k,*tcIt,singleTime*1.0e9/double(numQueries),batchTime*1.0e9/double(numQueries),singleTime/batchTime,identical?"yes":"no");
+			fflush(stdout);
+			if(!identical)
+				result=1;
+			}
+		}
+	
+	return result;
+	}
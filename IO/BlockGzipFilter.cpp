@@ -0,0 +1,733 @@
+/***********************************************************************
+BlockGzipFilter - Class to read and write block-gzip (BGZF) compressed
+files, which consist of independently compressed gzip members followed
+by a block index, using a pool of background compression threads.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the I/O Support Library (IO).
+
+The I/O Support Library is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License as published
+by the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+The I/O Support Library is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the I/O Support Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <IO/BlockGzipFilter.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <string>
+#include <algorithm>
+#include <Misc/ThrowStdErr.h>
+
+namespace IO {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+const size_t maxMemberSize=65536; // Maximum size of a block's gzip member, and of its uncompressed data
+const size_t defaultBlockSize=0xff00; // Uncompressed size of written blocks, leaving room for incompressible data
+const size_t headerSize=18; // Size of a data block's gzip member header
+const size_t trailerSize=8; // Size of a gzip member's CRC-32 and uncompressed size trailer
+const size_t maxIndexEntries=16384; // Maximum number of block sizes stored in a single index member
+const size_t indexTrailerSize=52; // Size of the empty gzip member pointing to the block index
+const unsigned char eofMember[28]= // Standard BGZF end-of-file marker
+	{
+	0x1fU,0x8bU,0x08U,0x04U,0x00U,0x00U,0x00U,0x00U,0x00U,0xffU,0x06U,0x00U,0x42U,0x43U,0x02U,0x00U,
+	0x1bU,0x00U,0x03U,0x00U,0x00U,0x00U,0x00U,0x00U,0x00U,0x00U,0x00U,0x00U
+	};
+
+inline unsigned int getUInt16(const unsigned char* data) // Extracts a little-endian 16-bit unsigned integer
+	{
+	return (unsigned int)(data[0])|((unsigned int)(data[1])<<8);
+	}
+
+inline unsigned int getUInt32(const unsigned char* data) // Extracts a little-endian 32-bit unsigned integer
+	{
+	return (unsigned int)(data[0])|((unsigned int)(data[1])<<8)|((unsigned int)(data[2])<<16)|((unsigned int)(data[3])<<24);
+	}
+
+inline SeekableFile::Offset getUInt64(const unsigned char* data) // Extracts a little-endian 64-bit unsigned integer
+	{
+	return SeekableFile::Offset(getUInt32(data))|(SeekableFile::Offset(getUInt32(data+4))<<32);
+	}
+
+inline unsigned char* putUInt16(unsigned char* data,unsigned int value) // Stores a little-endian 16-bit unsigned integer
+	{
+	data[0]=(unsigned char)(value&0xffU);
+	data[1]=(unsigned char)((value>>8)&0xffU);
+	return data+2;
+	}
+
+inline unsigned char* putUInt32(unsigned char* data,unsigned int value) // Stores a little-endian 32-bit unsigned integer
+	{
+	data=putUInt16(data,value&0xffffU);
+	return putUInt16(data,(value>>16)&0xffffU);
+	}
+
+inline unsigned char* putUInt64(unsigned char* data,SeekableFile::Offset value) // Stores a little-endian 64-bit unsigned integer
+	{
+	data=putUInt32(data,(unsigned int)(value&0xffffffffU));
+	return putUInt32(data,(unsigned int)((value>>32)&0xffffffffU));
+	}
+
+unsigned char* putMemberHeader(unsigned char* data,size_t memberSize,size_t extraSize) // Stores a gzip member header with a "BC" subfield followed by room for extra subfields of the given size
+	{
+	static const unsigned char fixedHeader[10]={0x1fU,0x8bU,0x08U,0x04U,0x00U,0x00U,0x00U,0x00U,0x00U,0xffU};
+	memcpy(data,fixedHeader,sizeof(fixedHeader));
+	data=putUInt16(data+sizeof(fixedHeader),(unsigned int)(6+extraSize));
+	*(data++)='B';
+	*(data++)='C';
+	data=putUInt16(data,2);
+	return putUInt16(data,(unsigned int)(memberSize-1));
+	}
+
+bool compressBlock(z_stream& stream,const unsigned char* uncompressed,size_t uncompressedSize,unsigned char* member,size_t& memberSize) // Compresses a block of data into a complete gzip member
+	{
+	/* Compress the data into the member's payload area: */
+	if(deflateReset(&stream)!=Z_OK)
+		return false;
+	stream.next_in=const_cast<Bytef*>(uncompressed);
+	stream.avail_in=uncompressedSize;
+	stream.next_out=member+headerSize;
+	stream.avail_out=maxMemberSize-headerSize-trailerSize;
+	int result=deflate(&stream,Z_FINISH);
+	if(result!=Z_STREAM_END)
+		{
+		/* Store the data without compression if compressing it would overflow the member: */
+		if(deflateReset(&stream)!=Z_OK||deflateParams(&stream,Z_NO_COMPRESSION,Z_DEFAULT_STRATEGY)!=Z_OK)
+			return false;
+		stream.next_in=const_cast<Bytef*>(uncompressed);
+		stream.avail_in=uncompressedSize;
+		stream.next_out=member+headerSize;
+		stream.avail_out=maxMemberSize-headerSize-trailerSize;
+		result=deflate(&stream,Z_FINISH);
+		
+		/* Restore the default compression level for the next block: */
+		if(deflateReset(&stream)!=Z_OK||deflateParams(&stream,Z_DEFAULT_COMPRESSION,Z_DEFAULT_STRATEGY)!=Z_OK||result!=Z_STREAM_END)
+			return false;
+		}
+	
+	/* Finish the gzip member: */
+	memberSize=headerSize+(maxMemberSize-headerSize-trailerSize-stream.avail_out)+trailerSize;
+	putMemberHeader(member,memberSize,0);
+	unsigned char* trailer=member+memberSize-trailerSize;
+	trailer=putUInt32(trailer,(unsigned int)(crc32(crc32(0L,Z_NULL,0),uncompressed,uncompressedSize)));
+	putUInt32(trailer,(unsigned int)(uncompressedSize));
+	
+	return true;
+	}
+
+bool decompressBlock(z_stream& stream,const unsigned char* member,size_t memberSize,unsigned char* uncompressed,size_t uncompressedSize) // Decompresses a complete gzip member into a block of data of the expected size
+	{
+	/* Locate the member's payload: */
+	if(memberSize<12+trailerSize)
+		return false;
+	size_t payloadStart=12+getUInt16(member+10);
+	if(payloadStart+trailerSize>memberSize||getUInt32(member+memberSize-4)!=uncompressedSize)
+		return false;
+	
+	/* Decompress the payload: */
+	if(inflateReset(&stream)!=Z_OK)
+		return false;
+	stream.next_in=const_cast<Bytef*>(member+payloadStart);
+	stream.avail_in=memberSize-trailerSize-payloadStart;
+	stream.next_out=uncompressed;
+	stream.avail_out=uncompressedSize;
+	if(inflate(&stream,Z_FINISH)!=Z_STREAM_END||stream.avail_out!=0)
+		return false;
+	
+	/* Check the uncompressed data's checksum: */
+	return (unsigned int)(crc32(crc32(0L,Z_NULL,0),uncompressed,uncompressedSize))==getUInt32(member+memberSize-trailerSize);
+	}
+
+}
+
+/********************************
+Methods of class BlockGzipFilter:
+********************************/
+
+size_t BlockGzipFilter::readData(File::Byte* buffer,size_t bufferSize)
+	{
+	/* Check for end-of-file: */
+	if(readPos>=uncompressedSize)
+		return 0;
+	
+	/* Find the block containing the current read position: */
+	size_t blockIndex;
+	if(blockSize!=0)
+		blockIndex=size_t(readPos/Offset(blockSize));
+	else
+		blockIndex=(std::upper_bound(blocks.begin(),blocks.end(),readPos,Block::upperBoundCompare)-blocks.begin())-1;
+	
+	/* Queue the block and the blocks following it for decompression: */
+	scheduleBlock(blockIndex,true);
+	for(size_t i=1;i<numSlots&&blockIndex+i<blocks.size();++i)
+		scheduleBlock(blockIndex+i,false);
+	
+	/* Wait until the block is decompressed: */
+	Slot& slot=slots[blockIndex%numSlots];
+	{
+	Threads::Mutex::Lock slotLock(slotMutex);
+	while(slot.state==QUEUED)
+		slotCond.wait(slotMutex);
+	}
+	if(slot.state==FAILED)
+		{
+		/* Release the slot and signal an error: */
+		slot.blockIndex=~size_t(0);
+		slot.state=EMPTY;
+		Misc::throwStdErr("IO::BlockGzipFilter: Data corruption detected in block %u",(unsigned int)(blockIndex));
+		}
+	
+	/* Read directly from the slot's buffer, starting at the current read position: */
+	size_t blockOffset=size_t(readPos-blocks[blockIndex].uncompressedPos);
+	size_t readSize=slot.uncompressedSize-blockOffset;
+	setReadBuffer(readSize,slot.uncompressed+blockOffset,false);
+	readPos+=Offset(readSize);
+	
+	return readSize;
+	}
+
+void BlockGzipFilter::writeData(const File::Byte* buffer,size_t bufferSize)
+	{
+	/* Block-gzip files can only be written sequentially: */
+	if(writePos!=uncompressedSize)
+		throw SeekError(writePos);
+	
+	while(bufferSize>0)
+		{
+		/* Wait until the next block's slot is free: */
+		writeBlocks(numSlots-1);
+		
+		/* Copy the next block's worth of data into its slot: */
+		Slot& slot=slots[blocks.size()%numSlots];
+		size_t writeSize=std::min(bufferSize,blockSize);
+		memcpy(slot.uncompressed,buffer,writeSize);
+		slot.uncompressedSize=writeSize;
+		slot.blockIndex=blocks.size();
+		
+		/* Add the block to the block list: */
+		Block newBlock;
+		newBlock.compressedPos=0;
+		newBlock.compressedSize=0;
+		newBlock.uncompressedPos=uncompressedSize;
+		blocks.push_back(newBlock);
+		uncompressedSize+=Offset(writeSize);
+		
+		/* Queue the block for compression: */
+		{
+		Threads::Mutex::Lock slotLock(slotMutex);
+		slot.state=QUEUED;
+		jobs.push_back(&slot);
+		jobCond.signal();
+		}
+		
+		buffer+=writeSize;
+		bufferSize-=writeSize;
+		writePos+=Offset(writeSize);
+		}
+	
+	/* Write any blocks that are already compressed: */
+	writeBlocks(numSlots);
+	}
+
+bool BlockGzipFilter::readIndex(void)
+	{
+	try
+		{
+		/* Read the index trailer and end-of-file members from the end of the compressed file: */
+		Offset fileSize=seekableCompressedFile->getSize();
+		unsigned char tail[indexTrailerSize+sizeof(eofMember)];
+		if(fileSize<Offset(sizeof(tail)))
+			return false;
+		seekableCompressedFile->setReadPosAbs(fileSize-Offset(sizeof(tail)));
+		seekableCompressedFile->readRaw(tail,sizeof(tail));
+		if(memcmp(tail+indexTrailerSize,eofMember,sizeof(eofMember))!=0)
+			return false;
+		
+		/* Check the index trailer member: */
+		unsigned char expectedHeader[22];
+		unsigned char* ehPtr=putMemberHeader(expectedHeader,indexTrailerSize,24);
+		*(ehPtr++)='V';
+		*(ehPtr++)='E';
+		putUInt16(ehPtr,20);
+		if(memcmp(tail,expectedHeader,sizeof(expectedHeader))!=0)
+			return false;
+		Offset indexPos=getUInt64(tail+22);
+		Offset fileUncompressedSize=getUInt64(tail+30);
+		size_t fileBlockSize=getUInt32(tail+38);
+		Offset indexEnd=fileSize-Offset(sizeof(tail));
+		if(fileBlockSize==0||fileBlockSize>maxMemberSize||indexPos>indexEnd)
+			return false;
+		
+		/* Read the compressed sizes of all blocks from the index members: */
+		std::vector<Block> newBlocks;
+		Offset compressedPos=0;
+		Offset uncompressedPos=0;
+		Offset memberPos=indexPos;
+		seekableCompressedFile->setReadPosAbs(memberPos);
+		while(memberPos<indexEnd)
+			{
+			/* Read and check the index member's header: */
+			unsigned char header[22];
+			seekableCompressedFile->readRaw(header,sizeof(header));
+			size_t payloadSize=getUInt16(header+20);
+			size_t memberSize=sizeof(header)+payloadSize+2+trailerSize;
+			ehPtr=putMemberHeader(expectedHeader,memberSize,4+payloadSize);
+			*(ehPtr++)='V';
+			*(ehPtr++)='I';
+			putUInt16(ehPtr,(unsigned int)(payloadSize));
+			if(memcmp(header,expectedHeader,sizeof(expectedHeader))!=0||payloadSize%2!=0)
+				return false;
+			
+			/* Read the block sizes: */
+			std::vector<unsigned char> payload(payloadSize+2+trailerSize);
+			seekableCompressedFile->readRaw(&payload[0],payload.size());
+			for(size_t i=0;i<payloadSize;i+=2)
+				{
+				Block newBlock;
+				newBlock.compressedPos=compressedPos;
+				newBlock.compressedSize=getUInt16(&payload[i])+1;
+				newBlock.uncompressedPos=uncompressedPos;
+				newBlocks.push_back(newBlock);
+				compressedPos+=Offset(newBlock.compressedSize);
+				uncompressedPos+=Offset(fileBlockSize);
+				}
+			
+			memberPos+=Offset(memberSize);
+			}
+		
+		/* Check that the blocks exactly cover the compressed and uncompressed data: */
+		if(memberPos!=indexEnd||compressedPos!=indexPos)
+			return false;
+		if(newBlocks.empty()?fileUncompressedSize!=0:fileUncompressedSize<=newBlocks.back().uncompressedPos||fileUncompressedSize>uncompressedPos)
+			return false;
+		
+		/* Install the new block index: */
+		blocks.swap(newBlocks);
+		blockSize=fileBlockSize;
+		uncompressedSize=fileUncompressedSize;
+		
+		return true;
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Treat the index as invalid: */
+		return false;
+		}
+	}
+
+void BlockGzipFilter::scanBlocks(void)
+	{
+	/* Read the headers of all gzip members in the compressed file: */
+	blocks.clear();
+	blockSize=0;
+	uncompressedSize=0;
+	Offset fileSize=seekableCompressedFile->getSize();
+	Offset memberPos=0;
+	while(memberPos<fileSize)
+		{
+		/* Read and check the member's fixed header: */
+		unsigned char header[12];
+		seekableCompressedFile->setReadPosAbs(memberPos);
+		seekableCompressedFile->readRaw(header,sizeof(header));
+		if(header[0]!=0x1fU||header[1]!=0x8bU||header[2]!=0x08U||(header[3]&0x04U)==0)
+			throw OpenError(Misc::printStdErrMsg("IO::BlockGzipFilter: Invalid gzip member at offset %ld",(long int)(memberPos)));
+		
+		/* Find the "BC" subfield containing the member's total size: */
+		size_t extraSize=getUInt16(header+10);
+		std::vector<unsigned char> extra(extraSize);
+		if(extraSize>0)
+			seekableCompressedFile->readRaw(&extra[0],extraSize);
+		size_t memberSize=0;
+		for(size_t i=0;i+4<=extraSize;i+=4+getUInt16(&extra[i+2]))
+			if(extra[i]=='B'&&extra[i+1]=='C'&&getUInt16(&extra[i+2])==2&&i+6<=extraSize)
+				memberSize=getUInt16(&extra[i+4])+1;
+		if(memberSize<sizeof(header)+extraSize+trailerSize)
+			throw OpenError(Misc::printStdErrMsg("IO::BlockGzipFilter: Gzip member at offset %ld is not a block",(long int)(memberPos)));
+		
+		/* Read the member's uncompressed size: */
+		unsigned char sizeBuffer[4];
+		seekableCompressedFile->setReadPosAbs(memberPos+Offset(memberSize-4));
+		seekableCompressedFile->readRaw(sizeBuffer,sizeof(sizeBuffer));
+		size_t memberUncompressedSize=getUInt32(sizeBuffer);
+		if(memberUncompressedSize>maxMemberSize)
+			throw OpenError(Misc::printStdErrMsg("IO::BlockGzipFilter: Block at offset %ld is too large",(long int)(memberPos)));
+		
+		/* Add non-empty members to the block list: */
+		if(memberUncompressedSize>0)
+			{
+			Block newBlock;
+			newBlock.compressedPos=memberPos;
+			newBlock.compressedSize=memberSize;
+			newBlock.uncompressedPos=uncompressedSize;
+			blocks.push_back(newBlock);
+			uncompressedSize+=Offset(memberUncompressedSize);
+			}
+		
+		memberPos+=Offset(memberSize);
+		}
+	}
+
+void BlockGzipFilter::scheduleBlock(size_t blockIndex,bool wait)
+	{
+	Slot& slot=slots[blockIndex%numSlots];
+	
+	{
+	Threads::Mutex::Lock slotLock(slotMutex);
+	
+	/* Check if the block is already in its slot: */
+	if(slot.blockIndex==blockIndex)
+		return;
+	
+	/* Check if the slot is still busy with another block: */
+	if(slot.state==QUEUED)
+		{
+		if(!wait)
+			return;
+		while(slot.state==QUEUED)
+			slotCond.wait(slotMutex);
+		}
+	}
+	
+	/* Read the block's gzip member into the slot: */
+	const Block& block=blocks[blockIndex];
+	slot.blockIndex=blockIndex;
+	slot.compressedSize=block.compressedSize;
+	slot.uncompressedSize=size_t((blockIndex+1<blocks.size()?blocks[blockIndex+1].uncompressedPos:uncompressedSize)-block.uncompressedPos);
+	try
+		{
+		if(slot.compressedSize>maxMemberSize)
+			Misc::throwStdErr("IO::BlockGzipFilter: Block %u is too large",(unsigned int)(blockIndex));
+		seekableCompressedFile->setReadPosAbs(block.compressedPos);
+		seekableCompressedFile->readRaw(slot.compressed,slot.compressedSize);
+		}
+	catch(...)
+		{
+		/* Release the slot: */
+		slot.blockIndex=~size_t(0);
+		slot.state=EMPTY;
+		throw;
+		}
+	
+	/* Queue the block for decompression: */
+	{
+	Threads::Mutex::Lock slotLock(slotMutex);
+	slot.state=QUEUED;
+	jobs.push_back(&slot);
+	jobCond.signal();
+	}
+	}
+
+void BlockGzipFilter::writeBlocks(size_t maxPendingBlocks)
+	{
+	while(numWrittenBlocks<blocks.size())
+		{
+		/* Check if the oldest pending block is compressed: */
+		Slot& slot=slots[numWrittenBlocks%numSlots];
+		{
+		Threads::Mutex::Lock slotLock(slotMutex);
+		if(slot.state==QUEUED)
+			{
+			/* Bail out if there are few enough pending blocks: */
+			if(blocks.size()-numWrittenBlocks<=maxPendingBlocks)
+				break;
+			
+			/* Wait for the block to be compressed: */
+			while(slot.state==QUEUED)
+				slotCond.wait(slotMutex);
+			}
+		}
+		if(slot.state==FAILED)
+			Misc::throwStdErr("IO::BlockGzipFilter: Internal zlib error while compressing block %u",(unsigned int)(numWrittenBlocks));
+		
+		/* Write the block's gzip member to the compressed file: */
+		compressedFile->writeRaw(slot.compressed,slot.compressedSize);
+		blocks[numWrittenBlocks].compressedPos=compressedSize;
+		blocks[numWrittenBlocks].compressedSize=slot.compressedSize;
+		compressedSize+=Offset(slot.compressedSize);
+		
+		/* Release the slot: */
+		slot.blockIndex=~size_t(0);
+		slot.state=EMPTY;
+		++numWrittenBlocks;
+		}
+	}
+
+void BlockGzipFilter::writeIndex(void)
+	{
+	/* Check if all blocks except the last one have the same uncompressed size: */
+	size_t indexBlockSize=blockSize;
+	for(size_t i=0;i+1<blocks.size();++i)
+		if(blocks[i+1].uncompressedPos-blocks[i].uncompressedPos!=Offset(blockSize))
+			indexBlockSize=0;
+	
+	/* Write the compressed sizes of all blocks into a sequence of empty index members: */
+	Offset indexPos=compressedSize;
+	std::vector<unsigned char> member;
+	for(size_t first=0;first<blocks.size();first+=maxIndexEntries)
+		{
+		size_t numEntries=std::min(blocks.size()-first,maxIndexEntries);
+		size_t memberSize=22+numEntries*2+2+trailerSize;
+		member.resize(memberSize);
+		unsigned char* mPtr=putMemberHeader(&member[0],memberSize,4+numEntries*2);
+		*(mPtr++)='V';
+		*(mPtr++)='I';
+		mPtr=putUInt16(mPtr,(unsigned int)(numEntries*2));
+		for(size_t i=0;i<numEntries;++i)
+			mPtr=putUInt16(mPtr,(unsigned int)(blocks[first+i].compressedSize-1));
+		
+		/* Add an empty compressed payload, and the CRC-32 and size of empty data: */
+		*(mPtr++)=0x03U;
+		*(mPtr++)=0x00U;
+		memset(mPtr,0,trailerSize);
+		compressedFile->writeRaw(&member[0],memberSize);
+		}
+	
+	/* Write the index trailer member: */
+	unsigned char trailer[indexTrailerSize];
+	unsigned char* tPtr=putMemberHeader(trailer,indexTrailerSize,24);
+	*(tPtr++)='V';
+	*(tPtr++)='E';
+	tPtr=putUInt16(tPtr,20);
+	tPtr=putUInt64(tPtr,indexPos);
+	tPtr=putUInt64(tPtr,uncompressedSize);
+	tPtr=putUInt32(tPtr,(unsigned int)(indexBlockSize));
+	*(tPtr++)=0x03U;
+	*(tPtr++)=0x00U;
+	memset(tPtr,0,trailerSize);
+	compressedFile->writeRaw(trailer,sizeof(trailer));
+	
+	/* Write the end-of-file member: */
+	compressedFile->writeRaw(eofMember,sizeof(eofMember));
+	}
+
+void* BlockGzipFilter::compressionThreadMethod(void)
+	{
+	/* Initialize a zlib stream object for raw deflate data: */
+	z_stream stream;
+	memset(&stream,0,sizeof(z_stream));
+	stream.zalloc=Z_NULL;
+	stream.zfree=Z_NULL;
+	stream.opaque=0;
+	bool streamOk;
+	if(writing)
+		streamOk=deflateInit2(&stream,Z_DEFAULT_COMPRESSION,Z_DEFLATED,-MAX_WBITS,8,Z_DEFAULT_STRATEGY)==Z_OK;
+	else
+		streamOk=inflateInit2(&stream,-MAX_WBITS)==Z_OK;
+	
+	while(true)
+		{
+		/* Wait for the next job: */
+		Slot* slot;
+		{
+		Threads::Mutex::Lock slotLock(slotMutex);
+		while(!shutdown&&jobs.empty())
+			jobCond.wait(slotMutex);
+		if(shutdown)
+			break;
+		slot=jobs.front();
+		jobs.pop_front();
+		}
+		
+		/* Process the slot's block: */
+		bool ok;
+		if(writing)
+			ok=streamOk&&compressBlock(stream,slot->uncompressed,slot->uncompressedSize,slot->compressed,slot->compressedSize);
+		else
+			ok=streamOk&&decompressBlock(stream,slot->compressed,slot->compressedSize,slot->uncompressed,slot->uncompressedSize);
+		
+		/* Hand the processed block back: */
+		{
+		Threads::Mutex::Lock slotLock(slotMutex);
+		slot->state=ok?READY:FAILED;
+		slotCond.broadcast();
+		}
+		}
+	
+	/* Clean up: */
+	if(streamOk)
+		{
+		if(writing)
+			deflateEnd(&stream);
+		else
+			inflateEnd(&stream);
+		}
+	
+	return 0;
+	}
+
+BlockGzipFilter::BlockGzipFilter(FilePtr sCompressedFile,unsigned int sNumThreads)
+	:SeekableFile(),
+	 compressedFile(sCompressedFile),
+	 writing(false),blockSize(0),
+	 uncompressedSize(0),compressedSize(0),
+	 numSlots(0),slots(0),
+	 shutdown(false),
+	 numThreads(sNumThreads),threads(0),
+	 numWrittenBlocks(0)
+	{
+	/* Adopt the compressed file's access mode: */
+	bool canRead=compressedFile->getReadBufferSize()!=0;
+	bool canWrite=compressedFile->getWriteBufferSize()!=0;
+	if(canRead&&canWrite)
+		throw OpenError("IO::BlockGzipFilter: Cannot read and write from/to block-gzipped file simultaneously");
+	else if(canRead)
+		{
+		/* Reading requires random access to the compressed file: */
+		seekableCompressedFile=compressedFile;
+		if(seekableCompressedFile==0)
+			throw OpenError("IO::BlockGzipFilter: Block-gzipped file is not seekable");
+		if(!isBlockGzipped(*seekableCompressedFile))
+			throw OpenError("IO::BlockGzipFilter: File is not block-gzip compressed");
+		
+		/* Read the block index, or create it if the file does not have one: */
+		if(!readIndex())
+			scanBlocks();
+		
+		/* Disable read-through, as all data is read from the slots: */
+		canReadThrough=false;
+		}
+	else if(canWrite)
+		{
+		/* Install a write buffer holding a single block: */
+		writing=true;
+		blockSize=defaultBlockSize;
+		File::resizeWriteBuffer(blockSize);
+		canWriteThrough=false;
+		}
+	else
+		throw OpenError("IO::BlockGzipFilter: Block-gzipped file is neither readable nor writable");
+	
+	/* Determine the number of compression threads: */
+	if(numThreads==0)
+		{
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		numThreads=numCpus>0?(unsigned int)(numCpus):1U;
+		}
+	
+	/* Create the block slots: */
+	numSlots=numThreads*2+2;
+	slots=new Slot[numSlots];
+	for(unsigned int i=0;i<numSlots;++i)
+		{
+		slots[i].blockIndex=~size_t(0);
+		slots[i].state=EMPTY;
+		slots[i].compressedSize=0;
+		slots[i].compressed=new Byte[maxMemberSize];
+		slots[i].uncompressedSize=0;
+		slots[i].uncompressed=new Byte[maxMemberSize];
+		}
+	
+	/* Start the compression threads: */
+	threads=new Threads::Thread[numThreads];
+	for(unsigned int i=0;i<numThreads;++i)
+		threads[i].start(this,&BlockGzipFilter::compressionThreadMethod);
+	}
+
+BlockGzipFilter::~BlockGzipFilter(void)
+	{
+	std::string writeError;
+	if(writing)
+		{
+		try
+			{
+			/* Compress and write all remaining data, followed by the block index: */
+			flush();
+			writeBlocks(0);
+			writeIndex();
+			}
+		catch(const std::runtime_error& err)
+			{
+			/* Remember the error to report it after cleaning up: */
+			writeError=err.what();
+			}
+		}
+	else
+		{
+		/* Release the buffered file's read buffer, which points into a slot: */
+		setReadBuffer(0,0,false);
+		}
+	
+	/* Shut down the compression threads: */
+	{
+	Threads::Mutex::Lock slotLock(slotMutex);
+	shutdown=true;
+	jobCond.broadcast();
+	}
+	delete[] threads;
+	
+	/* Delete the block slots: */
+	for(unsigned int i=0;i<numSlots;++i)
+		{
+		delete[] slots[i].compressed;
+		delete[] slots[i].uncompressed;
+		}
+	delete[] slots;
+	
+	if(!writeError.empty())
+		Misc::throwStdErr("%s",writeError.c_str());
+	}
+
+size_t BlockGzipFilter::getReadBufferSize(void) const
+	{
+	/* Data is read one block at a time: */
+	return writing?0:maxMemberSize;
+	}
+
+size_t BlockGzipFilter::resizeReadBuffer(size_t newReadBufferSize)
+	{
+	/* Ignore it and return the maximum block size: */
+	return writing?0:maxMemberSize;
+	}
+
+void BlockGzipFilter::resizeWriteBuffer(size_t newWriteBufferSize)
+	{
+	/* Ignore it */
+	}
+
+SeekableFile::Offset BlockGzipFilter::getSize(void) const
+	{
+	if(writing)
+		return writePos+getWritePtr();
+	else
+		return uncompressedSize;
+	}
+
+bool BlockGzipFilter::isBlockGzipped(SeekableFile& file)
+	{
+	bool result=false;
+	try
+		{
+		/* Read the file's first gzip member header and check for a leading "BC" subfield: */
+		unsigned char header[headerSize];
+		file.setReadPosAbs(0);
+		file.readRaw(header,sizeof(header));
+		result=header[0]==0x1fU&&header[1]==0x8bU&&header[2]==0x08U&&(header[3]&0x04U)!=0&&getUInt16(header+10)>=6&&header[12]=='B'&&header[13]=='C'&&getUInt16(header+14)==2;
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* File is too short */
+		}
+	
+	/* Rewind the file: */
+	file.setReadPosAbs(0);
+	
+	return result;
+	}
+
+}
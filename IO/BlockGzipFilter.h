@@ -0,0 +1,140 @@
+/***********************************************************************
+BlockGzipFilter - Class to read and write block-gzip (BGZF) compressed
+files, which consist of independently compressed gzip members followed
+by a block index, using a pool of background compression threads.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the I/O Support Library (IO).
+
+The I/O Support Library is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License as published
+by the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+The I/O Support Library is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the I/O Support Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+/***********************************************************************
+File format: A block-gzip file is a sequence of gzip members that each
+carry a "BC" extra subfield containing the member's total compressed
+size, and decompress to at most 64KB of data. Files written by this
+class append a sequence of empty gzip members carrying "VI" extra
+subfields that list the compressed sizes of all data members, followed
+by an empty gzip member carrying a "VE" extra subfield pointing to the
+first index member, and a standard empty BGZF end-of-file member. All
+index members decompress to nothing, so the entire file can be read by
+any standard gzip decompressor.
+***********************************************************************/
+
+#ifndef IO_BLOCKGZIPFILTER_INCLUDED
+#define IO_BLOCKGZIPFILTER_INCLUDED
+
+#include <deque>
+#include <vector>
+#include <Threads/Mutex.h>
+#include <Threads/Cond.h>
+#include <Threads/Thread.h>
+#include <IO/File.h>
+#include <IO/SeekableFile.h>
+
+namespace IO {
+
+class BlockGzipFilter:public SeekableFile
+	{
+	/* Embedded classes: */
+	private:
+	enum SlotState // Enumerated type for states of block slots
+		{
+		EMPTY, // Slot does not hold a block
+		QUEUED, // Slot holds a block waiting for or being processed by a compression thread
+		READY, // Slot holds a processed block
+		FAILED // Processing the slot's block failed
+		};
+	
+	struct Block // Structure describing a compressed block
+		{
+		/* Elements: */
+		public:
+		Offset compressedPos; // Position of the block's gzip member in the compressed file
+		size_t compressedSize; // Size of the block's gzip member
+		Offset uncompressedPos; // Position of the block's data in the uncompressed file
+		
+		/* Methods: */
+		static bool upperBoundCompare(Offset pos,const Block& block) // Compares an uncompressed position to a block's start position
+			{
+			return pos<block.uncompressedPos;
+			}
+		};
+	
+	struct Slot // Structure holding a block while it is being compressed or decompressed
+		{
+		/* Elements: */
+		public:
+		size_t blockIndex; // Index of the block currently held in the slot
+		SlotState state; // Processing state of the slot
+		size_t compressedSize; // Size of the block's complete gzip member
+		Byte* compressed; // Buffer for the block's complete gzip member
+		size_t uncompressedSize; // Size of the block's uncompressed data
+		Byte* uncompressed; // Buffer for the block's uncompressed data
+		};
+	
+	/* Elements: */
+	FilePtr compressedFile; // Underlying block-gzip compressed file
+	SeekableFilePtr seekableCompressedFile; // Underlying compressed file as a seekable file, only used for reading
+	bool writing; // Flag whether the filter compresses data instead of decompressing it
+	size_t blockSize; // Uncompressed size of all blocks except the last one, or 0 if block sizes vary
+	std::vector<Block> blocks; // List of all compressed blocks
+	Offset uncompressedSize; // Total size of the uncompressed data
+	Offset compressedSize; // Total size of all blocks written to the compressed file
+	unsigned int numSlots; // Number of block slots
+	Slot* slots; // Array of block slots; block i is held in slot i%numSlots
+	Threads::Mutex slotMutex; // Mutex serializing access to the slot states and the job queue
+	Threads::Cond jobCond; // Condition variable to signal new jobs to compression threads
+	Threads::Cond slotCond; // Condition variable to signal completed jobs
+	std::deque<Slot*> jobs; // Queue of slots waiting to be processed
+	bool shutdown; // Flag to shut down the compression threads
+	unsigned int numThreads; // Number of compression threads
+	Threads::Thread* threads; // Array of compression threads
+	size_t numWrittenBlocks; // Number of blocks written to the compressed file
+	
+	/* Protected methods from File: */
+	protected:
+	virtual size_t readData(Byte* buffer,size_t bufferSize);
+	virtual void writeData(const Byte* buffer,size_t bufferSize);
+	
+	/* Private methods: */
+	private:
+	bool readIndex(void); // Reads the block index from the end of the compressed file; returns false if there is no valid index
+	void scanBlocks(void); // Creates the block index by scanning the compressed file's gzip member headers
+	void scheduleBlock(size_t blockIndex,bool wait); // Reads the given block into its slot and queues it for decompression; skips blocks whose slot is busy unless wait flag is true
+	void writeBlocks(size_t maxPendingBlocks); // Writes compressed blocks to the compressed file in order, waiting until at most the given number of blocks are pending
+	void writeIndex(void); // Writes the block index and end-of-file members to the compressed file
+	void* compressionThreadMethod(void); // Method for the background compression threads
+	
+	/* Constructors and destructors: */
+	public:
+	BlockGzipFilter(FilePtr sCompressedFile,unsigned int sNumThreads =0); // Creates a block-gzip filter for the given underlying compressed file and number of compression threads (0: one per CPU); inherits access mode from compressed file, which must be seekable for reading
+	virtual ~BlockGzipFilter(void); // Flushes all written data and destroys the filter
+	
+	/* Methods from File: */
+	virtual size_t getReadBufferSize(void) const;
+	virtual size_t resizeReadBuffer(size_t newReadBufferSize);
+	virtual void resizeWriteBuffer(size_t newWriteBufferSize);
+	
+	/* Methods from SeekableFile: */
+	virtual Offset getSize(void) const;
+	
+	/* New methods: */
+	static bool isBlockGzipped(SeekableFile& file); // Returns true if the given file starts with a block-gzip member; resets the file's read position to the beginning
+	};
+
+}
+
+#endif
@@ -125,6 +125,21 @@ CSVSource::ConversionError::ConversionError(unsigned int fieldIndex,size_t recor
 Methods of class CSVSource:
 **************************/
 
+bool CSVSource::fillBuffer(void) const
+	{
+	/* Mark the entire current buffer window as read: */
+	source->skipInBuffer(bufferEnd-bufferStart);
+	
+	/* Peek at the character source's next buffer of data: */
+	const void* buffer;
+	size_t bufferSize=source->peekInBuffer(buffer);
+	bufferStart=static_cast<const unsigned char*>(buffer);
+	bufferPtr=bufferStart;
+	bufferEnd=bufferStart+bufferSize;
+	
+	return bufferSize!=0;
+	}
+
 bool CSVSource::skipRestOfField(bool quoted,int nextChar)
 	{
 	/* Keep track if any characters were actually skipped: */
@@ -143,7 +158,13 @@ bool CSVSource::skipRestOfField(bool quoted,int nextChar)
 			while(nextChar!=quote&&nextChar>=0)
 				{
 				skippedAny=true;
-				nextChar=source->getChar();
+				
+				/* Skip all following unquoted characters directly in the buffer window: */
+				const unsigned char* bPtr;
+				for(bPtr=bufferPtr;bPtr!=bufferEnd&&int(*bPtr)!=quote;++bPtr)
+					;
+				bufferPtr=bPtr;
+				nextChar=readSourceChar();
 				}
 			
 			/* Eof inside quote is a format error: */
@@ -151,11 +172,11 @@ bool CSVSource::skipRestOfField(bool quoted,int nextChar)
 				throw FormatError(fieldIndex,recordIndex);
 			
 			/* Check for quoted quotes: */
-			nextChar=source->getChar();
+			nextChar=readSourceChar();
 			if(nextChar==quote)
 				{
 				skippedAny=true;
-				nextChar=source->getChar();
+				nextChar=readSourceChar();
 				}
 			else
 				break;
@@ -171,7 +192,13 @@ bool CSVSource::skipRestOfField(bool quoted,int nextChar)
 		while(nextChar!=fieldSeparator&&nextChar!=recordSeparator&&nextChar>=0&&nextChar!=quote)
 			{
 			skippedAny=true;
-			nextChar=source->getChar();
+			
+			/* Skip all following field characters directly in the buffer window: */
+			const unsigned char* bPtr;
+			for(bPtr=bufferPtr;bPtr!=bufferEnd&&int(*bPtr)!=fieldSeparator&&int(*bPtr)!=recordSeparator&&int(*bPtr)!=quote;++bPtr)
+				;
+			bufferPtr=bPtr;
+			nextChar=readSourceChar();
 			}
 		}
 	
@@ -205,13 +232,13 @@ bool CSVSource::convertNumber(int& nextChar,unsigned int& value)
 	
 	/* Read the first digit: */
 	value=(unsigned int)(nextChar-'0');
-	nextChar=source->getChar();
+	nextChar=readSourceChar();
 	
 	/* Read all following digits: */
 	while(nextChar>='0'&&nextChar<='9')
 		{
 		value=value*10+(unsigned int)(nextChar-'0');
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		}
 	
 	return true;
@@ -225,10 +252,10 @@ bool CSVSource::convertNumber(int& nextChar,int& value)
 	if(nextChar=='-')
 		{
 		negated=true;
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		}
 	else if(nextChar=='+')
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 	
 	/* Signal a conversion error if the next character is not a digit: */
 	if(nextChar<'0'||nextChar>'9')
@@ -236,13 +263,13 @@ bool CSVSource::convertNumber(int& nextChar,int& value)
 	
 	/* Read the first digit: */
 	unsigned int tempValue=(unsigned int)(nextChar-'0');
-	nextChar=source->getChar();
+	nextChar=readSourceChar();
 	
 	/* Read all following digits: */
 	while(nextChar>='0'&&nextChar<='9')
 		{
 		tempValue=tempValue*10+(unsigned int)(nextChar-'0');
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		}
 	
 	/* Calculate the final value: */
@@ -262,10 +289,10 @@ bool CSVSource::convertNumber(int& nextChar,double& value)
 	if(nextChar=='-')
 		{
 		negated=true;
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		}
 	else if(nextChar=='+')
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 	
 	/* Keep track if any digits have been read: */
 	bool haveDigit=false;
@@ -276,13 +303,13 @@ bool CSVSource::convertNumber(int& nextChar,double& value)
 		{
 		haveDigit=true;
 		value=value*10.0+double(nextChar-'0');
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		}
 	
 	/* Check for a period: */
 	if(nextChar=='.')
 		{
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		
 		/* Read a fractional number part: */
 		double fraction=0.0;
@@ -292,7 +319,7 @@ bool CSVSource::convertNumber(int& nextChar,double& value)
 			haveDigit=true;
 			fraction=fraction*10.0+double(nextChar-'0');
 			fractionBase*=10.0;
-			nextChar=source->getChar();
+			nextChar=readSourceChar();
 			}
 		
 		value+=fraction/fractionBase;
@@ -309,17 +336,17 @@ bool CSVSource::convertNumber(int& nextChar,double& value)
 	/* Check for an exponent indicator: */
 	if(nextChar=='e'||nextChar=='E')
 		{
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		
 		/* Read a plus or minus sign: */
 		bool exponentNegated=false;
 		if(nextChar=='-')
 			{
 			exponentNegated=true;
-			nextChar=source->getChar();
+			nextChar=readSourceChar();
 			}
 		else if(nextChar=='+')
-			nextChar=source->getChar();
+			nextChar=readSourceChar();
 		
 		/* Signal a conversion error if the next character is not a digit: */
 		if(nextChar<'0'||nextChar>'9')
@@ -327,13 +354,13 @@ bool CSVSource::convertNumber(int& nextChar,double& value)
 		
 		/* Read the first exponent digit: */
 		double exponent=double(nextChar-'0');
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		
 		/* Read the rest of the exponent digits: */
 		while(nextChar>='0'&&nextChar<='9')
 			{
 			exponent=exponent*10.0+double(nextChar-'0');
-			nextChar=source->getChar();
+			nextChar=readSourceChar();
 			}
 		
 		/* Multiply the mantissa with the exponent: */
@@ -358,6 +385,7 @@ bool CSVSource::convertNumber(int& nextChar,float& value)
 
 CSVSource::CSVSource(FilePtr sSource)
 	:source(sSource),
+	 bufferStart(0),bufferPtr(0),bufferEnd(0),
 	 fieldSeparator(','),recordSeparator('\n'),quote('\"'),
 	 recordIndex(0),fieldIndex(0)
 	{
@@ -365,6 +393,8 @@ CSVSource::CSVSource(FilePtr sSource)
 
 CSVSource::~CSVSource(void)
 	{
+	/* Mark all characters read from the buffer window as read in the character source: */
+	source->skipInBuffer(bufferPtr-bufferStart);
 	}
 
 void CSVSource::setFieldSeparator(int newFieldSeparator)
@@ -386,19 +416,19 @@ template <class ValueParam>
 ValueParam CSVSource::readField(void)
 	{
 	/* Read the field's first character: */
-	int nextChar=source->getChar();
+	int nextChar=readSourceChar();
 	
 	/* Check for quote: */
 	bool quoted=false;
 	if(nextChar==quote)
 		{
 		quoted=true;
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		}
 	
 	/* Skip whitespace: */
 	while(isspace(nextChar)&&nextChar!=fieldSeparator&&nextChar!=recordSeparator&&nextChar>=0)
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 	
 	/* Read the numeric value: */
 	ValueParam result(0);
@@ -406,7 +436,7 @@ ValueParam CSVSource::readField(void)
 	
 	/* Skip whitespace: */
 	while(isspace(nextChar)&&nextChar!=fieldSeparator&&nextChar!=recordSeparator&&nextChar>=0)
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 	
 	/* Read until the end of the field, and invalidate the result if any further characters are encountered: */
 	if(skipRestOfField(quoted,nextChar))
@@ -424,13 +454,13 @@ template <>
 std::string CSVSource::readField(void)
 	{
 	/* Read the field's first character: */
-	int nextChar=source->getChar();
+	int nextChar=readSourceChar();
 	
 	std::string result;
 	if(nextChar==quote)
 		{
 		/* Skip the opening quote: */
-		nextChar=source->getChar();
+		nextChar=readSourceChar();
 		
 		/********************
 		Read a quoted string:
@@ -443,7 +473,14 @@ std::string CSVSource::readField(void)
 			while(nextChar!=quote&&nextChar>=0)
 				{
 				result.push_back(nextChar);
-				nextChar=source->getChar();
+				
+				/* Append all following unquoted characters directly from the buffer window: */
+				const unsigned char* bPtr;
+				for(bPtr=bufferPtr;bPtr!=bufferEnd&&int(*bPtr)!=quote;++bPtr)
+					;
+				result.append(bufferPtr,bPtr);
+				bufferPtr=bPtr;
+				nextChar=readSourceChar();
 				}
 			
 			/* Eof inside quote is a format error: */
@@ -451,11 +488,11 @@ std::string CSVSource::readField(void)
 				throw FormatError(fieldIndex,recordIndex);
 			
 			/* Check for quoted quotes: */
-			nextChar=source->getChar();
+			nextChar=readSourceChar();
 			if(nextChar==quote)
 				{
 				result.push_back(nextChar);
-				nextChar=source->getChar();
+				nextChar=readSourceChar();
 				}
 			else
 				break;
@@ -471,7 +508,14 @@ std::string CSVSource::readField(void)
 		while(nextChar!=fieldSeparator&&nextChar!=recordSeparator&&nextChar>=0&&nextChar!=quote)
 			{
 			result.push_back(nextChar);
-			nextChar=source->getChar();
+			
+			/* Append all following field characters directly from the buffer window: */
+			const unsigned char* bPtr;
+			for(bPtr=bufferPtr;bPtr!=bufferEnd&&int(*bPtr)!=fieldSeparator&&int(*bPtr)!=recordSeparator&&int(*bPtr)!=quote;++bPtr)
+				;
+			result.append(bufferPtr,bPtr);
+			bufferPtr=bPtr;
+			nextChar=readSourceChar();
 			}
 		}
 	
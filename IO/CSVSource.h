@@ -49,6 +49,9 @@ class CSVSource
 	/* Elements: */
 	private:
 	FilePtr source; // Data source for CSV source
+	mutable const unsigned char* bufferStart; // Start of the window into the data source's read buffer that is scanned in place
+	mutable const unsigned char* bufferPtr; // Next unread character in the buffer window
+	mutable const unsigned char* bufferEnd; // End of the buffer window
 	int fieldSeparator; // Character used to separate fields in a record; comma by default
 	int recordSeparator; // Character used to separate records; newline by default
 	int quote; // Character used to quote field contents; double quote by default
@@ -56,6 +59,14 @@ class CSVSource
 	unsigned int fieldIndex; // Zero-based index of the currently read field; increments before field read returns; resets to zero before field read on the last field in a record returns
 	
 	/* Private methods: */
+	bool fillBuffer(void) const; // Marks the current buffer window as read and peeks at the next window; returns false if the entire character source has been read
+	int readSourceChar(void) // Returns the next character from the buffer window, or EOF (-1) if the entire character source has been read
+		{
+		if(bufferPtr!=bufferEnd||fillBuffer())
+			return int(*(bufferPtr++));
+		else
+			return -1;
+		}
 	bool skipRestOfField(bool quoted,int nextChar); // Skips the rest of the current field starting with the given character; returns true if any characters were skipped; throws format error if the end of the field cannot be determined reliably
 	template <class ValueParam>
 	bool convertNumber(int& nextChar,ValueParam& value); // Converts characters in a field into a numeric value of the given type; returns false on conversion error
@@ -92,7 +103,7 @@ class CSVSource
 		}
 	bool eof(void) const // Returns true when the entire character source was read
 		{
-		return source->eof();
+		return bufferPtr==bufferEnd&&!fillBuffer();
 		}
 	bool eor(void) const // Returns true when the last read field terminated a record; returns true before the first field is read
 		{
@@ -103,11 +114,11 @@ class CSVSource
 	bool skipField(void) // Skips the current field; returns true if the field was non-empty after unquoting; throws exception if the end of the field cannot be determined reliably
 		{
 		/* Read the first character: */
-		int nextChar=source->getChar();
+		int nextChar=readSourceChar();
 		if(nextChar==quote)
 			{
 			/* Skip the opening quote: */
-			nextChar=source->getChar();
+			nextChar=readSourceChar();
 			
 			/* Skip a quoted field: */
 			return skipRestOfField(true,nextChar);
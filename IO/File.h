@@ -271,6 +271,20 @@ class File:public Misc::RefCounted
 		
 		return result;
 		}
+	size_t peekInBuffer(const void*& buffer) // Returns a pointer to all unread data in the file's internal buffer without marking it as read, reading more data if the buffer is empty; pointer stays valid until the next read; returns zero at end-of-file
+		{
+		/* Read more data if the buffer is empty and end-of-file has not been seen yet: */
+		if(readPtr==readDataEnd&&!haveEof)
+			fillReadBuffer();
+		
+		/* Return all unread buffer content: */
+		buffer=readPtr;
+		return readDataEnd-readPtr;
+		}
+	void skipInBuffer(size_t skipSize) // Marks the given amount of data returned by the most recent call to peekInBuffer as read
+		{
+		readPtr+=skipSize;
+		}
 	void readRaw(void* buffer,size_t bufferSize) // Reads exactly the given amount of data into the provided buffer; blocks until read complete
 		{
 		/* Check if there is enough data in the read buffer: */
@@ -60,6 +60,24 @@ size_t GzipFilter::readData(File::Byte* buffer,size_t bufferSize)
 		int result=inflate(&stream,Z_NO_FLUSH);
 		if(result==Z_STREAM_END)
 			{
+			/* Check if another gzip member follows the one that just ended: */
+			if(stream.avail_in==0)
+				{
+				void* compressedBuffer;
+				size_t compressedSize=gzippedFile->readInBuffer(compressedBuffer);
+				stream.next_in=static_cast<Bytef*>(compressedBuffer);
+				stream.avail_in=compressedSize;
+				}
+			
+			/* Ignore trailing data that does not start with a gzip magic number, such as zero padding: */
+			if(stream.avail_in!=0&&stream.next_in[0]==0x1fU&&(stream.avail_in<2||stream.next_in[1]==0x8bU))
+				{
+				/* Restart the decompressor on the next member: */
+				if(inflateReset(&stream)!=Z_OK)
+					Misc::throwStdErr("IO::GzipFilter: Internal zlib error while decompressing");
+				continue;
+				}
+			
 			/* Set the eof flag and clean out the decompressor: */
 			readEof=true;
 			if(inflateEnd(&stream)!=Z_OK)
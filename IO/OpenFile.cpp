@@ -26,6 +26,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Misc/FileNameExtensions.h>
 #include <IO/StandardFile.h>
 #include <IO/GzipFilter.h>
+#include <IO/BlockGzipFilter.h>
 #include <IO/SeekableFilter.h>
 #include <IO/StandardDirectory.h>
 
@@ -41,8 +42,25 @@ FilePtr openFile(const char* fileName,File::AccessMode accessMode)
 	/* Check if the file name has the .gz extension: */
 	if(Misc::hasCaseExtension(fileName,".gz"))
 		{
-		/* Wrap a gzip filter around the base file: */
-		result=new GzipFilter(result);
+		/* Check if the file is read and block-gzip compressed: */
+		SeekableFile* seekableFile=dynamic_cast<SeekableFile*>(result.getPointer());
+		if(accessMode==File::ReadOnly&&seekableFile!=0&&BlockGzipFilter::isBlockGzipped(*seekableFile))
+			{
+			/* Wrap a multithreaded block-gzip filter around the base file: */
+			result=new BlockGzipFilter(result);
+			}
+		else
+			{
+			/* Wrap a gzip filter around the base file: */
+			result=new GzipFilter(result);
+			}
+		}
+	
+	/* Check if the file name has the .bgz extension: */
+	else if(Misc::hasCaseExtension(fileName,".bgz"))
+		{
+		/* Wrap a multithreaded block-gzip filter around the base file: */
+		result=new BlockGzipFilter(result);
 		}
 	
 	/* Return the open file: */
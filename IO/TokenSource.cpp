@@ -49,6 +49,25 @@ void TokenSource::initCharacterClasses(void)
 	cc['\n']&=~QUOTEDTOKEN; // Newlines terminate quoted tokens
 	}
 
+int TokenSource::fillBuffer(void)
+	{
+	/* Mark the entire current buffer window as read: */
+	source->skipInBuffer(bufferEnd-bufferStart);
+	
+	/* Peek at the character source's next buffer of data: */
+	const void* buffer;
+	size_t bufferSize=source->peekInBuffer(buffer);
+	bufferStart=static_cast<const unsigned char*>(buffer);
+	bufferPtr=bufferStart;
+	bufferEnd=bufferStart+bufferSize;
+	
+	/* Return the window's first character: */
+	if(bufferPtr!=bufferEnd)
+		return int(*(bufferPtr++));
+	else
+		return -1;
+	}
+
 void TokenSource::resizeTokenBuffer(void)
 	{
 	tokenBufferSize=(tokenBufferSize*5)/4+10;
@@ -59,8 +78,21 @@ void TokenSource::resizeTokenBuffer(void)
 	tokenBuffer=newTokenBuffer;
 	}
 
+void TokenSource::appendToken(const unsigned char* begin,const unsigned char* end)
+	{
+	/* Make room in the token buffer: */
+	size_t appendSize=end-begin;
+	while(tokenSize+appendSize>tokenBufferSize)
+		resizeTokenBuffer();
+	
+	/* Copy the characters: */
+	memcpy(tokenBuffer+tokenSize,begin,appendSize);
+	tokenSize+=appendSize;
+	}
+
 TokenSource::TokenSource(FilePtr sSource)
 	:source(sSource),
+	 bufferStart(0),bufferPtr(0),bufferEnd(0),
 	 cc(characterClasses+1),
 	 tokenBufferSize(40),tokenBuffer(new char[tokenBufferSize+1]),tokenSize(0)
 	{
@@ -68,14 +100,16 @@ TokenSource::TokenSource(FilePtr sSource)
 	initCharacterClasses();
 	
 	/* Read the first character from the character source: */
-	lastChar=source->getChar();
+	lastChar=readSourceChar();
 	}
 
 TokenSource::~TokenSource(void)
 	{
-	/* Put the last read character back into the character source: */
-	if(lastChar>=0)
-		source->ungetChar(lastChar);
+	/* Mark all characters up to, but not including, the last read character as read in the character source: */
+	size_t readSize=bufferPtr-bufferStart;
+	if(lastChar>=0&&readSize>0)
+		--readSize;
+	source->skipInBuffer(readSize);
 	
 	/* Delete the allocated token buffer: */
 	delete[] tokenBuffer;
@@ -187,18 +221,32 @@ void TokenSource::skipWs(void)
 	{
 	/* Skip all whitespace characters: */
 	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+		{
+		/* Skip whitespace directly in the buffer window: */
+		const unsigned char* bPtr;
+		for(bPtr=bufferPtr;bPtr!=bufferEnd&&(cc[*bPtr]&WHITESPACE);++bPtr)
+			;
+		bufferPtr=bPtr;
+		lastChar=readSourceChar();
+		}
 	}
 
 void TokenSource::skipLine(void)
 	{
 	/* Skip everything until the next newline: */
 	while(lastChar>=0&&lastChar!='\n')
-		lastChar=source->getChar();
+		{
+		/* Find the next newline directly in the buffer window: */
+		const unsigned char* bPtr;
+		for(bPtr=bufferPtr;bPtr!=bufferEnd&&*bPtr!='\n';++bPtr)
+			;
+		bufferPtr=bPtr;
+		lastChar=readSourceChar();
+		}
 	
 	/* Skip the newline: */
 	if(lastChar=='\n')
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 	}
 
 const char* TokenSource::readNextToken(void)
@@ -211,27 +259,35 @@ const char* TokenSource::readNextToken(void)
 		{
 		/* Read a single punctuation character: */
 		tokenBuffer[tokenSize++]=lastChar;
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		}
 	else if(cc[lastChar]&QUOTE)
 		{
 		/* Read the quote character and temporarily remove it from the set of quoted string characters: */
 		int quote=lastChar;
 		cc[quote]&=~QUOTEDTOKEN;
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		
 		/* Read characters until the matching quote, endline, or EOF: */
 		while(cc[lastChar]&QUOTEDTOKEN)
 			{
+			/* Append the last read character: */
 			if(tokenSize>=tokenBufferSize)
 				resizeTokenBuffer();
 			tokenBuffer[tokenSize++]=lastChar;
-			lastChar=source->getChar();
+			
+			/* Append all following token characters directly from the buffer window: */
+			const unsigned char* tokenEnd;
+			for(tokenEnd=bufferPtr;tokenEnd!=bufferEnd&&(cc[*tokenEnd]&QUOTEDTOKEN);++tokenEnd)
+				;
+			appendToken(bufferPtr,tokenEnd);
+			bufferPtr=tokenEnd;
+			lastChar=readSourceChar();
 			}
 		
 		/* Read the terminating quote, if there is one: */
 		if(lastChar==quote)
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 		
 		/* Add the quote character to the set of quoted token characters again: */
 		cc[quote]|=QUOTEDTOKEN;
@@ -241,10 +297,18 @@ const char* TokenSource::readNextToken(void)
 		/* Read a non-quoted token: */
 		while(cc[lastChar]&TOKEN)
 			{
+			/* Append the last read character: */
 			if(tokenSize>=tokenBufferSize)
 				resizeTokenBuffer();
 			tokenBuffer[tokenSize++]=lastChar;
-			lastChar=source->getChar();
+			
+			/* Append all following token characters directly from the buffer window: */
+			const unsigned char* tokenEnd;
+			for(tokenEnd=bufferPtr;tokenEnd!=bufferEnd&&(cc[*tokenEnd]&TOKEN);++tokenEnd)
+				;
+			appendToken(bufferPtr,tokenEnd);
+			bufferPtr=tokenEnd;
+			lastChar=readSourceChar();
 			}
 		}
 	
@@ -252,12 +316,35 @@ const char* TokenSource::readNextToken(void)
 	tokenBuffer[tokenSize]='\0';
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return tokenBuffer;
 	}
 
+void TokenSource::readUntil(const char* terminators,std::vector<char>& characters)
+	{
+	/* Create a lookup table of terminator characters: */
+	bool terminator[256];
+	memset(terminator,0,sizeof(terminator));
+	for(const char* tPtr=terminators;*tPtr!='\0';++tPtr)
+		terminator[(unsigned char)(*tPtr)]=true;
+	
+	/* Read characters until a terminator or EOF: */
+	while(lastChar>=0&&!terminator[lastChar])
+		{
+		/* Append the last read character: */
+		characters.push_back(char(lastChar));
+		
+		/* Append all following non-terminator characters directly from the buffer window: */
+		const unsigned char* bPtr;
+		for(bPtr=bufferPtr;bPtr!=bufferEnd&&!terminator[*bPtr];++bPtr)
+			;
+		characters.insert(characters.end(),bufferPtr,bPtr);
+		bufferPtr=bPtr;
+		lastChar=readSourceChar();
+		}
+	}
+
 bool TokenSource::isToken(const char* token) const
 	{
 	return strcmp(tokenBuffer,token)==0;
@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define IO_TOKENSOURCE_INCLUDED
 
 #include <stddef.h>
+#include <vector>
 #include <IO/File.h>
 
 namespace IO {
@@ -43,6 +44,9 @@ class TokenSource
 	
 	/* Elements: */
 	FilePtr source; // Data source for token reader
+	const unsigned char* bufferStart; // Start of the window into the data source's read buffer that is scanned in place
+	const unsigned char* bufferPtr; // Next unread character in the buffer window
+	const unsigned char* bufferEnd; // End of the buffer window
 	unsigned char characterClasses[257]; // Array of character type bit flags for quicker classification, with extra space for EOF
 	unsigned char* cc; // Pointer into character classes array to account for EOF==-1
 	int lastChar; // Last character read from character source
@@ -52,7 +56,16 @@ class TokenSource
 	
 	/* Private methods: */
 	void initCharacterClasses(void); // Initializes the character classes array
+	int fillBuffer(void); // Marks the current buffer window as read, peeks at the next window, and returns its first character or EOF
+	int readSourceChar(void) // Returns the next character from the buffer window, or EOF (-1) if the entire character source has been read
+		{
+		if(bufferPtr!=bufferEnd)
+			return int(*(bufferPtr++));
+		else
+			return fillBuffer();
+		}
 	void resizeTokenBuffer(void); // Creates additional room in the token buffer
+	void appendToken(const unsigned char* begin,const unsigned char* end); // Appends the given range of characters to the token buffer
 	
 	/* Constructors and destructors: */
 	public:
@@ -77,6 +90,7 @@ class TokenSource
 		return lastChar;
 		}
 	const char* readNextToken(void); // Reads the next token, i.e., either a single punctuation character, or a sequence of non-whitespace and non-punctuation characters, then skips whitespace
+	void readUntil(const char* terminators,std::vector<char>& characters); // Appends all characters up to, but not including, the next occurrence of any character in the given string, or EOF, to the given buffer without tokenizing them or skipping whitespace
 	size_t getTokenSize(void) const // Returns the length of the most recently read token
 		{
 		return tokenSize;
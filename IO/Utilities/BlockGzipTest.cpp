@@ -0,0 +1,269 @@
+/***********************************************************************
+BlockGzipTest - Program to check that block-gzipped files written by
+IO::BlockGzipFilter round-trip through sequential reads, seeks through
+the block index, seeks through a scanned block list, and IO::GzipFilter.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the I/O Support Library (IO).
+
+The I/O Support Library is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License as published
+by the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+The I/O Support Library is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the I/O Support Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <IO/File.h>
+#include <IO/SeekableFile.h>
+#include <IO/StandardFile.h>
+#include <IO/GzipFilter.h>
+#include <IO/BlockGzipFilter.h>
+#include <IO/OpenFile.h>
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+unsigned int randomState=1U; // State of the deterministic pseudo-random number generator
+
+unsigned int nextRandom(void) // Returns the next pseudo-random number in [0, 2^31)
+	{
+	randomState=randomState*1103515245U+12345U;
+	return (randomState>>1)&0x7fffffffU;
+	}
+
+void createTestData(std::vector<unsigned char>& data,size_t size) // Creates moderately compressible test data of the given size
+	{
+	data.resize(size);
+	for(size_t i=0;i<size;)
+		{
+		/* Alternate between runs of repeated text and runs of random bytes: */
+		size_t runLength=std::min(size_t(nextRandom()%4096+1),size-i);
+		if(nextRandom()%4!=0)
+			{
+			unsigned int value=nextRandom();
+			for(size_t j=0;j<runLength;++j)
+				data[i+j]=(unsigned char)('a'+(value+j)%26U);
+			}
+		else
+			{
+			for(size_t j=0;j<runLength;++j)
+				data[i+j]=(unsigned char)(nextRandom()&0xffU);
+			}
+		i+=runLength;
+		}
+	}
+
+void writeFile(IO::File& file,const std::vector<unsigned char>& data) // Writes the given data in chunks of random sizes
+	{
+	for(size_t pos=0;pos<data.size();)
+		{
+		size_t chunkSize=std::min(size_t(nextRandom()%100000+1),data.size()-pos);
+		file.writeRaw(&data[pos],chunkSize);
+		pos+=chunkSize;
+		}
+	}
+
+bool compareSequential(IO::File& file,const std::vector<unsigned char>& data) // Reads the file sequentially and compares it to the given data
+	{
+	std::vector<unsigned char> buffer(65536);
+	for(size_t pos=0;pos<data.size();)
+		{
+		size_t chunkSize=std::min(size_t(nextRandom()%buffer.size()+1),data.size()-pos);
+		file.readRaw(&buffer[0],chunkSize);
+		if(memcmp(&buffer[0],&data[pos],chunkSize)!=0)
+			return false;
+		pos+=chunkSize;
+		}
+	
+	/* Check that the file ends where the data ends: */
+	return file.eof();
+	}
+
+bool compareSeeks(IO::SeekableFile& file,const std::vector<unsigned char>& data,unsigned int numSeeks) // Reads random file ranges after seeking and compares them to the given data
+	{
+	if(file.getSize()!=IO::SeekableFile::Offset(data.size()))
+		return false;
+	std::vector<unsigned char> buffer(200000);
+	for(unsigned int seek=0;seek<numSeeks;++seek)
+		{
+		size_t pos=size_t(nextRandom())%data.size();
+		size_t size=std::min(size_t(nextRandom()%buffer.size()+1),data.size()-pos);
+		file.setReadPosAbs(IO::SeekableFile::Offset(pos));
+		file.readRaw(&buffer[0],size);
+		if(memcmp(&buffer[0],&data[pos],size)!=0)
+			return false;
+		}
+	return true;
+	}
+
+bool readTail(const char* fileName,std::vector<unsigned char>& contents,size_t& indexPos) // Reads the entire compressed file and extracts the block index position from its index trailer; returns false if the file does not end with an index trailer and end-of-file member
+	{
+	/* Read the raw compressed file: */
+	IO::StandardFile file(fileName);
+	contents.resize(size_t(file.getSize()));
+	file.readRaw(&contents[0],contents.size());
+	
+	/* Check for the "VE" index trailer member followed by the 28-byte end-of-file member: */
+	size_t size=contents.size();
+	if(size<52+28)
+		return false;
+	const unsigned char* tail=&contents[size-52-28];
+	if(tail[0]!=0x1fU||tail[1]!=0x8bU||tail[2]!=0x08U||tail[3]!=0x04U||tail[18]!='V'||tail[19]!='E')
+		return false;
+	const unsigned char* eof=tail+52;
+	if(eof[0]!=0x1fU||eof[1]!=0x8bU||eof[12]!='B'||eof[13]!='C')
+		return false;
+	
+	/* Extract the position of the first "VI" index member: */
+	indexPos=0;
+	for(int i=7;i>=0;--i)
+		indexPos=(indexPos<<8)|size_t(tail[22+i]);
+	const unsigned char* index=&contents[indexPos];
+	return indexPos<size-52-28&&index[0]==0x1fU&&index[1]==0x8bU&&index[18]=='V'&&index[19]=='I';
+	}
+
+void writeRaw(const char* fileName,const unsigned char* data,size_t size) // Writes the given raw data to a file
+	{
+	IO::StandardFile file(fileName,IO::File::WriteOnly);
+	file.writeRaw(data,size);
+	}
+
+bool report(const char* testName,bool passed) // Prints the result of a single test
+	{
+	std::cout<<testName<<": "<<(passed?"passed":"FAILED")<<std::endl;
+	return passed;
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse command line: */
+	size_t dataSize=16*1024*1024;
+	unsigned int numSeeks=1000;
+	const char* baseName="BlockGzipTest";
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"size")==0&&i+1<argc)
+				{
+				++i;
+				dataSize=size_t(atof(argv[i])*1024.0*1024.0);
+				}
+			else if(strcasecmp(argv[i]+1,"seeks")==0&&i+1<argc)
+				{
+				++i;
+				numSeeks=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			baseName=argv[i];
+		}
+	if(dataSize==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-size <data size in MB>] [-seeks <number of random seeks>] [<temporary file base name>]"<<std::endl;
+		return 1;
+		}
+	std::string blockGzipName=std::string(baseName)+".bgz";
+	std::string scannedName=std::string(baseName)+".scanned.bgz";
+	std::string gzipName=std::string(baseName)+".gz";
+	
+	bool passed=true;
+	try
+		{
+		/* Create the test data: */
+		std::vector<unsigned char> data;
+		createTestData(data,dataSize);
+		
+		/* Write the test data through a block-gzip filter: */
+		{
+		IO::BlockGzipFilter file(new IO::StandardFile(blockGzipName.c_str(),IO::File::WriteOnly));
+		writeFile(file,data);
+		}
+		
+		/* Check the index members at the end of the compressed file: */
+		std::vector<unsigned char> contents;
+		size_t indexPos=0;
+		bool haveIndex=readTail(blockGzipName.c_str(),contents,indexPos);
+		passed=report("Block index trailer",haveIndex)&&passed;
+		
+		/* Read the file sequentially and through random seeks using the block index: */
+		{
+		IO::SeekableFilePtr file=IO::openSeekableFile(blockGzipName.c_str());
+		passed=report("Block-gzip sequential read",compareSequential(*file,data))&&passed;
+		passed=report("Block-gzip seeks through block index",compareSeeks(*file,data,numSeeks))&&passed;
+		}
+		
+		if(haveIndex)
+			{
+			/* Strip the index members to force the filter to scan the gzip member headers: */
+			std::vector<unsigned char> scanned(contents.begin(),contents.begin()+indexPos);
+			scanned.insert(scanned.end(),contents.end()-28,contents.end());
+			writeRaw(scannedName.c_str(),&scanned[0],scanned.size());
+			IO::BlockGzipFilter file(new IO::StandardFile(scannedName.c_str()));
+			passed=report("Block-gzip seeks through scanned blocks",compareSeeks(file,data,numSeeks))&&passed;
+			}
+		
+		/* Read the block-gzipped file with a standard gzip filter: */
+		{
+		IO::GzipFilter file(new IO::StandardFile(blockGzipName.c_str()));
+		passed=report("Block-gzip read by gzip filter",compareSequential(file,data))&&passed;
+		}
+		
+		/* Write the test data through the default .gz writer, which must produce a plain gzip file: */
+		{
+		IO::FilePtr file=IO::openFile(gzipName.c_str(),IO::File::WriteOnly);
+		writeFile(*file,data);
+		}
+		{
+		IO::StandardFile file(gzipName.c_str());
+		passed=report("Default .gz writer is plain gzip",!IO::BlockGzipFilter::isBlockGzipped(file))&&passed;
+		}
+		
+		/* Append zero padding to the plain gzip file and read it back: */
+		{
+		IO::StandardFile file(gzipName.c_str());
+		std::vector<unsigned char> padded(size_t(file.getSize())+512,0U);
+		file.readRaw(&padded[0],padded.size()-512);
+		writeRaw(gzipName.c_str(),&padded[0],padded.size());
+		}
+		{
+		IO::FilePtr file=IO::openFile(gzipName.c_str());
+		passed=report("Gzip read with trailing padding",compareSequential(*file,data))&&passed;
+		}
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		passed=false;
+		}
+	
+	/* Clean up: */
+	remove(blockGzipName.c_str());
+	remove(scannedName.c_str());
+	remove(gzipName.c_str());
+	
+	return passed?0:1;
+	}
@@ -0,0 +1,394 @@
+/***********************************************************************
+ParserBenchmark - Program to measure the throughput of IO::ValueSource,
+IO::TokenSource, and IO::CSVSource on large generated text files read
+through standard files, standard files with tiny read buffers, and
+memory-mapped files, while checking every parsed value against the
+generated contents.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the I/O Support Library (IO).
+
+The I/O Support Library is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License as published
+by the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+The I/O Support Library is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the I/O Support Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <Realtime/Time.h>
+#include <IO/File.h>
+#include <IO/StandardFile.h>
+#include <IO/MemMappedFile.h>
+#include <IO/ValueSource.h>
+#include <IO/TokenSource.h>
+#include <IO/CSVSource.h>
+
+namespace {
+
+/**************
+Helper classes:
+**************/
+
+struct Record // Structure for the values stored in one line of a generated file
+	{
+	/* Elements: */
+	public:
+	std::string word; // Unquoted word
+	std::string text; // Text that is quoted in the file
+	int integer; // Signed integer
+	std::string numberText; // Floating-point number as written to the file
+	double number; // Exact value of the floating-point number
+	unsigned int unsignedInteger; // Unsigned integer
+	};
+
+class Digest // Class to compute an FNV-1a hash over all parsed values, to compare results between library versions
+	{
+	/* Elements: */
+	private:
+	unsigned long long hash; // Current hash value
+	
+	/* Constructors and destructors: */
+	public:
+	Digest(void)
+		:hash(14695981039346656037ULL)
+		{
+		}
+	
+	/* Methods: */
+	void add(const void* data,size_t size) // Adds the given raw data to the hash
+		{
+		const unsigned char* dPtr=static_cast<const unsigned char*>(data);
+		for(size_t i=0;i<size;++i)
+			{
+			hash^=dPtr[i];
+			hash*=1099511628211ULL;
+			}
+		}
+	void add(const std::string& string) // Adds the given string and a terminator to the hash
+		{
+		add(string.data(),string.size());
+		add("",1);
+		}
+	template <class ValueParam>
+	void addValue(const ValueParam& value) // Adds the binary representation of the given value to the hash
+		{
+		add(&value,sizeof(ValueParam));
+		}
+	unsigned long long getHash(void) const
+		{
+		return hash;
+		}
+	};
+
+/****************
+Helper functions:
+****************/
+
+void createRecord(unsigned int lineIndex,Record& record) // Creates the deterministic contents of the given line
+	{
+	char buffer[64];
+	snprintf(buffer,sizeof(buffer),"word%u",lineIndex);
+	record.word=buffer;
+	snprintf(buffer,sizeof(buffer),"quoted, %u text",lineIndex*31U);
+	record.text=buffer;
+	record.integer=int((lineIndex*7919U)%200000U)-100000;
+	record.unsignedInteger=lineIndex*2654435761U;
+	
+	/* Create a number whose decimal representation converts exactly, with an optional exponent: */
+	unsigned int integral=(lineIndex*104729U)%100000U;
+	unsigned int eighths=lineIndex%8U;
+	unsigned int exponent=lineIndex%3U;
+	bool negative=lineIndex%2U==1U;
+	snprintf(buffer,sizeof(buffer),"%s%u.%03u",negative?"-":"",integral,eighths*125U);
+	record.numberText=buffer;
+	record.number=double(integral)+double(eighths)/8.0;
+	if(negative)
+		record.number=-record.number;
+	if(lineIndex%5U==0U)
+		{
+		snprintf(buffer,sizeof(buffer),"e%u",exponent);
+		record.numberText.append(buffer);
+		for(unsigned int i=0;i<exponent;++i)
+			record.number*=10.0;
+		}
+	}
+
+size_t writeFiles(const char* valueFileName,const char* csvFileName,unsigned int numLines) // Writes the value and CSV test files; returns the size of the value file
+	{
+	IO::StandardFile valueFile(valueFileName,IO::File::WriteOnly);
+	IO::StandardFile csvFile(csvFileName,IO::File::WriteOnly);
+	size_t valueFileSize=0;
+	Record record;
+	std::string line;
+	char buffer[64];
+	for(unsigned int lineIndex=0;lineIndex<numLines;++lineIndex)
+		{
+		createRecord(lineIndex,record);
+		
+		/* Write a whitespace-separated line for the value and token sources: */
+		line=record.word;
+		line.append(" \"");
+		line.append(record.text);
+		line.append("\"  ");
+		snprintf(buffer,sizeof(buffer),"%d\t",record.integer);
+		line.append(buffer);
+		line.append(record.numberText);
+		snprintf(buffer,sizeof(buffer)," , %u\n",record.unsignedInteger);
+		line.append(buffer);
+		valueFile.writeRaw(line.data(),line.size());
+		valueFileSize+=line.size();
+		
+		/* Write a CSV record: */
+		snprintf(buffer,sizeof(buffer),"%d,",record.integer);
+		line=buffer;
+		line.append(record.numberText);
+		line.append(",\"");
+		line.append(record.text);
+		line.append(" \"\"quoted\"\"\",");
+		line.append(record.word);
+		line.push_back('\n');
+		csvFile.writeRaw(line.data(),line.size());
+		}
+	
+	return valueFileSize;
+	}
+
+IO::FilePtr openFile(const char* fileName,int fileType) // Opens the given file as a standard file, a standard file with a tiny read buffer, or a memory-mapped file
+	{
+	if(fileType==2)
+		return new IO::MemMappedFile(fileName);
+	IO::FilePtr result=new IO::StandardFile(fileName);
+	if(fileType==1)
+		result->resizeReadBuffer(7);
+	return result;
+	}
+
+bool parseValues(IO::FilePtr file,unsigned int numLines,Digest* digest) // Parses the value file using a value source; if digest is not null, checks all values and adds them to the digest; returns false on mismatch
+	{
+	IO::ValueSource source(file);
+	source.setPunctuation(",");
+	source.setQuotes("\"");
+	source.skipWs();
+	Record record;
+	for(unsigned int lineIndex=0;lineIndex<numLines;++lineIndex)
+		{
+		std::string word=source.readString();
+		std::string text=source.readString();
+		int integer=source.readInteger();
+		double number=source.readNumber();
+		int comma=source.readChar();
+		unsigned int unsignedInteger=source.readUnsignedInteger();
+		if(digest!=0)
+			{
+			createRecord(lineIndex,record);
+			if(word!=record.word||text!=record.text||integer!=record.integer||number!=record.number||comma!=','||unsignedInteger!=record.unsignedInteger)
+				return false;
+			digest->add(word);
+			digest->add(text);
+			digest->addValue(integer);
+			digest->addValue(number);
+			digest->addValue(unsignedInteger);
+			}
+		}
+	return source.eof();
+	}
+
+bool parseTokens(IO::FilePtr file,unsigned int numLines,Digest* digest) // Parses the value file using a token source; if digest is not null, checks all tokens and adds them to the digest; returns false on mismatch
+	{
+	IO::TokenSource source(file);
+	source.setPunctuation(",");
+	source.setQuotes("\"");
+	source.skipWs();
+	Record record;
+	std::string expected[6];
+	char buffer[64];
+	for(unsigned int lineIndex=0;lineIndex<numLines;++lineIndex)
+		{
+		if(digest!=0)
+			{
+			/* Create the expected tokens of this line: */
+			createRecord(lineIndex,record);
+			expected[0]=record.word;
+			expected[1]=record.text;
+			snprintf(buffer,sizeof(buffer),"%d",record.integer);
+			expected[2]=buffer;
+			expected[3]=record.numberText;
+			expected[4]=",";
+			snprintf(buffer,sizeof(buffer),"%u",record.unsignedInteger);
+			expected[5]=buffer;
+			}
+		for(int i=0;i<6;++i)
+			{
+			source.readNextToken();
+			if(digest!=0)
+				{
+				if(!source.isToken(expected[i].c_str()))
+					return false;
+				digest->add(source.getToken());
+				}
+			}
+		}
+	return source.eof();
+	}
+
+bool parseCSV(IO::FilePtr file,unsigned int numLines,Digest* digest) // Parses the CSV file using a CSV source; if digest is not null, checks all fields and adds them to the digest; returns false on mismatch
+	{
+	IO::CSVSource source(file);
+	Record record;
+	for(unsigned int lineIndex=0;lineIndex<numLines;++lineIndex)
+		{
+		int integer=source.readField<int>();
+		double number=source.readField<double>();
+		std::string text=source.readField<std::string>();
+		std::string word=source.readField<std::string>();
+		if(digest!=0)
+			{
+			createRecord(lineIndex,record);
+			if(integer!=record.integer||number!=record.number||text!=record.text+" \"quoted\""||word!=record.word||!source.eor())
+				return false;
+			digest->addValue(integer);
+			digest->addValue(number);
+			digest->add(text);
+			digest->add(word);
+			}
+		}
+	return source.eof();
+	}
+
+bool parseFile(int parser,const char* fileName,int fileType,unsigned int numLines,Digest* digest) // Parses the given file with the given parser
+	{
+	IO::FilePtr file=openFile(fileName,fileType);
+	switch(parser)
+		{
+		case 0:
+			return parseValues(file,numLines,digest);
+		
+		case 1:
+			return parseTokens(file,numLines,digest);
+		
+		default:
+			return parseCSV(file,numLines,digest);
+		}
+	}
+
+bool report(const char* testName,bool passed) // Prints the result of a single test
+	{
+	std::cout<<testName<<": "<<(passed?"passed":"FAILED")<<std::endl;
+	return passed;
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse command line: */
+	unsigned int numLines=1000000;
+	unsigned int numRepeats=3;
+	const char* baseName="ParserBenchmark";
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"lines")==0&&i+1<argc)
+				{
+				++i;
+				numLines=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"repeats")==0&&i+1<argc)
+				{
+				++i;
+				numRepeats=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			baseName=argv[i];
+		}
+	if(numLines==0||numRepeats==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-lines <number of lines per test file>] [-repeats <number of timed repetitions>] [<temporary file base name>]"<<std::endl;
+		return 1;
+		}
+	std::string valueFileName=std::string(baseName)+".txt";
+	std::string csvFileName=std::string(baseName)+".csv";
+	
+	static const char* parserNames[3]={"ValueSource","TokenSource","CSVSource"};
+	static const char* fileTypeNames[3]={"standard file","tiny read buffer","memory-mapped file"};
+	
+	bool passed=true;
+	try
+		{
+		/* Create the test files: */
+		size_t valueFileSize=writeFiles(valueFileName.c_str(),csvFileName.c_str(),numLines);
+		size_t csvFileSize=size_t(IO::StandardFile(csvFileName.c_str()).getSize());
+		
+		/* Run all parsers on all file types: */
+		std::vector<std::string> rows;
+		for(int parser=0;parser<3;++parser)
+			{
+			const char* fileName=parser<2?valueFileName.c_str():csvFileName.c_str();
+			size_t fileSize=parser<2?valueFileSize:csvFileSize;
+			unsigned long long firstHash=0;
+			for(int fileType=0;fileType<3;++fileType)
+				{
+				/* Check the parsed values and that all file types produce the same digest: */
+				Digest digest;
+				bool ok=parseFile(parser,fileName,fileType,numLines,&digest);
+				unsigned long long hash=digest.getHash();
+				if(fileType==0)
+					firstHash=hash;
+				std::string testName=std::string(parserNames[parser])+" on "+fileTypeNames[fileType];
+				passed=report(testName.c_str(),ok&&hash==firstHash)&&passed;
+				
+				/* Time parsing the file without checking the parsed values: */
+				std::vector<double> times;
+				for(unsigned int repeat=0;repeat<numRepeats;++repeat)
+					{
+					Realtime::TimePointMonotonic start;
+					parseFile(parser,fileName,fileType,numLines,0);
+					times.push_back(double(start.setAndDiff())*1.0e3);
+					}
+				
+				/* Format the minimum and median times and the median throughput: */
+				std::sort(times.begin(),times.end());
+				double medianTime=times[times.size()/2];
+				char row[256];
+				snprintf(row,sizeof(row),"%s,%s,%lu,%.1f,%.1f,%.1f,%016llx",parserNames[parser],fileTypeNames[fileType],(unsigned long)fileSize,times.front(),medianTime,double(fileSize)/(medianTime*1.0e-3)/(1024.0*1024.0),hash);
+				rows.push_back(row);
+				}
+			}
+		
+		/* Print the result table; digests must not change between library versions: */
+		printf("\nParser,File type,File size (bytes),Minimum time (ms),Median time (ms),Throughput (MB/s),Digest\n");
+		for(std::vector<std::string>::iterator rIt=rows.begin();rIt!=rows.end();++rIt)
+			printf("%s\n",rIt->c_str());
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		passed=false;
+		}
+	
+	/* Clean up: */
+	remove(valueFileName.c_str());
+	remove(csvFileName.c_str());
+	
+	return passed?0:1;
+	}
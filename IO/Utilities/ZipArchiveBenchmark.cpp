@@ -0,0 +1,343 @@
+/***********************************************************************
+ZipArchiveBenchmark - Program to measure the time to open a large ZIP
+archive with and without a directory index cache, and to extract all its
+entries sequentially and concurrently, while checking that all access
+paths return the original file contents.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the I/O Support Library (IO).
+
+The I/O Support Library is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License as published
+by the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+The I/O Support Library is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the I/O Support Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/ThrowStdErr.h>
+#include <Realtime/Time.h>
+#include <IO/SeekableFile.h>
+#include <IO/StandardFile.h>
+#include <IO/ZipArchive.h>
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+void createFileData(unsigned int fileIndex,size_t averageSize,std::vector<unsigned char>& data) // Creates the deterministic contents of the given archive entry
+	{
+	/* Seed a pseudo-random number generator with the file index: */
+	unsigned int state=fileIndex*2654435761U+1U;
+	state=state*1103515245U+12345U;
+	size_t size=averageSize/2+size_t((state>>1)%(averageSize+1));
+	
+	/* Fill the file with moderately compressible text: */
+	data.resize(size);
+	for(size_t i=0;i<size;++i)
+		{
+		if(i%64==0)
+			state=state*1103515245U+12345U;
+		data[i]=(unsigned char)('a'+((state>>8)+i%7U)%26U);
+		}
+	}
+
+std::string getFileName(unsigned int fileIndex) // Returns the name of the given archive entry
+	{
+	char fileName[64];
+	snprintf(fileName,sizeof(fileName),"dir%03u/file%05u.dat",fileIndex/100U,fileIndex);
+	return fileName;
+	}
+
+void putUInt16(std::vector<unsigned char>& buffer,unsigned int value) // Appends a little-endian 16-bit value
+	{
+	buffer.push_back((unsigned char)(value&0xffU));
+	buffer.push_back((unsigned char)((value>>8)&0xffU));
+	}
+
+void putUInt32(std::vector<unsigned char>& buffer,unsigned int value) // Appends a little-endian 32-bit value
+	{
+	putUInt16(buffer,value&0xffffU);
+	putUInt16(buffer,(value>>16)&0xffffU);
+	}
+
+void deflateData(const std::vector<unsigned char>& data,std::vector<unsigned char>& compressed) // Compresses the given data into a raw deflate stream
+	{
+	z_stream stream;
+	memset(&stream,0,sizeof(z_stream));
+	if(deflateInit2(&stream,Z_DEFAULT_COMPRESSION,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+		Misc::throwStdErr("ZipArchiveBenchmark: Unable to initialize deflate stream");
+	compressed.resize(deflateBound(&stream,uLong(data.size())));
+	stream.next_in=const_cast<Bytef*>(&data[0]);
+	stream.avail_in=uInt(data.size());
+	stream.next_out=&compressed[0];
+	stream.avail_out=uInt(compressed.size());
+	int result=deflate(&stream,Z_FINISH);
+	compressed.resize(compressed.size()-stream.avail_out);
+	deflateEnd(&stream);
+	if(result!=Z_STREAM_END)
+		Misc::throwStdErr("ZipArchiveBenchmark: Unable to compress file data");
+	}
+
+void writeArchive(const char* archiveFileName,unsigned int numFiles,size_t averageSize) // Writes a ZIP archive where every fourth entry is stored and all others are deflated
+	{
+	IO::StandardFile archive(archiveFileName,IO::File::WriteOnly);
+	std::vector<unsigned char> centralDirectory;
+	unsigned int archivePos=0;
+	std::vector<unsigned char> data,compressed,header;
+	for(unsigned int fileIndex=0;fileIndex<numFiles;++fileIndex)
+		{
+		/* Create and optionally compress the file's contents: */
+		createFileData(fileIndex,averageSize,data);
+		std::string fileName=getFileName(fileIndex);
+		unsigned int crc=(unsigned int)(crc32(crc32(0L,Z_NULL,0),&data[0],uInt(data.size())));
+		bool stored=fileIndex%4==0;
+		if(!stored)
+			deflateData(data,compressed);
+		const std::vector<unsigned char>& fileData=stored?data:compressed;
+		
+		/* Write the file's local header, name, and data: */
+		header.clear();
+		putUInt32(header,0x04034b50U);
+		putUInt16(header,20U);
+		putUInt16(header,0U);
+		putUInt16(header,stored?0U:8U);
+		putUInt16(header,0U);
+		putUInt16(header,0x21U);
+		putUInt32(header,crc);
+		putUInt32(header,(unsigned int)(fileData.size()));
+		putUInt32(header,(unsigned int)(data.size()));
+		putUInt16(header,(unsigned int)(fileName.size()));
+		putUInt16(header,0U);
+		archive.writeRaw(&header[0],header.size());
+		archive.writeRaw(fileName.data(),fileName.size());
+		archive.writeRaw(&fileData[0],fileData.size());
+		
+		/* Append the file's central directory entry: */
+		putUInt32(centralDirectory,0x02014b50U);
+		putUInt16(centralDirectory,20U);
+		centralDirectory.insert(centralDirectory.end(),header.begin()+4,header.end());
+		putUInt16(centralDirectory,0U);
+		putUInt16(centralDirectory,0U);
+		putUInt16(centralDirectory,0U);
+		putUInt32(centralDirectory,0U);
+		putUInt32(centralDirectory,archivePos);
+		centralDirectory.insert(centralDirectory.end(),fileName.begin(),fileName.end());
+		
+		archivePos+=(unsigned int)(header.size()+fileName.size()+fileData.size());
+		}
+	
+	/* Write the central directory and end-of-central-directory record: */
+	archive.writeRaw(&centralDirectory[0],centralDirectory.size());
+	header.clear();
+	putUInt32(header,0x06054b50U);
+	putUInt16(header,0U);
+	putUInt16(header,0U);
+	putUInt16(header,numFiles);
+	putUInt16(header,numFiles);
+	putUInt32(header,(unsigned int)(centralDirectory.size()));
+	putUInt32(header,archivePos);
+	putUInt16(header,0U);
+	archive.writeRaw(&header[0],header.size());
+	}
+
+bool findAllFiles(const IO::ZipArchive& archive,unsigned int numFiles,std::vector<IO::ZipArchive::FileID>& fileIds) // Looks up all archive entries by name; returns false if any entry is missing
+	{
+	fileIds.clear();
+	try
+		{
+		for(unsigned int fileIndex=0;fileIndex<numFiles;++fileIndex)
+			fileIds.push_back(archive.findFile(getFileName(fileIndex).c_str()));
+		}
+	catch(const IO::ZipArchive::FileNotFoundError&)
+		{
+		return false;
+		}
+	return true;
+	}
+
+bool compareFiles(std::vector<IO::SeekableFilePtr>& files,size_t averageSize) // Compares all extracted files to their original contents
+	{
+	std::vector<unsigned char> data,buffer;
+	for(unsigned int fileIndex=0;fileIndex<files.size();++fileIndex)
+		{
+		createFileData(fileIndex,averageSize,data);
+		if(files[fileIndex]==0||files[fileIndex]->getSize()!=IO::SeekableFile::Offset(data.size()))
+			return false;
+		buffer.resize(data.size());
+		files[fileIndex]->readRaw(&buffer[0],buffer.size());
+		if(buffer!=data)
+			return false;
+		}
+	return true;
+	}
+
+double getMedian(std::vector<double>& times) // Returns the median of the given list of times
+	{
+	std::sort(times.begin(),times.end());
+	return times[times.size()/2];
+	}
+
+bool report(const char* testName,bool passed) // Prints the result of a single test
+	{
+	std::cout<<testName<<": "<<(passed?"passed":"FAILED")<<std::endl;
+	return passed;
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse command line: */
+	unsigned int numFiles=20000;
+	size_t averageSize=4096;
+	unsigned int numRepeats=5;
+	unsigned int numThreads=0;
+	const char* baseName="ZipArchiveBenchmark";
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"files")==0&&i+1<argc)
+				{
+				++i;
+				numFiles=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"size")==0&&i+1<argc)
+				{
+				++i;
+				averageSize=size_t(atof(argv[i])*1024.0);
+				}
+			else if(strcasecmp(argv[i]+1,"repeats")==0&&i+1<argc)
+				{
+				++i;
+				numRepeats=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"threads")==0&&i+1<argc)
+				{
+				++i;
+				numThreads=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			baseName=argv[i];
+		}
+	if(numFiles==0||numFiles>65535||averageSize==0||numRepeats==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-files <number of archive entries, at most 65535>] [-size <average entry size in KB>] [-repeats <number of timed repetitions>] [-threads <number of extraction threads, 0 for one per CPU>] [<temporary file base name>]"<<std::endl;
+		return 1;
+		}
+	std::string archiveName=std::string(baseName)+".zip";
+	std::string indexCacheName=std::string(baseName)+".zipindex";
+	
+	bool passed=true;
+	try
+		{
+		/* Create the test archive and remove any stale index cache: */
+		writeArchive(archiveName.c_str(),numFiles,averageSize);
+		remove(indexCacheName.c_str());
+		
+		/* Time opening the archive by parsing its central directory: */
+		std::vector<double> times;
+		for(unsigned int repeat=0;repeat<numRepeats;++repeat)
+			{
+			Realtime::TimePointMonotonic start;
+			IO::ZipArchive archive(archiveName.c_str());
+			times.push_back(double(start.setAndDiff())*1.0e3);
+			}
+		double parseTime=getMedian(times);
+		
+		/* Create the index cache, then time opening the archive from the cache: */
+		{
+		IO::ZipArchive archive(archiveName.c_str(),indexCacheName.c_str());
+		}
+		times.clear();
+		for(unsigned int repeat=0;repeat<numRepeats;++repeat)
+			{
+			Realtime::TimePointMonotonic start;
+			IO::ZipArchive archive(archiveName.c_str(),indexCacheName.c_str());
+			times.push_back(double(start.setAndDiff())*1.0e3);
+			}
+		double cacheTime=getMedian(times);
+		
+		/* Check that both directory trees contain all entries with the same file IDs: */
+		IO::ZipArchive parsedArchive(archiveName.c_str());
+		IO::ZipArchive archive(archiveName.c_str(),indexCacheName.c_str());
+		std::vector<IO::ZipArchive::FileID> parsedFileIds,fileIds;
+		bool parsedOk=findAllFiles(parsedArchive,numFiles,parsedFileIds);
+		passed=report("Find all entries in parsed directory",parsedOk)&&passed;
+		bool cachedOk=findAllFiles(archive,numFiles,fileIds);
+		passed=report("Find all entries in cached directory",cachedOk)&&passed;
+		if(parsedOk&&cachedOk)
+			{
+			bool same=true;
+			for(unsigned int fileIndex=0;fileIndex<numFiles;++fileIndex)
+				same=same&&parsedFileIds[fileIndex].getFileSize()==fileIds[fileIndex].getFileSize()&&parsedFileIds[fileIndex].getCompressedFileSize()==fileIds[fileIndex].getCompressedFileSize();
+			passed=report("Cached directory matches parsed directory",same)&&passed;
+			}
+		
+		if(cachedOk)
+			{
+			/* Time extracting all entries sequentially: */
+			std::vector<IO::SeekableFilePtr> files;
+			times.clear();
+			for(unsigned int repeat=0;repeat<numRepeats;++repeat)
+				{
+				files.clear();
+				Realtime::TimePointMonotonic start;
+				for(std::vector<IO::ZipArchive::FileID>::iterator fIt=fileIds.begin();fIt!=fileIds.end();++fIt)
+					files.push_back(archive.openSeekableFile(*fIt));
+				times.push_back(double(start.setAndDiff())*1.0e3);
+				}
+			double sequentialTime=getMedian(times);
+			passed=report("Sequential extraction",compareFiles(files,averageSize))&&passed;
+			
+			/* Time extracting all entries concurrently: */
+			times.clear();
+			for(unsigned int repeat=0;repeat<numRepeats;++repeat)
+				{
+				files.clear();
+				Realtime::TimePointMonotonic start;
+				archive.extractFiles(fileIds,files,numThreads);
+				times.push_back(double(start.setAndDiff())*1.0e3);
+				}
+			double parallelTime=getMedian(times);
+			passed=report("Parallel extraction",compareFiles(files,averageSize))&&passed;
+			
+			/* Print the median times in milliseconds: */
+			printf("\nEntries,Parse directory (ms),Load index cache (ms),Sequential extraction (ms),Parallel extraction (ms)\n");
+			printf("%u,%.3f,%.3f,%.3f,%.3f\n",numFiles,parseTime,cacheTime,sequentialTime,parallelTime);
+			}
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		passed=false;
+		}
+	
+	/* Clean up: */
+	remove(archiveName.c_str());
+	remove(indexCacheName.c_str());
+	
+	return passed?0:1;
+	}
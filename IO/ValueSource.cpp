@@ -30,10 +30,40 @@ namespace IO {
 Methods of class ValueSource:
 ****************************/
 
+int ValueSource::fillBuffer(void)
+	{
+	/* Mark the entire current buffer window as read: */
+	source->skipInBuffer(bufferEnd-bufferStart);
+	
+	/* Peek at the character source's next buffer of data: */
+	const void* buffer;
+	size_t bufferSize=source->peekInBuffer(buffer);
+	bufferStart=static_cast<const unsigned char*>(buffer);
+	bufferPtr=bufferStart;
+	bufferEnd=bufferStart+bufferSize;
+	
+	/* Return the window's first character: */
+	if(bufferPtr!=bufferEnd)
+		return int(*(bufferPtr++));
+	else
+		return -1;
+	}
+
+void ValueSource::ungetSourceChar(void)
+	{
+	/* Mark all characters read from the buffer window as read in the character source, and drop the window: */
+	source->skipInBuffer(bufferPtr-bufferStart);
+	bufferStart=bufferPtr=bufferEnd=0;
+	
+	/* Put the last read character back into the character source: */
+	if(lastChar>=0)
+		source->ungetChar(lastChar);
+	}
+
 char ValueSource::processEscape(void)
 	{
 	/* Skip the escape character: */
-	lastChar=source->getChar();
+	lastChar=readSourceChar();
 	
 	/* Handle the escape sequence: */
 	char result;
@@ -79,8 +109,8 @@ char ValueSource::processEscape(void)
 			{
 			/* Parse an octal character code: */
 			result=lastChar-'0';
-			lastChar=source->getChar();
-			for(int i=1;i<3&&lastChar>='0'&&lastChar<='7';++i,lastChar=source->getChar())
+			lastChar=readSourceChar();
+			for(int i=1;i<3&&lastChar>='0'&&lastChar<='7';++i,lastChar=readSourceChar())
 				result=(result<<3)+(lastChar-'0');
 			mustSkip=false;
 			break;
@@ -90,7 +120,7 @@ char ValueSource::processEscape(void)
 			{
 			/* Parse a hexadecimal character code: */
 			result=0;
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			while((lastChar>='0'&&lastChar<='9')||(lastChar>='A'&&lastChar<='F')||(lastChar>='a'&&lastChar<='f'))
 				{
 				if(lastChar>='0'&&lastChar<='9')
@@ -99,7 +129,7 @@ char ValueSource::processEscape(void)
 					result=(result<<4)+(lastChar-'A'+10);
 				else
 					result=(result<<4)+(lastChar-'a'+10);
-				lastChar=source->getChar();
+				lastChar=readSourceChar();
 				}
 			mustSkip=false;
 			break;
@@ -116,13 +146,14 @@ char ValueSource::processEscape(void)
 			result=lastChar;
 		}
 	if(mustSkip)
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 	
 	return result;
 	}
 
 ValueSource::ValueSource(FilePtr sSource)
 	:source(sSource),
+	 bufferStart(0),bufferPtr(0),bufferEnd(0),
 	 cc(characterClasses+1),
 	 escapeChar(-1)
 	{
@@ -130,14 +161,16 @@ ValueSource::ValueSource(FilePtr sSource)
 	resetCharacterClasses();
 	
 	/* Read the first character from the character source: */
-	lastChar=source->getChar();
+	lastChar=readSourceChar();
 	}
 
 ValueSource::~ValueSource(void)
 	{
-	/* Put the last read character back into the character source: */
-	if(lastChar>=0)
-		source->ungetChar(lastChar);
+	/* Mark all characters up to, but not including, the last read character as read in the character source: */
+	if(lastChar>=0&&bufferPtr!=bufferStart&&bufferPtr[-1]==lastChar)
+		source->skipInBuffer(bufferPtr-1-bufferStart);
+	else
+		ungetSourceChar();
 	}
 
 void ValueSource::resetCharacterClasses(void)
@@ -278,11 +311,18 @@ void ValueSource::skipLine(void)
 	{
 	/* Skip everything until the next newline: */
 	while(lastChar>=0&&lastChar!='\n')
-		lastChar=source->getChar();
+		{
+		/* Find the next newline directly in the buffer window: */
+		const unsigned char* bPtr;
+		for(bPtr=bufferPtr;bPtr!=bufferEnd&&*bPtr!='\n';++bPtr)
+			;
+		bufferPtr=bPtr;
+		lastChar=readSourceChar();
+		}
 	
 	/* Skip the newline: */
 	if(lastChar=='\n')
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 	}
 
 std::string ValueSource::readLine(void)
@@ -293,12 +333,19 @@ std::string ValueSource::readLine(void)
 	while(lastChar>=0&&lastChar!='\n')
 		{
 		result.push_back(lastChar);
-		lastChar=source->getChar();
+		
+		/* Append everything up to the next newline directly from the buffer window: */
+		const unsigned char* bPtr;
+		for(bPtr=bufferPtr;bPtr!=bufferEnd&&*bPtr!='\n';++bPtr)
+			;
+		result.append(bufferPtr,bPtr);
+		bufferPtr=bPtr;
+		lastChar=readSourceChar();
 		}
 	
 	/* Skip the newline: */
 	if(lastChar=='\n')
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 	
 	return result;
 	}
@@ -311,7 +358,7 @@ unsigned int ValueSource::matchString(const char* string)
 		{
 		++result;
 		++string;
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		}
 	
 	return result;
@@ -327,7 +374,7 @@ bool ValueSource::isLiteral(const char* literal)
 		if(lastChar==*literal)
 			{
 			/* Go to the next character: */
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			++literal;
 			}
 		result=*literal=='\0';
@@ -338,7 +385,7 @@ bool ValueSource::isLiteral(const char* literal)
 		while((cc[lastChar]&STRING)&&lastChar==*literal)
 			{
 			/* Go to the next character: */
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			++literal;
 			}
 		
@@ -347,13 +394,12 @@ bool ValueSource::isLiteral(const char* literal)
 		while(cc[lastChar]&STRING)
 			{
 			result=false;
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			}
 		}
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
@@ -367,28 +413,27 @@ bool ValueSource::isLiteral(char literal)
 		/* Match a single punctuation character: */
 		result=lastChar==literal;
 		if(result)
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 		}
 	else if(cc[lastChar]&STRING)
 		{
 		/* Check the string's first character against the literal: */
 		result=lastChar==literal;
 		if(result)
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 		
 		/* Check if the string has been exhausted; if not, skip the rest of it: */
 		while(cc[lastChar]&STRING)
 			{
 			result=false;
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			}
 		}
 	else
 		result=false;
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
@@ -403,7 +448,7 @@ bool ValueSource::isCaseLiteral(const char* literal)
 		if(tolower(lastChar)==tolower(*literal))
 			{
 			/* Go to the next character: */
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			++literal;
 			}
 		result=*literal=='\0';
@@ -414,7 +459,7 @@ bool ValueSource::isCaseLiteral(const char* literal)
 		while((cc[lastChar]&STRING)&&tolower(lastChar)==tolower(*literal))
 			{
 			/* Go to the next character: */
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			++literal;
 			}
 		
@@ -423,13 +468,12 @@ bool ValueSource::isCaseLiteral(const char* literal)
 		while(cc[lastChar]&STRING)
 			{
 			result=false;
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			}
 		}
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
@@ -443,27 +487,26 @@ bool ValueSource::isCaseLiteral(char literal)
 		/* Match a single punctuation character: */
 		result=tolower(lastChar)==tolower(literal);
 		if(result)
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 		}
 	else if(cc[lastChar]&STRING)
 		{
 		/* Check the string's first character against the literal: */
 		result=tolower(lastChar)==tolower(literal);
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		
 		/* Check if the string has been exhausted; if not, skip the rest of it: */
 		while(cc[lastChar]&STRING)
 			{
 			result=false;
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			}
 		}
 	else
 		result=false;
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
@@ -473,28 +516,28 @@ void ValueSource::skipString(void)
 	if(cc[lastChar]&PUNCTUATION)
 		{
 		/* Read a punctuation character: */
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		}
 	else if(cc[lastChar]&QUOTE)
 		{
 		/* Read the quote character and temporarily remove it from the set of quoted string characters: */
 		int quote=lastChar;
 		cc[quote]&=~QUOTEDSTRING;
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		
 		/* Read characters until the matching quote, endline, or EOF: */
 		while(cc[lastChar]&QUOTEDSTRING)
 			{
 			/* Skip the next character or escape sequence: */
 			if(lastChar!=escapeChar)
-				lastChar=source->getChar();
+				lastChar=readSourceChar();
 			else
 				processEscape();
 			}
 		
 		/* Read the terminating quote, if there is one: */
 		if(lastChar==quote)
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 		
 		/* Add the quote character to the set of quoted string characters again: */
 		cc[quote]|=QUOTEDSTRING;
@@ -506,15 +549,14 @@ void ValueSource::skipString(void)
 			{
 			/* Skip the next character or escape sequence: */
 			if(lastChar!=escapeChar)
-				lastChar=source->getChar();
+				lastChar=readSourceChar();
 			else
 				processEscape();
 			}
 		}
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	}
 
 std::string ValueSource::readString(void)
@@ -525,14 +567,14 @@ std::string ValueSource::readString(void)
 		{
 		/* Read a punctuation character: */
 		result.push_back(lastChar);
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		}
 	else if(cc[lastChar]&QUOTE)
 		{
 		/* Read the quote character and temporarily remove it from the set of quoted string characters: */
 		int quote=lastChar;
 		cc[quote]&=~QUOTEDSTRING;
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		
 		/* Read characters until the matching quote, endline, or EOF: */
 		while(cc[lastChar]&QUOTEDSTRING)
@@ -541,7 +583,7 @@ std::string ValueSource::readString(void)
 			if(lastChar!=escapeChar)
 				{
 				result.push_back(lastChar);
-				lastChar=source->getChar();
+				lastChar=readSourceChar();
 				}
 			else
 				result.push_back(processEscape());
@@ -549,7 +591,7 @@ std::string ValueSource::readString(void)
 		
 		/* Read the terminating quote, if there is one: */
 		if(lastChar==quote)
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 		
 		/* Add the quote character to the set of quoted string characters again: */
 		cc[quote]|=QUOTEDSTRING;
@@ -563,7 +605,7 @@ std::string ValueSource::readString(void)
 			if(lastChar!=escapeChar)
 				{
 				result.push_back(lastChar);
-				lastChar=source->getChar();
+				lastChar=readSourceChar();
 				}
 			else
 				result.push_back(processEscape());
@@ -571,8 +613,7 @@ std::string ValueSource::readString(void)
 		}
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
@@ -582,7 +623,7 @@ int ValueSource::readInteger(void)
 	/* Read a plus or minus sign: */
 	bool negate=lastChar=='-';
 	if(lastChar=='-'||lastChar=='+')
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 	
 	/* Signal an error if the next character is not a digit: */
 	if(!(cc[lastChar]&DIGIT))
@@ -593,7 +634,7 @@ int ValueSource::readInteger(void)
 	while(cc[lastChar]&DIGIT)
 		{
 		result=result*10+int(lastChar-'0');
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		}
 	
 	/* Negate the result if a minus sign was read: */
@@ -601,8 +642,7 @@ int ValueSource::readInteger(void)
 		result=-result;
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
@@ -618,12 +658,11 @@ unsigned int ValueSource::readUnsignedInteger(void)
 	while(cc[lastChar]&DIGIT)
 		{
 		result=result*10+(unsigned int)(lastChar-'0');
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		}
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
@@ -633,7 +672,7 @@ double ValueSource::readNumber(void)
 	/* Read a plus or minus sign: */
 	bool negate=lastChar=='-';
 	if(lastChar=='-'||lastChar=='+')
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 	
 	/* Read an integral number part: */
 	bool haveDigit=false;
@@ -642,13 +681,13 @@ double ValueSource::readNumber(void)
 		{
 		haveDigit=true;
 		result=result*10.0+double(lastChar-'0');
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		}
 	
 	/* Check for a period: */
 	if(lastChar=='.')
 		{
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		
 		/* Read a fractional number part: */
 		double fraction=0.0;
@@ -658,7 +697,7 @@ double ValueSource::readNumber(void)
 			haveDigit=true;
 			fraction=fraction*10.0+double(lastChar-'0');
 			fractionBase*=10.0;
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			}
 		
 		result+=fraction/fractionBase;
@@ -675,12 +714,12 @@ double ValueSource::readNumber(void)
 	/* Check for an exponent indicator: */
 	if(lastChar=='e'||lastChar=='E')
 		{
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		
 		/* Read a plus or minus sign: */
 		bool negateExponent=lastChar=='-';
 		if(lastChar=='-'||lastChar=='+')
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 		
 		/* Check if there are any digits in the exponent: */
 		if(!(cc[lastChar]&DIGIT))
@@ -691,7 +730,7 @@ double ValueSource::readNumber(void)
 		while(cc[lastChar]&DIGIT)
 			{
 			exponent=exponent*10.0+double(lastChar-'0');
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			}
 		
 		/* Multiply the mantissa with the exponent: */
@@ -699,8 +738,7 @@ double ValueSource::readNumber(void)
 		}
 	
 	/* Skip whitespace: */
-	while(cc[lastChar]&WHITESPACE)
-		lastChar=source->getChar();
+	skipWs();
 	
 	return result;
 	}
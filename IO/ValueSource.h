@@ -56,12 +56,24 @@ class ValueSource
 	
 	/* Elements: */
 	FilePtr source; // Data source for value reader
+	const unsigned char* bufferStart; // Start of the window into the data source's read buffer that is scanned in place
+	const unsigned char* bufferPtr; // Next unread character in the buffer window
+	const unsigned char* bufferEnd; // End of the buffer window
 	unsigned char characterClasses[257]; // Array of character type bit flags for quicker classification, with extra space for EOF
 	unsigned char* cc; // Pointer into character classes array to account for EOF==-1
 	int escapeChar; // Escape character for quoted and non-quoted strings; -1 if escape sequences should be ignored
 	int lastChar; // Last character read from character source
 	
 	/* Private methods: */
+	int fillBuffer(void); // Marks the current buffer window as read, peeks at the next window, and returns its first character or EOF
+	int readSourceChar(void) // Returns the next character from the buffer window, or EOF (-1) if the entire character source has been read
+		{
+		if(bufferPtr!=bufferEnd)
+			return int(*(bufferPtr++));
+		else
+			return fillBuffer();
+		}
+	void ungetSourceChar(void); // Puts the last read character back into the character source when it can not be put back into the buffer window
 	char processEscape(void); // Processes an escape sequence from the character source
 	
 	/* Constructors and destructors: */
@@ -87,7 +99,14 @@ class ValueSource
 		{
 		/* Skip all whitespace characters: */
 		while(cc[lastChar]&WHITESPACE)
-			lastChar=source->getChar();
+			{
+			/* Skip whitespace directly in the buffer window: */
+			const unsigned char* bPtr;
+			for(bPtr=bufferPtr;bPtr!=bufferEnd&&(cc[*bPtr]&WHITESPACE);++bPtr)
+				;
+			bufferPtr=bPtr;
+			lastChar=readSourceChar();
+			}
 		}
 	void skipLine(void); // Skips characters up to and including the next newline character
 	int peekc(void) const // Returns the next character that will be read, without reading it
@@ -97,19 +116,23 @@ class ValueSource
 	int getChar(void) // Returns the next character
 		{
 		int result=lastChar;
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		return result;
 		}
 	void ungetChar(int character) // Puts the given character back into the character source
 		{
-		source->ungetChar(lastChar);
+		/* Step back in the buffer window if the given character and the last read character were the last two characters read from it: */
+		if(lastChar>=0&&bufferPtr-bufferStart>=2&&bufferPtr[-1]==lastChar&&bufferPtr[-2]==character)
+			--bufferPtr;
+		else
+			ungetSourceChar();
 		lastChar=character;
 		}
 	
 	int readChar(void) // Reads and returns a single character
 		{
 		int result=lastChar;
-		lastChar=source->getChar();
+		lastChar=readSourceChar();
 		skipWs();
 		
 		return result;
@@ -125,7 +148,7 @@ class ValueSource
 		while(cc[lastChar]&STRING)
 			{
 			result=false;
-			lastChar=source->getChar();
+			lastChar=readSourceChar();
 			}
 		skipWs();
 		
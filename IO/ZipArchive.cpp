@@ -24,15 +24,27 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <IO/ZipArchive.h>
 
 #include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <zlib.h>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <Misc/SizedTypes.h>
 #include <Misc/ThrowStdErr.h>
+#include <Threads/Atomic.h>
+#include <Threads/Thread.h>
 #include <IO/StandardFile.h>
 #include <IO/FixedMemoryFile.h>
 
+#ifdef __APPLE__
+#define pread64 pread
+#endif
+
 namespace IO {
 
 namespace {
@@ -186,8 +198,177 @@ ZipArchiveStreamingFile::~ZipArchiveStreamingFile(void)
 	delete stream;
 	}
 
+/************************************************************************
+Class to read stored ZIP archive entries directly from a memory-mapped
+range of the archive file:
+************************************************************************/
+
+class ZipArchiveMappedFile:public SeekableFile
+	{
+	/* Elements: */
+	private:
+	void* mapBase; // Base address of the memory-mapped range of the archive file
+	size_t mapSize; // Size of the memory-mapped range, including the leading partial page
+	size_t dataSize; // Size of the entry's data
+	
+	/* Constructors and destructors: */
+	public:
+	ZipArchiveMappedFile(int archiveFd,SeekableFile::Offset dataPos,size_t sDataSize); // Maps the given range of the given archive file
+	virtual ~ZipArchiveMappedFile(void);
+	
+	/* Methods from File: */
+	virtual size_t resizeReadBuffer(size_t newReadBufferSize);
+	virtual void resizeWriteBuffer(size_t newWriteBufferSize);
+	
+	/* Methods from SeekableFile: */
+	virtual Offset getSize(void) const;
+	};
+
+/*************************************
+Methods of class ZipArchiveMappedFile:
+*************************************/
+
+ZipArchiveMappedFile::ZipArchiveMappedFile(int archiveFd,SeekableFile::Offset dataPos,size_t sDataSize)
+	:SeekableFile(ReadOnly),
+	 mapBase(0),mapSize(0),dataSize(sDataSize)
+	{
+	/* Memory-map the page-aligned range of the archive file containing the entry's data: */
+	Offset pageSize=Offset(sysconf(_SC_PAGESIZE));
+	Offset mapPos=dataPos-dataPos%pageSize;
+	size_t dataOffset=size_t(dataPos-mapPos);
+	mapSize=dataOffset+dataSize;
+	mapBase=mmap(0,mapSize,PROT_READ,MAP_SHARED,archiveFd,mapPos);
+	if(mapBase==MAP_FAILED)
+		throw OpenError(Misc::printStdErrMsg("IO::ZipArchive: Unable to memory-map archive entry due to error %d",errno));
+	
+	/* Re-allocate the buffered file's read buffer to point directly into the mapped range: */
+	setReadBuffer(dataSize,static_cast<Byte*>(mapBase)+dataOffset,false);
+	canReadThrough=false;
+	
+	/* Pretend putting the entry's data into the read buffer: */
+	appendReadBufferData(dataSize);
+	readPos=dataSize;
+	}
+
+ZipArchiveMappedFile::~ZipArchiveMappedFile(void)
+	{
+	/* Release the buffered file's read buffer: */
+	setReadBuffer(0,0,false);
+	
+	/* Unmap the archive range: */
+	munmap(mapBase,mapSize);
+	}
+
+size_t ZipArchiveMappedFile::resizeReadBuffer(size_t newReadBufferSize)
+	{
+	/* Ignore it and return the full data size: */
+	return dataSize;
+	}
+
+void ZipArchiveMappedFile::resizeWriteBuffer(size_t newWriteBufferSize)
+	{
+	/* Ignore it */
+	}
+
+SeekableFile::Offset ZipArchiveMappedFile::getSize(void) const
+	{
+	return dataSize;
+	}
+
+/****************
+Helper functions:
+****************/
+
+const char indexCacheHeader[16]="ZipArchiveIdx01"; // Identifier and version of ZIP archive index cache files
+
+inline unsigned int getUInt16(const unsigned char* data) // Extracts a little-endian 16-bit unsigned integer
+	{
+	return (unsigned int)(data[0])|((unsigned int)(data[1])<<8);
+	}
+
+inline unsigned int getUInt32(const unsigned char* data) // Extracts a little-endian 32-bit unsigned integer
+	{
+	return (unsigned int)(data[0])|((unsigned int)(data[1])<<8)|((unsigned int)(data[2])<<16)|((unsigned int)(data[3])<<24);
+	}
+
 }
 
+/**************************************************************
+Class to extract multiple files from a ZIP archive concurrently:
+**************************************************************/
+
+class ZipArchiveExtractor
+	{
+	/* Elements: */
+	private:
+	ZipArchive& archive; // The ZIP archive from which to extract files
+	const std::vector<ZipArchive::FileID>& fileIds; // List of files to extract
+	std::vector<SeekableFilePtr>& files; // List of extracted files
+	Threads::Atomic<unsigned int> nextFileIndex; // Index of the next file to be extracted by any thread
+	Threads::Mutex errorMutex; // Mutex protecting the error state
+	bool failed; // Flag if extracting any file failed
+	std::string errorMessage; // Error message of the first failed extraction
+	
+	/* Constructors and destructors: */
+	public:
+	ZipArchiveExtractor(ZipArchive& sArchive,const std::vector<ZipArchive::FileID>& sFileIds,std::vector<SeekableFilePtr>& sFiles)
+		:archive(sArchive),fileIds(sFileIds),files(sFiles),
+		 nextFileIndex(0),
+		 failed(false)
+		{
+		}
+	
+	/* Methods: */
+	void* extractorThreadMethod(void); // Extracts files until all files are extracted or an error occurred
+	bool hasFailed(void) const // Returns true if extracting any file failed
+		{
+		return failed;
+		}
+	const std::string& getErrorMessage(void) const // Returns the message of the first extraction error
+		{
+		return errorMessage;
+		}
+	};
+
+/************************************
+Methods of class ZipArchiveExtractor:
+************************************/
+
+void* ZipArchiveExtractor::extractorThreadMethod(void)
+	{
+	unsigned int numFiles=fileIds.size();
+	while(true)
+		{
+		/* Grab the next file to extract: */
+		unsigned int fileIndex=nextFileIndex.postAdd(1);
+		if(fileIndex>=numFiles)
+			break;
+		
+		try
+			{
+			/* Extract the file into its slot; slots are never shared between threads: */
+			files[fileIndex]=archive.extractFile(fileIds[fileIndex]);
+			}
+		catch(std::runtime_error err)
+			{
+			/* Remember the first error: */
+			{
+			Threads::Mutex::Lock errorLock(errorMutex);
+			if(!failed)
+				{
+				failed=true;
+				errorMessage=err.what();
+				}
+			}
+			
+			/* Skip all remaining files: */
+			nextFileIndex.postAdd(numFiles);
+			}
+		}
+	
+	return 0;
+	}
+
 /**************************************************************************************
 Class to represent directories inside a ZIP archive using an IO::Directory abstraction:
 **************************************************************************************/
@@ -420,6 +601,10 @@ ZipArchive::Directory::~Directory(void)
 
 bool ZipArchive::Directory::addPath(const char* path,const ZipArchive::FileID& fileId)
 	{
+	/* An empty path refers to this directory itself, which already exists: */
+	if(*path=='\0')
+		return true;
+	
 	/* Find the end of the first path component: */
 	const char* nameEnd;
 	for(nameEnd=path;*nameEnd!='\0'&&*nameEnd!='/';++nameEnd)
@@ -455,7 +640,11 @@ bool ZipArchive::Directory::addPath(const char* path,const ZipArchive::FileID& f
 		
 		entries.push_back(newEntry);
 		
-		return true;
+		/* Add the rest of the path to a new subdirectory: */
+		if(path[nameLen]=='/')
+			return newEntry.child->addPath(path+nameLen+1,fileId);
+		else
+			return true;
 		}
 	else if(path[nameLen]=='/'&&eIt->filePos==~Offset(0))
 		{
@@ -481,6 +670,69 @@ void ZipArchive::Directory::finalize(void)
 			}
 	}
 
+void ZipArchive::Directory::writeIndex(File& indexFile) const
+	{
+	/* Write all directory entries in their finalized order: */
+	indexFile.write<Misc::UInt32>(Misc::UInt32(entries.size()));
+	for(std::vector<Entry>::const_iterator eIt=entries.begin();eIt!=entries.end();++eIt)
+		{
+		/* Write the entry's name and file position: */
+		size_t nameLen=strlen(eIt->name);
+		indexFile.write<Misc::UInt16>(Misc::UInt16(nameLen));
+		indexFile.write<char>(eIt->name,nameLen);
+		indexFile.write<Misc::UInt64>(Misc::UInt64(eIt->filePos));
+		
+		/* Check if the entry is a subdirectory: */
+		if(eIt->filePos==~Offset(0))
+			{
+			/* Write the subdirectory recursively: */
+			eIt->child->writeIndex(indexFile);
+			}
+		else
+			{
+			/* Write the file's sizes: */
+			indexFile.write<Misc::UInt64>(Misc::UInt64(eIt->sizes.compressed));
+			indexFile.write<Misc::UInt64>(Misc::UInt64(eIt->sizes.uncompressed));
+			}
+		}
+	}
+
+void ZipArchive::Directory::readIndex(File& indexFile)
+	{
+	/* Read all directory entries: */
+	unsigned int numEntries=indexFile.read<Misc::UInt32>();
+	for(unsigned int i=0;i<numEntries;++i)
+		{
+		/* Add an empty file entry first so that the destructor cleans up if reading fails: */
+		entries.push_back(Entry());
+		Entry& entry=entries.back();
+		
+		/* Read the entry's name and file position: */
+		size_t nameLen=indexFile.read<Misc::UInt16>();
+		entry.name=new char[nameLen+1];
+		indexFile.read<char>(entry.name,nameLen);
+		entry.name[nameLen]='\0';
+		Offset filePos=Offset(indexFile.read<Misc::UInt64>());
+		
+		/* Check if the entry is a subdirectory: */
+		if(filePos==~Offset(0))
+			{
+			/* Read the subdirectory recursively: */
+			entry.filePos=filePos;
+			entry.child=new Directory(this);
+			entry.child->parentIndex=i;
+			entry.child->readIndex(indexFile);
+			}
+		else
+			{
+			/* Read the file's sizes: */
+			entry.sizes.compressed=size_t(indexFile.read<Misc::UInt64>());
+			entry.sizes.uncompressed=size_t(indexFile.read<Misc::UInt64>());
+			entry.filePos=filePos;
+			}
+		}
+	}
+
 void ZipArchive::Directory::getPath(std::string& path,size_t suffixLen) const
 	{
 	if(parent==0)
@@ -557,27 +809,23 @@ std::pair<ZipArchive::Directory*,unsigned int> ZipArchive::Directory::findPath(c
 			/* Find the current prefix in the current directory's entries via binary search with the invariant l->name<=prefix<r->name: */
 			std::vector<Directory::Entry>::const_iterator l=currentDir->entries.begin();
 			std::vector<Directory::Entry>::const_iterator r=currentDir->entries.end();
-			bool found=false;
-			if(r-l==1)
-				found=strncmp(l->name,prefixStart,prefixLen)==0&&l->name[prefixLen]=='\0';
-			else
+			if(l==r)
+				return std::pair<Directory*,unsigned int>(0,0);
+			while(r-l>1)
 				{
-				do
-					{
-					/* Compare the middle element to the current prefix: */
-					std::vector<Directory::Entry>::const_iterator m=l+(r-l)/2;
-					int comp=strncmp(m->name,prefixStart,prefixLen);
-					if(comp==0&&m->name[prefixLen]!='\0')
-						comp=1;
-					found=comp==0;
-					if(comp<=0)
-						l=m;
-					else
-						r=m;
-					}
-				while(r-l>1);
+				/* Compare the middle element to the current prefix: */
+				std::vector<Directory::Entry>::const_iterator m=l+(r-l)/2;
+				int comp=strncmp(m->name,prefixStart,prefixLen);
+				if(comp==0&&m->name[prefixLen]!='\0')
+					comp=1;
+				if(comp<=0)
+					l=m;
+				else
+					r=m;
 				}
-			if(!found)
+			
+			/* Check if the remaining candidate matches the current prefix: */
+			if(strncmp(l->name,prefixStart,prefixLen)!=0||l->name[prefixLen]!='\0')
 				return std::pair<Directory*,unsigned int>(0,0);
 			
 			/* Check if the path is completely processed: */
@@ -760,7 +1008,7 @@ ZipArchive::FileNotFoundError::~FileNotFoundError(void) throw()
 Methods of class ZipArchive:
 ***************************/
 
-int ZipArchive::initArchive(void)
+int ZipArchive::locateCentralDirectory(void)
 	{
 	/* Set the archive file's endianness: */
 	archive->setEndianness(Misc::LittleEndian);
@@ -771,7 +1019,7 @@ int ZipArchive::initArchive(void)
 		return -1;
 	
 	/* Read backwards from end of file until end-of-directory signature is found: */
-	Offset archiveSize=archive->getSize();
+	archiveSize=archive->getSize();
 	Offset readPos=archiveSize;
 	Offset firstReadPos=readPos>Offset(70000)?readPos-Offset(70000):Offset(0); // If no signature is found after this pos, there is none
 	unsigned char readBuffer[256];
@@ -845,13 +1093,19 @@ int ZipArchive::initArchive(void)
 	unsigned short eocdCommentLength=archive->read<Misc::UInt16>();
 	
 	/* Remember the directory offset and size: */
-	Offset directoryPos=Offset(eocdCDOffset);
-	size_t directorySize=size_t(eocdCDSize);
+	directoryPos=Offset(eocdCDOffset);
+	directorySize=size_t(eocdCDSize);
 	
 	/* Check again if this was really the end-of-directory marker: */
 	if(directoryPos+Offset(directorySize)!=endOfCentralDirPos||endOfCentralDirPos+Offset(sizeof(Misc::UInt32)*3+sizeof(Misc::UInt16)*5+eocdCommentLength)!=archiveSize)
 		return -3;
 	
+	/* Signal success: */
+	return 0;
+	}
+
+int ZipArchive::readCentralDirectory(void)
+	{
 	/*************************************************
 	Read the ZIP archive's entire directory hierarchy:
 	*************************************************/
@@ -922,12 +1176,263 @@ int ZipArchive::initArchive(void)
 	return 0;
 	}
 
+int ZipArchive::initArchive(const char* indexCacheFileName)
+	{
+	/* Check if the archive is a regular file accessible through a file descriptor: */
+	try
+		{
+		int fd=archive->getFd();
+		struct stat archiveStat;
+		if(fstat(fd,&archiveStat)==0&&S_ISREG(archiveStat.st_mode))
+			{
+			archiveFd=fd;
+			archiveModTime=archiveStat.st_mtime;
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		/* Access the archive through its file object only */
+		}
+	
+	/* Find the central directory: */
+	int result=locateCentralDirectory();
+	if(result!=0)
+		return result;
+	
+	/* Try reading the directory tree from the index cache first: */
+	if(indexCacheFileName!=0&&readIndexCache(indexCacheFileName))
+		return 0;
+	
+	/* Read the directory tree from the central directory and update the index cache: */
+	result=readCentralDirectory();
+	if(result==0&&indexCacheFileName!=0)
+		writeIndexCache(indexCacheFileName);
+	
+	return result;
+	}
+
+bool ZipArchive::readIndexCache(const char* indexCacheFileName)
+	{
+	try
+		{
+		/* Open the index cache file: */
+		SeekableFilePtr indexFile(new StandardFile(indexCacheFileName,File::ReadOnly));
+		indexFile->setEndianness(Misc::LittleEndian);
+		
+		/* Check the cache file's header: */
+		char header[sizeof(indexCacheHeader)];
+		indexFile->read<char>(header,sizeof(header));
+		if(memcmp(header,indexCacheHeader,sizeof(header))!=0)
+			return false;
+		
+		/* Check that the cache file was created from the same archive: */
+		if(indexFile->read<Misc::UInt64>()!=Misc::UInt64(archiveSize)||indexFile->read<Misc::SInt64>()!=Misc::SInt64(archiveModTime))
+			return false;
+		if(indexFile->read<Misc::UInt64>()!=Misc::UInt64(directoryPos)||indexFile->read<Misc::UInt64>()!=Misc::UInt64(directorySize))
+			return false;
+		
+		/* Read the directory tree into a temporary root directory: */
+		Directory newRoot(0);
+		newRoot.readIndex(*indexFile);
+		
+		/* Move the temporary root directory's entries into the real root directory: */
+		root.entries.swap(newRoot.entries);
+		for(std::vector<Directory::Entry>::iterator eIt=root.entries.begin();eIt!=root.entries.end();++eIt)
+			if(eIt->filePos==~Offset(0))
+				eIt->child->parent=&root;
+		
+		return true;
+		}
+	catch(std::runtime_error err)
+		{
+		/* Treat the index cache as invalid: */
+		return false;
+		}
+	}
+
+void ZipArchive::writeIndexCache(const char* indexCacheFileName) const
+	{
+	/* Write the index into a temporary file first so that concurrent readers never see a partial index: */
+	char tempSuffix[32];
+	snprintf(tempSuffix,sizeof(tempSuffix),".%d.tmp",int(getpid()));
+	std::string tempFileName(indexCacheFileName);
+	tempFileName.append(tempSuffix);
+	try
+		{
+		{
+		SeekableFilePtr indexFile(new StandardFile(tempFileName.c_str(),File::WriteOnly));
+		indexFile->setEndianness(Misc::LittleEndian);
+		
+		/* Write the cache file's header: */
+		indexFile->write<char>(indexCacheHeader,sizeof(indexCacheHeader));
+		
+		/* Write the archive's identification: */
+		indexFile->write<Misc::UInt64>(Misc::UInt64(archiveSize));
+		indexFile->write<Misc::SInt64>(Misc::SInt64(archiveModTime));
+		indexFile->write<Misc::UInt64>(Misc::UInt64(directoryPos));
+		indexFile->write<Misc::UInt64>(Misc::UInt64(directorySize));
+		
+		/* Write the directory tree: */
+		root.writeIndex(*indexFile);
+		
+		/* Flush the file here so that write errors are caught below instead of in the file's destructor: */
+		indexFile->flush();
+		}
+		
+		/* Replace the index cache file atomically: */
+		if(rename(tempFileName.c_str(),indexCacheFileName)!=0)
+			unlink(tempFileName.c_str());
+		}
+	catch(std::runtime_error err)
+		{
+		/* The index cache is optional; remove the partial file and carry on: */
+		unlink(tempFileName.c_str());
+		}
+	}
+
+void ZipArchive::readArchive(ZipArchive::Offset pos,void* buffer,size_t size)
+	{
+	if(archiveFd>=0)
+		{
+		/* Read directly from the archive file without touching the shared file position: */
+		char* bufferPtr=static_cast<char*>(buffer);
+		while(size>0)
+			{
+			ssize_t readResult=pread64(archiveFd,bufferPtr,size,pos);
+			if(readResult>0)
+				{
+				bufferPtr+=readResult;
+				pos+=Offset(readResult);
+				size-=size_t(readResult);
+				}
+			else if(readResult==0)
+				throw File::ReadError(size);
+			else if(errno!=EINTR)
+				Misc::throwStdErr("IO::ZipArchive: Error %d while reading from archive",errno);
+			}
+		}
+	else
+		{
+		/* Read through the archive's file object: */
+		Threads::Mutex::Lock archiveLock(archiveMutex);
+		archive->setReadPosAbs(pos);
+		archive->read<char>(static_cast<char*>(buffer),size);
+		}
+	}
+
+void ZipArchive::readLocalFileHeader(const ZipArchive::FileID& fileId,ZipArchive::LocalFileHeader& header)
+	{
+	/* Read the fixed-size part of the file's local header: */
+	unsigned char headerBuffer[30];
+	readArchive(fileId.filePos,headerBuffer,sizeof(headerBuffer));
+	if(getUInt32(headerBuffer)!=0x04034b50U)
+		Misc::throwStdErr("IO::ZipArchive: Invalid file header signature");
+	
+	/* Extract the compression method and skip the file name and extra field: */
+	header.compressionMethod=getUInt16(headerBuffer+8);
+	header.dataPos=fileId.filePos+Offset(sizeof(headerBuffer)+getUInt16(headerBuffer+26)+getUInt16(headerBuffer+28));
+	
+	/* Take the file's sizes from the central directory, as the local header might defer them to a trailing data descriptor: */
+	header.compressedSize=fileId.compressedSize;
+	header.uncompressedSize=fileId.uncompressedSize;
+	}
+
+SeekableFile* ZipArchive::extractFile(const ZipArchive::FileID& fileId)
+	{
+	/* Read the file's header: */
+	LocalFileHeader header;
+	readLocalFileHeader(fileId,header);
+	
+	if(header.compressionMethod==0)
+		{
+		/* Map stored files directly from the archive file if possible: */
+		if(archiveFd>=0&&header.compressedSize>0)
+			return new ZipArchiveMappedFile(archiveFd,header.dataPos,header.compressedSize);
+		
+		/* Directly read the uncompressed data: */
+		FixedMemoryFile* result=new FixedMemoryFile(header.compressedSize);
+		try
+			{
+			readArchive(header.dataPos,result->getMemory(),header.compressedSize);
+			}
+		catch(...)
+			{
+			delete result;
+			throw;
+			}
+		
+		return result;
+		}
+	
+	/* Read the compressed data: */
+	Bytef* compressed=new Bytef[header.compressedSize];
+	try
+		{
+		readArchive(header.dataPos,compressed,header.compressedSize);
+		}
+	catch(...)
+		{
+		delete[] compressed;
+		throw;
+		}
+	
+	/* Uncompress the data: */
+	FixedMemoryFile* result=new FixedMemoryFile(header.uncompressedSize);
+	z_stream stream;
+	memset(&stream,0,sizeof(z_stream));
+	stream.zalloc=0;
+	stream.zfree=0;
+	stream.opaque=0;
+	if(inflateInit2(&stream,-MAX_WBITS)!=Z_OK)
+		{
+		delete[] compressed;
+		delete result;
+		Misc::throwStdErr("IO::ZipArchive: Internal zlib error");
+		}
+	stream.next_in=compressed;
+	stream.avail_in=header.compressedSize;
+	stream.next_out=static_cast<Bytef*>(result->getMemory());
+	stream.avail_out=header.uncompressedSize;
+	int inflateResult=inflate(&stream,Z_FINISH);
+	delete[] compressed;
+	if(inflateEnd(&stream)!=Z_OK||inflateResult!=Z_STREAM_END)
+		{
+		delete result;
+		Misc::throwStdErr("IO::ZipArchive: Internal zlib error");
+		}
+	
+	return result;
+	}
+
 ZipArchive::ZipArchive(const char* archiveFileName)
 	:archive(new StandardFile(archiveFileName,File::ReadOnly)),
+	 archiveFd(-1),archiveSize(0),archiveModTime(0),directoryPos(0),directorySize(0),
+	 root(0)
+	{
+	/* Initialize the archive and handle errors: */
+	switch(initArchive(0))
+		{
+		case -1:
+			Misc::throwStdErr("IO::ZipArchive: %s is not a valid ZIP archive",archiveFileName);
+			break;
+		
+		case -2:
+			Misc::throwStdErr("IO::ZipArchive: Unable to locate central directory in ZIP archive %s",archiveFileName);
+			break;
+		
+		case -3:
+			Misc::throwStdErr("IO::ZipArchive: Invalid central directory in ZIP archive %s",archiveFileName);
+			break;
+		}
+	}
+
+ZipArchive::ZipArchive(const char* archiveFileName,const char* indexCacheFileName)
+	:archive(new StandardFile(archiveFileName,File::ReadOnly)),
+	 archiveFd(-1),archiveSize(0),archiveModTime(0),directoryPos(0),directorySize(0),
 	 root(0)
 	{
 	/* Initialize the archive and handle errors: */
-	switch(initArchive())
+	switch(initArchive(indexCacheFileName))
 		{
 		case -1:
 			Misc::throwStdErr("IO::ZipArchive: %s is not a valid ZIP archive",archiveFileName);
@@ -945,10 +1450,33 @@ ZipArchive::ZipArchive(const char* archiveFileName)
 
 ZipArchive::ZipArchive(SeekableFilePtr sArchive)
 	:archive(sArchive),
+	 archiveFd(-1),archiveSize(0),archiveModTime(0),directoryPos(0),directorySize(0),
 	 root(0)
 	{
 	/* Initialize the archive and handle errors: */
-	switch(initArchive())
+	switch(initArchive(0))
+		{
+		case -1:
+			Misc::throwStdErr("IO::ZipArchive: Source file is not a valid ZIP archive");
+			break;
+		
+		case -2:
+			Misc::throwStdErr("IO::ZipArchive: Unable to locate central directory in ZIP archive");
+			break;
+		
+		case -3:
+			Misc::throwStdErr("IO::ZipArchive: Invalid central directory in ZIP archive");
+			break;
+		}
+	}
+
+ZipArchive::ZipArchive(SeekableFilePtr sArchive,const char* indexCacheFileName)
+	:archive(sArchive),
+	 archiveFd(-1),archiveSize(0),archiveModTime(0),directoryPos(0),directorySize(0),
+	 root(0)
+	{
+	/* Initialize the archive and handle errors: */
+	switch(initArchive(indexCacheFileName))
 		{
 		case -1:
 			Misc::throwStdErr("IO::ZipArchive: Source file is not a valid ZIP archive");
@@ -990,92 +1518,55 @@ ZipArchive::FileID ZipArchive::findFile(const char* fileName) const
 FilePtr ZipArchive::openFile(const ZipArchive::FileID& fileId)
 	{
 	/* Read the file's header: */
-	archive->setReadPosAbs(fileId.filePos);
-	if(archive->read<Misc::UInt32>()!=0x04034b50U)
-		Misc::throwStdErr("IO::ZipArchive::openFile: Invalid file header signature");
-	
-	/* Read file header information: */
-	archive->skip<Misc::UInt16>(2);
-	unsigned short compressionMethod=archive->read<Misc::UInt16>();
-	archive->skip<Misc::UInt16>(2);
-	archive->skip<Misc::UInt32>(1);
-	unsigned int compressedSize=archive->read<Misc::UInt32>();
-	archive->skip<Misc::UInt32>(1);
-	unsigned short fileNameLength=archive->read<Misc::UInt16>();
-	unsigned short extraFieldLength=archive->read<Misc::UInt16>();
-	
-	/* Skip file name and extra field: */
-	archive->skip<char>(fileNameLength);
-	archive->skip<char>(extraFieldLength);
+	LocalFileHeader header;
+	readLocalFileHeader(fileId,header);
 	
 	/* Create and return the result file: */
-	return new ZipArchiveStreamingFile(archive,compressionMethod,archive->getReadPos(),compressedSize);
+	return new ZipArchiveStreamingFile(archive,header.compressionMethod,header.dataPos,header.compressedSize);
 	}
 
 SeekableFilePtr ZipArchive::openSeekableFile(const ZipArchive::FileID& fileId)
 	{
-	/* Read the file's header: */
-	archive->setReadPosAbs(fileId.filePos);
-	if(archive->read<Misc::UInt32>()!=0x04034b50U)
-		Misc::throwStdErr("IO::ZipArchive::openSeekableFile: Invalid file header signature");
-	
-	/* Read file header information: */
-	archive->skip<Misc::UInt16>(2);
-	unsigned short compressionMethod=archive->read<Misc::UInt16>();
-	archive->skip<Misc::UInt16>(2);
-	archive->skip<Misc::UInt32>(1);
-	unsigned int compressedSize=archive->read<Misc::UInt32>();
-	unsigned int uncompressedSize=archive->read<Misc::UInt32>();
-	unsigned short fileNameLength=archive->read<Misc::UInt16>();
-	unsigned short extraFieldLength=archive->read<Misc::UInt16>();
-	
-	/* Skip file name and extra field: */
-	archive->skip<char>(fileNameLength);
-	archive->skip<char>(extraFieldLength);
-	
-	/* Create the result file: */
-	FixedMemoryFile* result=new FixedMemoryFile(uncompressedSize);
-	if(compressionMethod==0)
+	/* Extract the file: */
+	return extractFile(fileId);
+	}
+
+void ZipArchive::extractFiles(const std::vector<ZipArchive::FileID>& fileIds,std::vector<SeekableFilePtr>& files,unsigned int numThreads)
+	{
+	/* Prepare the result list: */
+	files.clear();
+	files.resize(fileIds.size());
+	
+	/* Determine the number of extraction threads: */
+	if(numThreads==0)
 		{
-		/* Directly read the uncompressed data: */
-		archive->read<char>(static_cast<char*>(result->getMemory()),compressedSize);
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		numThreads=numCpus>0?(unsigned int)(numCpus):1U;
 		}
-	else
+	if(numThreads>fileIds.size())
+		numThreads=fileIds.size();
+	
+	/* Extract the files using the calling thread and additional worker threads: */
+	ZipArchiveExtractor extractor(*this,fileIds,files);
+	if(numThreads>1)
 		{
-		/* Read the compressed data: */
-		Bytef* compressed=new Bytef[compressedSize];
-		archive->read<Bytef>(compressed,compressedSize);
+		Threads::Thread* workers=new Threads::Thread[numThreads-1];
+		for(unsigned int i=0;i<numThreads-1;++i)
+			workers[i].start(&extractor,&ZipArchiveExtractor::extractorThreadMethod);
+		extractor.extractorThreadMethod();
 		
-		/* Uncompress the data: */
-		z_stream stream;
-		stream.zalloc=0;
-		stream.zfree=0;
-		stream.opaque=0;
-		if(inflateInit2(&stream,-MAX_WBITS)!=Z_OK)
-			{
-			delete[] compressed;
-			delete result;
-			Misc::throwStdErr("IO::ZipArchive::openSeekableFile: Internal zlib error");
-			}
-		stream.next_in=compressed;
-		stream.avail_in=compressedSize;
-		stream.next_out=static_cast<Bytef*>(result->getMemory());
-		stream.avail_out=uncompressedSize;
-		if(inflate(&stream,Z_FINISH)!=Z_STREAM_END)
-			{
-			delete[] compressed;
-			delete result;
-			Misc::throwStdErr("IO::ZipArchive::openSeekableFile: Internal zlib error");
-			}
-		delete[] compressed;
-		if(inflateEnd(&stream)!=Z_OK)
-			{
-			delete result;
-			Misc::throwStdErr("IO::ZipArchive::openSeekableFile: Internal zlib error");
-			}
+		/* Wait for all worker threads to finish: */
+		delete[] workers;
 		}
+	else
+		extractor.extractorThreadMethod();
 	
-	return result;
+	/* Check for errors: */
+	if(extractor.hasFailed())
+		{
+		files.clear();
+		Misc::throwStdErr("IO::ZipArchive::extractFiles: %s",extractor.getErrorMessage().c_str());
+		}
 	}
 
 DirectoryPtr ZipArchive::openRootDirectory(void)
@@ -25,10 +25,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define IO_ZIPARCHIVE_INCLUDED
 
 #include <string.h>
+#include <time.h>
 #include <utility>
 #include <vector>
 #include <stdexcept>
 #include <Misc/RefCounted.h>
+#include <Threads/Mutex.h>
 #include <IO/File.h>
 #include <IO/SeekableFile.h>
 #include <IO/Directory.h>
@@ -36,6 +38,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 /* Forward declarations: */
 namespace IO {
 class ZipArchiveDirectory;
+class ZipArchiveExtractor;
 }
 
 namespace IO {
@@ -101,6 +104,8 @@ class ZipArchive:public Misc::RefCounted
 		/* Methods: */
 		bool addPath(const char* path,const FileID& fileId); // Adds the file or directory of the given directory-relative path to this directory; returns true if path was added successfully
 		void finalize(void); // Finalizes this directory and all its subdirectories by sorting entries by name and fixing subdirectory back-pointers
+		void writeIndex(File& indexFile) const; // Writes this finalized directory and all its subdirectories to an index cache file
+		void readIndex(File& indexFile); // Reads this directory and all its subdirectories from an index cache file; entries are already finalized
 		void getPath(std::string& path,size_t suffixLen) const; // Returns the absolute path name of this directory terminated with a '/'; reserves enough space to append a suffix of the given length
 		std::pair<Directory*,unsigned int> findPath(const char* path); // Returns a pointer to a directory and an index into that directory's entry array corresponding to the given relative path; returns (0, 0) if path does not exist
 		};
@@ -190,25 +195,52 @@ class ZipArchive:public Misc::RefCounted
 	
 	friend class DirectoryIterator;
 	friend class ZipArchiveDirectory;
+	friend class ZipArchiveExtractor;
 	
-	/* Elements: */
 	private:
+	struct LocalFileHeader // Structure describing a file's data as stored in the archive
+		{
+		/* Elements: */
+		public:
+		unsigned int compressionMethod; // Compression method; 0 for stored files
+		Offset dataPos; // Position of the file's (compressed) data inside the archive
+		size_t compressedSize; // Size of the file's data inside the archive
+		size_t uncompressedSize; // Size of the file's uncompressed data
+		};
+	
+	/* Elements: */
 	SeekableFilePtr archive; // File object to access the ZIP archive
+	int archiveFd; // File descriptor of the ZIP archive file for positional reads and memory mapping, or -1 if the archive is not backed by a file descriptor
+	Threads::Mutex archiveMutex; // Mutex serializing positional reads from the archive file object if there is no file descriptor
+	Offset archiveSize; // Total size of the ZIP archive
+	time_t archiveModTime; // Modification time of the ZIP archive file, or 0 if unknown
+	Offset directoryPos; // Position of the central directory inside the ZIP archive
+	size_t directorySize; // Size of the central directory
 	Directory root; // The ZIP archive's root directory
 	
 	/* Private methods: */
-	int initArchive(void); // Initializes the ZIP archive file structures; returns error code
+	int locateCentralDirectory(void); // Finds the ZIP archive's central directory; returns error code
+	int readCentralDirectory(void); // Reads the ZIP archive's central directory into the directory tree; returns error code
+	int initArchive(const char* indexCacheFileName); // Initializes the ZIP archive file structures, using and updating the given index cache file if not null; returns error code
+	bool readIndexCache(const char* indexCacheFileName); // Reads the directory tree from the given index cache file; returns false if the cache file does not exist or does not match the archive
+	void writeIndexCache(const char* indexCacheFileName) const; // Writes the directory tree to the given index cache file; silently ignores errors
+	void readArchive(Offset pos,void* buffer,size_t size); // Reads a block of data from the given archive position; can be called from multiple threads
+	void readLocalFileHeader(const FileID& fileId,LocalFileHeader& header); // Reads the local file header of the given file; can be called from multiple threads
+	SeekableFile* extractFile(const FileID& fileId); // Extracts the given file into a seekable file; can be called from multiple threads
 	
 	/* Constructors and destructors: */
 	public:
 	ZipArchive(const char* archiveFileName); // Opens a ZIP archive of the given file name using a standard file abstraction
+	ZipArchive(const char* archiveFileName,const char* indexCacheFileName); // Ditto; reads the directory tree from the given index cache file if it is valid, and creates or updates the cache file otherwise
 	ZipArchive(SeekableFilePtr sArchive); // Reads a ZIP archive from an already-opened file
+	ZipArchive(SeekableFilePtr sArchive,const char* indexCacheFileName); // Ditto, using the given index cache file
 	~ZipArchive(void); // Closes the ZIP archive
 	
 	/* Methods: */
 	FileID findFile(const char* fileName) const; // Returns a file identifier for a file of the given name; throws exception if file does not exist
 	FilePtr openFile(const FileID& fileId); // Returns a file for streaming reading
-	SeekableFilePtr openSeekableFile(const FileID& fileId); // Returns a file for seekable reading
+	SeekableFilePtr openSeekableFile(const FileID& fileId); // Returns a file for seekable reading; stored files are memory-mapped directly from the archive if possible
+	void extractFiles(const std::vector<FileID>& fileIds,std::vector<SeekableFilePtr>& files,unsigned int numThreads =0); // Extracts the given files for seekable reading using the given number of concurrent threads (0: one per CPU); stores extracted files in the same order as the given file IDs
 	DirectoryPtr openRootDirectory(void); // Returns a directory object representing the root directory
 	DirectoryPtr openDirectory(const char* directoryName); // Returns a directory object representing the given directory name
 	};
@@ -143,6 +143,36 @@ class Histogram
 		{
 		return Scalar(valueSum/double(numSamples));
 		}
+	Scalar getMinValue(void) const // Returns the smallest sample in the histogram
+		{
+		return minValue;
+		}
+	Scalar getMaxValue(void) const // Returns the largest sample in the histogram
+		{
+		return maxValue;
+		}
+	Scalar getPercentile(double fraction) const // Returns an upper bound for the value below which the given fraction of samples fall, with bin size resolution
+		{
+		if(numSamples==0)
+			return Scalar(0);
+		
+		/* Find the first bin at which the cumulative sample count reaches the given fraction: */
+		double threshold=fraction*double(numSamples);
+		size_t cumulativeSize=0;
+		size_t lastBinIndex=getLastBinIndex();
+		for(size_t binIndex=getFirstBinIndex();binIndex<lastBinIndex;++binIndex)
+			{
+			cumulativeSize+=bins[binIndex];
+			if(double(cumulativeSize)>=threshold)
+				{
+				/* Return the bin's upper bound, clamped to the sample range: */
+				Scalar result=getBinMax(binIndex);
+				return result<maxValue?result:maxValue;
+				}
+			}
+		
+		return maxValue;
+		}
 	};
 
 }
@@ -0,0 +1,441 @@
+/***********************************************************************
+FlatHashTable - Class for storing and finding values (open addressing
+version using linear probing with Robin Hood insertion), with a subset
+of the interface of HashTable.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Miscellaneous Support Library (Misc).
+
+The Miscellaneous Support Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Miscellaneous Support Library is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Miscellaneous Support Library; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef MISC_FLATHASHTABLE_INCLUDED
+#define MISC_FLATHASHTABLE_INCLUDED
+
+#include <stddef.h>
+#include <new>
+#include <algorithm>
+#include <Misc/StandardHashFunction.h>
+#include <Misc/HashTable.h>
+
+namespace Misc {
+
+/***********************************************************************
+Usage prerequisites:
+- class Source must provide operator!=
+- class HashFunction must provide static size_t hash(const Source&
+  source,size_t tableSize)
+- classes Source and Dest must be copyable
+Unlike HashTable, entries are stored directly in the table. Any
+insertion or removal can move other entries, which invalidates all
+iterators and references to entries.
+***********************************************************************/
+
+template <class Source,class Dest,class HashFunction =StandardHashFunction<Source> >
+class FlatHashTable
+	{
+	/* Embedded classes: */
+	public:
+	typedef HashTableEntry<Source,Dest> Entry; // Type for hash table entries
+	typedef typename HashTable<Source,Dest,HashFunction>::EntryNotFoundError EntryNotFoundError; // Class for exceptions when requested hash table entry does not exist
+	
+	private:
+	struct Slot // Structure for table slots; slots are never constructed as a whole, and only the entries of used slots are constructed
+		{
+		/* Elements: */
+		public:
+		unsigned int probeLength; // Distance of the slot's entry from its home slot plus one, or zero if the slot is empty
+		Entry entry; // The slot's entry
+		};
+	
+	public:
+	class Iterator
+		{
+		friend class FlatHashTable;
+		
+		/* Elements: */
+		private:
+		FlatHashTable* table; // Pointer to table this iterator is pointing into
+		size_t slotIndex; // Index of current table slot
+		
+		/* Constructors and destructors: */
+		public:
+		Iterator(void) // Creates invalid iterator
+			:table(0),slotIndex(0)
+			{
+			}
+		private:
+		Iterator(FlatHashTable* sTable,size_t sSlotIndex) // Creates iterator to the first used slot at or after the given one
+			:table(sTable),slotIndex(sSlotIndex)
+			{
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0)
+				++slotIndex;
+			}
+		
+		/* Methods: */
+		public:
+		bool isFinished(void) const
+			{
+			return slotIndex>=table->tableSize;
+			}
+		friend bool operator==(const Iterator& it1,const Iterator& it2)
+			{
+			return it1.slotIndex==it2.slotIndex;
+			}
+		friend bool operator!=(const Iterator& it1,const Iterator& it2)
+			{
+			return it1.slotIndex!=it2.slotIndex;
+			}
+		Entry& operator*(void) const
+			{
+			return table->slots[slotIndex].entry;
+			}
+		Entry* operator->(void) const
+			{
+			return &table->slots[slotIndex].entry;
+			}
+		Iterator& operator++(void)
+			{
+			/* Go to next used slot: */
+			++slotIndex;
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0)
+				++slotIndex;
+			return *this;
+			}
+		};
+	
+	class ConstIterator
+		{
+		friend class FlatHashTable;
+		
+		/* Elements: */
+		private:
+		const FlatHashTable* table; // Pointer to table this iterator is pointing into
+		size_t slotIndex; // Index of current table slot
+		
+		/* Constructors and destructors: */
+		public:
+		ConstIterator(void) // Creates invalid iterator
+			:table(0),slotIndex(0)
+			{
+			}
+		private:
+		ConstIterator(const FlatHashTable* sTable,size_t sSlotIndex) // Creates iterator to the first used slot at or after the given one
+			:table(sTable),slotIndex(sSlotIndex)
+			{
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0)
+				++slotIndex;
+			}
+		
+		/* Methods: */
+		public:
+		bool isFinished(void) const
+			{
+			return slotIndex>=table->tableSize;
+			}
+		friend bool operator==(const ConstIterator& it1,const ConstIterator& it2)
+			{
+			return it1.slotIndex==it2.slotIndex;
+			}
+		friend bool operator!=(const ConstIterator& it1,const ConstIterator& it2)
+			{
+			return it1.slotIndex!=it2.slotIndex;
+			}
+		const Entry& operator*(void) const
+			{
+			return table->slots[slotIndex].entry;
+			}
+		const Entry* operator->(void) const
+			{
+			return &table->slots[slotIndex].entry;
+			}
+		ConstIterator& operator++(void)
+			{
+			/* Go to next used slot: */
+			++slotIndex;
+			while(slotIndex<table->tableSize&&table->slots[slotIndex].probeLength==0)
+				++slotIndex;
+			return *this;
+			}
+		};
+	
+	friend class Iterator;
+	friend class ConstIterator;
+	
+	/* Elements: */
+	private:
+	size_t tableSize; // Current table size
+	float waterMark; // Maximum table usage ratio
+	float growRate; // Rate the table grows at
+	Slot* slots; // Array of table slots
+	size_t usedEntries; // Number of entries currently used
+	size_t maxEntries; // Maximum number of entries at current table size
+	
+	/* Private methods: */
+	static Slot* allocateSlots(size_t numSlots) // Allocates the given number of empty slots
+		{
+		Slot* result=static_cast<Slot*>(::operator new(numSlots*sizeof(Slot)));
+		for(size_t i=0;i<numSlots;++i)
+			result[i].probeLength=0;
+		return result;
+		}
+	size_t calcMaxEntries(void) const // Returns the maximum number of entries at the current table size, leaving at least one empty slot
+		{
+		size_t result=(size_t)(tableSize*waterMark);
+		return result<tableSize?result:tableSize-1;
+		}
+	size_t findSlot(const Source& findSource) const // Returns the index of the slot containing the given source, or tableSize if the source is not found
+		{
+		size_t index=HashFunction::hash(findSource,tableSize);
+		for(unsigned int probeLength=1;slots[index].probeLength>=probeLength;++probeLength)
+			{
+			/* Check the slot if its entry has the same home slot: */
+			if(slots[index].probeLength==probeLength&&!(slots[index].entry.getSource()!=findSource))
+				return index;
+			
+			/* Go to the next slot: */
+			if(++index==tableSize)
+				index=0;
+			}
+		
+		/* The entry would have displaced an entry closer to its home slot: */
+		return tableSize;
+		}
+	size_t insertNewEntry(const Entry& newEntry) // Inserts an entry whose source is not in the table, without growing the table; returns the index of the entry's slot
+		{
+		size_t index=HashFunction::hash(newEntry.getSource(),tableSize);
+		unsigned int probeLength=1;
+		
+		/* Find the first empty slot, or the first slot whose entry is closer to its home slot: */
+		while(slots[index].probeLength>=probeLength)
+			{
+			++probeLength;
+			if(++index==tableSize)
+				index=0;
+			}
+		size_t result=index;
+		
+		/* Place the new entry and carry the displaced entries forward until an empty slot is found: */
+		Entry carried(newEntry);
+		while(slots[index].probeLength!=0)
+			{
+			if(slots[index].probeLength<probeLength)
+				{
+				std::swap(slots[index].entry,carried);
+				std::swap(slots[index].probeLength,probeLength);
+				}
+			++probeLength;
+			if(++index==tableSize)
+				index=0;
+			}
+		new(&slots[index].entry) Entry(carried);
+		slots[index].probeLength=probeLength;
+		++usedEntries;
+		
+		return result;
+		}
+	void removeSlot(size_t index) // Removes the entry in the given slot and shifts following entries back towards their home slots
+		{
+		/* Destroy the entry: */
+		slots[index].entry.~Entry();
+		slots[index].probeLength=0;
+		--usedEntries;
+		
+		/* Move following displaced entries back by one slot: */
+		size_t next=index+1;
+		if(next==tableSize)
+			next=0;
+		while(slots[next].probeLength>1)
+			{
+			new(&slots[index].entry) Entry(slots[next].entry);
+			slots[index].probeLength=slots[next].probeLength-1;
+			slots[next].entry.~Entry();
+			slots[next].probeLength=0;
+			index=next;
+			if(++next==tableSize)
+				next=0;
+			}
+		}
+	void growTable(size_t newTableSize) // Changes the table size without deleting current entries
+		{
+		/* Never shrink the table below the number of entries it holds: */
+		if(newTableSize<1)
+			newTableSize=1;
+		while((size_t)(newTableSize*waterMark)<usedEntries||newTableSize<=usedEntries)
+			newTableSize=(size_t)(newTableSize*growRate)+1;
+		
+		/* Allocate the new table: */
+		size_t oldTableSize=tableSize;
+		Slot* oldSlots=slots;
+		tableSize=newTableSize;
+		slots=allocateSlots(tableSize);
+		usedEntries=0;
+		maxEntries=calcMaxEntries();
+		
+		/* Move all entries to the new table: */
+		for(size_t i=0;i<oldTableSize;++i)
+			if(oldSlots[i].probeLength!=0)
+				{
+				insertNewEntry(oldSlots[i].entry);
+				oldSlots[i].entry.~Entry();
+				}
+		
+		/* Delete the old table: */
+		::operator delete(oldSlots);
+		}
+	size_t insertEntry(const Entry& newEntry) // Inserts an entry whose source is not in the table, growing the table if necessary; returns the index of the entry's slot
+		{
+		if(usedEntries>=maxEntries)
+			growTable((size_t)(tableSize*growRate)+1);
+		return insertNewEntry(newEntry);
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	FlatHashTable(size_t sTableSize,float sWaterMark =0.8f,float sGrowRate =1.7312543)
+		:tableSize(sTableSize>0?sTableSize:1),waterMark(sWaterMark),growRate(sGrowRate),
+		 slots(allocateSlots(tableSize)),
+		 usedEntries(0),maxEntries(calcMaxEntries())
+		{
+		}
+	private:
+	FlatHashTable(const FlatHashTable& source); // Prohibit copy constructor
+	FlatHashTable& operator=(const FlatHashTable& source); // Prohibit assignment operator
+	public:
+	~FlatHashTable(void)
+		{
+		/* Destroy all used table entries: */
+		for(size_t i=0;i<tableSize;++i)
+			if(slots[i].probeLength!=0)
+				slots[i].entry.~Entry();
+		
+		/* Delete the table: */
+		::operator delete(slots);
+		}
+	
+	/* Methods: */
+	void setTableSize(size_t newTableSize)
+		{
+		growTable(newTableSize);
+		}
+	void clear(void)
+		{
+		/* Destroy all used table entries: */
+		for(size_t i=0;i<tableSize;++i)
+			if(slots[i].probeLength!=0)
+				{
+				slots[i].entry.~Entry();
+				slots[i].probeLength=0;
+				}
+		
+		usedEntries=0;
+		}
+	size_t getNumEntries(void) const // Returns the number of entries currently in the hash table
+		{
+		return usedEntries;
+		}
+	size_t getTableSize(void) const // Returns the current number of table slots
+		{
+		return tableSize;
+		}
+	bool setEntry(const Entry& newEntry)
+		{
+		size_t index=findSlot(newEntry.getSource());
+		if(index<tableSize)
+			{
+			/* Set value of existing entry: */
+			slots[index].entry=newEntry;
+			return true;
+			}
+		else
+			{
+			/* Insert new entry: */
+			insertEntry(newEntry);
+			return false;
+			}
+		}
+	void removeEntry(const Source& findSource) // Removes entry
+		{
+		size_t index=findSlot(findSource);
+		if(index<tableSize)
+			removeSlot(index);
+		}
+	bool isEntry(const Source& findSource) const
+		{
+		return findSlot(findSource)<tableSize;
+		}
+	bool isEntry(const Entry& entry) const // Wrapper for isEntry function
+		{
+		return isEntry(entry.getSource());
+		}
+	const Entry& getEntry(const Source& findSource) const // Returns reference to entry; throws exception if entry is not found
+		{
+		size_t index=findSlot(findSource);
+		if(index>=tableSize)
+			throw EntryNotFoundError(findSource);
+		return slots[index].entry;
+		}
+	Entry& getEntry(const Source& findSource) // Ditto
+		{
+		size_t index=findSlot(findSource);
+		if(index>=tableSize)
+			throw EntryNotFoundError(findSource);
+		return slots[index].entry;
+		}
+	Entry& operator[](const Source& source) // Returns reference to entry; inserts new entry if source is not found
+		{
+		size_t index=findSlot(source);
+		if(index>=tableSize)
+			{
+			/* Insert new entry with default destination: */
+			index=insertEntry(Entry(source));
+			}
+		return slots[index].entry;
+		}
+	Iterator begin(void)
+		{
+		return Iterator(this,0); // Create iterator to first entry
+		}
+	ConstIterator begin(void) const
+		{
+		return ConstIterator(this,0); // Create iterator to first entry
+		}
+	Iterator end(void)
+		{
+		return Iterator(this,tableSize); // Create iterator past end of table
+		}
+	ConstIterator end(void) const
+		{
+		return ConstIterator(this,tableSize); // Create iterator past end of table
+		}
+	Iterator findEntry(const Source& findSource)
+		{
+		return Iterator(this,findSlot(findSource));
+		}
+	ConstIterator findEntry(const Source& findSource) const
+		{
+		return ConstIterator(this,findSlot(findSource));
+		}
+	void removeEntry(const Iterator& it) // Removes entry pointed to by iterator
+		{
+		if(it.table==this&&it.slotIndex<tableSize&&slots[it.slotIndex].probeLength!=0)
+			removeSlot(it.slotIndex);
+		}
+	};
+
+}
+
+#endif
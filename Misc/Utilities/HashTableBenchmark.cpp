@@ -0,0 +1,213 @@
+/***********************************************************************
+HashTableBenchmark - Program to compare the speed of chained and open
+addressing hash tables for insertion, successful and unsuccessful
+lookup, iteration, and removal at different load factors, and to check
+that both produce identical results.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Miscellaneous Support Library (Misc).
+
+The Miscellaneous Support Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Miscellaneous Support Library is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Miscellaneous Support Library; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <Misc/SizedTypes.h>
+#include <Misc/HashTable.h>
+#include <Misc/FlatHashTable.h>
+#include <Realtime/Time.h>
+
+/****************************
+Benchmarked hash table types:
+****************************/
+
+typedef Misc::HashTable<unsigned int,unsigned int> ChainedTable;
+typedef Misc::FlatHashTable<unsigned int,unsigned int> FlatTable;
+
+/**********************
+Benchmarked operations:
+**********************/
+
+enum Operation
+	{
+	INSERT,FIND_HIT,FIND_MISS,ITERATE,REMOVE,NUMOPERATIONS
+	};
+
+const char* operationNames[NUMOPERATIONS]=
+	{
+	"insert","find_hit","find_miss","iterate","remove"
+	};
+
+/****************
+Helper functions:
+****************/
+
+std::vector<double> parseList(const char* list) // Parses a comma-separated list of numbers
+	{
+	std::vector<double> result;
+	const char* lPtr=list;
+	while(*lPtr!='\0')
+		{
+		char* endPtr;
+		result.push_back(strtod(lPtr,&endPtr));
+		lPtr=endPtr;
+		if(*lPtr==',')
+			++lPtr;
+		else if(*lPtr!='\0')
+			{
+			result.clear();
+			break;
+			}
+		}
+	return result;
+	}
+
+template <class TableParam>
+void runOperations(TableParam& table,const std::vector<unsigned int>& keys,const std::vector<unsigned int>& lookupKeys,const std::vector<unsigned int>& missingKeys,double times[NUMOPERATIONS],Misc::UInt64 results[NUMOPERATIONS]) // Runs all operations on the given empty table and stores their times and results
+	{
+	Realtime::TimePointMonotonic start;
+	
+	/* Insert all keys: */
+	for(size_t i=0;i<keys.size();++i)
+		table.setEntry(typename TableParam::Entry(keys[i],(unsigned int)(i)));
+	times[INSERT]=double(start.setAndDiff());
+	results[INSERT]=table.getNumEntries();
+	
+	/* Look up all keys in random order: */
+	Misc::UInt64 sum=0;
+	for(std::vector<unsigned int>::const_iterator kIt=lookupKeys.begin();kIt!=lookupKeys.end();++kIt)
+		{
+		typename TableParam::Iterator tIt=table.findEntry(*kIt);
+		if(!tIt.isFinished())
+			sum+=tIt->getDest();
+		}
+	times[FIND_HIT]=double(start.setAndDiff());
+	results[FIND_HIT]=sum;
+	
+	/* Look up keys that are not in the table: */
+	Misc::UInt64 numFound=0;
+	for(std::vector<unsigned int>::const_iterator kIt=missingKeys.begin();kIt!=missingKeys.end();++kIt)
+		if(table.isEntry(*kIt))
+			++numFound;
+	times[FIND_MISS]=double(start.setAndDiff());
+	results[FIND_MISS]=numFound;
+	
+	/* Iterate over all entries: */
+	sum=0;
+	for(typename TableParam::Iterator tIt=table.begin();!tIt.isFinished();++tIt)
+		sum+=Misc::UInt64(tIt->getSource())*31U+tIt->getDest();
+	times[ITERATE]=double(start.setAndDiff());
+	results[ITERATE]=sum;
+	
+	/* Remove every other key: */
+	for(size_t i=0;i<keys.size();i+=2)
+		table.removeEntry(keys[i]);
+	times[REMOVE]=double(start.setAndDiff());
+	results[REMOVE]=table.getNumEntries();
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numEntries=1000000;
+	std::vector<double> loadFactors=parseList("0.25,0.5,0.7,0.8,0.9,0");
+	unsigned int numRounds=3;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"numEntries")==0&&i+1<argc)
+				numEntries=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"loadFactors")==0&&i+1<argc)
+				loadFactors=parseList(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"numRounds")==0&&i+1<argc)
+				numRounds=(unsigned int)(atoi(argv[++i]));
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	if(numEntries<1||loadFactors.empty()||numRounds<1)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-numEntries <number of entries>] [-loadFactors <l1,l2,...>] [-numRounds <number of rounds>]"<<std::endl;
+		std::cerr<<"A load factor of 0 starts from a small table that grows during insertion"<<std::endl;
+		return 1;
+		}
+	
+	/* Create distinct pseudo-random keys by multiplicative scrambling of consecutive integers: */
+	std::vector<unsigned int> keys(numEntries);
+	std::vector<unsigned int> missingKeys(numEntries);
+	for(unsigned int i=0;i<numEntries;++i)
+		{
+		keys[i]=i*2654435761U;
+		missingKeys[i]=(i+numEntries)*2654435761U;
+		}
+	std::vector<unsigned int> lookupKeys(keys);
+	std::random_shuffle(lookupKeys.begin(),lookupKeys.end());
+	
+	/* Print the header of the comma-separated result table: */
+	printf("operation,load_factor,chained_ns,flat_ns,speedup,identical\n");
+	
+	int result=0;
+	for(std::vector<double>::iterator lfIt=loadFactors.begin();lfIt!=loadFactors.end();++lfIt)
+		{
+		/* Size the tables for the requested load factor, or start small and let them grow: */
+		size_t tableSize=*lfIt>0.0?size_t(double(numEntries)/(*lfIt))+1:101;
+		float waterMark=*lfIt>0.0?1.0f:0.8f;
+		
+		/* Run all operations on both table types several times and keep the best times: */
+		double bestTimes[2][NUMOPERATIONS];
+		Misc::UInt64 results[2][NUMOPERATIONS];
+		for(unsigned int round=0;round<numRounds;++round)
+			{
+			double times[2][NUMOPERATIONS];
+			{
+			ChainedTable chained(tableSize,waterMark);
+			runOperations(chained,keys,lookupKeys,missingKeys,times[0],results[0]);
+			}
+			{
+			FlatTable flat(tableSize,waterMark);
+			runOperations(flat,keys,lookupKeys,missingKeys,times[1],results[1]);
+			}
+			for(int t=0;t<2;++t)
+				for(int op=0;op<NUMOPERATIONS;++op)
+					if(round==0||bestTimes[t][op]>times[t][op])
+						bestTimes[t][op]=times[t][op];
+			}
+		
+		/* Print the per-operation times: */
+		for(int op=0;op<NUMOPERATIONS;++op)
+			{
+			double numOps=op==REMOVE?double((numEntries+1)/2):double(numEntries);
+			bool identical=results[0][op]==results[1][op];
+			if(*lfIt>0.0)
+				printf("%s,%.2f",operationNames[op],*lfIt);
+			else
+				printf("%s,grow",operationNames[op]);
+			printf(",%.1f,%.1f,%.2f,%s\n",bestTimes[0][op]*1.0e9/numOps,bestTimes[1][op]*1.0e9/numOps,bestTimes[0][op]/bestTimes[1][op],identical?"yes":"no");
+			if(!identical)
+				result=1;
+			}
+		fflush(stdout);
+		}
+	
+	return result;
+	}
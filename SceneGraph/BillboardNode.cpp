@@ -91,6 +91,28 @@ void BillboardNode::update(void)
 		orthoZAxis.normalize();
 		rotationNormal=axisOfRotation.getValue()^orthoZAxis;
 		}
+	
+	/* Update the group node: */
+	GroupNode::update();
+	}
+
+Box BillboardNode::calcBoundingBox(void) const
+	{
+	/* Return the children's bounding box if it does not have a finite size: */
+	Box childrenBox=calcChildrenBoundingBox();
+	if(childrenBox.isNull()||childrenBox.isFull())
+		return childrenBox;
+	
+	/* Return a box containing the children's bounding box under all rotations around the origin: */
+	Scalar radius2(0);
+	for(int i=0;i<8;++i)
+		{
+		Scalar dist2=Geometry::sqrDist(childrenBox.getVertex(i),Point::origin);
+		if(radius2<dist2)
+			radius2=dist2;
+		}
+	Scalar radius=Math::sqrt(radius2);
+	return Box(Point(-radius,-radius,-radius),Point(radius,radius,radius));
 	}
 
 void BillboardNode::glRenderAction(GLRenderState& renderState) const
@@ -131,10 +153,11 @@ void BillboardNode::glRenderAction(GLRenderState& renderState) const
 		previousTransform=renderState.pushTransform(transform);
 		}
 	
-	/* Call the render actions of all children in order: */
-	for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
-		(*chIt)->glRenderAction(renderState);
-		
+	/* Call the render actions of all children in order if the children's bounding box is inside the view frustum: */
+	if(renderState.isBoxVisible(boundingBox))
+		for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
+			(*chIt)->glRenderAction(renderState);
+	
 	/* Pop the transformation off the matrix stack: */
 	renderState.popTransform(previousTransform);
 	}
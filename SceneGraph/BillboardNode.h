@@ -56,6 +56,7 @@ class BillboardNode:public GroupNode
 	virtual void update(void);
 	
 	/* Methods from GraphNode: */
+	virtual Box calcBoundingBox(void) const;
 	virtual void glRenderAction(GLRenderState& renderState) const;
 	};
 
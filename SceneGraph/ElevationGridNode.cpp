@@ -25,7 +25,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <SceneGraph/ElevationGridNode.h>
 
 #include <string.h>
+#include <algorithm>
 #include <Math/Constants.h>
+#include <Threads/Mutex.h>
+#include <Threads/TaskPool.h>
 #include <GL/gl.h>
 #include <GL/GLColorTemplates.h>
 #include <GL/GLContextData.h>
@@ -73,260 +76,140 @@ ElevationGridNode::DataItem::~DataItem(void)
 		glDeleteBuffersARB(1,&indexBufferObjectId);
 	}
 
-/**********************************
-Methods of class ElevationGridNode:
-**********************************/
+namespace {
 
-Point* ElevationGridNode::calcVertices(void) const
+/************************************************************
+Helper classes to prepare elevation grids in blocks of rows:
+************************************************************/
+
+const size_t minRowBlockSize=4; // Minimum number of grid rows processed by a thread at a time
+
+typedef ElevationGridNode::Vertex Vertex;
+
+void calcNormalScales(const ElevationGridNode& node,Scalar& nx,Scalar& ny,Scalar& nz) // Calculates the scaling factors for non-normalized per-quad normal vectors
 	{
-	/* Allocate the result array: */
-	int xDim=xDimension.getValue();
-	int zDim=zDimension.getValue();
-	Point* vertices=new Point[zDim*xDim];
-	
-	/* Calculate all vertex positions: */
-	Scalar xSp=xSpacing.getValue();
-	Scalar zSp=zSpacing.getValue();
-	Point* vPtr=vertices;
-	const Scalar* hPtr=&height.getValue(0);
-	if(heightIsY.getValue())
-		{
-		Point p;
-		p[2]=origin.getValue()[2];
-		for(int z=0;z<zDim;++z,p[2]+=zSp)
-			{
-			p[0]=origin.getValue()[0];
-			for(int x=0;x<xDim;++x,++vPtr,++hPtr,p[0]+=xSp)
-				{
-				p[1]=origin.getValue()[1]+*hPtr*heightScale.getValue();
-				*vPtr=p;
-				}
-			}
-		}
-	else
-		{
-		Point p;
-		p[1]=origin.getValue()[1];
-		for(int z=0;z<zDim;++z,p[1]+=zSp)
-			{
-			p[0]=origin.getValue()[0];
-			for(int x=0;x<xDim;++x,++vPtr,++hPtr,p[0]+=xSp)
-				{
-				p[2]=origin.getValue()[2]+*hPtr*heightScale.getValue();
-				*vPtr=p;
-				}
-			}
-		}
+	nx=node.zSpacing.getValue()*node.heightScale.getValue();
+	ny=node.xSpacing.getValue()*node.zSpacing.getValue();
+	nz=node.xSpacing.getValue()*node.heightScale.getValue();
 	
-	return vertices;
+	/* Flip normal vectors if quads are oriented clockwise, and again to account for y,z-swap: */
+	Scalar sign(1);
+	if(!node.ccw.getValue())
+		sign=-sign;
+	if(!node.heightIsY.getValue())
+		sign=-sign;
+	nx*=sign;
+	ny*=sign;
+	nz*=sign;
 	}
 
-Vector* ElevationGridNode::calcQuadNormals(void) const
+class VertexCalculator // Functor to calculate untransformed vertex positions
 	{
-	/* Allocate the result array: */
-	int xDim=xDimension.getValue();
-	int zDim=zDimension.getValue();
-	Vector* normals=new Vector[(zDim-1)*(xDim-1)];
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	Point* vertices; // Array of vertex positions
 	
-	/* Calculate the normal scaling factors: */
-	Scalar nx=zSpacing.getValue()*heightScale.getValue();
-	Scalar ny=xSpacing.getValue()*zSpacing.getValue();
-	Scalar nz=xSpacing.getValue()*heightScale.getValue();
-	if(!ccw.getValue())
+	/* Constructors and destructors: */
+	public:
+	VertexCalculator(const ElevationGridNode& sNode,Point* sVertices)
+		:node(sNode),vertices(sVertices)
 		{
-		/* Flip normal vectors if quads are oriented clockwise: */
-		nx=-nx;
-		ny=-ny;
-		nz=-nz;
 		}
 	
-	if(heightIsY.getValue())
-		{
-		/* Calculate all quad normal vectors: */
-		Vector* nPtr=normals;
-		for(int z=0;z<zDim-1;++z)
-			for(int x=0;x<xDim-1;++x,++nPtr)
-				{
-				/* Calculate the quad normal as the average of the normals of the quad's two triangles: */
-				const Scalar* h=&(height.getValue(z*xDim+x));
-				(*nPtr)[0]=(h[0]-h[1]+h[xDim]-h[xDim+1])*nx;
-				(*nPtr)[1]=ny*Scalar(2); // To average over sum of two triangle normals
-				(*nPtr)[2]=(h[0]+h[1]-h[xDim]-h[xDim+1])*nz;
-				}
-		}
-	else
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
 		{
-		/* Flip normal vectors to account for y,z-swap: */
-		nx=-nx;
-		ny=-ny;
-		nz=-nz;
+		int xDim=node.xDimension.getValue();
+		Scalar xSp=node.xSpacing.getValue();
+		Scalar zSp=node.zSpacing.getValue();
+		int hComp=2;
+		int zComp=1;
+		if(node.heightIsY.getValue())
+			std::swap(hComp,zComp);
+		const Point& o=node.origin.getValue();
 		
-		/* Calculate all quad normal vectors: */
-		Vector* nPtr=normals;
-		for(int z=0;z<zDim-1;++z)
-			for(int x=0;x<xDim-1;++x,++nPtr)
+		/* Accumulate the block's first row position by repeated addition to get the same rounding as a serial pass over all rows: */
+		Point p;
+		p[zComp]=o[zComp];
+		for(size_t z=0;z<zBegin;++z)
+			p[zComp]+=zSp;
+		
+		Point* vPtr=vertices+zBegin*xDim;
+		const Scalar* hPtr=&node.height.getValue(zBegin*xDim);
+		for(int z=int(zBegin);z<int(zEnd);++z,p[zComp]+=zSp)
+			{
+			p[0]=o[0];
+			for(int x=0;x<xDim;++x,++vPtr,++hPtr,p[0]+=xSp)
 				{
-				/* Calculate the quad normal as the average of the normals of the quad's two triangles: */
-				const Scalar* h=&(height.getValue(z*xDim+x));
-				(*nPtr)[0]=(h[0]-h[1]+h[xDim]-h[xDim+1])*nx;
-				(*nPtr)[1]=(h[0]+h[1]-h[xDim]-h[xDim+1])*nz;
-				(*nPtr)[2]=ny*Scalar(2); // To average over sum of two triangle normals
+				p[hComp]=o[hComp]+*hPtr*node.heightScale.getValue();
+				*vPtr=p;
 				}
-		}
-	
-	return normals;
-	}
-
-int* ElevationGridNode::calcHoleyQuadCases(GLuint& numQuads,GLuint& numTriangles) const
-	{
-	/* Allocate the result array: */
-	int xDim=xDimension.getValue();
-	int zDim=zDimension.getValue();
-	int* quadCases=new int[(zDim-1)*(xDim-1)];
-	
-	/* Calculate the triangulation cases for all grid cells: */
-	numQuads=0;
-	numTriangles=0;
-	int* qcPtr=quadCases;
-	for(int z=0;z<zDim-1;++z)
-		for(int x=0;x<xDim-1;++x,++qcPtr)
-			{
-			/* Compare the grid cell's four corner elevations against the invalid value: */
-			const Scalar* h=&(height.getValue(z*xDim+x));
-			int c=0x0;
-			if(h[0]!=invalidHeight.getValue())
-				c+=0x1;
-			if(h[1]!=invalidHeight.getValue())
-				c+=0x2;
-			if(h[xDim]!=invalidHeight.getValue())
-				c+=0x4;
-			if(h[xDim+1]!=invalidHeight.getValue())
-				c+=0x8;
-			
-			/* Accumulate the number of quads or triangles for this grid cell: */
-			if(c==0x7||c==0xb||c==0xd||c==0xe)
-				++numTriangles;
-			if(c==0xf)
-				++numQuads;
-			
-			/* Store the quad case: */
-			*qcPtr=c;
 			}
-	
-	return quadCases;
-	}
+		}
+	};
 
-Vector* ElevationGridNode::calcHoleyQuadNormals(const int* quadCases) const
+class QuadNormalCalculator // Functor to calculate non-normalized per-quad normal vectors, optionally with removal of invalid samples
 	{
-	/* Allocate the result array: */
-	int xDim=xDimension.getValue();
-	int zDim=zDimension.getValue();
-	Vector* normals=new Vector[(zDim-1)*(xDim-1)];
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	const int* quadCases; // Array of quad triangulation cases, or null if all samples are valid
+	Vector* normals; // Array of per-quad normal vectors
+	Scalar nx,ny,nz; // Normal scaling factors
 	
-	/* Calculate the normal scaling factors: */
-	Scalar nx=zSpacing.getValue()*heightScale.getValue();
-	Scalar ny=xSpacing.getValue()*zSpacing.getValue();
-	Scalar nz=xSpacing.getValue()*heightScale.getValue();
-	if(!ccw.getValue())
+	/* Constructors and destructors: */
+	public:
+	QuadNormalCalculator(const ElevationGridNode& sNode,const int* sQuadCases,Vector* sNormals)
+		:node(sNode),quadCases(sQuadCases),normals(sNormals)
 		{
-		/* Flip normal vectors if quads are oriented clockwise: */
-		nx=-nx;
-		ny=-ny;
-		nz=-nz;
+		calcNormalScales(node,nx,ny,nz);
 		}
 	
-	if(heightIsY.getValue())
-		{
-		/* Calculate all quad normal vectors: */
-		Vector* nPtr=normals;
-		const int* qcPtr=quadCases;
-		for(int z=0;z<zDim-1;++z)
-			for(int x=0;x<xDim-1;++x,++nPtr,++qcPtr)
-				{
-				/* Calculate the quad normal depending on the quad's triangulation case: */
-				const Scalar* h=&(height.getValue(z*xDim+x));
-				switch(*qcPtr)
-					{
-					case 0x7: // Lower-left triangle
-						(*nPtr)[0]=(h[1]-h[0])*nx;
-						(*nPtr)[1]=ny;
-						(*nPtr)[2]=(h[0]-h[xDim])*nz;
-						break;
-					
-					case 0xb: // Lower-right triangle
-						(*nPtr)[0]=(h[0]-h[1])*nx;
-						(*nPtr)[1]=ny;
-						(*nPtr)[2]=(h[1]-h[xDim+1])*nz;
-						break;
-					
-					case 0xd: // Upper-left triangle
-						(*nPtr)[0]=(h[xDim]-h[xDim+1])*nx;
-						(*nPtr)[1]=ny;
-						(*nPtr)[2]=(h[0]-h[xDim])*nz;
-						break;
-					
-					case 0xe: // Upper-right triangle
-						(*nPtr)[0]=(h[xDim]-h[xDim+1])*nx;
-						(*nPtr)[1]=ny;
-						(*nPtr)[2]=(h[1]-h[xDim+1])*nz;
-						break;
-					
-					case 0xf: // Full quad
-						(*nPtr)[0]=(h[0]-h[1]+h[xDim]-h[xDim+1])*nx;
-						(*nPtr)[1]=ny*Scalar(2); // To average over sum of two triangle normals;
-						(*nPtr)[2]=(h[0]+h[1]-h[xDim]-h[xDim+1])*nz;
-						break;
-					
-					default:
-						*nPtr=Vector::zero;
-					}
-				}
-		}
-	else
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
 		{
-		/* Flip normal vectors to account for y,z-swap: */
-		nx=-nx;
-		ny=-ny;
-		nz=-nz;
-		
-		/* Calculate all quad normal vectors: */
-		Vector* nPtr=normals;
-		const int* qcPtr=quadCases;
-		for(int z=0;z<zDim-1;++z)
-			for(int x=0;x<xDim-1;++x,++nPtr,++qcPtr)
+		int xDim=node.xDimension.getValue();
+		int hComp=2;
+		int zComp=1;
+		if(node.heightIsY.getValue())
+			std::swap(hComp,zComp);
+		Vector* nPtr=normals+zBegin*(xDim-1);
+		for(int z=int(zBegin);z<int(zEnd);++z)
+			for(int x=0;x<xDim-1;++x,++nPtr)
 				{
 				/* Calculate the quad normal depending on the quad's triangulation case: */
-				const Scalar* h=&(height.getValue(z*xDim+x));
-				switch(*qcPtr)
+				const Scalar* h=&(node.height.getValue(z*xDim+x));
+				switch(quadCases!=0?quadCases[z*(xDim-1)+x]:0xf)
 					{
 					case 0x7: // Lower-left triangle
 						(*nPtr)[0]=(h[1]-h[0])*nx;
-						(*nPtr)[1]=(h[0]-h[xDim])*nz;
-						(*nPtr)[2]=ny;
+						(*nPtr)[hComp]=ny;
+						(*nPtr)[zComp]=(h[0]-h[xDim])*nz;
 						break;
 					
 					case 0xb: // Lower-right triangle
 						(*nPtr)[0]=(h[0]-h[1])*nx;
-						(*nPtr)[1]=(h[1]-h[xDim+1])*nz;
-						(*nPtr)[2]=ny;
+						(*nPtr)[hComp]=ny;
+						(*nPtr)[zComp]=(h[1]-h[xDim+1])*nz;
 						break;
 					
 					case 0xd: // Upper-left triangle
 						(*nPtr)[0]=(h[xDim]-h[xDim+1])*nx;
-						(*nPtr)[1]=(h[0]-h[xDim])*nz;
-						(*nPtr)[2]=ny;
+						(*nPtr)[hComp]=ny;
+						(*nPtr)[zComp]=(h[0]-h[xDim])*nz;
 						break;
 					
 					case 0xe: // Upper-right triangle
 						(*nPtr)[0]=(h[xDim]-h[xDim+1])*nx;
-						(*nPtr)[1]=(h[1]-h[xDim+1])*nz;
-						(*nPtr)[2]=ny;
+						(*nPtr)[hComp]=ny;
+						(*nPtr)[zComp]=(h[1]-h[xDim+1])*nz;
 						break;
 					
-					case 0xf: // Full quad
+					case 0xf: // Full quad; average of the normals of the quad's two triangles
 						(*nPtr)[0]=(h[0]-h[1]+h[xDim]-h[xDim+1])*nx;
-						(*nPtr)[1]=(h[0]+h[1]-h[xDim]-h[xDim+1])*nz;
-						(*nPtr)[2]=ny*Scalar(2); // To average over sum of two triangle normals;
+						(*nPtr)[hComp]=ny*Scalar(2); // To average over sum of two triangle normals
+						(*nPtr)[zComp]=(h[0]+h[1]-h[xDim]-h[xDim+1])*nz;
 						break;
 					
 					default:
@@ -334,198 +217,95 @@ Vector* ElevationGridNode::calcHoleyQuadNormals(const int* quadCases) const
 					}
 				}
 		}
-	
-	return normals;
-	}
+	};
 
-void ElevationGridNode::uploadIndexedQuadStripSet(void) const
+class HoleyQuadCaseCalculator // Functor to calculate quad triangulation cases and to count the resulting quads and triangles
 	{
-	/* Define the vertex type used in the vertex array: */
-	typedef GLGeometry::Vertex<Scalar,2,GLubyte,4,Scalar,Scalar,3> Vertex;
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	int* quadCases; // Array of quad triangulation cases
+	Threads::Mutex countMutex; // Mutex serializing access to the quad and triangle counters
+	GLuint& numQuads; // Number of full quads
+	GLuint& numTriangles; // Number of triangles
 	
-	/* Retrieve the elevation grid layout: */
-	int xDim=xDimension.getValue();
-	int zDim=zDimension.getValue();
-	Scalar xSp=xSpacing.getValue();
-	Scalar zSp=zSpacing.getValue();
-	
-	/* Calculate all per-quad normal vectors if there are no explicit normals: */
-	Vector* quadNormals=0;
-	if(normal.getValue()==0)
-		quadNormals=calcQuadNormals();
-	
-	/* Initialize the vertex buffer object: */
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB,xDim*zDim*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
-	
-	/* Store all vertices: */
-	int hComp=2;
-	int zComp=1;
-	if(heightIsY.getValue())
-		std::swap(hComp,zComp);
-	Scalar hOffset=origin.getValue()[hComp];
-	Scalar zOffset=origin.getValue()[zComp];
-	Vertex* vPtr=static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB));
-	size_t vInd=0;
-	for(int z=0;z<zDim;++z)
-		for(int x=0;x<xDim;++x,++vPtr,++vInd)
-			{
-			/* Calculate the raw vertex position: */
-			Point p;
-			p[0]=origin.getValue()[0]+Scalar(x)*Scalar(xSp);
-			p[hComp]=hOffset+height.getValue(vInd)*heightScale.getValue();
-			p[zComp]=zOffset+Scalar(z)*Scalar(zSp);
-			
-			/* Store the vertex' texture coordinate: */
-			if(imageProjection.getValue()!=0)
-				{
-				/* Retrieve texture coordinates from the image projection node: */
-				vPtr->texCoord=imageProjection.getValue()->calcTexCoord(p);
-				}
-			else if(texCoord.getValue()!=0)
-				vPtr->texCoord=texCoord.getValue()->point.getValue(vInd);
-			else
-				{
-				/* Generate standard texture coordinates: */
-				vPtr->texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
-				}
-			
-			/* Store the vertex' color: */
-			if(color.getValue()!=0)
-				vPtr->color=Vertex::Color(color.getValue()->color.getValue(vInd));
-			else if(colorMap.getValue()!=0)
-				vPtr->color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd)*heightScale.getValue()));
-			else
-				vPtr->color=Vertex::Color(255,255,255);
-			
-			/* Calculate the vertex normal: */
-			Vector n;
-			if(normal.getValue()!=0)
-				{
-				n=normal.getValue()->vector.getValue(vInd);
-				if(!heightIsY.getValue())
-					{
-					std::swap(n[1],n[2]);
-					n=-n;
-					}
-				}  
-			else
-				{
-				/* Average the quad normals of quads surrounding the vertex: */
-				n=Vector::zero;
-				Vector* qn=quadNormals+(z*(xDim-1)+x);
-				if(x>0)
-					{
-					if(z>0)
-						n+=qn[-(xDim-1)-1];
-					if(z<zDim-1)
-						n+=qn[-1];
-					}
-				if(x<xDim-1)
-					{
-					if(z>0)
-						n+=qn[-(xDim-1)];
-					if(z<zDim-1)
-						n+=qn[0];
-					}
-				}
-			
-			/* Store the vertex position and normal: */
-			if(pointTransform.getValue()!=0)
-				{
-				vPtr->normal=Vertex::Normal(pointTransform.getValue()->transformNormal(p,n));
-				vPtr->position=Vertex::Position(pointTransform.getValue()->transformPoint(p));
-				}
-			else
-				{
-				n.normalize();
-				vPtr->normal=Vertex::Normal(n);
-				vPtr->position=Vertex::Position(p);
-				}
-			}
-	
-	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
-	
-	/* Delete the per-quad normals: */
-	delete[] quadNormals;
-	
-	/* Initialize the index buffer object: */
-	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB,(zDim-1)*xDim*2*sizeof(GLuint),0,GL_STATIC_DRAW_ARB);
-	
-	/* Store all vertex indices: */
-	GLuint* iPtr=static_cast<GLuint*>(glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB));
-	if(ccw.getValue())
+	/* Constructors and destructors: */
+	public:
+	HoleyQuadCaseCalculator(const ElevationGridNode& sNode,int* sQuadCases,GLuint& sNumQuads,GLuint& sNumTriangles)
+		:node(sNode),quadCases(sQuadCases),
+		 numQuads(sNumQuads),numTriangles(sNumTriangles)
 		{
-		for(int z=0;z<zDim-1;++z)
-			for(int x=0;x<xDim;++x,iPtr+=2)
-				{
-				iPtr[0]=GLuint(z*xDim+x);
-				iPtr[1]=GLuint((z+1)*xDim+x);
-				}
 		}
-	else
+	
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
 		{
-		for(int z=0;z<zDim-1;++z)
-			for(int x=0;x<xDim;++x,iPtr+=2)
+		int xDim=node.xDimension.getValue();
+		Scalar invalidHeight=node.invalidHeight.getValue();
+		GLuint blockNumQuads=0;
+		GLuint blockNumTriangles=0;
+		int* qcPtr=quadCases+zBegin*(xDim-1);
+		for(int z=int(zBegin);z<int(zEnd);++z)
+			for(int x=0;x<xDim-1;++x,++qcPtr)
 				{
-				iPtr[0]=GLuint((z+1)*xDim+x);
-				iPtr[1]=GLuint(z*xDim+x);
+				/* Compare the grid cell's four corner elevations against the invalid value: */
+				const Scalar* h=&(node.height.getValue(z*xDim+x));
+				int c=0x0;
+				if(h[0]!=invalidHeight)
+					c+=0x1;
+				if(h[1]!=invalidHeight)
+					c+=0x2;
+				if(h[xDim]!=invalidHeight)
+					c+=0x4;
+				if(h[xDim+1]!=invalidHeight)
+					c+=0x8;
+				
+				/* Accumulate the number of quads or triangles for this grid cell: */
+				if(c==0x7||c==0xb||c==0xd||c==0xe)
+					++blockNumTriangles;
+				if(c==0xf)
+					++blockNumQuads;
+				
+				/* Store the quad case: */
+				*qcPtr=c;
 				}
+		
+		/* Add the block's quads and triangles to the totals: */
+		Threads::Mutex::Lock countLock(countMutex);
+		numQuads+=blockNumQuads;
+		numTriangles+=blockNumTriangles;
 		}
-	
-	glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
-	}
+	};
 
-void ElevationGridNode::uploadQuadSet(void) const
+class VertexNormalCalculator // Functor to convert per-quad normal vectors to non-normalized per-vertex normal vectors, optionally with removal of invalid samples
 	{
-	/* Define the vertex type used in the vertex array: */
-	typedef GLGeometry::Vertex<Scalar,2,GLubyte,4,Scalar,Scalar,3> Vertex;
-	
-	/* Retrieve the elevation grid layout: */
-	int xDim=xDimension.getValue();
-	int zDim=zDimension.getValue();
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	const int* quadCases; // Array of quad triangulation cases, or null if all samples are valid
+	const Vector* quadNormals; // Array of per-quad normal vectors
+	Vector* vertexNormals; // Array of per-vertex normal vectors
 	
-	/* Calculate all untransformed vertex positions: */
-	Point* vertices=calcVertices();
+	/* Constructors and destructors: */
+	public:
+	VertexNormalCalculator(const ElevationGridNode& sNode,const int* sQuadCases,const Vector* sQuadNormals,Vector* sVertexNormals)
+		:node(sNode),quadCases(sQuadCases),quadNormals(sQuadNormals),vertexNormals(sVertexNormals)
+		{
+		}
 	
-	/* Calculate all per-quad or per-vertex normal vectors if there are no explicit normals: */
-	Vector* quadNormals=0;
-	Vector* vertexNormals=0;
-	if(normalPerVertex.getValue())
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
 		{
-		if(normal.getValue()!=0)
+		int xDim=node.xDimension.getValue();
+		int zDim=node.zDimension.getValue();
+		Vector* vnPtr=vertexNormals+zBegin*xDim;
+		if(quadCases==0)
 			{
-			/* Copy the provided normals: */
-			vertexNormals=new Vector[zDim*xDim];
-			MF<Vector>::ValueList::const_iterator nIt=normal.getValue()->vector.getValues().begin();
-			Vector* vnPtr=vertexNormals;
-			if(heightIsY.getValue())
-				{
-				for(int i=zDim*xDim;i>0;--i,++nIt,++vnPtr)
-					*vnPtr=*nIt;
-				}
-			else
-				{
-				for(int i=zDim*xDim;i>0;--i,++nIt,++vnPtr)
-					{
-					(*vnPtr)[0]=-(*nIt)[0];
-					(*vnPtr)[1]=-(*nIt)[2];
-					(*vnPtr)[2]=-(*nIt)[1];
-					}
-				}
-			}
-		else
-			{
-			/* Calculate the per-quad normals: */
-			quadNormals=calcQuadNormals();
-			
-			/* Convert the per-quad normals to non-normalized per-vertex normals: */
-			vertexNormals=new Vector[zDim*xDim];
-			Vector* vnPtr=vertexNormals;
-			for(int z=0;z<zDim;++z)
+			for(int z=int(zBegin);z<int(zEnd);++z)
 				for(int x=0;x<xDim;++x,++vnPtr)
 					{
 					*vnPtr=Vector::zero;
-					Vector* qn=quadNormals+(z*(xDim-1)+x);
+					const Vector* qn=quadNormals+(z*(xDim-1)+x);
 					if(x>0)
 						{
 						if(z>0)
@@ -541,226 +321,748 @@ void ElevationGridNode::uploadQuadSet(void) const
 							*vnPtr+=qn[0];
 						}
 					}
-			
-			/* Delete the per-quad normals: */
-			delete[] quadNormals;
-			quadNormals=0;
-			}
-		
-		if(pointTransform.getValue()!=0)
-			{
-			/* Transform the per-vertex normals: */
-			Point* vPtr=vertices;
-			Vector* vnPtr=vertexNormals;
-			for(int i=zDim*xDim;i>0;--i,++vPtr,++vnPtr)
-				*vnPtr=pointTransform.getValue()->transformNormal(*vPtr,*vnPtr);
 			}
 		else
 			{
-			/* Normalize the per-vertex normals: */
-			Vector* vnPtr=vertexNormals;
-			for(int i=zDim*xDim;i>0;--i,++vnPtr)
-				vnPtr->normalize();
+			const Scalar* hPtr=&node.height.getValue(zBegin*xDim);
+			for(int z=int(zBegin);z<int(zEnd);++z)
+				for(int x=0;x<xDim;++x,++hPtr,++vnPtr)
+					if(*hPtr!=node.invalidHeight.getValue())
+						{
+						*vnPtr=Vector::zero;
+						const int* qc=quadCases+(z*(xDim-1)+x);
+						const Vector* qn=quadNormals+(z*(xDim-1)+x);
+						
+						/* Add each surrounding quad's normal 0, 1, or 2 times depending on the respective quad's triangulation case: */
+						if(x>0)
+							{
+							if(z>0)
+								{
+								if((qc[-(xDim-1)-1]&0xa)==0xa)
+									*vnPtr+=qn[-(xDim-1)-1];
+								if((qc[-(xDim-1)-1]&0xc)==0xc)
+									*vnPtr+=qn[-(xDim-1)-1];
+								}
+							if(z<zDim-1)
+								{
+								if((qc[-1]&0x3)==0x3)
+									*vnPtr+=qn[-1];
+								if((qc[-1]&0xa)==0xa)
+									*vnPtr+=qn[-1];
+								}
+							}
+						if(x<xDim-1)
+							{
+							if(z>0)
+								{
+								if((qc[-(xDim-1)]&0x5)==0x5)
+									*vnPtr+=qn[-(xDim-1)];
+								if((qc[-(xDim-1)]&0xc)==0xc)
+									*vnPtr+=qn[-(xDim-1)];
+								}
+							if(z<zDim-1)
+								{
+								if((qc[0]&0x3)==0x3)
+									*vnPtr+=qn[0];
+								if((qc[0]&0x5)==0x5)
+									*vnPtr+=qn[0];
+								}
+							}
+						}
 			}
 		}
-	else
+	};
+
+class VertexNormalFinisher // Functor to transform or normalize per-vertex normal vectors, optionally skipping invalid samples
+	{
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	const Point* vertices; // Array of untransformed vertex positions
+	Vector* vertexNormals; // Array of per-vertex normal vectors
+	bool skipInvalids; // Flag whether to skip vertices with invalid elevations
+	
+	/* Constructors and destructors: */
+	public:
+	VertexNormalFinisher(const ElevationGridNode& sNode,const Point* sVertices,Vector* sVertexNormals,bool sSkipInvalids)
+		:node(sNode),vertices(sVertices),vertexNormals(sVertexNormals),skipInvalids(sSkipInvalids)
 		{
-		if(normal.getValue()!=0)
-			{
-			/* Copy the provided normals: */
-			quadNormals=new Vector[(zDim-1)*(xDim-1)];
-			MF<Vector>::ValueList::const_iterator nIt=normal.getValue()->vector.getValues().begin();
-			Vector* qnPtr=quadNormals;
-			if(heightIsY.getValue())
-				{
-				for(int i=(zDim-1)*(xDim-1);i>0;--i,++nIt,++qnPtr)
-					*qnPtr=*nIt;
-				}
-			else
+		}
+	
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
+		{
+		int xDim=node.xDimension.getValue();
+		const PointTransformNode* pt=node.pointTransform.getValue().getPointer();
+		for(size_t i=zBegin*xDim;i<zEnd*xDim;++i)
+			if(!skipInvalids||node.height.getValue(i)!=node.invalidHeight.getValue())
 				{
-				for(int i=(zDim-1)*(xDim-1);i>0;--i,++nIt,++qnPtr)
-					{
-					(*qnPtr)[0]=-(*nIt)[0];
-					(*qnPtr)[1]=-(*nIt)[2];
-					(*qnPtr)[2]=-(*nIt)[1];
-					}
+				if(pt!=0)
+					vertexNormals[i]=pt->transformNormal(vertices[i],vertexNormals[i]);
+				else
+					vertexNormals[i].normalize();
 				}
-			}
-		else
-			{
-			/* Calculate the per-quad normals: */
-			quadNormals=calcQuadNormals();
-			}
-		
-		if(pointTransform.getValue()!=0)
+		}
+	};
+
+class QuadNormalFinisher // Functor to transform per-quad normal vectors around the quads' midpoints, or to normalize them
+	{
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	const Point* vertices; // Array of untransformed vertex positions
+	const int* quadCases; // Array of quad triangulation cases, or null if all samples are valid
+	Vector* quadNormals; // Array of per-quad normal vectors
+	
+	/* Constructors and destructors: */
+	public:
+	QuadNormalFinisher(const ElevationGridNode& sNode,const Point* sVertices,const int* sQuadCases,Vector* sQuadNormals)
+		:node(sNode),vertices(sVertices),quadCases(sQuadCases),quadNormals(sQuadNormals)
+		{
+		}
+	
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
+		{
+		int xDim=node.xDimension.getValue();
+		const PointTransformNode* pt=node.pointTransform.getValue().getPointer();
+		Vector* qnPtr=quadNormals+zBegin*(xDim-1);
+		if(pt!=0)
 			{
-			/* Transform the per-quad normals: */
-			Vector* qnPtr=quadNormals;
-			for(int z=0;z<zDim-1;++z)
+			for(int z=int(zBegin);z<int(zEnd);++z)
 				for(int x=0;x<xDim-1;++x,++qnPtr)
 					{
-					/* Transform the per-quad normal around the quad's midpoint: */
-					Point* vPtr=vertices+(z*xDim+x);
+					/* Transform the per-quad normal around the midpoint of the quad's triangulation: */
+					const Point* vPtr=vertices+(z*xDim+x);
 					Point mp;
-					for(int i=0;i<3;++i)
-						mp[i]=(vPtr[0][i]+vPtr[1][i]+vPtr[xDim][i]+vPtr[xDim+1][i])*Scalar(0.25);
-					*qnPtr=pointTransform.getValue()->transformNormal(mp,*qnPtr);
+					switch(quadCases!=0?quadCases[z*(xDim-1)+x]:0xf)
+						{
+						case 0x7:
+							for(int i=0;i<3;++i)
+								mp[i]=(vPtr[0][i]+vPtr[1][i]+vPtr[xDim][i])/Scalar(3);
+							*qnPtr=pt->transformNormal(mp,*qnPtr);
+							break;
+						
+						case 0xb:
+							for(int i=0;i<3;++i)
+								mp[i]=(vPtr[0][i]+vPtr[1][i]+vPtr[xDim+1][i])/Scalar(3);
+							*qnPtr=pt->transformNormal(mp,*qnPtr);
+							break;
+						
+						case 0xd:
+							for(int i=0;i<3;++i)
+								mp[i]=(vPtr[0][i]+vPtr[xDim][i]+vPtr[xDim+1][i])/Scalar(3);
+							*qnPtr=pt->transformNormal(mp,*qnPtr);
+							break;
+						
+						case 0xe:
+							for(int i=0;i<3;++i)
+								mp[i]=(vPtr[1][i]+vPtr[xDim][i]+vPtr[xDim+1][i])/Scalar(3);
+							*qnPtr=pt->transformNormal(mp,*qnPtr);
+							break;
+						
+						case 0xf:
+							for(int i=0;i<3;++i)
+								mp[i]=(vPtr[0][i]+vPtr[1][i]+vPtr[xDim][i]+vPtr[xDim+1][i])*Scalar(0.25);
+							*qnPtr=pt->transformNormal(mp,*qnPtr);
+							break;
+						}
 					}
 			}
 		else
 			{
 			/* Normalize the per-quad normals: */
-			Vector* qnPtr=quadNormals;
-			for(int i=(zDim-1)*(xDim-1);i>0;--i,++qnPtr)
+			for(size_t i=zBegin*(xDim-1);i<zEnd*(xDim-1);++i,++qnPtr)
 				qnPtr->normalize();
 			}
 		}
+	};
+
+class VertexFinisher // Functor to calculate per-vertex texture coordinates from an image projection, and to transform vertex positions, optionally skipping invalid samples
+	{
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	Point* vertices; // Array of vertex positions
+	TexCoord* vertexTexCoords; // Array of per-vertex texture coordinates, or null if there is no image projection
+	bool skipInvalids; // Flag whether to skip vertices with invalid elevations when transforming vertex positions
 	
-	TexCoord* vertexTexCoords=0;
-	if(imageProjection.getValue()!=0)
+	/* Constructors and destructors: */
+	public:
+	VertexFinisher(const ElevationGridNode& sNode,Point* sVertices,TexCoord* sVertexTexCoords,bool sSkipInvalids)
+		:node(sNode),vertices(sVertices),vertexTexCoords(sVertexTexCoords),skipInvalids(sSkipInvalids)
 		{
-		/* Calculate per-vertex texture coordinates: */
-		vertexTexCoords=new TexCoord[xDim*zDim];
-		Point* vPtr=vertices;
-		TexCoord* vtcPtr=vertexTexCoords;
-		for(int z=0;z<zDim;++z)
-			for(int x=0;x<xDim;++x,++vPtr,++vtcPtr)
-				*vtcPtr=imageProjection.getValue()->calcTexCoord(*vPtr);
 		}
 	
-	if(pointTransform.getValue()!=0)
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
 		{
-		/* Transform all vertex positions: */
-		Point* vPtr=vertices;
-		for(int i=zDim*xDim;i>0;--i,++vPtr)
-			*vPtr=pointTransform.getValue()->transformPoint(*vPtr);
+		int xDim=node.xDimension.getValue();
+		const PointTransformNode* pt=node.pointTransform.getValue().getPointer();
+		for(size_t i=zBegin*xDim;i<zEnd*xDim;++i)
+			{
+			/* Calculate texture coordinates from the untransformed vertex position: */
+			if(vertexTexCoords!=0)
+				vertexTexCoords[i]=node.imageProjection.getValue()->calcTexCoord(vertices[i]);
+			
+			/* Transform the vertex position: */
+			if(pt!=0&&(!skipInvalids||node.height.getValue(i)!=node.invalidHeight.getValue()))
+				vertices[i]=pt->transformPoint(vertices[i]);
+			}
 		}
+	};
+
+class RowPrimitiveCounter // Functor to count the quads and triangles generated by each row of grid cells
+	{
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	const int* quadCases; // Array of quad triangulation cases
+	size_t* rowNumQuads; // Array of numbers of quads per row
+	size_t* rowNumTriangles; // Array of numbers of triangles per row
 	
-	/* Initialize the vertex buffer object: */
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB,(xDim-1)*(zDim-1)*4*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
+	/* Constructors and destructors: */
+	public:
+	RowPrimitiveCounter(const ElevationGridNode& sNode,const int* sQuadCases,size_t* sRowNumQuads,size_t* sRowNumTriangles)
+		:node(sNode),quadCases(sQuadCases),rowNumQuads(sRowNumQuads),rowNumTriangles(sRowNumTriangles)
+		{
+		}
 	
-	/* Store all vertices: */
-	int hComp=heightIsY.getValue()?1:2;
-	Scalar hOffset=origin.getValue()[hComp];
-	Vertex* vPtr=static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB));
-	size_t qInd=0;
-	for(int z=0;z<zDim-1;++z)
-		for(int x=0;x<xDim-1;++x,vPtr+=4,++qInd)
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
+		{
+		int xDim=node.xDimension.getValue();
+		const int* qcPtr=quadCases+zBegin*(xDim-1);
+		for(size_t z=zBegin;z<zEnd;++z)
 			{
-			size_t vInd=z*xDim+x;
-			Vertex v[4];
-			
-			/* Calculate the corner texture coordinates of the current quad: */
-			if(imageProjection.getValue()!=0)
-				{
-				/* Store the per-vertex texture coordinates: */
-				v[0].texCoord=vertexTexCoords[vInd];
-				v[1].texCoord=vertexTexCoords[vInd+1];
-				v[2].texCoord=vertexTexCoords[vInd+xDim+1];
-				v[3].texCoord=vertexTexCoords[vInd+xDim];
-				}
-			else if(texCoord.getValue()!=0)
-				{
-				v[0].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd));
-				v[1].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd+1));
-				v[2].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd+xDim+1));
-				v[3].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd+xDim));
-				}
-			else
+			rowNumQuads[z]=0;
+			rowNumTriangles[z]=0;
+			for(int x=0;x<xDim-1;++x,++qcPtr)
 				{
-				v[0].texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
-				v[1].texCoord=Vertex::TexCoord(Scalar(x+1)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
-				v[2].texCoord=Vertex::TexCoord(Scalar(x+1)/Scalar(xDim-1),Scalar(z+1)/Scalar(zDim-1));
-				v[3].texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z+1)/Scalar(zDim-1));
+				if(*qcPtr==0x7||*qcPtr==0xb||*qcPtr==0xd||*qcPtr==0xe)
+					++rowNumTriangles[z];
+				if(*qcPtr==0xf)
+					++rowNumQuads[z];
 				}
-			
-			/* Get the corner colors of the current quad: */
-			if(color.getValue()!=0)
+			}
+		}
+	};
+
+class IndexedQuadStripVertexWriter // Functor to write the vertices of an indexed quad strip set
+	{
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	const Vector* quadNormals; // Array of non-normalized per-quad normal vectors, or null if there are explicit normals
+	Vertex* vertices; // Array of vertices
+	
+	/* Constructors and destructors: */
+	public:
+	IndexedQuadStripVertexWriter(const ElevationGridNode& sNode,const Vector* sQuadNormals,Vertex* sVertices)
+		:node(sNode),quadNormals(sQuadNormals),vertices(sVertices)
+		{
+		}
+	
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
+		{
+		/* Retrieve the elevation grid layout: */
+		int xDim=node.xDimension.getValue();
+		int zDim=node.zDimension.getValue();
+		Scalar xSp=node.xSpacing.getValue();
+		Scalar zSp=node.zSpacing.getValue();
+		int hComp=2;
+		int zComp=1;
+		if(node.heightIsY.getValue())
+			std::swap(hComp,zComp);
+		Scalar hOffset=node.origin.getValue()[hComp];
+		Scalar zOffset=node.origin.getValue()[zComp];
+		
+		Vertex* vPtr=vertices+zBegin*xDim;
+		size_t vInd=zBegin*xDim;
+		for(int z=int(zBegin);z<int(zEnd);++z)
+			for(int x=0;x<xDim;++x,++vPtr,++vInd)
 				{
-				if(colorPerVertex.getValue())
+				/* Calculate the raw vertex position: */
+				Point p;
+				p[0]=node.origin.getValue()[0]+Scalar(x)*Scalar(xSp);
+				p[hComp]=hOffset+node.height.getValue(vInd)*node.heightScale.getValue();
+				p[zComp]=zOffset+Scalar(z)*Scalar(zSp);
+				
+				/* Store the vertex' texture coordinate: */
+				if(node.imageProjection.getValue()!=0)
 					{
-					v[0].color=Vertex::Color(color.getValue()->color.getValue(vInd));
-					v[1].color=Vertex::Color(color.getValue()->color.getValue(vInd+1));
-					v[2].color=Vertex::Color(color.getValue()->color.getValue(vInd+xDim+1));
-					v[3].color=Vertex::Color(color.getValue()->color.getValue(vInd+xDim));
+					/* Retrieve texture coordinates from the image projection node: */
+					vPtr->texCoord=node.imageProjection.getValue()->calcTexCoord(p);
 					}
+				else if(node.texCoord.getValue()!=0)
+					vPtr->texCoord=node.texCoord.getValue()->point.getValue(vInd);
 				else
 					{
-					Vertex::Color c=Vertex::Color(color.getValue()->color.getValue(qInd));
-					for(int i=0;i<4;++i)
-						v[i].color=c;
+					/* Generate standard texture coordinates: */
+					vPtr->texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
 					}
-				}
-			else if(colorMap.getValue()!=0)
-				{
-				if(colorPerVertex.getValue())
+				
+				/* Store the vertex' color: */
+				if(node.color.getValue()!=0)
+					vPtr->color=Vertex::Color(node.color.getValue()->color.getValue(vInd));
+				else if(node.colorMap.getValue()!=0)
+					vPtr->color=Vertex::Color(node.colorMap.getValue()->mapColor(hOffset+node.height.getValue(vInd)*node.heightScale.getValue()));
+				else
+					vPtr->color=Vertex::Color(255,255,255);
+				
+				/* Calculate the vertex normal: */
+				Vector n;
+				if(node.normal.getValue()!=0)
 					{
-					v[0].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd)*heightScale.getValue()));
-					v[1].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd+1)*heightScale.getValue()));
-					v[2].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd+xDim+1)*heightScale.getValue()));
-					v[3].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd+xDim)*heightScale.getValue()));
+					n=node.normal.getValue()->vector.getValue(vInd);
+					if(!node.heightIsY.getValue())
+						{
+						std::swap(n[1],n[2]);
+						n=-n;
+						}
 					}
 				else
 					{
-					Scalar h=(height.getValue(vInd)+height.getValue(vInd+1)+height.getValue(vInd+xDim)+height.getValue(vInd+xDim+1))*heightScale.getValue();
-					Vertex::Color c=Vertex::Color(colorMap.getValue()->mapColor(hOffset+h*Scalar(0.25)));
-					for(int i=0;i<4;++i)
-						v[i].color=c;
+					/* Average the quad normals of quads surrounding the vertex: */
+					n=Vector::zero;
+					const Vector* qn=quadNormals+(z*(xDim-1)+x);
+					if(x>0)
+						{
+						if(z>0)
+							n+=qn[-(xDim-1)-1];
+						if(z<zDim-1)
+							n+=qn[-1];
+						}
+					if(x<xDim-1)
+						{
+						if(z>0)
+							n+=qn[-(xDim-1)];
+						if(z<zDim-1)
+							n+=qn[0];
+						}
+					}
+				
+				/* Store the vertex position and normal: */
+				if(node.pointTransform.getValue()!=0)
+					{
+					vPtr->normal=Vertex::Normal(node.pointTransform.getValue()->transformNormal(p,n));
+					vPtr->position=Vertex::Position(node.pointTransform.getValue()->transformPoint(p));
+					}
+				else
+					{
+					n.normalize();
+					vPtr->normal=Vertex::Normal(n);
+					vPtr->position=Vertex::Position(p);
 					}
 				}
-			else
-				{
-				for(int i=0;i<4;++i)
-					v[i].color=Vertex::Color(255,255,255);
-				}
-			
-			/* Set the corner normal vectors and vertex positions of the current quad: */
-			if(normalPerVertex.getValue())
+		}
+	};
+
+class IndexedQuadStripIndexWriter // Functor to write the vertex indices of an indexed quad strip set
+	{
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	GLuint* indices; // Array of vertex indices
+	
+	/* Constructors and destructors: */
+	public:
+	IndexedQuadStripIndexWriter(const ElevationGridNode& sNode,GLuint* sIndices)
+		:node(sNode),indices(sIndices)
+		{
+		}
+	
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
+		{
+		int xDim=node.xDimension.getValue();
+		GLuint* iPtr=indices+zBegin*xDim*2;
+		if(node.ccw.getValue())
+			{
+			for(int z=int(zBegin);z<int(zEnd);++z)
+				for(int x=0;x<xDim;++x,iPtr+=2)
+					{
+					iPtr[0]=GLuint(z*xDim+x);
+					iPtr[1]=GLuint((z+1)*xDim+x);
+					}
+			}
+		else
+			{
+			for(int z=int(zBegin);z<int(zEnd);++z)
+				for(int x=0;x<xDim;++x,iPtr+=2)
+					{
+					iPtr[0]=GLuint((z+1)*xDim+x);
+					iPtr[1]=GLuint(z*xDim+x);
+					}
+			}
+		}
+	};
+
+class QuadVertexWriter // Functor to write the corner vertices of grid cells as quads, or as quads and triangles with removal of invalid samples
+	{
+	/* Elements: */
+	private:
+	const ElevationGridNode& node; // The elevation grid
+	const Point* vertices; // Array of transformed vertex positions
+	const Vector* vertexNormals; // Array of per-vertex normal vectors if normals are per vertex
+	const Vector* quadNormals; // Array of per-quad normal vectors if normals are per quad
+	const TexCoord* vertexTexCoords; // Array of per-vertex texture coordinates, or null if there is no image projection
+	const int* quadCases; // Array of quad triangulation cases, or null if all samples are valid
+	const size_t* rowQuadOffsets; // Array of indices of the first quad vertex written for each row if there are invalid samples
+	const size_t* rowTriangleOffsets; // Array of indices of the first triangle vertex written for each row if there are invalid samples
+	Vertex* quadVertices; // Array of quad and triangle vertices
+	
+	/* Private methods: */
+	void calcCorners(int x,int z,Vertex v[4]) const // Calculates the corner vertices of the given grid cell
+		{
+		int xDim=node.xDimension.getValue();
+		int zDim=node.zDimension.getValue();
+		size_t vInd=z*xDim+x;
+		size_t qInd=z*(xDim-1)+x;
+		
+		/* Calculate the corner texture coordinates of the current quad: */
+		if(vertexTexCoords!=0)
+			{
+			/* Store the per-vertex texture coordinates: */
+			v[0].texCoord=vertexTexCoords[vInd];
+			v[1].texCoord=vertexTexCoords[vInd+1];
+			v[2].texCoord=vertexTexCoords[vInd+xDim+1];
+			v[3].texCoord=vertexTexCoords[vInd+xDim];
+			}
+		else if(node.texCoord.getValue()!=0)
+			{
+			v[0].texCoord=Vertex::TexCoord(node.texCoord.getValue()->point.getValue(vInd));
+			v[1].texCoord=Vertex::TexCoord(node.texCoord.getValue()->point.getValue(vInd+1));
+			v[2].texCoord=Vertex::TexCoord(node.texCoord.getValue()->point.getValue(vInd+xDim+1));
+			v[3].texCoord=Vertex::TexCoord(node.texCoord.getValue()->point.getValue(vInd+xDim));
+			}
+		else
+			{
+			v[0].texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
+			v[1].texCoord=Vertex::TexCoord(Scalar(x+1)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
+			v[2].texCoord=Vertex::TexCoord(Scalar(x+1)/Scalar(xDim-1),Scalar(z+1)/Scalar(zDim-1));
+			v[3].texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z+1)/Scalar(zDim-1));
+			}
+		
+		/* Get the corner colors of the current quad: */
+		if(node.color.getValue()!=0)
+			{
+			if(node.colorPerVertex.getValue())
 				{
-				v[0].normal=Vertex::Normal(vertexNormals[vInd]);
-				v[1].normal=Vertex::Normal(vertexNormals[vInd+1]);
-				v[2].normal=Vertex::Normal(vertexNormals[vInd+xDim+1]);
-				v[3].normal=Vertex::Normal(vertexNormals[vInd+xDim]);
+				v[0].color=Vertex::Color(node.color.getValue()->color.getValue(vInd));
+				v[1].color=Vertex::Color(node.color.getValue()->color.getValue(vInd+1));
+				v[2].color=Vertex::Color(node.color.getValue()->color.getValue(vInd+xDim+1));
+				v[3].color=Vertex::Color(node.color.getValue()->color.getValue(vInd+xDim));
 				}
 			else
 				{
-				Vertex::Normal n=Vertex::Normal(quadNormals[qInd]);
+				Vertex::Color c=Vertex::Color(node.color.getValue()->color.getValue(qInd));
 				for(int i=0;i<4;++i)
-					v[i].normal=n;
+					v[i].color=c;
 				}
-			v[0].position=Vertex::Position(vertices[vInd]);
-			v[1].position=Vertex::Position(vertices[vInd+1]);
-			v[2].position=Vertex::Position(vertices[vInd+xDim+1]);
-			v[3].position=Vertex::Position(vertices[vInd+xDim]);
-			
-			/* Store the corner vertices of the current quad: */
-			if(ccw.getValue())
+			}
+		else if(node.colorMap.getValue()!=0)
+			{
+			const ColorMapNode* cm=node.colorMap.getValue().getPointer();
+			Scalar hOffset=node.origin.getValue()[node.heightIsY.getValue()?1:2];
+			Scalar hScale=node.heightScale.getValue();
+			if(node.colorPerVertex.getValue())
 				{
-				/* Store the corner vertices in counter-clockwise order: */
+				v[0].color=Vertex::Color(cm->mapColor(hOffset+node.height.getValue(vInd)*hScale));
+				v[1].color=Vertex::Color(cm->mapColor(hOffset+node.height.getValue(vInd+1)*hScale));
+				v[2].color=Vertex::Color(cm->mapColor(hOffset+node.height.getValue(vInd+xDim+1)*hScale));
+				v[3].color=Vertex::Color(cm->mapColor(hOffset+node.height.getValue(vInd+xDim)*hScale));
+				}
+			else if(quadCases==0)
+				{
+				Scalar h=(node.height.getValue(vInd)+node.height.getValue(vInd+1)+node.height.getValue(vInd+xDim)+node.height.getValue(vInd+xDim+1))*hScale;
+				Vertex::Color c=Vertex::Color(cm->mapColor(hOffset+h*Scalar(0.25)));
 				for(int i=0;i<4;++i)
-					vPtr[i]=v[3-i];
+					v[i].color=c;
 				}
 			else
 				{
-				/* Store the corner vertices in clockwise order: */
+				/* Average the valid corner elevations: */
+				Scalar h=Scalar(0);
+				Scalar w=Scalar(0);
+				if(quadCases[qInd]&0x1)
+					{
+					h+=node.height.getValue(vInd);
+					w+=Scalar(1);
+					}
+				if(quadCases[qInd]&0x2)
+					{
+					h+=node.height.getValue(vInd+1);
+					w+=Scalar(1);
+					}
+				if(quadCases[qInd]&0x4)
+					{
+					h+=node.height.getValue(vInd+xDim);
+					w+=Scalar(1);
+					}
+				if(quadCases[qInd]&0x8)
+					{
+					h+=node.height.getValue(vInd+xDim+1);
+					w+=Scalar(1);
+					}
+				Vertex::Color c=Vertex::Color(cm->mapColor(hOffset+h*hScale/w));
 				for(int i=0;i<4;++i)
-					vPtr[i]=v[i];
+					v[i].color=c;
 				}
 			}
+		else
+			{
+			for(int i=0;i<4;++i)
+				v[i].color=Vertex::Color(255,255,255);
+			}
+		
+		/* Set the corner normal vectors and vertex positions of the current quad: */
+		if(node.normalPerVertex.getValue())
+			{
+			v[0].normal=Vertex::Normal(vertexNormals[vInd]);
+			v[1].normal=Vertex::Normal(vertexNormals[vInd+1]);
+			v[2].normal=Vertex::Normal(vertexNormals[vInd+xDim+1]);
+			v[3].normal=Vertex::Normal(vertexNormals[vInd+xDim]);
+			}
+		else
+			{
+			Vertex::Normal n=Vertex::Normal(quadNormals[qInd]);
+			for(int i=0;i<4;++i)
+				v[i].normal=n;
+			}
+		v[0].position=Vertex::Position(vertices[vInd]);
+		v[1].position=Vertex::Position(vertices[vInd+1]);
+		v[2].position=Vertex::Position(vertices[vInd+xDim+1]);
+		v[3].position=Vertex::Position(vertices[vInd+xDim]);
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	QuadVertexWriter(const ElevationGridNode& sNode,const Point* sVertices,const Vector* sVertexNormals,const Vector* sQuadNormals,const TexCoord* sVertexTexCoords,const int* sQuadCases,const size_t* sRowQuadOffsets,const size_t* sRowTriangleOffsets,Vertex* sQuadVertices)
+		:node(sNode),vertices(sVertices),vertexNormals(sVertexNormals),quadNormals(sQuadNormals),vertexTexCoords(sVertexTexCoords),
+		 quadCases(sQuadCases),rowQuadOffsets(sRowQuadOffsets),rowTriangleOffsets(sRowTriangleOffsets),
+		 quadVertices(sQuadVertices)
+		{
+		}
+	
+	/* Methods: */
+	void operator()(size_t zBegin,size_t zEnd)
+		{
+		int xDim=node.xDimension.getValue();
+		bool ccw=node.ccw.getValue();
+		if(quadCases==0)
+			{
+			/* Store the corner vertices of all quads in the row block: */
+			Vertex* vPtr=quadVertices+zBegin*(xDim-1)*4;
+			for(int z=int(zBegin);z<int(zEnd);++z)
+				for(int x=0;x<xDim-1;++x,vPtr+=4)
+					{
+					Vertex v[4];
+					calcCorners(x,z,v);
+					if(ccw)
+						{
+						/* Store the corner vertices in counter-clockwise order: */
+						for(int i=0;i<4;++i)
+							vPtr[i]=v[3-i];
+						}
+					else
+						{
+						/* Store the corner vertices in clockwise order: */
+						for(int i=0;i<4;++i)
+							vPtr[i]=v[i];
+						}
+					}
+			}
+		else
+			{
+			/* Start storing quads and triangles where the row block's first row's quads and triangles go: */
+			Vertex* qvPtr=quadVertices+rowQuadOffsets[zBegin];
+			Vertex* tvPtr=quadVertices+rowTriangleOffsets[zBegin];
+			const int* qcPtr=quadCases+zBegin*(xDim-1);
+			for(int z=int(zBegin);z<int(zEnd);++z)
+				for(int x=0;x<xDim-1;++x,++qcPtr)
+					{
+					/* Skip grid cells that are entirely removed: */
+					if(*qcPtr!=0x7&&*qcPtr!=0xb&&*qcPtr!=0xd&&*qcPtr!=0xe&&*qcPtr!=0xf)
+						continue;
+					
+					Vertex v[4];
+					calcCorners(x,z,v);
+					
+					/* Store the corner vertices of the current grid cell depending on the cell's triangulation case: */
+					if(ccw)
+						{
+						/* Store the corner vertices in counter-clockwise order: */
+						switch(*qcPtr)
+							{
+							case 0x7:
+								tvPtr[0]=v[3];
+								tvPtr[1]=v[1];
+								tvPtr[2]=v[0];
+								tvPtr+=3;
+								break;
+							
+							case 0xb:
+								tvPtr[0]=v[2];
+								tvPtr[1]=v[1];
+								tvPtr[2]=v[0];
+								tvPtr+=3;
+								break;
+							
+							case 0xd:
+								tvPtr[0]=v[3];
+								tvPtr[1]=v[2];
+								tvPtr[2]=v[0];
+								tvPtr+=3;
+								break;
+							
+							case 0xe:
+								tvPtr[0]=v[3];
+								tvPtr[1]=v[2];
+								tvPtr[2]=v[1];
+								tvPtr+=3;
+								break;
+							
+							case 0xf:
+								for(int i=0;i<4;++i)
+									qvPtr[i]=v[3-i];
+								qvPtr+=4;
+							}
+						}
+					else
+						{
+						/* Store the corner vertices in clockwise order: */
+						switch(*qcPtr)
+							{
+							case 0x7:
+								tvPtr[0]=v[0];
+								tvPtr[1]=v[1];
+								tvPtr[2]=v[3];
+								tvPtr+=3;
+								break;
+							
+							case 0xb:
+								tvPtr[0]=v[0];
+								tvPtr[1]=v[1];
+								tvPtr[2]=v[2];
+								tvPtr+=3;
+								break;
+							
+							case 0xd:
+								tvPtr[0]=v[0];
+								tvPtr[1]=v[2];
+								tvPtr[2]=v[3];
+								tvPtr+=3;
+								break;
+							
+							case 0xe:
+								tvPtr[0]=v[1];
+								tvPtr[1]=v[2];
+								tvPtr[2]=v[3];
+								tvPtr+=3;
+								break;
+							
+							case 0xf:
+								for(int i=0;i<4;++i)
+									qvPtr[i]=v[i];
+								qvPtr+=4;
+							}
+						}
+					}
+			}
+		}
+	};
+
+}
+
+/**********************************
+Methods of class ElevationGridNode:
+**********************************/
+
+Point* ElevationGridNode::calcVertices(void) const
+	{
+	/* Allocate the result array: */
+	int xDim=xDimension.getValue();
+	int zDim=zDimension.getValue();
+	Point* vertices=new Point[zDim*xDim];
+	
+	/* Calculate all vertex positions in parallel blocks of rows: */
+	VertexCalculator calculator(*this,vertices);
+	Threads::TaskPool::getSharedPool().processRange(0,zDim,minRowBlockSize,calculator);
+	
+	return vertices;
+	}
+
+Vector* ElevationGridNode::calcQuadNormals(void) const
+	{
+	/* Allocate the result array: */
+	int xDim=xDimension.getValue();
+	int zDim=zDimension.getValue();
+	Vector* normals=new Vector[(zDim-1)*(xDim-1)];
 	
-	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+	/* Calculate all quad normal vectors in parallel blocks of rows: */
+	QuadNormalCalculator calculator(*this,0,normals);
+	Threads::TaskPool::getSharedPool().processRange(0,zDim-1,minRowBlockSize,calculator);
+	
+	return normals;
+	}
+
+int* ElevationGridNode::calcHoleyQuadCases(GLuint& numQuads,GLuint& numTriangles) const
+	{
+	/* Allocate the result array: */
+	int xDim=xDimension.getValue();
+	int zDim=zDimension.getValue();
+	int* quadCases=new int[(zDim-1)*(xDim-1)];
+	
+	/* Calculate the triangulation cases for all grid cells in parallel blocks of rows: */
+	numQuads=0;
+	numTriangles=0;
+	HoleyQuadCaseCalculator calculator(*this,quadCases,numQuads,numTriangles);
+	Threads::TaskPool::getSharedPool().processRange(0,zDim-1,minRowBlockSize,calculator);
+	
+	return quadCases;
+	}
+
+Vector* ElevationGridNode::calcHoleyQuadNormals(const int* quadCases) const
+	{
+	/* Allocate the result array: */
+	int xDim=xDimension.getValue();
+	int zDim=zDimension.getValue();
+	Vector* normals=new Vector[(zDim-1)*(xDim-1)];
+	
+	/* Calculate all quad normal vectors in parallel blocks of rows: */
+	QuadNormalCalculator calculator(*this,quadCases,normals);
+	Threads::TaskPool::getSharedPool().processRange(0,zDim-1,minRowBlockSize,calculator);
+	
+	return normals;
+	}
+
+void ElevationGridNode::calcIndexedQuadStripVertices(ElevationGridNode::Vertex* vertices) const
+	{
+	/* Calculate all per-quad normal vectors if there are no explicit normals: */
+	Vector* quadNormals=0;
+	if(normal.getValue()==0)
+		quadNormals=calcQuadNormals();
 	
-	/* Delete the per-quad and per-vertex normals, texture coordinates, and vertex positions: */
+	/* Store all vertices in parallel blocks of rows: */
+	IndexedQuadStripVertexWriter writer(*this,quadNormals,vertices);
+	Threads::TaskPool::getSharedPool().processRange(0,zDimension.getValue(),minRowBlockSize,writer);
+	
+	/* Delete the per-quad normals: */
 	delete[] quadNormals;
-	delete[] vertexNormals;
-	delete[] vertexTexCoords;
-	delete[] vertices;
 	}
 
-void ElevationGridNode::uploadHoleyQuadTriangleSet(GLuint& numQuads,GLuint& numTriangles) const
+void ElevationGridNode::calcIndexedQuadStripIndices(GLuint* indices) const
+	{
+	/* Store all vertex indices in parallel blocks of rows: */
+	IndexedQuadStripIndexWriter writer(*this,indices);
+	Threads::TaskPool::getSharedPool().processRange(0,zDimension.getValue()-1,minRowBlockSize,writer);
+	}
+
+void ElevationGridNode::calcQuadVertices(const int* quadCases,GLuint numQuads,ElevationGridNode::Vertex* quadVertices) const
 	{
-	/* Define the vertex type used in the vertex array: */
-	typedef GLGeometry::Vertex<Scalar,2,GLubyte,4,Scalar,Scalar,3> Vertex;
+	Threads::TaskPool& taskPool=Threads::TaskPool::getSharedPool();
 	
 	/* Retrieve the elevation grid layout: */
 	int xDim=xDimension.getValue();
@@ -769,9 +1071,6 @@ void ElevationGridNode::uploadHoleyQuadTriangleSet(GLuint& numQuads,GLuint& numT
 	/* Calculate all untransformed vertex positions: */
 	Point* vertices=calcVertices();
 	
-	/* Calculate the triangulation cases for all grid quads: */
-	int* quadCases=calcHoleyQuadCases(numQuads,numTriangles);
-	
 	/* Calculate all per-quad or per-vertex normal vectors if there are no explicit normals: */
 	Vector* quadNormals=0;
 	Vector* vertexNormals=0;
@@ -801,81 +1100,21 @@ void ElevationGridNode::uploadHoleyQuadTriangleSet(GLuint& numQuads,GLuint& numT
 		else
 			{
 			/* Calculate the per-quad normals: */
-			quadNormals=calcHoleyQuadNormals(quadCases);
+			quadNormals=quadCases!=0?calcHoleyQuadNormals(quadCases):calcQuadNormals();
 			
 			/* Convert the per-quad normals to non-normalized per-vertex normals: */
 			vertexNormals=new Vector[zDim*xDim];
-			MF<Scalar>::ValueList::const_iterator hIt=height.getValues().begin();
-			Vector* vnPtr=vertexNormals;
-			for(int z=0;z<zDim;++z)
-				for(int x=0;x<xDim;++x,++hIt,++vnPtr)
-					if(*hIt!=invalidHeight.getValue())
-						{
-						*vnPtr=Vector::zero;
-						int* qc=quadCases+(z*(xDim-1)+x);
-						Vector* qn=quadNormals+(z*(xDim-1)+x);
-						
-						/* Add each surrounding quad's normal 0, 1, or 2 times depending on the respective quad's triangulation case: */
-						if(x>0)
-							{
-							if(z>0)
-								{
-								if((qc[-(xDim-1)-1]&0xa)==0xa)
-									*vnPtr+=qn[-(xDim-1)-1];
-								if((qc[-(xDim-1)-1]&0xc)==0xc)
-									*vnPtr+=qn[-(xDim-1)-1];
-								}
-							if(z<zDim-1)
-								{
-								if((qc[-1]&0x3)==0x3)
-									*vnPtr+=qn[-1];
-								if((qc[-1]&0xa)==0xa)
-									*vnPtr+=qn[-1];
-								}
-							}
-						if(x<xDim-1)
-							{
-							if(z>0)
-								{
-								if((qc[-(xDim-1)]&0x5)==0x5)
-									*vnPtr+=qn[-(xDim-1)];
-								if((qc[-(xDim-1)]&0xc)==0xc)
-									*vnPtr+=qn[-(xDim-1)];
-								}
-							if(z<zDim-1)
-								{
-								if((qc[0]&0x3)==0x3)
-									*vnPtr+=qn[0];
-								if((qc[0]&0x5)==0x5)
-									*vnPtr+=qn[0];
-								}
-							}
-						}
+			VertexNormalCalculator calculator(*this,quadCases,quadNormals,vertexNormals);
+			taskPool.processRange(0,zDim,minRowBlockSize,calculator);
 			
 			/* Delete the per-quad normals: */
 			delete[] quadNormals;
 			quadNormals=0;
 			}
 		
-		if(pointTransform.getValue()!=0)
-			{
-			/* Transform the per-vertex normals: */
-			MF<Scalar>::ValueList::const_iterator hIt=height.getValues().begin();
-			Point* vPtr=vertices;
-			Vector* vnPtr=vertexNormals;
-			for(int i=zDim*xDim;i>0;--i,++hIt,++vPtr,++vnPtr)
-				if(*hIt!=invalidHeight.getValue())
-					*vnPtr=pointTransform.getValue()->transformNormal(*vPtr,*vnPtr);
-			}
-		else
-			{
-			/* Normalize the per-vertex normals: */
-			MF<Scalar>::ValueList::const_iterator hIt=height.getValues().begin();
-			Vector* vnPtr=vertexNormals;
-			for(int i=zDim*xDim;i>0;--i,++hIt,++vnPtr)
-				if(*hIt!=invalidHeight.getValue())
-					vnPtr->normalize();
-			}
+		/* Transform or normalize the per-vertex normals: */
+		VertexNormalFinisher finisher(*this,vertices,vertexNormals,quadCases!=0);
+		taskPool.processRange(0,zDim,minRowBlockSize,finisher);
 		}
 	else
 		{
@@ -903,295 +1142,104 @@ void ElevationGridNode::uploadHoleyQuadTriangleSet(GLuint& numQuads,GLuint& numT
 		else
 			{
 			/* Calculate the per-quad normals: */
-			quadNormals=calcHoleyQuadNormals(quadCases);
+			quadNormals=quadCases!=0?calcHoleyQuadNormals(quadCases):calcQuadNormals();
 			}
 		
-		if(pointTransform.getValue()!=0)
-			{
-			/* Transform the per-quad normals: */
-			int* qcPtr=quadCases;
-			Vector* qnPtr=quadNormals;
-			for(int z=0;z<zDim-1;++z)
-				for(int x=0;x<xDim-1;++x,++qcPtr,++qnPtr)
-					{
-					/* Transform the per-quad normal around the quad's midpoint: */
-					Point* vPtr=vertices+(z*xDim+x);
-					Point mp;
-					switch(*qcPtr)
-						{
-						case 0x7:
-							for(int i=0;i<3;++i)
-								mp[i]=(vPtr[0][i]+vPtr[1][i]+vPtr[xDim][i])/Scalar(3);
-							*qnPtr=pointTransform.getValue()->transformNormal(mp,*qnPtr);
-							break;
-						
-						case 0xb:
-							for(int i=0;i<3;++i)
-								mp[i]=(vPtr[0][i]+vPtr[1][i]+vPtr[xDim+1][i])/Scalar(3);
-							*qnPtr=pointTransform.getValue()->transformNormal(mp,*qnPtr);
-							break;
-						
-						case 0xd:
-							for(int i=0;i<3;++i)
-								mp[i]=(vPtr[0][i]+vPtr[xDim][i]+vPtr[xDim+1][i])/Scalar(3);
-							*qnPtr=pointTransform.getValue()->transformNormal(mp,*qnPtr);
-							break;
-						
-						case 0xe:
-							for(int i=0;i<3;++i)
-								mp[i]=(vPtr[1][i]+vPtr[xDim][i]+vPtr[xDim+1][i])/Scalar(3);
-							*qnPtr=pointTransform.getValue()->transformNormal(mp,*qnPtr);
-							break;
-						
-						case 0xf:
-							for(int i=0;i<3;++i)
-								mp[i]=(vPtr[0][i]+vPtr[1][i]+vPtr[xDim][i]+vPtr[xDim+1][i])*Scalar(0.25);
-							*qnPtr=pointTransform.getValue()->transformNormal(mp,*qnPtr);
-							break;
-						}
-					}
-			}
-		else
-			{
-			/* Normalize the per-quad normals: */
-			Vector* qnPtr=quadNormals;
-			for(int i=(zDim-1)*(xDim-1);i>0;--i,++qnPtr)
-				qnPtr->normalize();
-			}
+		/* Transform or normalize the per-quad normals: */
+		QuadNormalFinisher finisher(*this,vertices,quadCases,quadNormals);
+		taskPool.processRange(0,zDim-1,minRowBlockSize,finisher);
 		}
 	
+	/* Calculate per-vertex texture coordinates if there is an image projection, and transform all vertex positions: */
 	TexCoord* vertexTexCoords=0;
 	if(imageProjection.getValue()!=0)
-		{
-		/* Calculate per-vertex texture coordinates: */
 		vertexTexCoords=new TexCoord[xDim*zDim];
-		Point* vPtr=vertices;
-		TexCoord* vtcPtr=vertexTexCoords;
-		for(int z=0;z<zDim;++z)
-			for(int x=0;x<xDim;++x,++vPtr,++vtcPtr)
-				*vtcPtr=imageProjection.getValue()->calcTexCoord(*vPtr);
-		}
-	
-	if(pointTransform.getValue()!=0)
+	if(vertexTexCoords!=0||pointTransform.getValue()!=0)
 		{
-		/* Transform all vertex positions: */
-		MF<Scalar>::ValueList::const_iterator hIt=height.getValues().begin();
-		Point* vPtr=vertices;
-		for(int i=zDim*xDim;i>0;--i,++hIt,++vPtr)
-			if(*hIt!=invalidHeight.getValue())
-				*vPtr=pointTransform.getValue()->transformPoint(*vPtr);
+		VertexFinisher finisher(*this,vertices,vertexTexCoords,quadCases!=0);
+		taskPool.processRange(0,zDim,minRowBlockSize,finisher);
 		}
 	
-	/* Initialize the vertex buffer object: */
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB,(numQuads*4+numTriangles*3)*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
-	
-	/* Store all vertices: */
-	int hComp=heightIsY.getValue()?1:2;
-	Scalar hOffset=origin.getValue()[hComp];
-	Vertex* qvPtr=static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB));
-	Vertex* tvPtr=qvPtr+(numQuads*4);
-	size_t qInd=0;
-	for(int z=0;z<zDim-1;++z)
-		for(int x=0;x<xDim-1;++x,++qInd)
+	/* Calculate where each row's quads and triangles go if there are invalid samples: */
+	size_t* rowQuadOffsets=0;
+	size_t* rowTriangleOffsets=0;
+	if(quadCases!=0)
+		{
+		rowQuadOffsets=new size_t[zDim-1];
+		rowTriangleOffsets=new size_t[zDim-1];
+		RowPrimitiveCounter counter(*this,quadCases,rowQuadOffsets,rowTriangleOffsets);
+		taskPool.processRange(0,zDim-1,minRowBlockSize,counter);
+		
+		/* Convert the per-row counts to vertex offsets; quads go first, followed by triangles: */
+		size_t quadOffset=0;
+		size_t triangleOffset=size_t(numQuads)*4;
+		for(int z=0;z<zDim-1;++z)
 			{
-			size_t vInd=z*xDim+x;
-			Vertex v[4];
-			
-			/* Calculate the corner texture coordinates of the current quad: */
-			if(imageProjection.getValue()!=0)
-				{
-				/* Store the per-vertex texture coordinates: */
-				v[0].texCoord=vertexTexCoords[vInd];
-				v[1].texCoord=vertexTexCoords[vInd+1];
-				v[2].texCoord=vertexTexCoords[vInd+xDim+1];
-				v[3].texCoord=vertexTexCoords[vInd+xDim];
-				}
-			else if(texCoord.getValue()!=0)
-				{
-				v[0].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd));
-				v[1].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd+1));
-				v[2].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd+xDim+1));
-				v[3].texCoord=Vertex::TexCoord(texCoord.getValue()->point.getValue(vInd+xDim));
-				}
-			else
-				{
-				v[0].texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
-				v[1].texCoord=Vertex::TexCoord(Scalar(x+1)/Scalar(xDim-1),Scalar(z)/Scalar(zDim-1));
-				v[2].texCoord=Vertex::TexCoord(Scalar(x+1)/Scalar(xDim-1),Scalar(z+1)/Scalar(zDim-1));
-				v[3].texCoord=Vertex::TexCoord(Scalar(x)/Scalar(xDim-1),Scalar(z+1)/Scalar(zDim-1));
-				}
-			
-			/* Get the corner colors of the current quad: */
-			if(color.getValue()!=0)
-				{
-				if(colorPerVertex.getValue())
-					{
-					v[0].color=Vertex::Color(color.getValue()->color.getValue(vInd));
-					v[1].color=Vertex::Color(color.getValue()->color.getValue(vInd+1));
-					v[2].color=Vertex::Color(color.getValue()->color.getValue(vInd+xDim+1));
-					v[3].color=Vertex::Color(color.getValue()->color.getValue(vInd+xDim));
-					}
-				else
-					{
-					Vertex::Color c=Vertex::Color(color.getValue()->color.getValue(qInd));
-					for(int i=0;i<4;++i)
-						v[i].color=c;
-					}
-				}
-			else if(colorMap.getValue()!=0)
-				{
-				if(colorPerVertex.getValue())
-					{
-					v[0].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd)*heightScale.getValue()));
-					v[1].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd+1)*heightScale.getValue()));
-					v[2].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd+xDim+1)*heightScale.getValue()));
-					v[3].color=Vertex::Color(colorMap.getValue()->mapColor(hOffset+height.getValue(vInd+xDim)*heightScale.getValue()));
-					}
-				else
-					{
-					Scalar h=Scalar(0);
-					Scalar w=Scalar(0);
-					if(quadCases[qInd]&0x1)
-						{
-						h+=height.getValue(vInd);
-						w+=Scalar(1);
-						}
-					if(quadCases[qInd]&0x2)
-						{
-						h+=height.getValue(vInd+1);
-						w+=Scalar(1);
-						}
-					if(quadCases[qInd]&0x4)
-						{
-						h+=height.getValue(vInd+xDim);
-						w+=Scalar(1);
-						}
-					if(quadCases[qInd]&0x8)
-						{
-						h+=height.getValue(vInd+xDim+1);
-						w+=Scalar(1);
-						}
-					Vertex::Color c=Vertex::Color(colorMap.getValue()->mapColor(hOffset+h*heightScale.getValue()/w));
-					for(int i=0;i<4;++i)
-						v[i].color=c;
-					}
-				}
-			else
-				{
-				for(int i=0;i<4;++i)
-					v[i].color=Vertex::Color(255,255,255);
-				}
-			
-			/* Set the corner normal vectors and vertex positions of the current quad: */
-			if(normalPerVertex.getValue())
-				{
-				v[0].normal=Vertex::Normal(vertexNormals[vInd]);
-				v[1].normal=Vertex::Normal(vertexNormals[vInd+1]);
-				v[2].normal=Vertex::Normal(vertexNormals[vInd+xDim+1]);
-				v[3].normal=Vertex::Normal(vertexNormals[vInd+xDim]);
-				}
-			else
-				{
-				Vertex::Normal n=Vertex::Normal(quadNormals[qInd]);
-				for(int i=0;i<4;++i)
-					v[i].normal=n;
-				}
-			v[0].position=Vertex::Position(vertices[vInd]);
-			v[1].position=Vertex::Position(vertices[vInd+1]);
-			v[2].position=Vertex::Position(vertices[vInd+xDim+1]);
-			v[3].position=Vertex::Position(vertices[vInd+xDim]);
-			
-			/* Store the corner vertices of the current grid cell depending on the cell's triangulation case: */
-			if(ccw.getValue())
-				{
-				/* Store the corner vertices in counter-clockwise order: */
-				switch(quadCases[qInd])
-					{
-					case 0x7:
-						tvPtr[0]=v[3];
-						tvPtr[1]=v[1];
-						tvPtr[2]=v[0];
-						tvPtr+=3;
-						break;
-					
-					case 0xb:
-						tvPtr[0]=v[2];
-						tvPtr[1]=v[1];
-						tvPtr[2]=v[0];
-						tvPtr+=3;
-						break;
-					
-					case 0xd:
-						tvPtr[0]=v[3];
-						tvPtr[1]=v[2];
-						tvPtr[2]=v[0];
-						tvPtr+=3;
-						break;
-					
-					case 0xe:
-						tvPtr[0]=v[3];
-						tvPtr[1]=v[2];
-						tvPtr[2]=v[1];
-						tvPtr+=3;
-						break;
-					
-					case 0xf:
-						for(int i=0;i<4;++i)
-							qvPtr[i]=v[3-i];
-						qvPtr+=4;
-					}
-				}
-			else
-				{
-				/* Store the corner vertices in clockwise order: */
-				switch(quadCases[qInd])
-					{
-					case 0x7:
-						tvPtr[0]=v[0];
-						tvPtr[1]=v[1];
-						tvPtr[2]=v[3];
-						tvPtr+=3;
-						break;
-					
-					case 0xb:
-						tvPtr[0]=v[0];
-						tvPtr[1]=v[1];
-						tvPtr[2]=v[2];
-						tvPtr+=3;
-						break;
-					
-					case 0xd:
-						tvPtr[0]=v[0];
-						tvPtr[1]=v[2];
-						tvPtr[2]=v[3];
-						tvPtr+=3;
-						break;
-					
-					case 0xe:
-						tvPtr[0]=v[1];
-						tvPtr[1]=v[2];
-						tvPtr[2]=v[3];
-						tvPtr+=3;
-						break;
-					
-					case 0xf:
-						for(int i=0;i<4;++i)
-							qvPtr[i]=v[i];
-						qvPtr+=4;
-					}
-				}
+			size_t rowNumQuads=rowQuadOffsets[z];
+			rowQuadOffsets[z]=quadOffset;
+			quadOffset+=rowNumQuads*4;
+			size_t rowNumTriangles=rowTriangleOffsets[z];
+			rowTriangleOffsets[z]=triangleOffset;
+			triangleOffset+=rowNumTriangles*3;
 			}
+		}
 	
-	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+	/* Store all vertices in parallel blocks of rows: */
+	QuadVertexWriter writer(*this,vertices,vertexNormals,quadNormals,vertexTexCoords,quadCases,rowQuadOffsets,rowTriangleOffsets,quadVertices);
+	taskPool.processRange(0,zDim-1,minRowBlockSize,writer);
 	
-	/* Delete the per-quad and per-vertex normals, the triangulation cases, texture coordinates, and the vertex positions: */
+	/* Delete the row offsets, per-quad and per-vertex normals, texture coordinates, and vertex positions: */
+	delete[] rowQuadOffsets;
+	delete[] rowTriangleOffsets;
 	delete[] quadNormals;
 	delete[] vertexNormals;
-	delete[] quadCases;
 	delete[] vertexTexCoords;
 	delete[] vertices;
 	}
 
+void ElevationGridNode::uploadIndexedQuadStripSet(void) const
+	{
+	/* Retrieve the elevation grid layout: */
+	int xDim=xDimension.getValue();
+	int zDim=zDimension.getValue();
+	
+	/* Initialize the vertex buffer object and store all vertices directly into it: */
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB,xDim*zDim*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
+	calcIndexedQuadStripVertices(static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB)));
+	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+	
+	/* Initialize the index buffer object and store all vertex indices directly into it: */
+	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB,(zDim-1)*xDim*2*sizeof(GLuint),0,GL_STATIC_DRAW_ARB);
+	calcIndexedQuadStripIndices(static_cast<GLuint*>(glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB)));
+	glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
+	}
+
+void ElevationGridNode::uploadQuadSet(void) const
+	{
+	/* Retrieve the elevation grid layout: */
+	int xDim=xDimension.getValue();
+	int zDim=zDimension.getValue();
+	
+	/* Initialize the vertex buffer object and store all vertices directly into it: */
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB,(xDim-1)*(zDim-1)*4*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
+	calcQuadVertices(0,0,static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB)));
+	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+	}
+
+void ElevationGridNode::uploadHoleyQuadTriangleSet(GLuint& numQuads,GLuint& numTriangles) const
+	{
+	/* Calculate the triangulation cases for all grid quads: */
+	int* quadCases=calcHoleyQuadCases(numQuads,numTriangles);
+	
+	/* Initialize the vertex buffer object and store all vertices directly into it: */
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB,(numQuads*4+numTriangles*3)*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
+	calcQuadVertices(quadCases,numQuads,static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB)));
+	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+	
+	/* Delete the triangulation cases: */
+	delete[] quadCases;
+	}
+
 ElevationGridNode::ElevationGridNode(void)
 	:colorPerVertex(true),normalPerVertex(true),
 	 creaseAngle(0),
@@ -1460,8 +1508,6 @@ void ElevationGridNode::glRenderAction(GLRenderState& renderState) const
 	/* Get the context data item: */
 	DataItem* dataItem=renderState.contextData.retrieveDataItem<DataItem>(this);
 	
-	typedef GLGeometry::Vertex<Scalar,2,GLubyte,4,Scalar,Scalar,3> Vertex;
-	
 	/* Bind the vertex buffer object: */
 	glBindBufferARB(GL_ARRAY_BUFFER_ARB,dataItem->vertexBufferObjectId);
 	
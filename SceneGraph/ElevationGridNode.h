@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include <GL/gl.h>
 #include <GL/GLObject.h>
+#include <GL/GLGeometryVertex.h>
 #include <SceneGraph/FieldTypes.h>
 #include <SceneGraph/GeometryNode.h>
 #include <SceneGraph/TextureCoordinateNode.h>
@@ -49,6 +50,7 @@ class ElevationGridNode:public GeometryNode,public GLObject
 	typedef SF<NormalNodePointer> SFNormalNode;
 	typedef SF<ColorMapNodePointer> SFColorMapNode;
 	typedef SF<ImageProjectionNodePointer> SFImageProjectionNode;
+	typedef GLGeometry::Vertex<Scalar,2,GLubyte,4,Scalar,Scalar,3> Vertex; // Type for vertices stored in vertex buffer objects
 	
 	/* Elements: */
 	
@@ -106,6 +108,9 @@ class ElevationGridNode:public GeometryNode,public GLObject
 	Vector* calcQuadNormals(void) const; // Returns a new-allocated array of non-normalized per-quad normal vectors
 	int* calcHoleyQuadCases(GLuint& numQuads,GLuint& numTriangles) const; // Returns a new-allocated array of quad triangulation cases
 	Vector* calcHoleyQuadNormals(const int* quadCases) const; // Returns a new-allocated array of non-normalized per-quad normal vectors with removal of invalid samples
+	void calcIndexedQuadStripVertices(Vertex* vertices) const; // Writes the xDim*zDim vertices of the elevation grid as a set of indexed quad strips into the given array
+	void calcIndexedQuadStripIndices(GLuint* indices) const; // Writes the (zDim-1)*xDim*2 vertex indices of the elevation grid as a set of indexed quad strips into the given array
+	void calcQuadVertices(const int* quadCases,GLuint numQuads,Vertex* quadVertices) const; // Writes the vertices of the elevation grid as a set of quads into the given array; if quad triangulation cases are given, writes numQuads quads followed by triangles with removal of invalid samples
 	void uploadIndexedQuadStripSet(void) const; // Uploads the elevation grid as a set of indexed quad strips
 	void uploadQuadSet(void) const; // Uploads the elevation grid as a set of quads
 	void uploadHoleyQuadTriangleSet(GLuint& numQuads,GLuint& numTriangles) const; // Uploads the elevation grid as a set of quads and triangles with removal of invalid samples; updates passed number of quads and triangles
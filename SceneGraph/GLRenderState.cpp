@@ -36,14 +36,17 @@ GLRenderState::GLRenderState(GLContextData& sContextData,const GLRenderState::DO
 	:contextData(sContextData),
 	 baseViewerPos(sBaseViewerPos),baseUpVector(sBaseUpVector),
 	 currentTransform(initialTransform),
+	 frameTime(-1.0),
+	 frustumCulling(false),numVisitedNodes(0),numCulledNodes(0),
 	 emissiveColor(0.0f,0.0f,0.0f)
 	{
+	/* Initialize the view frustum in eye coordinates from the current OpenGL context: */
+	glLoadIdentity();
+	baseFrustum.setFromGL();
+	
 	/* Install the initial transformation: */
 	glLoadMatrix(currentTransform);
 	
-	/* Initialize the view frustum from the current OpenGL context: */
-	baseFrustum.setFromGL();
-	
 	/* Initialize OpenGL state tracking elements: */
 	cullingEnabled=glIsEnabled(GL_CULL_FACE);
 	GLint tempCulledFace;
@@ -114,16 +117,17 @@ bool GLRenderState::doesBoxIntersectFrustum(const Box& box) const
 	/* Check the box against each frustum plane: */
 	for(int planeIndex=0;planeIndex<6;++planeIndex)
 		{
-		/* Get the frustum plane's normal vector: */
-		const Vector& normal=baseFrustum.getFrustumPlane(planeIndex).getNormal();
+		/* Get the frustum plane's normal vector, which points to the inside of the frustum: */
+		const Frustum::Plane& plane=baseFrustum.getFrustumPlane(planeIndex);
+		const Vector& normal=plane.getNormal();
 		
-		/* Find the point on the bounding box which is closest to the frustum plane: */
+		/* Find the point on the bounding box which is farthest inside the frustum plane: */
 		Point p;
 		for(int i=0;i<3;++i)
 			p[i]=normal*axis[i]>Scalar(0)?box.max[i]:box.min[i];
 		
-		/* Check if the point is inside the view frustum: */
-		if(!baseFrustum.getFrustumPlane(planeIndex).contains(currentTransform.transform(p)))
+		/* The box is outside the view frustum if that point is outside the frustum plane: */
+		if(normal*Point(currentTransform.transform(p))<plane.getOffset())
 			return false;
 		}
 	
@@ -45,10 +45,20 @@ class GLRenderState
 	/* Elements: */
 	GLContextData& contextData; // Context data of the current OpenGL context
 	private:
-	Frustum baseFrustum; // The rendering context's view frustum in initial model coordinates
-	Point baseViewerPos; // Viewer position in initial model coordinates
-	Vector baseUpVector; // Up vector in initial model coordinates
-	DOGTransform currentTransform; // Transformation from initial model coordinates to current model coordinates
+	Frustum baseFrustum; // The rendering context's view frustum in eye coordinates
+	Point baseViewerPos; // Viewer position in eye coordinates
+	Vector baseUpVector; // Up vector in eye coordinates
+	DOGTransform currentTransform; // Transformation from current model coordinates to eye coordinates
+	
+	/* Elements identifying the current rendering frame: */
+	public:
+	double frameTime; // Time stamp shared by all render passes of the same frame in different windows, eyes, or contexts; negative if unknown, in which case every render pass is treated as a new frame
+	
+	/* Elements controlling view frustum culling: */
+	public:
+	bool frustumCulling; // Flag whether group nodes skip rendering their children if the bounding boxes cached at their last update do not intersect the view frustum; disabled by default, as it requires updating all ancestors of changed nodes bottom-up
+	unsigned int numVisitedNodes; // Number of group nodes whose bounding boxes were checked against the view frustum
+	unsigned int numCulledNodes; // Number of group nodes whose children were not rendered because their bounding boxes were outside the view frustum
 	
 	/* Elements shadowing current OpenGL state: */
 	public:
@@ -76,6 +86,17 @@ class GLRenderState
 	DOGTransform pushTransform(const DOGTransform& deltaTransform); // Ditto, with a double-precision transformation
 	void popTransform(const DOGTransform& previousTransform); // Resets the matrix stack to the given transformation; must be result from previous pushTransform call
 	bool doesBoxIntersectFrustum(const Box& box) const; // Returns true if the given box in current model coordinates intersects the view frustum
+	bool isBoxVisible(const Box& box) // Returns true if a group node with the given bounding box in current model coordinates needs to render its children; updates the culling counters
+		{
+		++numVisitedNodes;
+		
+		/* Never cull boxes of unknown or infinite extent: */
+		if(!frustumCulling||box.isNull()||box.isFull()||doesBoxIntersectFrustum(box))
+			return true;
+		
+		++numCulledNodes;
+		return false;
+		}
 	
 	/* OpenGL state management methods: */
 	void enableCulling(GLenum newCulledFace); // Enables OpenGL face culling
@@ -118,25 +118,17 @@ void GeodeticToCartesianTransformNode::update(void)
 		ReferenceEllipsoidNode::Geoid::Frame frame=referenceEllipsoid.getValue()->getRE().geodeticToCartesianFrame(g);
 		transform=OGTransform(frame.getTranslation(),frame.getRotation(),referenceEllipsoid.getValue()->scale.getValue());
 		}
+	
+	/* Update the group node: */
+	GroupNode::update();
 	}
 
 Box GeodeticToCartesianTransformNode::calcBoundingBox(void) const
 	{
-	/* Return the explicit bounding box if there is one: */
-	if(haveExplicitBoundingBox)
-		return explicitBoundingBox;
-	else
-		{
-		/* Calculate the group's bounding box as the union of the transformed children's boxes: */
-		Box result=Box::empty;
-		for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
-			{
-			Box childBox=(*chIt)->calcBoundingBox();
-			childBox.transform(transform);
-			result.addBox(childBox);
-			}
-		return result;
-		}
+	/* Return the transformed bounding box of the children: */
+	Box result=calcChildrenBoundingBox();
+	result.transform(transform);
+	return result;
 	}
 
 void GeodeticToCartesianTransformNode::glRenderAction(GLRenderState& renderState) const
@@ -144,10 +136,11 @@ void GeodeticToCartesianTransformNode::glRenderAction(GLRenderState& renderState
 	/* Push the transformation onto the matrix stack: */
 	GLRenderState::DOGTransform previousTransform=renderState.pushTransform(transform);
 	
-	/* Call the render actions of all children in order: */
-	for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
-		(*chIt)->glRenderAction(renderState);
-		
+	/* Call the render actions of all children in order if the children's bounding box is inside the view frustum: */
+	if(renderState.isBoxVisible(boundingBox))
+		for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
+			(*chIt)->glRenderAction(renderState);
+	
 	/* Pop the transformation off the matrix stack: */
 	renderState.popTransform(previousTransform);
 	}
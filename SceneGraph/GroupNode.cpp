@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <string.h>
 #include <SceneGraph/EventTypes.h>
 #include <SceneGraph/VRMLFile.h>
+#include <SceneGraph/GLRenderState.h>
 
 namespace SceneGraph {
 
@@ -31,10 +32,29 @@ namespace SceneGraph {
 Methods of class GroupNode:
 **************************/
 
+Box GroupNode::calcChildrenBoundingBox(void) const
+	{
+	/* Return the explicit bounding box if there is one: */
+	if(haveExplicitBoundingBox)
+		return explicitBoundingBox;
+	
+	/* Calculate the union of the children's bounding boxes: */
+	Box result=Box::empty;
+	for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
+		result.addBox((*chIt)->calcBoundingBox());
+	return result;
+	}
+
+void GroupNode::updateBoundingBox(void)
+	{
+	boundingBox=calcChildrenBoundingBox();
+	}
+
 GroupNode::GroupNode(void)
 	:bboxCenter(Point::origin),
 	 bboxSize(Size(-1,-1,-1)),
-	 haveExplicitBoundingBox(false)
+	 haveExplicitBoundingBox(false),
+	 boundingBox(Box::empty)
 	{
 	}
 
@@ -142,25 +162,23 @@ void GroupNode::update(void)
 			}
 		explicitBoundingBox=Box(pmin,pmax);
 		}
+	
+	/* Cache the bounding box for view frustum culling: */
+	updateBoundingBox();
 	}
 
 Box GroupNode::calcBoundingBox(void) const
 	{
-	/* Return the explicit bounding box if there is one: */
-	if(haveExplicitBoundingBox)
-		return explicitBoundingBox;
-	else
-		{
-		/* Calculate the group's bounding box as the union of the children's boxes: */
-		Box result=Box::empty;
-		for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
-			result.addBox((*chIt)->calcBoundingBox());
-		return result;
-		}
+	/* Calculate the bounding box from the current state of the children, as they might have changed since the last update: */
+	return calcChildrenBoundingBox();
 	}
 
 void GroupNode::glRenderAction(GLRenderState& renderState) const
 	{
+	/* Bail out if the group's bounding box is outside the view frustum: */
+	if(!renderState.isBoxVisible(boundingBox))
+		return;
+	
 	/* Call the render actions of all children in order: */
 	for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
 		(*chIt)->glRenderAction(renderState);
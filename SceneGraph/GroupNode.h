@@ -53,6 +53,12 @@ class GroupNode:public GraphNode
 	protected:
 	bool haveExplicitBoundingBox; // Flag whether the node has an explicit bounding box
 	Box explicitBoundingBox; // The explicit bounding box, if it exists
+	Box boundingBox; // Bounding box of the node's children in the node's own coordinate system at the time of the last update; only used for view frustum culling
+	
+	/* Protected methods: */
+	protected:
+	Box calcChildrenBoundingBox(void) const; // Returns the explicit bounding box, or the union of the children's current bounding boxes
+	void updateBoundingBox(void); // Caches the bounding box of the node's children for view frustum culling
 	
 	/* Constructors and destructors: */
 	public:
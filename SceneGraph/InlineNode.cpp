@@ -52,10 +52,19 @@ void InlineNode::parseField(const char* fieldName,VRMLFile& vrmlFile)
 		{
 		vrmlFile.parseField(url);
 		
-		/* Load the external VRML file: */
 		std::string externalFileName=vrmlFile.getFullUrl(url.getValue(0));
-		SceneGraph::VRMLFile externalVrmlFile(externalFileName,Cluster::openFile(vrmlFile.getMultiplexer(),externalFileName.c_str()),vrmlFile.getNodeCreator(),vrmlFile.getMultiplexer());
-		externalVrmlFile.parse(this);
+		if(vrmlFile.getMultiplexer()==0&&vrmlFile.getAsyncInlineLoading())
+			{
+			/* Load the external VRML file in the background; its nodes are attached before the including VRML file is finished: */
+			vrmlFile.loadInline(this,externalFileName);
+			}
+		else
+			{
+			/* Load the external VRML file immediately, to read shared files in the same order on all cluster nodes: */
+			SceneGraph::VRMLFile externalVrmlFile(externalFileName,Cluster::openFile(vrmlFile.getMultiplexer(),externalFileName.c_str()),vrmlFile.getNodeCreator(),vrmlFile.getMultiplexer());
+			externalVrmlFile.setAsyncInlineLoading(vrmlFile.getAsyncInlineLoading());
+			externalVrmlFile.parse(this);
+			}
 		}
 	else
 		GroupNode::parseField(fieldName,vrmlFile);
@@ -63,6 +72,8 @@ void InlineNode::parseField(const char* fieldName,VRMLFile& vrmlFile)
 
 void InlineNode::update(void)
 	{
+	/* Update the group node: */
+	GroupNode::update();
 	}
 
 }
@@ -47,6 +47,8 @@ class InlineNode:public GroupNode
 	virtual void update(void);
 	};
 
+typedef Misc::Autopointer<InlineNode> InlineNodePointer;
+
 }
 
 #endif
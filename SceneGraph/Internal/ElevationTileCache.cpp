@@ -0,0 +1,545 @@
+/***********************************************************************
+ElevationTileCache - Class to page square tiles of a quadtree of
+progressively coarser resolution levels of an elevation grid stored in a
+BIL file, preparing tiles for rendering in a pool of background threads
+and keeping recently used tiles within a memory budget.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <SceneGraph/Internal/ElevationTileCache.h>
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdexcept>
+#include <algorithm>
+#include <Misc/ThrowStdErr.h>
+#include <Math/Math.h>
+#include <Cluster/OpenFile.h>
+
+namespace SceneGraph {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+template <class SampleParam>
+inline
+void
+readSamples(
+	IO::SeekableFile& bilFile,
+	const BILGridLayout& layout,
+	const std::vector<int>& columns,
+	const std::vector<int>& rows,
+	Scalar* heights) // Reads the elevation samples at the given columns and rows from a BIL file
+	{
+	/* Read the range of columns covered by the tile from each row: */
+	int columnBegin=columns.front();
+	size_t rowLength=size_t(columns.back()-columnBegin+1);
+	std::vector<SampleParam> rowBuffer(rowLength);
+	Scalar* hPtr=heights;
+	for(std::vector<int>::const_iterator rIt=rows.begin();rIt!=rows.end();++rIt)
+		{
+		/* BIL files store the grid's top row first: */
+		bilFile.setReadPosAbs(layout.rowBytes*IO::SeekableFile::Offset(layout.size[1]-1-*rIt)+IO::SeekableFile::Offset(columnBegin)*IO::SeekableFile::Offset(sizeof(SampleParam)));
+		bilFile.read(&rowBuffer[0],rowLength);
+		
+		/* Pick the tile's samples from the row: */
+		for(std::vector<int>::const_iterator cIt=columns.begin();cIt!=columns.end();++cIt,++hPtr)
+			*hPtr=Scalar(rowBuffer[*cIt-columnBegin]);
+		}
+	}
+
+}
+
+/*******************************************
+Methods of class ElevationTileCache::Tile:
+*******************************************/
+
+ElevationTileCache::Tile::Tile(const ElevationTileCache::TileKey& sKey,int sNumSamplesX,int sNumSamplesZ)
+	:key(sKey),
+	 vertices(0),indices(0),
+	 sampleSpacing(0)
+	{
+	numSamples[0]=sNumSamplesX;
+	numSamples[1]=sNumSamplesZ;
+	vertices=new Vertex[getNumVertices()];
+	indices=new GLuint[getNumIndices()];
+	}
+
+ElevationTileCache::Tile::~Tile(void)
+	{
+	delete[] vertices;
+	delete[] indices;
+	}
+
+/***********************************
+Methods of class ElevationTileCache:
+***********************************/
+
+IO::SeekableFilePtr ElevationTileCache::openBILFile(void) const
+	{
+	/* Open the BIL file locally; tiles are read asynchronously and can not be distributed over a multicast pipe: */
+	IO::SeekableFilePtr result(Cluster::openSeekableFile(0,bilFileName.c_str()));
+	result->setEndianness(layout.endianness);
+	return result;
+	}
+
+ElevationTileCache::Tile* ElevationTileCache::prepareTile(IO::SeekableFile& bilFile,const ElevationTileCache::TileKey& key) const
+	{
+	/* Calculate the columns and rows of the grid samples covered by the tile, with one extra sample on each side to calculate normal vectors: */
+	int stride=1<<key.level;
+	int extent=tileSize*stride;
+	int tileIndex[2];
+	tileIndex[0]=int(key.x);
+	tileIndex[1]=int(key.z);
+	std::vector<int> sampleIndices[2];
+	for(int i=0;i<2;++i)
+		{
+		int first=tileIndex[i]*extent;
+		int last=std::min(first+extent,layout.size[i]-1);
+		sampleIndices[i].push_back(std::max(first-stride,0));
+		for(int s=first;s<last;s+=stride)
+			sampleIndices[i].push_back(s);
+		sampleIndices[i].push_back(last);
+		sampleIndices[i].push_back(std::min(last+stride,layout.size[i]-1));
+		}
+	int ext[2];
+	for(int i=0;i<2;++i)
+		ext[i]=int(sampleIndices[i].size());
+	
+	/* Read the tile's elevation samples: */
+	std::vector<Scalar> heights(size_t(ext[0])*size_t(ext[1]));
+	if(layout.numBits==16)
+		readSamples<signed short int>(bilFile,layout,sampleIndices[0],sampleIndices[1],&heights[0]);
+	else
+		readSamples<float>(bilFile,layout,sampleIndices[0],sampleIndices[1],&heights[0]);
+	
+	/* Calculate the range of valid elevations and replace invalid samples with the minimum: */
+	Scalar hMin(0),hMax(0);
+	bool haveValid=false;
+	for(std::vector<Scalar>::iterator hIt=heights.begin();hIt!=heights.end();++hIt)
+		if(!layout.haveNodata||*hIt!=layout.nodata)
+			{
+			if(!haveValid)
+				{
+				hMin=hMax=*hIt;
+				haveValid=true;
+				}
+			else if(hMin>*hIt)
+				hMin=*hIt;
+			else if(hMax<*hIt)
+				hMax=*hIt;
+			}
+	if(layout.haveNodata)
+		for(std::vector<Scalar>::iterator hIt=heights.begin();hIt!=heights.end();++hIt)
+			if(*hIt==layout.nodata)
+				*hIt=hMin;
+	
+	/* Calculate the untransformed positions of all samples: */
+	int hComp=2;
+	int zComp=1;
+	if(heightIsY)
+		std::swap(hComp,zComp);
+	std::vector<Point> points(heights.size());
+	std::vector<Point>::iterator pIt=points.begin();
+	std::vector<Scalar>::const_iterator hIt=heights.begin();
+	for(int z=0;z<ext[1];++z)
+		{
+		Point p;
+		p[zComp]=origin[zComp]+Scalar(sampleIndices[1][z])*layout.cellSize[1];
+		for(int x=0;x<ext[0];++x,++pIt,++hIt)
+			{
+			p[0]=origin[0]+Scalar(sampleIndices[0][x])*layout.cellSize[0];
+			p[hComp]=origin[hComp]+*hIt*heightScale;
+			*pIt=p;
+			}
+		}
+	
+	/* Create the tile: */
+	int nx=ext[0]-2;
+	int nz=ext[1]-2;
+	Tile* result=new Tile(key,nx,nz);
+	
+	/* Calculate the tile's grid vertices: */
+	Scalar texScale[2];
+	for(int i=0;i<2;++i)
+		texScale[i]=Scalar(1)/Scalar(layout.size[i]-1);
+	const PointTransformNode* pt=pointTransform.getPointer();
+	const ColorMapNode* cm=colorMap.getPointer();
+	Vertex* vPtr=result->vertices;
+	for(int z=1;z<=nz;++z)
+		for(int x=1;x<=nx;++x,++vPtr)
+			{
+			size_t index=size_t(z)*size_t(ext[0])+size_t(x);
+			const Point& p=points[index];
+			
+			/* Calculate the vertex normal from the central differences of the neighboring sample positions: */
+			Vector n=(points[index+ext[0]]-points[index-ext[0]])^(points[index+1]-points[index-1]);
+			if(!ccw)
+				n=-n;
+			
+			vPtr->texCoord=Vertex::TexCoord(Scalar(sampleIndices[0][x])*texScale[0],Scalar(sampleIndices[1][z])*texScale[1]);
+			if(cm!=0)
+				vPtr->color=Vertex::Color(cm->mapColor(origin[hComp]+heights[index]*heightScale));
+			else
+				vPtr->color=Vertex::Color(255,255,255);
+			if(pt!=0)
+				{
+				vPtr->normal=Vertex::Normal(pt->transformNormal(p,n));
+				vPtr->position=Vertex::Position(pt->transformPoint(p));
+				}
+			else
+				{
+				n.normalize();
+				vPtr->normal=Vertex::Normal(n);
+				vPtr->position=Vertex::Position(p);
+				}
+			}
+	
+	/* Create skirt vertices hanging down from the tile's edges to hide cracks between tiles of different resolution levels: */
+	Scalar skirtDepth=(hMax-hMin)*Math::abs(heightScale);
+	Scalar minSkirtDepth=Scalar(stride)*std::max(layout.cellSize[0],layout.cellSize[1]);
+	if(skirtDepth<minSkirtDepth)
+		skirtDepth=minSkirtDepth;
+	const int edgeStarts[4][2]={{1,1},{1,nz},{1,1},{nx,1}};
+	const int edgeSteps[4][2]={{1,0},{1,0},{0,1},{0,1}};
+	for(int edge=0;edge<4;++edge)
+		{
+		int edgeLength=edge<2?nx:nz;
+		for(int i=0;i<edgeLength;++i,++vPtr)
+			{
+			int x=edgeStarts[edge][0]+i*edgeSteps[edge][0];
+			int z=edgeStarts[edge][1]+i*edgeSteps[edge][1];
+			
+			/* Copy the edge vertex and lower its untransformed position: */
+			*vPtr=result->vertices[(z-1)*nx+(x-1)];
+			Point p=points[size_t(z)*size_t(ext[0])+size_t(x)];
+			p[hComp]-=skirtDepth;
+			if(pt!=0)
+				vPtr->position=Vertex::Position(pt->transformPoint(p));
+			else
+				vPtr->position=Vertex::Position(p);
+			}
+		}
+	
+	/* Calculate the tile's bounding box: */
+	result->box=Box::empty;
+	size_t numVertices=result->getNumVertices();
+	for(size_t i=0;i<numVertices;++i)
+		result->box.addPoint(result->vertices[i].position);
+	
+	/* Estimate the distance between neighboring vertices: */
+	const Vertex* v=result->vertices;
+	Scalar xSpacing=Scalar(Geometry::dist(v[0].position,v[nx-1].position))/Scalar(nx-1);
+	Scalar zSpacing=Scalar(Geometry::dist(v[0].position,v[(nz-1)*nx].position))/Scalar(nz-1);
+	result->sampleSpacing=std::max(xSpacing,zSpacing);
+	
+	/* Create the vertex indices of the tile's quad strips: */
+	GLuint* iPtr=result->indices;
+	for(int z=0;z<nz-1;++z)
+		for(int x=0;x<nx;++x,iPtr+=2)
+			{
+			if(ccw)
+				{
+				iPtr[0]=GLuint(z*nx+x);
+				iPtr[1]=GLuint((z+1)*nx+x);
+				}
+			else
+				{
+				iPtr[0]=GLuint((z+1)*nx+x);
+				iPtr[1]=GLuint(z*nx+x);
+				}
+			}
+	
+	/* Create the vertex indices of the tile's skirt strips: */
+	GLuint skirtIndex=GLuint(nx*nz);
+	for(int edge=0;edge<4;++edge)
+		{
+		int edgeLength=edge<2?nx:nz;
+		for(int i=0;i<edgeLength;++i,iPtr+=2,++skirtIndex)
+			{
+			int x=edgeStarts[edge][0]+i*edgeSteps[edge][0];
+			int z=edgeStarts[edge][1]+i*edgeSteps[edge][1];
+			iPtr[0]=GLuint((z-1)*nx+(x-1));
+			iPtr[1]=skirtIndex;
+			}
+		}
+	
+	return result;
+	}
+
+void ElevationTileCache::evictTiles(void)
+	{
+	while(memorySize>memoryBudget)
+		{
+		/* Find the least recently used prepared tile that was not requested in the current or previous frame: */
+		TileMap::Iterator lruIt=tiles.end();
+		for(TileMap::Iterator tIt=tiles.begin();!tIt.isFinished();++tIt)
+			if(tIt->getDest().tile!=0&&tIt->getDest().lastUsed+1<frame&&(lruIt.isFinished()||lruIt->getDest().lastUsed>tIt->getDest().lastUsed))
+				lruIt=tIt;
+		if(lruIt.isFinished())
+			break;
+		
+		/* Evict the tile; tiles still held by the renderer are deleted once released: */
+		memorySize-=lruIt->getDest().tile->getMemorySize();
+		tiles.removeEntry(lruIt);
+		}
+	}
+
+void* ElevationTileCache::loaderThreadMethod(void)
+	{
+	/* Open a private handle to the BIL file: */
+	IO::SeekableFilePtr bilFile;
+	try
+		{
+		bilFile=openBILFile();
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Record the error for the cache's owner: */
+		Threads::Mutex::Lock cacheLock(cacheMutex);
+		lastError=std::string("Could not open BIL file ")+bilFileName+" due to exception "+err.what();
+		
+		/* Leave the requests to the other loader threads, or fail all requests if there are none: */
+		if(--numActiveThreads==0)
+			{
+			for(std::vector<TileKey>::iterator rIt=requests.begin();rIt!=requests.end();++rIt)
+				tiles.getEntry(*rIt).getDest().failed=true;
+			numFailedTiles+=(unsigned int)(requests.size());
+			requests.clear();
+			}
+		return 0;
+		}
+	
+	while(true)
+		{
+		/* Wait for the next request: */
+		TileKey key;
+		{
+		Threads::Mutex::Lock cacheLock(cacheMutex);
+		while(!shutdown&&requests.empty())
+			requestCond.wait(cacheMutex);
+		if(shutdown)
+			break;
+		
+		/* Pick the most recently requested tile, preferring coarser tiles: */
+		std::vector<TileKey>::iterator bestIt=requests.begin();
+		unsigned int bestLastUsed=tiles.getEntry(*bestIt).getDest().lastUsed;
+		for(std::vector<TileKey>::iterator rIt=bestIt+1;rIt!=requests.end();++rIt)
+			{
+			unsigned int lastUsed=tiles.getEntry(*rIt).getDest().lastUsed;
+			if(bestLastUsed<lastUsed||(bestLastUsed==lastUsed&&bestIt->level<rIt->level))
+				{
+				bestIt=rIt;
+				bestLastUsed=lastUsed;
+				}
+			}
+		key=*bestIt;
+		*bestIt=requests.back();
+		requests.pop_back();
+		}
+		
+		/* Prepare the tile without holding the cache lock: */
+		Tile* tile=0;
+		std::string error;
+		try
+			{
+			tile=prepareTile(*bilFile,key);
+			}
+		catch(const std::runtime_error& err)
+			{
+			/* Mark the tile as failed below: */
+			error=err.what();
+			}
+		catch(...)
+			{
+			/* Mark the tile as failed below: */
+			error="Unknown exception";
+			}
+		
+		/* Store the tile unless its request was discarded in the meantime: */
+		{
+		Threads::Mutex::Lock cacheLock(cacheMutex);
+		TileMap::Iterator tIt=tiles.findEntry(key);
+		if(!tIt.isFinished())
+			{
+			if(tile!=0)
+				{
+				tIt->getDest().tile=tile;
+				memorySize+=tile->getMemorySize();
+				evictTiles();
+				}
+			else
+				{
+				tIt->getDest().failed=true;
+				++numFailedTiles;
+				char keyString[64];
+				snprintf(keyString,sizeof(keyString),"%u/%u/%u",key.level,key.x,key.z);
+				lastError=std::string("Could not prepare tile ")+keyString+" from BIL file "+bilFileName+" due to exception "+error;
+				}
+			}
+		else
+			delete tile;
+		}
+		}
+	
+	return 0;
+	}
+
+ElevationTileCache::ElevationTileCache(const std::string& sBilFileName,const BILGridLayout& sLayout,const Point& sOrigin,Scalar sHeightScale,bool sHeightIsY,bool sCcw,ColorMapNode* sColorMap,PointTransformNode* sPointTransform,int sTileSize,size_t sMemoryBudget,unsigned int sNumThreads)
+	:bilFileName(sBilFileName),layout(sLayout),
+	 origin(sOrigin),heightScale(sHeightScale),heightIsY(sHeightIsY),ccw(sCcw),
+	 colorMap(sColorMap),pointTransform(sPointTransform),
+	 tileSize(sTileSize),rootLevel(0),
+	 memoryBudget(sMemoryBudget),
+	 tiles(1021),memorySize(0),frame(1),frameTime(-1.0),numFailedTiles(0),
+	 shutdown(false),numThreads(0),numActiveThreads(0),threads(0)
+	{
+	/* Check the grid and tile layout: */
+	if(layout.size[0]<2||layout.size[1]<2)
+		Misc::throwStdErr("SceneGraph::ElevationTileCache: File %s has invalid grid size",bilFileName.c_str());
+	if(tileSize<2)
+		tileSize=2;
+	
+	/* Find the resolution level where a single tile covers the entire grid: */
+	int maxCells=std::max(layout.size[0],layout.size[1])-1;
+	while((tileSize<<rootLevel)<maxCells)
+		++rootLevel;
+	
+	/* Prepare the root tile in the calling thread: */
+	IO::SeekableFilePtr bilFile=openBILFile();
+	rootTile=prepareTile(*bilFile,TileKey(rootLevel,0,0));
+	
+	/* Start the loader threads: */
+	numThreads=sNumThreads;
+	if(numThreads==0)
+		{
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		numThreads=numCpus>0?(unsigned int)(numCpus):1U;
+		}
+	numActiveThreads=numThreads;
+	threads=new Threads::Thread[numThreads];
+	for(unsigned int i=0;i<numThreads;++i)
+		threads[i].start(this,&ElevationTileCache::loaderThreadMethod);
+	}
+
+ElevationTileCache::~ElevationTileCache(void)
+	{
+	/* Discard all pending requests and shut down the loader threads: */
+	{
+	Threads::Mutex::Lock cacheLock(cacheMutex);
+	requests.clear();
+	shutdown=true;
+	requestCond.broadcast();
+	}
+	delete[] threads;
+	}
+
+int ElevationTileCache::getChildKeys(const ElevationTileCache::TileKey& key,ElevationTileCache::TileKey childKeys[4]) const
+	{
+	int numChildren=0;
+	if(key.level>0)
+		{
+		/* Return all children that cover at least one grid cell: */
+		unsigned int childLevel=key.level-1;
+		int childExtent=tileSize<<childLevel;
+		for(unsigned int z=key.z*2;z<key.z*2+2;++z)
+			for(unsigned int x=key.x*2;x<key.x*2+2;++x)
+				if(int(x)*childExtent<layout.size[0]-1&&int(z)*childExtent<layout.size[1]-1)
+					childKeys[numChildren++]=TileKey(childLevel,x,z);
+		}
+	return numChildren;
+	}
+
+unsigned int ElevationTileCache::startFrame(double newFrameTime)
+	{
+	Threads::Mutex::Lock cacheLock(cacheMutex);
+	
+	/* Don't start a new frame if another render pass of the same frame already did: */
+	if(newFrameTime>=0.0&&newFrameTime==frameTime)
+		return frame;
+	frameTime=newFrameTime;
+	++frame;
+	
+	/* Discard requests for tiles that have not been requested since the previous frame: */
+	for(size_t i=0;i<requests.size();)
+		{
+		TileMap::Iterator tIt=tiles.findEntry(requests[i]);
+		if(tIt->getDest().lastUsed+2<frame)
+			{
+			tiles.removeEntry(tIt);
+			requests[i]=requests.back();
+			requests.pop_back();
+			}
+		else
+			++i;
+		}
+	
+	return frame;
+	}
+
+ElevationTileCache::TilePointer ElevationTileCache::getTile(const ElevationTileCache::TileKey& key)
+	{
+	Threads::Mutex::Lock cacheLock(cacheMutex);
+	
+	/* Check if the tile is already in the cache: */
+	TileMap::Iterator tIt=tiles.findEntry(key);
+	if(tIt.isFinished())
+		{
+		/* Request the tile from the loader threads, or fail it if no loader thread can read the BIL file: */
+		CacheEntry entry;
+		entry.lastUsed=frame;
+		entry.failed=numActiveThreads==0;
+		tiles.setEntry(TileMap::Entry(key,entry));
+		if(!entry.failed)
+			{
+			requests.push_back(key);
+			requestCond.signal();
+			}
+		else
+			++numFailedTiles;
+		return TilePointer();
+		}
+	
+	/* Mark the tile as used and return it, or null if it is still being prepared: */
+	tIt->getDest().lastUsed=frame;
+	return tIt->getDest().tile;
+	}
+
+size_t ElevationTileCache::getMemorySize(void)
+	{
+	Threads::Mutex::Lock cacheLock(cacheMutex);
+	return memorySize;
+	}
+
+unsigned int ElevationTileCache::getNumFailedTiles(void)
+	{
+	Threads::Mutex::Lock cacheLock(cacheMutex);
+	return numFailedTiles;
+	}
+
+std::string ElevationTileCache::getLastError(void)
+	{
+	Threads::Mutex::Lock cacheLock(cacheMutex);
+	return lastError;
+	}
+
+}
@@ -0,0 +1,194 @@
+/***********************************************************************
+ElevationTileCache - Class to page square tiles of a quadtree of
+progressively coarser resolution levels of an elevation grid stored in a
+BIL file, preparing tiles for rendering in a pool of background threads
+and keeping recently used tiles within a memory budget.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef SCENEGRAPH_INTERNAL_ELEVATIONTILECACHE_INCLUDED
+#define SCENEGRAPH_INTERNAL_ELEVATIONTILECACHE_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <Misc/Autopointer.h>
+#include <Misc/HashTable.h>
+#include <IO/SeekableFile.h>
+#include <Threads/Mutex.h>
+#include <Threads/Cond.h>
+#include <Threads/Thread.h>
+#include <Threads/RefCounted.h>
+#include <Geometry/Point.h>
+#include <Geometry/Box.h>
+#include <GL/gl.h>
+#include <GL/GLGeometryVertex.h>
+#include <SceneGraph/Geometry.h>
+#include <SceneGraph/ColorMapNode.h>
+#include <SceneGraph/PointTransformNode.h>
+#include <SceneGraph/Internal/LoadElevationGrid.h>
+
+namespace SceneGraph {
+
+class ElevationTileCache
+	{
+	/* Embedded classes: */
+	public:
+	typedef GLGeometry::Vertex<Scalar,2,GLubyte,4,Scalar,Scalar,3> Vertex; // Type for tile vertices
+	
+	struct TileKey // Structure identifying a tile by its resolution level and its index inside its level
+		{
+		/* Elements: */
+		public:
+		unsigned int level; // Resolution level; level 0 has full resolution, and each level above has half the resolution of the level below
+		unsigned int x,z; // Tile index along grid columns and rows
+		
+		/* Constructors and destructors: */
+		TileKey(void)
+			:level(0),x(0),z(0)
+			{
+			}
+		TileKey(unsigned int sLevel,unsigned int sX,unsigned int sZ)
+			:level(sLevel),x(sX),z(sZ)
+			{
+			}
+		
+		/* Methods: */
+		friend bool operator==(const TileKey& k1,const TileKey& k2)
+			{
+			return k1.level==k2.level&&k1.x==k2.x&&k1.z==k2.z;
+			}
+		friend bool operator!=(const TileKey& k1,const TileKey& k2)
+			{
+			return k1.level!=k2.level||k1.x!=k2.x||k1.z!=k2.z;
+			}
+		static size_t hash(const TileKey& key,size_t tableSize)
+			{
+			return (size_t(key.level)*73856093U+size_t(key.x)*19349663U+size_t(key.z)*83492791U)%tableSize;
+			}
+		};
+	
+	class Tile:public Threads::RefCounted // Class for tiles prepared for rendering; tiles are immutable once prepared
+		{
+		/* Elements: */
+		public:
+		TileKey key; // The tile's key
+		int numSamples[2]; // Number of grid samples in the tile along columns and rows
+		Vertex* vertices; // Grid vertices in row-major order, followed by the vertices of the skirts along the tile's bottom, top, left, and right edges
+		GLuint* indices; // Vertex indices of numSamples[1]-1 quad strips of length 2*numSamples[0], followed by the indices of two skirt strips of length 2*numSamples[0] and two of length 2*numSamples[1]
+		Box box; // Bounding box of the tile's vertices including its skirts
+		Scalar sampleSpacing; // Approximate distance between neighboring grid vertices
+		
+		/* Constructors and destructors: */
+		Tile(const TileKey& sKey,int sNumSamplesX,int sNumSamplesZ); // Creates an uninitialized tile of the given size
+		virtual ~Tile(void);
+		
+		/* Methods: */
+		size_t getNumVertices(void) const // Returns the total number of vertices
+			{
+			return size_t(numSamples[0])*size_t(numSamples[1])+size_t(numSamples[0]+numSamples[1])*2;
+			}
+		size_t getNumIndices(void) const // Returns the total number of vertex indices
+			{
+			return size_t(numSamples[1]-1)*size_t(numSamples[0])*2+size_t(numSamples[0]+numSamples[1])*4;
+			}
+		size_t getMemorySize(void) const // Returns the amount of memory used by the tile's vertices and indices in bytes
+			{
+			return getNumVertices()*sizeof(Vertex)+getNumIndices()*sizeof(GLuint);
+			}
+		};
+	
+	typedef Misc::Autopointer<Tile> TilePointer;
+	
+	private:
+	struct CacheEntry // Structure for tiles in the cache
+		{
+		/* Elements: */
+		public:
+		TilePointer tile; // Pointer to the prepared tile, or null if the tile is still being prepared
+		unsigned int lastUsed; // Number of the last frame in which the tile was requested
+		bool failed; // Flag if the tile could not be prepared
+		
+		/* Constructors and destructors: */
+		CacheEntry(void)
+			:lastUsed(0),failed(false)
+			{
+			}
+		};
+	
+	typedef Misc::HashTable<TileKey,CacheEntry,TileKey> TileMap; // Hash table type mapping keys to cached tiles
+	
+	/* Elements: */
+	std::string bilFileName; // Name of the BIL file containing the full-resolution elevation grid
+	BILGridLayout layout; // Layout of the BIL file
+	Point origin; // Position of the grid's first sample
+	Scalar heightScale; // Scale factor applied to all height values
+	bool heightIsY; // Flag whether heights go along the y axis instead of the z axis
+	bool ccw; // Flag whether the elevation grid's quads are oriented counter-clockwise
+	ColorMapNodePointer colorMap; // Optional color map to color vertices by elevation
+	PointTransformNodePointer pointTransform; // Optional transformation applied to all vertices
+	int tileSize; // Number of grid cells along each side of a tile
+	unsigned int rootLevel; // Resolution level of the single tile covering the entire grid
+	size_t memoryBudget; // Maximum amount of memory used by prepared tiles in bytes
+	TilePointer rootTile; // The tile covering the entire grid, which is never evicted
+	Threads::Mutex cacheMutex; // Mutex serializing access to the tile cache and request list
+	Threads::Cond requestCond; // Condition variable to signal new requests to the loader threads
+	TileMap tiles; // Map of tiles that are prepared or being prepared
+	std::vector<TileKey> requests; // List of tiles waiting for a loader thread
+	size_t memorySize; // Amount of memory used by prepared tiles in bytes
+	unsigned int frame; // Number of the current frame
+	double frameTime; // Time stamp of the current frame, or negative if render passes have no time stamps
+	unsigned int numFailedTiles; // Number of tile requests that failed since the cache was created
+	std::string lastError; // Message of the most recent tile loading error, or empty if no tile failed
+	bool shutdown; // Flag to shut down the loader threads
+	unsigned int numThreads; // Number of loader threads
+	unsigned int numActiveThreads; // Number of loader threads that opened the BIL file or are still opening it
+	Threads::Thread* threads; // Array of loader threads
+	
+	/* Private methods: */
+	IO::SeekableFilePtr openBILFile(void) const; // Opens the BIL file for reading samples
+	Tile* prepareTile(IO::SeekableFile& bilFile,const TileKey& key) const; // Reads and prepares the tile of the given key
+	void evictTiles(void); // Evicts least recently used tiles until the cache is within its memory budget; called with cache mutex locked
+	void* loaderThreadMethod(void); // Method for the background loader threads
+	
+	/* Constructors and destructors: */
+	public:
+	ElevationTileCache(const std::string& sBilFileName,const BILGridLayout& sLayout,const Point& sOrigin,Scalar sHeightScale,bool sHeightIsY,bool sCcw,ColorMapNode* sColorMap,PointTransformNode* sPointTransform,int sTileSize,size_t sMemoryBudget,unsigned int sNumThreads =0); // Creates a cache for the given BIL file and prepares the root tile; creates the given number of loader threads (0: one per CPU); throws exception if the BIL file can not be read
+	~ElevationTileCache(void); // Discards all pending requests and shuts down the loader threads
+	
+	/* Methods: */
+	const TilePointer& getRootTile(void) const // Returns the tile covering the entire grid
+		{
+		return rootTile;
+		}
+	int getChildKeys(const TileKey& key,TileKey childKeys[4]) const; // Stores the keys of the up to four next-finer tiles covering the same area as the given tile in the given array; returns the number of children
+	unsigned int startFrame(double newFrameTime); // Starts a new rendering frame unless the given non-negative time stamp matches the current frame's, and discards requests for tiles that were not requested in the previous frame; returns the current frame number
+	TilePointer getTile(const TileKey& key); // Returns the tile of the given key if it is prepared; otherwise requests the tile from the loader threads and returns null
+	size_t getMemoryBudget(void) const // Returns the cache's memory budget in bytes
+		{
+		return memoryBudget;
+		}
+	size_t getMemorySize(void); // Returns the amount of memory currently used by prepared tiles
+	unsigned int getNumFailedTiles(void); // Returns the number of tile requests that failed because the BIL file could not be read
+	std::string getLastError(void); // Returns the message of the most recent tile loading error, or an empty string if no tile failed
+	};
+
+}
+
+#endif
@@ -0,0 +1,239 @@
+/***********************************************************************
+InlineLoader - Class to load the external VRML files referenced by
+inline nodes in a pool of background threads, and to attach the loaded
+nodes to their inline nodes once all files have been loaded.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <SceneGraph/Internal/InlineLoader.h>
+
+#include <unistd.h>
+#include <stdexcept>
+#include <Misc/ThrowStdErr.h>
+#include <Cluster/OpenFile.h>
+#include <SceneGraph/VRMLFile.h>
+
+namespace SceneGraph {
+
+namespace {
+
+/***************************************************************
+Helper types and functions to order updates of enclosing nodes:
+***************************************************************/
+
+typedef Misc::HashTable<Node*,std::vector<Node*> > NodeDependencies; // Hash table mapping nodes to the nodes that must be updated before them
+typedef Misc::HashTable<Node*,void> NodeSet; // Hash set of nodes
+
+void addDependency(NodeDependencies& dependencies,Node* node,Node* dependency)
+	{
+	dependencies[node].getDest().push_back(dependency);
+	}
+
+void orderUpdates(Node* node,NodeDependencies& dependencies,NodeSet& visited,std::vector<Node*>& order)
+	{
+	/* Bail out if the node was already visited: */
+	if(visited.isEntry(node))
+		return;
+	visited.setEntry(NodeSet::Entry(node));
+	
+	/* Order the node's dependencies first: */
+	NodeDependencies::Iterator dIt=dependencies.findEntry(node);
+	if(!dIt.isFinished())
+		{
+		std::vector<Node*> nodeDependencies=dIt->getDest();
+		for(std::vector<Node*>::iterator ndIt=nodeDependencies.begin();ndIt!=nodeDependencies.end();++ndIt)
+			orderUpdates(*ndIt,dependencies,visited,order);
+		}
+	
+	/* Update the node after its dependencies: */
+	order.push_back(node);
+	}
+
+}
+
+/*****************************
+Methods of class InlineLoader:
+*****************************/
+
+void* InlineLoader::loaderThreadMethod(void)
+	{
+	while(true)
+		{
+		/* Wait for the next job: */
+		Job* job;
+		{
+		Threads::Mutex::Lock jobLock(jobMutex);
+		while(!shutdown&&queue.empty())
+			jobCond.wait(jobMutex);
+		if(shutdown)
+			break;
+		job=queue.front();
+		queue.pop_front();
+		}
+		
+		/* Load the job's VRML file; inline nodes inside the file are handed back to this loader: */
+		std::string error;
+		try
+			{
+			VRMLFile vrmlFile(job->url,Cluster::openFile(0,job->url.c_str()),nodeCreator);
+			vrmlFile.setInlineLoader(this,job->basePath);
+			vrmlFile.parse(job->root);
+			}
+		catch(std::runtime_error err)
+			{
+			error=err.what();
+			}
+		catch(...)
+			{
+			/* Mark the job as failed so that finish does not wait for it forever: */
+			error=std::string("SceneGraph::InlineLoader: Unknown exception while loading ")+job->url;
+			}
+		
+		/* Hand the finished job back: */
+		{
+		Threads::Mutex::Lock jobLock(jobMutex);
+		job->error=error;
+		job->done=true;
+		--numPendingJobs;
+		doneCond.broadcast();
+		}
+		}
+	
+	return 0;
+	}
+
+InlineLoader::InlineLoader(NodeCreator& sNodeCreator,unsigned int sNumThreads)
+	:nodeCreator(sNodeCreator),
+	 jobMap(17),
+	 numPendingJobs(0),
+	 shutdown(false),
+	 numThreads(sNumThreads),threads(0)
+	{
+	/* Determine the number of loader threads: */
+	if(numThreads==0)
+		{
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		numThreads=numCpus>0?(unsigned int)(numCpus):1U;
+		}
+	
+	/* Start the loader threads: */
+	threads=new Threads::Thread[numThreads];
+	for(unsigned int i=0;i<numThreads;++i)
+		threads[i].start(this,&InlineLoader::loaderThreadMethod);
+	}
+
+InlineLoader::~InlineLoader(void)
+	{
+	/* Shut down the loader threads, which finish the VRML files they are currently loading: */
+	{
+	Threads::Mutex::Lock jobLock(jobMutex);
+	shutdown=true;
+	jobCond.broadcast();
+	}
+	delete[] threads;
+	
+	/* Delete all jobs: */
+	for(std::vector<Job*>::iterator jIt=jobs.begin();jIt!=jobs.end();++jIt)
+		delete *jIt;
+	}
+
+void InlineLoader::load(InlineNode* node,const std::string& url,const InlineLoader::NodePath& path)
+	{
+	Threads::Mutex::Lock jobLock(jobMutex);
+	
+	/* Check if the VRML file was already requested: */
+	Job* job;
+	JobMap::Iterator jmIt=jobMap.findEntry(url);
+	if(jmIt.isFinished())
+		{
+		/* Create a new job and queue it for the loader threads: */
+		job=new Job;
+		job->url=url;
+		job->basePath=path;
+		job->root=new GroupNode;
+		job->done=false;
+		jobs.push_back(job);
+		jobMap[url]=job;
+		queue.push_back(job);
+		++numPendingJobs;
+		jobCond.signal();
+		}
+	else
+		job=jmIt->getDest();
+	
+	/* Add the inline node to the job's waiting list: */
+	Request request;
+	request.node=node;
+	request.path=path;
+	job->requests.push_back(request);
+	}
+
+void InlineLoader::finish(void)
+	{
+	/* Wait until all requested VRML files are loaded, including those requested while loading other files: */
+	{
+	Threads::Mutex::Lock jobLock(jobMutex);
+	while(numPendingJobs>0)
+		doneCond.wait(jobMutex);
+	}
+	
+	/* Report the first error in request order: */
+	for(std::vector<Job*>::iterator jIt=jobs.begin();jIt!=jobs.end();++jIt)
+		if(!(*jIt)->error.empty())
+			Misc::throwStdErr("%s",(*jIt)->error.c_str());
+	
+	/* Attach the loaded nodes to all waiting inline nodes, and collect the nodes that need to be updated: */
+	NodeDependencies dependencies(101);
+	std::vector<Node*> roots;
+	for(std::vector<Job*>::iterator jIt=jobs.begin();jIt!=jobs.end();++jIt)
+		{
+		const GroupNode::MFGraphNode::ValueList& loaded=(*jIt)->root->children.getValues();
+		for(std::vector<Request>::iterator rIt=(*jIt)->requests.begin();rIt!=(*jIt)->requests.end();++rIt)
+			{
+			/* Append the loaded nodes to the inline node's children: */
+			for(GroupNode::MFGraphNode::ValueList::const_iterator lIt=loaded.begin();lIt!=loaded.end();++lIt)
+				rIt->node->children.appendValue(*lIt);
+			
+			/* Each node on the path must be updated after the node it encloses: */
+			roots.push_back(rIt->path.front());
+			for(size_t i=1;i<rIt->path.size();++i)
+				addDependency(dependencies,rIt->path[i-1],rIt->path[i]);
+			
+			/* Inline nodes sharing a VRML file must be updated after the first one, which encloses nested inline nodes: */
+			if(rIt!=(*jIt)->requests.begin())
+				addDependency(dependencies,rIt->node.getPointer(),(*jIt)->requests.front().node.getPointer());
+			}
+		}
+	
+	/* Update all affected nodes from the inside out to recalculate their bounding boxes: */
+	NodeSet visited(101);
+	std::vector<Node*> order;
+	for(std::vector<Node*>::iterator rIt=roots.begin();rIt!=roots.end();++rIt)
+		orderUpdates(*rIt,dependencies,visited,order);
+	for(std::vector<Node*>::iterator oIt=order.begin();oIt!=order.end();++oIt)
+		(*oIt)->update();
+	
+	/* Delete all jobs: */
+	for(std::vector<Job*>::iterator jIt=jobs.begin();jIt!=jobs.end();++jIt)
+		delete *jIt;
+	jobs.clear();
+	jobMap.clear();
+	}
+
+}
@@ -0,0 +1,103 @@
+/***********************************************************************
+InlineLoader - Class to load the external VRML files referenced by
+inline nodes in a pool of background threads, and to attach the loaded
+nodes to their inline nodes once all files have been loaded.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef SCENEGRAPH_INTERNAL_INLINELOADER_INCLUDED
+#define SCENEGRAPH_INTERNAL_INLINELOADER_INCLUDED
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <Misc/StringHashFunctions.h>
+#include <Misc/HashTable.h>
+#include <Threads/Mutex.h>
+#include <Threads/Cond.h>
+#include <Threads/Thread.h>
+#include <SceneGraph/Node.h>
+#include <SceneGraph/GroupNode.h>
+#include <SceneGraph/InlineNode.h>
+
+/* Forward declarations: */
+namespace SceneGraph {
+class NodeCreator;
+}
+
+namespace SceneGraph {
+
+class InlineLoader
+	{
+	/* Embedded classes: */
+	public:
+	typedef std::vector<Node*> NodePath; // Type for lists of nodes enclosing a node, from the outermost node down to the node itself
+	
+	private:
+	struct Request // Structure describing an inline node waiting for the nodes of an external VRML file
+		{
+		/* Elements: */
+		public:
+		InlineNodePointer node; // The waiting inline node
+		NodePath path; // Nodes enclosing the inline node, ending with the inline node itself
+		};
+	
+	struct Job // Structure describing an external VRML file to be loaded
+		{
+		/* Elements: */
+		public:
+		std::string url; // Fully-qualified URL of the VRML file
+		NodePath basePath; // Path of the inline node that first requested the VRML file
+		GroupNodePointer root; // Group node receiving the VRML file's top-level nodes
+		bool done; // Flag whether the VRML file has been loaded
+		std::string error; // Error message if loading the VRML file failed
+		std::vector<Request> requests; // List of inline nodes waiting for the VRML file
+		};
+	
+	typedef Misc::HashTable<std::string,Job*> JobMap; // Hash table type to share jobs between inline nodes referencing the same VRML file
+	
+	/* Elements: */
+	NodeCreator& nodeCreator; // Node creator for all loaded VRML files
+	Threads::Mutex jobMutex; // Mutex serializing access to the job lists
+	Threads::Cond jobCond; // Condition variable to signal new jobs to the loader threads
+	Threads::Cond doneCond; // Condition variable to signal finished jobs
+	std::vector<Job*> jobs; // List of all jobs in the order in which they were requested
+	JobMap jobMap; // Map from VRML file URLs to jobs
+	std::deque<Job*> queue; // Queue of jobs waiting for a loader thread
+	size_t numPendingJobs; // Number of jobs that have not finished yet
+	bool shutdown; // Flag to shut down the loader threads
+	unsigned int numThreads; // Number of loader threads
+	Threads::Thread* threads; // Array of loader threads
+	
+	/* Private methods: */
+	void* loaderThreadMethod(void); // Method for the background loader threads
+	
+	/* Constructors and destructors: */
+	public:
+	InlineLoader(NodeCreator& sNodeCreator,unsigned int sNumThreads =0); // Creates a loader for the given node creator and number of loader threads (0: one per CPU)
+	~InlineLoader(void); // Discards all unfinished jobs and shuts down the loader threads
+	
+	/* Methods: */
+	void load(InlineNode* node,const std::string& url,const NodePath& path); // Requests the VRML file of the given URL for the given inline node, which is enclosed by the given path of nodes being parsed; can be called from any thread
+	void finish(void); // Waits for all requested VRML files, attaches their nodes to all waiting inline nodes, and updates the inline nodes and their enclosing nodes; throws exception if any VRML file could not be loaded
+	};
+
+}
+
+#endif
@@ -58,94 +58,26 @@ std::string createHeaderFileName(const std::string& bilFileName)
 
 void loadBILGrid(ElevationGridNode& node,Cluster::Multiplexer* multiplexer)
 	{
-	/* Open the header file: */
+	/* Read the header file: */
 	std::string bilFileName=node.heightUrl.getValue(0);
-	IO::ValueSource header(Cluster::openFile(multiplexer,createHeaderFileName(bilFileName).c_str()));
-	header.skipWs();
-	
-	/* Parse the header file: */
+	BILGridLayout layout=readBILGridLayout(bilFileName,multiplexer);
 	typedef IO::SeekableFile::Offset Offset;
-	int size[2]={-1,-1};
-	int numBits=16;
-	Offset bandGapBytes=0;
-	Offset bandRowBytes=0;
-	Offset totalRowBytes=0;
-	Misc::Endianness endianness=Misc::HostEndianness;
-	Scalar cellSize[2]={Scalar(1),Scalar(1)};
-	while(!header.eof())
+	const int* size=layout.size;
+	Offset totalRowBytes=layout.rowBytes;
+	
+	/* Set the node's invalid removal flag and invalid height value: */
+	if(layout.haveNodata)
 		{
-		/* Read the next token: */
-		std::string token=header.readString();
-		
-		if(token=="LAYOUT")
-			{
-			std::string layout=header.readString();
-			if(layout!="BIL")
-				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s does not have BIL layout",bilFileName.c_str());
-			}
-		else if(token=="NBANDS")
-			{
-			int numBands=header.readInteger();
-			if(numBands!=1)
-				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has %d bands instead of 1",bilFileName.c_str(),numBands);
-			}
-		else if(token=="NCOLS")
-			size[0]=header.readInteger();
-		else if(token=="NROWS")
-			size[1]=header.readInteger();
-		else if(token=="NBITS")
-			{
-			numBits=header.readInteger();
-			if(numBits!=16&&numBits!=32)
-				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has unsupported number of bits per sample %d",bilFileName.c_str(),numBits);
-			}
-		else if(token=="BANDGAPBYTES")
-			bandGapBytes=Offset(header.readInteger());
-		else if(token=="BANDROWBYTES")
-			bandRowBytes=Offset(header.readInteger());
-		else if(token=="TOTALROWBYTES")
-			totalRowBytes=Offset(header.readInteger());
-		else if(token=="BYTEORDER")
-			{
-			std::string byteOrder=header.readString();
-			if(byteOrder=="LSBFIRST"||byteOrder=="I")
-				endianness=Misc::LittleEndian;
-			else if(byteOrder=="MSBFIRST"||byteOrder=="M")
-				endianness=Misc::BigEndian;
-			else
-				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has unrecognized byte order %s",bilFileName.c_str(),byteOrder.c_str());
-			}
-		else if(token=="CELLSIZE")
-			{
-			Scalar cs=Scalar(header.readNumber());
-			for(int i=0;i<2;++i)
-				cellSize[i]=cs;
-			}
-		else if(token=="XDIM")
-			cellSize[0]=Scalar(header.readNumber());
-		else if(token=="YDIM")
-			cellSize[1]=Scalar(header.readNumber());
-		else if(token=="NODATA_VALUE")
-			{
-			/* Set the node's invalid removal flag and invalid height value: */
-			node.removeInvalids.setValue(true);
-			node.invalidHeight.setValue(header.readNumber());
-			}
+		node.removeInvalids.setValue(true);
+		node.invalidHeight.setValue(layout.nodata);
 		}
 	
-	/* Check the image layout: */
-	int numBytes=(numBits+7)/8;
-	if(totalRowBytes!=bandRowBytes||bandRowBytes!=Offset(size[0])*Offset(numBytes))
-		Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has mismatching row size",bilFileName.c_str());
-	if(bandGapBytes!=0)
-		Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has nonzero band gap",bilFileName.c_str());
-	
 	/* Read the image: */
 	IO::SeekableFilePtr imageFile(Cluster::openSeekableFile(multiplexer,bilFileName.c_str()));
-	imageFile->setEndianness(endianness);
+	imageFile->setEndianness(layout.endianness);
 	std::vector<Scalar> heights;
 	heights.reserve(size_t(size[0])*size_t(size[1]));
-	if(numBits==16)
+	if(layout.numBits==16)
 		{
 		signed short int* rowBuffer=new signed short int[size[0]];
 		for(int y=size[1]-1;y>=0;--y)
@@ -158,7 +90,7 @@ void loadBILGrid(ElevationGridNode& node,Cluster::Multiplexer* multiplexer)
 			}
 		delete[] rowBuffer;
 		}
-	else if(numBits==32)
+	else if(layout.numBits==32)
 		{
 		float* rowBuffer=new float[size[0]];
 		for(int y=size[1]-1;y>=0;--y)
@@ -174,9 +106,9 @@ void loadBILGrid(ElevationGridNode& node,Cluster::Multiplexer* multiplexer)
 	
 	/* Install the height field: */
 	node.xDimension.setValue(size[0]);
-	node.xSpacing.setValue(cellSize[0]);
+	node.xSpacing.setValue(layout.cellSize[0]);
 	node.zDimension.setValue(size[1]);
-	node.zSpacing.setValue(cellSize[1]);
+	node.zSpacing.setValue(layout.cellSize[1]);
 	std::swap(node.height.getValues(),heights);
 	}
 
@@ -267,6 +199,95 @@ void loadImageGrid(ElevationGridNode& node,Cluster::Multiplexer* multiplexer)
 
 }
 
+BILGridLayout readBILGridLayout(const std::string& bilFileName,Cluster::Multiplexer* multiplexer)
+	{
+	/* Open the header file: */
+	IO::ValueSource header(Cluster::openFile(multiplexer,createHeaderFileName(bilFileName).c_str()));
+	header.skipWs();
+	
+	/* Parse the header file: */
+	typedef IO::SeekableFile::Offset Offset;
+	BILGridLayout result;
+	result.size[0]=result.size[1]=-1;
+	result.numBits=16;
+	Offset bandGapBytes=0;
+	Offset bandRowBytes=0;
+	Offset totalRowBytes=0;
+	result.endianness=Misc::HostEndianness;
+	result.cellSize[0]=result.cellSize[1]=Scalar(1);
+	result.haveNodata=false;
+	result.nodata=Scalar(0);
+	while(!header.eof())
+		{
+		/* Read the next token: */
+		std::string token=header.readString();
+		
+		if(token=="LAYOUT")
+			{
+			std::string layout=header.readString();
+			if(layout!="BIL")
+				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s does not have BIL layout",bilFileName.c_str());
+			}
+		else if(token=="NBANDS")
+			{
+			int numBands=header.readInteger();
+			if(numBands!=1)
+				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has %d bands instead of 1",bilFileName.c_str(),numBands);
+			}
+		else if(token=="NCOLS")
+			result.size[0]=header.readInteger();
+		else if(token=="NROWS")
+			result.size[1]=header.readInteger();
+		else if(token=="NBITS")
+			{
+			result.numBits=header.readInteger();
+			if(result.numBits!=16&&result.numBits!=32)
+				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has unsupported number of bits per sample %d",bilFileName.c_str(),result.numBits);
+			}
+		else if(token=="BANDGAPBYTES")
+			bandGapBytes=Offset(header.readInteger());
+		else if(token=="BANDROWBYTES")
+			bandRowBytes=Offset(header.readInteger());
+		else if(token=="TOTALROWBYTES")
+			totalRowBytes=Offset(header.readInteger());
+		else if(token=="BYTEORDER")
+			{
+			std::string byteOrder=header.readString();
+			if(byteOrder=="LSBFIRST"||byteOrder=="I")
+				result.endianness=Misc::LittleEndian;
+			else if(byteOrder=="MSBFIRST"||byteOrder=="M")
+				result.endianness=Misc::BigEndian;
+			else
+				Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has unrecognized byte order %s",bilFileName.c_str(),byteOrder.c_str());
+			}
+		else if(token=="CELLSIZE")
+			{
+			Scalar cs=Scalar(header.readNumber());
+			for(int i=0;i<2;++i)
+				result.cellSize[i]=cs;
+			}
+		else if(token=="XDIM")
+			result.cellSize[0]=Scalar(header.readNumber());
+		else if(token=="YDIM")
+			result.cellSize[1]=Scalar(header.readNumber());
+		else if(token=="NODATA_VALUE")
+			{
+			result.haveNodata=true;
+			result.nodata=Scalar(header.readNumber());
+			}
+		}
+	
+	/* Check the image layout: */
+	int numBytes=(result.numBits+7)/8;
+	if(totalRowBytes!=bandRowBytes||bandRowBytes!=Offset(result.size[0])*Offset(numBytes))
+		Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has mismatching row size",bilFileName.c_str());
+	if(bandGapBytes!=0)
+		Misc::throwStdErr("SceneGraph::loadElevationGrid: File %s has nonzero band gap",bilFileName.c_str());
+	
+	result.rowBytes=totalRowBytes;
+	return result;
+	}
+
 void loadElevationGrid(ElevationGridNode& node,Cluster::Multiplexer* multiplexer)
 	{
 	/* Determine the format of the height file: */
@@ -23,6 +23,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef SCENEGRAPH_INTERNAL_LOADELEVATIONGRID_INCLUDED
 #define SCENEGRAPH_INTERNAL_LOADELEVATIONGRID_INCLUDED
 
+#include <string>
+#include <Misc/Endianness.h>
+#include <IO/SeekableFile.h>
 #include <SceneGraph/FieldTypes.h>
 
 /* Forward declarations: */
@@ -35,6 +38,20 @@ class ElevationGridNode;
 
 namespace SceneGraph {
 
+struct BILGridLayout // Structure describing the layout of a single-band elevation grid in a BIL file
+	{
+	/* Elements: */
+	public:
+	int size[2]; // Number of grid columns and rows
+	int numBits; // Number of bits per sample; 16 for signed integers, 32 for floats
+	Misc::Endianness endianness; // Byte order of samples
+	IO::SeekableFile::Offset rowBytes; // Number of bytes per grid row
+	Scalar cellSize[2]; // Sample spacing along columns and rows
+	bool haveNodata; // Flag whether the grid has a value for invalid samples
+	Scalar nodata; // Value for invalid samples
+	};
+
+BILGridLayout readBILGridLayout(const std::string& bilFileName,Cluster::Multiplexer* multiplexer); // Reads the header file belonging to the given BIL file; throws exception if the layout is not supported
 void loadElevationGrid(ElevationGridNode& node,Cluster::Multiplexer* multiplexer);
 
 }
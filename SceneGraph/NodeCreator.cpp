@@ -49,6 +49,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <SceneGraph/IndexedLineSetNode.h>
 #include <SceneGraph/CurveSetNode.h>
 #include <SceneGraph/ElevationGridNode.h>
+#include <SceneGraph/TiledElevationGridNode.h>
 #include <SceneGraph/QuadSetNode.h>
 #include <SceneGraph/IndexedFaceSetNode.h>
 #include <SceneGraph/ShapeNode.h>
@@ -99,6 +100,7 @@ NodeCreator::NodeCreator(void)
 	registerNodeType(new GenericNodeFactory<IndexedLineSetNode>());
 	registerNodeType(new GenericNodeFactory<CurveSetNode>());
 	registerNodeType(new GenericNodeFactory<ElevationGridNode>());
+	registerNodeType(new GenericNodeFactory<TiledElevationGridNode>());
 	registerNodeType(new GenericNodeFactory<QuadSetNode>());
 	registerNodeType(new GenericNodeFactory<IndexedFaceSetNode>());
 	registerNodeType(new GenericNodeFactory<ShapeNode>());
@@ -0,0 +1,348 @@
+/***********************************************************************
+TiledElevationGridNode - Class for quad-based height fields that are too
+large to be held in memory, rendered as a quadtree of multi-resolution
+tiles paged from disk based on their distance from the viewer.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#define GLGEOMETRY_NONSTANDARD_TEMPLATES
+
+#include <SceneGraph/TiledElevationGridNode.h>
+
+#include <string.h>
+#include <stdexcept>
+#include <Math/Math.h>
+#include <GL/gl.h>
+#include <GL/GLContextData.h>
+#include <GL/GLExtensionManager.h>
+#include <GL/Extensions/GLARBVertexBufferObject.h>
+#include <GL/GLGeometryWrappers.h>
+#include <GL/GLGeometryVertex.h>
+#include <SceneGraph/VRMLFile.h>
+#include <SceneGraph/GLRenderState.h>
+#include <SceneGraph/Internal/LoadElevationGrid.h>
+
+namespace SceneGraph {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+Scalar sqrDist(const Point& p,const Box& box) // Returns the squared distance from the given point to the given box
+	{
+	Scalar result(0);
+	for(int i=0;i<3;++i)
+		{
+		if(p[i]<box.min[i])
+			result+=Math::sqr(box.min[i]-p[i]);
+		else if(p[i]>box.max[i])
+			result+=Math::sqr(p[i]-box.max[i]);
+		}
+	return result;
+	}
+
+}
+
+/***************************************************
+Methods of class TiledElevationGridNode::DataItem:
+***************************************************/
+
+TiledElevationGridNode::DataItem::DataItem(void)
+	:tiles(101),memorySize(0),
+	 version(0)
+	{
+	/* Initialize the vertex buffer object extension: */
+	GLARBVertexBufferObject::initExtension();
+	}
+
+TiledElevationGridNode::DataItem::~DataItem(void)
+	{
+	/* Destroy all uploaded tiles' buffer objects: */
+	for(GLTileMap::Iterator tIt=tiles.begin();!tIt.isFinished();++tIt)
+		{
+		glDeleteBuffersARB(1,&tIt->getDest().vertexBufferObjectId);
+		glDeleteBuffersARB(1,&tIt->getDest().indexBufferObjectId);
+		}
+	}
+
+void TiledElevationGridNode::DataItem::deleteTile(TiledElevationGridNode::GLTileMap::Iterator tileIt)
+	{
+	glDeleteBuffersARB(1,&tileIt->getDest().vertexBufferObjectId);
+	glDeleteBuffersARB(1,&tileIt->getDest().indexBufferObjectId);
+	memorySize-=tileIt->getDest().memorySize;
+	tiles.removeEntry(tileIt);
+	}
+
+/***************************************
+Methods of class TiledElevationGridNode:
+***************************************/
+
+void TiledElevationGridNode::renderTile(GLRenderState& renderState,TiledElevationGridNode::DataItem* dataItem,const Point& viewerPos,const ElevationTileCache::TilePointer& tile,unsigned int frame) const
+	{
+	/* Skip the tile if it is outside the view frustum; tile boxes never go stale, so this does not depend on group node culling: */
+	if(!renderState.doesBoxIntersectFrustum(tile->box))
+		return;
+	
+	/* Check if the tile is too coarse for its distance from the viewer: */
+	if(Math::sqr(tile->sampleSpacing*detailFactor.getValue())>sqrDist(viewerPos,tile->box))
+		{
+		/* Request the tile's children: */
+		ElevationTileCache::TileKey childKeys[4];
+		int numChildren=tileCache->getChildKeys(tile->key,childKeys);
+		ElevationTileCache::TilePointer children[4];
+		bool childrenReady=numChildren>0;
+		for(int i=0;i<numChildren;++i)
+			{
+			children[i]=tileCache->getTile(childKeys[i]);
+			if(children[i]==0)
+				childrenReady=false;
+			}
+		
+		/* Render the children instead of the tile if all are ready: */
+		if(childrenReady)
+			{
+			for(int i=0;i<numChildren;++i)
+				renderTile(renderState,dataItem,viewerPos,children[i],frame);
+			return;
+			}
+		}
+	
+	/* Render the tile itself: */
+	drawTile(renderState,dataItem,*tile,frame);
+	}
+
+void TiledElevationGridNode::drawTile(GLRenderState& renderState,TiledElevationGridNode::DataItem* dataItem,const ElevationTileCache::Tile& tile,unsigned int frame) const
+	{
+	/* Check if the tile has already been uploaded: */
+	GLTileMap::Iterator tIt=dataItem->tiles.findEntry(tile.key);
+	if(tIt.isFinished())
+		{
+		/* Upload the tile's vertices and vertex indices into new buffer objects: */
+		GLTile glTile;
+		glGenBuffersARB(1,&glTile.vertexBufferObjectId);
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB,glTile.vertexBufferObjectId);
+		glBufferDataARB(GL_ARRAY_BUFFER_ARB,tile.getNumVertices()*sizeof(Vertex),tile.vertices,GL_STATIC_DRAW_ARB);
+		glGenBuffersARB(1,&glTile.indexBufferObjectId);
+		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,glTile.indexBufferObjectId);
+		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB,tile.getNumIndices()*sizeof(GLuint),tile.indices,GL_STATIC_DRAW_ARB);
+		glTile.memorySize=tile.getMemorySize();
+		glTile.lastUsed=frame;
+		dataItem->tiles.setEntry(GLTileMap::Entry(tile.key,glTile));
+		dataItem->memorySize+=glTile.memorySize;
+		}
+	else
+		{
+		/* Bind the tile's buffer objects: */
+		tIt->getDest().lastUsed=frame;
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB,tIt->getDest().vertexBufferObjectId);
+		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,tIt->getDest().indexBufferObjectId);
+		}
+	glVertexPointer(static_cast<Vertex*>(0));
+	
+	/* Draw the tile as a set of indexed quad strips: */
+	int nx=tile.numSamples[0];
+	int nz=tile.numSamples[1];
+	const GLuint* iPtr=0;
+	for(int z=0;z<nz-1;++z,iPtr+=nx*2)
+		glDrawElements(GL_QUAD_STRIP,nx*2,GL_UNSIGNED_INT,iPtr);
+	
+	/* Draw the tile's skirts from both sides: */
+	if(solid.getValue())
+		renderState.disableCulling();
+	for(int edge=0;edge<4;++edge)
+		{
+		int edgeLength=edge<2?nx:nz;
+		glDrawElements(GL_QUAD_STRIP,edgeLength*2,GL_UNSIGNED_INT,iPtr);
+		iPtr+=edgeLength*2;
+		}
+	if(solid.getValue())
+		renderState.enableCulling(GL_BACK);
+	}
+
+TiledElevationGridNode::TiledElevationGridNode(void)
+	:origin(Point::origin),
+	 heightScale(1),
+	 heightIsY(true),
+	 ccw(true),solid(true),
+	 tileSize(256),detailFactor(500),
+	 memoryBudget(256),numLoaderThreads(0),
+	 multiplexer(0),tileCache(0),version(0)
+	{
+	}
+
+TiledElevationGridNode::~TiledElevationGridNode(void)
+	{
+	delete tileCache;
+	}
+
+const char* TiledElevationGridNode::getStaticClassName(void)
+	{
+	return "TiledElevationGrid";
+	}
+
+const char* TiledElevationGridNode::getClassName(void) const
+	{
+	return "TiledElevationGrid";
+	}
+
+void TiledElevationGridNode::parseField(const char* fieldName,VRMLFile& vrmlFile)
+	{
+	if(strcmp(fieldName,"colorMap")==0)
+		vrmlFile.parseSFNode(colorMap);
+	else if(strcmp(fieldName,"origin")==0)
+		vrmlFile.parseField(origin);
+	else if(strcmp(fieldName,"heightUrl")==0)
+		{
+		vrmlFile.parseField(heightUrl);
+		
+		/* Fully qualify all URLs: */
+		for(size_t i=0;i<heightUrl.getNumValues();++i)
+			heightUrl.setValue(i,vrmlFile.getFullUrl(heightUrl.getValue(i)));
+		
+		/* Store the VRML file's multicast pipe multiplexer: */
+		multiplexer=vrmlFile.getMultiplexer();
+		}
+	else if(strcmp(fieldName,"heightScale")==0)
+		vrmlFile.parseField(heightScale);
+	else if(strcmp(fieldName,"heightIsY")==0)
+		vrmlFile.parseField(heightIsY);
+	else if(strcmp(fieldName,"ccw")==0)
+		vrmlFile.parseField(ccw);
+	else if(strcmp(fieldName,"solid")==0)
+		vrmlFile.parseField(solid);
+	else if(strcmp(fieldName,"tileSize")==0)
+		vrmlFile.parseField(tileSize);
+	else if(strcmp(fieldName,"detailFactor")==0)
+		vrmlFile.parseField(detailFactor);
+	else if(strcmp(fieldName,"memoryBudget")==0)
+		vrmlFile.parseField(memoryBudget);
+	else if(strcmp(fieldName,"numLoaderThreads")==0)
+		vrmlFile.parseField(numLoaderThreads);
+	else
+		GeometryNode::parseField(fieldName,vrmlFile);
+	}
+
+void TiledElevationGridNode::update(void)
+	{
+	/* Shut down the current tile cache: */
+	delete tileCache;
+	tileCache=0;
+	
+	if(heightUrl.getNumValues()>0)
+		{
+		try
+			{
+			/* Read the height file's layout and create a tile cache for it: */
+			BILGridLayout layout=readBILGridLayout(heightUrl.getValue(0),multiplexer);
+			size_t budget=size_t(Math::max(memoryBudget.getValue(),1))*size_t(1024*1024);
+			tileCache=new ElevationTileCache(heightUrl.getValue(0),layout,origin.getValue(),heightScale.getValue(),heightIsY.getValue(),ccw.getValue(),colorMap.getValue().getPointer(),pointTransform.getValue().getPointer(),tileSize.getValue(),budget,(unsigned int)(Math::max(numLoaderThreads.getValue(),0)));
+			}
+		catch(std::runtime_error err)
+			{
+			/* Carry on... */
+			}
+		}
+	
+	/* Invalidate the uploaded tiles: */
+	++version;
+	}
+
+Box TiledElevationGridNode::calcBoundingBox(void) const
+	{
+	if(tileCache!=0)
+		return tileCache->getRootTile()->box;
+	else
+		return Box::empty;
+	}
+
+void TiledElevationGridNode::glRenderAction(GLRenderState& renderState) const
+	{
+	/* Bail out if the elevation grid is invalid: */
+	if(tileCache==0)
+		return;
+	
+	/* Set up OpenGL state: */
+	if(solid.getValue())
+		renderState.enableCulling(GL_BACK);
+	else
+		renderState.disableCulling();
+	
+	/* Get the context data item: */
+	DataItem* dataItem=renderState.contextData.retrieveDataItem<DataItem>(this);
+	
+	/* Discard all uploaded tiles if the elevation grid changed: */
+	if(dataItem->version!=version)
+		{
+		while(dataItem->tiles.getNumEntries()>0)
+			dataItem->deleteTile(dataItem->tiles.begin());
+		dataItem->version=version;
+		}
+	
+	/* Set up the vertex arrays: */
+	int vertexArrayParts=Vertex::getPartsMask();
+	if(colorMap.getValue()==0)
+		{
+		/* Disable the color vertex array: */
+		vertexArrayParts&=~GLVertexArrayParts::Color;
+		}
+	GLVertexArrayParts::enable(vertexArrayParts);
+	
+	/* Render the tile quadtree starting from the root tile; render passes of the same frame share the frame number: */
+	unsigned int frame=tileCache->startFrame(renderState.frameTime);
+	renderTile(renderState,dataItem,renderState.getViewerPos(),tileCache->getRootTile(),frame);
+	
+	/* Reset the vertex arrays: */
+	GLVertexArrayParts::disable(vertexArrayParts);
+	
+	/* Protect the buffer objects: */
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,0);
+	
+	/* Delete least recently rendered tiles that were not rendered in this frame until the uploaded tiles are within the memory budget: */
+	size_t budget=tileCache->getMemoryBudget();
+	while(dataItem->memorySize>budget)
+		{
+		GLTileMap::Iterator lruIt=dataItem->tiles.end();
+		for(GLTileMap::Iterator tIt=dataItem->tiles.begin();!tIt.isFinished();++tIt)
+			if(tIt->getDest().lastUsed!=frame&&(lruIt.isFinished()||lruIt->getDest().lastUsed>tIt->getDest().lastUsed))
+				lruIt=tIt;
+		if(lruIt.isFinished())
+			break;
+		dataItem->deleteTile(lruIt);
+		}
+	}
+
+void TiledElevationGridNode::initContext(GLContextData& contextData) const
+	{
+	/* Create a data item and store it in the context: */
+	DataItem* dataItem=new DataItem;
+	contextData.addDataItem(this,dataItem);
+	}
+
+std::string TiledElevationGridNode::getTileError(void) const
+	{
+	if(tileCache!=0)
+		return tileCache->getLastError();
+	else
+		return std::string();
+	}
+
+}
@@ -0,0 +1,128 @@
+/***********************************************************************
+TiledElevationGridNode - Class for quad-based height fields that are too
+large to be held in memory, rendered as a quadtree of multi-resolution
+tiles paged from disk based on their distance from the viewer.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef SCENEGRAPH_TILEDELEVATIONGRIDNODE_INCLUDED
+#define SCENEGRAPH_TILEDELEVATIONGRIDNODE_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <Misc/HashTable.h>
+#include <GL/gl.h>
+#include <GL/GLObject.h>
+#include <SceneGraph/FieldTypes.h>
+#include <SceneGraph/GeometryNode.h>
+#include <SceneGraph/ColorMapNode.h>
+#include <SceneGraph/Internal/ElevationTileCache.h>
+
+/* Forward declarations: */
+namespace Cluster {
+class Multiplexer;
+}
+
+namespace SceneGraph {
+
+class TiledElevationGridNode:public GeometryNode,public GLObject
+	{
+	/* Embedded classes: */
+	public:
+	typedef SF<ColorMapNodePointer> SFColorMapNode;
+	typedef ElevationTileCache::Vertex Vertex; // Type for vertices stored in vertex buffer objects
+	
+	protected:
+	struct GLTile // Structure for tiles uploaded into buffer objects
+		{
+		/* Elements: */
+		public:
+		GLuint vertexBufferObjectId; // ID of vertex buffer object containing the tile's vertices
+		GLuint indexBufferObjectId; // ID of index buffer object containing the tile's vertex indices
+		size_t memorySize; // Size of the tile's buffer objects in bytes
+		unsigned int lastUsed; // Number of the last frame in which the tile was rendered
+		};
+	
+	typedef Misc::HashTable<ElevationTileCache::TileKey,GLTile,ElevationTileCache::TileKey> GLTileMap; // Hash table type mapping tile keys to uploaded tiles
+	
+	struct DataItem:public GLObject::DataItem
+		{
+		/* Elements: */
+		public:
+		GLTileMap tiles; // Map of tiles uploaded into buffer objects
+		size_t memorySize; // Total size of all uploaded tiles' buffer objects in bytes
+		unsigned int version; // Version of the elevation grid whose tiles are uploaded
+		
+		/* Constructors and destructors: */
+		DataItem(void);
+		virtual ~DataItem(void);
+		
+		/* Methods: */
+		void deleteTile(GLTileMap::Iterator tileIt); // Deletes the buffer objects of the given uploaded tile and removes it from the map
+		};
+	
+	/* Fields: */
+	public:
+	SFColorMapNode colorMap;
+	SFPoint origin;
+	MFString heightUrl; // URL of a BIL file containing the full-resolution height array
+	SFFloat heightScale; // Scale factor applied to all height values
+	SFBool heightIsY;
+	SFBool ccw;
+	SFBool solid;
+	SFInt tileSize; // Number of grid cells along each side of a tile
+	SFFloat detailFactor; // Tiles are refined while their distance from the viewer is less than their sample spacing times this factor
+	SFInt memoryBudget; // Maximum size of prepared tiles held in memory, and of tiles uploaded to each OpenGL context, in megabytes
+	SFInt numLoaderThreads; // Number of background threads preparing tiles (0: one per CPU)
+	
+	/* Derived state: */
+	protected:
+	Cluster::Multiplexer* multiplexer; // Pointer to a multicast pipe multiplexer when parsing VRML files in a cluster environment
+	ElevationTileCache* tileCache; // Cache of prepared tiles, or null if the elevation grid is invalid
+	unsigned int version; // Version number of elevation grid
+	
+	/* Private methods: */
+	void renderTile(GLRenderState& renderState,DataItem* dataItem,const Point& viewerPos,const ElevationTileCache::TilePointer& tile,unsigned int frame) const; // Renders the given tile, or its children if they are ready and the tile is too coarse
+	void drawTile(GLRenderState& renderState,DataItem* dataItem,const ElevationTileCache::Tile& tile,unsigned int frame) const; // Uploads the given tile if necessary and draws it
+	
+	/* Constructors and destructors: */
+	public:
+	TiledElevationGridNode(void); // Creates a default tiled elevation grid
+	virtual ~TiledElevationGridNode(void);
+	
+	/* Methods from Node: */
+	static const char* getStaticClassName(void);
+	virtual const char* getClassName(void) const;
+	virtual void parseField(const char* fieldName,VRMLFile& vrmlFile);
+	virtual void update(void);
+	
+	/* Methods from GeometryNode: */
+	virtual Box calcBoundingBox(void) const; // Returns the bounding box of the coarsest tile, which approximates the full-resolution elevation grid
+	virtual void glRenderAction(GLRenderState& renderState) const;
+	
+	/* Methods from GLObject: */
+	virtual void initContext(GLContextData& contextData) const;
+	
+	/* New methods: */
+	std::string getTileError(void) const; // Returns the message of the most recent error while loading tiles in the background, or an empty string if all tiles loaded
+	};
+
+}
+
+#endif
@@ -122,25 +122,17 @@ void TransformNode::update(void)
 	transform*=OGTransform::scale(uniformScale);
 	transform*=OGTransform::rotate(rotation.getValue());
 	transform*=OGTransform::translateToOriginFrom(center.getValue());
+	
+	/* Update the group node: */
+	GroupNode::update();
 	}
 
 Box TransformNode::calcBoundingBox(void) const
 	{
-	/* Return the explicit bounding box if there is one: */
-	if(haveExplicitBoundingBox)
-		return explicitBoundingBox;
-	else
-		{
-		/* Calculate the group's bounding box as the union of the transformed children's boxes: */
-		Box result=Box::empty;
-		for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
-			{
-			Box childBox=(*chIt)->calcBoundingBox();
-			childBox.transform(transform);
-			result.addBox(childBox);
-			}
-		return result;
-		}
+	/* Return the transformed bounding box of the children: */
+	Box result=calcChildrenBoundingBox();
+	result.transform(transform);
+	return result;
 	}
 
 void TransformNode::glRenderAction(GLRenderState& renderState) const
@@ -148,10 +140,11 @@ void TransformNode::glRenderAction(GLRenderState& renderState) const
 	/* Push the transformation onto the matrix stack: */
 	GLRenderState::DOGTransform previousTransform=renderState.pushTransform(transform);
 	
-	/* Call the render actions of all children in order: */
-	for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
-		(*chIt)->glRenderAction(renderState);
-		
+	/* Call the render actions of all children in order if the children's bounding box is inside the view frustum: */
+	if(renderState.isBoxVisible(boundingBox))
+		for(MFGraphNode::ValueList::const_iterator chIt=children.getValues().begin();chIt!=children.getValues().end();++chIt)
+			(*chIt)->glRenderAction(renderState);
+	
 	/* Pop the transformation off the matrix stack: */
 	renderState.popTransform(previousTransform);
 	}
@@ -0,0 +1,110 @@
+/***********************************************************************
+BoundingBoxTest - Program to check that group node bounding boxes follow
+changes to their subgraphs without an OpenGL context, and that the boxes
+cached for view frustum culling are refreshed by bottom-up updates.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <iostream>
+#include <Math/Math.h>
+#include <Geometry/Point.h>
+#include <Geometry/Vector.h>
+#include <Geometry/Box.h>
+#include <SceneGraph/Geometry.h>
+#include <SceneGraph/GroupNode.h>
+#include <SceneGraph/TransformNode.h>
+#include <SceneGraph/ShapeNode.h>
+#include <SceneGraph/BoxNode.h>
+
+/******************************************************
+Helper class exposing the bounding box cached by groups:
+******************************************************/
+
+class TestGroupNode:public SceneGraph::GroupNode
+	{
+	/* Methods: */
+	public:
+	const SceneGraph::Box& getCachedBoundingBox(void) const // Returns the bounding box cached during the last update
+		{
+		return boundingBox;
+		}
+	};
+
+typedef Misc::Autopointer<TestGroupNode> TestGroupNodePointer;
+
+/****************
+Helper functions:
+****************/
+
+bool isBox(const SceneGraph::Box& box,const SceneGraph::Point& min,const SceneGraph::Point& max) // Returns true if the given box has the given corners up to rounding
+	{
+	for(int i=0;i<3;++i)
+		if(Math::abs(box.min[i]-min[i])>1.0e-5f||Math::abs(box.max[i]-max[i])>1.0e-5f)
+			return false;
+	return true;
+	}
+
+bool report(const char* testName,bool passed) // Prints the result of a single test
+	{
+	std::cout<<testName<<": "<<(passed?"passed":"FAILED")<<std::endl;
+	return passed;
+	}
+
+int main(void)
+	{
+	/* Create a scene graph root -> transform -> shape -> box: */
+	SceneGraph::BoxNodePointer box=new SceneGraph::BoxNode;
+	box->update();
+	SceneGraph::ShapeNodePointer shape=new SceneGraph::ShapeNode;
+	shape->geometry.setValue(box);
+	shape->update();
+	SceneGraph::TransformNodePointer transform=new SceneGraph::TransformNode;
+	transform->translation.setValue(SceneGraph::Vector(10,0,0));
+	transform->children.appendValue(shape);
+	transform->update();
+	TestGroupNodePointer root=new TestGroupNode;
+	root->children.appendValue(transform);
+	root->update();
+	
+	bool passed=true;
+	passed=report("Initial bounding box",isBox(root->calcBoundingBox(),SceneGraph::Point(9,-1,-1),SceneGraph::Point(11,1,1)))&&passed;
+	passed=report("Initial cached bounding box",isBox(root->getCachedBoundingBox(),SceneGraph::Point(9,-1,-1),SceneGraph::Point(11,1,1)))&&passed;
+	
+	/* Change the box's size and only update the box node itself: */
+	box->size.setValue(SceneGraph::Size(4,2,2));
+	box->update();
+	passed=report("Bounding box after leaf change",isBox(root->calcBoundingBox(),SceneGraph::Point(8,-1,-1),SceneGraph::Point(12,1,1)))&&passed;
+	
+	/* Move the transform and only update the transform node itself: */
+	transform->translation.setValue(SceneGraph::Vector(0,5,0));
+	transform->update();
+	passed=report("Bounding box after transform change",isBox(root->calcBoundingBox(),SceneGraph::Point(-2,4,-1),SceneGraph::Point(2,6,1)))&&passed;
+	
+	/* Check that updating the root refreshes its cached box: */
+	root->update();
+	passed=report("Cached bounding box after root update",isBox(root->getCachedBoundingBox(),SceneGraph::Point(-2,4,-1),SceneGraph::Point(2,6,1)))&&passed;
+	
+	/* Check that an explicit bounding box overrides the children's boxes: */
+	root->bboxCenter.setValue(SceneGraph::Point(0,0,0));
+	root->bboxSize.setValue(SceneGraph::Size(100,100,100));
+	root->update();
+	passed=report("Explicit bounding box",isBox(root->calcBoundingBox(),SceneGraph::Point(-50,-50,-50),SceneGraph::Point(50,50,50))&&isBox(root->getCachedBoundingBox(),SceneGraph::Point(-50,-50,-50),SceneGraph::Point(50,50,50)))&&passed;
+	
+	return passed?0:1;
+	}
@@ -0,0 +1,352 @@
+/***********************************************************************
+ElevationGridBenchmark - Program to measure the time taken by the
+geometry preparation stages of elevation grids on large generated grids
+for different numbers of threads, without requiring an OpenGL context,
+and to check that all numbers of threads produce identical geometry.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Math/Math.h>
+#include <Realtime/Time.h>
+#include <Threads/TaskPool.h>
+#include <SceneGraph/ElevationGridNode.h>
+
+/****************
+Helper functions:
+****************/
+
+std::vector<unsigned int> parseList(const char* list) // Parses a comma-separated list of unsigned integers
+	{
+	std::vector<unsigned int> result;
+	const char* lPtr=list;
+	while(*lPtr!='\0')
+		{
+		char* endPtr;
+		result.push_back((unsigned int)(strtoul(lPtr,&endPtr,10)));
+		lPtr=endPtr;
+		if(*lPtr==',')
+			++lPtr;
+		else if(*lPtr!='\0')
+			{
+			result.clear();
+			break;
+			}
+		}
+	return result;
+	}
+
+Misc::UInt64 checksum(const void* data,size_t size) // Returns a 64-bit FNV-1a hash of the given memory block, processed in 64-bit words
+	{
+	Misc::UInt64 hash=0xcbf29ce484222325ULL;
+	const Misc::UInt64* wPtr=static_cast<const Misc::UInt64*>(data);
+	for(size_t i=size/sizeof(Misc::UInt64);i>0;--i,++wPtr)
+		hash=(hash^*wPtr)*0x100000001b3ULL;
+	const unsigned char* bPtr=reinterpret_cast<const unsigned char*>(wPtr);
+	for(size_t i=size%sizeof(Misc::UInt64);i>0;--i,++bPtr)
+		hash=(hash^*bPtr)*0x100000001b3ULL;
+	return hash;
+	}
+
+/*******************************************************
+Helper class exposing elevation grid preparation stages:
+*******************************************************/
+
+class BenchmarkElevationGridNode:public SceneGraph::ElevationGridNode
+	{
+	/* Methods: */
+	public:
+	using SceneGraph::ElevationGridNode::calcVertices;
+	using SceneGraph::ElevationGridNode::calcQuadNormals;
+	using SceneGraph::ElevationGridNode::calcHoleyQuadCases;
+	using SceneGraph::ElevationGridNode::calcHoleyQuadNormals;
+	using SceneGraph::ElevationGridNode::calcIndexedQuadStripVertices;
+	using SceneGraph::ElevationGridNode::calcIndexedQuadStripIndices;
+	using SceneGraph::ElevationGridNode::calcQuadVertices;
+	};
+
+enum Stage // Enumerated type for measured geometry preparation stages
+	{
+	VERTICES,QUADNORMALS,HOLEYQUADCASES,HOLEYQUADNORMALS,INDEXEDQUADSTRIPSET,QUADSET,HOLEYQUADTRIANGLESET,NUMSTAGES
+	};
+
+const char* stageNames[NUMSTAGES]=
+	{
+	"vertices","quadNormals","holeyQuadCases","holeyQuadNormals","indexedQuadStripSet","quadSet","holeyQuadTriangleSet"
+	};
+
+void createGrid(BenchmarkElevationGridNode& grid,int size,bool holes) // Creates a smooth elevation grid of the given size, optionally with holes of invalid elevations
+	{
+	/* Use an origin and spacings that are not exactly representable to expose differences in rounding: */
+	grid.origin.setValue(SceneGraph::Point(-123.4f,5.6f,78.9f));
+	grid.xDimension.setValue(size);
+	grid.xSpacing.setValue(0.3f);
+	grid.zDimension.setValue(size);
+	grid.zSpacing.setValue(0.7f);
+	grid.removeInvalids.setValue(holes);
+	grid.invalidHeight.setValue(-9999.0f);
+	std::vector<SceneGraph::Scalar>& heights=grid.height.getValues();
+	heights.reserve(size_t(size)*size_t(size));
+	for(int z=0;z<size;++z)
+		for(int x=0;x<size;++x)
+			{
+			/* Punch a regular pattern of square holes into the grid: */
+			if(holes&&x%64<5&&z%64<5)
+				heights.push_back(-9999.0f);
+			else
+				heights.push_back(SceneGraph::Scalar(100.0*Math::sin(double(x)*0.01)*Math::cos(double(z)*0.013)+10.0*Math::sin(double(x+z)*0.1)));
+			}
+	}
+
+Misc::UInt64 hashSerialVertices(const BenchmarkElevationGridNode& grid) // Calculates vertex positions like the original serial code and hashes them
+	{
+	int xDim=grid.xDimension.getValue();
+	int zDim=grid.zDimension.getValue();
+	SceneGraph::Scalar xSp=grid.xSpacing.getValue();
+	SceneGraph::Scalar zSp=grid.zSpacing.getValue();
+	int hComp=2;
+	int zComp=1;
+	if(grid.heightIsY.getValue())
+		std::swap(hComp,zComp);
+	const SceneGraph::Point& o=grid.origin.getValue();
+	std::vector<SceneGraph::Point> vertices(size_t(zDim)*size_t(xDim));
+	std::vector<SceneGraph::Point>::iterator vIt=vertices.begin();
+	const SceneGraph::Scalar* hPtr=&grid.height.getValue(0);
+	SceneGraph::Point p;
+	p[zComp]=o[zComp];
+	for(int z=0;z<zDim;++z,p[zComp]+=zSp)
+		{
+		p[0]=o[0];
+		for(int x=0;x<xDim;++x,++vIt,++hPtr,p[0]+=xSp)
+			{
+			p[hComp]=o[hComp]+*hPtr*grid.heightScale.getValue();
+			*vIt=p;
+			}
+		}
+	return checksum(&vertices[0],vertices.size()*sizeof(SceneGraph::Point));
+	}
+
+double runStage(const BenchmarkElevationGridNode& grid,const BenchmarkElevationGridNode& holeyGrid,Stage stage,Misc::UInt64& hash) // Runs one geometry preparation stage and returns its time; hashes the stage's results
+	{
+	size_t size=size_t(grid.xDimension.getValue());
+	size_t numVertices=size*size;
+	size_t numQuads=(size-1)*(size-1);
+	Realtime::TimePointMonotonic start;
+	double time=0.0;
+	switch(stage)
+		{
+		case VERTICES:
+			{
+			SceneGraph::Point* vertices=grid.calcVertices();
+			time=double(start.setAndDiff());
+			hash=checksum(vertices,numVertices*sizeof(SceneGraph::Point));
+			delete[] vertices;
+			break;
+			}
+		
+		case QUADNORMALS:
+			{
+			SceneGraph::Vector* normals=grid.calcQuadNormals();
+			time=double(start.setAndDiff());
+			hash=checksum(normals,numQuads*sizeof(SceneGraph::Vector));
+			delete[] normals;
+			break;
+			}
+		
+		case HOLEYQUADCASES:
+			{
+			GLuint numFullQuads,numTriangles;
+			int* quadCases=holeyGrid.calcHoleyQuadCases(numFullQuads,numTriangles);
+			time=double(start.setAndDiff());
+			hash=checksum(quadCases,numQuads*sizeof(int))^(Misc::UInt64(numFullQuads)<<32)^Misc::UInt64(numTriangles);
+			delete[] quadCases;
+			break;
+			}
+		
+		case HOLEYQUADNORMALS:
+			{
+			GLuint numFullQuads,numTriangles;
+			int* quadCases=holeyGrid.calcHoleyQuadCases(numFullQuads,numTriangles);
+			start.set();
+			SceneGraph::Vector* normals=holeyGrid.calcHoleyQuadNormals(quadCases);
+			time=double(start.setAndDiff());
+			hash=checksum(normals,numQuads*sizeof(SceneGraph::Vector));
+			delete[] normals;
+			delete[] quadCases;
+			break;
+			}
+		
+		case INDEXEDQUADSTRIPSET:
+			{
+			/* Allocate arrays standing in for the mapped vertex and index buffers: */
+			SceneGraph::ElevationGridNode::Vertex* vertices=new SceneGraph::ElevationGridNode::Vertex[numVertices];
+			GLuint* indices=new GLuint[(size-1)*size*2];
+			start.set();
+			grid.calcIndexedQuadStripVertices(vertices);
+			grid.calcIndexedQuadStripIndices(indices);
+			time=double(start.setAndDiff());
+			hash=checksum(vertices,numVertices*sizeof(SceneGraph::ElevationGridNode::Vertex))^checksum(indices,(size-1)*size*2*sizeof(GLuint));
+			delete[] vertices;
+			delete[] indices;
+			break;
+			}
+		
+		case QUADSET:
+			{
+			SceneGraph::ElevationGridNode::Vertex* vertices=new SceneGraph::ElevationGridNode::Vertex[numQuads*4];
+			start.set();
+			grid.calcQuadVertices(0,0,vertices);
+			time=double(start.setAndDiff());
+			hash=checksum(vertices,numQuads*4*sizeof(SceneGraph::ElevationGridNode::Vertex));
+			delete[] vertices;
+			break;
+			}
+		
+		case HOLEYQUADTRIANGLESET:
+			{
+			GLuint numFullQuads,numTriangles;
+			int* quadCases=holeyGrid.calcHoleyQuadCases(numFullQuads,numTriangles);
+			size_t numOutputVertices=size_t(numFullQuads)*4+size_t(numTriangles)*3;
+			SceneGraph::ElevationGridNode::Vertex* vertices=new SceneGraph::ElevationGridNode::Vertex[numOutputVertices];
+			start.set();
+			holeyGrid.calcQuadVertices(quadCases,numFullQuads,vertices);
+			time=double(start.setAndDiff());
+			hash=checksum(vertices,numOutputVertices*sizeof(SceneGraph::ElevationGridNode::Vertex));
+			delete[] vertices;
+			delete[] quadCases;
+			break;
+			}
+		
+		default:
+			;
+		}
+	
+	return time;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	int size=4096;
+	std::vector<unsigned int> threadCounts=parseList("1,2,4,0");
+	unsigned int numRounds=3;
+	bool runStages[NUMSTAGES];
+	for(int i=0;i<NUMSTAGES;++i)
+		runStages[i]=true;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"size")==0&&i+1<argc)
+				size=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"threadCounts")==0&&i+1<argc)
+				threadCounts=parseList(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"numRounds")==0&&i+1<argc)
+				numRounds=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"skip")==0&&i+1<argc)
+				{
+				/* Skip the named stage: */
+				++i;
+				for(int s=0;s<NUMSTAGES;++s)
+					if(strcasecmp(argv[i],stageNames[s])==0)
+						runStages[s]=false;
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	if(size<2||threadCounts.empty()||numRounds<1)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-size <grid size>] [-threadCounts <n1,n2,...>] [-numRounds <number of rounds>] [-skip <stage name>]*"<<std::endl;
+		return 1;
+		}
+	
+	int result=0;
+	try
+		{
+		/* Create the elevation grids: */
+		std::cerr<<"Creating two "<<size<<" x "<<size<<" elevation grids..."<<std::endl;
+		BenchmarkElevationGridNode grid;
+		createGrid(grid,size,false);
+		BenchmarkElevationGridNode holeyGrid;
+		createGrid(holeyGrid,size,true);
+		
+		/* Print the header of the comma-separated result table: */
+		printf("stage,threads,best_s,speedup,identical\n");
+		
+		Threads::TaskPool& taskPool=Threads::TaskPool::getSharedPool();
+		for(int s=0;s<NUMSTAGES;++s)
+			{
+			if(!runStages[s])
+				continue;
+			
+			/* Run the stage single-threaded to create the reference result and time: */
+			taskPool.setConcurrency(1);
+			Misc::UInt64 referenceHash;
+			double referenceTime=runStage(grid,holeyGrid,Stage(s),referenceHash);
+			for(unsigned int round=1;round<numRounds;++round)
+				{
+				Misc::UInt64 hash;
+				double time=runStage(grid,holeyGrid,Stage(s),hash);
+				if(referenceTime>time)
+					referenceTime=time;
+				}
+			
+			/* Compare vertex positions against the original serial code instead of the single-threaded run: */
+			if(Stage(s)==VERTICES)
+				referenceHash=hashSerialVertices(grid);
+			
+			/* Run the stage with each number of threads: */
+			for(std::vector<unsigned int>::iterator tcIt=threadCounts.begin();tcIt!=threadCounts.end();++tcIt)
+				{
+				taskPool.setConcurrency(*tcIt);
+				bool identical=true;
+				double bestTime=0.0;
+				for(unsigned int round=0;round<numRounds;++round)
+					{
+					Misc::UInt64 hash;
+					double time=runStage(grid,holeyGrid,Stage(s),hash);
+					if(round==0||bestTime>time)
+						bestTime=time;
+					identical=identical&&hash==referenceHash;
+					}
+				printf("%s,%u,%.3f,%.2f,%s\n",stageNames[s],taskPool.getConcurrency(),bestTime,referenceTime/bestTime,identical?"yes":"no");
+				fflush(stdout);
+				if(!identical)
+					result=1;
+				}
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		result=1;
+		}
+	
+	return result;
+	}
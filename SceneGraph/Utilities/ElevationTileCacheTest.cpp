@@ -0,0 +1,166 @@
+/***********************************************************************
+ElevationTileCacheTest - Program to check frame counting, background
+tile loading, and error handling of the elevation tile cache without an
+OpenGL context.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/Endianness.h>
+#include <SceneGraph/Geometry.h>
+#include <SceneGraph/Internal/LoadElevationGrid.h>
+#include <SceneGraph/Internal/ElevationTileCache.h>
+
+typedef SceneGraph::ElevationTileCache ElevationTileCache;
+typedef ElevationTileCache::TileKey TileKey;
+
+/****************
+Helper functions:
+****************/
+
+bool report(const char* testName,bool passed) // Prints the result of a single test
+	{
+	std::cout<<testName<<": "<<(passed?"passed":"FAILED")<<std::endl;
+	return passed;
+	}
+
+void writeBILFile(const char* bilFileName,const SceneGraph::BILGridLayout& layout) // Writes a little-endian 16-bit BIL file whose height at column x and row z is (x+z)%1000
+	{
+	FILE* file=fopen(bilFileName,"wb");
+	if(file==0)
+		throw std::runtime_error(std::string("Could not create ")+bilFileName);
+	std::vector<unsigned char> row(layout.size[0]*2);
+	for(int z=layout.size[1]-1;z>=0;--z) // BIL files store the top row first
+		{
+		for(int x=0;x<layout.size[0];++x)
+			{
+			unsigned int height=(unsigned int)((x+z)%1000);
+			row[x*2+0]=(unsigned char)(height&0xffU);
+			row[x*2+1]=(unsigned char)(height>>8);
+			}
+		fwrite(&row[0],1,row.size(),file);
+		}
+	fclose(file);
+	}
+
+int pollTiles(ElevationTileCache& cache,const std::vector<TileKey>& keys,double& frameTime,int maxFrames) // Requests the given tiles once per frame until all are ready, or the given number of frames passed; returns the number of ready tiles
+	{
+	int numReady=0;
+	for(int frame=0;frame<maxFrames;++frame)
+		{
+		cache.startFrame(frameTime);
+		frameTime+=1.0;
+		numReady=0;
+		for(std::vector<TileKey>::const_iterator kIt=keys.begin();kIt!=keys.end();++kIt)
+			if(cache.getTile(*kIt)!=0)
+				++numReady;
+		if(numReady==int(keys.size()))
+			break;
+		usleep(10000);
+		}
+	return numReady;
+	}
+
+int main(void)
+	{
+	/* Create a BIL file that is much larger than a file buffer: */
+	SceneGraph::BILGridLayout layout;
+	layout.size[0]=1025;
+	layout.size[1]=769;
+	layout.numBits=16;
+	layout.endianness=Misc::LittleEndian;
+	layout.rowBytes=IO::SeekableFile::Offset(layout.size[0])*2;
+	layout.cellSize[0]=layout.cellSize[1]=SceneGraph::Scalar(1);
+	layout.haveNodata=false;
+	layout.nodata=SceneGraph::Scalar(0);
+	char bilFileName[256];
+	snprintf(bilFileName,sizeof(bilFileName),"/tmp/ElevationTileCacheTest-%d.bil",int(getpid()));
+	writeBILFile(bilFileName,layout);
+	
+	bool passed=true;
+	try
+		{
+		ElevationTileCache* cache=new ElevationTileCache(bilFileName,layout,SceneGraph::Point::origin,SceneGraph::Scalar(1),false,true,0,0,32,size_t(64)*size_t(1024*1024),2);
+		const ElevationTileCache::TilePointer& root=cache->getRootTile();
+		passed=report("Root tile",root!=0&&root->key.level==5&&root->numSamples[0]==33&&root->numSamples[1]==25)&&passed;
+		
+		/* Render passes with the same time stamp belong to the same frame; passes without time stamps each start a frame: */
+		unsigned int frame1=cache->startFrame(1.0);
+		unsigned int frame2=cache->startFrame(1.0);
+		unsigned int frame3=cache->startFrame(2.0);
+		unsigned int frame4=cache->startFrame(-1.0);
+		unsigned int frame5=cache->startFrame(-1.0);
+		passed=report("Frame counting",frame2==frame1&&frame3==frame1+1&&frame4==frame3+1&&frame5==frame4+1)&&passed;
+		
+		/* Load the root tile's children and the full-resolution tile in the grid's top-right corner in the background: */
+		std::vector<TileKey> keys;
+		TileKey childKeys[4];
+		int numChildren=cache->getChildKeys(root->key,childKeys);
+		for(int i=0;i<numChildren;++i)
+			keys.push_back(childKeys[i]);
+		keys.push_back(TileKey(0,31,23));
+		double frameTime=10.0;
+		int numReady=pollTiles(*cache,keys,frameTime,1000);
+		bool tilesOk=numChildren==4&&numReady==int(keys.size());
+		for(std::vector<TileKey>::iterator kIt=keys.begin();tilesOk&&kIt!=keys.end();++kIt)
+			{
+			ElevationTileCache::TilePointer tile=cache->getTile(*kIt);
+			tilesOk=tile!=0&&tile->key==*kIt&&tile->box.max[2]<=SceneGraph::Scalar(999);
+			}
+		ElevationTileCache::TilePointer fine=cache->getTile(TileKey(0,31,23));
+		tilesOk=tilesOk&&fine!=0&&fine->numSamples[0]==33&&fine->numSamples[1]==33&&fine->box.max[2]==SceneGraph::Scalar((32*32+24*32)%1000); // Skirts only extend below the grid
+		passed=report("Background tile loading",tilesOk)&&passed;
+		passed=report("No errors on a valid file",cache->getNumFailedTiles()==0&&cache->getLastError().empty())&&passed;
+		
+		/* Truncate the BIL file to its top rows and request tiles from the bottom rows, which are stored at the end: */
+		if(truncate(bilFileName,layout.rowBytes*IO::SeekableFile::Offset(layout.size[1]/2))!=0)
+			throw std::runtime_error("Could not truncate BIL file");
+		std::vector<TileKey> badKeys;
+		for(unsigned int x=0;x<8;++x)
+			badKeys.push_back(TileKey(0,x,0));
+		numReady=pollTiles(*cache,badKeys,frameTime,100);
+		std::string error=cache->getLastError();
+		passed=report("Failed tiles on a truncated file",numReady==0&&cache->getNumFailedTiles()==badKeys.size()&&!error.empty())&&passed;
+		
+		/* Check that failed tiles are not requested again: */
+		pollTiles(*cache,badKeys,frameTime,10);
+		passed=report("Failed tiles stay failed",cache->getNumFailedTiles()==badKeys.size())&&passed;
+		
+		/* Shut down the cache while many tile requests are pending: */
+		for(unsigned int z=0;z<24;++z)
+			for(unsigned int x=0;x<32;++x)
+				cache->getTile(TileKey(0,x,z));
+		delete cache;
+		passed=report("Shutdown with pending requests",true)&&passed;
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cout<<"Caught exception "<<err.what()<<std::endl;
+		passed=false;
+		}
+	
+	unlink(bilFileName);
+	
+	return passed?0:1;
+	}
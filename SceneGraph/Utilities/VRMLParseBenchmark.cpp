@@ -0,0 +1,245 @@
+/***********************************************************************
+VRMLParseBenchmark - Program to measure the throughput of the VRML
+parser on large generated indexed face sets, and to check that bulk
+parsing of numeric multi-valued fields produces the same scene graphs as
+parsing them one value at a time.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Simple Scene Graph Renderer (SceneGraph).
+
+The Simple Scene Graph Renderer is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Simple Scene Graph Renderer is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Simple Scene Graph Renderer; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <Realtime/Time.h>
+#include <IO/OpenFile.h>
+#include <SceneGraph/GroupNode.h>
+#include <SceneGraph/ShapeNode.h>
+#include <SceneGraph/CoordinateNode.h>
+#include <SceneGraph/ColorNode.h>
+#include <SceneGraph/IndexedFaceSetNode.h>
+#include <SceneGraph/NodeCreator.h>
+#include <SceneGraph/VRMLFile.h>
+
+/****************
+Helper functions:
+****************/
+
+std::vector<unsigned int> parseList(const char* list) // Parses a comma-separated list of unsigned integers
+	{
+	std::vector<unsigned int> result;
+	const char* lPtr=list;
+	while(*lPtr!='\0')
+		{
+		char* endPtr;
+		result.push_back((unsigned int)(strtoul(lPtr,&endPtr,10)));
+		lPtr=endPtr;
+		if(*lPtr==',')
+			++lPtr;
+		else if(*lPtr!='\0')
+			{
+			result.clear();
+			break;
+			}
+		}
+	return result;
+	}
+
+double randomCoordinate(void) // Returns a random coordinate in [-1000, 1000)
+	{
+	return double(rand())*2000.0/(double(RAND_MAX)+1.0)-1000.0;
+	}
+
+void writeVrmlFile(const char* fileName,unsigned int numPoints) // Writes a VRML file containing an indexed face set with the given number of vertices
+	{
+	FILE* file=fopen(fileName,"w");
+	if(file==0)
+		throw std::runtime_error(std::string("Unable to create file ")+fileName);
+	
+	/* Use a fixed random seed to generate the same file on every run: */
+	srand(1);
+	
+	fprintf(file,"#VRML V2.0 utf8\n\n");
+	fprintf(file,"Shape\n\t{\n\tgeometry IndexedFaceSet\n\t\t{\n");
+	
+	/* Write the vertex positions, using different number formats and an occasional comment: */
+	fprintf(file,"\t\tcoord Coordinate\n\t\t\t{\n\t\t\tpoint\n\t\t\t\t[\n");
+	for(unsigned int i=0;i<numPoints;++i)
+		{
+		if(i%1000==999)
+			fprintf(file,"\t\t\t\t# Vertex %u\n\t\t\t\t%.9g %.6e %.3f,\n",i,randomCoordinate(),randomCoordinate(),randomCoordinate());
+		else
+			fprintf(file,"\t\t\t\t%.6f %.6f %.6f,\n",randomCoordinate(),randomCoordinate(),randomCoordinate());
+		}
+	fprintf(file,"\t\t\t\t]\n\t\t\t}\n");
+	
+	/* Write the vertex colors: */
+	fprintf(file,"\t\tcolor Color\n\t\t\t{\n\t\t\tcolor\n\t\t\t\t[\n");
+	for(unsigned int i=0;i<numPoints;++i)
+		fprintf(file,"\t\t\t\t%.3f %.3f %.3f,\n",double(rand()%1001)/1000.0,double(rand()%1001)/1000.0,double(rand()%1001)/1000.0);
+	fprintf(file,"\t\t\t\t]\n\t\t\t}\n");
+	
+	/* Write the face vertex indices: */
+	fprintf(file,"\t\tcoordIndex\n\t\t\t[\n");
+	for(unsigned int i=0;i+2<numPoints;i+=2)
+		fprintf(file,"\t\t\t%u, %u, %u, -1, %u, %u, %u, -1,\n",i,i+1,i+2,i+2,i+1,i+3<numPoints?i+3:0);
+	fprintf(file,"\t\t\t]\n\t\t}\n\t}\n");
+	
+	fclose(file);
+	}
+
+SceneGraph::IndexedFaceSetNode* parseVrmlFile(const char* fileName,bool bulkParsing,unsigned int numThreads,SceneGraph::GroupNodePointer& root,double& parseTime) // Parses the given VRML file and returns its indexed face set
+	{
+	/* Parse the VRML file into a new root node: */
+	Realtime::TimePointMonotonic parseStart;
+	root=new SceneGraph::GroupNode;
+	SceneGraph::NodeCreator nodeCreator;
+	SceneGraph::VRMLFile vrmlFile(fileName,IO::openFile(fileName),nodeCreator);
+	vrmlFile.setBulkParsing(bulkParsing);
+	vrmlFile.setNumParserThreads(numThreads);
+	vrmlFile.parse(root);
+	parseTime=double(parseStart.setAndDiff());
+	
+	/* Find the indexed face set: */
+	SceneGraph::IndexedFaceSetNode* faceSet=0;
+	if(root->children.getNumValues()==1)
+		{
+		SceneGraph::ShapeNode* shape=dynamic_cast<SceneGraph::ShapeNode*>(root->children.getValue(0).getPointer());
+		if(shape!=0)
+			faceSet=dynamic_cast<SceneGraph::IndexedFaceSetNode*>(shape->geometry.getValue().getPointer());
+		}
+	if(faceSet==0||faceSet->coord.getValue()==0||faceSet->color.getValue()==0)
+		throw std::runtime_error(std::string("Unexpected scene graph structure in ")+fileName);
+	
+	return faceSet;
+	}
+
+template <class ValueParam>
+bool compareValues(const std::vector<ValueParam>& values1,const std::vector<ValueParam>& values2) // Returns true if the two value lists are identical
+	{
+	if(values1.size()!=values2.size())
+		return false;
+	for(size_t i=0;i<values1.size();++i)
+		if(!(values1[i]==values2[i]))
+			return false;
+	return true;
+	}
+
+bool compareFaceSets(const SceneGraph::IndexedFaceSetNode& faceSet1,const SceneGraph::IndexedFaceSetNode& faceSet2) // Returns true if the two indexed face sets have identical vertices, colors, and indices
+	{
+	return compareValues(faceSet1.coord.getValue()->point.getValues(),faceSet2.coord.getValue()->point.getValues())&&
+	       compareValues(faceSet1.color.getValue()->color.getValues(),faceSet2.color.getValue()->color.getValues())&&
+	       compareValues(faceSet1.coordIndex.getValues(),faceSet2.coordIndex.getValues());
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numPoints=1000000;
+	std::vector<unsigned int> threadCounts=parseList("1,2,4,0");
+	unsigned int numRounds=3;
+	const char* fileName="VRMLParseBenchmark.wrl";
+	bool keepFile=false;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"numPoints")==0&&i+1<argc)
+				numPoints=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"threadCounts")==0&&i+1<argc)
+				threadCounts=parseList(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"numRounds")==0&&i+1<argc)
+				numRounds=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"file")==0&&i+1<argc)
+				fileName=argv[++i];
+			else if(strcasecmp(argv[i]+1,"keep")==0)
+				keepFile=true;
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	if(numPoints<3||threadCounts.empty()||numRounds<1)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-numPoints <number of vertices>] [-threadCounts <n1,n2,...>] [-numRounds <number of rounds>] [-file <VRML file name>] [-keep]"<<std::endl;
+		return 1;
+		}
+	
+	int result=0;
+	try
+		{
+		/* Generate the VRML file: */
+		std::cerr<<"Writing "<<numPoints<<" vertices to "<<fileName<<"..."<<std::endl;
+		writeVrmlFile(fileName,numPoints);
+		double fileSize=double(IO::openSeekableFile(fileName)->getSize())/(1024.0*1024.0);
+		
+		/* Parse the file one value at a time to create the reference scene graph: */
+		SceneGraph::GroupNodePointer referenceRoot;
+		double parseTime;
+		SceneGraph::IndexedFaceSetNode* reference=parseVrmlFile(fileName,false,1,referenceRoot,parseTime);
+		
+		/* Print the header of the comma-separated result table; throughput is in MB/s of VRML text: */
+		printf("mode,threads,fileSize_MB,best_s,throughput_MBps,identical\n");
+		
+		/* Measure parsing one value at a time: */
+		double bestTime=parseTime;
+		for(unsigned int round=1;round<numRounds;++round)
+			{
+			SceneGraph::GroupNodePointer root;
+			parseVrmlFile(fileName,false,1,root,parseTime);
+			if(bestTime>parseTime)
+				bestTime=parseTime;
+			}
+		printf("single,1,%.1f,%.3f,%.1f,yes\n",fileSize,bestTime,fileSize/bestTime);
+		fflush(stdout);
+		
+		/* Measure bulk parsing with each number of threads: */
+		for(std::vector<unsigned int>::iterator tcIt=threadCounts.begin();tcIt!=threadCounts.end();++tcIt)
+			{
+			bool identical=true;
+			bestTime=0.0;
+			for(unsigned int round=0;round<numRounds;++round)
+				{
+				SceneGraph::GroupNodePointer root;
+				SceneGraph::IndexedFaceSetNode* faceSet=parseVrmlFile(fileName,true,*tcIt,root,parseTime);
+				if(round==0||bestTime>parseTime)
+					bestTime=parseTime;
+				identical=identical&&compareFaceSets(*faceSet,*reference);
+				}
+			printf("bulk,%u,%.1f,%.3f,%.1f,%s\n",*tcIt,fileSize,bestTime,fileSize/bestTime,identical?"yes":"no");
+			fflush(stdout);
+			if(!identical)
+				result=1;
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		result=1;
+		}
+	
+	/* Clean up: */
+	if(!keepFile)
+		unlink(fileName);
+	
+	return result;
+	}
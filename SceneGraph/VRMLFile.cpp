@@ -23,28 +23,126 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <SceneGraph/VRMLFile.h>
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <Misc/SizedTypes.h>
 #include <Misc/StringPrintf.h>
 #include <Misc/ThrowStdErr.h>
+#include <Misc/StandardMarshallers.h>
+#include <Threads/Thread.h>
+#include <IO/MemMappedFile.h>
 #include <Geometry/ComponentArray.h>
 #include <Geometry/Point.h>
 #include <Geometry/Vector.h>
 #include <Geometry/Rotation.h>
+#include <Geometry/GeometryMarshallers.h>
+#include <GL/GLMarshallers.h>
 #include <SceneGraph/EventTypes.h>
 #include <SceneGraph/NodeCreator.h>
 #include <SceneGraph/GraphNode.h>
+#include <SceneGraph/Internal/InlineLoader.h>
 
 namespace SceneGraph {
 
 namespace {
 
+/***************************************************
+Tags for the structure of binary scene graph caches:
+***************************************************/
+
+enum CacheTag
+	{
+	CACHE_LISTEND=0, // End of a list of node values
+	CACHE_NULLNODE, // Null node value, followed by an optional DEF name
+	CACHE_USENODE, // Reference to a named node, followed by the node's name
+	CACHE_NODE, // New node, followed by an optional DEF name, the node's type name, and the node's fields and routes
+	CACHE_FIELD, // Field of the current node, followed by the field's name and value
+	CACHE_ROUTE, // Route statement, followed by the route's source and sink names
+	CACHE_NODEEND // End of the current node's fields and routes
+	};
+
+/* Identifier at the beginning of binary scene graph caches; changes whenever the cache format changes: */
+const char cacheMagic[16]="VRMLFileCache02";
+
+/**************
+Helper classes:
+**************/
+
+class CacheFile:public IO::File // Class to write binary scene graph caches; discards all data after the first write error instead of throwing exceptions
+	{
+	/* Elements: */
+	private:
+	int fd; // File descriptor of the cache file
+	bool failed; // Flag whether a write error occurred
+	
+	/* Protected methods from IO::File: */
+	protected:
+	virtual void writeData(const Byte* buffer,size_t bufferSize)
+		{
+		/* Write all data in the given buffer unless an earlier write failed: */
+		while(!failed&&bufferSize>0)
+			{
+			ssize_t writeResult=::write(fd,buffer,bufferSize);
+			if(writeResult>0)
+				{
+				buffer+=writeResult;
+				bufferSize-=writeResult;
+				}
+			else if(writeResult==0||errno!=EINTR)
+				failed=true;
+			}
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	CacheFile(const char* fileName)
+		:IO::File(WriteOnly),
+		 fd(open(fileName,O_WRONLY|O_CREAT|O_TRUNC,S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH)),failed(false)
+		{
+		if(fd<0)
+			throw OpenError(Misc::printStdErrMsg("SceneGraph::VRMLFile: Unable to create binary cache %s",fileName));
+		}
+	virtual ~CacheFile(void) // Closes the cache file without writing buffered data
+		{
+		if(fd>=0)
+			::close(fd);
+		}
+	
+	/* Methods: */
+	bool close(void) // Writes all buffered data and closes the cache file; returns false if the cache file is incomplete
+		{
+		flush();
+		bool complete=!failed&&::close(fd)==0;
+		fd=-1;
+		return complete;
+		}
+	};
+
+/****************
+Helper functions:
+****************/
+
+inline Misc::SInt64 getModTimeNsec(const struct stat& fileStat) // Returns the nanosecond part of a file's modification time
+	{
+	#ifdef __APPLE__
+	return Misc::SInt64(fileStat.st_mtimespec.tv_nsec);
+	#else
+	return Misc::SInt64(fileStat.st_mtim.tv_nsec);
+	#endif
+	}
+
 /*************************************************************************
-Helper function to parse route statements (will move into VRMLFile class):
+Helper functions to parse route statements (will move into VRMLFile class):
 *************************************************************************/
 
-void parseRoute(VRMLFile& vrmlFile)
+void createRoute(VRMLFile& vrmlFile,const std::string& sourceName,const std::string& sinkName)
 	{
-	/* Read the event source name: */
-	const char* source=vrmlFile.readNextToken();
+	const char* source=sourceName.c_str();
 	
 	/* Split the event source into node name and field name: */
 	const char* periodPtr=0;
@@ -70,13 +168,7 @@ void parseRoute(VRMLFile& vrmlFile)
 		throw VRMLFile::ParseError(vrmlFile,Misc::stringPrintf("unknown field \"%s\" in event source",periodPtr+1));
 		}
 	
-	/* Check the TO keyword: */
-	vrmlFile.readNextToken();
-	if(!vrmlFile.isToken("TO"))
-		throw VRMLFile::ParseError(vrmlFile,"missing TO keyword in route definition");
-		
-	/* Read the event sink name: */
-	const char* sink=vrmlFile.readNextToken();
+	const char* sink=sinkName.c_str();
 	
 	/* Split the event sink into node name and field name: */
 	periodPtr=0;
@@ -117,6 +209,32 @@ void parseRoute(VRMLFile& vrmlFile)
 	delete route;
 	}
 
+void parseRoute(VRMLFile& vrmlFile)
+	{
+	/* Read the event source name: */
+	std::string source=vrmlFile.readNextToken();
+	
+	/* Check the TO keyword: */
+	vrmlFile.readNextToken();
+	if(!vrmlFile.isToken("TO"))
+		throw VRMLFile::ParseError(vrmlFile,"missing TO keyword in route definition");
+	
+	/* Read the event sink name: */
+	std::string sink=vrmlFile.readNextToken();
+	
+	/* Create the route: */
+	createRoute(vrmlFile,source,sink);
+	
+	/* Write the route to the binary cache: */
+	IO::File* cache=vrmlFile.getCacheWriter();
+	if(cache!=0)
+		{
+		cache->write<Misc::UInt8>(CACHE_ROUTE);
+		Misc::Marshaller<std::string>::write(source,*cache);
+		Misc::Marshaller<std::string>::write(sink,*cache);
+		}
+	}
+
 /********************************************************************
 Helper functions to parse floating-point values and component arrays:
 ********************************************************************/
@@ -164,6 +282,218 @@ parseComponentArray(
 		}
 	}
 
+/*********************************************************************
+Helper functions and classes to parse lists of numbers in bulk directly
+from character buffers:
+*********************************************************************/
+
+inline
+bool
+isNumberSeparator(
+	char c)
+	{
+	/* Numbers are separated by whitespace and commas: */
+	return c==' '||c=='\n'||c==','||c=='\t'||c=='\r'||c=='\v'||c=='\f';
+	}
+
+inline
+const char*
+getNumberTypeName(
+	int)
+	{
+	return "integer";
+	}
+
+inline
+const char*
+getNumberTypeName(
+	double)
+	{
+	return "floating-point";
+	}
+
+bool
+parseNumber(
+	const char* begin,
+	const char* end,
+	int& value)
+	{
+	/* Parse short decimal integers directly: */
+	const char* cPtr=begin;
+	bool negative=*cPtr=='-';
+	if(*cPtr=='-'||*cPtr=='+')
+		++cPtr;
+	if(cPtr!=end&&end-cPtr<=9)
+		{
+		long result=0;
+		for(;cPtr!=end&&*cPtr>='0'&&*cPtr<='9';++cPtr)
+			result=result*10+long(*cPtr-'0');
+		if(cPtr==end)
+			{
+			value=int(negative?-result:result);
+			return true;
+			}
+		}
+	
+	/* Parse all other tokens like single values to get identical results: */
+	std::string token(begin,end);
+	char* endPtr=0;
+	value=int(strtol(token.c_str(),&endPtr,10));
+	return endPtr==token.c_str()+token.size();
+	}
+
+bool
+parseNumber(
+	const char* begin,
+	const char* end,
+	double& value)
+	{
+	/* Powers of ten that are exactly representable as double-precision numbers: */
+	static const double powersOfTen[23]=
+		{
+		1.0e0,1.0e1,1.0e2,1.0e3,1.0e4,1.0e5,1.0e6,1.0e7,1.0e8,1.0e9,1.0e10,1.0e11,
+		1.0e12,1.0e13,1.0e14,1.0e15,1.0e16,1.0e17,1.0e18,1.0e19,1.0e20,1.0e21,1.0e22
+		};
+	
+	/* Parse the sign: */
+	const char* cPtr=begin;
+	bool negative=*cPtr=='-';
+	if(*cPtr=='-'||*cPtr=='+')
+		++cPtr;
+	
+	/* Parse the integer and fractional digits into a decimal mantissa and exponent: */
+	Misc::UInt64 mantissa=0;
+	int numSignificantDigits=0;
+	int exponent=0;
+	bool haveDigits=false;
+	for(;cPtr!=end&&*cPtr>='0'&&*cPtr<='9';++cPtr)
+		{
+		mantissa=mantissa*10U+Misc::UInt64(*cPtr-'0');
+		if(mantissa!=0U)
+			++numSignificantDigits;
+		haveDigits=true;
+		}
+	if(cPtr!=end&&*cPtr=='.')
+		{
+		for(++cPtr;cPtr!=end&&*cPtr>='0'&&*cPtr<='9';++cPtr)
+			{
+			mantissa=mantissa*10U+Misc::UInt64(*cPtr-'0');
+			if(mantissa!=0U)
+				++numSignificantDigits;
+			--exponent;
+			haveDigits=true;
+			}
+		}
+	
+	/* Parse the optional exponent: */
+	if(haveDigits&&cPtr!=end&&(*cPtr=='e'||*cPtr=='E'))
+		{
+		++cPtr;
+		bool negativeExponent=cPtr!=end&&*cPtr=='-';
+		if(cPtr!=end&&(*cPtr=='-'||*cPtr=='+'))
+			++cPtr;
+		if(cPtr!=end&&*cPtr>='0'&&*cPtr<='9')
+			{
+			int e=0;
+			for(;cPtr!=end&&*cPtr>='0'&&*cPtr<='9';++cPtr)
+				if(e<10000)
+					e=e*10+(*cPtr-'0');
+			exponent+=negativeExponent?-e:e;
+			}
+		else
+			haveDigits=false;
+		}
+	
+	/*********************************************************************
+	If the mantissa and the power of ten are both exactly representable,
+	multiplying or dividing them yields the correctly rounded value, which
+	is exactly what strtod returns.
+	*********************************************************************/
+	
+	if(haveDigits&&cPtr==end&&numSignificantDigits<=19&&mantissa<=(Misc::UInt64(1)<<53)&&exponent>=-22&&exponent<=22)
+		{
+		double result=double(mantissa);
+		if(exponent>=0)
+			result*=powersOfTen[exponent];
+		else
+			result/=powersOfTen[-exponent];
+		value=negative?-result:result;
+		return true;
+		}
+	
+	/* Parse all other tokens like single values to get identical results: */
+	std::string token(begin,end);
+	char* endPtr=0;
+	value=strtod(token.c_str(),&endPtr);
+	return endPtr==token.c_str()+token.size();
+	}
+
+inline
+bool
+parseNumber(
+	const char* begin,
+	const char* end,
+	float& value)
+	{
+	/* Parse the number in double precision and convert it like single values: */
+	double result;
+	bool ok=parseNumber(begin,end,result);
+	value=float(result);
+	return ok;
+	}
+
+template <class NumberParam>
+class NumberListParser // Class to parse a range of a bracketed list of numbers, potentially in a background thread
+	{
+	/* Elements: */
+	public:
+	const char* begin; // Beginning of the text range
+	const char* end; // End of the text range
+	std::vector<NumberParam> numbers; // Numbers parsed from the text range
+	size_t numLines; // Number of newlines skipped while parsing the text range
+	const char* errorBegin; // Beginning of the first token that could not be parsed, or null
+	const char* errorEnd; // End of the first token that could not be parsed
+	
+	/* Constructors and destructors: */
+	NumberListParser(void)
+		:begin(0),end(0),numLines(0),errorBegin(0),errorEnd(0)
+		{
+		}
+	
+	/* Methods: */
+	void* parse(void) // Parses the text range until its end or the first invalid token
+		{
+		const char* cPtr=begin;
+		while(true)
+			{
+			/* Skip separators while counting lines: */
+			for(;cPtr!=end&&isNumberSeparator(*cPtr);++cPtr)
+				if(*cPtr=='\n')
+					++numLines;
+			if(cPtr==end)
+				break;
+			
+			/* Find the end of the next token: */
+			const char* tokenEnd;
+			for(tokenEnd=cPtr+1;tokenEnd!=end&&!isNumberSeparator(*tokenEnd);++tokenEnd)
+				;
+			
+			/* Parse the token: */
+			NumberParam number;
+			if(!parseNumber(cPtr,tokenEnd,number))
+				{
+				errorBegin=cPtr;
+				errorEnd=tokenEnd;
+				break;
+				}
+			numbers.push_back(number);
+			cPtr=tokenEnd;
+			}
+		
+		return 0;
+		}
+	};
+
 /***********************************************************
 Templatized helper class to parse values from token sources:
 ***********************************************************/
@@ -345,6 +675,15 @@ class ValueParser<NodePointer>
 		{
 		NodePointer result;
 		
+		/* Read the node from the binary cache if there is one: */
+		if(vrmlFile.getCacheReader()!=0)
+			{
+			if(!vrmlFile.readCachedNode(result))
+				throw VRMLFile::ParseError(vrmlFile,"Corrupted binary cache");
+			return result;
+			}
+		IO::File* cache=vrmlFile.getCacheWriter();
+		
 		/* Read the node type name: */
 		vrmlFile.readNextToken();
 		if(vrmlFile.isToken("ROUTE"))
@@ -355,7 +694,15 @@ class ValueParser<NodePointer>
 		else if(vrmlFile.isToken("USE"))
 			{
 			/* Retrieve a named node from the VRML file: */
-			result=vrmlFile.useNode(vrmlFile.readNextToken());
+			std::string nodeName=vrmlFile.readNextToken();
+			result=vrmlFile.useNode(nodeName.c_str());
+			
+			/* Write the node reference to the binary cache: */
+			if(cache!=0)
+				{
+				cache->write<Misc::UInt8>(CACHE_USENODE);
+				Misc::Marshaller<std::string>::write(nodeName,*cache);
+				}
 			}
 		else
 			{
@@ -376,6 +723,15 @@ class ValueParser<NodePointer>
 				if((result=vrmlFile.createNode(vrmlFile.getToken()))==0)
 					throw VRMLFile::ParseError(vrmlFile,Misc::stringPrintf("Unknown node type %s",vrmlFile.getToken()));
 				
+				/* Write the node's header to the binary cache: */
+				if(cache!=0)
+					{
+					cache->write<Misc::UInt8>(CACHE_NODE);
+					Misc::Marshaller<std::string>::write(defName,*cache);
+					Misc::Marshaller<std::string>::write(std::string(vrmlFile.getToken()),*cache);
+					}
+				vrmlFile.enterNode(result.getPointer());
+				
 				/* Check for and skip the opening brace: */
 				vrmlFile.readNextToken();
 				if(!vrmlFile.isToken("{"))
@@ -392,6 +748,13 @@ class ValueParser<NodePointer>
 						}
 					else
 						{
+						/* Write the field's name to the binary cache; the field's value follows: */
+						if(cache!=0)
+							{
+							cache->write<Misc::UInt8>(CACHE_FIELD);
+							Misc::Marshaller<std::string>::write(std::string(vrmlFile.getToken()),*cache);
+							}
+						
 						/* Parse a field value: */
 						result->parseField(vrmlFile.getToken(),vrmlFile);
 						}
@@ -401,10 +764,19 @@ class ValueParser<NodePointer>
 				if(vrmlFile.eof())
 					throw VRMLFile::ParseError(vrmlFile,"Missing closing brace in node definition");
 				vrmlFile.readNextToken();
+				if(cache!=0)
+					cache->write<Misc::UInt8>(CACHE_NODEEND);
 				
 				/* Finalize the node: */
+				vrmlFile.leaveNode();
 				result->update();
 				}
+			else if(cache!=0)
+				{
+				/* Write the null node to the binary cache: */
+				cache->write<Misc::UInt8>(CACHE_NULLNODE);
+				Misc::Marshaller<std::string>::write(defName,*cache);
+				}
 			
 			if(!defName.empty())
 				{
@@ -417,6 +789,301 @@ class ValueParser<NodePointer>
 		}
 	};
 
+/********************************************************************
+Templatized helper class to assemble values from lists of components:
+********************************************************************/
+
+template <class ValueParam>
+class ValueComponents // Generic class for value types that cannot be parsed in bulk
+	{
+	};
+
+template <>
+class ValueComponents<int>
+	{
+	/* Embedded classes: */
+	public:
+	typedef int Component;
+	static const int numComponents=1;
+	
+	/* Methods: */
+	static int makeValue(const Component* components)
+		{
+		return components[0];
+		}
+	};
+
+template <>
+class ValueComponents<Scalar>
+	{
+	/* Embedded classes: */
+	public:
+	typedef Scalar Component;
+	static const int numComponents=1;
+	
+	/* Methods: */
+	static Scalar makeValue(const Component* components)
+		{
+		return components[0];
+		}
+	};
+
+template <>
+class ValueComponents<double>
+	{
+	/* Embedded classes: */
+	public:
+	typedef double Component;
+	static const int numComponents=1;
+	
+	/* Methods: */
+	static double makeValue(const Component* components)
+		{
+		return components[0];
+		}
+	};
+
+template <class ComponentArrayParam>
+class ComponentArrayComponents // Helper class for value types derived from component arrays
+	{
+	/* Embedded classes: */
+	public:
+	typedef typename ComponentArrayParam::Scalar Component;
+	static const int numComponents=ComponentArrayParam::dimension;
+	
+	/* Methods: */
+	static ComponentArrayParam makeValue(const Component* components)
+		{
+		ComponentArrayParam result;
+		for(int i=0;i<numComponents;++i)
+			result[i]=components[i];
+		return result;
+		}
+	};
+
+template <>
+class ValueComponents<Size>:public ComponentArrayComponents<Size>
+	{
+	};
+
+template <class ScalarParam>
+class ValueComponents<Geometry::Point<ScalarParam,3> >:public ComponentArrayComponents<Geometry::Point<ScalarParam,3> >
+	{
+	};
+
+template <class ScalarParam>
+class ValueComponents<Geometry::Vector<ScalarParam,3> >:public ComponentArrayComponents<Geometry::Vector<ScalarParam,3> >
+	{
+	};
+
+template <>
+class ValueComponents<TexCoord>:public ComponentArrayComponents<TexCoord>
+	{
+	};
+
+template <>
+class ValueComponents<Rotation>
+	{
+	/* Embedded classes: */
+	public:
+	typedef Rotation::Scalar Component;
+	static const int numComponents=4;
+	
+	/* Methods: */
+	static Rotation makeValue(const Component* components)
+		{
+		/* Assemble the rotation from its axis and angle: */
+		return Rotation::rotateAxis(Rotation::Vector(components),components[3]);
+		}
+	};
+
+template <class ScalarParam,int numComponentsParam>
+class ValueComponents<GLColor<ScalarParam,numComponentsParam> >
+	{
+	/* Embedded classes: */
+	public:
+	typedef ScalarParam Component;
+	static const int numComponents=numComponentsParam;
+	
+	/* Methods: */
+	static GLColor<ScalarParam,numComponentsParam> makeValue(const Component* components)
+		{
+		GLColor<ScalarParam,numComponentsParam> result;
+		for(int i=0;i<numComponentsParam;++i)
+			result[i]=components[i];
+		return result;
+		}
+	};
+
+/***********************************************************************
+Templatized helper class to parse bracketed lists of values from token
+sources:
+***********************************************************************/
+
+template <class ValueParam>
+inline
+void
+parseSingleValues(
+	MF<ValueParam>& field,
+	VRMLFile& vrmlFile)
+	{
+	/* Read a list of values: */
+	while(!vrmlFile.eof()&&vrmlFile.peekc()!=']')
+		{
+		/* Read a single value: */
+		field.appendValue(ValueParser<ValueParam>::parseValue(vrmlFile));
+		}
+	
+	/* Skip the closing bracket: */
+	if(vrmlFile.eof())
+		throw VRMLFile::ParseError(vrmlFile,"Missing closing bracket in multi-valued field");
+	vrmlFile.readNextToken();
+	}
+
+template <class ValueParam>
+class ValueListParser // Generic class to parse lists of values one value at a time
+	{
+	/* Methods: */
+	public:
+	static void parseValueList(MF<ValueParam>& field,VRMLFile& vrmlFile)
+		{
+		parseSingleValues(field,vrmlFile);
+		}
+	static void writeCachedValues(const MF<ValueParam>& field,IO::File& cache)
+		{
+		/* Write the number of values followed by the values: */
+		const typename MF<ValueParam>::ValueList& values=field.getValues();
+		cache.write<Misc::UInt32>(Misc::UInt32(values.size()));
+		for(typename MF<ValueParam>::ValueList::const_iterator vIt=values.begin();vIt!=values.end();++vIt)
+			Misc::Marshaller<ValueParam>::write(*vIt,cache);
+		}
+	static void readCachedValues(MF<ValueParam>& field,IO::File& cache)
+		{
+		/* Read the number of values followed by the values: */
+		size_t numValues=cache.read<Misc::UInt32>();
+		typename MF<ValueParam>::ValueList& values=field.getValues();
+		values.reserve(numValues);
+		for(size_t i=0;i<numValues;++i)
+			values.push_back(Misc::Marshaller<ValueParam>::read(cache));
+		}
+	};
+
+template <class ValueParam>
+class NumericValueListParser // Class to parse lists of numeric values in bulk
+	{
+	/* Methods: */
+	public:
+	static void parseValueList(MF<ValueParam>& field,VRMLFile& vrmlFile)
+		{
+		typedef ValueComponents<ValueParam> VC;
+		
+		if(vrmlFile.getBulkParsing())
+			{
+			/* Parse the list's value components in bulk: */
+			std::vector<typename VC::Component> components;
+			vrmlFile.parseNumberList(components);
+			if(components.size()%VC::numComponents!=0)
+				throw VRMLFile::ParseError(vrmlFile,"Incomplete value in multi-valued field");
+			
+			/* Assemble the field's values: */
+			typename MF<ValueParam>::ValueList& values=field.getValues();
+			values.reserve(components.size()/VC::numComponents);
+			const typename VC::Component* cEnd=components.empty()?0:&components[0]+components.size();
+			for(const typename VC::Component* cPtr=components.empty()?0:&components[0];cPtr!=cEnd;cPtr+=VC::numComponents)
+				values.push_back(VC::makeValue(cPtr));
+			}
+		else
+			parseSingleValues(field,vrmlFile);
+		}
+	static void writeCachedValues(const MF<ValueParam>& field,IO::File& cache)
+		{
+		typedef ValueComponents<ValueParam> VC;
+		
+		/* Write the number of values: */
+		const typename MF<ValueParam>::ValueList& values=field.getValues();
+		cache.write<Misc::UInt32>(Misc::UInt32(values.size()));
+		
+		/* Write the values' components as one array if the values are tightly packed: */
+		if(sizeof(ValueParam)==VC::numComponents*sizeof(typename VC::Component))
+			{
+			if(!values.empty())
+				cache.write(reinterpret_cast<const typename VC::Component*>(&values[0]),values.size()*VC::numComponents);
+			}
+		else
+			{
+			for(typename MF<ValueParam>::ValueList::const_iterator vIt=values.begin();vIt!=values.end();++vIt)
+				Misc::Marshaller<ValueParam>::write(*vIt,cache);
+			}
+		}
+	static void readCachedValues(MF<ValueParam>& field,IO::File& cache)
+		{
+		typedef ValueComponents<ValueParam> VC;
+		
+		/* Read the number of values: */
+		size_t numValues=cache.read<Misc::UInt32>();
+		typename MF<ValueParam>::ValueList& values=field.getValues();
+		
+		/* Read the values' components as one array if the values are tightly packed: */
+		if(sizeof(ValueParam)==VC::numComponents*sizeof(typename VC::Component))
+			{
+			values.resize(numValues);
+			if(numValues!=0)
+				cache.read(reinterpret_cast<typename VC::Component*>(&values[0]),numValues*VC::numComponents);
+			}
+		else
+			{
+			values.reserve(numValues);
+			for(size_t i=0;i<numValues;++i)
+				values.push_back(Misc::Marshaller<ValueParam>::read(cache));
+			}
+		}
+	};
+
+template <>
+class ValueListParser<int>:public NumericValueListParser<int>
+	{
+	};
+
+template <>
+class ValueListParser<Scalar>:public NumericValueListParser<Scalar>
+	{
+	};
+
+template <>
+class ValueListParser<double>:public NumericValueListParser<double>
+	{
+	};
+
+template <>
+class ValueListParser<Size>:public NumericValueListParser<Size>
+	{
+	};
+
+template <class ScalarParam>
+class ValueListParser<Geometry::Point<ScalarParam,3> >:public NumericValueListParser<Geometry::Point<ScalarParam,3> >
+	{
+	};
+
+template <class ScalarParam>
+class ValueListParser<Geometry::Vector<ScalarParam,3> >:public NumericValueListParser<Geometry::Vector<ScalarParam,3> >
+	{
+	};
+
+template <>
+class ValueListParser<Rotation>:public NumericValueListParser<Rotation>
+	{
+	};
+
+template <class ScalarParam,int numComponentsParam>
+class ValueListParser<GLColor<ScalarParam,numComponentsParam> >:public NumericValueListParser<GLColor<ScalarParam,numComponentsParam> >
+	{
+	};
+
+template <>
+class ValueListParser<TexCoord>:public NumericValueListParser<TexCoord>
+	{
+	};
+
 /***********************************************************
 Templatized helper class to parse fields from token sources:
 ***********************************************************/
@@ -437,8 +1104,32 @@ class FieldParser<SF<ValueParam> >
 	public:
 	static void parseField(SF<ValueParam>& field,VRMLFile& vrmlFile)
 		{
-		/* Just read the field's value: */
-		field.setValue(ValueParser<ValueParam>::parseValue(vrmlFile));
+		if(vrmlFile.getCacheReader()!=0)
+			{
+			/* Read the field's value from the binary cache: */
+			field.setValue(Misc::Marshaller<ValueParam>::read(*vrmlFile.getCacheReader()));
+			}
+		else
+			{
+			/* Just read the field's value: */
+			field.setValue(ValueParser<ValueParam>::parseValue(vrmlFile));
+			
+			/* Write the field's value to the binary cache: */
+			if(vrmlFile.getCacheWriter()!=0)
+				Misc::Marshaller<ValueParam>::write(field.getValue(),*vrmlFile.getCacheWriter());
+			}
+		}
+	};
+
+template <>
+class FieldParser<SFNode>
+	{
+	/* Methods: */
+	public:
+	static void parseField(SFNode& field,VRMLFile& vrmlFile)
+		{
+		/* Node values are written to and read from binary caches as they are parsed: */
+		vrmlFile.parseSFNode(field);
 		}
 	};
 
@@ -456,29 +1147,43 @@ class FieldParser<MF<ValueParam> >
 		/* Clear the field: */
 		field.clearValues();
 		
+		if(vrmlFile.getCacheReader()!=0)
+			{
+			/* Read the field's values from the binary cache: */
+			ValueListParser<ValueParam>::readCachedValues(field,*vrmlFile.getCacheReader());
+			return;
+			}
+		
 		/* Check for opening bracket: */
 		if(vrmlFile.peekc()=='[')
 			{
 			/* Skip the opening bracket: */
 			vrmlFile.readNextToken();
 			
-			/* Read a list of values: */
-			while(!vrmlFile.eof()&&vrmlFile.peekc()!=']')
-				{
-				/* Read a single value: */
-				field.appendValue(ValueParser<ValueParam>::parseValue(vrmlFile));
-				}
-			
-			/* Skip the closing bracket: */
-			if(vrmlFile.eof())
-				throw VRMLFile::ParseError(vrmlFile,"Missing closing bracket in multi-valued field");
-			vrmlFile.readNextToken();
+			/* Read a list of values up to and including the closing bracket: */
+			ValueListParser<ValueParam>::parseValueList(field,vrmlFile);
 			}
 		else
 			{
 			/* Read a single value: */
 			field.appendValue(ValueParser<ValueParam>::parseValue(vrmlFile));
 			}
+		
+		/* Write the field's values to the binary cache: */
+		if(vrmlFile.getCacheWriter()!=0)
+			ValueListParser<ValueParam>::writeCachedValues(field,*vrmlFile.getCacheWriter());
+		}
+	};
+
+template <>
+class FieldParser<MFNode>
+	{
+	/* Methods: */
+	public:
+	static void parseField(MFNode& field,VRMLFile& vrmlFile)
+		{
+		/* Node values are written to and read from binary caches as they are parsed: */
+		vrmlFile.parseMFNode(field);
 		}
 	};
 
@@ -493,17 +1198,84 @@ VRMLFile::ParseError::ParseError(const VRMLFile& vrmlFile,std::string error)
 	{
 	}
 
+/*********************************
+Static elements of class VRMLFile:
+*********************************/
+
+std::string VRMLFile::cacheDirectory(getenv("SCENEGRAPH_VRMLCACHEDIR")!=0?getenv("SCENEGRAPH_VRMLCACHEDIR"):"");
+
 /*************************
 Methods of class VRMLFile:
 *************************/
 
+void VRMLFile::openCache(void)
+	{
+	try
+		{
+		/* Identify the VRML file by its absolute path, modification time, and size: */
+		char sourcePath[PATH_MAX];
+		struct stat sourceStat;
+		if(realpath(sourceUrl.c_str(),sourcePath)==0||stat(sourcePath,&sourceStat)!=0)
+			return;
+		
+		/* Name the cache after a hash of the VRML file's absolute path: */
+		Misc::UInt64 hash=14695981039346656037ULL;
+		for(const char* spPtr=sourcePath;*spPtr!='\0';++spPtr)
+			hash=(hash^Misc::UInt64((unsigned char)*spPtr))*1099511628211ULL;
+		cacheFileName=Misc::stringPrintf("%s/%016llx.vrmlcache",cacheDirectory.c_str(),(unsigned long long)hash);
+		
+		/* Check if there is an up-to-date cache for the VRML file: */
+		struct stat cacheStat;
+		if(stat(cacheFileName.c_str(),&cacheStat)==0)
+			{
+			IO::FilePtr cache=new IO::MemMappedFile(cacheFileName.c_str());
+			cache->setEndianness(Misc::LittleEndian);
+			char magic[sizeof(cacheMagic)];
+			cache->read(magic,sizeof(magic));
+			if(memcmp(magic,cacheMagic,sizeof(cacheMagic))==0&&
+			   Misc::Marshaller<std::string>::read(*cache)==sourcePath&&
+			   cache->read<Misc::SInt64>()==Misc::SInt64(sourceStat.st_mtime)&&
+			   cache->read<Misc::SInt64>()==getModTimeNsec(sourceStat)&&
+			   cache->read<Misc::UInt64>()==Misc::UInt64(sourceStat.st_size))
+				{
+				/* Read the scene graph from the cache: */
+				cacheReader=cache;
+				return;
+				}
+			}
+		
+		/* Write a new cache to a temporary file, which replaces the cache file once parsing succeeds: */
+		cacheWriterFileName=Misc::stringPrintf("%s.%d",cacheFileName.c_str(),int(getpid()));
+		cacheWriter=new CacheFile(cacheWriterFileName.c_str());
+		cacheWriter->setEndianness(Misc::LittleEndian);
+		cacheWriter->write(cacheMagic,sizeof(cacheMagic));
+		Misc::Marshaller<std::string>::write(std::string(sourcePath),*cacheWriter);
+		cacheWriter->write<Misc::SInt64>(Misc::SInt64(sourceStat.st_mtime));
+		cacheWriter->write<Misc::SInt64>(getModTimeNsec(sourceStat));
+		cacheWriter->write<Misc::UInt64>(Misc::UInt64(sourceStat.st_size));
+		}
+	catch(std::runtime_error err)
+		{
+		/* Disable caching on any errors: */
+		cacheReader=0;
+		if(cacheWriter!=0)
+			{
+			cacheWriter=0;
+			unlink(cacheWriterFileName.c_str());
+			}
+		cacheWriterFileName.clear();
+		}
+	}
+
 VRMLFile::VRMLFile(std::string sSourceUrl,IO::FilePtr sSource,NodeCreator& sNodeCreator,Cluster::Multiplexer* sMultiplexer)
 	:IO::TokenSource(sSource),
 	 sourceUrl(sSourceUrl),
 	 nodeCreator(sNodeCreator),
 	 multiplexer(sMultiplexer),
 	 nodeMap(101),
-	 currentLine(1)
+	 currentLine(1),
+	 bulkParsing(true),numParserThreads(0),
+	 asyncInlineLoading(true),inlineLoader(0),ownInlineLoader(false)
 	{
 	/* Initialize the token source: */
 	setWhitespace(',',true); // Comma is treated as whitespace
@@ -529,18 +1301,226 @@ VRMLFile::VRMLFile(std::string sSourceUrl,IO::FilePtr sSource,NodeCreator& sNode
 	for(std::string::const_iterator suIt=sourceUrl.begin();suIt!=sourceUrl.end();++suIt)
 		if(*suIt=='/')
 			urlPrefix=suIt+1;
+	
+	/* Use a binary cache for the VRML file if caching is enabled and the file is not shared across a cluster: */
+	if(!cacheDirectory.empty()&&multiplexer==0)
+		openCache();
+	}
+
+VRMLFile::~VRMLFile(void)
+	{
+	/* Remove a binary cache that was not completely written; destroying the cache writer discards its buffered data: */
+	if(cacheWriter!=0)
+		{
+		cacheWriter=0;
+		unlink(cacheWriterFileName.c_str());
+		}
+	
+	/* Shut down the inline loader: */
+	if(ownInlineLoader)
+		delete inlineLoader;
 	}
 
 void VRMLFile::parse(GroupNodePointer root)
 	{
-	/* Read nodes until end of file: */
-	while(!eof())
+	if(cacheReader!=0)
+		{
+		/* Remember the parser's state in case the binary cache turns out to be unusable: */
+		size_t numRootChildren=root->children.getValues().size();
+		size_t nodeStackSize=nodeStack.size();
+		
+		try
+			{
+			/* Read top-level nodes from the binary cache up to the end of the list: */
+			NodePointer node;
+			while(readCachedNode(node))
+				{
+				if(node!=0)
+					{
+					GraphNodePointer graphNode(dynamic_cast<GraphNode*>(node.getPointer()));
+					if(graphNode==0)
+						throw ParseError(*this,"Mismatching node type");
+					root->children.appendValue(graphNode);
+					}
+				}
+			}
+		catch(...)
+			{
+			/* Discard all nodes read from the binary cache: */
+			root->children.getValues().resize(numRootChildren);
+			nodeMap.clear();
+			nodeStack.resize(nodeStackSize);
+			
+			/* Remove the binary cache and write a new one while parsing the VRML file, which is still positioned right after its header: */
+			cacheReader=0;
+			unlink(cacheFileName.c_str());
+			openCache();
+			}
+		}
+	
+	if(cacheReader==0)
+		{
+		/* Read nodes until end of file: */
+		while(!eof())
+			{
+			SF<GraphNodePointer> node;
+			parseSFNode(node);
+			if(node.getValue()!=0)
+				root->children.appendValue(node.getValue());
+			}
+		
+		if(cacheWriter!=0)
+			{
+			/* Finish the binary cache: */
+			bool cacheComplete=false;
+			try
+				{
+				writeCacheListEnd();
+				cacheWriter->flush();
+				CacheFile* cacheFile=dynamic_cast<CacheFile*>(cacheWriter.getPointer());
+				cacheComplete=cacheFile!=0&&cacheFile->close();
+				}
+			catch(std::runtime_error err)
+				{
+				/* Disable caching on any write errors: */
+				}
+			cacheWriter=0;
+			
+			/* Move the binary cache into place if it was written completely: */
+			if(!cacheComplete||rename(cacheWriterFileName.c_str(),cacheFileName.c_str())!=0)
+				unlink(cacheWriterFileName.c_str());
+			}
+		}
+	
+	/* Wait for all external VRML files referenced by inline nodes and attach their nodes: */
+	if(ownInlineLoader)
+		inlineLoader->finish();
+	
+	/* Update the root node to account for its new children: */
+	root->update();
+	}
+
+void VRMLFile::setAsyncInlineLoading(bool newAsyncInlineLoading)
+	{
+	asyncInlineLoading=newAsyncInlineLoading;
+	}
+
+void VRMLFile::setInlineLoader(InlineLoader* newInlineLoader,const std::vector<Node*>& newNodeStack)
+	{
+	if(ownInlineLoader)
+		delete inlineLoader;
+	inlineLoader=newInlineLoader;
+	ownInlineLoader=false;
+	nodeStack=newNodeStack;
+	}
+
+void VRMLFile::setCacheDirectory(std::string newCacheDirectory)
+	{
+	cacheDirectory=newCacheDirectory;
+	}
+
+bool VRMLFile::readCachedNode(NodePointer& node)
+	{
+	node=0;
+	IO::File& cache=*cacheReader;
+	switch(cache.read<Misc::UInt8>())
+		{
+		case CACHE_LISTEND:
+			return false;
+		
+		case CACHE_NULLNODE:
+			{
+			/* Read the null node's optional name: */
+			std::string defName=Misc::Marshaller<std::string>::read(cache);
+			if(!defName.empty())
+				defineNode(defName.c_str(),node);
+			break;
+			}
+		
+		case CACHE_USENODE:
+			/* Retrieve a named node: */
+			node=useNode(Misc::Marshaller<std::string>::read(cache).c_str());
+			break;
+		
+		case CACHE_ROUTE:
+			{
+			/* Create a route: */
+			std::string source=Misc::Marshaller<std::string>::read(cache);
+			std::string sink=Misc::Marshaller<std::string>::read(cache);
+			createRoute(*this,source,sink);
+			break;
+			}
+		
+		case CACHE_NODE:
+			{
+			/* Create the node: */
+			std::string defName=Misc::Marshaller<std::string>::read(cache);
+			std::string nodeType=Misc::Marshaller<std::string>::read(cache);
+			if((node=createNode(nodeType.c_str()))==0)
+				throw ParseError(*this,Misc::stringPrintf("Unknown node type %s",nodeType.c_str()));
+			
+			/* Read the node's fields and routes: */
+			enterNode(node.getPointer());
+			while(true)
+				{
+				Misc::UInt8 tag=cache.read<Misc::UInt8>();
+				if(tag==CACHE_FIELD)
+					node->parseField(Misc::Marshaller<std::string>::read(cache).c_str(),*this);
+				else if(tag==CACHE_ROUTE)
+					{
+					std::string source=Misc::Marshaller<std::string>::read(cache);
+					std::string sink=Misc::Marshaller<std::string>::read(cache);
+					createRoute(*this,source,sink);
+					}
+				else if(tag==CACHE_NODEEND)
+					break;
+				else
+					throw ParseError(*this,"Corrupted binary cache");
+				}
+			
+			/* Finalize the node: */
+			leaveNode();
+			node->update();
+			
+			if(!defName.empty())
+				defineNode(defName.c_str(),node);
+			break;
+			}
+		
+		default:
+			throw ParseError(*this,"Corrupted binary cache");
+		}
+	
+	return true;
+	}
+
+void VRMLFile::loadInline(InlineNode* node,const std::string& url)
+	{
+	/* Create an inline loader on the first request: */
+	if(inlineLoader==0)
 		{
-		SF<GraphNodePointer> node;
-		parseSFNode(node);
-		if(node.getValue()!=0)
-			root->children.appendValue(node.getValue());
+		inlineLoader=new InlineLoader(nodeCreator);
+		ownInlineLoader=true;
 		}
+	
+	/* Request the VRML file: */
+	inlineLoader->load(node,url,nodeStack);
+	}
+
+void VRMLFile::writeCacheListEnd(void)
+	{
+	if(cacheWriter!=0)
+		cacheWriter->write<Misc::UInt8>(CACHE_LISTEND);
+	}
+
+void VRMLFile::setBulkParsing(bool newBulkParsing)
+	{
+	bulkParsing=newBulkParsing;
+	}
+
+void VRMLFile::setNumParserThreads(unsigned int newNumParserThreads)
+	{
+	numParserThreads=newNumParserThreads;
 	}
 
 template <class ValueParam>
@@ -561,6 +1541,85 @@ VRMLFile::parseField(
 	FieldParser<FieldParam>::parseField(field,*this);
 	}
 
+template <class NumberParam>
+void
+VRMLFile::parseNumberList(
+	std::vector<NumberParam>& numbers)
+	{
+	/* Read the list's text up to the closing bracket, replacing comments with newlines: */
+	std::vector<char> text;
+	while(true)
+		{
+		IO::TokenSource::readUntil("]#",text);
+		if(IO::TokenSource::peekc()!='#')
+			break;
+		IO::TokenSource::skipLine();
+		text.push_back('\n');
+		}
+	const char* textBegin=text.empty()?0:&text[0];
+	const char* textEnd=textBegin+text.size();
+	
+	/* Determine the number of parsing threads; each thread parses at least 1MB of text: */
+	const size_t minChunkSize=1024*1024;
+	unsigned int numChunks=numParserThreads;
+	if(numChunks==0)
+		{
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		numChunks=numCpus>0?(unsigned int)(numCpus):1U;
+		}
+	if(numChunks>text.size()/minChunkSize)
+		numChunks=text.size()/minChunkSize;
+	if(numChunks<1)
+		numChunks=1;
+	
+	/* Split the text into chunks at number separators: */
+	std::vector<NumberListParser<NumberParam> > chunks(numChunks);
+	chunks[0].begin=textBegin;
+	for(unsigned int i=1;i<numChunks;++i)
+		{
+		const char* split=textBegin+(text.size()*i)/numChunks;
+		if(split<chunks[i-1].begin)
+			split=chunks[i-1].begin;
+		while(split!=textEnd&&!isNumberSeparator(*split))
+			++split;
+		chunks[i-1].end=split;
+		chunks[i].begin=split;
+		}
+	chunks[numChunks-1].end=textEnd;
+	
+	/* Parse the chunks using the calling thread and additional worker threads: */
+	if(numChunks>1)
+		{
+		Threads::Thread* workers=new Threads::Thread[numChunks-1];
+		for(unsigned int i=1;i<numChunks;++i)
+			workers[i-1].start(&chunks[i],&NumberListParser<NumberParam>::parse);
+		chunks[0].parse();
+		
+		/* Wait for all worker threads to finish: */
+		delete[] workers;
+		}
+	else
+		chunks[0].parse();
+	
+	/* Check for parsing errors and collect the parsed numbers in order: */
+	numbers.clear();
+	for(unsigned int i=0;i<numChunks;++i)
+		{
+		currentLine+=chunks[i].numLines;
+		if(chunks[i].errorBegin!=0)
+			throw ParseError(*this,Misc::stringPrintf("%s is not a valid %s value",std::string(chunks[i].errorBegin,chunks[i].errorEnd).c_str(),getNumberTypeName(NumberParam())));
+		if(numChunks==1)
+			numbers.swap(chunks[i].numbers);
+		else
+			numbers.insert(numbers.end(),chunks[i].numbers.begin(),chunks[i].numbers.end());
+		}
+	
+	/* Skip the closing bracket: */
+	if(IO::TokenSource::eof())
+		throw ParseError(*this,"Missing closing bracket in multi-valued field");
+	readNextToken();
+	}
+
 NodePointer VRMLFile::createNode(const char* nodeType)
 	{
 	return nodeCreator.createNode(nodeType);
@@ -600,6 +1659,14 @@ Force instantiation of value parser methods for standard value types:
 
 template NodePointer VRMLFile::parseValue<NodePointer>();
 
+/********************************************************************
+Force instantiation of number list parser methods for standard types:
+********************************************************************/
+
+template void VRMLFile::parseNumberList(std::vector<int>&);
+template void VRMLFile::parseNumberList(std::vector<float>&);
+template void VRMLFile::parseNumberList(std::vector<double>&);
+
 /********************************************************************
 Force instantiation of field parser methods for standard field types:
 ********************************************************************/
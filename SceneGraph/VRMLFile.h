@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #define SCENEGRAPH_VRMLFILE_INCLUDED
 
 #include <string>
+#include <vector>
 #include <stdexcept>
 #include <Misc/StringHashFunctions.h>
 #include <Misc/HashTable.h>
@@ -39,6 +40,8 @@ class Multiplexer;
 }
 namespace SceneGraph {
 class NodeCreator;
+class InlineNode;
+class InlineLoader;
 }
 
 namespace SceneGraph {
@@ -67,8 +70,20 @@ class VRMLFile:public IO::TokenSource
 	Cluster::Multiplexer* multiplexer; // Pointer to a multicast pipe multiplexer when parsing VRML files in a cluster environment
 	NodeMap nodeMap; // Map of named nodes
 	size_t currentLine; // Number of currently processed line
+	bool bulkParsing; // Flag whether bracketed lists of numeric values are parsed in bulk
+	unsigned int numParserThreads; // Maximum number of threads used to parse large lists of numeric values in bulk (0: one per CPU)
+	static std::string cacheDirectory; // Directory holding binary caches of parsed VRML files; caching is disabled if empty
+	IO::FilePtr cacheReader; // Binary cache from which the scene graph is read instead of the VRML file, if valid
+	IO::FilePtr cacheWriter; // Binary cache to which the scene graph is written while the VRML file is parsed
+	std::string cacheFileName; // Name of the binary cache for the VRML file
+	std::string cacheWriterFileName; // Name of the temporary file to which the binary cache is written
+	bool asyncInlineLoading; // Flag whether external VRML files referenced by inline nodes are loaded by background threads
+	InlineLoader* inlineLoader; // Loader for external VRML files referenced by inline nodes; created on demand
+	bool ownInlineLoader; // Flag whether the inline loader belongs to this VRML file, which has to wait for it to finish
+	std::vector<Node*> nodeStack; // Stack of nodes currently being parsed, starting with the nodes enclosing this VRML file if it is loaded for an inline node
 	
 	/* Private methods: */
+	void openCache(void); // Opens an up-to-date binary cache for reading, or a new binary cache for writing
 	void skipExtendedWhitespace(void) // Skips over "extended" whitespace, i.e., line comments and newlines
 		{
 		while(true)
@@ -100,6 +115,7 @@ class VRMLFile:public IO::TokenSource
 	/* Constructors and destructors: */
 	public:
 	VRMLFile(std::string sSourceUrl,IO::FilePtr sSource,NodeCreator& sNodeCreator,Cluster::Multiplexer* sMultiplexer =0); // Creates a VRML parser for the given character source and node creator
+	~VRMLFile(void); // Destroys the parser, removes an incomplete binary cache, and discards unfinished inline loads
 	
 	/* Overloaded methods from IO::TokenSource: */
 	bool eof(void)
@@ -121,11 +137,51 @@ class VRMLFile:public IO::TokenSource
 	/* Main method: */
 	void parse(GroupNodePointer root); // Adds top-level nodes from the VRML file to the given group node
 	
+	/* Methods to configure the parser: */
+	bool getBulkParsing(void) const // Returns true if bracketed lists of numeric values are parsed in bulk
+		{
+		return bulkParsing;
+		}
+	void setBulkParsing(bool newBulkParsing); // Enables or disables bulk parsing of bracketed lists of numeric values; enabled by default
+	void setNumParserThreads(unsigned int newNumParserThreads); // Sets the maximum number of threads used for bulk parsing (0: one per CPU)
+	static const std::string& getCacheDirectory(void) // Returns the directory holding binary caches of parsed VRML files
+		{
+		return cacheDirectory;
+		}
+	bool getAsyncInlineLoading(void) const // Returns true if inline nodes load their external VRML files in the background
+		{
+		return asyncInlineLoading;
+		}
+	void setAsyncInlineLoading(bool newAsyncInlineLoading); // Enables or disables loading external VRML files of inline nodes in the background; enabled by default, but never used when a multiplexer is present
+	void setInlineLoader(InlineLoader* newInlineLoader,const std::vector<Node*>& newNodeStack); // Hands inline nodes to the given shared loader, and sets the nodes enclosing this VRML file
+	static void setCacheDirectory(std::string newCacheDirectory); // Sets the directory holding binary caches for subsequently created parsers; empty string disables caching; initialized from SCENEGRAPH_VRMLCACHEDIR environment variable
+	
 	/* Methods called during parsing: */
+	IO::File* getCacheReader(void) // Returns the binary cache from which the scene graph is read, or null
+		{
+		return cacheReader.getPointer();
+		}
+	IO::File* getCacheWriter(void) // Returns the binary cache to which the scene graph is written, or null
+		{
+		return cacheWriter.getPointer();
+		}
+	bool readCachedNode(NodePointer& node); // Reads a node from the binary cache; returns false at the end of a node list
+	void enterNode(Node* node) // Notifies the parser that the fields of the given node are being parsed
+		{
+		nodeStack.push_back(node);
+		}
+	void leaveNode(void) // Notifies the parser that the fields of the most recently entered node have been parsed
+		{
+		nodeStack.pop_back();
+		}
+	void loadInline(InlineNode* node,const std::string& url); // Loads the VRML file of the given URL in the background and attaches its nodes to the given inline node before parse returns
+	void writeCacheListEnd(void); // Terminates a node list in the binary cache, if one is being written
 	template <class ValueParam>
 	ValueParam parseValue(void); // Parses a value of the given type from the VRML file
 	template <class FieldParam>
 	void parseField(FieldParam& field); // Sets the given field's value by reading from the VRML file
+	template <class NumberParam>
+	void parseNumberList(std::vector<NumberParam>& numbers); // Parses a bracketed list of numbers after its opening bracket was read, up to and including the closing bracket
 	template <class NodePointerParam>
 	void parseSFNode(SF<NodePointerParam>& field) // Parses a single-valued node field
 		{
@@ -145,6 +201,23 @@ class VRMLFile:public IO::TokenSource
 		/* Clear the field: */
 		field.clearValues();
 		
+		if(cacheReader!=0)
+			{
+			/* Read base-class nodes from the binary cache up to the end of the list: */
+			NodePointer node;
+			while(readCachedNode(node))
+				{
+				/* Check if the node type matches: */
+				if(node!=0&&dynamic_cast<typename NodePointerParam::Target*>(node.getPointer())==0)
+					throw ParseError(*this,"Mismatching node type");
+				
+				/* Set the field's node pointer: */
+				field.appendValue(node);
+				}
+			
+			return;
+			}
+		
 		/* Check for opening bracket: */
 		if(peekc()=='[')
 			{
@@ -182,6 +255,9 @@ class VRMLFile:public IO::TokenSource
 			/* Set the field's node pointer: */
 			field.appendValue(node);
 			}
+		
+		/* Terminate the node list in the binary cache: */
+		writeCacheListEnd();
 		}
 	NodeCreator& getNodeCreator(void) // Returns the VRML file's node creator
 		{
@@ -57,6 +57,16 @@ class Atomic
 	
 	/* Methods: */
 	public:
+	Value get(void) // Returns the current value
+		{
+		#if THREADS_CONFIG_HAVE_BUILTIN_ATOMICS
+		__sync_synchronize();
+		return *static_cast<volatile Value*>(&value);
+		#else
+		Spinlock::Lock lock(mutex);
+		return value;
+		#endif
+		}
 	
 	/* Pre-operation methods; return atomic value after operation: */
 	Value preAdd(Value other) // Pre-addition
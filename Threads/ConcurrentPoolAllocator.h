@@ -0,0 +1,391 @@
+/***********************************************************************
+ConcurrentPoolAllocator - Class to quickly allocate and release large
+numbers of objects of identical size from multiple threads, using per-
+thread caches of free allocation slots backed by a lock-free global free
+list.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Portable Threading Library (Threads).
+
+The Portable Threading Library is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Portable Threading Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Portable Threading Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef THREADS_CONCURRENTPOOLALLOCATOR_INCLUDED
+#define THREADS_CONCURRENTPOOLALLOCATOR_INCLUDED
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <Threads/Atomic.h>
+#include <Threads/Mutex.h>
+
+namespace Threads {
+
+template <class ContentParam,size_t pageSizeParam =8192>
+class ConcurrentPoolAllocator
+	{
+	/* Embedded classes: */
+	public:
+	typedef ContentParam Content; // Type of allocated object
+	static const size_t pageSize=pageSizeParam; // Size of memory page in bytes
+	
+	struct Statistics // Structure reporting the allocator's usage statistics
+		{
+		/* Elements: */
+		public:
+		size_t numChunks; // Number of memory chunks allocated by the pool
+		size_t numSlots; // Total number of allocation slots in all memory chunks
+		size_t numThreads; // Number of threads currently owning a slot cache
+		size_t numAllocations; // Total number of allocate calls
+		size_t numFrees; // Total number of free calls
+		size_t numRefills; // Number of times a thread cache was refilled from the global free list
+		size_t numFlushes; // Number of times a thread cache returned excess slots to the global free list
+		
+		/* Constructors and destructors: */
+		Statistics(void)
+			:numChunks(0),numSlots(0),numThreads(0),
+			 numAllocations(0),numFrees(0),numRefills(0),numFlushes(0)
+			{
+			}
+		
+		/* Methods: */
+		size_t getNumUsedSlots(void) const // Returns the number of currently allocated slots
+			{
+			return numAllocations-numFrees;
+			}
+		};
+	
+	private:
+	struct AllocationSlot // Structure representing memory allocation slots
+		{
+		/* Elements: */
+		public:
+		AllocationSlot* succ; // Pointer to next free slot in the same list or batch
+		AllocationSlot* nextBatch; // Pointer to the first slot of the next batch if this slot heads a batch on the global free list
+		};
+	
+	struct Chunk;
+	
+	struct ChunkHeader // Structure for memory chunk headers
+		{
+		/* Elements: */
+		public:
+		Chunk* succ; // Pointer to next chunk in list
+		
+		/* Constructors and destructors: */
+		ChunkHeader(void)
+			:succ(0)
+			{
+			}
+		};
+	
+	struct Chunk // Structure for chunks of memory
+		{
+		/* Elements: */
+		public:
+		ChunkHeader header; // Chunk header
+		char mem[pageSize-sizeof(ChunkHeader)]; // Uninitialized memory in chunk
+		};
+	
+	struct ThreadCache // Structure for a single thread's cache of free allocation slots
+		{
+		/* Elements: */
+		public:
+		ConcurrentPoolAllocator* allocator; // Pointer to the allocator owning the cache
+		AllocationSlot* firstSlot; // Pointer to head of the cache's free allocation slot list
+		size_t numSlots; // Number of slots in the cache's free list
+		size_t numAllocations,numFrees,numRefills,numFlushes; // Usage counters; only modified by the owning thread
+		ThreadCache* pred; // Pointer to previous cache in the allocator's cache list
+		ThreadCache* succ; // Pointer to next cache in the allocator's cache list
+		
+		/* Constructors and destructors: */
+		ThreadCache(ConcurrentPoolAllocator* sAllocator)
+			:allocator(sAllocator),firstSlot(0),numSlots(0),
+			 numAllocations(0),numFrees(0),numRefills(0),numFlushes(0),
+			 pred(0),succ(0)
+			{
+			}
+		};
+	
+	/* Elements: */
+	size_t slotSize; // Size of an allocation slot
+	size_t numSlotsPerChunk; // Number of allocation slots per memory chunk
+	size_t maxCachedSlots; // Maximum number of free slots held in a thread cache before half of them are returned to the global free list
+	pthread_key_t cacheKey; // Key to access the calling thread's slot cache
+	Atomic<AllocationSlot*> globalFreeList; // Pointer to the first slot of the first batch on the lock-free global free list
+	Mutex poolMutex; // Mutex serializing changes to the chunk list and the cache list
+	Chunk* firstChunk; // Pointer to head of chunk list
+	size_t numChunks; // Number of chunks in the chunk list
+	ThreadCache* firstCache; // Pointer to head of list of all thread caches
+	Statistics retiredStatistics; // Usage counters accumulated from the caches of threads that have terminated
+	
+	/* Private methods: */
+	static void destroyCache(void* cache) // Called by the pthreads library when a thread owning a slot cache terminates
+		{
+		ThreadCache* tc=static_cast<ThreadCache*>(cache);
+		tc->allocator->retireCache(tc);
+		}
+	ThreadCache* getCache(void) // Returns the calling thread's slot cache; creates a new cache on first use
+		{
+		ThreadCache* result=static_cast<ThreadCache*>(pthread_getspecific(cacheKey));
+		if(result==0)
+			{
+			/* Create a new cache and link it into the cache list: */
+			result=new ThreadCache(this);
+			{
+			Mutex::Lock poolLock(poolMutex);
+			result->succ=firstCache;
+			if(firstCache!=0)
+				firstCache->pred=result;
+			firstCache=result;
+			}
+			pthread_setspecific(cacheKey,result);
+			}
+		return result;
+		}
+	void pushGlobal(AllocationSlot* firstBatch,AllocationSlot* lastBatch) // Pushes the given chain of slot batches onto the global free list
+		{
+		/*********************************************************************
+		Pushing onto a Treiber stack does not suffer from the ABA problem,
+		because the new head's successor is not read from shared memory.
+		*********************************************************************/
+		
+		AllocationSlot* head=globalFreeList.get();
+		AllocationSlot* oldHead;
+		do
+			{
+			lastBatch->nextBatch=head;
+			oldHead=head;
+			head=globalFreeList.compareAndSwap(oldHead,firstBatch);
+			}
+		while(head!=oldHead);
+		}
+	AllocationSlot* popAllGlobal(void) // Detaches and returns all slot batches on the global free list
+		{
+		/*********************************************************************
+		Detaching the whole list at once avoids the ABA problem of popping
+		single batches, because the old head's successor is never read
+		before the swap.
+		*********************************************************************/
+		
+		AllocationSlot* head=globalFreeList.get();
+		while(head!=0&&!globalFreeList.ifCompareAndSwap(head,0))
+			head=globalFreeList.get();
+		return head;
+		}
+	void growPool(ThreadCache* cache) // Allocates a new memory chunk and adds all its slots to the given cache
+		{
+		/* Allocate a new chunk and link it into the chunk list: */
+		Chunk* newChunk=new Chunk;
+		{
+		Mutex::Lock poolLock(poolMutex);
+		newChunk->header.succ=firstChunk;
+		firstChunk=newChunk;
+		++numChunks;
+		}
+		
+		/* Create a linked list of free allocation slots in the new chunk: */
+		char* slotPtr=newChunk->mem;
+		for(size_t i=0;i<numSlotsPerChunk-1;++i,slotPtr+=slotSize)
+			reinterpret_cast<AllocationSlot*>(slotPtr)->succ=reinterpret_cast<AllocationSlot*>(slotPtr+slotSize);
+		
+		/* Connect the new free list to the cache's free list: */
+		reinterpret_cast<AllocationSlot*>(slotPtr)->succ=cache->firstSlot;
+		cache->firstSlot=reinterpret_cast<AllocationSlot*>(newChunk->mem);
+		cache->numSlots+=numSlotsPerChunk;
+		}
+	void refillCache(ThreadCache* cache) // Refills the given empty cache from the global free list, or by growing the pool
+		{
+		/* Take all batches from the global free list: */
+		AllocationSlot* batch=popAllGlobal();
+		if(batch!=0)
+			{
+			/* Return all but the first batch so that threads that never release slots do not hoard them: */
+			if(batch->nextBatch!=0)
+				{
+				AllocationSlot* lastBatch=batch->nextBatch;
+				while(lastBatch->nextBatch!=0)
+					lastBatch=lastBatch->nextBatch;
+				pushGlobal(batch->nextBatch,lastBatch);
+				}
+			
+			/* Count the slots in the kept batch: */
+			size_t numSlots=1;
+			for(AllocationSlot* sPtr=batch->succ;sPtr!=0;sPtr=sPtr->succ)
+				++numSlots;
+			cache->firstSlot=batch;
+			cache->numSlots=numSlots;
+			++cache->numRefills;
+			}
+		else
+			growPool(cache);
+		}
+	void flushCache(ThreadCache* cache,size_t numKeptSlots) // Returns all but the given number of slots from the given cache to the global free list
+		{
+		if(cache->numSlots<=numKeptSlots)
+			return;
+		
+		/* Find the last slot to keep: */
+		AllocationSlot* first;
+		if(numKeptSlots>0)
+			{
+			AllocationSlot* lastKept=cache->firstSlot;
+			for(size_t i=1;i<numKeptSlots;++i)
+				lastKept=lastKept->succ;
+			first=lastKept->succ;
+			lastKept->succ=0;
+			}
+		else
+			{
+			first=cache->firstSlot;
+			cache->firstSlot=0;
+			}
+		
+		/* Push the returned slots onto the global free list as a single batch: */
+		pushGlobal(first,first);
+		cache->numSlots=numKeptSlots;
+		++cache->numFlushes;
+		}
+	void retireCache(ThreadCache* cache) // Returns all slots of the given cache to the global free list and destroys the cache
+		{
+		flushCache(cache,0);
+		
+		/* Unlink the cache from the cache list and retain its usage counters: */
+		{
+		Mutex::Lock poolLock(poolMutex);
+		if(cache->pred!=0)
+			cache->pred->succ=cache->succ;
+		else
+			firstCache=cache->succ;
+		if(cache->succ!=0)
+			cache->succ->pred=cache->pred;
+		retiredStatistics.numAllocations+=cache->numAllocations;
+		retiredStatistics.numFrees+=cache->numFrees;
+		retiredStatistics.numRefills+=cache->numRefills;
+		retiredStatistics.numFlushes+=cache->numFlushes;
+		}
+		
+		delete cache;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	ConcurrentPoolAllocator(size_t sMaxCachedSlots =0) // Creates an empty memory pool; thread caches hold at most the given number of free slots (0: two chunks' worth); throws exception if the thread cache key can not be created
+		:globalFreeList(0),firstChunk(0),numChunks(0),firstCache(0)
+		{
+		/* Determine size of an allocation slot (allow for very small or oddly-sized content types): */
+		slotSize=sizeof(Content);
+		if(slotSize<sizeof(AllocationSlot)) // Pad slot size for contents smaller than the batch links
+			slotSize=sizeof(AllocationSlot);
+		else if(slotSize%sizeof(AllocationSlot*)!=0) // Pad slot size to properly align links
+			slotSize+=sizeof(AllocationSlot*)-slotSize%sizeof(AllocationSlot*);
+		
+		/* Calculate number of allocation slots per memory chunk: */
+		numSlotsPerChunk=(pageSize-sizeof(ChunkHeader))/slotSize;
+		
+		/* Calculate the thread cache limit; a cache must be able to hold a full new chunk: */
+		maxCachedSlots=sMaxCachedSlots!=0?sMaxCachedSlots:numSlotsPerChunk*2;
+		if(maxCachedSlots<numSlotsPerChunk)
+			maxCachedSlots=numSlotsPerChunk;
+		
+		/* Create the key for the per-thread slot caches: */
+		if(pthread_key_create(&cacheKey,destroyCache)!=0)
+			throw std::runtime_error("Threads::ConcurrentPoolAllocator: Unable to create thread cache key");
+		}
+	private:
+	ConcurrentPoolAllocator(const ConcurrentPoolAllocator& source); // Prohibit copy constructor
+	ConcurrentPoolAllocator& operator=(const ConcurrentPoolAllocator& source); // Prohibit assignment operator
+	public:
+	~ConcurrentPoolAllocator(void) // Destroys pool and releases all allocated memory chunks; no other thread may use the pool during or after destruction
+		{
+		/* Delete the cache key to prevent cache destruction callbacks from terminating threads: */
+		pthread_key_delete(cacheKey);
+		
+		/* Destroy all remaining thread caches: */
+		while(firstCache!=0)
+			{
+			ThreadCache* succ=firstCache->succ;
+			delete firstCache;
+			firstCache=succ;
+			}
+		
+		/* Release all memory chunks: */
+		while(firstChunk!=0)
+			{
+			Chunk* succ=firstChunk->header.succ;
+			delete firstChunk;
+			firstChunk=succ;
+			}
+		}
+	
+	/* Methods: */
+	void* allocate(void) // Allocates an uninitialized slot; can be called from any thread
+		{
+		ThreadCache* cache=getCache();
+		if(cache->firstSlot==0) // The cache ran out of slots
+			refillCache(cache);
+		
+		/* Return the first free slot from the cache: */
+		AllocationSlot* result=cache->firstSlot;
+		cache->firstSlot=result->succ;
+		--cache->numSlots;
+		++cache->numAllocations;
+		return result;
+		}
+	
+	void free(void* item) // Releases a slot; can be called from any thread, not only the one that allocated the slot
+		{
+		ThreadCache* cache=getCache();
+		
+		/* Put the freed slot at the head of the cache's list: */
+		AllocationSlot* newSlot=reinterpret_cast<AllocationSlot*>(item);
+		newSlot->succ=cache->firstSlot;
+		cache->firstSlot=newSlot;
+		++cache->numSlots;
+		++cache->numFrees;
+		
+		/* Return half the cache to the global free list if it grew too large: */
+		if(cache->numSlots>maxCachedSlots)
+			flushCache(cache,maxCachedSlots/2);
+		}
+	
+	void releaseThreadCache(void) // Returns all slots cached by the calling thread to the global free list
+		{
+		ThreadCache* cache=static_cast<ThreadCache*>(pthread_getspecific(cacheKey));
+		if(cache!=0)
+			flushCache(cache,0);
+		}
+	
+	Statistics getStatistics(void) // Returns the allocator's usage statistics; counters of running threads are sampled without synchronization
+		{
+		Mutex::Lock poolLock(poolMutex);
+		Statistics result=retiredStatistics;
+		result.numChunks=numChunks;
+		result.numSlots=numChunks*numSlotsPerChunk;
+		for(const ThreadCache* cPtr=firstCache;cPtr!=0;cPtr=cPtr->succ)
+			{
+			++result.numThreads;
+			result.numAllocations+=cPtr->numAllocations;
+			result.numFrees+=cPtr->numFrees;
+			result.numRefills+=cPtr->numRefills;
+			result.numFlushes+=cPtr->numFlushes;
+			}
+		return result;
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+/***********************************************************************
+TaskPool - Class for pools of worker threads that process index ranges
+in parallel by splitting them into blocks, with the calling thread
+participating in the work.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Portable Threading Library (Threads).
+
+The Portable Threading Library is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Portable Threading Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Portable Threading Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <Threads/TaskPool.h>
+
+#include <unistd.h>
+#include <algorithm>
+
+namespace Threads {
+
+namespace {
+
+/********************************************
+Mutex protecting creation of the shared pool:
+********************************************/
+
+Mutex sharedPoolMutex;
+TaskPool* sharedPool=0;
+
+}
+
+/*************************
+Methods of class TaskPool:
+*************************/
+
+void TaskPool::startThreads(unsigned int concurrency)
+	{
+	/* Determine the number of worker threads; the calling thread works on ranges as well: */
+	if(concurrency==0)
+		{
+		long numCpus=sysconf(_SC_NPROCESSORS_ONLN);
+		concurrency=numCpus>0?(unsigned int)(numCpus):1U;
+		}
+	numThreads=concurrency-1;
+	
+	/* Start the worker threads: */
+	shutdown=false;
+	threads=numThreads>0?new Thread[numThreads]:0;
+	for(unsigned int i=0;i<numThreads;++i)
+		threads[i].start(this,&TaskPool::workerThreadMethod);
+	}
+
+void TaskPool::stopThreads(void)
+	{
+	{
+	Mutex::Lock batchLock(batchMutex);
+	shutdown=true;
+	batchCond.broadcast();
+	}
+	delete[] threads;
+	threads=0;
+	numThreads=0;
+	}
+
+bool TaskPool::claimBlock(TaskPool::Batch* batch,size_t& blockBegin,size_t& blockEnd)
+	{
+	if(batch->next==batch->end)
+		return false;
+	
+	/* Claim the next block: */
+	blockBegin=batch->next;
+	blockEnd=batch->end-blockBegin>batch->blockSize?blockBegin+batch->blockSize:batch->end;
+	batch->next=blockEnd;
+	++batch->numActive;
+	
+	/* Remove an exhausted batch from the queue: */
+	if(batch->next==batch->end)
+		{
+		std::deque<Batch*>::iterator bIt=std::find(batches.begin(),batches.end(),batch);
+		if(bIt!=batches.end())
+			batches.erase(bIt);
+		}
+	
+	return true;
+	}
+
+void* TaskPool::workerThreadMethod(void)
+	{
+	Mutex::Lock batchLock(batchMutex);
+	while(true)
+		{
+		/* Wait for a batch with unclaimed blocks: */
+		while(!shutdown&&batches.empty())
+			batchCond.wait(batchMutex);
+		if(shutdown)
+			break;
+		
+		/* Process the next block of the oldest batch: */
+		Batch* batch=batches.front();
+		size_t blockBegin,blockEnd;
+		claimBlock(batch,blockBegin,blockEnd);
+		batchMutex.unlock();
+		batch->task->process(blockBegin,blockEnd);
+		batchMutex.lock();
+		
+		/* Wake up the batch's caller if this was the last active block: */
+		if(--batch->numActive==0&&batch->next==batch->end)
+			doneCond.broadcast();
+		}
+	
+	return 0;
+	}
+
+TaskPool::TaskPool(unsigned int sConcurrency)
+	:shutdown(false),
+	 numThreads(0),threads(0)
+	{
+	startThreads(sConcurrency);
+	}
+
+TaskPool::~TaskPool(void)
+	{
+	stopThreads();
+	}
+
+TaskPool& TaskPool::getSharedPool(void)
+	{
+	Mutex::Lock sharedPoolLock(sharedPoolMutex);
+	if(sharedPool==0)
+		sharedPool=new TaskPool;
+	return *sharedPool;
+	}
+
+void TaskPool::setConcurrency(unsigned int newConcurrency)
+	{
+	stopThreads();
+	startThreads(newConcurrency);
+	}
+
+void TaskPool::processRange(size_t begin,size_t end,size_t minBlockSize,TaskPool::RangeTask& task)
+	{
+	if(begin>=end)
+		return;
+	
+	/* Split the range into a few blocks per thread to balance uneven work: */
+	size_t blockSize=(end-begin+(numThreads+1)*4-1)/((numThreads+1)*4);
+	if(blockSize<minBlockSize)
+		blockSize=minBlockSize;
+	
+	/* Process small ranges, or all ranges if there are no worker threads, in the calling thread: */
+	if(numThreads==0||end-begin<=blockSize)
+		{
+		task.process(begin,end);
+		return;
+		}
+	
+	/* Queue the range for the worker threads: */
+	Batch batch;
+	batch.task=&task;
+	batch.next=begin;
+	batch.end=end;
+	batch.blockSize=blockSize;
+	batch.numActive=0;
+	Mutex::Lock batchLock(batchMutex);
+	batches.push_back(&batch);
+	batchCond.broadcast();
+	
+	/* Process blocks in the calling thread until all are claimed: */
+	size_t blockBegin,blockEnd;
+	while(claimBlock(&batch,blockBegin,blockEnd))
+		{
+		batchMutex.unlock();
+		task.process(blockBegin,blockEnd);
+		batchMutex.lock();
+		--batch.numActive;
+		}
+	
+	/* Wait for the worker threads to finish their blocks: */
+	while(batch.numActive>0)
+		doneCond.wait(batchMutex);
+	}
+
+}
@@ -0,0 +1,122 @@
+/***********************************************************************
+TaskPool - Class for pools of worker threads that process index ranges
+in parallel by splitting them into blocks, with the calling thread
+participating in the work.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Portable Threading Library (Threads).
+
+The Portable Threading Library is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Portable Threading Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Portable Threading Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef THREADS_TASKPOOL_INCLUDED
+#define THREADS_TASKPOOL_INCLUDED
+
+#include <stddef.h>
+#include <deque>
+#include <Threads/Mutex.h>
+#include <Threads/Cond.h>
+#include <Threads/Thread.h>
+
+namespace Threads {
+
+class TaskPool
+	{
+	/* Embedded classes: */
+	public:
+	class RangeTask // Abstract base class for tasks processing blocks of an index range; must not throw exceptions
+		{
+		/* Constructors and destructors: */
+		public:
+		virtual ~RangeTask(void)
+			{
+			}
+		
+		/* Methods: */
+		virtual void process(size_t begin,size_t end) =0; // Processes the half-open index block [begin, end); called concurrently for disjoint blocks
+		};
+	
+	private:
+	template <class FunctorParam>
+	class FunctorRangeTask:public RangeTask // Adapter class to process index ranges with arbitrary functors
+		{
+		/* Elements: */
+		private:
+		FunctorParam& functor; // Functor called as functor(begin,end) for each block
+		
+		/* Constructors and destructors: */
+		public:
+		FunctorRangeTask(FunctorParam& sFunctor)
+			:functor(sFunctor)
+			{
+			}
+		
+		/* Methods from RangeTask: */
+		virtual void process(size_t begin,size_t end)
+			{
+			functor(begin,end);
+			}
+		};
+	
+	struct Batch // Structure describing an index range being processed
+		{
+		/* Elements: */
+		public:
+		RangeTask* task; // Task processing the range's blocks
+		size_t next; // Start of the next unclaimed block
+		size_t end; // End of the index range
+		size_t blockSize; // Size of blocks handed to threads
+		unsigned int numActive; // Number of threads currently processing blocks of the range
+		};
+	
+	/* Elements: */
+	Mutex batchMutex; // Mutex serializing access to the batch queue
+	Cond batchCond; // Condition variable to signal new batches to the worker threads
+	Cond doneCond; // Condition variable to signal finished blocks to waiting callers
+	std::deque<Batch*> batches; // Queue of batches that still have unclaimed blocks
+	bool shutdown; // Flag to shut down the worker threads
+	unsigned int numThreads; // Number of worker threads
+	Thread* threads; // Array of worker threads
+	
+	/* Private methods: */
+	void startThreads(unsigned int concurrency); // Starts worker threads for the given number of threads working on ranges, including the calling thread (0: one per CPU)
+	void stopThreads(void); // Shuts down all worker threads
+	bool claimBlock(Batch* batch,size_t& blockBegin,size_t& blockEnd); // Claims the next block of the given batch while holding the batch mutex; returns false if there are no unclaimed blocks
+	void* workerThreadMethod(void); // Method for the worker threads
+	
+	/* Constructors and destructors: */
+	public:
+	TaskPool(unsigned int sConcurrency =0); // Creates a pool for the given number of threads working on ranges, including the calling thread (0: one per CPU)
+	~TaskPool(void); // Shuts down the worker threads; pool must be idle
+	
+	/* Methods: */
+	static TaskPool& getSharedPool(void); // Returns a process-wide pool with one thread per CPU, created on first use
+	unsigned int getConcurrency(void) const // Returns the number of threads working on ranges, including the calling thread
+		{
+		return numThreads+1;
+		}
+	void setConcurrency(unsigned int newConcurrency); // Restarts the pool for the given number of threads working on ranges (0: one per CPU); pool must be idle
+	void processRange(size_t begin,size_t end,size_t minBlockSize,RangeTask& task); // Processes the index range [begin, end) in blocks of at least the given size using the worker threads and the calling thread; returns when all blocks are processed; can be called from several threads at once
+	template <class FunctorParam>
+	void processRange(size_t begin,size_t end,size_t minBlockSize,FunctorParam& functor) // Ditto, calling functor(blockBegin,blockEnd) for each block
+		{
+		FunctorRangeTask<FunctorParam> task(functor);
+		processRange(begin,end,minBlockSize,static_cast<RangeTask&>(task));
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,371 @@
+/***********************************************************************
+PoolAllocatorBenchmark - Program to compare the speed of the system
+allocator, a spinlock-protected single-threaded pool allocator, and the
+concurrent pool allocator when allocating and releasing objects from
+multiple threads, both locally and across threads.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Portable Threading Library (Threads).
+
+The Portable Threading Library is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Portable Threading Library is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Portable Threading Library; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <iostream>
+#include <Misc/PoolAllocator.h>
+#include <Threads/Spinlock.h>
+#include <Threads/Thread.h>
+#include <Threads/LimitedQueue.h>
+#include <Threads/ConcurrentPoolAllocator.h>
+#include <Realtime/Time.h>
+
+/************************
+Type of allocated object:
+************************/
+
+struct Object
+	{
+	/* Elements: */
+	public:
+	unsigned int stamp; // Value written by the allocating thread and checked by the releasing thread
+	char payload[60]; // Padding to a typical small object size
+	};
+
+/***************************
+Benchmarked allocator types:
+***************************/
+
+class MallocAllocator
+	{
+	/* Methods: */
+	public:
+	void* allocate(void)
+		{
+		return malloc(sizeof(Object));
+		}
+	void free(void* item)
+		{
+		::free(item);
+		}
+	};
+
+class SpinlockPoolAllocator
+	{
+	/* Elements: */
+	private:
+	Threads::Spinlock poolMutex; // Mutex protecting the pool
+	Misc::PoolAllocator<Object> pool; // The single-threaded pool allocator
+	
+	/* Methods: */
+	public:
+	void* allocate(void)
+		{
+		Threads::Spinlock::Lock poolLock(poolMutex);
+		return pool.allocate();
+		}
+	void free(void* item)
+		{
+		Threads::Spinlock::Lock poolLock(poolMutex);
+		pool.free(item);
+		}
+	};
+
+typedef Threads::ConcurrentPoolAllocator<Object> ConcurrentAllocator;
+
+/*********************
+Benchmarked workloads:
+*********************/
+
+enum Workload
+	{
+	LOCAL,HANDOFF,NUMWORKLOADS
+	};
+
+const char* workloadNames[NUMWORKLOADS]=
+	{
+	"local","handoff"
+	};
+
+template <class AllocatorParam>
+class WorkloadRunner // Class running one workload on one allocator
+	{
+	/* Embedded classes: */
+	private:
+	typedef Threads::LimitedQueue<Object**> BatchQueue; // Type of queue to pass batches of objects between threads
+	
+	struct Pair // Structure connecting a producer and a consumer thread
+		{
+		/* Elements: */
+		public:
+		BatchQueue fullBatches; // Queue of batches allocated by the producer
+		BatchQueue emptyBatches; // Queue of batches released by the consumer
+		std::vector<Object**> batches; // List of all batch buffers
+		unsigned int numErrors; // Number of objects whose stamps did not match in the consumer
+		
+		/* Constructors and destructors: */
+		Pair(size_t batchSize)
+			:fullBatches(4),emptyBatches(4),numErrors(0)
+			{
+			for(int i=0;i<4;++i)
+				{
+				batches.push_back(new Object*[batchSize]);
+				emptyBatches.push(batches.back());
+				}
+			}
+		~Pair(void)
+			{
+			for(std::vector<Object**>::iterator bIt=batches.begin();bIt!=batches.end();++bIt)
+				delete[] *bIt;
+			}
+		};
+	
+	/* Elements: */
+	AllocatorParam& allocator; // The benchmarked allocator
+	size_t batchSize; // Number of objects allocated in each batch
+	unsigned int numBatches; // Number of batches allocated by each thread
+	Threads::Spinlock errorMutex; // Mutex protecting the error counter
+	unsigned int numErrors; // Number of objects whose stamps did not match
+	
+	/* Private methods: */
+	void* localThreadMethod(void) // Allocates and releases batches of objects in the same thread
+		{
+		Object** batch=new Object*[batchSize];
+		unsigned int threadErrors=0;
+		for(unsigned int b=0;b<numBatches;++b)
+			{
+			/* Allocate and stamp a batch of objects: */
+			for(size_t i=0;i<batchSize;++i)
+				{
+				batch[i]=static_cast<Object*>(allocator.allocate());
+				batch[i]->stamp=b*batchSize+i;
+				}
+			
+			/* Check and release the batch in interleaved order: */
+			for(size_t i=0;i<batchSize;i+=2)
+				{
+				if(batch[i]->stamp!=b*batchSize+i)
+					++threadErrors;
+				allocator.free(batch[i]);
+				}
+			for(size_t i=1;i<batchSize;i+=2)
+				{
+				if(batch[i]->stamp!=b*batchSize+i)
+					++threadErrors;
+				allocator.free(batch[i]);
+				}
+			}
+		delete[] batch;
+		
+		Threads::Spinlock::Lock errorLock(errorMutex);
+		numErrors+=threadErrors;
+		return 0;
+		}
+	void* producerThreadMethod(Pair* pair) // Allocates batches of objects and passes them to the consumer
+		{
+		for(unsigned int b=0;b<numBatches;++b)
+			{
+			Object** batch=pair->emptyBatches.pop();
+			for(size_t i=0;i<batchSize;++i)
+				{
+				batch[i]=static_cast<Object*>(allocator.allocate());
+				batch[i]->stamp=b*batchSize+i;
+				}
+			pair->fullBatches.push(batch);
+			}
+		return 0;
+		}
+	void* consumerThreadMethod(Pair* pair) // Checks and releases batches of objects received from the producer
+		{
+		for(unsigned int b=0;b<numBatches;++b)
+			{
+			Object** batch=pair->fullBatches.pop();
+			for(size_t i=0;i<batchSize;++i)
+				{
+				if(batch[i]->stamp!=b*batchSize+i)
+					++pair->numErrors;
+				allocator.free(batch[i]);
+				}
+			pair->emptyBatches.push(batch);
+			}
+		return 0;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	WorkloadRunner(AllocatorParam& sAllocator,size_t sBatchSize,unsigned int sNumBatches)
+		:allocator(sAllocator),batchSize(sBatchSize),numBatches(sNumBatches),numErrors(0)
+		{
+		}
+	
+	/* Methods: */
+	double run(Workload workload,unsigned int numThreads) // Runs the workload with the given number of threads; returns elapsed time in seconds
+		{
+		Realtime::TimePointMonotonic start;
+		if(workload==LOCAL)
+			{
+			Threads::Thread* threads=new Threads::Thread[numThreads];
+			for(unsigned int i=0;i<numThreads;++i)
+				threads[i].start(this,&WorkloadRunner::localThreadMethod);
+			for(unsigned int i=0;i<numThreads;++i)
+				threads[i].join();
+			delete[] threads;
+			}
+		else
+			{
+			/* Create producer/consumer pairs: */
+			unsigned int numPairs=numThreads/2;
+			std::vector<Pair*> pairs;
+			for(unsigned int i=0;i<numPairs;++i)
+				pairs.push_back(new Pair(batchSize));
+			start.set();
+			Threads::Thread* threads=new Threads::Thread[numPairs*2];
+			for(unsigned int i=0;i<numPairs;++i)
+				{
+				threads[i*2+0].start(this,&WorkloadRunner::producerThreadMethod,pairs[i]);
+				threads[i*2+1].start(this,&WorkloadRunner::consumerThreadMethod,pairs[i]);
+				}
+			for(unsigned int i=0;i<numPairs*2;++i)
+				threads[i].join();
+			delete[] threads;
+			for(unsigned int i=0;i<numPairs;++i)
+				{
+				numErrors+=pairs[i]->numErrors;
+				delete pairs[i];
+				}
+			}
+		return double(start.setAndDiff());
+		}
+	unsigned int getNumErrors(void) const // Returns the number of objects whose stamps did not match
+		{
+		return numErrors;
+		}
+	};
+
+/****************
+Helper functions:
+****************/
+
+std::vector<unsigned int> parseList(const char* list) // Parses a comma-separated list of numbers
+	{
+	std::vector<unsigned int> result;
+	const char* lPtr=list;
+	while(*lPtr!='\0')
+		{
+		char* endPtr;
+		result.push_back((unsigned int)(strtoul(lPtr,&endPtr,10)));
+		lPtr=endPtr;
+		if(*lPtr==',')
+			++lPtr;
+		else if(*lPtr!='\0')
+			{
+			result.clear();
+			break;
+			}
+		}
+	return result;
+	}
+
+template <class AllocatorParam>
+double runWorkload(Workload workload,unsigned int numThreads,size_t batchSize,unsigned int numBatches,unsigned int numRounds,unsigned int& numErrors) // Runs the given workload on a new allocator several times and returns the best time
+	{
+	AllocatorParam allocator;
+	double bestTime=0.0;
+	for(unsigned int round=0;round<numRounds;++round)
+		{
+		WorkloadRunner<AllocatorParam> runner(allocator,batchSize,numBatches);
+		double time=runner.run(workload,numThreads);
+		if(round==0||bestTime>time)
+			bestTime=time;
+		numErrors+=runner.getNumErrors();
+		}
+	return bestTime;
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	std::vector<unsigned int> threadCounts=parseList("2,4,8");
+	size_t batchSize=1000;
+	unsigned int numBatches=2000;
+	unsigned int numRounds=3;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"threadCounts")==0&&i+1<argc)
+				threadCounts=parseList(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"batchSize")==0&&i+1<argc)
+				batchSize=size_t(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"numBatches")==0&&i+1<argc)
+				numBatches=(unsigned int)(atoi(argv[++i]));
+			else if(strcasecmp(argv[i]+1,"numRounds")==0&&i+1<argc)
+				numRounds=(unsigned int)(atoi(argv[++i]));
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	bool threadCountsValid=!threadCounts.empty();
+	for(std::vector<unsigned int>::iterator tcIt=threadCounts.begin();tcIt!=threadCounts.end();++tcIt)
+		if(*tcIt<2||*tcIt%2!=0)
+			threadCountsValid=false;
+	if(!threadCountsValid||batchSize<1||numBatches<1||numRounds<1)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-threadCounts <t1,t2,...>] [-batchSize <objects per batch>] [-numBatches <batches per thread>] [-numRounds <number of rounds>]"<<std::endl;
+		std::cerr<<"Thread counts must be even, as the handoff workload runs pairs of producer and consumer threads"<<std::endl;
+		return 1;
+		}
+	
+	/* Print the header of the comma-separated result table: */
+	printf("workload,threads,malloc_ns,spinlock_pool_ns,concurrent_pool_ns,speedup_vs_malloc,speedup_vs_spinlock_pool,valid\n");
+	
+	int result=0;
+	for(int w=0;w<NUMWORKLOADS;++w)
+		for(std::vector<unsigned int>::iterator tcIt=threadCounts.begin();tcIt!=threadCounts.end();++tcIt)
+			{
+			/* Run the workload on all allocators: */
+			Workload workload=Workload(w);
+			unsigned int numErrors=0;
+			double times[3];
+			times[0]=runWorkload<MallocAllocator>(workload,*tcIt,batchSize,numBatches,numRounds,numErrors);
+			times[1]=runWorkload<SpinlockPoolAllocator>(workload,*tcIt,batchSize,numBatches,numRounds,numErrors);
+			times[2]=runWorkload<ConcurrentAllocator>(workload,*tcIt,batchSize,numBatches,numRounds,numErrors);
+			
+			/* Print the times per allocate/free pair: */
+			unsigned int numProducers=workload==LOCAL?*tcIt:*tcIt/2;
+			double numPairs=double(numProducers)*double(numBatches)*double(batchSize);
+			printf("%s,%u,%.1f,%.1f,%.1f,%.2f,%.2f,%s\n",workloadNames[w],*tcIt,times[0]*1.0e9/numPairs,times[1]*1.0e9/numPairs,times[2]*1.0e9/numPairs,times[0]/times[2],times[1]/times[2],numErrors==0?"yes":"no");
+			fflush(stdout);
+			if(numErrors!=0)
+				result=1;
+			}
+	
+	/* Report the concurrent allocator's statistics for one handoff run: */
+	{
+	ConcurrentAllocator allocator;
+	WorkloadRunner<ConcurrentAllocator> runner(allocator,batchSize,numBatches);
+	runner.run(HANDOFF,threadCounts.back());
+	ConcurrentAllocator::Statistics stats=allocator.getStatistics();
+	std::cerr<<"Concurrent pool after handoff run with "<<threadCounts.back()<<" threads: "<<stats.numChunks<<" chunks, "<<stats.numSlots<<" slots, ";
+	std::cerr<<stats.numAllocations<<" allocations, "<<stats.numFrees<<" frees, "<<stats.getNumUsedSlots()<<" slots in use, ";
+	std::cerr<<stats.numRefills<<" cache refills, "<<stats.numFlushes<<" cache flushes, "<<stats.numThreads<<" live thread caches"<<std::endl;
+	}
+	
+	return result;
+	}
@@ -0,0 +1,190 @@
+/***********************************************************************
+AtomicHistogram - Class for histograms of integer samples that can be
+updated concurrently from several threads without locking.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Vrui VR Device Driver Daemon (VRDeviceDaemon).
+
+The Vrui VR Device Driver Daemon is free software; you can redistribute
+it and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Vrui VR Device Driver Daemon is distributed in the hope that it will
+be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui VR Device Driver Daemon; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef ATOMICHISTOGRAM_INCLUDED
+#define ATOMICHISTOGRAM_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Math/Constants.h>
+#include <Threads/Atomic.h>
+
+class AtomicHistogram
+	{
+	/* Embedded classes: */
+	private:
+	struct Bin // Structure for a single histogram bin
+		{
+		/* Elements: */
+		public:
+		Threads::Atomic<unsigned int> numSamples; // Number of samples in the bin
+		
+		/* Constructors and destructors: */
+		Bin(void)
+			:numSamples(0U)
+			{
+			}
+		};
+	
+	public:
+	class Snapshot // Class holding a copy of a histogram's bins for evaluation
+		{
+		friend class AtomicHistogram;
+		
+		/* Elements: */
+		private:
+		int binSize; // Size of a histogram bin
+		int minBinValue; // Minimum value for which a bin was created
+		std::vector<unsigned int> bins; // Copied histogram bins, including the negative and positive outlier bins
+		unsigned int numSamples; // Total number of samples in all copied bins
+		int maxValue; // Largest sample in the copied histogram
+		
+		/* Constructors and destructors: */
+		public:
+		Snapshot(void)
+			:binSize(1),minBinValue(0),numSamples(0U),maxValue(0)
+			{
+			}
+		
+		/* Methods: */
+		unsigned int getNumSamples(void) const // Returns the number of samples in the snapshot
+			{
+			return numSamples;
+			}
+		int getMaxValue(void) const // Returns the largest sample in the snapshot, or 0 if the snapshot is empty
+			{
+			return numSamples>0U?maxValue:0;
+			}
+		int getPercentile(double fraction) const // Returns an upper bound for the value below which the given fraction of samples fall, with bin size resolution
+			{
+			if(numSamples==0U)
+				return 0;
+			
+			/* Find the first bin at which the cumulative sample count reaches the given fraction: */
+			double threshold=fraction*double(numSamples);
+			unsigned int cumulativeSize=0U;
+			size_t lastBinIndex=bins.size()-1;
+			for(size_t binIndex=0;binIndex<lastBinIndex;++binIndex)
+				{
+				cumulativeSize+=bins[binIndex];
+				if(cumulativeSize>0U&&double(cumulativeSize)>=threshold)
+					{
+					/* Return the bin's upper bound, clamped to the sample range: */
+					int result=minBinValue+binSize*int(binIndex);
+					return result<maxValue?result:maxValue;
+					}
+				}
+			
+			return maxValue;
+			}
+		};
+	
+	/* Elements: */
+	private:
+	int binSize; // Size of a histogram bin
+	int minBinValue; // Minimum value for which to create a bin
+	int maxBinValue; // Maximum value for which to create a bin
+	size_t numBins; // Number of bins in the histogram, including the negative and positive outlier bins
+	Bin* bins; // Array of histogram bins
+	Threads::Atomic<int> maxValue; // Largest sample added to the histogram
+	
+	/* Constructors and destructors: */
+	public:
+	AtomicHistogram(int sBinSize,int sMinBinValue,int sMaxBinValue)
+		:binSize(sBinSize),minBinValue(sMinBinValue),maxBinValue(sMaxBinValue),
+		 numBins(size_t((maxBinValue-minBinValue)/binSize)+3),bins(new Bin[numBins]),
+		 maxValue(Math::Constants<int>::min)
+		{
+		}
+	private:
+	AtomicHistogram(const AtomicHistogram& source); // Prohibit copy constructor
+	AtomicHistogram& operator=(const AtomicHistogram& source); // Prohibit assignment operator
+	public:
+	~AtomicHistogram(void)
+		{
+		delete[] bins;
+		}
+	
+	/* Methods: */
+	void addSample(int value) // Adds a sample to the histogram; can be called from any number of threads concurrently
+		{
+		/* Increment the sample's bin: */
+		size_t binIndex;
+		if(value<minBinValue)
+			binIndex=0; // Put value in negative outlier bin
+		else if(value>maxBinValue)
+			binIndex=numBins-1; // Put value in positive outlier bin
+		else
+			binIndex=size_t((value-minBinValue)/binSize)+1;
+		bins[binIndex].numSamples.postAdd(1U);
+		
+		/* Raise the maximum value until it is at least the new sample: */
+		int currentMax=maxValue.get();
+		while(currentMax<value)
+			{
+			int previousMax=maxValue.compareAndSwap(currentMax,value);
+			if(previousMax==currentMax)
+				break;
+			currentMax=previousMax;
+			}
+		}
+	void getSnapshot(Snapshot& snapshot,bool reset) // Copies the histogram into the given snapshot; atomically removes the copied samples from the histogram if reset is true
+		{
+		snapshot.binSize=binSize;
+		snapshot.minBinValue=minBinValue;
+		snapshot.bins.resize(numBins);
+		snapshot.numSamples=0U;
+		for(size_t i=0;i<numBins;++i)
+			{
+			/* Samples added concurrently end up either in this snapshot or in the next one: */
+			snapshot.bins[i]=reset?bins[i].numSamples.postAnd(0U):bins[i].numSamples.get();
+			snapshot.numSamples+=snapshot.bins[i];
+			}
+		if(reset)
+			{
+			/* Reset the maximum value: */
+			int currentMax=maxValue.get();
+			while(true)
+				{
+				int previousMax=maxValue.compareAndSwap(currentMax,Math::Constants<int>::min);
+				if(previousMax==currentMax)
+					break;
+				currentMax=previousMax;
+				}
+			snapshot.maxValue=currentMax;
+			}
+		else
+			snapshot.maxValue=maxValue.get();
+		
+		/* Bound the maximum value by the last non-empty bin if a concurrently added sample has not raised it yet: */
+		if(snapshot.numSamples>0U&&snapshot.maxValue==Math::Constants<int>::min)
+			{
+			size_t lastBinIndex=numBins-1;
+			while(lastBinIndex>0&&snapshot.bins[lastBinIndex]==0U)
+				--lastBinIndex;
+			snapshot.maxValue=lastBinIndex<numBins-1?minBinValue+binSize*int(lastBinIndex):maxBinValue;
+			}
+		}
+	};
+
+#endif
@@ -140,12 +140,28 @@ void VRDevice::addVirtualDevice(Vrui::VRDeviceDescriptor* newDevice)
 	deviceManager->addVirtualDevice(newDevice);
 	}
 
+void VRDevice::calibrateTrackerState(int deviceTrackerIndex,Vrui::VRDeviceState::TrackerState& state) const
+	{
+	if(calibrator!=0)
+		calibrator->calibrate(deviceTrackerIndex,state);
+	state.positionOrientation*=trackerPostTransformations[deviceTrackerIndex];
+	}
+
+Vrui::VRDeviceState::ValuatorState VRDevice::mapValuatorState(int deviceValuatorIndex,Vrui::VRDeviceState::ValuatorState state) const
+	{
+	float th=valuatorThresholds[deviceValuatorIndex];
+	if(state<-th)
+		return -Math::pow(-(state+th)/(1.0f-th),valuatorExponents[deviceValuatorIndex]);
+	else if(state>th)
+		return Math::pow((state-th)/(1.0f-th),valuatorExponents[deviceValuatorIndex]);
+	else
+		return 0.0f;
+	}
+
 void VRDevice::setTrackerState(int deviceTrackerIndex,const Vrui::VRDeviceState::TrackerState& state,Vrui::VRDeviceState::TimeStamp timeStamp)
 	{
 	Vrui::VRDeviceState::TrackerState calibratedState=state;
-	if(calibrator!=0)
-		calibrator->calibrate(deviceTrackerIndex,calibratedState);
-	calibratedState.positionOrientation*=trackerPostTransformations[deviceTrackerIndex];
+	calibrateTrackerState(deviceTrackerIndex,calibratedState);
 	deviceManager->setTrackerState(trackerIndices[deviceTrackerIndex],calibratedState,timeStamp);
 	}
 
@@ -156,15 +172,23 @@ void VRDevice::setButtonState(int deviceButtonIndex,Vrui::VRDeviceState::ButtonS
 
 void VRDevice::setValuatorState(int deviceValuatorIndex,Vrui::VRDeviceState::ValuatorState newState)
 	{
-	Vrui::VRDeviceState::ValuatorState calibratedState=newState;
-	float th=valuatorThresholds[deviceValuatorIndex];
-	if(calibratedState<-th)
-		calibratedState=-Math::pow(-(calibratedState+th)/(1.0f-th),valuatorExponents[deviceValuatorIndex]);
-	else if(calibratedState>th)
-		calibratedState=Math::pow((calibratedState-th)/(1.0f-th),valuatorExponents[deviceValuatorIndex]);
-	else
-		calibratedState=0.0f;
-	deviceManager->setValuatorState(valuatorIndices[deviceValuatorIndex],calibratedState);
+	deviceManager->setValuatorState(valuatorIndices[deviceValuatorIndex],mapValuatorState(deviceValuatorIndex,newState));
+	}
+
+void VRDevice::setState(Vrui::VRDeviceState& newState)
+	{
+	/* Calibrate all trackers and map all valuators in place: */
+	for(int i=0;i<newState.getNumTrackers();++i)
+		{
+		Vrui::VRDeviceState::TrackerState trackerState=newState.getTrackerState(i);
+		calibrateTrackerState(i,trackerState);
+		newState.setTrackerState(i,trackerState);
+		}
+	for(int i=0;i<newState.getNumValuators();++i)
+		newState.setValuatorState(i,mapValuatorState(i,newState.getValuatorState(i)));
+	
+	/* The device manager assigns each device contiguous index ranges, so the state can be copied by range: */
+	deviceManager->setStateRange(numTrackers>0?trackerIndices[0]:0,numButtons>0?buttonIndices[0]:0,numValuators>0?valuatorIndices[0]:0,newState);
 	}
 
 void VRDevice::updateState(void)
@@ -70,6 +70,8 @@ class VRDevice
 	
 	/* Private methods: */
 	void* deviceThreadMethodWrapper(void); // Wrapper method for the virtual device thread
+	void calibrateTrackerState(int deviceTrackerIndex,Vrui::VRDeviceState::TrackerState& state) const; // Applies the calibrator and post transformation to a tracker state (device index given)
+	Vrui::VRDeviceState::ValuatorState mapValuatorState(int deviceValuatorIndex,Vrui::VRDeviceState::ValuatorState state) const; // Applies the threshold and exponent mapping to a valuator state (device index given)
 	
 	/* Protected methods: */
 	protected:
@@ -87,6 +89,7 @@ class VRDevice
 		}
 	void setButtonState(int deviceButtonIndex,Vrui::VRDeviceState::ButtonState newState); // Sets a button state (device index given)
 	void setValuatorState(int deviceValuatorIndex,Vrui::VRDeviceState::ValuatorState newState); // Sets a valuator state (device index given)
+	void setState(Vrui::VRDeviceState& newState); // Calibrates a state matching the device's layout in place like the single-element methods, and forwards it into the device manager in one operation
 	void updateState(void); // Notifies the device manager that this device's state can be sent to clients
 	void startDeviceThread(void); // Starts the device communication thread
 	void stopDeviceThread(bool cancel =true); // Stops the device communication thread; if flag is true, thread will be cancelled
@@ -36,7 +36,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <VRDeviceDaemon/VRDeviceManager.h>
 #include <VRDeviceDaemon/VRDeviceServer.h>
 
-bool shutdown;
+bool shutdownRequested; // Flag whether the daemon is to shut down; not named "shutdown" to avoid interposing the socket function of the same name in plug-ins
 Threads::MutexCond shutdownCond;
 
 void signalHandler(int signalId)
@@ -47,7 +47,7 @@ void signalHandler(int signalId)
 			/* Restart server: */
 			{
 			Threads::MutexCond::Lock shutdownLock(shutdownCond);
-			shutdown=false;
+			shutdownRequested=false;
 			shutdownCond.broadcast();
 			}
 			break;
@@ -57,7 +57,7 @@ void signalHandler(int signalId)
 			/* Shut down server: */
 			{
 			Threads::MutexCond::Lock shutdownLock(shutdownCond);
-			shutdown=true;
+			shutdownRequested=true;
 			shutdownCond.broadcast();
 			}
 			break;
@@ -241,7 +241,7 @@ int main(int argc,char* argv[])
 		configFile->setCurrentSection("..");
 		
 		/* Create shutdown condition variable: */
-		shutdown=false;
+		shutdownRequested=false;
 		
 		/* Wait for restart or shutdown: */
 		shutdownCond.wait();
@@ -255,7 +255,7 @@ int main(int argc,char* argv[])
 		configFile=0;
 		
 		/* Shut down the device daemon if SIGINT or SIGTERM were caught: */
-		if(!daemonize||shutdown)
+		if(!daemonize||shutdownRequested)
 			{
 			#ifdef VERBOSE
 			std::cout<<"VRDeviceDaemon: Shutting down daemon"<<std::endl<<std::flush;
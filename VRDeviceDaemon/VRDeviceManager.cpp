@@ -27,17 +27,47 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <stdio.h>
 #include <dlfcn.h>
 #include <vector>
+#include <Misc/SizedTypes.h>
 #include <Misc/PrintInteger.h>
 #include <Misc/StandardValueCoders.h>
 #include <Misc/CompoundValueCoders.h>
 #include <Misc/ConfigurationFile.h>
 #include <Vrui/Internal/VRDeviceDescriptor.h>
+#include <Vrui/Internal/VRDeviceStatistics.h>
 
 #include <VRDeviceDaemon/VRFactory.h>
 #include <VRDeviceDaemon/VRDevice.h>
 #include <VRDeviceDaemon/VRCalibrator.h>
 #include <VRDeviceDaemon/Config.h>
 
+namespace {
+
+/**************
+Helper objects:
+**************/
+
+const int maxSnapshotAttempts=8; // Number of lock-free attempts to take a consistent state snapshot before blocking device updates
+
+/****************
+Helper functions:
+****************/
+
+int getLatency(Vrui::VRDeviceState::TimeStamp from,Vrui::VRDeviceState::TimeStamp to) // Returns the signed difference between two wrapping time stamps
+	{
+	return int(Misc::SInt32(to-from));
+	}
+
+void getLatencyPercentiles(AtomicHistogram& histogram,bool reset,AtomicHistogram::Snapshot& snapshot,float percentiles[Vrui::VRDeviceStatistics::NUM_LATENCYPERCENTILES]) // Evaluates a latency histogram into the reported latency percentiles
+	{
+	static const double fractions[Vrui::VRDeviceStatistics::MAXIMUM]={0.5,0.9,0.99};
+	histogram.getSnapshot(snapshot,reset);
+	for(int i=0;i<Vrui::VRDeviceStatistics::MAXIMUM;++i)
+		percentiles[i]=float(snapshot.getPercentile(fractions[i]));
+	percentiles[Vrui::VRDeviceStatistics::MAXIMUM]=float(snapshot.getMaxValue());
+	}
+
+}
+
 /********************************
 Methods of class VRDeviceManager:
 ********************************/
@@ -47,17 +77,19 @@ VRDeviceManager::VRDeviceManager(Misc::ConfigurationFile& configFile)
 	 calibratorFactories(configFile.retrieveString("./calibratorDirectory",VRDEVICEDAEMON_CONFIG_VRCALIBRATORSDIR)),
 	 numDevices(0),
 	 devices(0),trackerIndexBases(0),buttonIndexBases(0),valuatorIndexBases(0),
+	 deviceSlots(0),trackerDeliverySlots(0),
 	 fullTrackerReportMask(0x0),trackerReportMask(0x0),trackerUpdateNotificationEnabled(false),
 	 trackerUpdateCompleteCond(0)
 	{
 	/* Allocate device and base index arrays: */
 	typedef std::vector<std::string> StringList;
-	StringList deviceNames=configFile.retrieveValue<StringList>("./deviceNames");
+	deviceNames=configFile.retrieveValue<StringList>("./deviceNames");
 	numDevices=deviceNames.size();
 	devices=new VRDevice*[numDevices];
 	trackerIndexBases=new int[numDevices];
 	buttonIndexBases=new int[numDevices];
 	valuatorIndexBases=new int[numDevices];
+	deviceSlots=new DeviceSlot[numDevices];
 	
 	/* Initialize VR devices: */
 	for(currentDeviceIndex=0;currentDeviceIndex<numDevices;++currentDeviceIndex)
@@ -120,6 +152,9 @@ VRDeviceManager::VRDeviceManager(Misc::ConfigurationFile& configFile)
 	
 	/* Set server state's layout: */
 	state.setLayout(trackerNames.size(),buttonNames.size(),valuatorNames.size());
+	trackerSampleCounts.resize(trackerNames.size(),0U);
+	trackerReceiveTimeStamps.resize(trackerNames.size(),0U);
+	trackerDeliverySlots=new TrackerDeliverySlot[trackerNames.size()];
 	
 	/* Read names of all virtual devices: */
 	StringList virtualDeviceNames=configFile.retrieveValue<StringList>("./virtualDeviceNames",StringList());
@@ -152,6 +187,10 @@ VRDeviceManager::~VRDeviceManager(void)
 	delete[] buttonIndexBases;
 	delete[] valuatorIndexBases;
 	
+	/* Delete per-device state publishing slots and statistics, and per-tracker delivery records: */
+	delete[] deviceSlots;
+	delete[] trackerDeliverySlots;
+	
 	/* Delete virtual devices: */
 	for(std::vector<Vrui::VRDeviceDescriptor*>::iterator vdIt=virtualDevices.begin();vdIt!=virtualDevices.end();++vdIt)
 		delete *vdIt;
@@ -172,6 +211,7 @@ int VRDeviceManager::addTracker(const char* name)
 		}
 	else
 		trackerNames.push_back(name);
+	trackerDeviceIndices.push_back(currentDeviceIndex);
 	
 	/* Update the tracker report mask: */
 	fullTrackerReportMask=(0x1U<<(result+1))-1U;
@@ -194,6 +234,7 @@ int VRDeviceManager::addButton(const char* name)
 		}
 	else
 		buttonNames.push_back(name);
+	buttonDeviceIndices.push_back(currentDeviceIndex);
 	
 	return result;
 	}
@@ -213,6 +254,7 @@ int VRDeviceManager::addValuator(const char* name)
 		}
 	else
 		valuatorNames.push_back(name);
+	valuatorDeviceIndices.push_back(currentDeviceIndex);
 	
 	return result;
 	}
@@ -229,58 +271,273 @@ VRCalibrator* VRDeviceManager::createCalibrator(const std::string& calibratorTyp
 	return calibratorFactory->createObject(configFile);
 	}
 
+void VRDeviceManager::notifyTrackerUpdate(void)
+	{
+	Threads::Spinlock::Lock notificationLock(notificationMutex);
+	if(trackerUpdateNotificationEnabled)
+		{
+		/* Wake up all client threads in stream mode: */
+		trackerUpdateCompleteCond->broadcast();
+		}
+	}
+
 void VRDeviceManager::setTrackerState(int trackerIndex,const Vrui::VRDeviceState::TrackerState& newTrackerState,Vrui::VRDeviceState::TimeStamp newTimeStamp)
 	{
-	Threads::Mutex::Lock stateLock(stateMutex);
+	/* Get the reception time of the new tracker state: */
+	Vrui::VRDeviceState::TimeStamp receiveTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+	
+	DeviceSlot& slot=deviceSlots[trackerDeviceIndices[trackerIndex]];
+	
+	/* Publish the new tracker state through the state version of the device owning the tracker: */
+	{
+	Threads::Spinlock::Lock updateLock(slot.updateMutex);
+	slot.stateVersion.preAdd(1U);
 	state.setTrackerState(trackerIndex,newTrackerState);
 	state.setTrackerTimeStamp(trackerIndex,newTimeStamp);
+	++trackerSampleCounts[trackerIndex];
+	trackerReceiveTimeStamps[trackerIndex]=receiveTime;
+	slot.stateVersion.preAdd(1U);
+	}
+	
+	/* Update the device's statistics: */
+	slot.statistics.numSamples.postAdd(1U);
+	slot.statistics.receiveLatency.addSample(getLatency(newTimeStamp,receiveTime));
 	
 	if(trackerUpdateNotificationEnabled)
 		{
 		/* Update tracker report mask: */
-		trackerReportMask|=1<<trackerIndex;
-		if(trackerReportMask==fullTrackerReportMask)
-			{
-			/* Wake up all client threads in stream mode: */
-			trackerUpdateCompleteCond->broadcast();
-			trackerReportMask=0x0;
-			}
+		unsigned int newReportMask=trackerReportMask.preOr(1U<<trackerIndex);
+		
+		/* Notify clients if this update completed the mask; only one thread can succeed in resetting the mask: */
+		if(newReportMask==fullTrackerReportMask&&trackerReportMask.ifCompareAndSwap(fullTrackerReportMask,0x0U))
+			notifyTrackerUpdate();
 		}
 	}
 
 void VRDeviceManager::setButtonState(int buttonIndex,Vrui::VRDeviceState::ButtonState newButtonState)
 	{
-	Threads::Mutex::Lock stateLock(stateMutex);
+	DeviceSlot& slot=deviceSlots[buttonDeviceIndices[buttonIndex]];
+	Threads::Spinlock::Lock updateLock(slot.updateMutex);
+	slot.stateVersion.preAdd(1U);
 	state.setButtonState(buttonIndex,newButtonState);
+	slot.stateVersion.preAdd(1U);
 	}
 
 void VRDeviceManager::setValuatorState(int valuatorIndex,Vrui::VRDeviceState::ValuatorState newValuatorState)
 	{
-	Threads::Mutex::Lock stateLock(stateMutex);
+	DeviceSlot& slot=deviceSlots[valuatorDeviceIndices[valuatorIndex]];
+	Threads::Spinlock::Lock updateLock(slot.updateMutex);
+	slot.stateVersion.preAdd(1U);
 	state.setValuatorState(valuatorIndex,newValuatorState);
+	slot.stateVersion.preAdd(1U);
+	}
+
+void VRDeviceManager::setStateRange(int trackerIndexBase,int buttonIndexBase,int valuatorIndexBase,const Vrui::VRDeviceState& newState)
+	{
+	/* Find the device owning the given state ranges: */
+	int deviceIndex;
+	if(newState.getNumTrackers()>0)
+		deviceIndex=trackerDeviceIndices[trackerIndexBase];
+	else if(newState.getNumButtons()>0)
+		deviceIndex=buttonDeviceIndices[buttonIndexBase];
+	else if(newState.getNumValuators()>0)
+		deviceIndex=valuatorDeviceIndices[valuatorIndexBase];
+	else
+		return;
+	
+	/* Get the reception time of the new state: */
+	Vrui::VRDeviceState::TimeStamp receiveTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+	
+	/* Publish all state ranges at once through the state version of the device owning the ranges: */
+	DeviceSlot& slot=deviceSlots[deviceIndex];
+	unsigned int updatedTrackerMask=0x0U;
+	{
+	Threads::Spinlock::Lock updateLock(slot.updateMutex);
+	slot.stateVersion.preAdd(1U);
+	for(int i=0;i<newState.getNumTrackers();++i)
+		{
+		/* Skip trackers that did not receive a new sample: */
+		int trackerIndex=trackerIndexBase+i;
+		Vrui::VRDeviceState::TimeStamp newTimeStamp=newState.getTrackerTimeStamp(i);
+		if(state.getTrackerTimeStamp(trackerIndex)!=newTimeStamp)
+			{
+			state.setTrackerState(trackerIndex,newState.getTrackerState(i));
+			state.setTrackerTimeStamp(trackerIndex,newTimeStamp);
+			++trackerSampleCounts[trackerIndex];
+			trackerReceiveTimeStamps[trackerIndex]=receiveTime;
+			updatedTrackerMask|=1U<<trackerIndex;
+			}
+		}
+	for(int i=0;i<newState.getNumButtons();++i)
+		state.setButtonState(buttonIndexBase+i,newState.getButtonState(i));
+	for(int i=0;i<newState.getNumValuators();++i)
+		state.setValuatorState(valuatorIndexBase+i,newState.getValuatorState(i));
+	slot.stateVersion.preAdd(1U);
+	}
+	
+	/* Update the device's statistics with all new tracker samples: */
+	for(int i=0;i<newState.getNumTrackers();++i)
+		if(updatedTrackerMask&(1U<<(trackerIndexBase+i)))
+			{
+			slot.statistics.numSamples.postAdd(1U);
+			slot.statistics.receiveLatency.addSample(getLatency(newState.getTrackerTimeStamp(i),receiveTime));
+			}
+	
+	if(trackerUpdateNotificationEnabled&&updatedTrackerMask!=0x0U)
+		{
+		/* Update tracker report mask with all updated trackers at once: */
+		unsigned int newReportMask=trackerReportMask.preOr(updatedTrackerMask);
+		
+		/* Notify clients if this update completed the mask; only one thread can succeed in resetting the mask: */
+		if(newReportMask==fullTrackerReportMask&&trackerReportMask.ifCompareAndSwap(fullTrackerReportMask,0x0U))
+			notifyTrackerUpdate();
+		}
 	}
 
 void VRDeviceManager::updateState(void)
 	{
-	Threads::Mutex::Lock stateLock(stateMutex);
-	if(trackerUpdateNotificationEnabled)
+	notifyTrackerUpdate();
+	}
+
+void VRDeviceManager::copyState(StateSnapshot& snapshot) const
+	{
+	for(int i=0;i<state.getNumTrackers();++i)
 		{
-		/* Wake up all client threads in stream mode: */
-		trackerUpdateCompleteCond->broadcast();
+		snapshot.state.setTrackerState(i,state.getTrackerState(i));
+		snapshot.state.setTrackerTimeStamp(i,state.getTrackerTimeStamp(i));
+		snapshot.sampleCounts[i]=trackerSampleCounts[i];
+		snapshot.receiveTimeStamps[i]=trackerReceiveTimeStamps[i];
+		}
+	for(int i=0;i<state.getNumButtons();++i)
+		snapshot.state.setButtonState(i,state.getButtonState(i));
+	for(int i=0;i<state.getNumValuators();++i)
+		snapshot.state.setValuatorState(i,state.getValuatorState(i));
+	}
+
+void VRDeviceManager::snapshotState(StateSnapshot& snapshot)
+	{
+	/* Adapt the snapshot's layout if necessary: */
+	if(snapshot.state.getNumTrackers()!=state.getNumTrackers()||snapshot.state.getNumButtons()!=state.getNumButtons()||snapshot.state.getNumValuators()!=state.getNumValuators())
+		{
+		snapshot.state.setLayout(state.getNumTrackers(),state.getNumButtons(),state.getNumValuators());
+		snapshot.sampleCounts.resize(state.getNumTrackers());
+		snapshot.receiveTimeStamps.resize(state.getNumTrackers());
+		}
+	
+	/* Copy the state of all devices without locking, and repeat until no device updated its state while it was being copied: */
+	std::vector<unsigned int> versions(numDevices);
+	bool consistent=false;
+	for(int attempt=0;attempt<maxSnapshotAttempts&&!consistent;++attempt)
+		{
+		/* Read all devices' state versions with full memory barriers; give up on this attempt if any device is updating its state: */
+		consistent=true;
+		for(int deviceIndex=0;deviceIndex<numDevices&&consistent;++deviceIndex)
+			{
+			versions[deviceIndex]=deviceSlots[deviceIndex].stateVersion.postAdd(0U);
+			consistent=(versions[deviceIndex]&0x1U)==0x0U;
+			}
+		
+		if(consistent)
+			{
+			copyState(snapshot);
+			
+			/* Check that no device published a new state during the copy: */
+			for(int deviceIndex=0;deviceIndex<numDevices&&consistent;++deviceIndex)
+				consistent=deviceSlots[deviceIndex].stateVersion.get()==versions[deviceIndex];
+			}
+		}
+	
+	if(!consistent)
+		{
+		/* Block device updates for the duration of a single copy to guarantee progress: */
+		for(int deviceIndex=0;deviceIndex<numDevices;++deviceIndex)
+			deviceSlots[deviceIndex].updateMutex.lock();
+		copyState(snapshot);
+		for(int deviceIndex=numDevices-1;deviceIndex>=0;--deviceIndex)
+			deviceSlots[deviceIndex].updateMutex.unlock();
+		}
+	
+	/* Count the tracker samples that were overwritten before being taken into any snapshot: */
+	for(int i=0;i<state.getNumTrackers();++i)
+		{
+		/* Advance the tracker's taken sample count unless a concurrent snapshot already took the same or a newer sample: */
+		Threads::Atomic<unsigned int>& takenSampleCount=trackerDeliverySlots[i].takenSampleCount;
+		unsigned int taken=takenSampleCount.get();
+		while(int(Misc::SInt32(snapshot.sampleCounts[i]-taken))>0)
+			{
+			unsigned int previous=takenSampleCount.compareAndSwap(taken,snapshot.sampleCounts[i]);
+			if(previous==taken)
+				{
+				if(snapshot.sampleCounts[i]-taken>1U)
+					deviceSlots[trackerDeviceIndices[i]].statistics.numDroppedSamples.postAdd(snapshot.sampleCounts[i]-taken-1U);
+				break;
+				}
+			taken=previous;
+			}
+		}
+	}
+
+void VRDeviceManager::reportDelivery(const StateSnapshot& snapshot)
+	{
+	/* Get the delivery time: */
+	Vrui::VRDeviceState::TimeStamp deliveryTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+	
+	/* Record the queue and delivery latencies of all newly delivered tracker samples; only one thread can succeed in marking a sample as delivered: */
+	for(int i=0;i<state.getNumTrackers();++i)
+		{
+		Vrui::VRDeviceState::TimeStamp timeStamp=snapshot.state.getTrackerTimeStamp(i);
+		Threads::Atomic<Vrui::VRDeviceState::TimeStamp>& deliveredTimeStamp=trackerDeliverySlots[i].deliveredTimeStamp;
+		Vrui::VRDeviceState::TimeStamp delivered=deliveredTimeStamp.get();
+		if(delivered!=timeStamp&&deliveredTimeStamp.ifCompareAndSwap(delivered,timeStamp))
+			{
+			DeviceStatistics& ds=deviceSlots[trackerDeviceIndices[i]].statistics;
+			ds.queueLatency.addSample(getLatency(snapshot.receiveTimeStamps[i],deliveryTime));
+			ds.deliveryLatency.addSample(getLatency(timeStamp,deliveryTime));
+			}
+		}
+	}
+
+void VRDeviceManager::getStatistics(Vrui::VRDeviceStatistics& statistics,bool reset)
+	{
+	Threads::Spinlock::Lock statisticsLock(statisticsMutex);
+	
+	/* Calculate the length of the current observation period: */
+	Realtime::TimePointMonotonic now;
+	statistics.period=double(now.tv_sec-statisticsStartTime.tv_sec)+double(now.tv_nsec-statisticsStartTime.tv_nsec)*1.0e-9;
+	if(reset)
+		statisticsStartTime=now;
+	
+	/* Query the statistics of each device; samples arriving concurrently are counted in this or the next observation period: */
+	statistics.devices.resize(numDevices);
+	AtomicHistogram::Snapshot histogram;
+	for(int deviceIndex=0;deviceIndex<numDevices;++deviceIndex)
+		{
+		Vrui::VRDeviceStatistics::DeviceStatistics& s=statistics.devices[deviceIndex];
+		s.name=deviceNames[deviceIndex];
+		int trackerEnd=deviceIndex<numDevices-1?trackerIndexBases[deviceIndex+1]:state.getNumTrackers();
+		s.numTrackers=trackerEnd-trackerIndexBases[deviceIndex];
+		
+		DeviceStatistics& ds=deviceSlots[deviceIndex].statistics;
+		s.numSamples=reset?ds.numSamples.postAnd(0U):ds.numSamples.get();
+		s.numDroppedSamples=reset?ds.numDroppedSamples.postAnd(0U):ds.numDroppedSamples.get();
+		s.sampleRate=s.numTrackers>0&&statistics.period>0.0?float(double(s.numSamples)/(double(s.numTrackers)*statistics.period)):0.0f;
+		getLatencyPercentiles(ds.receiveLatency,reset,histogram,s.receiveLatency);
+		getLatencyPercentiles(ds.queueLatency,reset,histogram,s.queueLatency);
+		getLatencyPercentiles(ds.deliveryLatency,reset,histogram,s.deliveryLatency);
 		}
 	}
 
 void VRDeviceManager::enableTrackerUpdateNotification(Threads::MutexCond* sTrackerUpdateCompleteCond)
 	{
-	Threads::Mutex::Lock stateLock(stateMutex);
-	trackerUpdateNotificationEnabled=true;
+	Threads::Spinlock::Lock notificationLock(notificationMutex);
 	trackerUpdateCompleteCond=sTrackerUpdateCompleteCond;
-	trackerReportMask=0x0;
+	trackerReportMask.postAnd(0x0U);
+	trackerUpdateNotificationEnabled=true;
 	}
 
 void VRDeviceManager::disableTrackerUpdateNotification(void)
 	{
-	Threads::Mutex::Lock stateLock(stateMutex);
+	Threads::Spinlock::Lock notificationLock(notificationMutex);
 	trackerUpdateNotificationEnabled=false;
 	trackerUpdateCompleteCond=0;
 	}
@@ -26,10 +26,14 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #define VRDEVICEMANAGER_INCLUDED
 
 #include <string>
-#include <Threads/Mutex.h>
+#include <vector>
+#include <Threads/Spinlock.h>
+#include <Threads/Atomic.h>
 #include <Threads/MutexCond.h>
+#include <Realtime/Time.h>
 #include <Vrui/Internal/VRDeviceState.h>
 
+#include <VRDeviceDaemon/AtomicHistogram.h>
 #include <VRDeviceDaemon/VRFactoryManager.h>
 
 /* Forward declarations: */
@@ -38,6 +42,7 @@ class ConfigurationFile;
 }
 namespace Vrui {
 class VRDeviceDescriptor;
+class VRDeviceStatistics;
 }
 class VRDevice;
 class VRCalibrator;
@@ -69,8 +74,64 @@ class VRDeviceManager
 	
 	typedef VRFactoryManager<VRCalibrator> CalibratorFactoryManager;
 	
-	/* Elements: */
+	struct StateSnapshot // Structure holding a consistent copy of the state of all managed devices, and the pipeline stage data of each tracker state
+		{
+		/* Elements: */
+		public:
+		Vrui::VRDeviceState state; // Copy of the state of all managed devices
+		std::vector<unsigned int> sampleCounts; // Sample count of each tracker's state, to count dropped samples
+		std::vector<Vrui::VRDeviceState::TimeStamp> receiveTimeStamps; // Time at which each tracker's state was received by the device manager
+		};
+	
 	private:
+	struct DeviceStatistics // Structure to accumulate performance statistics for a VR device; all elements are updated without locking
+		{
+		/* Elements: */
+		public:
+		Threads::Atomic<unsigned int> numSamples; // Number of tracker samples received in the current observation period
+		Threads::Atomic<unsigned int> numDroppedSamples; // Number of tracker samples overwritten before being taken into a state snapshot
+		AtomicHistogram receiveLatency; // Histogram of latencies from device sample time to reception in microseconds
+		AtomicHistogram queueLatency; // Histogram of latencies from reception to delivery to clients in microseconds
+		AtomicHistogram deliveryLatency; // Histogram of latencies from device sample time to delivery to clients in microseconds
+		
+		/* Constructors and destructors: */
+		DeviceStatistics(void)
+			:numSamples(0U),numDroppedSamples(0U),
+			 receiveLatency(50,0,20000),queueLatency(50,0,20000),deliveryLatency(50,0,20000)
+			{
+			}
+		};
+	
+	struct DeviceSlot // Structure to publish the state elements owned by a VR device to the device server without locking
+		{
+		/* Elements: */
+		public:
+		Threads::Spinlock updateMutex; // Lock serializing state updates from several threads of the same device; never taken by the device server while the device is active
+		Threads::Atomic<unsigned int> stateVersion; // Version number of the device's state elements; odd while the device is updating them
+		DeviceStatistics statistics; // Performance statistics of the device
+		
+		/* Constructors and destructors: */
+		DeviceSlot(void)
+			:stateVersion(0U)
+			{
+			}
+		};
+	
+	struct TrackerDeliverySlot // Structure recording which samples of a tracker were taken into state snapshots and delivered to clients; updated by the device server without locking
+		{
+		/* Elements: */
+		public:
+		Threads::Atomic<unsigned int> takenSampleCount; // Sample count of the tracker's most recent sample taken into a state snapshot, to count dropped samples
+		Threads::Atomic<Vrui::VRDeviceState::TimeStamp> deliveredTimeStamp; // Time stamp of the tracker's most recently delivered sample, to count each sample's latencies only once
+		
+		/* Constructors and destructors: */
+		TrackerDeliverySlot(void)
+			:takenSampleCount(0U),deliveredTimeStamp(0U)
+			{
+			}
+		};
+	
+	/* Elements: */
 	DeviceFactoryManager deviceFactories; // Factory manager to load VR device classes
 	CalibratorFactoryManager calibratorFactories; // Factory manager to load VR calibrator classes
 	int numDevices; // Number of managed devices
@@ -79,17 +140,31 @@ class VRDeviceManager
 	int* buttonIndexBases; // Array of base button indices for each VR device
 	int* valuatorIndexBases; // Array of base valuator indices for each VR device
 	int currentDeviceIndex; // Index of currently constructed device during initialization
+	std::vector<std::string> deviceNames; // List of device names
 	std::vector<std::string> trackerNames; // List of tracker names
 	std::vector<std::string> buttonNames; // List of button names
 	std::vector<std::string> valuatorNames; // List of valuator names
-	Threads::Mutex stateMutex; // Mutex serializing access to all state elements
-	Vrui::VRDeviceState state; // Current state of all managed devices
+	std::vector<int> trackerDeviceIndices; // Index of the VR device owning each logical tracker
+	std::vector<int> buttonDeviceIndices; // Index of the VR device owning each logical button
+	std::vector<int> valuatorDeviceIndices; // Index of the VR device owning each logical valuator
+	DeviceSlot* deviceSlots; // Array of state publishing slots and statistics for each VR device
+	Vrui::VRDeviceState state; // Current state of all managed devices; each device's state elements are published through its slot's state version
+	std::vector<unsigned int> trackerSampleCounts; // Number of samples received for each tracker; published with the tracker states
+	std::vector<Vrui::VRDeviceState::TimeStamp> trackerReceiveTimeStamps; // Time at which each tracker's current state was received; published with the tracker states
+	TrackerDeliverySlot* trackerDeliverySlots; // Array of delivery records for each tracker
+	Threads::Spinlock statisticsMutex; // Lock serializing statistics queries
+	Realtime::TimePointMonotonic statisticsStartTime; // Time at which the current statistics observation period started
 	std::vector<Vrui::VRDeviceDescriptor*> virtualDevices; // List of virtual devices combining selected trackers, buttons, and valuators
 	unsigned int fullTrackerReportMask; // Bitmask containing 1-bits for all used logical tracker indices
-	unsigned int trackerReportMask; // Bitmask of logical tracker indices that have reported state
-	bool trackerUpdateNotificationEnabled; // Flag if update notification is enabled
+	Threads::Atomic<unsigned int> trackerReportMask; // Bitmask of logical tracker indices that have reported state
+	Threads::Spinlock notificationMutex; // Lock protecting the tracker update notification settings
+	volatile bool trackerUpdateNotificationEnabled; // Flag if update notification is enabled
 	Threads::MutexCond* trackerUpdateCompleteCond; // Condition variable to notify client threads that all tracker states has been updated
 	
+	/* Private methods: */
+	void notifyTrackerUpdate(void); // Wakes up all threads waiting for tracker updates
+	void copyState(StateSnapshot& snapshot) const; // Copies the current state and tracker stage data of all devices without synchronization
+	
 	/* Constructors and destructors: */
 	public:
 	VRDeviceManager(Misc::ConfigurationFile& configFile); // Creates device manager by reading current section of configuration file
@@ -118,6 +193,7 @@ class VRDeviceManager
 	void setTrackerState(int trackerIndex,const Vrui::VRDeviceState::TrackerState& newTrackerState,Vrui::VRDeviceState::TimeStamp newTimeStamp); // Updates state of single tracker
 	void setButtonState(int buttonIndex,Vrui::VRDeviceState::ButtonState newButtonState); // Updates state of single button
 	void setValuatorState(int valuatorIndex,Vrui::VRDeviceState::ValuatorState newValuatorState); // Updates state of single valuator
+	void setStateRange(int trackerIndexBase,int buttonIndexBase,int valuatorIndexBase,const Vrui::VRDeviceState& newState); // Updates the contiguous ranges of trackers, buttons, and valuators owned by a single device from the given state in one operation; only trackers whose time stamps changed are treated as new samples
 	void updateState(void); // Tells device manager that the current state should be considered "complete"
 	
 	/* Methods to communicate with device server: */
@@ -129,18 +205,13 @@ class VRDeviceManager
 		{
 		return *(virtualDevices[deviceIndex]);
 		}
-	void lockState(void) // Locks current device states
-		{
-		stateMutex.lock();
-		};
-	void unlockState(void) // Unlocks current device states
-		{
-		stateMutex.unlock();
-		};
-	Vrui::VRDeviceState& getState(void) // Returns current state of all managed devices (state must be locked while being used)
+	const Vrui::VRDeviceState& getState(void) const // Returns current state of all managed devices; only for querying the state's layout, use snapshotState to read state values
 		{
 		return state;
 		};
+	void snapshotState(StateSnapshot& snapshot); // Copies a consistent state of all managed devices into the given snapshot without blocking device updates
+	void reportDelivery(const StateSnapshot& snapshot); // Records the queue and delivery latencies of all tracker samples in the given snapshot that were not delivered before, which was just sent to one or more clients
+	void getStatistics(Vrui::VRDeviceStatistics& statistics,bool reset); // Fills in the device statistics of the given statistics object; starts a new observation period if flag is true
 	void enableTrackerUpdateNotification(Threads::MutexCond* sTrackerUpdateCompleteCond); // Sets a condition variable to be signalled when all trackers have updated
 	void disableTrackerUpdateNotification(void); // Disables tracker update notification
 	void start(void); // Starts device processing
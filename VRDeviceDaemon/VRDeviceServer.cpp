@@ -24,17 +24,96 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <VRDeviceDaemon/VRDeviceServer.h>
 
 #include <stdio.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#endif
 #include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Misc/PrintInteger.h>
 #include <Misc/StandardValueCoders.h>
 #include <Misc/ConfigurationFile.h>
+#include <Vrui/Internal/VRDeviceState.h>
 #include <Vrui/Internal/VRDeviceDescriptor.h>
+#include <Vrui/Internal/VRDeviceStatistics.h>
 
 #include <VRDeviceDaemon/VRDeviceManager.h>
 
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+void sendTimeStamp(Vrui::VRDevicePipe& pipe) // Sends a time stamp reply message containing the server's current time
+	{
+	pipe.writeMessage(Vrui::VRDevicePipe::TIMESTAMP_REPLY);
+	pipe.write<Vrui::VRDeviceState::TimeStamp>(Vrui::VRDeviceState::getCurrentTimeStamp());
+	pipe.flush();
+	}
+
+}
+
 /*******************************
 Methods of class VRDeviceServer:
 *******************************/
 
+void VRDeviceServer::sendState(VRDeviceServer::ClientData* clientData,const Vrui::VRDeviceState& state)
+	{
+	/* Send packet reply message: */
+	clientData->pipe.writeMessage(Vrui::VRDevicePipe::PACKET_REPLY);
+	
+	/* Send server state: */
+	state.write(clientData->pipe,clientData->clientExpectsTimeStamps);
+	
+	/* Send the packet's send time to let the client measure network latency: */
+	if(clientData->clientExpectsSendTimes)
+		clientData->pipe.write<Vrui::VRDeviceState::TimeStamp>(Vrui::VRDeviceState::getCurrentTimeStamp());
+	
+	clientData->pipe.flush();
+	++clientData->numPacketsSent;
+	}
+
+void VRDeviceServer::sendStatistics(VRDeviceServer::ClientData* clientData,bool reset)
+	{
+	/* Query the device manager's statistics: */
+	Vrui::VRDeviceStatistics statistics;
+	deviceManager->getStatistics(statistics,reset);
+	
+	/* Query the state of all connected clients: */
+	{
+	Threads::Mutex::Lock clientListLock(clientListMutex);
+	statistics.clients.reserve(clientList.size());
+	for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
+		{
+		Vrui::VRDeviceStatistics::ClientStatistics cs;
+		cs.name=(*clIt)->name;
+		cs.protocolVersion=(*clIt)->protocolVersion;
+		cs.active=(*clIt)->active;
+		cs.streaming=(*clIt)->streaming;
+		cs.numPacketsSent=(*clIt)->numPacketsSent;
+		
+		/* Query the number of unsent bytes in the client's socket send buffer: */
+		cs.sendBacklog=0;
+		#ifdef __linux__
+		int backlog=0;
+		if(ioctl((*clIt)->pipe.getFd(),SIOCOUTQ,&backlog)==0)
+			cs.sendBacklog=(unsigned int)backlog;
+		#endif
+		
+		statistics.clients.push_back(cs);
+		}
+	}
+	
+	/* Lock the pipe for writing: */
+	Threads::Mutex::Lock pipeLock(clientData->pipeMutex);
+	
+	/* Send statistics reply message: */
+	clientData->pipe.writeMessage(Vrui::VRDevicePipe::STATISTICS_REPLY);
+	statistics.write(clientData->pipe);
+	clientData->pipe.flush();
+	}
+
 void* VRDeviceServer::listenThreadMethod(void)
 	{
 	/* Enable immediate cancellation of this thread: */
@@ -50,6 +129,12 @@ void* VRDeviceServer::listenThreadMethod(void)
 		#endif
 		ClientData* newClient=new ClientData(listenSocket);
 		
+		/* Identify the new client by its address and port for statistics reports: */
+		char portId[12];
+		newClient->name=newClient->pipe.getPeerAddress();
+		newClient->name.push_back(':');
+		newClient->name.append(Misc::print(newClient->pipe.getPeerPortId(),portId+11));
+		
 		/* Connect the new client: */
 		#ifdef VERBOSE
 		printf("VRDeviceServer: Connecting new client from %s, port %d\n",newClient->pipe.getPeerHostName().c_str(),newClient->pipe.getPeerPortId());
@@ -122,6 +207,9 @@ void* VRDeviceServer::clientCommunicationThreadMethod(VRDeviceServer::ClientData
 							/* Check if the client expects tracker state time stamps: */
 							clientData->clientExpectsTimeStamps=clientData->protocolVersion>=3U;
 							
+							/* Check if the client expects packet send times: */
+							clientData->clientExpectsSendTimes=clientData->protocolVersion>=5U;
+							
 							pipe.flush();
 							}
 							
@@ -155,6 +243,21 @@ void* VRDeviceServer::clientCommunicationThreadMethod(VRDeviceServer::ClientData
 							state=ACTIVE;
 							break;
 						
+						case Vrui::VRDevicePipe::TIMESTAMP_REQUEST:
+							{
+							/* Lock the pipe for writing: */
+							Threads::Mutex::Lock pipeLock(clientData->pipeMutex);
+							
+							/* Send the server's current time stamp: */
+							sendTimeStamp(pipe);
+							}
+							break;
+						
+						case Vrui::VRDevicePipe::STATISTICS_REQUEST:
+							/* Send the server's statistics, and reset them if requested: */
+							sendStatistics(clientData,pipe.read<Misc::UInt8>()!=0);
+							break;
+						
 						default:
 							state=FINISH;
 						}
@@ -165,38 +268,66 @@ void* VRDeviceServer::clientCommunicationThreadMethod(VRDeviceServer::ClientData
 						{
 						case Vrui::VRDevicePipe::PACKET_REQUEST:
 						case Vrui::VRDevicePipe::STARTSTREAM_REQUEST:
-							deviceManager->lockState();
-							try
-								{
-								/* Lock the pipe for writing: */
-								Threads::Mutex::Lock pipeLock(clientData->pipeMutex);
-								
-								if(message==Vrui::VRDevicePipe::STARTSTREAM_REQUEST)
-									{
-									/* Enable streaming: */
-									clientData->streaming=true;
-									}
-								
-								/* Send packet reply message: */
-								pipe.writeMessage(Vrui::VRDevicePipe::PACKET_REPLY);
-								
-								/* Send server state: */
-								deviceManager->getState().write(pipe,clientData->clientExpectsTimeStamps);
-								pipe.flush();
-								}
-							catch(...)
+							{
+							/* Take a snapshot of the current server state: */
+							deviceManager->snapshotState(clientData->stateSnapshot);
+							
+							/* Lock the pipe for writing: */
+							Threads::Mutex::Lock pipeLock(clientData->pipeMutex);
+							
+							if(message==Vrui::VRDevicePipe::STARTSTREAM_REQUEST)
 								{
-								/* Unlock the device manager's state and throw the exception again: */
-								deviceManager->unlockState();
-								throw;
+								/* Enable streaming: */
+								clientData->streaming=true;
 								}
-							deviceManager->unlockState();
+							
+							/* Send server state: */
+							sendState(clientData,clientData->stateSnapshot.state);
+							}
+							
+							/* Record the delivery latencies of the sent state: */
+							deviceManager->reportDelivery(clientData->stateSnapshot);
 							
 							if(message==Vrui::VRDevicePipe::STARTSTREAM_REQUEST)
 								state=STREAMING;
 							
 							break;
 						
+						case Vrui::VRDevicePipe::PREDICTEDPACKET_REQUEST:
+							{
+							/* Read the requested prediction time stamp: */
+							Vrui::VRDeviceState::TimeStamp predictionTime=pipe.read<Vrui::VRDeviceState::TimeStamp>();
+							
+							/* Take a snapshot of the current server state: */
+							deviceManager->snapshotState(clientData->stateSnapshot);
+							Vrui::VRDeviceState& predictedState=clientData->stateSnapshot.state;
+							
+							/* Extrapolate all tracker states to the requested time: */
+							predictedState.predictTrackerStates(predictionTime);
+							
+							/* Lock the pipe for writing: */
+							Threads::Mutex::Lock pipeLock(clientData->pipeMutex);
+							
+							/* Send predicted server state: */
+							sendState(clientData,predictedState);
+							}
+							break;
+						
+						case Vrui::VRDevicePipe::TIMESTAMP_REQUEST:
+							{
+							/* Lock the pipe for writing: */
+							Threads::Mutex::Lock pipeLock(clientData->pipeMutex);
+							
+							/* Send the server's current time stamp: */
+							sendTimeStamp(pipe);
+							}
+							break;
+						
+						case Vrui::VRDevicePipe::STATISTICS_REQUEST:
+							/* Send the server's statistics, and reset them if requested: */
+							sendStatistics(clientData,pipe.read<Misc::UInt8>()!=0);
+							break;
+						
 						case Vrui::VRDevicePipe::DEACTIVATE_REQUEST:
 							{
 							/* Lock the client list: */
@@ -227,6 +358,16 @@ void* VRDeviceServer::clientCommunicationThreadMethod(VRDeviceServer::ClientData
 							/* Ignore message: */
 							break;
 						
+						case Vrui::VRDevicePipe::TIMESTAMP_REQUEST:
+							{
+							/* Lock the pipe for writing: */
+							Threads::Mutex::Lock pipeLock(clientData->pipeMutex);
+							
+							/* Send the server's current time stamp between stream packets: */
+							sendTimeStamp(pipe);
+							}
+							break;
+						
 						case Vrui::VRDevicePipe::STOPSTREAM_REQUEST:
 							{
 							/* Lock the pipe for writing: */
@@ -315,11 +456,12 @@ void* VRDeviceServer::streamingThreadMethod(void)
 		{
 		Threads::Mutex::Lock clientListLock(clientListMutex);
 		
-		/* Lock the device manager's current state: */
-		deviceManager->lockState();
+		/* Take a snapshot of the device manager's current state: */
+		deviceManager->snapshotState(streamStateSnapshot);
 		
 		/* Iterate through all clients in streaming mode: */
 		std::vector<ClientList::iterator> deadClients;
+		bool sent=false;
 		for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
 			{
 			/* Lock the client's pipe: */
@@ -329,12 +471,9 @@ void* VRDeviceServer::streamingThreadMethod(void)
 				{
 				try
 					{
-					/* Send packet reply message: */
-					(*clIt)->pipe.writeMessage(Vrui::VRDevicePipe::PACKET_REPLY);
-					
 					/* Send server state: */
-					deviceManager->getState().write((*clIt)->pipe,(*clIt)->clientExpectsTimeStamps);
-					(*clIt)->pipe.flush();
+					sendState(*clIt,streamStateSnapshot.state);
+					sent=true;
 					}
 				catch(std::runtime_error err)
 					{
@@ -356,8 +495,9 @@ void* VRDeviceServer::streamingThreadMethod(void)
 				}
 			}
 		
-		/* Unlock the device manager's state: */
-		deviceManager->unlockState();
+		/* Record the delivery latencies of the streamed state: */
+		if(sent)
+			deviceManager->reportDelivery(streamStateSnapshot);
 		
 		/* Disconnect all dead clients: */
 		for(std::vector<ClientList::iterator>::iterator dcIt=deadClients.begin();dcIt!=deadClients.end();++dcIt)
@@ -423,7 +563,6 @@ VRDeviceServer::~VRDeviceServer(void)
 	listenThread.join();
 	
 	/* Disconnect all clients: */
-	deviceManager->lockState();
 	for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
 		{
 		/* Stop client communication thread: */
@@ -433,7 +572,6 @@ VRDeviceServer::~VRDeviceServer(void)
 		/* Delete client data object (closing TCP socket): */
 		delete *clIt;
 		}
-	deviceManager->unlockState();
 	
 	/* Stop VR devices: */
 	if(numActiveClients>0)
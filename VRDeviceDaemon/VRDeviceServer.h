@@ -21,18 +21,21 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
+#include <string>
 #include <vector>
 #include <Threads/Thread.h>
 #include <Threads/Mutex.h>
 #include <Threads/MutexCond.h>
 #include <Comm/ListeningTCPSocket.h>
+#include <Vrui/Internal/VRDeviceState.h>
 #include <Vrui/Internal/VRDevicePipe.h>
 
+#include <VRDeviceDaemon/VRDeviceManager.h>
+
 /* Forward declarations: */
 namespace Misc {
 class ConfigurationFile;
 }
-class VRDeviceManager;
 
 class VRDeviceServer
 	{
@@ -44,15 +47,19 @@ class VRDeviceServer
 		public:
 		Threads::Mutex pipeMutex; // Mutex serializing write access to the client pipe
 		Vrui::VRDevicePipe pipe; // Pipe connected to the client
+		std::string name; // Client's address and port
 		Threads::Thread communicationThread; // Client communication thread
 		unsigned int protocolVersion; // Version of the VR device daemon protocol to use with this client
 		bool clientExpectsTimeStamps; // Flag whether the connected client expects to receive time stamp data
+		bool clientExpectsSendTimes; // Flag whether the connected client expects to receive the send time of each state packet
 		volatile bool active; // Flag if the client is active
 		volatile bool streaming; // Flag if the client is streaming
+		unsigned int numPacketsSent; // Number of state packets sent to the client
+		VRDeviceManager::StateSnapshot stateSnapshot; // Snapshot of the device manager's state used to answer this client's packet requests
 		
 		/* Constructors and destructors: */
 		ClientData(Comm::ListeningTCPSocket& listenSocket) // Accepts next incoming connection on given listening socket and establishes VR device connection
-			:pipe(listenSocket),protocolVersion(0),active(false),streaming(false)
+			:pipe(listenSocket),protocolVersion(0),clientExpectsTimeStamps(false),clientExpectsSendTimes(false),active(false),streaming(false),numPacketsSent(0)
 			{
 			};
 		};
@@ -69,11 +76,14 @@ class VRDeviceServer
 	int numActiveClients; // Number of clients that are currently active
 	Threads::Thread streamingThread; // Thread to stream device states to clients
 	Threads::MutexCond trackerUpdateCompleteCond; // Tracker update notification condition variable
+	VRDeviceManager::StateSnapshot streamStateSnapshot; // Snapshot of the device manager's state sent to all streaming clients
 	
 	/* Private methods: */
 	void* listenThreadMethod(void); // Connection initiating thread method
 	void* clientCommunicationThreadMethod(ClientData* clientData); // Client communication thread method
 	void* streamingThreadMethod(void); // Method to stream device states to all clients who are currently streaming
+	void sendState(ClientData* clientData,const Vrui::VRDeviceState& state); // Sends a state packet to the given client; client's pipe must be locked by caller
+	void sendStatistics(ClientData* clientData,bool reset); // Sends the server's device and client statistics to the given client
 	
 	/* Constructors and destructors: */
 	public:
@@ -22,10 +22,14 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <VRDeviceDaemon/VRDevices/RemoteDevice.h>
 
+#include <stdio.h>
+#include <sys/socket.h>
+#include <stdexcept>
 #include <Misc/ThrowStdErr.h>
 #include <Misc/Time.h>
 #include <Misc/StandardValueCoders.h>
 #include <Misc/ConfigurationFile.h>
+#include <Vrui/Internal/VRDeviceDescriptor.h>
 
 #include <VRDeviceDaemon/VRCalibrator.h>
 #include <VRDeviceDaemon/VRDeviceManager.h>
@@ -34,46 +38,253 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 Methods of class RemoteDevice:
 *****************************/
 
+void RemoteDevice::connectToServer(bool readLayout)
+	{
+	/* Connect to the remote device server: */
+	#ifdef VERBOSE
+	printf("RemoteDevice: Connecting to device server %s:%d\n",serverName.c_str(),serverPort);
+	fflush(stdout);
+	#endif
+	Vrui::VRDevicePipe* newPipe=new Vrui::VRDevicePipe(serverName.c_str(),serverPort);
+	{
+	Threads::Spinlock::Lock pipeLock(pipeMutex);
+	pipe=newPipe;
+	}
+	
+	/* Initiate connection: */
+	pipe->writeMessage(Vrui::VRDevicePipe::CONNECT_REQUEST);
+	pipe->write<unsigned int>(Vrui::VRDevicePipe::protocolVersionNumber);
+	pipe->flush();
+	
+	/* Wait for server's reply: */
+	if(!pipe->waitForData(Misc::Time(10,0))) // Throw exception if reply does not arrive in time
+		Misc::throwStdErr("RemoteDevice: Timeout while waiting for CONNECT_REPLY");
+	if(pipe->readMessage()!=Vrui::VRDevicePipe::CONNECT_REPLY)
+		Misc::throwStdErr("RemoteDevice: Mismatching message while waiting for CONNECT_REPLY");
+	serverProtocolVersion=pipe->read<unsigned int>();
+	if(serverProtocolVersion<1U||serverProtocolVersion>Vrui::VRDevicePipe::protocolVersionNumber)
+		Misc::throwStdErr("RemoteDevice: Unsupported server protocol version %u",serverProtocolVersion);
+	
+	/* Read server's layout: */
+	if(readLayout)
+		state.readLayout(*pipe);
+	else
+		{
+		/* Check that the server's layout did not change since the initial connection: */
+		Vrui::VRDeviceState newLayout;
+		newLayout.readLayout(*pipe);
+		if(newLayout.getNumTrackers()!=state.getNumTrackers()||newLayout.getNumButtons()!=state.getNumButtons()||newLayout.getNumValuators()!=state.getNumValuators())
+			Misc::throwStdErr("RemoteDevice: Server layout changed between connections");
+		}
+	
+	/* Skip the server's virtual devices: */
+	if(serverProtocolVersion>=2U)
+		{
+		int numVirtualDevices=pipe->read<int>();
+		for(int i=0;i<numVirtualDevices;++i)
+			{
+			Vrui::VRDeviceDescriptor vd;
+			vd.read(*pipe);
+			}
+		}
+	
+	/* Estimate the offset to the server's clock: */
+	serverTimeOffset=0U;
+	if(serverProtocolVersion>=4U)
+		synchronizeClocks();
+	}
+
+void RemoteDevice::disconnectFromServer(void)
+	{
+	/* Delete the pipe, which closes the connection; the server deactivates the connection on its end: */
+	Vrui::VRDevicePipe* oldPipe;
+	{
+	Threads::Spinlock::Lock pipeLock(pipeMutex);
+	oldPipe=pipe;
+	pipe=0;
+	}
+	delete oldPipe;
+	}
+
+void RemoteDevice::synchronizeClocks(void)
+	{
+	/* Run a number of time stamp request/reply round trips and keep the estimate from the shortest one: */
+	Vrui::VRDeviceState::TimeStamp minRoundTrip=~Vrui::VRDeviceState::TimeStamp(0);
+	for(int round=0;round<8;++round)
+		{
+		/* Send a time stamp request: */
+		Vrui::VRDeviceState::TimeStamp requestTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+		pipe->writeMessage(Vrui::VRDevicePipe::TIMESTAMP_REQUEST);
+		pipe->flush();
+		
+		/* Wait for the server's reply: */
+		if(!pipe->waitForData(Misc::Time(10,0)))
+			Misc::throwStdErr("RemoteDevice: Timeout while waiting for TIMESTAMP_REPLY");
+		if(pipe->readMessage()!=Vrui::VRDevicePipe::TIMESTAMP_REPLY)
+			Misc::throwStdErr("RemoteDevice: Mismatching message while waiting for TIMESTAMP_REPLY");
+		Vrui::VRDeviceState::TimeStamp serverTime=pipe->read<Vrui::VRDeviceState::TimeStamp>();
+		Vrui::VRDeviceState::TimeStamp replyTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+		
+		/* Assume that the server sampled its clock half-way through the round trip: */
+		Vrui::VRDeviceState::TimeStamp roundTrip=replyTime-requestTime;
+		if(minRoundTrip>roundTrip)
+			{
+			minRoundTrip=roundTrip;
+			serverTimeOffset=serverTime-(requestTime+roundTrip/2);
+			}
+		}
+	
+	/* Remember the best round trip time to judge later updates while streaming: */
+	clockSyncRoundTrip=minRoundTrip;
+	clockSyncTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+	clockSyncPending=false;
+	}
+
+void RemoteDevice::readServerState(void)
+	{
+	/* Read the server's state: */
+	state.read(*pipe,serverProtocolVersion>=3U);
+	if(serverProtocolVersion>=3U)
+		{
+		/* Convert the server's time stamps to local time: */
+		Vrui::VRDeviceState::TimeStamp* tsPtr=state.getTrackerTimeStamps();
+		for(int i=0;i<state.getNumTrackers();++i)
+			tsPtr[i]-=serverTimeOffset;
+		}
+	else
+		{
+		/* Time-stamp all trackers with the reception time: */
+		Vrui::VRDeviceState::TimeStamp now=Vrui::VRDeviceState::getCurrentTimeStamp();
+		for(int i=0;i<state.getNumTrackers();++i)
+			state.setTrackerTimeStamp(i,now);
+		}
+	
+	/* Skip the packet's send time: */
+	if(serverProtocolVersion>=5U)
+		pipe->read<Vrui::VRDeviceState::TimeStamp>();
+	}
+
+void RemoteDevice::requestClockResync(void)
+	{
+	/* Send a time stamp request if the server supports them, and the last request is not pending and old enough: */
+	if(serverProtocolVersion>=4U&&!clockSyncPending&&Vrui::VRDeviceState::getCurrentTimeStamp()-clockSyncTime>=10000000U)
+		{
+		clockSyncTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+		pipe->writeMessage(Vrui::VRDevicePipe::TIMESTAMP_REQUEST);
+		pipe->flush();
+		clockSyncPending=true;
+		}
+	}
+
+void RemoteDevice::readClockResync(void)
+	{
+	Vrui::VRDeviceState::TimeStamp serverTime=pipe->read<Vrui::VRDeviceState::TimeStamp>();
+	Vrui::VRDeviceState::TimeStamp replyTime=Vrui::VRDeviceState::getCurrentTimeStamp();
+	clockSyncPending=false;
+	
+	/* Only accept the new estimate if the reply was not delayed much behind queued state packets: */
+	Vrui::VRDeviceState::TimeStamp roundTrip=replyTime-clockSyncTime;
+	if(roundTrip<=clockSyncRoundTrip*2U+500U)
+		serverTimeOffset=serverTime-(clockSyncTime+roundTrip/2);
+	}
+
 void RemoteDevice::deviceThreadMethod(void)
 	{
-	while(true)
+	double reconnectWait=reconnectInterval;
+	while(keepRunning)
 		{
-		/* Wait for next message: */
-		if(pipe.readMessage()==Vrui::VRDevicePipe::PACKET_REPLY) // Just ignore any other messages
+		try
+			{
+			/* Connect to the server if not already connected: */
+			if(pipe==0)
+				connectToServer(false);
+			
+			/* Bail out if the device was stopped while connecting: */
 			{
-			/* Read current server state: */
-			state.read(pipe,false);
+			Threads::Spinlock::Lock pipeLock(pipeMutex);
+			if(!keepRunning)
+				break;
+			}
+			
+			/* Activate the server and start streaming: */
+			pipe->writeMessage(Vrui::VRDevicePipe::ACTIVATE_REQUEST);
+			pipe->writeMessage(Vrui::VRDevicePipe::STARTSTREAM_REQUEST);
+			pipe->flush();
+			reconnectWait=reconnectInterval;
 			
-			/* Copy new state into device manager: */
-			for(int i=0;i<state.getNumValuators();++i)
-				setValuatorState(i,state.getValuatorState(i));
-			for(int i=0;i<state.getNumButtons();++i)
-				setButtonState(i,state.getButtonState(i));
-			for(int i=0;i<state.getNumTrackers();++i)
-				setTrackerState(i,state.getTrackerState(i));
+			/* Forward state packets as soon as they arrive: */
+			while(keepRunning)
+				{
+				/* Wait for next message: */
+				Vrui::VRDevicePipe::MessageIdType message=pipe->readMessage();
+				if(message==Vrui::VRDevicePipe::TIMESTAMP_REPLY)
+					{
+					/* Update the clock offset estimate: */
+					readClockResync();
+					}
+				else if(message==Vrui::VRDevicePipe::PACKET_REPLY) // Just ignore any other messages
+					{
+					/* Read current server state: */
+					readServerState();
+					
+					if(directForwarding)
+						{
+						/* Calibrate the new state and copy it into the device manager in one operation: */
+						setState(state);
+						}
+					else
+						{
+						/* Copy new state into device manager one element at a time: */
+						for(int i=0;i<state.getNumValuators();++i)
+							setValuatorState(i,state.getValuatorState(i));
+						for(int i=0;i<state.getNumButtons();++i)
+							setButtonState(i,state.getButtonState(i));
+						for(int i=0;i<state.getNumTrackers();++i)
+							setTrackerState(i,state.getTrackerState(i),state.getTrackerTimeStamp(i));
+						}
+					
+					/* Periodically update the clock offset estimate to compensate for clock drift: */
+					requestClockResync();
+					}
+				}
+			}
+		catch(std::runtime_error err)
+			{
+			if(!keepRunning)
+				break;
+			
+			fprintf(stderr,"RemoteDevice: Lost connection to device server %s:%d due to exception %s; reconnecting in %f s\n",serverName.c_str(),serverPort,err.what(),reconnectWait);
+			fflush(stderr);
+			disconnectFromServer();
+			
+			/* Wait before the next reconnection attempt, unless the device is stopped in the meantime: */
+			{
+			Threads::MutexCond::Lock reconnectLock(reconnectCond);
+			if(keepRunning)
+				reconnectCond.timedWait(reconnectLock,Misc::Time::now()+Misc::Time(reconnectWait));
+			}
+			
+			/* Back off exponentially: */
+			reconnectWait*=2.0;
+			if(reconnectWait>maxReconnectInterval)
+				reconnectWait=maxReconnectInterval;
 			}
 		}
 	}
 
 RemoteDevice::RemoteDevice(VRDevice::Factory* sFactory,VRDeviceManager* sDeviceManager,Misc::ConfigurationFile& configFile)
 	:VRDevice(sFactory,sDeviceManager,configFile),
-	 pipe(configFile.retrieveString("./serverName").c_str(),configFile.retrieveValue<int>("./serverPort"))
+	 serverName(configFile.retrieveString("./serverName")),
+	 serverPort(configFile.retrieveValue<int>("./serverPort")),
+	 directForwarding(configFile.retrieveValue<bool>("./directForwarding",true)),
+	 reconnectInterval(configFile.retrieveValue<double>("./reconnectInterval",0.5)),
+	 maxReconnectInterval(configFile.retrieveValue<double>("./maxReconnectInterval",8.0)),
+	 pipe(0),serverProtocolVersion(0),serverTimeOffset(0U),
+	 clockSyncRoundTrip(0U),clockSyncTime(0U),clockSyncPending(false),
+	 keepRunning(false)
 	{
-	/* Initiate connection: */
-	#ifdef VERBOSE
-	printf("RemoteDevice: Connecting to device server\n");
-	fflush(stdout);
-	#endif
-	pipe.writeMessage(Vrui::VRDevicePipe::CONNECT_REQUEST);
-	
-	/* Wait for server's reply: */
-	if(!pipe.waitForData(Misc::Time(10,0))) // Throw exception if reply does not arrive in time
-		Misc::throwStdErr("RemoteDevice: Timeout while waiting for CONNECT_REPLY");
-	if(pipe.readMessage()!=Vrui::VRDevicePipe::CONNECT_REPLY)
-		Misc::throwStdErr("RemoteDevice: Mismatching message while waiting for CONNECT_REPLY");
-	
-	/* Read server's layout and initialize current state: */
-	state.readLayout(pipe);
+	/* Connect to the server to query its layout: */
+	connectToServer(true);
 	#ifdef VERBOSE
 	printf("RemoteDevice: Serving %d trackers, %d buttons, %d valuators\n",state.getNumTrackers(),state.getNumButtons(),state.getNumValuators());
 	fflush(stdout);
@@ -86,27 +297,49 @@ RemoteDevice::RemoteDevice(VRDevice::Factory* sFactory,VRDeviceManager* sDeviceM
 RemoteDevice::~RemoteDevice(void)
 	{
 	/* Disconnect from device server: */
-	pipe.writeMessage(Vrui::VRDevicePipe::DISCONNECT_REQUEST);
+	if(pipe!=0)
+		{
+		try
+			{
+			pipe->writeMessage(Vrui::VRDevicePipe::DISCONNECT_REQUEST);
+			pipe->flush();
+			}
+		catch(std::runtime_error)
+			{
+			/* Ignore errors; the connection is closed anyway */
+			}
+		disconnectFromServer();
+		}
 	}
 
 void RemoteDevice::start(void)
 	{
-	/* Start device communication thread: */
+	/* Start device communication thread, which connects to the server if necessary and activates it: */
+	keepRunning=true;
 	startDeviceThread();
-	
-	/* Activate device server: */
-	pipe.writeMessage(Vrui::VRDevicePipe::ACTIVATE_REQUEST);
-	pipe.writeMessage(Vrui::VRDevicePipe::STARTSTREAM_REQUEST);
 	}
 
 void RemoteDevice::stop(void)
 	{
-	/* Deactivate device server: */
-	pipe.writeMessage(Vrui::VRDevicePipe::STOPSTREAM_REQUEST);
-	pipe.writeMessage(Vrui::VRDevicePipe::DEACTIVATE_REQUEST);
+	/* Tell the device communication thread to shut down: */
+	{
+	Threads::MutexCond::Lock reconnectLock(reconnectCond);
+	keepRunning=false;
+	reconnectCond.signal();
+	}
+	
+	/* Wake up the device communication thread if it is waiting for data; shut down the socket directly as the pipe's buffers belong to the thread: */
+	{
+	Threads::Spinlock::Lock pipeLock(pipeMutex);
+	if(pipe!=0)
+		::shutdown(pipe->getFd(),SHUT_RDWR);
+	}
 	
 	/* Stop device communication thread: */
-	stopDeviceThread();
+	stopDeviceThread(false);
+	
+	/* Close the shut-down connection; the next start will reconnect, which also deactivates the server: */
+	disconnectFromServer();
 	}
 
 /*************************************
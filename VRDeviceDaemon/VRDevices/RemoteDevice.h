@@ -23,6 +23,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef REMOTEDEVICE_INCLUDED
 #define REMOTEDEVICE_INCLUDED
 
+#include <string>
+#include <Threads/Spinlock.h>
+#include <Threads/MutexCond.h>
 #include <Vrui/Internal/VRDeviceState.h>
 #include <Vrui/Internal/VRDevicePipe.h>
 
@@ -32,8 +35,29 @@ class RemoteDevice:public VRDevice
 	{
 	/* Elements: */
 	private:
-	Vrui::VRDevicePipe pipe; // Pipe connected to device server
+	std::string serverName; // Host name of the remote device server
+	int serverPort; // Port number of the remote device server
+	bool directForwarding; // Flag whether to calibrate each remote state as a whole and forward it into the device manager in one operation, instead of one element at a time
+	double reconnectInterval; // Initial interval between attempts to reconnect to the remote device server in seconds
+	double maxReconnectInterval; // Maximum interval between reconnection attempts in seconds
+	Threads::Spinlock pipeMutex; // Mutex protecting the pipe pointer against concurrent shutdown
+	Vrui::VRDevicePipe* pipe; // Pipe connected to device server, or null if disconnected
+	unsigned int serverProtocolVersion; // Protocol version negotiated with the remote device server
+	Vrui::VRDeviceState::TimeStamp serverTimeOffset; // Offset from the local monotonic clock to the remote server's clock in microseconds
+	Vrui::VRDeviceState::TimeStamp clockSyncRoundTrip; // Shortest round trip time observed during the last full clock synchronization in microseconds
+	Vrui::VRDeviceState::TimeStamp clockSyncTime; // Local time at which the most recent time stamp request was sent
+	bool clockSyncPending; // Flag whether a time stamp request was sent while streaming and its reply has not arrived yet
 	Vrui::VRDeviceState state; // Shadow of server's current state
+	volatile bool keepRunning; // Flag to shut down the device communication thread
+	Threads::MutexCond reconnectCond; // Condition variable to interrupt waiting between reconnection attempts
+	
+	/* Private methods: */
+	void connectToServer(bool readLayout); // Connects to the remote device server and reads its layout; checks the layout against the current one if flag is false
+	void disconnectFromServer(void); // Closes the connection to the remote device server
+	void synchronizeClocks(void); // Estimates the offset between the local and remote servers' clocks
+	void readServerState(void); // Reads a state packet from the remote server and converts its time stamps to local time
+	void requestClockResync(void); // Sends a time stamp request while streaming if the clock offset estimate is due for an update
+	void readClockResync(void); // Reads a time stamp reply while streaming and updates the clock offset estimate if the round trip was fast enough
 	
 	/* Protected methods: */
 	virtual void deviceThreadMethod(void);
@@ -25,6 +25,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/Internal/InputDeviceAdapterDeviceDaemon.h>
 
 #include <stdio.h>
+#include <Misc/SizedTypes.h>
 #include <Misc/ThrowStdErr.h>
 #include <Misc/FunctionCalls.h>
 #include <Misc/StandardValueCoders.h>
@@ -39,14 +40,8 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/InputGraphManager.h>
 #include <Vrui/Internal/VRDeviceDescriptor.h>
 
-// #define MEASURE_LATENCY
 // #define SAVE_TRACKERSTATES
 
-#ifdef MEASURE_LATENCY
-#include <Realtime/Time.h>
-Realtime::TimePointMonotonic lastUpdate;
-#endif
-
 #ifdef SAVE_TRACKERSTATES
 #include <IO/File.h>
 #include <IO/OpenFile.h>
@@ -63,12 +58,6 @@ Methods of class InputDeviceAdapterDeviceDaemon:
 
 void InputDeviceAdapterDeviceDaemon::packetNotificationCallback(VRDeviceClient* client)
 	{
-	#ifdef MEASURE_LATENCY
-	Realtime::TimePointMonotonic now;
-	VRDeviceState::TimeStamp nowTs=VRDeviceState::TimeStamp(now.tv_sec*1000000+(now.tv_nsec+500)/1000);
-	printf("Packet interval: %f ms, arrival latency: %f ms\n",double(lastUpdate.setAndDiff())*1000.0,double(nowTs-client->getState().getTrackerTimeStamp(0))/1000.0);
-	#endif
-	
 	#ifdef SAVE_TRACKERSTATES
 	realFile->write<Misc::UInt32>(client->getState().getTrackerTimeStamp(0));
 	Misc::Marshaller<VRDeviceState::TrackerState::PositionOrientation>::write(client->getState().getTrackerState(0).positionOrientation,*realFile);
@@ -195,8 +184,17 @@ void InputDeviceAdapterDeviceDaemon::createInputDevice(int deviceIndex,const Mis
 InputDeviceAdapterDeviceDaemon::InputDeviceAdapterDeviceDaemon(InputDeviceManager* sInputDeviceManager,const Misc::ConfigurationFileSection& configFileSection)
 	:InputDeviceAdapterIndexMap(sInputDeviceManager),
 	 deviceClient(configFileSection),
-	 motionPredictionDelta(configFileSection.retrieveValue<float>("./motionPrediction",0.0f))
+	 motionPredictionDelta(configFileSection.retrieveValue<float>("./motionPrediction",0.0f)),
+	 networkLatency(0),applyLatency(0),dataAge(0),lastPacketReceiveTime(0U)
 	{
+	/* Create latency histograms if requested: */
+	if(configFileSection.retrieveValue<bool>("./printLatencyStatistics",false))
+		{
+		networkLatency=new Math::Histogram<int>(50,0,20000);
+		applyLatency=new Math::Histogram<int>(50,0,20000);
+		dataAge=new Math::Histogram<int>(50,0,20000);
+		}
+	
 	#ifdef SAVE_TRACKERSTATES
 	realFile=IO::openFile("RealTrackerData.dat",IO::File::WriteOnly);
 	realFile->setEndianness(Misc::LittleEndian);
@@ -221,6 +219,21 @@ InputDeviceAdapterDeviceDaemon::~InputDeviceAdapterDeviceDaemon(void)
 	deviceClient.stopStream();
 	deviceClient.deactivate();
 	
+	if(dataAge!=0)
+		{
+		/* Print the collected latency statistics: */
+		if(networkLatency->getNumSamples()>0&&deviceClient.hasPacketSendTimes())
+			printf("InputDeviceAdapterDeviceDaemon: Network latency from %u packets: median %d us, 90%% %d us, 99%% %d us, max %d us\n",(unsigned int)networkLatency->getNumSamples(),networkLatency->getPercentile(0.5),networkLatency->getPercentile(0.9),networkLatency->getPercentile(0.99),networkLatency->getMaxValue());
+		if(applyLatency->getNumSamples()>0)
+			printf("InputDeviceAdapterDeviceDaemon: Packet application latency from %u packets: median %d us, 90%% %d us, 99%% %d us, max %d us\n",(unsigned int)applyLatency->getNumSamples(),applyLatency->getPercentile(0.5),applyLatency->getPercentile(0.9),applyLatency->getPercentile(0.99),applyLatency->getMaxValue());
+		if(dataAge->getNumSamples()>0)
+			printf("InputDeviceAdapterDeviceDaemon: Tracking data age from %u samples: median %d us, 90%% %d us, 99%% %d us, max %d us\n",(unsigned int)dataAge->getNumSamples(),dataAge->getPercentile(0.5),dataAge->getPercentile(0.9),dataAge->getPercentile(0.99),dataAge->getMaxValue());
+		fflush(stdout);
+		}
+	delete networkLatency;
+	delete applyLatency;
+	delete dataAge;
+	
 	#ifdef SAVE_TRACKERSTATES
 	realFile=0;
 	predictedFile=0;
@@ -310,22 +323,25 @@ void InputDeviceAdapterDeviceDaemon::updateInputDevices(void)
 	deviceClient.lockState();
 	const VRDeviceState& state=deviceClient.getState();
 	
-	#ifdef MEASURE_LATENCY
-	
-	Realtime::TimePointMonotonic now;
-	VRDeviceState::TimeStamp ts=VRDeviceState::TimeStamp(now.tv_sec*1000000+(now.tv_nsec+500)/1000);
-	
-	double staleness=0.0;
-	for(int i=0;i<state.getNumTrackers();++i)
-		staleness+=double(ts-state.getTrackerTimeStamp(i));
-	printf("Tracking data staleness: %f ms\n",staleness*0.001/double(state.getNumTrackers()));
-	
-	#endif
-	
 	/* Get the current time for input device motion prediction: */
 	Realtime::TimePointMonotonic now;
 	VRDeviceState::TimeStamp nowTs=VRDeviceState::TimeStamp(now.tv_sec*1000000+(now.tv_nsec+500)/1000);
 	
+	if(dataAge!=0)
+		{
+		/* Record the network and application latencies of the current state packet if it has not been seen before: */
+		if(lastPacketReceiveTime!=deviceClient.getPacketReceiveTime())
+			{
+			lastPacketReceiveTime=deviceClient.getPacketReceiveTime();
+			networkLatency->addSample(int(Misc::SInt32(lastPacketReceiveTime-deviceClient.getPacketSendTime())));
+			applyLatency->addSample(int(Misc::SInt32(nowTs-lastPacketReceiveTime)));
+			}
+		
+		/* Record the ages of all tracker states: */
+		for(int i=0;i<state.getNumTrackers();++i)
+			dataAge->addSample(int(Misc::SInt32(nowTs-state.getTrackerTimeStamp(i))));
+		}
+	
 	for(int deviceIndex=0;deviceIndex<numInputDevices;++deviceIndex)
 		{
 		/* Get pointer to the input device: */
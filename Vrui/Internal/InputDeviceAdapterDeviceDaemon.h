@@ -28,6 +28,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <string>
 #include <vector>
 #include <Threads/Spinlock.h>
+#include <Math/Histogram.h>
 #include <Vrui/Internal/VRDeviceClient.h>
 #include <Vrui/Internal/InputDeviceAdapterIndexMap.h>
 
@@ -48,6 +49,10 @@ class InputDeviceAdapterDeviceDaemon:public InputDeviceAdapterIndexMap
 	std::vector<std::string> valuatorNames; // Array of valuator names for all defined input devices
 	Threads::Spinlock errorMessageMutex; // Mutex protecting the error message log
 	std::vector<std::string> errorMessages; // Log of error messages received from the device client
+	Math::Histogram<int>* networkLatency; // Histogram of latencies from the server sending a state packet to its reception in microseconds, or null if statistics are disabled
+	Math::Histogram<int>* applyLatency; // Histogram of latencies from the reception of a state packet to its application to input devices in microseconds, or null if statistics are disabled
+	Math::Histogram<int>* dataAge; // Histogram of ages of tracker states at the time they are applied to input devices in microseconds, or null if statistics are disabled
+	VRDeviceState::TimeStamp lastPacketReceiveTime; // Receive time of the most recently processed state packet
 	
 	/* Private methods: */
 	static void packetNotificationCallback(VRDeviceClient* client);
@@ -46,6 +46,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/InputDeviceManager.h>
 #include <Vrui/TextEventDispatcher.h>
 #include <Vrui/InputGraphManager.h>
+#include <Vrui/Internal/InputDeviceDataChunkReader.h>
 #include <Vrui/Internal/MouseCursorFaker.h>
 #include <Vrui/VRWindow.h>
 #include <Vrui/Internal/Vrui.h>
@@ -60,11 +61,36 @@ namespace Vrui {
 Methods of class InputDeviceAdapterPlayback:
 *******************************************/
 
+bool InputDeviceAdapterPlayback::readNextTimeStamp(void)
+	{
+	if(chunkReader!=0)
+		{
+		/* Get the next frame from the chunk reader: */
+		frameSource=chunkReader->readNextFrame(nextTimeStamp);
+		return frameSource!=0;
+		}
+	else
+		{
+		/* Read the next time stamp directly from the input file: */
+		try
+			{
+			nextTimeStamp=inputDeviceDataFile->read<double>();
+			return true;
+			}
+		catch(IO::File::ReadError)
+			{
+			return false;
+			}
+		}
+	}
+
 InputDeviceAdapterPlayback::InputDeviceAdapterPlayback(InputDeviceManager* sInputDeviceManager,const Misc::ConfigurationFileSection& configFileSection)
 	:InputDeviceAdapter(sInputDeviceManager),
 	 inputDeviceDataFile(IO::openSeekableFile(configFileSection.retrieveString("./inputDeviceDataFileName").c_str())),
+	 chunkReader(0),frameSource(inputDeviceDataFile.getPointer()),
 	 mouseCursorFaker(0),
 	 synchronizePlayback(configFileSection.retrieveValue<bool>("./synchronizePlayback",false)),
+	 playbackSpeed(configFileSection.retrieveValue<double>("./playbackSpeed",1.0)),
 	 quitWhenDone(configFileSection.retrieveValue<bool>("./quitWhenDone",false)),
 	 soundPlayer(0),
 	 #ifdef VRUI_INPUTDEVICEADAPTERPLAYBACK_USE_KINECT
@@ -108,6 +134,11 @@ InputDeviceAdapterPlayback::InputDeviceAdapterPlayback(InputDeviceManager* sInpu
 		/* File version with text and text control events: */
 		fileVersion=4;
 		}
+	else if(strcmp(header+29,"5.0\n")==0)
+		{
+		/* File version with compressed and indexed frame chunks: */
+		fileVersion=5;
+		}
 	else
 		{
 		header[32]='\0';
@@ -195,15 +226,28 @@ InputDeviceAdapterPlayback::InputDeviceAdapterPlayback(InputDeviceManager* sInpu
 		mouseCursorFaker->setCursorHotspot(configFileSection.retrieveValue<Vector>("./mouseCursorHotspot",mouseCursorFaker->getCursorHotspot()));
 		}
 	
+	if(fileVersion>=5)
+		{
+		/* Read the frame chunk index: */
+		chunkReader=new InputDeviceDataChunkReader(inputDeviceDataFile);
+		}
+	
+	/* Check if the user wants to start playback at a later time: */
+	if(configFileSection.hasTag("./startTime"))
+		{
+		if(chunkReader!=0)
+			chunkReader->seekToTime(configFileSection.retrieveValue<double>("./startTime"));
+		else
+			std::cerr<<"InputDeviceAdapterPlayback: Ignoring start time; input device data file version "<<fileVersion<<" does not support seeking"<<std::endl;
+		}
+	
 	/* Read time stamp of first data frame: */
-	try
+	if(readNextTimeStamp())
 		{
-		nextTimeStamp=inputDeviceDataFile->read<double>();
-		
 		/* Request an update for the next frame: */
 		requestUpdate();
 		}
-	catch(IO::File::ReadError)
+	else
 		{
 		done=true;
 		nextTimeStamp=Math::Constants<double>::max;
@@ -291,6 +335,7 @@ InputDeviceAdapterPlayback::InputDeviceAdapterPlayback(InputDeviceManager* sInpu
 
 InputDeviceAdapterPlayback::~InputDeviceAdapterPlayback(void)
 	{
+	delete chunkReader;
 	delete mouseCursorFaker;
 	delete soundPlayer;
 	#ifdef VRUI_INPUTDEVICEADAPTERPLAYBACK_USE_KINECT
@@ -358,7 +403,7 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 				/* Calculate the offset between the saved timestamps and the system's wall clock time: */
 				Misc::Time rt=Misc::Time::now();
 				double realTime=double(rt.tv_sec)+double(rt.tv_nsec)/1000000000.0;
-				timeStampOffset=nextTimeStamp-realTime;
+				timeStampOffset=nextTimeStamp-realTime*playbackSpeed;
 				}
 			
 			/* Start the sound player, if there is one: */
@@ -384,7 +429,7 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 		/* Check if there is positive drift between the system's offset wall clock time and the next time stamp: */
 		Misc::Time rt=Misc::Time::now();
 		double realTime=double(rt.tv_sec)+double(rt.tv_nsec)/1000000000.0;
-		double delta=nextTimeStamp-(realTime+timeStampOffset);
+		double delta=(nextTimeStamp-(realTime*playbackSpeed+timeStampOffset))/playbackSpeed;
 		if(delta>0.0)
 			{
 			/* Block to correct the drift: */
@@ -401,20 +446,20 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 			if(fileVersion>=3)
 				{
 				Vector deviceRayDir;
-				inputDeviceDataFile->read(deviceRayDir.getComponents(),3);
-				Scalar deviceRayStart=inputDeviceDataFile->read<Scalar>();
+				frameSource->read(deviceRayDir.getComponents(),3);
+				Scalar deviceRayStart=frameSource->read<Scalar>();
 				inputDevices[device]->setDeviceRay(deviceRayDir,deviceRayStart);
 				}
 			TrackerState::Vector translation;
-			inputDeviceDataFile->read(translation.getComponents(),3);
+			frameSource->read(translation.getComponents(),3);
 			Scalar quat[4];
-			inputDeviceDataFile->read(quat,4);
+			frameSource->read(quat,4);
 			inputDevices[device]->setTransformation(TrackerState(translation,TrackerState::Rotation(quat)));
 			if(fileVersion>=3)
 				{
 				Vector linearVelocity,angularVelocity;
-				inputDeviceDataFile->read(linearVelocity.getComponents(),3);
-				inputDeviceDataFile->read(angularVelocity.getComponents(),3);
+				frameSource->read(linearVelocity.getComponents(),3);
+				frameSource->read(angularVelocity.getComponents(),3);
 				inputDevices[device]->setLinearVelocity(linearVelocity);
 				inputDevices[device]->setAngularVelocity(angularVelocity);
 				}
@@ -429,7 +474,7 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 				{
 				if(numBits==0)
 					{
-					buttonBits=inputDeviceDataFile->read<unsigned char>();
+					buttonBits=frameSource->read<unsigned char>();
 					numBits=8;
 					}
 				inputDevices[device]->setButtonState(i,(buttonBits&0x80U)!=0x00U);
@@ -441,7 +486,7 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 			{
 			for(int i=0;i<inputDevices[device]->getNumButtons();++i)
 				{
-				int buttonState=inputDeviceDataFile->read<int>();
+				int buttonState=frameSource->read<int>();
 				inputDevices[device]->setButtonState(i,buttonState);
 				}
 			}
@@ -449,7 +494,7 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 		/* Update valuator states: */
 		for(int i=0;i<inputDevices[device]->getNumValuators();++i)
 			{
-			double valuatorState=inputDeviceDataFile->read<double>();
+			double valuatorState=frameSource->read<double>();
 			inputDevices[device]->setValuator(i,valuatorState);
 			}
 		}
@@ -457,19 +502,17 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 	if(fileVersion>=4)
 		{
 		/* Read and enqueue all text and text control events: */
-		inputDeviceManager->getTextEventDispatcher()->readEventQueues(*inputDeviceDataFile);
+		inputDeviceManager->getTextEventDispatcher()->readEventQueues(*frameSource);
 		}
 	
 	/* Read time stamp of next data frame: */
-	try
+	if(readNextTimeStamp())
 		{
-		nextTimeStamp=inputDeviceDataFile->read<double>();
-		
 		/* Request a synchronized update for the next frame: */
 		synchronize(nextTimeStamp,false);
 		requestUpdate();
 		}
-	catch(IO::File::ReadError)
+	else
 		{
 		done=true;
 		nextTimeStamp=Math::Constants<double>::max;
@@ -541,6 +584,38 @@ void InputDeviceAdapterPlayback::updateInputDevices(void)
 		}
 	}
 
+bool InputDeviceAdapterPlayback::seekToTime(double time)
+	{
+	/* Bail out if the input file does not have a chunk index: */
+	if(chunkReader==0)
+		return false;
+	
+	/* Position the chunk reader and read the time stamp of the new next data frame: */
+	chunkReader->seekToTime(time);
+	if(readNextTimeStamp())
+		{
+		done=false;
+		
+		if(synchronizePlayback&&firstFrameCountdown==0U)
+			{
+			/* Re-calculate the offset between the saved timestamps and the system's wall clock time: */
+			Misc::Time rt=Misc::Time::now();
+			double realTime=double(rt.tv_sec)+double(rt.tv_nsec)/1000000000.0;
+			timeStampOffset=nextTimeStamp-realTime*playbackSpeed;
+			}
+		
+		/* Request an update for the next frame: */
+		requestUpdate();
+		}
+	else
+		{
+		done=true;
+		nextTimeStamp=Math::Constants<double>::max;
+		}
+	
+	return true;
+	}
+
 #ifdef VRUI_INPUTDEVICEADAPTERPLAYBACK_USE_KINECT
 
 void InputDeviceAdapterPlayback::glRenderAction(GLContextData& contextData) const
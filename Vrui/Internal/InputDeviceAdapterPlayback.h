@@ -41,6 +41,7 @@ namespace Sound {
 class SoundPlayer;
 }
 namespace Vrui {
+class InputDeviceDataChunkReader;
 class MouseCursorFaker;
 class VRWindow;
 #ifdef VRUI_INPUTDEVICEADAPTERPLAYBACK_USE_KINECT
@@ -56,10 +57,13 @@ class InputDeviceAdapterPlayback:public InputDeviceAdapter
 	private:
 	IO::SeekableFilePtr inputDeviceDataFile; // File containing the input device data
 	unsigned int fileVersion; // Version of the input device data file
+	InputDeviceDataChunkReader* chunkReader; // Reader for compressed and indexed frame chunks in version 5 files
+	IO::File* frameSource; // File from which to read the next frame's data
 	int* deviceFeatureBaseIndices; // Array of base indices in feature name array for each input device
 	std::vector<std::string> deviceFeatureNames; // Array of input device feature names
 	MouseCursorFaker* mouseCursorFaker; // Pointer to object used to render a fake mouse cursor
 	bool synchronizePlayback; // Flag whether to force the Vrui mainloop to run at the speed of the recording; by default, mainloop runs as fast as it can
+	double playbackSpeed; // Ratio of recording time to wall clock time during synchronized playback
 	bool quitWhenDone; // Flag whether to quit the Vrui application when all saved data has been played back
 	Sound::SoundPlayer* soundPlayer; // Pointer to a sound player object used to play back synchronized commentary tracks
 	#ifdef VRUI_INPUTDEVICEADAPTERPLAYBACK_USE_KINECT
@@ -80,6 +84,9 @@ class InputDeviceAdapterPlayback:public InputDeviceAdapter
 	int nextMovieFrameCounter; // Frame index for the next movie frame
 	bool done; // Flag if input file is at end
 	
+	/* Private methods: */
+	bool readNextTimeStamp(void); // Reads the time stamp of the next data frame; returns false if input file is at end
+	
 	/* Constructors and destructors: */
 	public:
 	InputDeviceAdapterPlayback(InputDeviceManager* sInputDeviceManager,const Misc::ConfigurationFileSection& configFileSection); // Creates adapter by opening and reading pre-recorded device data file
@@ -106,6 +113,7 @@ class InputDeviceAdapterPlayback:public InputDeviceAdapter
 		{
 		return nextTimeStamp;
 		}
+	bool seekToTime(double time); // Continues playback from the last data frame at or before the given time; returns false if the input file does not support seeking
 	};
 
 }
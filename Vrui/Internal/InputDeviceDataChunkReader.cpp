@@ -0,0 +1,217 @@
+/***********************************************************************
+InputDeviceDataChunkReader - Class to read the frames of a chunked and
+indexed input device data file, with fast seeking to arbitrary time
+stamps.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Vrui/Internal/InputDeviceDataChunkReader.h>
+
+#include <string.h>
+#include <zlib.h>
+#include <algorithm>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/Endianness.h>
+
+namespace Vrui {
+
+/*******************************************
+Methods of class InputDeviceDataChunkReader:
+*******************************************/
+
+bool InputDeviceDataChunkReader::readIndex(IO::SeekableFile::Offset dataStart)
+	{
+	/* Check if the file is large enough to contain a trailer: */
+	IO::SeekableFile::Offset fileSize=file->getSize();
+	if(fileSize<dataStart+20)
+		return false;
+	
+	/* Read and check the trailer: */
+	file->setReadPosAbs(fileSize-20);
+	Misc::UInt64 indexOffset=file->read<Misc::UInt64>();
+	Misc::UInt32 numChunks=file->read<Misc::UInt32>();
+	char tag[8];
+	file->read<char>(tag,8);
+	if(memcmp(tag,"VRUIIDX\n",8)!=0||indexOffset<Misc::UInt64(dataStart)||indexOffset+4+Misc::UInt64(numChunks)*24+20!=Misc::UInt64(fileSize))
+		return false;
+	
+	/* Read and check the chunk index: */
+	file->setReadPosAbs(indexOffset);
+	file->read<char>(tag,4);
+	if(memcmp(tag,"INDX",4)!=0)
+		return false;
+	chunkIndex.reserve(numChunks);
+	for(Misc::UInt32 i=0;i<numChunks;++i)
+		{
+		ChunkIndexEntry cie;
+		cie.firstTimeStamp=file->read<Misc::Float64>();
+		cie.lastTimeStamp=file->read<Misc::Float64>();
+		cie.offset=file->read<Misc::UInt64>();
+		chunkIndex.push_back(cie);
+		}
+	
+	return true;
+	}
+
+void InputDeviceDataChunkReader::rebuildIndex(IO::SeekableFile::Offset dataStart)
+	{
+	/* Follow the chain of chunk headers until the end of the file, or an incomplete chunk: */
+	chunkIndex.clear();
+	IO::SeekableFile::Offset fileSize=file->getSize();
+	IO::SeekableFile::Offset chunkPos=dataStart;
+	while(chunkPos+32<=fileSize)
+		{
+		/* Read the chunk header: */
+		file->setReadPosAbs(chunkPos);
+		char tag[4];
+		file->read<char>(tag,4);
+		if(memcmp(tag,"CHNK",4)!=0)
+			break;
+		ChunkIndexEntry cie;
+		cie.firstTimeStamp=file->read<Misc::Float64>();
+		cie.lastTimeStamp=file->read<Misc::Float64>();
+		cie.offset=chunkPos;
+		file->skip<Misc::UInt32>(2);
+		Misc::UInt32 compressedSize=file->read<Misc::UInt32>();
+		if(chunkPos+32+IO::SeekableFile::Offset(compressedSize)>fileSize)
+			break;
+		
+		/* Enter the chunk into the index and go to the next chunk: */
+		chunkIndex.push_back(cie);
+		chunkPos+=32+IO::SeekableFile::Offset(compressedSize);
+		}
+	}
+
+void InputDeviceDataChunkReader::loadChunk(size_t chunk)
+	{
+	/* Read the chunk header: */
+	file->setReadPosAbs(chunkIndex[chunk].offset);
+	char tag[4];
+	file->read<char>(tag,4);
+	if(memcmp(tag,"CHNK",4)!=0)
+		Misc::throwStdErr("Vrui::InputDeviceDataChunkReader: Corrupted chunk %u in input device data file",(unsigned int)chunk);
+	file->skip<Misc::Float64>(2);
+	Misc::UInt32 numFrames=file->read<Misc::UInt32>();
+	Misc::UInt32 uncompressedSize=file->read<Misc::UInt32>();
+	Misc::UInt32 compressedSize=file->read<Misc::UInt32>();
+	
+	/* Read the compressed chunk data: */
+	if(compressedBuffer.size()<compressedSize)
+		compressedBuffer.resize(compressedSize);
+	file->readRaw(&compressedBuffer[0],compressedSize);
+	
+	/* Decompress the chunk data, re-using the previous chunk's buffer if it is large enough: */
+	if(chunkData==0||size_t(chunkData->getSize())<uncompressedSize)
+		{
+		chunkData=new IO::FixedMemoryFile(uncompressedSize);
+		chunkData->setEndianness(Misc::LittleEndian);
+		}
+	uLongf decompressedSize=uncompressedSize;
+	if(uncompress(static_cast<Bytef*>(chunkData->getMemory()),&decompressedSize,&compressedBuffer[0],compressedSize)!=Z_OK||decompressedSize!=uncompressedSize)
+		Misc::throwStdErr("Vrui::InputDeviceDataChunkReader: Corrupted chunk %u in input device data file",(unsigned int)chunk);
+	
+	/* Read the frame tables and convert frame offsets to absolute positions in the chunk data: */
+	chunkData->setReadPosAbs(0);
+	frameTimeStamps.resize(numFrames);
+	frameOffsets.resize(numFrames);
+	if(numFrames>0)
+		{
+		chunkData->read(&frameTimeStamps[0],numFrames);
+		chunkData->read(&frameOffsets[0],numFrames);
+		}
+	Misc::UInt32 frameDataStart=numFrames*(sizeof(Misc::Float64)+sizeof(Misc::UInt32));
+	for(std::vector<Misc::UInt32>::iterator foIt=frameOffsets.begin();foIt!=frameOffsets.end();++foIt)
+		*foIt+=frameDataStart;
+	
+	currentChunk=chunk;
+	nextFrame=0;
+	}
+
+InputDeviceDataChunkReader::InputDeviceDataChunkReader(IO::SeekableFilePtr sFile)
+	:file(sFile),
+	 currentChunk(0),nextFrame(0)
+	{
+	/* Read the chunk index, or reconstruct it if the file was not closed properly: */
+	IO::SeekableFile::Offset dataStart=file->getReadPos();
+	if(!readIndex(dataStart))
+		rebuildIndex(dataStart);
+	
+	/* Load the first chunk: */
+	currentChunk=chunkIndex.size();
+	if(!chunkIndex.empty())
+		loadChunk(0);
+	}
+
+double InputDeviceDataChunkReader::getFirstTimeStamp(void) const
+	{
+	return chunkIndex.empty()?0.0:chunkIndex.front().firstTimeStamp;
+	}
+
+double InputDeviceDataChunkReader::getLastTimeStamp(void) const
+	{
+	return chunkIndex.empty()?0.0:chunkIndex.back().lastTimeStamp;
+	}
+
+IO::File* InputDeviceDataChunkReader::readNextFrame(double& timeStamp)
+	{
+	/* Advance to the next non-empty chunk if the current chunk is exhausted: */
+	while(currentChunk<chunkIndex.size()&&nextFrame>=frameTimeStamps.size())
+		{
+		if(currentChunk+1<chunkIndex.size())
+			loadChunk(currentChunk+1);
+		else
+			currentChunk=chunkIndex.size();
+		}
+	if(currentChunk>=chunkIndex.size())
+		return 0;
+	
+	/* Position the chunk data at the beginning of the next frame: */
+	timeStamp=frameTimeStamps[nextFrame];
+	chunkData->setReadPosAbs(frameOffsets[nextFrame]);
+	++nextFrame;
+	
+	return chunkData.getPointer();
+	}
+
+void InputDeviceDataChunkReader::seekToTime(double time)
+	{
+	if(chunkIndex.empty())
+		return;
+	
+	/* Find the last chunk starting at or before the given time: */
+	size_t l=0;
+	size_t r=chunkIndex.size();
+	while(r-l>1)
+		{
+		size_t m=(l+r)>>1;
+		if(chunkIndex[m].firstTimeStamp<=time)
+			l=m;
+		else
+			r=m;
+		}
+	if(currentChunk!=l)
+		loadChunk(l);
+	
+	/* Find the last frame at or before the given time in the chunk: */
+	std::vector<Misc::Float64>::iterator ftsIt=std::upper_bound(frameTimeStamps.begin(),frameTimeStamps.end(),Misc::Float64(time));
+	nextFrame=ftsIt!=frameTimeStamps.begin()?size_t(ftsIt-frameTimeStamps.begin())-1:0;
+	}
+
+}
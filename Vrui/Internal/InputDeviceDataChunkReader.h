@@ -0,0 +1,80 @@
+/***********************************************************************
+InputDeviceDataChunkReader - Class to read the frames of a chunked and
+indexed input device data file, with fast seeking to arbitrary time
+stamps.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef VRUI_INTERNAL_INPUTDEVICEDATACHUNKREADER_INCLUDED
+#define VRUI_INTERNAL_INPUTDEVICEDATACHUNKREADER_INCLUDED
+
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <Misc/Autopointer.h>
+#include <IO/SeekableFile.h>
+#include <IO/FixedMemoryFile.h>
+
+namespace Vrui {
+
+class InputDeviceDataChunkReader
+	{
+	/* Embedded classes: */
+	private:
+	struct ChunkIndexEntry // Structure for chunk index entries
+		{
+		/* Elements: */
+		public:
+		Misc::Float64 firstTimeStamp,lastTimeStamp; // Time stamps of first and last frame in the chunk
+		Misc::UInt64 offset; // Absolute position of the chunk's header in the file
+		};
+	
+	/* Elements: */
+	IO::SeekableFilePtr file; // File from which chunks are read
+	std::vector<ChunkIndexEntry> chunkIndex; // Index of all chunks in the file
+	size_t currentChunk; // Index of the currently loaded chunk; equal to number of chunks if no chunk is loaded
+	std::vector<unsigned char> compressedBuffer; // Buffer to read compressed chunk data
+	Misc::Autopointer<IO::FixedMemoryFile> chunkData; // Uncompressed data of the currently loaded chunk
+	std::vector<Misc::Float64> frameTimeStamps; // Time stamps of all frames in the current chunk
+	std::vector<Misc::UInt32> frameOffsets; // Offsets of all frames in the current chunk's uncompressed data
+	size_t nextFrame; // Index of the next frame to be read from the current chunk
+	
+	/* Private methods: */
+	bool readIndex(IO::SeekableFile::Offset dataStart); // Reads the chunk index from the end of the file; returns false if there is no valid index
+	void rebuildIndex(IO::SeekableFile::Offset dataStart); // Reconstructs the chunk index by following the chunk headers
+	void loadChunk(size_t chunk); // Reads and decompresses the chunk of the given index
+	
+	/* Constructors and destructors: */
+	public:
+	InputDeviceDataChunkReader(IO::SeekableFilePtr sFile); // Reads chunks starting at the current read position of the given file
+	
+	/* Methods: */
+	size_t getNumChunks(void) const // Returns the number of chunks in the file
+		{
+		return chunkIndex.size();
+		}
+	double getFirstTimeStamp(void) const; // Returns the time stamp of the first frame in the file
+	double getLastTimeStamp(void) const; // Returns the time stamp of the last frame in the file
+	IO::File* readNextFrame(double& timeStamp); // Returns the next frame's time stamp and a file positioned at the frame's data, or null at the end of the file
+	void seekToTime(double time); // Positions the reader such that the next frame will be the last frame at or before the given time, or the first frame in the file
+	};
+
+}
+
+#endif
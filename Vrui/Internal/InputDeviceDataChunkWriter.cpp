@@ -0,0 +1,210 @@
+/***********************************************************************
+InputDeviceDataChunkWriter - Class to write the frames of an input
+device data file as a sequence of independently compressed chunks,
+followed by a chunk index for fast seeking during playback.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Vrui/Internal/InputDeviceDataChunkWriter.h>
+
+#include <zlib.h>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/Endianness.h>
+
+namespace Vrui {
+
+namespace {
+
+/**************
+Helper classes:
+**************/
+
+class DeflateSink // Helper class to compress data written from a buffer chain into a single memory block
+	{
+	/* Elements: */
+	private:
+	z_stream stream; // zlib compression object
+	
+	/* Constructors and destructors: */
+	public:
+	DeflateSink(int compressionLevel,Bytef* output,size_t outputSize)
+		{
+		stream.zalloc=0;
+		stream.zfree=0;
+		stream.opaque=0;
+		if(deflateInit(&stream,compressionLevel)!=Z_OK)
+			Misc::throwStdErr("Vrui::InputDeviceDataChunkWriter: Unable to initialize compressor");
+		stream.next_out=output;
+		stream.avail_out=uInt(outputSize);
+		}
+	~DeflateSink(void)
+		{
+		deflateEnd(&stream);
+		}
+	
+	/* Methods: */
+	void writeRaw(const void* data,size_t dataSize) // Compresses the given data block
+		{
+		stream.next_in=static_cast<Bytef*>(const_cast<void*>(data));
+		stream.avail_in=uInt(dataSize);
+		while(stream.avail_in>0)
+			if(deflate(&stream,Z_NO_FLUSH)!=Z_OK)
+				Misc::throwStdErr("Vrui::InputDeviceDataChunkWriter: Error while compressing chunk data");
+		}
+	size_t finish(void) // Finishes compression and returns the size of the compressed data
+		{
+		stream.next_in=0;
+		stream.avail_in=0;
+		if(deflate(&stream,Z_FINISH)!=Z_STREAM_END)
+			Misc::throwStdErr("Vrui::InputDeviceDataChunkWriter: Error while compressing chunk data");
+		return stream.total_out;
+		}
+	};
+
+}
+
+/*******************************************
+Methods of class InputDeviceDataChunkWriter:
+*******************************************/
+
+InputDeviceDataChunkWriter::InputDeviceDataChunkWriter(IO::SeekableFilePtr sFile,size_t sMaxChunkSize,int sCompressionLevel)
+	:file(sFile),
+	 maxChunkSize(sMaxChunkSize),compressionLevel(sCompressionLevel),
+	 closed(false)
+	{
+	/* Chunk data is always written in little-endian byte order: */
+	frameData.setEndianness(Misc::LittleEndian);
+	}
+
+InputDeviceDataChunkWriter::~InputDeviceDataChunkWriter(void)
+	{
+	if(!closed)
+		{
+		try
+			{
+			close();
+			}
+		catch(std::runtime_error err)
+			{
+			/* Print a message, but carry on: */
+			std::cerr<<"Vrui::InputDeviceDataChunkWriter: Unable to close input device data file due to exception "<<err.what()<<std::endl;
+			}
+		}
+	}
+
+IO::File& InputDeviceDataChunkWriter::startFrame(double timeStamp)
+	{
+	/* Start a new frame at the end of the current frame data: */
+	frameTimeStamps.push_back(Misc::Float64(timeStamp));
+	frameOffsets.push_back(Misc::UInt32(frameData.getDataSize()));
+	
+	return frameData;
+	}
+
+void InputDeviceDataChunkWriter::finishFrame(void)
+	{
+	/* Write the current chunk if it is full: */
+	if(frameData.getDataSize()>=maxChunkSize)
+		writeChunk();
+	}
+
+void InputDeviceDataChunkWriter::writeChunk(void)
+	{
+	/* Bail out if the current chunk is empty: */
+	Misc::UInt32 numFrames=Misc::UInt32(frameTimeStamps.size());
+	if(numFrames==0)
+		return;
+	
+	/* Write the frame tables into a separate buffer: */
+	IO::VariableMemoryFile frameTables;
+	frameTables.setEndianness(Misc::LittleEndian);
+	frameTables.write(&frameTimeStamps[0],numFrames);
+	frameTables.write(&frameOffsets[0],numFrames);
+	
+	/* Compress the frame tables and frame data into a single block: */
+	size_t uncompressedSize=frameTables.getDataSize()+frameData.getDataSize();
+	uLong compressedBufferSize=compressBound(uLong(uncompressedSize));
+	Bytef* compressedBuffer=new Bytef[compressedBufferSize];
+	size_t compressedSize;
+	try
+		{
+		DeflateSink sink(compressionLevel,compressedBuffer,compressedBufferSize);
+		frameTables.writeToSink(sink);
+		frameData.writeToSink(sink);
+		compressedSize=sink.finish();
+		}
+	catch(...)
+		{
+		delete[] compressedBuffer;
+		throw;
+		}
+	
+	/* Enter the chunk into the index: */
+	ChunkIndexEntry cie;
+	cie.firstTimeStamp=frameTimeStamps.front();
+	cie.lastTimeStamp=frameTimeStamps.back();
+	cie.offset=Misc::UInt64(file->getWritePos());
+	chunkIndex.push_back(cie);
+	
+	/* Write the chunk header and compressed chunk data: */
+	file->write<char>("CHNK",4);
+	file->write<Misc::Float64>(cie.firstTimeStamp);
+	file->write<Misc::Float64>(cie.lastTimeStamp);
+	file->write<Misc::UInt32>(numFrames);
+	file->write<Misc::UInt32>(Misc::UInt32(uncompressedSize));
+	file->write<Misc::UInt32>(Misc::UInt32(compressedSize));
+	file->writeRaw(compressedBuffer,compressedSize);
+	delete[] compressedBuffer;
+	
+	/* Start a new chunk: */
+	frameTimeStamps.clear();
+	frameOffsets.clear();
+	frameData.clear();
+	}
+
+void InputDeviceDataChunkWriter::close(void)
+	{
+	if(closed)
+		return;
+	closed=true;
+	
+	/* Write the last chunk: */
+	writeChunk();
+	
+	/* Write the chunk index: */
+	Misc::UInt64 indexOffset=Misc::UInt64(file->getWritePos());
+	file->write<char>("INDX",4);
+	for(std::vector<ChunkIndexEntry>::iterator ciIt=chunkIndex.begin();ciIt!=chunkIndex.end();++ciIt)
+		{
+		file->write<Misc::Float64>(ciIt->firstTimeStamp);
+		file->write<Misc::Float64>(ciIt->lastTimeStamp);
+		file->write<Misc::UInt64>(ciIt->offset);
+		}
+	
+	/* Write the trailer: */
+	file->write<Misc::UInt64>(indexOffset);
+	file->write<Misc::UInt32>(Misc::UInt32(chunkIndex.size()));
+	file->write<char>("VRUIIDX\n",8);
+	file->flush();
+	}
+
+}
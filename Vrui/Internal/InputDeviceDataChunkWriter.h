@@ -0,0 +1,93 @@
+/***********************************************************************
+InputDeviceDataChunkWriter - Class to write the frames of an input
+device data file as a sequence of independently compressed chunks,
+followed by a chunk index for fast seeking during playback.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+/***********************************************************************
+Layout of the frame section of a version 5 input device data file, all
+in little-endian byte order:
+- A sequence of chunks, each consisting of:
+  - Tag "CHNK"
+  - Float64 time stamps of the first and last frame in the chunk
+  - UInt32 number of frames, uncompressed size, and compressed size
+  - zlib-compressed chunk data, which contains a table of all frames'
+    Float64 time stamps, followed by a table of all frames' UInt32
+    offsets relative to the end of the tables, followed by all frames'
+    device states and text events in version 4 layout
+- A chunk index, consisting of:
+  - Tag "INDX"
+  - For each chunk, the Float64 time stamps of its first and last frame
+    and its UInt64 absolute position in the file
+- A trailer, consisting of the UInt64 absolute position of the chunk
+  index, the UInt32 number of chunks, and the tag "VRUIIDX\n"
+If the index or trailer are missing, e.g., after the recording
+application crashed, the chunk index can be reconstructed by following
+the chunk headers.
+***********************************************************************/
+
+#ifndef VRUI_INTERNAL_INPUTDEVICEDATACHUNKWRITER_INCLUDED
+#define VRUI_INTERNAL_INPUTDEVICEDATACHUNKWRITER_INCLUDED
+
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <IO/SeekableFile.h>
+#include <IO/VariableMemoryFile.h>
+
+namespace Vrui {
+
+class InputDeviceDataChunkWriter
+	{
+	/* Embedded classes: */
+	private:
+	struct ChunkIndexEntry // Structure for chunk index entries
+		{
+		/* Elements: */
+		public:
+		Misc::Float64 firstTimeStamp,lastTimeStamp; // Time stamps of first and last frame in the chunk
+		Misc::UInt64 offset; // Absolute position of the chunk's header in the file
+		};
+	
+	/* Elements: */
+	IO::SeekableFilePtr file; // File to which chunks are written
+	size_t maxChunkSize; // Uncompressed frame data size at which a chunk is written to the file
+	int compressionLevel; // zlib compression level for chunk data
+	std::vector<Misc::Float64> frameTimeStamps; // Time stamps of all frames in the current chunk
+	std::vector<Misc::UInt32> frameOffsets; // Offsets of all frames in the current chunk's frame data
+	IO::VariableMemoryFile frameData; // Buffer accumulating the current chunk's frame data
+	std::vector<ChunkIndexEntry> chunkIndex; // Index of all chunks written so far
+	bool closed; // Flag whether the chunk index has been written
+	
+	/* Constructors and destructors: */
+	public:
+	InputDeviceDataChunkWriter(IO::SeekableFilePtr sFile,size_t sMaxChunkSize,int sCompressionLevel); // Writes chunks to the current write position of the given file
+	~InputDeviceDataChunkWriter(void); // Closes the writer if it has not been closed already
+	
+	/* Methods: */
+	IO::File& startFrame(double timeStamp); // Starts a new frame with the given time stamp; returns a file to which to write the frame's data
+	void finishFrame(void); // Finishes the current frame; writes the current chunk if it reached its maximum size
+	void writeChunk(void); // Compresses and writes the current chunk to the file
+	void close(void); // Writes the last chunk, the chunk index, and the trailer; no frames can be written afterwards
+	};
+
+}
+
+#endif
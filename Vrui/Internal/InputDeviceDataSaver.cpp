@@ -41,6 +41,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/InputDeviceFeature.h>
 #include <Vrui/InputDeviceManager.h>
 #include <Vrui/TextEventDispatcher.h>
+#include <Vrui/Internal/InputDeviceDataChunkWriter.h>
 #ifdef VRUI_INPUTDEVICEDATASAVER_USE_KINECT
 #include <Vrui/Internal/KinectRecorder.h>
 #endif
@@ -52,7 +53,8 @@ Methods of class InputDeviceDataSaver:
 *************************************/
 
 InputDeviceDataSaver::InputDeviceDataSaver(const Misc::ConfigurationFileSection& configFileSection,InputDeviceManager& inputDeviceManager,TextEventDispatcher* sTextEventDispatcher,unsigned int randomSeed)
-	:inputDeviceDataFile(IO::openFile(Misc::createNumberedFileName(configFileSection.retrieveString("./inputDeviceDataFileName"),4).c_str(),IO::File::WriteOnly)),
+	:inputDeviceDataFile(IO::openSeekableFile(Misc::createNumberedFileName(configFileSection.retrieveString("./inputDeviceDataFileName"),4).c_str(),IO::File::WriteOnly)),
+	 chunkWriter(0),
 	 numInputDevices(inputDeviceManager.getNumInputDevices()),
 	 inputDevices(new InputDevice*[numInputDevices]),
 	 textEventDispatcher(sTextEventDispatcher),
@@ -64,7 +66,7 @@ InputDeviceDataSaver::InputDeviceDataSaver(const Misc::ConfigurationFileSection&
 	{
 	/* Write a file identification header: */
 	inputDeviceDataFile->setEndianness(Misc::LittleEndian);
-	static const char* fileHeader="Vrui Input Device Data File v4.0\n";
+	static const char* fileHeader="Vrui Input Device Data File v5.0\n";
 	inputDeviceDataFile->write<char>(fileHeader,34);
 	
 	/* Save the random number seed: */
@@ -93,6 +95,11 @@ InputDeviceDataSaver::InputDeviceDataSaver(const Misc::ConfigurationFileSection&
 			}
 		}
 	
+	/* Create a writer to save input device data frames in compressed chunks: */
+	unsigned int chunkSize=configFileSection.retrieveValue<unsigned int>("./chunkSize",256U*1024U);
+	int compressionLevel=configFileSection.retrieveValue<int>("./compressionLevel",6);
+	chunkWriter=new InputDeviceDataChunkWriter(inputDeviceDataFile,chunkSize,compressionLevel);
+	
 	/* Check if the user wants to record a commentary track: */
 	std::string soundFileName=configFileSection.retrieveString("./soundFileName","");
 	if(!soundFileName.empty())
@@ -130,6 +137,9 @@ InputDeviceDataSaver::InputDeviceDataSaver(const Misc::ConfigurationFileSection&
 
 InputDeviceDataSaver::~InputDeviceDataSaver(void)
 	{
+	/* Write the last chunk and the chunk index: */
+	delete chunkWriter;
+	
 	delete[] inputDevices;
 	delete soundRecorder;
 	#ifdef VRUI_INPUTDEVICEDATASAVER_USE_KINECT
@@ -154,8 +164,8 @@ void InputDeviceDataSaver::saveCurrentState(double currentTimeStamp)
 			}
 		}
 	
-	/* Write current time stamp: */
-	inputDeviceDataFile->write(currentTimeStamp);
+	/* Start a new frame with the current time stamp: */
+	IO::File& frame=chunkWriter->startFrame(currentTimeStamp);
 	
 	/* Write state of all input devices: */
 	for(int i=0;i<numInputDevices;++i)
@@ -163,13 +173,13 @@ void InputDeviceDataSaver::saveCurrentState(double currentTimeStamp)
 		/* Write input device's tracker state: */
 		if(inputDevices[i]->getTrackType()!=InputDevice::TRACK_NONE)
 			{
-			inputDeviceDataFile->write(inputDevices[i]->getDeviceRayDirection().getComponents(),3);
-			inputDeviceDataFile->write(inputDevices[i]->getDeviceRayStart());
+			frame.write(inputDevices[i]->getDeviceRayDirection().getComponents(),3);
+			frame.write(inputDevices[i]->getDeviceRayStart());
 			const TrackerState& t=inputDevices[i]->getTransformation();
-			inputDeviceDataFile->write(t.getTranslation().getComponents(),3);
-			inputDeviceDataFile->write(t.getRotation().getQuaternion(),4);
-			inputDeviceDataFile->write(inputDevices[i]->getLinearVelocity().getComponents(),3);
-			inputDeviceDataFile->write(inputDevices[i]->getAngularVelocity().getComponents(),3);
+			frame.write(t.getTranslation().getComponents(),3);
+			frame.write(t.getRotation().getQuaternion(),4);
+			frame.write(inputDevices[i]->getLinearVelocity().getComponents(),3);
+			frame.write(inputDevices[i]->getAngularVelocity().getComponents(),3);
 			}
 		
 		/* Write input device's button states: */
@@ -182,7 +192,7 @@ void InputDeviceDataSaver::saveCurrentState(double currentTimeStamp)
 				buttonBits|=0x01U;
 			if(++numBits==8)
 				{
-				inputDeviceDataFile->write(buttonBits);
+				frame.write(buttonBits);
 				buttonBits=0x00U;
 				numBits=0;
 				}
@@ -190,19 +200,22 @@ void InputDeviceDataSaver::saveCurrentState(double currentTimeStamp)
 		if(numBits!=0)
 			{
 			buttonBits<<=8-numBits;
-			inputDeviceDataFile->write(buttonBits);
+			frame.write(buttonBits);
 			}
 		
 		/* Write input device's valuator states: */
 		for(int j=0;j<inputDevices[i]->getNumValuators();++j)
 			{
 			double valuatorState=inputDevices[i]->getValuator(j);
-			inputDeviceDataFile->write(valuatorState);
+			frame.write(valuatorState);
 			}
 		}
 	
 	/* Write all enqueued text and text control events: */
-	textEventDispatcher->writeEventQueues(*inputDeviceDataFile);
+	textEventDispatcher->writeEventQueues(frame);
+	
+	/* Finish the frame: */
+	chunkWriter->finishFrame();
 	}
 
 }
@@ -25,7 +25,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #define VRUI_INTERNAL_INPUTDEVICEDATASAVER_INCLUDED
 
 #include <string>
-#include <IO/File.h>
+#include <IO/SeekableFile.h>
 
 /* Forward declarations: */
 namespace Misc {
@@ -37,6 +37,7 @@ class SoundRecorder;
 namespace Vrui {
 class InputDevice;
 class InputDeviceManager;
+class InputDeviceDataChunkWriter;
 class TextEventDispatcher;
 #ifdef VRUI_INPUTDEVICEDATASAVER_USE_KINECT
 class KinectRecorder;
@@ -49,7 +50,8 @@ class InputDeviceDataSaver
 	{
 	/* Elements: */
 	private:
-	IO::FilePtr inputDeviceDataFile; // File input device data is saved to
+	IO::SeekableFilePtr inputDeviceDataFile; // File input device data is saved to
+	InputDeviceDataChunkWriter* chunkWriter; // Writer to save input device data frames as compressed and indexed chunks
 	int numInputDevices; // Number of saved (physical) input devices
 	InputDevice** inputDevices; // Array of pointers to saved input devices
 	TextEventDispatcher* textEventDispatcher; // Pointer to the dispatcher for GLMotif text and text control events
@@ -23,16 +23,24 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Vrui/Internal/VRDeviceClient.h>
 
+#include <Misc/SizedTypes.h>
 #include <Misc/Time.h>
 #include <Misc/StandardValueCoders.h>
 #include <Misc/ConfigurationFile.h>
 #include <Realtime/Time.h>
 #include <Vrui/Internal/VRDeviceDescriptor.h>
+#include <Vrui/Internal/VRDeviceStatistics.h>
 
 namespace Vrui {
 
 namespace {
 
+/**************
+Helper objects:
+**************/
+
+const VRDeviceState::TimeStamp clockResyncInterval=10000000U; // Interval between clock offset updates in streaming mode in microseconds
+
 /****************
 Helper functions:
 ****************/
@@ -40,10 +48,7 @@ Helper functions:
 void setTrackerStateTimeStamps(VRDeviceState& state) // Sets tracker state time stamps to current monotonic time
 	{
 	/* Get the current monotonic time: */
-	Realtime::TimePointMonotonic now;
-	
-	/* Get the lower-order bits of the microsecond time: */
-	VRDeviceState::TimeStamp ts=VRDeviceState::TimeStamp(now.tv_sec*1000000+(now.tv_nsec+500)/1000);
+	VRDeviceState::TimeStamp ts=VRDeviceState::getCurrentTimeStamp();
 	
 	/* Set all tracker state time stamps to the curren time: */
 	for(int i=0;i<state.getNumTrackers();++i)
@@ -56,6 +61,61 @@ void setTrackerStateTimeStamps(VRDeviceState& state) // Sets tracker state time
 Methods of class VRDeviceClient:
 *******************************/
 
+void VRDeviceClient::readServerState(void)
+	{
+	/* Read server's state: */
+	state.read(pipe,serverHasTimeStamps);
+	if(serverHasTimeStamps)
+		{
+		/* Convert the server's time stamps to client time: */
+		if(serverTimeOffset!=0U)
+			{
+			VRDeviceState::TimeStamp* tsPtr=state.getTrackerTimeStamps();
+			for(int i=0;i<state.getNumTrackers();++i)
+				tsPtr[i]-=serverTimeOffset;
+			}
+		}
+	else
+		setTrackerStateTimeStamps(state);
+	
+	/* Read the packet's send time and convert it to client time: */
+	packetReceiveTime=VRDeviceState::getCurrentTimeStamp();
+	if(serverHasStatistics)
+		packetSendTime=pipe.read<VRDeviceState::TimeStamp>()-serverTimeOffset;
+	else
+		packetSendTime=packetReceiveTime;
+	}
+
+void VRDeviceClient::requestClockResync(void)
+	{
+	/* Bail out if the server does not support clock synchronization, or the last request is still pending or recent: */
+	if(!serverHasClockSync||clockSyncPending||VRDeviceState::getCurrentTimeStamp()-clockSyncTime<clockResyncInterval)
+		return;
+	
+	/* Don't send any more requests once streaming mode is being stopped, so that all replies arrive before the stop stream reply: */
+	Threads::Mutex::Lock pipeWriteLock(pipeWriteMutex);
+	if(streaming)
+		{
+		/* Send a time stamp request: */
+		clockSyncTime=VRDeviceState::getCurrentTimeStamp();
+		pipe.writeMessage(VRDevicePipe::TIMESTAMP_REQUEST);
+		pipe.flush();
+		clockSyncPending=true;
+		}
+	}
+
+void VRDeviceClient::readClockResync(void)
+	{
+	VRDeviceState::TimeStamp serverTime=pipe.read<VRDeviceState::TimeStamp>();
+	VRDeviceState::TimeStamp replyTime=VRDeviceState::getCurrentTimeStamp();
+	clockSyncPending=false;
+	
+	/* Only accept the new estimate if the reply was not delayed much behind queued state packets: */
+	VRDeviceState::TimeStamp roundTrip=replyTime-clockSyncTime;
+	if(roundTrip<=clockSyncRoundTrip*2U+500U)
+		serverTimeOffset=serverTime-(clockSyncTime+roundTrip/2);
+	}
+
 void* VRDeviceClient::streamReceiveThreadMethod(void)
 	{
 	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
@@ -71,9 +131,7 @@ void* VRDeviceClient::streamReceiveThreadMethod(void)
 				/* Read server's state: */
 				{
 				Threads::Mutex::Lock stateLock(stateMutex);
-				state.read(pipe,serverHasTimeStamps);
-				if(!serverHasTimeStamps)
-					setTrackerStateTimeStamps(state);
+				readServerState();
 				}
 				
 				/* Signal packet reception: */
@@ -82,6 +140,14 @@ void* VRDeviceClient::streamReceiveThreadMethod(void)
 				/* Invoke packet notification callback: */
 				if(packetNotificationCallback!=0)
 					(*packetNotificationCallback)(this);
+				
+				/* Periodically update the clock offset estimate to compensate for clock drift: */
+				requestClockResync();
+				}
+			else if(message==VRDevicePipe::TIMESTAMP_REPLY)
+				{
+				/* Update the clock offset estimate: */
+				readClockResync();
 				}
 			else if(message==VRDevicePipe::STOPSTREAM_REPLY)
 				break;
@@ -152,11 +218,25 @@ void VRDeviceClient::initClient(void)
 	
 	/* Check if the server will send tracker state time stamps: */
 	serverHasTimeStamps=serverProtocolVersionNumber>=3U;
+	
+	/* Check if the server supports clock synchronization and motion prediction: */
+	serverHasClockSync=serverProtocolVersionNumber>=4U;
+	if(serverHasClockSync)
+		{
+		/* Estimate the initial offset between the client's and server's clocks: */
+		synchronizeClocks();
+		}
+	
+	/* Check if the server sends packet send times and supports statistics requests: */
+	serverHasStatistics=serverProtocolVersionNumber>=5U;
 	}
 
 VRDeviceClient::VRDeviceClient(const char* deviceServerName,int deviceServerPort)
 	:pipe(deviceServerName,deviceServerPort),
 	 serverProtocolVersionNumber(0),serverHasTimeStamps(false),
+	 serverHasClockSync(false),serverHasStatistics(false),serverTimeOffset(0U),
+	 clockSyncRoundTrip(0U),clockSyncTime(0U),clockSyncPending(false),
+	 packetSendTime(0U),packetReceiveTime(0U),
 	 active(false),streaming(false),connectionDead(false),
 	 packetNotificationCallback(0),errorCallback(0)
 	{
@@ -166,6 +246,9 @@ VRDeviceClient::VRDeviceClient(const char* deviceServerName,int deviceServerPort
 VRDeviceClient::VRDeviceClient(const Misc::ConfigurationFileSection& configFileSection)
 	:pipe(configFileSection.retrieveString("./serverName").c_str(),configFileSection.retrieveValue<int>("./serverPort")),
 	 serverProtocolVersionNumber(0),serverHasTimeStamps(false),
+	 serverHasClockSync(false),serverHasStatistics(false),serverTimeOffset(0U),
+	 clockSyncRoundTrip(0U),clockSyncTime(0U),clockSyncPending(false),
+	 packetSendTime(0U),packetReceiveTime(0U),
 	 active(false),streaming(false),connectionDead(false),
 	 packetNotificationCallback(0),errorCallback(0)
 	{
@@ -191,6 +274,85 @@ VRDeviceClient::~VRDeviceClient(void)
 		delete *vdIt;
 	}
 
+void VRDeviceClient::synchronizeClocks(int numRounds)
+	{
+	if(!serverHasClockSync||streaming||connectionDead)
+		return;
+	
+	/* Run a number of time stamp request/reply round trips and keep the estimate from the shortest one: */
+	VRDeviceState::TimeStamp minRoundTrip=~VRDeviceState::TimeStamp(0);
+	for(int round=0;round<numRounds;++round)
+		{
+		/* Send a time stamp request: */
+		VRDeviceState::TimeStamp requestTime=VRDeviceState::getCurrentTimeStamp();
+		pipe.writeMessage(VRDevicePipe::TIMESTAMP_REQUEST);
+		pipe.flush();
+		
+		/* Wait for the server's reply: */
+		if(!pipe.waitForData(Misc::Time(10,0)))
+			{
+			connectionDead=true;
+			throw ProtocolError("VRDeviceClient: Timeout while waiting for TIMESTAMP_REPLY",this);
+			}
+		if(pipe.readMessage()!=VRDevicePipe::TIMESTAMP_REPLY)
+			{
+			connectionDead=true;
+			throw ProtocolError("VRDeviceClient: Mismatching message while waiting for TIMESTAMP_REPLY",this);
+			}
+		VRDeviceState::TimeStamp serverTime=pipe.read<VRDeviceState::TimeStamp>();
+		VRDeviceState::TimeStamp replyTime=VRDeviceState::getCurrentTimeStamp();
+		
+		/* Assume that the server sampled its clock half-way through the round trip: */
+		VRDeviceState::TimeStamp roundTrip=replyTime-requestTime;
+		if(minRoundTrip>roundTrip)
+			{
+			minRoundTrip=roundTrip;
+			serverTimeOffset=serverTime-(requestTime+roundTrip/2);
+			}
+		}
+	
+	/* Remember the best round trip time to judge later updates in streaming mode: */
+	clockSyncRoundTrip=minRoundTrip;
+	clockSyncTime=VRDeviceState::getCurrentTimeStamp();
+	}
+
+bool VRDeviceClient::getStatistics(VRDeviceStatistics& statistics,bool reset)
+	{
+	if(!serverHasStatistics||streaming||connectionDead)
+		return false;
+	
+	/* Send a statistics request: */
+	pipe.writeMessage(VRDevicePipe::STATISTICS_REQUEST);
+	pipe.write<Misc::UInt8>(reset?1:0);
+	pipe.flush();
+	
+	/* Wait for the server's reply: */
+	if(!pipe.waitForData(Misc::Time(10,0)))
+		{
+		connectionDead=true;
+		throw ProtocolError("VRDeviceClient: Timeout while waiting for STATISTICS_REPLY",this);
+		}
+	if(pipe.readMessage()!=VRDevicePipe::STATISTICS_REPLY)
+		{
+		connectionDead=true;
+		throw ProtocolError("VRDeviceClient: Mismatching message while waiting for STATISTICS_REPLY",this);
+		}
+	
+	/* Read the statistics: */
+	try
+		{
+		statistics.read(pipe);
+		}
+	catch(std::runtime_error err)
+		{
+		/* Mark the connection as dead and re-throw the original exception: */
+		connectionDead=true;
+		throw;
+		}
+	
+	return true;
+	}
+
 void VRDeviceClient::activate(void)
 	{
 	if(!active&&!connectionDead)
@@ -250,9 +412,7 @@ void VRDeviceClient::getPacket(void)
 			try
 				{
 				Threads::Mutex::Lock stateLock(stateMutex);
-				state.read(pipe,serverHasTimeStamps);
-				if(!serverHasTimeStamps)
-					setTrackerStateTimeStamps(state);
+				readServerState();
 				}
 			catch(std::runtime_error err)
 				{
@@ -264,6 +424,49 @@ void VRDeviceClient::getPacket(void)
 		}
 	}
 
+void VRDeviceClient::getPredictedPacket(VRDeviceState::TimeStamp predictionTime)
+	{
+	/* Fall back to a regular state packet if the server can't predict or the client is streaming: */
+	if(!serverHasClockSync||streaming)
+		{
+		getPacket();
+		return;
+		}
+	
+	if(active)
+		{
+		/* Send predicted packet request message with the prediction time converted to server time: */
+		pipe.writeMessage(VRDevicePipe::PREDICTEDPACKET_REQUEST);
+		pipe.write<VRDeviceState::TimeStamp>(predictionTime+serverTimeOffset);
+		pipe.flush();
+		
+		/* Wait for packet reply message: */
+		if(!pipe.waitForData(Misc::Time(10,0))) // Throw exception if reply does not arrive in time
+			{
+			connectionDead=true;
+			throw ProtocolError("VRDeviceClient: Timout while waiting for PACKET_REPLY",this);
+			}
+		if(pipe.readMessage()!=VRDevicePipe::PACKET_REPLY)
+			{
+			connectionDead=true;
+			throw ProtocolError("VRDeviceClient: Mismatching message while waiting for PACKET_REPLY",this);
+			}
+		
+		/* Read server's predicted state: */
+		try
+			{
+			Threads::Mutex::Lock stateLock(stateMutex);
+			readServerState();
+			}
+		catch(std::runtime_error err)
+			{
+			/* Mark the connection as dead and re-throw the original exception: */
+			connectionDead=true;
+			throw;
+			}
+		}
+	}
+
 void VRDeviceClient::startStream(VRDeviceClient::Callback* newPacketNotificationCallback,VRDeviceClient::ErrorCallback* newErrorCallback)
 	{
 	if(active&&!streaming&&!connectionDead)
@@ -296,16 +499,21 @@ void VRDeviceClient::stopStream(void)
 	{
 	if(streaming)
 		{
+		{
+		Threads::Mutex::Lock pipeWriteLock(pipeWriteMutex);
 		streaming=false;
 		if(!connectionDead)
 			{
 			/* Send stop streaming message: */
 			pipe.writeMessage(VRDevicePipe::STOPSTREAM_REQUEST);
 			pipe.flush();
-			
-			/* Wait for packet receiving thread to die: */
-			streamReceiveThread.join();
 			}
+		}
+		
+		/* Wait for packet receiving thread to die: */
+		if(!connectionDead)
+			streamReceiveThread.join();
+		clockSyncPending=false;
 		
 		/* Delete the callback functions: */
 		delete packetNotificationCallback;
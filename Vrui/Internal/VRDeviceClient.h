@@ -40,6 +40,7 @@ class ConfigurationFileSection;
 }
 namespace Vrui {
 class VRDeviceDescriptor;
+class VRDeviceStatistics;
 }
 
 namespace Vrui {
@@ -70,9 +71,18 @@ class VRDeviceClient
 	VRDevicePipe pipe; // Pipe connected to device server
 	unsigned int serverProtocolVersionNumber; // Version number of server protocol
 	bool serverHasTimeStamps; // Flag whether the connected device server sends tracker state time stamps
+	bool serverHasClockSync; // Flag whether the connected device server supports clock synchronization and motion prediction requests
+	bool serverHasStatistics; // Flag whether the connected device server sends packet send times and supports statistics requests
+	VRDeviceState::TimeStamp serverTimeOffset; // Offset from the client's monotonic clock to the server's clock in microseconds
+	VRDeviceState::TimeStamp clockSyncRoundTrip; // Shortest round trip time observed during the last full clock synchronization in microseconds
+	VRDeviceState::TimeStamp clockSyncTime; // Client time at which the most recent time stamp request was sent
+	bool clockSyncPending; // Flag whether a time stamp request was sent in streaming mode and its reply has not arrived yet
+	Threads::Mutex pipeWriteMutex; // Mutex serializing writes to the pipe between the caller and the packet receiving thread in streaming mode
 	std::vector<VRDeviceDescriptor*> virtualDevices; // List of virtual input devices managed by the server
 	Threads::Mutex stateMutex; // Mutex to serialize access to current state
 	VRDeviceState state; // Shadow of server's current state
+	VRDeviceState::TimeStamp packetSendTime; // Time at which the server sent the current state, in client time
+	VRDeviceState::TimeStamp packetReceiveTime; // Time at which the client received the current state
 	bool active; // Flag if client is active
 	bool streaming; // Flag if client is in streaming mode
 	volatile bool connectionDead; // Flag whether the connection to the server was interrupted while in streaming mode
@@ -82,6 +92,9 @@ class VRDeviceClient
 	ErrorCallback* errorCallback; // Function called when a protocol error occurs in streaming mode (called from background thread)
 	
 	/* Private methods: */
+	void readServerState(void); // Reads a state packet from the server and converts its time stamps to client time; state must be locked
+	void requestClockResync(void); // Sends a time stamp request from the packet receiving thread if the clock offset estimate is due for an update
+	void readClockResync(void); // Reads a time stamp reply in the packet receiving thread and updates the clock offset estimate if the round trip was fast enough
 	void* streamReceiveThreadMethod(void); // Stream packet receiving thread method
 	void initClient(void); // Initializes communication between device server and client
 	
@@ -112,9 +125,28 @@ class VRDeviceClient
 		{
 		return state;
 		}
+	bool hasPacketSendTimes(void) const // Returns true if the server reports the send time of each state packet
+		{
+		return serverHasStatistics;
+		}
+	VRDeviceState::TimeStamp getPacketSendTime(void) const // Returns the time at which the server sent the current state in client time, or the receive time if the server does not report send times (state must be locked)
+		{
+		return packetSendTime;
+		}
+	VRDeviceState::TimeStamp getPacketReceiveTime(void) const // Returns the time at which the current state was received (state must be locked)
+		{
+		return packetReceiveTime;
+		}
+	VRDeviceState::TimeStamp getServerTimeOffset(void) const // Returns the current estimate of the offset from the client's clock to the server's clock
+		{
+		return serverTimeOffset;
+		}
+	void synchronizeClocks(int numRounds =8); // Estimates the offset between the client's and server's clocks using the given number of request/reply round trips; cannot be called in streaming mode, where the estimate is updated periodically
+	bool getStatistics(VRDeviceStatistics& statistics,bool reset =false); // Queries the server's device and client statistics and optionally starts a new observation period; returns false if the server does not support statistics; cannot be called in streaming mode
 	void activate(void); // Prepares the server for sending state packets
 	void deactivate(void); // Deactivates server
 	void getPacket(void); // Requests state packet from server; blocks until arrival
+	void getPredictedPacket(VRDeviceState::TimeStamp predictionTime); // Requests state packet predicted by the server to the given client time; blocks until arrival; falls back to getPacket in streaming mode or if the server can't predict
 	void startStream(Callback* newPacketNotificationCallback,ErrorCallback* newErrorCallback =0); // Installs given callback functions (device client adopts function objects) and starts streaming mode
 	void stopStream(void); // Stops streaming mode
 	};
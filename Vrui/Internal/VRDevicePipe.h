@@ -46,7 +46,12 @@ class VRDevicePipe:public Comm::TCPPipe
 		PACKET_REPLY, // Sends a device state packet
 		STARTSTREAM_REQUEST, // Requests entering stream mode (server sends packets automatically)
 		STOPSTREAM_REQUEST, // Requests leaving stream mode
-		STOPSTREAM_REPLY // Server's reply after last stream packet has been sent
+		STOPSTREAM_REPLY, // Server's reply after last stream packet has been sent
+		TIMESTAMP_REQUEST, // Requests the server's current time stamp for clock synchronization
+		TIMESTAMP_REPLY, // Sends the server's current time stamp
+		PREDICTEDPACKET_REQUEST, // Requests a single packet with device state predicted to a given server time stamp
+		STATISTICS_REQUEST, // Requests the server's device and client statistics
+		STATISTICS_REPLY // Sends the server's device and client statistics
 		};
 	
 	/* Constructors and destructors: */
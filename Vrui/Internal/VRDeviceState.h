@@ -27,6 +27,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Misc/SizedTypes.h>
 #include <Misc/ArrayMarshallers.h>
 #include <IO/File.h>
+#include <Realtime/Time.h>
 #include <Geometry/OrthonormalTransformation.h>
 #include <Geometry/GeometryMarshallers.h>
 
@@ -96,6 +97,13 @@ class VRDeviceState
 		/* Initialize state arrays: */
 		initState();
 		}
+	VRDeviceState(const VRDeviceState& source) // Copy constructor
+		:numTrackers(0),trackerStates(0),trackerTimeStamps(0),
+		 numButtons(0),buttonStates(0),
+		 numValuators(0),valuatorStates(0)
+		{
+		*this=source;
+		}
 	~VRDeviceState(void)
 		{
 		delete[] trackerStates;
@@ -105,6 +113,11 @@ class VRDeviceState
 		}
 	
 	/* Methods: */
+	static TimeStamp getCurrentTimeStamp(void) // Returns the lower-order bits of the current monotonic time in microseconds
+		{
+		Realtime::TimePointMonotonic now;
+		return TimeStamp(now.tv_sec*1000000+(now.tv_nsec+500)/1000);
+		}
 	void setLayout(int newNumTrackers,int newNumButtons,int newNumValuators) // Sets the number of represented trackers, buttons and valuators
 		{
 		/* Re-allocate state arrays: */
@@ -208,6 +221,41 @@ class VRDeviceState
 		{
 		return valuatorStates;
 		}
+	void predictTrackerStates(TimeStamp predictionTime) // Extrapolates all tracker states to the given time stamp using their current linear and angular velocities
+		{
+		typedef TrackerState::PositionOrientation PO;
+		for(int i=0;i<numTrackers;++i)
+			{
+			/* Calculate the signed prediction interval, taking time stamp wrap-around into account: */
+			float predictionDelta=float(Misc::SInt32(predictionTime-trackerTimeStamps[i]))*1.0e-6f;
+			
+			/* Extrapolate the tracker's position and orientation: */
+			TrackerState& ts=trackerStates[i];
+			PO::Rotation predictRot=PO::Rotation::rotateScaledAxis(ts.angularVelocity*predictionDelta)*ts.positionOrientation.getRotation();
+			predictRot.renormalize();
+			PO::Vector predictTrans=ts.linearVelocity*predictionDelta+ts.positionOrientation.getTranslation();
+			ts.positionOrientation=PO(predictTrans,predictRot);
+			trackerTimeStamps[i]=predictionTime;
+			}
+		}
+	VRDeviceState& operator=(const VRDeviceState& source) // Copies the given device state, adapting this state's layout if necessary
+		{
+		if(this!=&source)
+			{
+			if(numTrackers!=source.numTrackers||numButtons!=source.numButtons||numValuators!=source.numValuators)
+				setLayout(source.numTrackers,source.numButtons,source.numValuators);
+			for(int i=0;i<numTrackers;++i)
+				{
+				trackerStates[i]=source.trackerStates[i];
+				trackerTimeStamps[i]=source.trackerTimeStamps[i];
+				}
+			for(int i=0;i<numButtons;++i)
+				buttonStates[i]=source.buttonStates[i];
+			for(int i=0;i<numValuators;++i)
+				valuatorStates[i]=source.valuatorStates[i];
+			}
+		return *this;
+		}
 	void writeLayout(IO::File& sink) const // Writes device state's layout to given data sink
 		{
 		sink.write<int>(numTrackers);
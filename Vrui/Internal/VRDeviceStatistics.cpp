@@ -0,0 +1,98 @@
+/***********************************************************************
+VRDeviceStatistics - Class describing update rates, latencies, and
+client backlogs measured by a VR device daemon.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Vrui/Internal/VRDeviceStatistics.h>
+
+#include <Misc/SizedTypes.h>
+#include <Misc/StandardMarshallers.h>
+#include <IO/File.h>
+
+namespace Vrui {
+
+/***********************************
+Methods of class VRDeviceStatistics:
+***********************************/
+
+void VRDeviceStatistics::write(IO::File& sink) const
+	{
+	sink.write<Misc::Float64>(period);
+	
+	/* Write all device statistics: */
+	sink.write<Misc::UInt32>(Misc::UInt32(devices.size()));
+	for(std::vector<DeviceStatistics>::const_iterator dIt=devices.begin();dIt!=devices.end();++dIt)
+		{
+		Misc::Marshaller<std::string>::write(dIt->name,sink);
+		sink.write<Misc::UInt32>(dIt->numTrackers);
+		sink.write<Misc::UInt32>(dIt->numSamples);
+		sink.write<Misc::UInt32>(dIt->numDroppedSamples);
+		sink.write<Misc::Float32>(dIt->sampleRate);
+		sink.write<Misc::Float32>(dIt->receiveLatency,NUM_LATENCYPERCENTILES);
+		sink.write<Misc::Float32>(dIt->queueLatency,NUM_LATENCYPERCENTILES);
+		sink.write<Misc::Float32>(dIt->deliveryLatency,NUM_LATENCYPERCENTILES);
+		}
+	
+	/* Write all client statistics: */
+	sink.write<Misc::UInt32>(Misc::UInt32(clients.size()));
+	for(std::vector<ClientStatistics>::const_iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+		{
+		Misc::Marshaller<std::string>::write(cIt->name,sink);
+		sink.write<Misc::UInt32>(cIt->protocolVersion);
+		sink.write<Misc::UInt8>(cIt->active?1:0);
+		sink.write<Misc::UInt8>(cIt->streaming?1:0);
+		sink.write<Misc::UInt32>(cIt->numPacketsSent);
+		sink.write<Misc::UInt32>(cIt->sendBacklog);
+		}
+	}
+
+void VRDeviceStatistics::read(IO::File& source)
+	{
+	period=source.read<Misc::Float64>();
+	
+	/* Read all device statistics: */
+	devices.resize(source.read<Misc::UInt32>());
+	for(std::vector<DeviceStatistics>::iterator dIt=devices.begin();dIt!=devices.end();++dIt)
+		{
+		dIt->name=Misc::Marshaller<std::string>::read(source);
+		dIt->numTrackers=source.read<Misc::UInt32>();
+		dIt->numSamples=source.read<Misc::UInt32>();
+		dIt->numDroppedSamples=source.read<Misc::UInt32>();
+		dIt->sampleRate=source.read<Misc::Float32>();
+		source.read<Misc::Float32>(dIt->receiveLatency,NUM_LATENCYPERCENTILES);
+		source.read<Misc::Float32>(dIt->queueLatency,NUM_LATENCYPERCENTILES);
+		source.read<Misc::Float32>(dIt->deliveryLatency,NUM_LATENCYPERCENTILES);
+		}
+	
+	/* Read all client statistics: */
+	clients.resize(source.read<Misc::UInt32>());
+	for(std::vector<ClientStatistics>::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+		{
+		cIt->name=Misc::Marshaller<std::string>::read(source);
+		cIt->protocolVersion=source.read<Misc::UInt32>();
+		cIt->active=source.read<Misc::UInt8>()!=0;
+		cIt->streaming=source.read<Misc::UInt8>()!=0;
+		cIt->numPacketsSent=source.read<Misc::UInt32>();
+		cIt->sendBacklog=source.read<Misc::UInt32>();
+		}
+	}
+
+}
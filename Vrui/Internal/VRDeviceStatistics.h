@@ -0,0 +1,90 @@
+/***********************************************************************
+VRDeviceStatistics - Class describing update rates, latencies, and
+client backlogs measured by a VR device daemon.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef VRUI_INTERNAL_VRDEVICESTATISTICS_INCLUDED
+#define VRUI_INTERNAL_VRDEVICESTATISTICS_INCLUDED
+
+#include <string>
+#include <vector>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+}
+
+namespace Vrui {
+
+class VRDeviceStatistics
+	{
+	/* Embedded classes: */
+	public:
+	enum LatencyPercentile // Enumerated type for reported latency percentiles
+		{
+		MEDIAN=0,P90,P99,MAXIMUM,NUM_LATENCYPERCENTILES
+		};
+	
+	struct DeviceStatistics // Structure describing the performance of a single VR device
+		{
+		/* Elements: */
+		public:
+		std::string name; // Name of the device's configuration file section
+		unsigned int numTrackers; // Number of trackers owned by the device
+		unsigned int numSamples; // Number of tracker samples received from the device
+		unsigned int numDroppedSamples; // Number of tracker samples that were overwritten before they were sent to any client
+		float sampleRate; // Average tracker sample rate in Hz per tracker
+		float receiveLatency[NUM_LATENCYPERCENTILES]; // Latency percentiles from device sample time to reception by the device manager in microseconds
+		float queueLatency[NUM_LATENCYPERCENTILES]; // Latency percentiles from reception by the device manager to writing to a client's socket in microseconds
+		float deliveryLatency[NUM_LATENCYPERCENTILES]; // Latency percentiles from device sample time to writing to a client's socket in microseconds
+		};
+	
+	struct ClientStatistics // Structure describing the state of a single connected client
+		{
+		/* Elements: */
+		public:
+		std::string name; // Client's host name and port
+		unsigned int protocolVersion; // Protocol version used by the client
+		bool active; // Flag whether the client is active
+		bool streaming; // Flag whether the client is streaming
+		unsigned int numPacketsSent; // Number of state packets sent to the client
+		unsigned int sendBacklog; // Number of bytes queued in the client socket's send buffer
+		};
+	
+	/* Elements: */
+	double period; // Length of the observation period in seconds
+	std::vector<DeviceStatistics> devices; // Statistics for all VR devices
+	std::vector<ClientStatistics> clients; // Statistics for all connected clients
+	
+	/* Constructors and destructors: */
+	VRDeviceStatistics(void) // Creates empty statistics
+		:period(0.0)
+		{
+		}
+	
+	/* Methods: */
+	void write(IO::File& sink) const; // Writes the statistics to a data sink
+	void read(IO::File& source); // Reads statistics from a data source
+	};
+
+}
+
+#endif
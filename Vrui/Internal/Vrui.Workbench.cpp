@@ -799,6 +799,9 @@ void init(int& argc,char**& argv,char**&)
 				/* Create the multicast multiplexer: */
 				vruiMultiplexer=new Cluster::Multiplexer(vruiNumSlaves,0,master.c_str(),masterPort,multicastGroup.c_str(),multicastPort);
 				vruiMultiplexer->setSendBufferSize(multicastSendBufferSize);
+				vruiMultiplexer->setMTUSize(vruiConfigFile->retrieveValue<unsigned int>("./multipipeMTUSize",(unsigned int)(vruiMultiplexer->getMTUSize())));
+				vruiMultiplexer->setFecBlockSize(vruiConfigFile->retrieveValue<unsigned int>("./multipipeFecBlockSize",vruiMultiplexer->getFecBlockSize()));
+				vruiMultiplexer->setCollectiveFanout(vruiConfigFile->retrieveValue<unsigned int>("./multipipeCollectiveFanout",vruiMultiplexer->getCollectiveFanout()));
 				
 				/* Start the multipipe slaves on all slave nodes: */
 				std::string multipipeRemoteCommand=vruiConfigFile->retrieveString("./multipipeRemoteCommand","ssh");
@@ -39,8 +39,12 @@ SceneGraph::GLRenderState* createRenderState(bool navigational,GLContextData& co
 	/* Get the initial transformation: */
 	const NavTransform& initial=navigational?getDisplayState(contextData).modelviewNavigational:mvp;
 	
+	/* Create the render state object and mark it with the current frame's application time: */
+	SceneGraph::GLRenderState* result=new SceneGraph::GLRenderState(contextData,initial,mvp.transform(getMainViewer()->getHeadPosition()),mvp.transform(getUpDirection()));
+	result->frameTime=getApplicationTime();
+	
 	/* Return the render state object: */
-	return new SceneGraph::GLRenderState(contextData,initial,mvp.transform(getMainViewer()->getHeadPosition()),mvp.transform(getUpDirection()));
+	return result;
 	}
 
 SceneGraph::GLRenderState* createRenderState(const NavTransform& transform,bool navigational,GLContextData& contextData)
@@ -53,8 +57,12 @@ SceneGraph::GLRenderState* createRenderState(const NavTransform& transform,bool
 	initial*=transform;
 	initial.renormalize();
 	
+	/* Create the render state object and mark it with the current frame's application time: */
+	SceneGraph::GLRenderState* result=new SceneGraph::GLRenderState(contextData,initial,mvp.transform(getMainViewer()->getHeadPosition()),mvp.transform(getUpDirection()));
+	result->frameTime=getApplicationTime();
+	
 	/* Return the render state object: */
-	return new SceneGraph::GLRenderState(contextData,initial,mvp.transform(getMainViewer()->getHeadPosition()),mvp.transform(getUpDirection()));
+	return result;
 	}
 
 void renderSceneGraph(const SceneGraph::GraphNode* root,bool navigational,GLContextData& contextData)
@@ -68,8 +76,9 @@ void renderSceneGraph(const SceneGraph::GraphNode* root,bool navigational,GLCont
 	/* Get the initial transformation: */
 	const NavTransform& initial=navigational?getDisplayState(contextData).modelviewNavigational:mvp;
 	
-	/* Create the render state object: */
+	/* Create the render state object and mark it with the current frame's application time: */
 	SceneGraph::GLRenderState renderState(contextData,initial,mvp.transform(getMainViewer()->getHeadPosition()),mvp.transform(getUpDirection()));
+	renderState.frameTime=getApplicationTime();
 	
 	/* Render the scene graph: */
 	root->glRenderAction(renderState);
@@ -91,8 +100,9 @@ void renderSceneGraph(const SceneGraph::GraphNode* root,const NavTransform& tran
 	initial*=transform;
 	initial.renormalize();
 	
-	/* Create the render state object: */
+	/* Create the render state object and mark it with the current frame's application time: */
 	SceneGraph::GLRenderState renderState(contextData,initial,mvp.transform(getMainViewer()->getHeadPosition()),mvp.transform(getUpDirection()));
+	renderState.frameTime=getApplicationTime();
 	
 	/* Render the scene graph: */
 	root->glRenderAction(renderState);
@@ -0,0 +1,314 @@
+/***********************************************************************
+ConvertInputDeviceDataFile - Program to convert a previously saved input
+device data file of any version into the chunked and indexed format
+written by Vrui's InputDeviceDataSaver class.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/StringMarshaller.h>
+#include <IO/File.h>
+#include <IO/SeekableFile.h>
+#include <IO/OpenFile.h>
+#include <Vrui/Geometry.h>
+#include <Vrui/InputDevice.h>
+#include <Vrui/TextEventDispatcher.h>
+#include <Vrui/Internal/InputDeviceDataChunkReader.h>
+#include <Vrui/Internal/InputDeviceDataChunkWriter.h>
+
+/**************
+Helper classes:
+**************/
+
+struct DeviceLayout // Structure to store the layout of a saved input device
+	{
+	/* Elements: */
+	public:
+	int trackType;
+	int numButtons;
+	int numValuators;
+	Vrui::Vector deviceRayDirection; // Device ray direction from file header, for files of version 2 and earlier
+	};
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	const char* inputFileName=0;
+	const char* outputFileName=0;
+	unsigned int chunkSize=256U*1024U;
+	int compressionLevel=6;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"chunkSize")==0&&i+1<argc)
+				{
+				++i;
+				chunkSize=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"compressionLevel")==0&&i+1<argc)
+				{
+				++i;
+				compressionLevel=atoi(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else if(inputFileName==0)
+			inputFileName=argv[i];
+		else if(outputFileName==0)
+			outputFileName=argv[i];
+		else
+			std::cerr<<"Ignoring extra command line argument "<<argv[i]<<std::endl;
+		}
+	if(inputFileName==0||outputFileName==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" <input file name> <output file name> [-chunkSize <uncompressed chunk size>] [-compressionLevel <zlib compression level>]"<<std::endl;
+		return 1;
+		}
+	
+	try
+		{
+		/* Open the input file: */
+		IO::SeekableFilePtr inputDeviceDataFile(IO::openSeekableFile(inputFileName));
+		inputDeviceDataFile->setEndianness(Misc::LittleEndian);
+		
+		/* Read the file header: */
+		static const char* fileHeader="Vrui Input Device Data File v5.0\n";
+		char header[34];
+		inputDeviceDataFile->read<char>(header,34);
+		header[33]='\0';
+		
+		int fileVersion;
+		if(strncmp(header,fileHeader,29)!=0)
+			{
+			/* Pre-versioning file version: */
+			fileVersion=1;
+			
+			/* Old file format doesn't have the header text: */
+			inputDeviceDataFile->setReadPosAbs(0);
+			}
+		else if(strcmp(header+29,"2.0\n")==0)
+			fileVersion=2;
+		else if(strcmp(header+29,"3.0\n")==0)
+			fileVersion=3;
+		else if(strcmp(header+29,"4.0\n")==0)
+			fileVersion=4;
+		else if(strcmp(header+29,"5.0\n")==0)
+			fileVersion=5;
+		else
+			{
+			header[32]='\0';
+			std::cerr<<"Unsupported input device data file version "<<header+29<<std::endl;
+			return 1;
+			}
+		
+		/* Open the output file and write the file header: */
+		IO::SeekableFilePtr outputFile(IO::openSeekableFile(outputFileName,IO::File::WriteOnly));
+		outputFile->setEndianness(Misc::LittleEndian);
+		outputFile->write<char>(fileHeader,34);
+		
+		/* Copy the random seed value: */
+		outputFile->write<unsigned int>(inputDeviceDataFile->read<unsigned int>());
+		
+		/* Copy the number of input devices: */
+		int numInputDevices=inputDeviceDataFile->read<int>();
+		outputFile->write<int>(numInputDevices);
+		
+		/* Copy the layouts and feature names of all input devices: */
+		std::vector<DeviceLayout> devices(numInputDevices);
+		for(int i=0;i<numInputDevices;++i)
+			{
+			/* Read device's name and layout: */
+			std::string name;
+			if(fileVersion>=2)
+				name=Misc::readCppString(*inputDeviceDataFile);
+			else
+				{
+				/* Read a fixed-size string: */
+				char nameBuffer[40];
+				inputDeviceDataFile->read(nameBuffer,sizeof(nameBuffer));
+				nameBuffer[sizeof(nameBuffer)-1]='\0';
+				name=nameBuffer;
+				}
+			DeviceLayout& dl=devices[i];
+			dl.trackType=inputDeviceDataFile->read<int>();
+			dl.numButtons=inputDeviceDataFile->read<int>();
+			dl.numValuators=inputDeviceDataFile->read<int>();
+			dl.deviceRayDirection=Vrui::Vector(0,1,0);
+			if(fileVersion<3)
+				inputDeviceDataFile->read(dl.deviceRayDirection.getComponents(),3);
+			
+			/* Write device's name and layout: */
+			Misc::writeCppString(name,*outputFile);
+			outputFile->write<int>(dl.trackType);
+			outputFile->write<int>(dl.numButtons);
+			outputFile->write<int>(dl.numValuators);
+			
+			/* Copy or create the device's feature names: */
+			if(fileVersion>=2)
+				{
+				for(int j=0;j<dl.numButtons+dl.numValuators;++j)
+					Misc::writeCppString(Misc::readCppString(*inputDeviceDataFile),*outputFile);
+				}
+			else
+				{
+				char featureName[40];
+				for(int j=0;j<dl.numButtons;++j)
+					{
+					snprintf(featureName,sizeof(featureName),"Button%d",j);
+					Misc::writeCppString(featureName,*outputFile);
+					}
+				for(int j=0;j<dl.numValuators;++j)
+					{
+					snprintf(featureName,sizeof(featureName),"Valuator%d",j);
+					Misc::writeCppString(featureName,*outputFile);
+					}
+				}
+			}
+		
+		/* Create a chunk reader for version 5 input files, and a chunk writer for the output file: */
+		Misc::SelfDestructPointer<Vrui::InputDeviceDataChunkReader> chunkReader;
+		if(fileVersion>=5)
+			chunkReader.setTarget(new Vrui::InputDeviceDataChunkReader(inputDeviceDataFile));
+		Vrui::InputDeviceDataChunkWriter chunkWriter(outputFile,chunkSize,compressionLevel);
+		
+		/* Convert all data frames: */
+		size_t numFrames=0;
+		double firstTimeStamp=0.0;
+		double lastTimeStamp=0.0;
+		while(true)
+			{
+			/* Read the next time stamp: */
+			double timeStamp;
+			IO::File* frameSource;
+			if(chunkReader.isValid())
+				{
+				frameSource=chunkReader->readNextFrame(timeStamp);
+				if(frameSource==0)
+					break;
+				}
+			else
+				{
+				frameSource=inputDeviceDataFile.getPointer();
+				try
+					{
+					timeStamp=inputDeviceDataFile->read<double>();
+					}
+				catch(IO::File::ReadError)
+					{
+					/* At end of file */
+					break;
+					}
+				}
+			if(numFrames==0)
+				firstTimeStamp=timeStamp;
+			lastTimeStamp=timeStamp;
+			++numFrames;
+			
+			/* Start a new output frame: */
+			IO::File& frame=chunkWriter.startFrame(timeStamp);
+			
+			/* Convert the states of all input devices: */
+			for(std::vector<DeviceLayout>::iterator dIt=devices.begin();dIt!=devices.end();++dIt)
+				{
+				/* Convert tracker state: */
+				if(dIt->trackType!=Vrui::InputDevice::TRACK_NONE)
+					{
+					Vrui::Scalar trackerState[17];
+					if(fileVersion>=3)
+						frameSource->read(trackerState,17);
+					else
+						{
+						/* Use the device ray from the file header and zero velocities: */
+						for(int i=0;i<3;++i)
+							trackerState[i]=dIt->deviceRayDirection[i];
+						trackerState[3]=Vrui::Scalar(0);
+						frameSource->read(trackerState+4,7);
+						for(int i=11;i<17;++i)
+							trackerState[i]=Vrui::Scalar(0);
+						}
+					frame.write(trackerState,17);
+					}
+				
+				/* Convert button states: */
+				if(fileVersion>=3)
+					{
+					int numButtonBytes=(dIt->numButtons+7)/8;
+					for(int i=0;i<numButtonBytes;++i)
+						frame.write(frameSource->read<unsigned char>());
+					}
+				else
+					{
+					unsigned char buttonBits=0x00U;
+					int numBits=0;
+					for(int i=0;i<dIt->numButtons;++i)
+						{
+						buttonBits<<=1;
+						if(frameSource->read<int>()!=0)
+							buttonBits|=0x01U;
+						if(++numBits==8)
+							{
+							frame.write(buttonBits);
+							buttonBits=0x00U;
+							numBits=0;
+							}
+						}
+					if(numBits!=0)
+						{
+						buttonBits<<=8-numBits;
+						frame.write(buttonBits);
+						}
+					}
+				
+				/* Copy valuator states: */
+				for(int i=0;i<dIt->numValuators;++i)
+					frame.write(frameSource->read<double>());
+				}
+			
+			/* Copy text and text control events, or write empty event queues for older files: */
+			Vrui::TextEventDispatcher textEvents(false);
+			if(fileVersion>=4)
+				textEvents.readEventQueues(*frameSource);
+			textEvents.writeEventQueues(frame);
+			
+			chunkWriter.finishFrame();
+			}
+		
+		/* Write the chunk index: */
+		chunkWriter.close();
+		
+		std::cout<<"Converted "<<numFrames<<" frames from time "<<firstTimeStamp<<" to "<<lastTimeStamp<<" from version "<<fileVersion<<" to version 5"<<std::endl;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,227 @@
+/***********************************************************************
+DeviceStressBenchmark - Program to measure the throughput and latency of
+a Vrui VR Device Daemon under load from many concurrently updating
+devices and several streaming clients.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Misc/Time.h>
+#include <Misc/FunctionCalls.h>
+#include <Math/Histogram.h>
+#include <Vrui/Internal/VRDeviceState.h>
+#include <Vrui/Internal/VRDeviceStatistics.h>
+#include <Vrui/Internal/VRDeviceClient.h>
+
+/**************
+Helper classes:
+**************/
+
+struct ClientMonitor // Structure collecting the packets received by one streaming client
+	{
+	/* Elements: */
+	public:
+	Vrui::VRDeviceClient* client; // Device client connected to the server
+	std::vector<Vrui::VRDeviceState::TimeStamp> trackerTimeStamps; // Time stamps of all trackers in the most recently received packet
+	bool first; // Flag whether the next packet is the first one received
+	unsigned int numPackets; // Number of state packets received
+	unsigned int numUpdates; // Number of tracker states that changed between successive packets
+	Math::Histogram<int> latencies; // Histogram of latencies from device sample time to packet reception for all changed tracker states in microseconds
+	Math::Histogram<int> networkLatencies; // Histogram of latencies from the server sending a packet to its reception in microseconds
+	
+	/* Constructors and destructors: */
+	ClientMonitor(Vrui::VRDeviceClient* sClient)
+		:client(sClient),first(true),numPackets(0),numUpdates(0),
+		 latencies(1,-10000,100000),networkLatencies(1,-10000,100000)
+		{
+		}
+	
+	/* Methods: */
+	void packetCallback(Vrui::VRDeviceClient* deviceClient) // Called from the client's packet receiving thread when a new state packet arrives
+		{
+		deviceClient->lockState();
+		const Vrui::VRDeviceState& state=deviceClient->getState();
+		Vrui::VRDeviceState::TimeStamp receiveTime=deviceClient->getPacketReceiveTime();
+		if(first)
+			{
+			/* Initialize the tracker time stamps: */
+			trackerTimeStamps.clear();
+			for(int i=0;i<state.getNumTrackers();++i)
+				trackerTimeStamps.push_back(state.getTrackerTimeStamp(i));
+			first=false;
+			}
+		else
+			{
+			/* Count the trackers that were updated since the previous packet: */
+			for(int i=0;i<state.getNumTrackers();++i)
+				if(state.getTrackerTimeStamp(i)!=trackerTimeStamps[i])
+					{
+					trackerTimeStamps[i]=state.getTrackerTimeStamp(i);
+					++numUpdates;
+					latencies.addSample(int(Misc::SInt32(receiveTime-trackerTimeStamps[i])));
+					}
+			}
+		networkLatencies.addSample(int(Misc::SInt32(receiveTime-deviceClient->getPacketSendTime())));
+		++numPackets;
+		deviceClient->unlockState();
+		}
+	};
+
+int main(int argc,char* argv[])
+	{
+	/* Parse command line: */
+	char* serverName=0;
+	double runTime=10.0;
+	unsigned int numClients=1;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"time")==0&&i+1<argc)
+				{
+				++i;
+				runTime=atof(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"clients")==0&&i+1<argc)
+				{
+				++i;
+				numClients=(unsigned int)(atoi(argv[i]));
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			serverName=argv[i];
+		}
+	if(serverName==0||numClients==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-time <run time in s>] [-clients <number of streaming clients>] <serverName:serverPort>"<<std::endl;
+		return 1;
+		}
+	
+	/* Split the server name into hostname:port: */
+	char* colonPtr=0;
+	for(char* cPtr=serverName;*cPtr!='\0';++cPtr)
+		if(*cPtr==':')
+			colonPtr=cPtr;
+	int portNumber=0;
+	if(colonPtr!=0)
+		{
+		portNumber=atoi(colonPtr+1);
+		*colonPtr='\0';
+		}
+	
+	/* Connect all clients to the server: */
+	std::vector<ClientMonitor*> monitors;
+	try
+		{
+		for(unsigned int i=0;i<numClients;++i)
+			monitors.push_back(new ClientMonitor(new Vrui::VRDeviceClient(serverName,portNumber)));
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<" while connecting to device server"<<std::endl;
+		for(std::vector<ClientMonitor*>::iterator mIt=monitors.begin();mIt!=monitors.end();++mIt)
+			{
+			delete (*mIt)->client;
+			delete *mIt;
+			}
+		return 1;
+		}
+	
+	/* Start a new statistics observation period on the server: */
+	Vrui::VRDeviceStatistics stats;
+	bool haveStatistics=monitors.front()->client->getStatistics(stats,true);
+	
+	int result=0;
+	try
+		{
+		/* Start streaming on all clients: */
+		for(std::vector<ClientMonitor*>::iterator mIt=monitors.begin();mIt!=monitors.end();++mIt)
+			{
+			(*mIt)->client->activate();
+			(*mIt)->client->startStream(Misc::createFunctionCall(*mIt,&ClientMonitor::packetCallback));
+			}
+		
+		/* Let the server run under load: */
+		Misc::sleep(Misc::Time(runTime));
+		
+		/* Stop streaming on all clients: */
+		for(std::vector<ClientMonitor*>::iterator mIt=monitors.begin();mIt!=monitors.end();++mIt)
+			{
+			(*mIt)->client->stopStream();
+			(*mIt)->client->deactivate();
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<" while streaming from device server"<<std::endl;
+		result=1;
+		}
+	
+	if(result==0)
+		{
+		/* Print the client-side results: */
+		printf("Client,Packets,Packet rate (Hz),Tracker updates,Update rate (Hz),Median latency (us),90%% latency (us),99%% latency (us),Max latency (us),Median network latency (us),99%% network latency (us)\n");
+		for(unsigned int i=0;i<numClients;++i)
+			{
+			ClientMonitor& m=*monitors[i];
+			printf("%u,%u,%.1f,%u,%.1f",i,m.numPackets,double(m.numPackets)/runTime,m.numUpdates,double(m.numUpdates)/runTime);
+			if(m.latencies.getNumSamples()>0)
+				printf(",%d,%d,%d,%d",m.latencies.getPercentile(0.5),m.latencies.getPercentile(0.9),m.latencies.getPercentile(0.99),m.latencies.getMaxValue());
+			else
+				printf(",,,,");
+			if(m.networkLatencies.getNumSamples()>0)
+				printf(",%d,%d\n",m.networkLatencies.getPercentile(0.5),m.networkLatencies.getPercentile(0.99));
+			else
+				printf(",,\n");
+			}
+		
+		/* Print the server-side results: */
+		if(haveStatistics&&monitors.front()->client->getStatistics(stats,false))
+			{
+			printf("\nDevice,Trackers,Samples,Dropped samples,Sample rate (Hz),Median receive latency (us),99%% receive latency (us),Median queue latency (us),99%% queue latency (us),Median delivery latency (us),99%% delivery latency (us),Max delivery latency (us)\n");
+			for(std::vector<Vrui::VRDeviceStatistics::DeviceStatistics>::iterator dIt=stats.devices.begin();dIt!=stats.devices.end();++dIt)
+				{
+				printf("%s,%u,%u,%u,%.1f",dIt->name.c_str(),dIt->numTrackers,dIt->numSamples,dIt->numDroppedSamples,dIt->sampleRate);
+				printf(",%.1f,%.1f",dIt->receiveLatency[Vrui::VRDeviceStatistics::MEDIAN],dIt->receiveLatency[Vrui::VRDeviceStatistics::P99]);
+				printf(",%.1f,%.1f",dIt->queueLatency[Vrui::VRDeviceStatistics::MEDIAN],dIt->queueLatency[Vrui::VRDeviceStatistics::P99]);
+				printf(",%.1f,%.1f,%.1f\n",dIt->deliveryLatency[Vrui::VRDeviceStatistics::MEDIAN],dIt->deliveryLatency[Vrui::VRDeviceStatistics::P99],dIt->deliveryLatency[Vrui::VRDeviceStatistics::MAXIMUM]);
+				}
+			}
+		else
+			printf("\nDevice server does not support statistics\n");
+		}
+	
+	/* Disconnect all clients: */
+	for(std::vector<ClientMonitor*>::iterator mIt=monitors.begin();mIt!=monitors.end();++mIt)
+		{
+		delete (*mIt)->client;
+		delete *mIt;
+		}
+	
+	return result;
+	}
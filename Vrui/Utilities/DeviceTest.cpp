@@ -32,6 +32,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Geometry/AffineCombiner.h>
 #include <Geometry/OutputOperators.h>
 #include <Vrui/Internal/VRDeviceDescriptor.h>
+#include <Vrui/Internal/VRDeviceStatistics.h>
 #include <Vrui/Internal/VRDeviceClient.h>
 
 typedef Vrui::VRDeviceState::TrackerState TrackerState;
@@ -211,6 +212,10 @@ int main(int argc,char* argv[])
 	unsigned int latencyBinSize=250;
 	unsigned int latencyMaxLatency=20000;
 	unsigned int latencyNumSamples=1000;
+	bool printStatistics=false;
+	bool resetStatistics=false;
+	bool predict=false;
+	Vrui::VRDeviceState::TimeStamp predictionDelta=0U;
 	for(int i=1;i<argc;++i)
 		{
 		if(argv[i][0]=='-')
@@ -258,6 +263,19 @@ int main(int argc,char* argv[])
 				++i;
 				latencyNumSamples=(unsigned int)(atoi(argv[i]));
 				}
+			else if(strcasecmp(argv[i],"-stats")==0)
+				printStatistics=true;
+			else if(strcasecmp(argv[i],"-resetStats")==0)
+				{
+				printStatistics=true;
+				resetStatistics=true;
+				}
+			else if(strcasecmp(argv[i],"-predict")==0)
+				{
+				predict=true;
+				++i;
+				predictionDelta=Vrui::VRDeviceState::TimeStamp(atoi(argv[i]));
+				}
 			}
 		else
 			serverName=argv[i];
@@ -265,7 +283,7 @@ int main(int argc,char* argv[])
 	
 	if(serverName==0)
 		{
-		std::cerr<<"Usage: "<<argv[0]<<" [-ld | -listDevices] [(-t | --trackerIndex) <trackerIndex>] [-alltrackers] [-p | -o | -f | -v] [-b] [-n] [-save <save file name>] [-trigger <trigger index>] [-latency <trackerIndex> <bin size> <max latency> <num samples>] <serverName:serverPort>"<<std::endl;
+		std::cerr<<"Usage: "<<argv[0]<<" [-ld | -listDevices] [(-t | --trackerIndex) <trackerIndex>] [-alltrackers] [-p | -o | -f | -v] [-b] [-n] [-save <save file name>] [-trigger <trigger index>] [-latency <trackerIndex> <bin size> <max latency> <num samples>] [-stats | -resetStats] [-predict <prediction interval in us>] <serverName:serverPort>"<<std::endl;
 		return 1;
 		}
 	
@@ -337,6 +355,42 @@ int main(int argc,char* argv[])
 		std::cout<<std::endl;
 		}
 	
+	if(printStatistics)
+		{
+		/* Query and print the server's device and client statistics: */
+		Vrui::VRDeviceStatistics stats;
+		if(!deviceClient->getStatistics(stats,resetStatistics))
+			{
+			std::cerr<<"Device server at "<<serverName<<":"<<portNumber<<" does not support statistics"<<std::endl;
+			delete deviceClient;
+			return 1;
+			}
+		
+		std::cout<<"Device server statistics over the last "<<std::fixed<<std::setprecision(3)<<stats.period<<" s:"<<std::endl;
+		for(std::vector<Vrui::VRDeviceStatistics::DeviceStatistics>::iterator dIt=stats.devices.begin();dIt!=stats.devices.end();++dIt)
+			{
+			std::cout<<"Device "<<dIt->name<<": "<<dIt->numTrackers<<" trackers, "<<dIt->numSamples<<" samples, "<<dIt->numDroppedSamples<<" dropped, "<<std::setprecision(1)<<dIt->sampleRate<<" Hz"<<std::endl;
+			if(dIt->numSamples>0)
+				{
+				std::cout<<"  Receive latency (median/90%/99%/max): "<<dIt->receiveLatency[Vrui::VRDeviceStatistics::MEDIAN]<<"/"<<dIt->receiveLatency[Vrui::VRDeviceStatistics::P90]<<"/"<<dIt->receiveLatency[Vrui::VRDeviceStatistics::P99]<<"/"<<dIt->receiveLatency[Vrui::VRDeviceStatistics::MAXIMUM]<<" us"<<std::endl;
+				std::cout<<"  Queue latency (median/90%/99%/max): "<<dIt->queueLatency[Vrui::VRDeviceStatistics::MEDIAN]<<"/"<<dIt->queueLatency[Vrui::VRDeviceStatistics::P90]<<"/"<<dIt->queueLatency[Vrui::VRDeviceStatistics::P99]<<"/"<<dIt->queueLatency[Vrui::VRDeviceStatistics::MAXIMUM]<<" us"<<std::endl;
+				std::cout<<"  Delivery latency (median/90%/99%/max): "<<dIt->deliveryLatency[Vrui::VRDeviceStatistics::MEDIAN]<<"/"<<dIt->deliveryLatency[Vrui::VRDeviceStatistics::P90]<<"/"<<dIt->deliveryLatency[Vrui::VRDeviceStatistics::P99]<<"/"<<dIt->deliveryLatency[Vrui::VRDeviceStatistics::MAXIMUM]<<" us"<<std::endl;
+				}
+			}
+		for(std::vector<Vrui::VRDeviceStatistics::ClientStatistics>::iterator cIt=stats.clients.begin();cIt!=stats.clients.end();++cIt)
+			{
+			std::cout<<"Client "<<cIt->name<<": protocol version "<<cIt->protocolVersion;
+			if(cIt->streaming)
+				std::cout<<", streaming";
+			else if(cIt->active)
+				std::cout<<", active";
+			std::cout<<", "<<cIt->numPacketsSent<<" packets sent, "<<cIt->sendBacklog<<" bytes backlog"<<std::endl;
+			}
+		
+		delete deviceClient;
+		return 0;
+		}
+	
 	/* Disable printing of tracking information if there are no trackers: */
 	deviceClient->lockState();
 	if(printMode==0&&deviceClient->getState().getNumTrackers()==0)
@@ -377,13 +431,17 @@ int main(int argc,char* argv[])
 	try
 		{
 		deviceClient->activate();
-		deviceClient->startStream(0);
+		if(!predict)
+			deviceClient->startStream(0);
 		bool loop=true;
 		bool oldTriggerState=false;
 		while(loop)
 			{
-			/* Wait for next packet: */
-			deviceClient->getPacket();
+			/* Wait for next packet, or request a packet predicted by the server into the future: */
+			if(predict)
+				deviceClient->getPredictedPacket(Vrui::VRDeviceState::getCurrentTimeStamp()+predictionDelta);
+			else
+				deviceClient->getPacket();
 			Realtime::TimePointMonotonic now;
 			Vrui::VRDeviceState::TimeStamp nowTs=Vrui::VRDeviceState::TimeStamp(now.tv_sec*1000000+(now.tv_nsec+500)/1000);
 			++numPackets;
@@ -418,7 +476,10 @@ int main(int argc,char* argv[])
 
 						/* Wait for the next packet: */
 						deviceClient->unlockState();
-						deviceClient->getPacket();
+						if(predict)
+							deviceClient->getPredictedPacket(Vrui::VRDeviceState::getCurrentTimeStamp()+predictionDelta);
+						else
+							deviceClient->getPacket();
 						deviceClient->lockState();
 						}
 
@@ -0,0 +1,418 @@
+/***********************************************************************
+InputDeviceDataFileTest - Program to check that input device data frames
+round-trip through InputDeviceDataChunkWriter and
+InputDeviceDataChunkReader, including seeks and index reconstruction,
+and through the ConvertInputDeviceDataFile utility.
+Copyright (c) 2014 Oliver Kreylos
+
+This file is part of the Virtual Reality User Interface Library (Vrui).
+
+The Virtual Reality User Interface Library is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Virtual Reality User Interface Library is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Virtual Reality User Interface Library; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Misc/VarInt.h>
+#include <Misc/StringMarshaller.h>
+#include <IO/File.h>
+#include <IO/SeekableFile.h>
+#include <IO/StandardFile.h>
+#include <IO/OpenFile.h>
+#include <Vrui/InputDevice.h>
+#include <Vrui/Internal/InputDeviceDataChunkReader.h>
+#include <Vrui/Internal/InputDeviceDataChunkWriter.h>
+
+namespace {
+
+/**************
+Helper classes:
+**************/
+
+struct DeviceLayout // Structure describing the layout of a test input device
+	{
+	/* Elements: */
+	public:
+	const char* name;
+	int trackType;
+	int numButtons;
+	int numValuators;
+	};
+
+struct Frame // Structure holding the states of all test input devices at one time
+	{
+	/* Elements: */
+	public:
+	double timeStamp;
+	std::vector<double> trackerStates; // 17 tracker state components for each tracked device
+	std::vector<unsigned char> buttonBytes; // Packed button states of all devices
+	std::vector<double> valuators; // Valuator states of all devices
+	};
+
+/****************
+Helper functions:
+****************/
+
+const DeviceLayout devices[]=
+	{
+	{"Head",Vrui::InputDevice::TRACK_POS|Vrui::InputDevice::TRACK_DIR|Vrui::InputDevice::TRACK_ORIENT,0,0},
+	{"Wand",Vrui::InputDevice::TRACK_POS|Vrui::InputDevice::TRACK_DIR|Vrui::InputDevice::TRACK_ORIENT,6,2},
+	{"Keyboard",Vrui::InputDevice::TRACK_NONE,11,0}
+	};
+const int numDevices=sizeof(devices)/sizeof(DeviceLayout);
+
+unsigned int randomState=1U; // State of the deterministic pseudo-random number generator
+
+unsigned int nextRandom(void) // Returns the next pseudo-random number in [0, 2^31)
+	{
+	randomState=randomState*1103515245U+12345U;
+	return (randomState>>1)&0x7fffffffU;
+	}
+
+double nextDouble(void) // Returns a pseudo-random number in [-1, 1)
+	{
+	return double(nextRandom())/double(0x40000000U)-1.0;
+	}
+
+void createFrames(std::vector<Frame>& frames,size_t numFrames) // Creates the given number of frames with strictly increasing time stamps
+	{
+	frames.resize(numFrames);
+	double timeStamp=0.0;
+	for(size_t i=0;i<numFrames;++i)
+		{
+		Frame& f=frames[i];
+		timeStamp+=0.005+double(nextRandom()%1000)*1.0e-5;
+		f.timeStamp=timeStamp;
+		for(int d=0;d<numDevices;++d)
+			{
+			if(devices[d].trackType!=Vrui::InputDevice::TRACK_NONE)
+				for(int j=0;j<17;++j)
+					f.trackerStates.push_back(nextDouble());
+			for(int j=0;j<(devices[d].numButtons+7)/8;++j)
+				f.buttonBytes.push_back((unsigned char)(nextRandom()&0xffU));
+			for(int j=0;j<devices[d].numValuators;++j)
+				f.valuators.push_back(nextDouble());
+			}
+		}
+	}
+
+void writeFrameData(IO::File& file,const Frame& frame) // Writes a frame's device states and empty text event queues in version 4 layout
+	{
+	std::vector<double>::const_iterator tsIt=frame.trackerStates.begin();
+	std::vector<unsigned char>::const_iterator bIt=frame.buttonBytes.begin();
+	std::vector<double>::const_iterator vIt=frame.valuators.begin();
+	for(int d=0;d<numDevices;++d)
+		{
+		if(devices[d].trackType!=Vrui::InputDevice::TRACK_NONE)
+			for(int j=0;j<17;++j,++tsIt)
+				file.write<Misc::Float64>(*tsIt);
+		for(int j=0;j<(devices[d].numButtons+7)/8;++j,++bIt)
+			file.write<unsigned char>(*bIt);
+		for(int j=0;j<devices[d].numValuators;++j,++vIt)
+			file.write<Misc::Float64>(*vIt);
+		}
+	Misc::writeVarInt(Misc::UInt32(0),file);
+	Misc::writeVarInt(Misc::UInt32(0),file);
+	}
+
+bool compareFrameData(IO::File& file,const Frame& frame) // Reads a frame's device states and text event queues and compares them to the given frame
+	{
+	std::vector<double>::const_iterator tsIt=frame.trackerStates.begin();
+	std::vector<unsigned char>::const_iterator bIt=frame.buttonBytes.begin();
+	std::vector<double>::const_iterator vIt=frame.valuators.begin();
+	for(int d=0;d<numDevices;++d)
+		{
+		if(devices[d].trackType!=Vrui::InputDevice::TRACK_NONE)
+			for(int j=0;j<17;++j,++tsIt)
+				if(file.read<Misc::Float64>()!=*tsIt)
+					return false;
+		for(int j=0;j<(devices[d].numButtons+7)/8;++j,++bIt)
+			if(file.read<unsigned char>()!=*bIt)
+				return false;
+		for(int j=0;j<devices[d].numValuators;++j,++vIt)
+			if(file.read<Misc::Float64>()!=*vIt)
+				return false;
+		}
+	return Misc::readVarInt(file)==0U&&Misc::readVarInt(file)==0U;
+	}
+
+void writeChunkedFile(const char* fileName,const std::vector<Frame>& frames,size_t chunkSize) // Writes a short prefix followed by all frames through a chunk writer
+	{
+	IO::SeekableFilePtr file(IO::openSeekableFile(fileName,IO::File::WriteOnly));
+	file->setEndianness(Misc::LittleEndian);
+	file->write<char>("PRFX",4);
+	Vrui::InputDeviceDataChunkWriter writer(file,chunkSize,6);
+	for(std::vector<Frame>::const_iterator fIt=frames.begin();fIt!=frames.end();++fIt)
+		{
+		writeFrameData(writer.startFrame(fIt->timeStamp),*fIt);
+		writer.finishFrame();
+		}
+	writer.close();
+	}
+
+IO::SeekableFilePtr openChunkedFile(const char* fileName) // Opens a file written by writeChunkedFile and positions it after the prefix
+	{
+	IO::SeekableFilePtr file(IO::openSeekableFile(fileName));
+	file->setEndianness(Misc::LittleEndian);
+	file->skip<char>(4);
+	return file;
+	}
+
+bool compareSequential(Vrui::InputDeviceDataChunkReader& reader,const std::vector<Frame>& frames) // Reads all frames from the given reader and compares them to the given frames
+	{
+	for(std::vector<Frame>::const_iterator fIt=frames.begin();fIt!=frames.end();++fIt)
+		{
+		double timeStamp;
+		IO::File* frame=reader.readNextFrame(timeStamp);
+		if(frame==0||timeStamp!=fIt->timeStamp||!compareFrameData(*frame,*fIt))
+			return false;
+		}
+	
+	/* Check that the reader ends where the frames end: */
+	double timeStamp;
+	return reader.readNextFrame(timeStamp)==0;
+	}
+
+bool compareSeeks(Vrui::InputDeviceDataChunkReader& reader,const std::vector<Frame>& frames,unsigned int numSeeks) // Seeks to random times and compares the frames following each seek to the given frames
+	{
+	double first=frames.front().timeStamp;
+	double last=frames.back().timeStamp;
+	if(reader.getFirstTimeStamp()!=first||reader.getLastTimeStamp()!=last)
+		return false;
+	for(unsigned int seek=0;seek<numSeeks;++seek)
+		{
+		/* Seek to a random time, including times before the first and after the last frame: */
+		double time=first-1.0+(last-first+2.0)*double(nextRandom())/double(0x80000000U);
+		reader.seekToTime(time);
+		
+		/* Find the expected frame, i.e., the last frame at or before the seek time or the first frame: */
+		size_t l=0;
+		size_t r=frames.size();
+		while(r-l>1)
+			{
+			size_t m=(l+r)>>1;
+			if(frames[m].timeStamp<=time)
+				l=m;
+			else
+				r=m;
+			}
+		
+		/* Read a few frames after the seek: */
+		for(size_t i=l;i<frames.size()&&i<l+3;++i)
+			{
+			double timeStamp;
+			IO::File* frame=reader.readNextFrame(timeStamp);
+			if(frame==0||timeStamp!=frames[i].timeStamp||!compareFrameData(*frame,frames[i]))
+				return false;
+			}
+		}
+	return true;
+	}
+
+void writeVersion4File(const char* fileName,const std::vector<Frame>& frames) // Writes the given frames as a version 4 input device data file
+	{
+	IO::SeekableFilePtr file(IO::openSeekableFile(fileName,IO::File::WriteOnly));
+	file->setEndianness(Misc::LittleEndian);
+	file->write<char>("Vrui Input Device Data File v4.0\n",34);
+	file->write<unsigned int>(0x12345678U);
+	file->write<int>(numDevices);
+	for(int d=0;d<numDevices;++d)
+		{
+		Misc::writeCppString(devices[d].name,*file);
+		file->write<int>(devices[d].trackType);
+		file->write<int>(devices[d].numButtons);
+		file->write<int>(devices[d].numValuators);
+		for(int j=0;j<devices[d].numButtons+devices[d].numValuators;++j)
+			{
+			char featureName[40];
+			snprintf(featureName,sizeof(featureName),"%sFeature%d",devices[d].name,j);
+			Misc::writeCppString(featureName,*file);
+			}
+		}
+	for(std::vector<Frame>::const_iterator fIt=frames.begin();fIt!=frames.end();++fIt)
+		{
+		file->write<double>(fIt->timeStamp);
+		writeFrameData(*file,*fIt);
+		}
+	}
+
+bool compareVersion5File(const char* fileName,const std::vector<Frame>& frames) // Reads a version 5 input device data file and compares its header and frames to the ones written by writeVersion4File
+	{
+	IO::SeekableFilePtr file(IO::openSeekableFile(fileName));
+	file->setEndianness(Misc::LittleEndian);
+	
+	/* Check the file header and device layouts: */
+	char header[34];
+	file->read<char>(header,34);
+	if(memcmp(header,"Vrui Input Device Data File v5.0\n",34)!=0)
+		return false;
+	if(file->read<unsigned int>()!=0x12345678U||file->read<int>()!=numDevices)
+		return false;
+	for(int d=0;d<numDevices;++d)
+		{
+		if(Misc::readCppString(*file)!=devices[d].name)
+			return false;
+		if(file->read<int>()!=devices[d].trackType||file->read<int>()!=devices[d].numButtons||file->read<int>()!=devices[d].numValuators)
+			return false;
+		for(int j=0;j<devices[d].numButtons+devices[d].numValuators;++j)
+			{
+			char featureName[40];
+			snprintf(featureName,sizeof(featureName),"%sFeature%d",devices[d].name,j);
+			if(Misc::readCppString(*file)!=featureName)
+				return false;
+			}
+		}
+	
+	/* Check the frames: */
+	Vrui::InputDeviceDataChunkReader reader(file);
+	return compareSequential(reader,frames);
+	}
+
+bool runConverter(const std::string& converter,const std::string& inputFileName,const std::string& outputFileName,size_t chunkSize) // Runs the converter utility on the given files; returns true if it succeeded
+	{
+	char chunkSizeArg[32];
+	snprintf(chunkSizeArg,sizeof(chunkSizeArg),"%u",(unsigned int)chunkSize);
+	std::string command="\""+converter+"\" \""+inputFileName+"\" \""+outputFileName+"\" -chunkSize "+chunkSizeArg+" > /dev/null";
+	return system(command.c_str())==0;
+	}
+
+bool report(const char* testName,bool passed) // Prints the result of a single test
+	{
+	std::cout<<testName<<": "<<(passed?"passed":"FAILED")<<std::endl;
+	return passed;
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse command line: */
+	size_t numFrames=20000;
+	size_t chunkSize=16*1024;
+	unsigned int numSeeks=1000;
+	std::string converter;
+	const char* baseName="InputDeviceDataFileTest";
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"frames")==0&&i+1<argc)
+				{
+				++i;
+				numFrames=size_t(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"chunkSize")==0&&i+1<argc)
+				{
+				++i;
+				chunkSize=size_t(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"seeks")==0&&i+1<argc)
+				{
+				++i;
+				numSeeks=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"converter")==0&&i+1<argc)
+				{
+				++i;
+				converter=argv[i];
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			baseName=argv[i];
+		}
+	if(numFrames==0||chunkSize==0)
+		{
+		std::cerr<<"Usage: "<<argv[0]<<" [-frames <number of frames>] [-chunkSize <uncompressed chunk size>] [-seeks <number of random seeks>] [-converter <converter executable>] [<temporary file base name>]"<<std::endl;
+		return 1;
+		}
+	if(converter.empty())
+		{
+		/* Look for the converter next to this program: */
+		converter=argv[0];
+		std::string::size_type slashPos=converter.rfind('/');
+		converter=(slashPos!=std::string::npos?converter.substr(0,slashPos+1):std::string("./"))+"ConvertInputDeviceDataFile";
+		}
+	std::string chunkedName=std::string(baseName)+".chunks";
+	std::string truncatedName=std::string(baseName)+".truncated.chunks";
+	std::string version4Name=std::string(baseName)+".v4.dat";
+	std::string version5Name=std::string(baseName)+".v5.dat";
+	std::string rechunkedName=std::string(baseName)+".rechunked.dat";
+	
+	bool passed=true;
+	try
+		{
+		/* Create the test frames: */
+		std::vector<Frame> frames;
+		createFrames(frames,numFrames);
+		
+		/* Write the frames through a chunk writer and read them back sequentially and through seeks: */
+		writeChunkedFile(chunkedName.c_str(),frames,chunkSize);
+		size_t numChunks;
+		{
+		Vrui::InputDeviceDataChunkReader reader(openChunkedFile(chunkedName.c_str()));
+		numChunks=reader.getNumChunks();
+		passed=report("Multiple chunks written",numChunks>1)&&passed;
+		passed=report("Chunk reader sequential read",compareSequential(reader,frames))&&passed;
+		passed=report("Chunk reader seeks through chunk index",compareSeeks(reader,frames,numSeeks))&&passed;
+		}
+		
+		/* Strip the chunk index and trailer, and append a partial chunk, as if the recording application had crashed: */
+		{
+		IO::StandardFile file(chunkedName.c_str());
+		std::vector<unsigned char> contents(size_t(file.getSize()));
+		file.readRaw(&contents[0],contents.size());
+		contents.resize(contents.size()-(4+numChunks*24+20));
+		static const unsigned char partialChunk[]={'C','H','N','K',0x00U,0x00U,0x00U};
+		contents.insert(contents.end(),partialChunk,partialChunk+sizeof(partialChunk));
+		IO::StandardFile truncated(truncatedName.c_str(),IO::File::WriteOnly);
+		truncated.writeRaw(&contents[0],contents.size());
+		}
+		{
+		Vrui::InputDeviceDataChunkReader reader(openChunkedFile(truncatedName.c_str()));
+		passed=report("Reconstructed chunk index",reader.getNumChunks()==numChunks)&&passed;
+		passed=report("Chunk reader sequential read after index reconstruction",compareSequential(reader,frames))&&passed;
+		passed=report("Chunk reader seeks through reconstructed index",compareSeeks(reader,frames,numSeeks))&&passed;
+		}
+		
+		/* Convert a version 4 file to version 5, and re-chunk the result: */
+		writeVersion4File(version4Name.c_str(),frames);
+		bool converted=runConverter(converter,version4Name,version5Name,chunkSize);
+		passed=report("Conversion from version 4",converted&&compareVersion5File(version5Name.c_str(),frames))&&passed;
+		converted=converted&&runConverter(converter,version5Name,rechunkedName,chunkSize*4);
+		passed=report("Re-chunking of version 5",converted&&compareVersion5File(rechunkedName.c_str(),frames))&&passed;
+		}
+	catch(const std::runtime_error& err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		passed=false;
+		}
+	
+	/* Clean up: */
+	remove(chunkedName.c_str());
+	remove(truncatedName.c_str());
+	remove(version4Name.c_str());
+	remove(version5Name.c_str());
+	remove(rechunkedName.c_str());
+	
+	return passed?0:1;
+	}